@@ -8,25 +8,39 @@
 #include "skyline/loader/loader.h"
 #include "skyline/common.h"
 #include "skyline/os.h"
+#include "skyline/nce.h"
 #include "skyline/jvm.h"
 #include "skyline/input.h"
+#include "skyline/audio.h"
+#include "skyline/statistics.h"
+#include "skyline/benchmark.h"
+#include "skyline/allocation.h"
+#include "skyline/control_block.h"
 
-bool Halt;
+std::atomic<bool> Halt;
 jobject Surface;
+std::mutex SurfaceMutex;
+std::condition_variable SurfaceCondition;
 skyline::GroupMutex JniMtx;
-skyline::u16 fps;
-skyline::u32 frametime;
+skyline::ControlBlock Control;
 std::weak_ptr<skyline::input::Input> inputWeak;
+std::weak_ptr<skyline::NCE> nceWeak;
+std::weak_ptr<skyline::audio::Audio> audioWeak;
+std::weak_ptr<skyline::PerformanceStatistics> statisticsWeak;
 
 void signalHandler(int signal) {
     __android_log_print(ANDROID_LOG_FATAL, "emu-cpp", "Halting program due to signal: %s", strsignal(signal));
     exit(signal);
 }
 
-extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(JNIEnv *env, jobject instance, jstring romUriJstring, jint romType, jint romFd, jint preferenceFd, jstring appFilesPathJstring) {
+/**
+ * @brief Runs an application until it exits or is halted, this is shared by regular and headless benchmark runs
+ * @param benchmark The headless benchmark to run the application as, this is nullptr to run it normally
+ */
+static void ExecuteApplication(JNIEnv *env, jobject instance, jstring romUriJstring, jint romType, jint romFd, jint preferenceFd, jstring appFilesPathJstring, std::shared_ptr<skyline::Benchmark> benchmark) {
     Halt = false;
-    fps = 0;
-    frametime = 0;
+    Control.fps = 0;
+    Control.frametime = 0;
 
     std::signal(SIGTERM, signalHandler);
     std::signal(SIGSEGV, signalHandler);
@@ -40,16 +54,21 @@ extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(
     auto jvmManager{std::make_shared<skyline::JvmManager>(env, instance)};
     auto settings{std::make_shared<skyline::Settings>(preferenceFd)};
     close(preferenceFd);
+    skyline::allocation::SetEnabled(settings->GetBool("allocation_profiler", false));
 
     auto appFilesPath{env->GetStringUTFChars(appFilesPathJstring, nullptr)};
-    auto logger{std::make_shared<skyline::Logger>(std::string(appFilesPath) + "skyline.log", static_cast<skyline::Logger::LogLevel>(std::stoi(settings->GetString("log_level"))))};
+    auto logger{std::make_shared<skyline::Logger>(std::string(appFilesPath) + "skyline.log", static_cast<skyline::Logger::LogLevel>(std::stoi(settings->GetString("log_level"))), settings->GetBool("log_logcat", true))};
     //settings->List(logger); // (Uncomment when you want to print out all settings strings)
 
     auto start{std::chrono::steady_clock::now()};
+    auto launchTimestamp{skyline::util::GetTimeNs()};
 
     try {
-        skyline::kernel::OS os(jvmManager, logger, settings, std::string(appFilesPath));
+        skyline::kernel::OS os(jvmManager, logger, settings, std::string(appFilesPath), std::move(benchmark));
         inputWeak = os.state.input;
+        nceWeak = os.state.nce;
+        audioWeak = os.state.audio;
+        statisticsWeak = os.state.statistics;
         jvmManager->InitializeControllers();
         env->ReleaseStringUTFChars(appFilesPathJstring, appFilesPath);
 
@@ -57,6 +76,8 @@ extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(
         logger->Info("Launching ROM {}", romUri);
         env->ReleaseStringUTFChars(romUriJstring, romUri);
 
+        Control.runState = skyline::RunState::Running;
+        os.state.statistics->boot.Record(skyline::BootPhase::Setup, launchTimestamp, skyline::util::GetTimeNs());
         os.Execute(romFd, static_cast<skyline::loader::RomFormat>(romType));
     } catch (std::exception &e) {
         logger->Error(e.what());
@@ -64,7 +85,12 @@ extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(
         logger->Error("An unknown exception has occurred");
     }
 
+    Control.runState = skyline::RunState::Stopped;
     inputWeak.reset();
+    nceWeak.reset();
+    audioWeak.reset();
+    statisticsWeak.reset();
+    skyline::allocation::SetEnabled(false);
 
     logger->Info("Emulation has ended");
 
@@ -74,10 +100,36 @@ extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(
     close(romFd);
 }
 
+extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeApplication(JNIEnv *env, jobject instance, jstring romUriJstring, jint romType, jint romFd, jint preferenceFd, jstring appFilesPathJstring) {
+    ExecuteApplication(env, instance, romUriJstring, romType, romFd, preferenceFd, appFilesPathJstring, nullptr);
+}
+
+/**
+ * @brief Runs an application headless without a surface or audio output until either limit is reached, a JSON report of its performance is written to "benchmark.json" in the app files directory
+ * @param frameCount The amount of frames to run for or 0 for no limit
+ * @param duration The duration to run for in seconds or 0 for no limit
+ * @param inputPathJstring The path of an input recording to replay during the run or an empty string for none
+ * @param gpuTracePathJstring The path of a GPFIFO trace to replay during the run or an empty string for none
+ */
+extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_executeBenchmark(JNIEnv *env, jobject instance, jstring romUriJstring, jint romType, jint romFd, jint preferenceFd, jstring appFilesPathJstring, jlong frameCount, jlong duration, jstring inputPathJstring, jstring gpuTracePathJstring) {
+    auto appFilesPath{env->GetStringUTFChars(appFilesPathJstring, nullptr)};
+    auto inputPath{env->GetStringUTFChars(inputPathJstring, nullptr)};
+    auto gpuTracePath{env->GetStringUTFChars(gpuTracePathJstring, nullptr)};
+    auto benchmark{std::make_shared<skyline::Benchmark>(static_cast<skyline::u64>(frameCount), static_cast<skyline::u64>(duration) * skyline::constant::NsInSecond, std::string(appFilesPath) + "benchmark.json", std::string(inputPath), std::string(gpuTracePath))};
+    env->ReleaseStringUTFChars(gpuTracePathJstring, gpuTracePath);
+    env->ReleaseStringUTFChars(inputPathJstring, inputPath);
+    env->ReleaseStringUTFChars(appFilesPathJstring, appFilesPath);
+
+    ExecuteApplication(env, instance, romUriJstring, romType, romFd, preferenceFd, appFilesPathJstring, std::move(benchmark));
+}
+
 extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_setHalt(JNIEnv *, jobject, jboolean halt) {
     JniMtx.lock(skyline::GroupMutex::Group::Group2);
     Halt = halt;
     JniMtx.unlock();
+
+    std::lock_guard guard(SurfaceMutex);
+    SurfaceCondition.notify_all(); // Threads which are paused while there's no surface need to exit promptly
 }
 
 extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_setSurface(JNIEnv *env, jobject, jobject surface) {
@@ -89,14 +141,142 @@ extern "C" JNIEXPORT void Java_emu_skyline_EmulationActivity_setSurface(JNIEnv *
     else
         Surface = surface;
     JniMtx.unlock();
+
+    std::lock_guard guard(SurfaceMutex);
+    SurfaceCondition.notify_all();
+}
+
+extern "C" JNIEXPORT jobject Java_emu_skyline_EmulationActivity_getControlBlock(JNIEnv *env, jobject) {
+    return env->NewDirectByteBuffer(&Control, sizeof(Control));
+}
+
+extern "C" JNIEXPORT jfloat Java_emu_skyline_EmulationActivity_getAudioLatency(JNIEnv *, jobject) {
+    auto audio{audioWeak.lock()};
+    return audio ? static_cast<float>(audio->GetStatistics().latency) : 0.0f;
+}
+
+extern "C" JNIEXPORT jint Java_emu_skyline_EmulationActivity_getAudioBufferSize(JNIEnv *, jobject) {
+    auto audio{audioWeak.lock()};
+    return audio ? audio->GetStatistics().bufferSize : 0;
+}
+
+extern "C" JNIEXPORT jint Java_emu_skyline_EmulationActivity_getAudioXRunCount(JNIEnv *, jobject) {
+    auto audio{audioWeak.lock()};
+    return audio ? audio->GetStatistics().xRunCount : 0;
+}
+
+extern "C" JNIEXPORT jlongArray Java_emu_skyline_EmulationActivity_getSvcProfile(JNIEnv *env, jobject) {
+    auto nce{nceWeak.lock()};
+    if (!nce)
+        return nullptr;
+
+    auto profile{nce->GetSvcProfile()};
+    auto array{env->NewLongArray(static_cast<jsize>(profile.size()))};
+    env->SetLongArrayRegion(array, 0, static_cast<jsize>(profile.size()), reinterpret_cast<jlong *>(profile.data()));
+    return array;
 }
 
-extern "C" JNIEXPORT jint Java_emu_skyline_EmulationActivity_getFps(JNIEnv *, jobject) {
-    return fps;
+/**
+ * @return A snapshot of the performance statistics of the application or null if it isn't running, the layout is:
+ * [0-3] The 50th, 95th and 99th percentile and the maximum of the recent frame times in microseconds
+ * [4-7] The same percentiles of the recent latencies from a frame being queued to it being posted in microseconds
+ * [8] The amount of pending GPFIFO entries, [9] SVCs per second, [10] IPC requests per second, [11] The amount of audio underruns
+ * [12] The total amount of texture data uploaded in bytes, [13-34] The amount of guest memory mapped for every MemoryType in bytes
+ * [35] The total amount of freed guest memory which has been released back to the host in bytes
+ * [36-79] The amount of host memory reserved and resident for the host mappings of every MemoryType in bytes, these are interleaved
+ * [80] The amount of host memory used by host copies of textures in bytes, [81] The amount of host memory used by audio tracks in bytes
+ * [82] The total amount of audio renderer voices which were culled to stay within the DSP budget, [83] The total amount of frames which were skipped
+ * [84-99] Allocations per second and bytes allocated per second for every allocation::Tag interleaved, these are 0 unless allocation profiling is enabled
+ * @note The rates are calculated over the time since the previous snapshot, they're 0 for the first snapshot
+ */
+extern "C" JNIEXPORT jlongArray Java_emu_skyline_EmulationActivity_getPerformanceStats(JNIEnv *env, jobject) {
+    auto statistics{statisticsWeak.lock()};
+    auto nce{nceWeak.lock()};
+    auto audio{audioWeak.lock()};
+    if (!statistics || !nce || !audio)
+        return nullptr;
+
+    skyline::u64 svcCount{};
+    auto profile{nce->GetSvcProfile()};
+    constexpr size_t SvcEntrySize{2 + skyline::NCE::SvcStatistics::BucketCount}; // Every SVC in the profile is its call count, its time and its buckets
+    for (size_t offset{}; offset < profile.size(); offset += SvcEntrySize)
+        svcCount += profile[offset];
+    auto ipcCount{statistics->ipcRequestCount.load(std::memory_order_relaxed)};
+
+    // The rates are calculated from the totals of the previous snapshot, this is only called from the UI thread so the previous values don't need to be synchronized
+    static skyline::u64 lastTimestamp{}, lastSvcCount{}, lastIpcCount{};
+    auto now{skyline::util::GetTimeNs()};
+    skyline::u64 svcRate{}, ipcRate{};
+    if (lastTimestamp && now > lastTimestamp && svcCount >= lastSvcCount && ipcCount >= lastIpcCount) {
+        svcRate = (svcCount - lastSvcCount) * skyline::constant::NsInSecond / (now - lastTimestamp);
+        ipcRate = (ipcCount - lastIpcCount) * skyline::constant::NsInSecond / (now - lastTimestamp);
+    }
+    auto allocations{skyline::allocation::GetCounters()};
+    static std::array<skyline::allocation::Counters, skyline::allocation::TagCount> lastAllocations{};
+    std::array<skyline::allocation::Counters, skyline::allocation::TagCount> allocationRates{};
+    if (lastTimestamp && now > lastTimestamp && skyline::allocation::IsEnabled()) {
+        for (size_t tag{}; tag < skyline::allocation::TagCount; tag++) {
+            // The counters are reset when profiling is enabled again, a snapshot across that is skipped rather than underflowing
+            if (allocations[tag].count >= lastAllocations[tag].count && allocations[tag].bytes >= lastAllocations[tag].bytes)
+                allocationRates[tag] = {(allocations[tag].count - lastAllocations[tag].count) * skyline::constant::NsInSecond / (now - lastTimestamp), (allocations[tag].bytes - lastAllocations[tag].bytes) * skyline::constant::NsInSecond / (now - lastTimestamp)};
+        }
+    }
+    lastAllocations = allocations;
+
+    lastTimestamp = now;
+    lastSvcCount = svcCount;
+    lastIpcCount = ipcCount;
+
+    auto frameTimes{statistics->frameTimes.GetPercentiles()};
+    auto presentLatency{statistics->presentLatency.GetPercentiles()};
+    std::vector<jlong> snapshot{
+        frameTimes.p50,
+        frameTimes.p95,
+        frameTimes.p99,
+        frameTimes.max,
+        presentLatency.p50,
+        presentLatency.p95,
+        presentLatency.p99,
+        presentLatency.max,
+        statistics->gpfifoQueueDepth.load(std::memory_order_relaxed),
+        static_cast<jlong>(svcRate),
+        static_cast<jlong>(ipcRate),
+        static_cast<jlong>(audio->GetStatistics().xRunCount),
+        static_cast<jlong>(statistics->textureUploadBytes.load(std::memory_order_relaxed)),
+    };
+    for (size_t type{}; type < skyline::PerformanceStatistics::MemoryTypeCount; type++)
+        snapshot.push_back(static_cast<jlong>(statistics->GetMemoryUsage(static_cast<skyline::kernel::memory::MemoryType>(type))));
+    snapshot.push_back(static_cast<jlong>(statistics->releasedBytes.load(std::memory_order_relaxed)));
+    for (const auto &usage : statistics->GetHostMemoryUsage()) {
+        snapshot.push_back(static_cast<jlong>(usage.reserved));
+        snapshot.push_back(static_cast<jlong>(usage.resident));
+    }
+    snapshot.push_back(static_cast<jlong>(statistics->textureHostBytes.load(std::memory_order_relaxed)));
+    snapshot.push_back(static_cast<jlong>(statistics->audioHostBytes.load(std::memory_order_relaxed)));
+    snapshot.push_back(static_cast<jlong>(statistics->culledVoices.load(std::memory_order_relaxed)));
+    snapshot.push_back(static_cast<jlong>(statistics->skippedFrames.load(std::memory_order_relaxed)));
+    for (const auto &rate : allocationRates) {
+        snapshot.push_back(static_cast<jlong>(rate.count));
+        snapshot.push_back(static_cast<jlong>(rate.bytes));
+    }
+
+    auto array{env->NewLongArray(static_cast<jsize>(snapshot.size()))};
+    env->SetLongArrayRegion(array, 0, static_cast<jsize>(snapshot.size()), snapshot.data());
+    return array;
 }
 
-extern "C" JNIEXPORT jfloat Java_emu_skyline_EmulationActivity_getFrametime(JNIEnv *, jobject) {
-    return static_cast<float>(frametime) / 100;
+/**
+ * @return The boot timeline of the application or null if it isn't running, the start of every BootPhase relative to the launch and its duration are interleaved in microseconds and both are -1 for phases which haven't happened yet
+ */
+extern "C" JNIEXPORT jlongArray Java_emu_skyline_EmulationActivity_getBootTimeline(JNIEnv *env, jobject) {
+    auto statistics{statisticsWeak.lock()};
+    if (!statistics)
+        return nullptr;
+
+    auto timeline{statistics->boot.GetTimeline()};
+    auto array{env->NewLongArray(static_cast<jsize>(timeline.size()))};
+    env->SetLongArrayRegion(array, 0, static_cast<jsize>(timeline.size()), reinterpret_cast<jlong *>(timeline.data()));
+    return array;
 }
 
 extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_setController(JNIEnv *, jobject, jint index, jint type, jint partnerIndex) {
@@ -109,25 +289,20 @@ extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_updateContr
     inputWeak.lock()->npad.Update();
 }
 
-extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_setButtonState(JNIEnv *, jobject, jint index, jlong mask, jboolean pressed) {
+extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_setControllerState(JNIEnv *, jobject, jint index, jlong buttons, jint leftX, jint leftY, jint rightX, jint rightY) {
     try {
         auto input{inputWeak.lock()};
-        auto device{input->npad.controllers[index].device};
-        if (device)
-            device->SetButtonState(skyline::input::NpadButton{.raw = static_cast<skyline::u64>(mask)}, pressed);
-    } catch (const std::bad_weak_ptr &) {
-        // We don't mind if we miss button updates while input hasn't been initialized
-    }
-}
+        if (input->IsReplaying())
+            return; // Host input would diverge from the recording
+
+        if (index < 0 || static_cast<size_t>(index) >= input->npad.controllers.size())
+            return;
 
-extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_setAxisValue(JNIEnv *, jobject, jint index, jint axis, jint value) {
-    try {
-        auto input{inputWeak.lock()};
         auto device{input->npad.controllers[index].device};
         if (device)
-            device->SetAxisValue(static_cast<skyline::input::NpadAxisId>(axis), value);
+            device->SetState(skyline::input::NpadButton{.raw = static_cast<skyline::u64>(buttons)}, leftX, leftY, rightX, rightY);
     } catch (const std::bad_weak_ptr &) {
-        // We don't mind if we miss axis updates while input hasn't been initialized
+        // We don't mind if we miss state updates while input hasn't been initialized
     }
 }
 
@@ -136,8 +311,10 @@ extern "C" JNIEXPORT void JNICALL Java_emu_skyline_EmulationActivity_setTouchSta
         using Point = skyline::input::TouchScreenPoint;
 
         auto input{inputWeak.lock()};
-        jboolean isCopy{false};
+        if (input->IsReplaying())
+            return;
 
+        jboolean isCopy{false};
         skyline::span<Point> points(reinterpret_cast<Point *>(env->GetIntArrayElements(pointsJni, &isCopy)), env->GetArrayLength(pointsJni) / (sizeof(Point) / sizeof(jint)));
         input->touch.SetState(points);
         env->ReleaseIntArrayElements(pointsJni, reinterpret_cast<jint *>(points.data()), JNI_ABORT);
@@ -8,39 +8,63 @@
 #include "skyline/loader/nso.h"
 #include "skyline/loader/nca.h"
 #include "skyline/loader/nsp.h"
+#include "skyline/loader/xci.h"
+#include "skyline/loader/metadata_cache.h"
 #include "skyline/jvm.h"
 
 extern "C" JNIEXPORT jint JNICALL Java_emu_skyline_loader_RomFile_populate(JNIEnv *env, jobject thiz, jint jformat, jint fd, jstring appFilesPathJstring) {
     skyline::loader::RomFormat format{static_cast<skyline::loader::RomFormat>(jformat)};
 
-    auto appFilesPath{env->GetStringUTFChars(appFilesPathJstring, nullptr)};
-    auto keyStore{std::make_shared<skyline::crypto::KeyStore>(appFilesPath)};
-    env->ReleaseStringUTFChars(appFilesPathJstring, appFilesPath);
-
-    std::unique_ptr<skyline::loader::Loader> loader;
-    try {
-        auto backing{std::make_shared<skyline::vfs::OsBacking>(fd)};
-
-        switch (format) {
-            case skyline::loader::RomFormat::NRO:
-                loader = std::make_unique<skyline::loader::NroLoader>(backing);
-                break;
-            case skyline::loader::RomFormat::NSO:
-                loader = std::make_unique<skyline::loader::NsoLoader>(backing);
-                break;
-            case skyline::loader::RomFormat::NCA:
-                loader = std::make_unique<skyline::loader::NcaLoader>(backing, keyStore);
-                break;
-            case skyline::loader::RomFormat::NSP:
-                loader = std::make_unique<skyline::loader::NspLoader>(backing, keyStore);
-                break;
-            default:
-                return static_cast<jint>(skyline::loader::LoaderResult::ParsingError);
+    auto appFilesPathChars{env->GetStringUTFChars(appFilesPathJstring, nullptr)};
+    std::string appFilesPath(appFilesPathChars);
+    env->ReleaseStringUTFChars(appFilesPathJstring, appFilesPathChars);
+
+    skyline::loader::MetadataCache cache(fd, appFilesPath);
+    auto metadata{cache.Load()};
+    if (!metadata) {
+        // The ROM is only parsed if its metadata isn't cached, this requires constructing the entire loader
+        auto keyStore{std::make_shared<skyline::crypto::KeyStore>(appFilesPath)};
+
+        std::unique_ptr<skyline::loader::Loader> loader;
+        try {
+            auto backing{std::make_shared<skyline::vfs::OsBacking>(fd)};
+
+            switch (format) {
+                case skyline::loader::RomFormat::NRO:
+                    loader = std::make_unique<skyline::loader::NroLoader>(backing);
+                    break;
+                case skyline::loader::RomFormat::NSO:
+                    loader = std::make_unique<skyline::loader::NsoLoader>(backing);
+                    break;
+                case skyline::loader::RomFormat::NCA:
+                    loader = std::make_unique<skyline::loader::NcaLoader>(backing, keyStore);
+                    break;
+                case skyline::loader::RomFormat::NSP:
+                case skyline::loader::RomFormat::NSZ:
+                    loader = std::make_unique<skyline::loader::NspLoader>(backing, keyStore);
+                    break;
+                case skyline::loader::RomFormat::XCI:
+                case skyline::loader::RomFormat::XCZ:
+                    loader = std::make_unique<skyline::loader::XciLoader>(backing, keyStore);
+                    break;
+                default:
+                    return static_cast<jint>(skyline::loader::LoaderResult::ParsingError);
+            }
+
+            metadata.emplace();
+            if (loader->nacp) {
+                metadata->hasNacp = true;
+                metadata->applicationName = loader->nacp->applicationName;
+                metadata->applicationPublisher = loader->nacp->applicationPublisher;
+                metadata->icon = loader->GetIcon();
+            }
+        } catch (const skyline::loader::loader_exception &e) {
+            return static_cast<jint>(e.error);
+        } catch (const std::exception &e) {
+            return static_cast<jint>(skyline::loader::LoaderResult::ParsingError);
         }
-    } catch (const skyline::loader::loader_exception &e) {
-        return static_cast<jint>(e.error);
-    } catch (const std::exception &e) {
-        return static_cast<jint>(skyline::loader::LoaderResult::ParsingError);
+
+        cache.Save(*metadata);
     }
 
     jclass clazz{env->GetObjectClass(thiz)};
@@ -48,11 +72,11 @@ extern "C" JNIEXPORT jint JNICALL Java_emu_skyline_loader_RomFile_populate(JNIEn
     jfieldID applicationAuthorField{env->GetFieldID(clazz, "applicationAuthor", "Ljava/lang/String;")};
     jfieldID rawIconField{env->GetFieldID(clazz, "rawIcon", "[B")};
 
-    if (loader->nacp) {
-        env->SetObjectField(thiz, applicationNameField, env->NewStringUTF(loader->nacp->applicationName.c_str()));
-        env->SetObjectField(thiz, applicationAuthorField, env->NewStringUTF(loader->nacp->applicationPublisher.c_str()));
+    if (metadata->hasNacp) {
+        env->SetObjectField(thiz, applicationNameField, env->NewStringUTF(metadata->applicationName.c_str()));
+        env->SetObjectField(thiz, applicationAuthorField, env->NewStringUTF(metadata->applicationPublisher.c_str()));
 
-        auto icon{loader->GetIcon()};
+        const auto &icon{metadata->icon};
         jbyteArray iconByteArray{env->NewByteArray(icon.size())};
         env->SetByteArrayRegion(iconByteArray, 0, icon.size(), reinterpret_cast<const jbyte *>(icon.data()));
         env->SetObjectField(thiz, rawIconField, iconByteArray);
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <new>
+#include "allocation.h"
+
+namespace skyline::allocation {
+    static std::atomic<bool> trackingEnabled{};
+    static std::array<std::atomic<u64>, TagCount> allocationCounts{};
+    static std::array<std::atomic<u64>, TagCount> allocationBytes{};
+    static thread_local Tag currentTag{Tag::Untagged}; //!< The tag of the innermost scope on the thread
+
+    void SetEnabled(bool enabled) {
+        if (enabled) {
+            for (size_t tag{}; tag < TagCount; tag++) {
+                allocationCounts[tag].store(0, std::memory_order_relaxed);
+                allocationBytes[tag].store(0, std::memory_order_relaxed);
+            }
+        }
+        trackingEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool IsEnabled() {
+        return trackingEnabled.load(std::memory_order_relaxed);
+    }
+
+    std::array<Counters, TagCount> GetCounters() {
+        std::array<Counters, TagCount> counters;
+        for (size_t tag{}; tag < TagCount; tag++)
+            counters[tag] = {allocationCounts[tag].load(std::memory_order_relaxed), allocationBytes[tag].load(std::memory_order_relaxed)};
+        return counters;
+    }
+
+    Scope::Scope(Tag tag) : previous(currentTag) {
+        currentTag = tag;
+    }
+
+    Scope::~Scope() {
+        currentTag = previous;
+    }
+
+    /**
+     * @brief Attributes an allocation to the tag of the calling thread, if tracking is enabled
+     */
+    static inline void Track(size_t size) {
+        if (__predict_true(!trackingEnabled.load(std::memory_order_relaxed)))
+            return;
+
+        auto tag{static_cast<size_t>(currentTag)};
+        allocationCounts[tag].fetch_add(1, std::memory_order_relaxed);
+        allocationBytes[tag].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void *Allocate(size_t size) {
+        Track(size);
+        // A zero-sized allocation has to return a unique pointer, malloc doesn't guarantee that
+        while (true) {
+            if (auto pointer{std::malloc(size ? size : 1)})
+                return pointer;
+            if (auto handler{std::get_new_handler()})
+                handler();
+            else
+                throw std::bad_alloc();
+        }
+    }
+
+    static void *AllocateAligned(size_t size, std::align_val_t alignment) {
+        Track(size);
+        auto align{std::max(static_cast<size_t>(alignment), sizeof(void *))};
+        while (true) {
+            void *pointer{};
+            if (!posix_memalign(&pointer, align, size ? size : 1))
+                return pointer;
+            if (auto handler{std::get_new_handler()})
+                handler();
+            else
+                throw std::bad_alloc();
+        }
+    }
+}
+
+// The global allocation functions are replaced so every allocation through operator new can be attributed, they're otherwise equivalent to the default ones
+void *operator new(size_t size) {
+    return skyline::allocation::Allocate(size);
+}
+
+void *operator new[](size_t size) {
+    return skyline::allocation::Allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return skyline::allocation::Allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return skyline::allocation::Allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return skyline::allocation::AllocateAligned(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return skyline::allocation::AllocateAligned(size, alignment);
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
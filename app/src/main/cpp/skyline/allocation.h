@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline::allocation {
+    /**
+     * @brief The subsystems allocations are attributed to, a nested scope takes precedence over the one it's in
+     */
+    enum class Tag : u8 {
+        Untagged, //!< Any allocation outside of a tagged scope
+        Svc, //!< Allocations made while servicing an SVC outside of IPC
+        Ipc, //!< Allocations made while handling an IPC request
+        Gpfifo, //!< Allocations made on the GPFIFO thread, this includes recording commands into the GraphicsContext
+        Presentation, //!< Allocations made while presenting frames
+        Audio, //!< Allocations made by the audio renderer and the audio output
+        Input, //!< Allocations made by the HID sampling thread
+        Loader, //!< Allocations made while loading the ROM
+    };
+
+    constexpr size_t TagCount{static_cast<size_t>(Tag::Loader) + 1};
+
+    /**
+     * @brief The total allocations attributed to a tag
+     */
+    struct Counters {
+        u64 count; //!< The amount of allocations
+        u64 bytes; //!< The amount of bytes that were allocated
+    };
+
+    /**
+     * @brief Enables or disables tracking heap allocations made through operator new, every allocation is attributed to the tag of the scope it's made in
+     * @note The counters are reset when it's enabled, the only cost while it's disabled is checking if it's enabled which is a single relaxed load
+     */
+    void SetEnabled(bool enabled);
+
+    bool IsEnabled();
+
+    /**
+     * @return The counters of every tag since tracking was enabled
+     */
+    std::array<Counters, TagCount> GetCounters();
+
+    /**
+     * @brief Attributes all allocations on the calling thread to a tag for the lifetime of this object, the previous tag is restored afterwards
+     */
+    class Scope {
+      private:
+        Tag previous; //!< The tag of the enclosing scope
+
+      public:
+        explicit Scope(Tag tag);
+
+        Scope(const Scope &) = delete;
+
+        ~Scope();
+    };
+}
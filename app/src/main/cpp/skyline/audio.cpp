@@ -1,26 +1,104 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <unistd.h>
+#include "os.h"
+#include "trace.h"
+#include "statistics.h"
+#include "allocation.h"
+#include "benchmark.h"
 #include "audio.h"
 
 namespace skyline::audio {
-    Audio::Audio(const DeviceState &state) : oboe::AudioStreamCallback() {
+    Audio::Audio(const DeviceState &state) : oboe::AudioStreamCallback(), state(state), audioTracks(new TrackList()) {
         builder.setChannelCount(constant::ChannelCount);
         builder.setSampleRate(constant::SampleRate);
         builder.setFormat(constant::PcmFormat);
-        builder.setFramesPerCallback(constant::MixBufferSize);
         builder.setUsage(oboe::Usage::Game);
+        builder.setPerformanceMode(oboe::PerformanceMode::LowLatency);
+        builder.setSharingMode(oboe::SharingMode::Exclusive); // Oboe falls back to a shared stream if the device doesn't support exclusive streams
         builder.setCallback(this);
 
+        if (state.settings->GetBool("audio_time_stretch", false))
+            timeStretcher.emplace();
+        ApplySettings();
+
+        if (state.benchmark) {
+            nullSinkRunning = true;
+            nullSinkThread = std::thread(&Audio::NullSinkThread, this);
+        } else {
+            OpenStream();
+        }
+    }
+
+    void Audio::OpenStream() {
         builder.openManagedStream(outputStream);
+        // The size of the callback isn't fixed as that requires an additional buffer which adds latency, the buffer is instead grown from its minimum size until it stops underrunning
+        latencyTuner = std::make_unique<oboe::LatencyTuner>(*outputStream);
+        tunedMinimumBufferSize = 0;
         outputStream->requestStart();
+
+        state.logger->Info("Opened audio stream: {} sharing, {} frames per burst, {} frame capacity", outputStream->getSharingMode() == oboe::SharingMode::Exclusive ? "Exclusive" : "Shared", outputStream->getFramesPerBurst(), outputStream->getBufferCapacityInFrames());
+    }
+
+    void Audio::ApplySettings() {
+        minimumBufferSize = static_cast<i32>(std::clamp(state.settings->GetStringInt("audio_latency", 0), 0, 1000) * constant::SampleRate / 1000);
+    }
+
+    void Audio::NullSinkThread() {
+        pthread_setname_np(pthread_self(), "Sky-NullAudio");
+        allocation::Scope allocationScope(allocation::Tag::Audio);
+
+        // Samples are consumed at the rate the output stream would consume them at, so guests that pace themselves to audio run at the same speed
+        constexpr std::chrono::milliseconds Period{5};
+        std::vector<i16> buffer;
+        auto lastTime{std::chrono::steady_clock::now()};
+        while (nullSinkRunning) {
+            std::this_thread::sleep_for(Period);
+            auto now{std::chrono::steady_clock::now()};
+            auto frames{static_cast<size_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastTime).count()) * constant::SampleRate / 1000000};
+            if (!frames)
+                continue;
+            lastTime += std::chrono::microseconds(frames * 1000000 / constant::SampleRate); // The remainder which doesn't add up to a whole frame is carried over
+
+            buffer.resize(frames * constant::ChannelCount);
+            std::fill(buffer.begin(), buffer.end(), 0);
+            Render(buffer);
+        }
+    }
+
+    Audio::~Audio() {
+        if (nullSinkThread.joinable()) {
+            nullSinkRunning = false;
+            nullSinkThread.join();
+        } else {
+            outputStream->close();
+        }
+        delete audioTracks.load(); // The stream is stopped, so all retired snapshots are freed alongside retiredTracks
+    }
+
+    void Audio::UpdateTracks(const std::function<void(TrackList &)> &modify) {
+        auto tracks{new TrackList(*audioTracks.load())};
+        modify(*tracks);
+        std::unique_ptr<const TrackList> previousTracks{audioTracks.exchange(tracks)};
+
+        // The callback sets callbackActive prior to loading the snapshot and increments callbackEpoch after clearing it, so if it's active then the snapshot is only freed after that callback has incremented the epoch read prior to it
+        auto epoch{callbackEpoch.load()};
+        if (callbackActive.load())
+            retiredTracks.push_back({std::move(previousTracks), epoch});
+
+        epoch = callbackEpoch.load();
+        std::erase_if(retiredTracks, [epoch](const RetiredTracks &retired) { return retired.epoch < epoch; });
     }
 
     std::shared_ptr<AudioTrack> Audio::OpenTrack(u8 channelCount, u32 sampleRate, const std::function<void()> &releaseCallback) {
         std::lock_guard trackGuard(trackLock);
 
         auto track{std::make_shared<AudioTrack>(channelCount, sampleRate, releaseCallback)};
-        audioTracks.push_back(track);
+        state.statistics->audioHostBytes.fetch_add(sizeof(AudioTrack), std::memory_order_relaxed); // The sample buffer is inline in the track, so it's the bulk of its size
+        UpdateTracks([&track](TrackList &tracks) {
+            tracks.push_back(track);
+        });
 
         return track;
     }
@@ -28,45 +106,90 @@ namespace skyline::audio {
     void Audio::CloseTrack(std::shared_ptr<AudioTrack> &track) {
         std::lock_guard trackGuard(trackLock);
 
-        audioTracks.erase(std::remove(audioTracks.begin(), audioTracks.end(), track), audioTracks.end());
+        UpdateTracks([&track](TrackList &tracks) {
+            tracks.erase(std::remove(tracks.begin(), tracks.end(), track), tracks.end());
+        });
+        if (track)
+            state.statistics->audioHostBytes.fetch_sub(sizeof(AudioTrack), std::memory_order_relaxed);
         track.reset();
     }
 
-    oboe::DataCallbackResult Audio::onAudioReady(oboe::AudioStream *audioStream, void *audioData, int32_t numFrames) {
-        auto destBuffer{static_cast<i16 *>(audioData)};
-        auto streamSamples{static_cast<size_t>(numFrames) * audioStream->getChannelCount()};
+    size_t Audio::MixTracks(const TrackList &tracks, span<i16> buffer) {
         size_t writtenSamples{};
+        for (auto &track : tracks) {
+            if (track->playbackState == AudioOutState::Stopped)
+                continue;
 
-        {
-            std::lock_guard trackGuard(trackLock);
+            auto trackSamples{track->samples.Read(buffer, [](i16 *source, i16 *destination) {
+                *destination = Saturate<i16, i32>(static_cast<u32>(*destination) + static_cast<u32>(*source));
+            }, writtenSamples)};
 
-            for (auto &track : audioTracks) {
-                if (track->playbackState == AudioOutState::Stopped)
-                    continue;
+            writtenSamples = std::max(trackSamples, writtenSamples);
 
-                std::lock_guard bufferGuard(track->bufferLock);
+            track->CheckReleasedBuffers();
+        }
+        return writtenSamples;
+    }
 
-                auto trackSamples{track->samples.Read(span(destBuffer, streamSamples), [](i16 *source, i16 *destination) {
-                    *destination = Saturate<i16, i32>(static_cast<u32>(*destination) + static_cast<u32>(*source));
-                }, writtenSamples)};
+    size_t Audio::Render(span<i16> output) {
+        size_t writtenSamples{};
+        callbackActive = true;
+        auto &tracks{*audioTracks.load()};
+        if (timeStretcher) {
+            size_t fillSamples{};
+            for (auto &track : tracks)
+                if (track->playbackState != AudioOutState::Stopped)
+                    fillSamples = std::max<size_t>(fillSamples, track->samples.GetWritePosition() - track->samples.GetReadPosition());
+            timeStretcher->UpdateTempo(fillSamples / constant::ChannelCount);
+            trace::SetCounter("Audio Tempo", static_cast<i64>(timeStretcher->GetTempo() * 100.0f));
+
+            writtenSamples = timeStretcher->Process(output, [&tracks](span<i16> buffer) {
+                return MixTracks(tracks, buffer);
+            });
+        } else {
+            writtenSamples = MixTracks(tracks, output);
+        }
+        callbackActive = false;
+        callbackEpoch++;
+        return writtenSamples;
+    }
 
-                writtenSamples = std::max(trackSamples, writtenSamples);
+    oboe::DataCallbackResult Audio::onAudioReady(oboe::AudioStream *audioStream, void *audioData, int32_t numFrames) {
+        TRACE_SCOPE("Audio::onAudioReady");
+        allocation::Scope allocationScope(allocation::Tag::Audio);
+        auto destBuffer{static_cast<i16 *>(audioData)};
+        auto streamSamples{static_cast<size_t>(numFrames) * audioStream->getChannelCount()};
 
-                track->sampleCounter += trackSamples;
-                track->CheckReleasedBuffers();
-            }
+        if (auto tid{gettid()}; tid != callbackTid) {
+            // Oboe may recreate the callback thread when the stream is restarted so the affinity is applied on any new thread
+            callbackTid = tid;
+            state.os->affinity.SetHostAffinity(kernel::AffinityManager::HostThread::Audio);
+            state.os->performanceHint.SetThread(kernel::PerformanceHintManager::HintThread::Audio, tid);
         }
 
+        auto writtenSamples{Render(span(destBuffer, streamSamples))};
+
+        trace::SetCounter("Audio Underrun Samples", static_cast<i64>(streamSamples - std::min(writtenSamples, streamSamples)));
         if (streamSamples > writtenSamples)
             memset(destBuffer + writtenSamples, 0, (streamSamples - writtenSamples) * sizeof(i16));
 
+        if (auto minimum{minimumBufferSize.load(std::memory_order_relaxed)}; minimum != tunedMinimumBufferSize) {
+            latencyTuner->setMinimumBufferSize(minimum ? minimum : audioStream->getFramesPerBurst());
+            latencyTuner->requestReset(); // The buffer is only shrunk to the minimum when the tuner is reset
+            tunedMinimumBufferSize = minimum;
+        }
+        latencyTuner->tune();
+        if (auto xRuns{audioStream->getXRunCount()})
+            xRunCount.store(xRuns.value(), std::memory_order_relaxed);
+        bufferSize.store(audioStream->getBufferSizeInFrames(), std::memory_order_relaxed);
+        if (auto streamLatency{audioStream->calculateLatencyMillis()})
+            latency.store(streamLatency.value(), std::memory_order_relaxed);
+
         return oboe::DataCallbackResult::Continue;
     }
 
     void Audio::onErrorAfterClose(oboe::AudioStream *audioStream, oboe::Result error) {
-        if (error == oboe::Result::ErrorDisconnected) {
-            builder.openManagedStream(outputStream);
-            outputStream->requestStart();
-        }
+        if (error == oboe::Result::ErrorDisconnected)
+            OpenStream();
     }
 }
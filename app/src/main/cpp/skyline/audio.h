@@ -4,6 +4,7 @@
 #pragma once
 
 #include <audio/track.h>
+#include <audio/time_stretcher.h>
 
 namespace skyline::audio {
     /**
@@ -11,14 +12,84 @@ namespace skyline::audio {
      */
     class Audio : public oboe::AudioStreamCallback {
       private:
+        const DeviceState &state;
         oboe::AudioStreamBuilder builder;
         oboe::ManagedStream outputStream;
-        std::vector<std::shared_ptr<AudioTrack>> audioTracks;
-        Mutex trackLock; //!< Synchronizes modifications to the audio tracks
+        std::unique_ptr<oboe::LatencyTuner> latencyTuner; //!< Grows the buffer of outputStream from its minimum size whenever it underruns, this is recreated alongside the stream
+        using TrackList = std::vector<std::shared_ptr<AudioTrack>>;
+        std::atomic<const TrackList *> audioTracks; //!< An immutable snapshot of all open tracks, it's replaced rather than modified so the audio callback can read it without locking
+        std::atomic<bool> callbackActive{}; //!< If the audio callback might be reading a snapshot of audioTracks
+        std::atomic<u64> callbackEpoch{}; //!< The amount of times the audio callback has finished reading a snapshot of audioTracks
+
+        /**
+         * @brief A snapshot of audioTracks which was replaced while the audio callback might have been reading it
+         */
+        struct RetiredTracks {
+            std::unique_ptr<const TrackList> tracks;
+            u64 epoch; //!< The value of callbackEpoch when the snapshot was replaced, it can be freed once callbackEpoch is past this
+        };
+
+        Mutex trackLock; //!< Synchronizes replacing audioTracks and access to retiredTracks, this is never locked by the audio callback
+        std::vector<RetiredTracks> retiredTracks; //!< The replaced snapshots which are yet to be freed, they're reclaimed by subsequent updates rather than waiting on the audio callback
+        pid_t callbackTid{}; //!< The TID of the thread the audio callback was last called on
+        std::atomic<i32> xRunCount{}; //!< The amount of underruns of the current stream, this is updated by the audio callback
+        std::atomic<i32> bufferSize{}; //!< The size of the buffer of the current stream in frames, this is updated by the audio callback
+        std::atomic<double> latency{}; //!< The latency of the current stream in milliseconds, this is updated by the audio callback
+        std::atomic<i32> minimumBufferSize{}; //!< The size in frames which the latency tuner doesn't shrink the buffer below, this is controlled by the "audio_latency" setting and is 0 to let the tuner start from a single burst
+        i32 tunedMinimumBufferSize{}; //!< The value of minimumBufferSize which was last applied to latencyTuner, this is only used by the audio callback
+        std::optional<TimeStretcher> timeStretcher; //!< Slows down playback when the tracks run low on samples, this is only used by the audio callback
+        std::thread nullSinkThread; //!< The thread which consumes samples in place of the output stream during headless benchmarks
+        std::atomic<bool> nullSinkRunning{}; //!< If nullSinkThread should keep running
+
+        /**
+         * @brief Opens and starts outputStream with a new latency tuner for it
+         */
+        void OpenStream();
+
+        /**
+         * @brief Consumes the samples of all tracks in real time and discards them, this stands in for the output stream when there's no audio output
+         */
+        void NullSinkThread();
+
+        /**
+         * @brief Mixes the samples of all playing tracks into the output and time stretches them if enabled, this is the part of the audio callback which doesn't depend on the output stream
+         * @return The amount of samples written into the output
+         */
+        size_t Render(span<i16> output);
+
+        /**
+         * @brief Replaces the snapshot of all open tracks with a modified copy of it, the previous snapshot is retired until the audio callback can't be reading it
+         * @note This never waits on the audio callback, any retired snapshots which it's done with are freed instead
+         * @param modify A function that modifies the copy of the current snapshot
+         * @note trackLock MUST be locked when calling this
+         */
+        void UpdateTracks(const std::function<void(TrackList &)> &modify);
+
+        /**
+         * @brief Mixes the samples of all playing tracks into the supplied buffer
+         * @return The amount of samples written into the buffer
+         */
+        static size_t MixTracks(const TrackList &tracks, span<i16> buffer);
 
       public:
+        /**
+         * @brief A snapshot of the statistics of the output stream
+         */
+        struct Statistics {
+            i32 xRunCount; //!< The amount of underruns since the stream was opened
+            i32 bufferSize; //!< The size of the stream buffer in frames
+            double latency; //!< The estimated output latency in milliseconds
+        };
+
         Audio(const DeviceState &state);
 
+        ~Audio();
+
+        /**
+         * @brief Reads the "audio_latency" setting again, it's applied to the output stream by the next audio callback
+         */
+        void ApplySettings();
+
         /**
          * @brief Opens a new track that can be used to play sound
          * @param channelCount The amount channels that are present in the track
@@ -34,7 +105,14 @@ namespace skyline::audio {
         void CloseTrack(std::shared_ptr<AudioTrack> &track);
 
         /**
-         * @brief The callback oboe uses to get audio sample data
+         * @return The statistics of the output stream as of the last audio callback
+         */
+        inline Statistics GetStatistics() {
+            return {xRunCount, bufferSize, latency};
+        }
+
+        /**
+         * @brief The callback oboe uses to get audio sample data, this doesn't lock anything as it runs on a real-time thread
          * @param audioStream The audio stream we are being called by
          * @param audioData The raw audio sample data
          * @param numFrames The amount of frames the sample data needs to contain
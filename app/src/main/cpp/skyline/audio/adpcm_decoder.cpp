@@ -7,18 +7,19 @@
 namespace skyline::audio {
     AdpcmDecoder::AdpcmDecoder(const std::vector<std::array<i16, 2>> &coefficients) : coefficients(coefficients) {}
 
-    std::vector<i16> AdpcmDecoder::Decode(span<u8> adpcmData) {
-        constexpr size_t BytesPerFrame{0x8};
-        constexpr size_t SamplesPerFrame{0xE};
+    constexpr size_t BytesPerFrame{0x8};
+    constexpr size_t SamplesPerFrame{0xE};
 
-        size_t remainingSamples{(adpcmData.size() / BytesPerFrame) * SamplesPerFrame};
+    size_t AdpcmDecoder::GetMaxOutputSize(size_t adpcmSize) {
+        return (adpcmSize / BytesPerFrame) * SamplesPerFrame;
+    }
 
-        std::vector<i16> output;
-        output.reserve(remainingSamples);
+    size_t AdpcmDecoder::Decode(span<u8> adpcmData, span<i16> output, u8 channelCount) {
+        size_t remainingSamples{std::min(GetMaxOutputSize(adpcmData.size()), output.size() / channelCount)};
 
-        size_t inputOffset{};
+        size_t inputOffset{}, outputOffset{};
 
-        while (inputOffset < adpcmData.size()) {
+        while (inputOffset < adpcmData.size() && remainingSamples) {
             FrameHeader header{adpcmData[inputOffset++]};
 
             size_t frameSamples{std::min(SamplesPerFrame, remainingSamples)};
@@ -39,7 +40,8 @@ namespace skyline::audio {
                 sample = (sample * (0x800 << header.scale) + prediction + 0x400) >> 11;
 
                 auto saturated{audio::Saturate<i16, i32>(sample)};
-                output.push_back(saturated);
+                for (u8 channel{}; channel < channelCount; channel++)
+                    output[outputOffset++] = saturated;
                 history[1] = history[0];
                 history[0] = saturated;
             }
@@ -47,6 +49,6 @@ namespace skyline::audio {
             remainingSamples -= frameSamples;
         }
 
-        return output;
+        return outputOffset;
     }
 }
@@ -28,9 +28,17 @@ namespace skyline::audio {
       public:
         AdpcmDecoder(const std::vector<std::array<i16, 2>> &coefficients);
 
+        /**
+         * @return The maximum amount of samples that decoding the supplied amount of ADPCM data results in
+         */
+        static size_t GetMaxOutputSize(size_t adpcmSize);
+
         /**
          * @brief Decodes a buffer of ADPCM data into I16 PCM
+         * @param output The buffer to decode into, it should be at least GetMaxOutputSize() * channelCount samples large
+         * @param channelCount The amount of channels to write every decoded sample into, this allows expanding the output to interleaved stereo without another pass
+         * @return The amount of samples written into output
          */
-        std::vector<i16> Decode(span<u8> adpcmData);
+        size_t Decode(span<u8> adpcmData, span<i16> output, u8 channelCount = 1);
     };
 }
@@ -7,139 +7,91 @@
 
 namespace skyline::audio {
     /**
-     * @brief An abstraction of an array into a circular buffer
+     * @brief An abstraction of an array into a wait-free single-producer single-consumer circular buffer
      * @tparam Type The type of elements stored in the buffer
      * @tparam Size The maximum size of the circular buffer
+     * @note Only a single thread may append to the buffer and only a single thread may read from it at any time, they can be different threads
      * @url https://en.wikipedia.org/wiki/Circular_buffer
      */
     template<typename Type, size_t Size>
     class CircularBuffer {
       private:
         std::array<Type, Size> array{}; //!< The internal array holding the circular buffer
-        Type *start{array.begin()}; //!< The start/oldest element of the internal array
-        Type *end{array.begin()}; //!< The end/newest element of the internal array
-        bool empty{true}; //!< If the buffer is full or empty, as start == end can mean either
-        Mutex mtx; //!< Synchronizes buffer operations so they don't overlap
+        std::atomic<u64> readPosition{}; //!< The total amount of elements that have been read from the buffer, this is only written to by the consumer
+        std::atomic<u64> writePosition{}; //!< The total amount of elements that have been appended to the buffer, this is only written to by the producer
+
+        /**
+         * @brief Calls the supplied function with every contiguous region of the internal array that the elements from the supplied position onwards are in
+         */
+        template<typename Function>
+        inline void ForEachRegion(u64 position, size_t count, Function function) {
+            while (count) {
+                size_t offset{position % Size};
+                size_t size{std::min(count, Size - offset)};
+                function(array.data() + offset, size);
+
+                position += size;
+                count -= size;
+            }
+        }
 
       public:
         /**
          * @brief Reads data from this buffer into the specified buffer
-         * @param address The address to write buffer data into
-         * @param maxSize The maximum amount of data to write in units of Type
+         * @param buffer The buffer to write data into, up to its size in units of Type is read
          * @param copyFunction If this is specified, then this is called rather than memcpy
+         * @param copyOffset The amount of elements that copyFunction is called for, the rest are copied with memcpy, all elements use copyFunction if this is -1
          * @return The amount of data written into the input buffer in units of Type
          */
         inline size_t Read(span<Type> buffer, void copyFunction(Type *, Type *) = {}, ssize_t copyOffset = -1) {
-            std::lock_guard guard(mtx);
-
-            if (empty)
-                return 0;
-
-            Type* pointer{buffer.data()};
-            ssize_t maxSize{static_cast<ssize_t>(buffer.size())}, size{}, sizeBegin{}, sizeEnd{};
-
-            if (start < end) {
-                sizeEnd = std::min(end - start, maxSize);
-
-                size = sizeEnd;
-            } else {
-                sizeEnd = std::min(array.end() - start, maxSize);
-                sizeBegin = std::min(end - array.begin(), maxSize - sizeEnd);
-
-                size = sizeBegin + sizeEnd;
-            }
-
-            if (copyFunction && copyOffset) {
-                auto sourceEnd{start + ((copyOffset != -1) ? copyOffset : sizeEnd)};
-
-                for (auto source{start}, destination{pointer}; source < sourceEnd; source++, destination++)
-                    copyFunction(source, destination);
-
-                if (copyOffset != -1) {
-                    std::memcpy(pointer + copyOffset, start + copyOffset, (sizeEnd - copyOffset) * sizeof(Type));
-                    copyOffset -= sizeEnd;
-                }
-            } else {
-                std::memcpy(pointer, start, sizeEnd * sizeof(Type));
-            }
-
-            pointer += sizeEnd;
-
-            if (sizeBegin) {
-                if (copyFunction && copyOffset) {
-                    auto sourceEnd{array.begin() + ((copyOffset != -1) ? copyOffset : sizeBegin)};
-
-                    for (auto source{array.begin()}, destination{pointer}; source < sourceEnd; source++, destination++)
-                        copyFunction(source, destination);
-
-                    if (copyOffset != -1)
-                        std::memcpy(array.begin() + copyOffset, pointer + copyOffset, (sizeBegin - copyOffset) * sizeof(Type));
-                } else {
-                    std::memcpy(pointer, array.begin(), sizeBegin * sizeof(Type));
-                }
-
-                start = array.begin() + sizeBegin;
-            } else {
-                start += sizeEnd;
-            }
-
-            if (start == end)
-                empty = true;
-
-            return static_cast<size_t>(size);
+            auto position{readPosition.load(std::memory_order_relaxed)};
+            auto size{static_cast<size_t>(std::min<u64>(writePosition.load(std::memory_order_acquire) - position, buffer.size()))};
+            size_t functionSize{copyFunction ? ((copyOffset == -1) ? size : std::min(static_cast<size_t>(copyOffset), size)) : 0};
+
+            Type *pointer{buffer.data()};
+            ForEachRegion(position, functionSize, [&](Type *source, size_t regionSize) {
+                for (auto sourceEnd{source + regionSize}; source < sourceEnd; source++, pointer++)
+                    copyFunction(source, pointer);
+            });
+            ForEachRegion(position + functionSize, size - functionSize, [&](Type *source, size_t regionSize) {
+                std::memcpy(pointer, source, regionSize * sizeof(Type));
+                pointer += regionSize;
+            });
+
+            readPosition.store(position + size, std::memory_order_release); // The producer can only reuse the elements after they've been read
+            return size;
         }
 
         /**
-         * @brief Appends data from the specified buffer into this buffer
+         * @brief Appends data from the specified buffer into this buffer, any data which doesn't fit into the free space of the buffer is dropped
+         * @return The write position after the data has been appended, the data has been read once the read position reaches this
          */
-        inline void Append(span<Type> buffer) {
-            std::lock_guard guard(mtx);
-
-            Type* pointer{buffer.data()};
-            ssize_t size{static_cast<ssize_t>(buffer.size())};
-            while (size) {
-                if (start <= end && end != array.end()) {
-                    auto sizeEnd{std::min(array.end() - end, size)};
-                    std::memcpy(end, pointer, sizeEnd * sizeof(Type));
-
-                    pointer += sizeEnd;
-                    size -= sizeEnd;
-
-                    end += sizeEnd;
-                } else {
-                    auto sizePreStart{(end == array.end()) ? std::min(start - array.begin(), size) : std::min(start - end, size)};
-                    auto sizePostStart{std::min(array.end() - start, size - sizePreStart)};
-
-                    if (sizePreStart)
-                        std::memcpy((end == array.end()) ? array.begin() : end, pointer, sizePreStart * sizeof(Type));
-
-                    if (end == array.end())
-                        end = array.begin() + sizePreStart;
-                    else
-                        end += sizePreStart;
-
-                    pointer += sizePreStart;
-                    size -= sizePreStart;
-
-                    if (sizePostStart)
-                        std::memcpy(end, pointer, sizePostStart * sizeof(Type));
-
-                    if (start == array.end())
-                        start = array.begin() + sizePostStart;
-                    else
-                        start += sizePostStart;
-
-                    if (end == array.end())
-                        end = array.begin() + sizePostStart;
-                    else
-                        end += sizePostStart;
+        inline u64 Append(span<Type> buffer) {
+            auto position{writePosition.load(std::memory_order_relaxed)};
+            auto size{static_cast<size_t>(std::min<u64>(Size - (position - readPosition.load(std::memory_order_acquire)), buffer.size()))};
+
+            Type *pointer{buffer.data()};
+            ForEachRegion(position, size, [&](Type *destination, size_t regionSize) {
+                std::memcpy(destination, pointer, regionSize * sizeof(Type));
+                pointer += regionSize;
+            });
+
+            writePosition.store(position + size, std::memory_order_release);
+            return position + size;
+        }
 
-                    pointer += sizePostStart;
-                    size -= sizePostStart;
-                }
+        /**
+         * @return The total amount of elements that have been read from the buffer
+         */
+        inline u64 GetReadPosition() {
+            return readPosition.load(std::memory_order_acquire);
+        }
 
-                empty = false;
-            }
+        /**
+         * @return The total amount of elements that have been appended to the buffer
+         */
+        inline u64 GetWritePosition() {
+            return writePosition.load(std::memory_order_acquire);
         }
     };
 }
@@ -33,8 +33,7 @@ namespace skyline {
 
         struct BufferIdentifier {
             u64 tag;
-            u64 finalSample; //!< The final sample this buffer will be played in, after that the buffer can be safely released
-            bool released; //!< If the buffer has been released (fully played back)
+            u64 finalSample; //!< The read position of the track's samples after which this buffer has been fully played back and is released
         };
 
         /**
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <arm_neon.h>
+#include "common.h"
+#include "downmix.h"
+
+namespace skyline::audio {
+    void DownmixSurroundToStereo(span<const i16> input, span<i16> output, const DownmixCoefficients &coefficients) {
+        size_t frameCount{input.size() / constant::SurroundChannelCount};
+        if (output.size() < frameCount * constant::ChannelCount)
+            throw exception("Downmix output is too small: 0x{:X} (Frames: 0x{:X})", output.size(), frameCount);
+
+        // Every frame is read as three pairs of channels, the front and back pairs are already in the layout of a stereo frame so only the center pair needs to be summed and duplicated
+        float32x4_t centerWeights{coefficients.center, coefficients.lowFrequency, coefficients.center, coefficients.lowFrequency};
+        auto source{input.data()};
+        auto destination{output.data()};
+        size_t frame{};
+        for (; frame + 4 <= frameCount; frame += 4) {
+            auto pairs{vld3q_s32(reinterpret_cast<const i32 *>(source + frame * constant::SurroundChannelCount))};
+            auto front{vreinterpretq_s16_s32(pairs.val[0])};
+            auto center{vreinterpretq_s16_s32(pairs.val[1])};
+            auto back{vreinterpretq_s16_s32(pairs.val[2])};
+
+            auto centerSums{vpaddq_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(center))), centerWeights), vmulq_f32(vcvtq_f32_s32(vmovl_high_s16(center)), centerWeights))};
+            auto centerFrames{vzipq_f32(centerSums, centerSums)};
+
+            auto low{vmlaq_n_f32(vmlaq_n_f32(centerFrames.val[0], vcvtq_f32_s32(vmovl_s16(vget_low_s16(front))), coefficients.front), vcvtq_f32_s32(vmovl_s16(vget_low_s16(back))), coefficients.back)};
+            auto high{vmlaq_n_f32(vmlaq_n_f32(centerFrames.val[1], vcvtq_f32_s32(vmovl_high_s16(front)), coefficients.front), vcvtq_f32_s32(vmovl_high_s16(back)), coefficients.back)};
+            vst1q_s16(destination + frame * constant::ChannelCount, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(low)), vqmovn_s32(vcvtq_s32_f32(high))));
+        }
+
+        for (; frame < frameCount; frame++) {
+            auto samples{source + frame * constant::SurroundChannelCount};
+            float center{samples[2] * coefficients.center + samples[3] * coefficients.lowFrequency};
+            destination[frame * constant::ChannelCount] = Saturate<i16, i32>(samples[0] * coefficients.front + center + samples[4] * coefficients.back);
+            destination[frame * constant::ChannelCount + 1] = Saturate<i16, i32>(samples[1] * coefficients.front + center + samples[5] * coefficients.back);
+        }
+    }
+}
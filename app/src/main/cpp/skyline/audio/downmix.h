@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline {
+    namespace constant {
+        constexpr u8 SurroundChannelCount{6}; //!< The amount of channels in 5.1 surround sound, these are ordered as front left, front right, center, low frequency, back left and back right
+    }
+
+    namespace audio {
+        /**
+         * @brief The coefficients of a 5.1 to stereo downmix, every side of the stereo output is the sum of its respective front and back channel and both center channels
+         */
+        struct DownmixCoefficients {
+            float front;
+            float center;
+            float lowFrequency;
+            float back;
+        };
+
+        constexpr DownmixCoefficients DefaultDownmixCoefficients{1.0f, 0.707f, 0.251f, 0.707f}; //!< The coefficients that are used when none are specified
+
+        /**
+         * @brief Downmixes interleaved 5.1 surround sound to interleaved stereo
+         * @param output The buffer the stereo samples are written into, it must hold a third of the samples in input
+         */
+        void DownmixSurroundToStereo(span<const i16> input, span<i16> output, const DownmixCoefficients &coefficients = DefaultDownmixCoefficients);
+    }
+}
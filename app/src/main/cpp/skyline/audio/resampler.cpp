@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <arm_neon.h>
 #include "common.h"
 #include "resampler.h"
 
@@ -9,11 +10,12 @@ namespace skyline::audio {
      * @brief The coefficients for each index of a single output frame
      */
     struct LutEntry {
-        i32 a;
-        i32 b;
-        i32 c;
-        i32 d;
+        i16 a;
+        i16 b;
+        i16 c;
+        i16 d;
     };
+    static_assert(sizeof(LutEntry) == sizeof(int16x4_t));
 
     // @fmt:off
     constexpr std::array<LutEntry, 128> CurveLut0{{
@@ -119,37 +121,92 @@ namespace skyline::audio {
         {-42, 3751, 26253, 2811},   {-38, 3608, 26270, 2936},   {-34, 3467, 26281, 3064},   {-32, 3329, 26287, 3195}}};
     // @fmt:on
 
-    std::vector<i16> Resampler::ResampleBuffer(span<i16> inputBuffer, double ratio, u8 channelCount) {
+    /**
+     * @brief Filters a single output frame from the 4 consecutive input frames that taps points to
+     */
+    static void FilterFrame(const i16 *taps, const LutEntry &coefficients, u8 channelCount, bool upmix, i16 *output) {
+        auto coefficientVector{vld1_s16(&coefficients.a)};
+        if (channelCount == 2) {
+            // The coefficients are duplicated for both channels, so all 8 samples of the frames are filtered with a single load
+            auto samples{vld1q_s16(taps)};
+            auto zippedCoefficients{vzip_s16(coefficientVector, coefficientVector)};
+            auto products{vmull_s16(vget_low_s16(samples), zippedCoefficients.val[0])};
+            products = vmlal_s16(products, vget_high_s16(samples), zippedCoefficients.val[1]);
+            auto sums{vadd_s32(vget_low_s32(products), vget_high_s32(products))};
+            auto frame{vqshrn_n_s32(vcombine_s32(sums, sums), 15)};
+            vst1_lane_s32(reinterpret_cast<i32 *>(output), vreinterpret_s32_s16(frame), 0);
+        } else if (channelCount == 1) {
+            auto products{vmull_s16(vld1_s16(taps), coefficientVector)};
+            auto sample{Saturate<i16, i32>(vaddvq_s32(products) >> 15)};
+            output[0] = sample;
+            if (upmix)
+                output[1] = sample;
+        } else {
+            for (u8 channel{}; channel < channelCount; channel++) {
+                i32 data{taps[channel] * coefficients.a +
+                    taps[channelCount + channel] * coefficients.b +
+                    taps[(channelCount * 2) + channel] * coefficients.c +
+                    taps[(channelCount * 3) + channel] * coefficients.d};
+
+                output[channel] = Saturate<i16, i32>(data >> 15);
+            }
+        }
+    }
+
+    size_t Resampler::GetMaxOutputSize(size_t inputSize, double ratio, u8 channelCount) {
         auto step{static_cast<u32>(ratio * 0x8000)};
-        auto outputSize{static_cast<size_t>(inputBuffer.size() / ratio)};
-        std::vector<i16> outputBuffer(outputSize);
+        return ((((inputSize / channelCount) << 15) / step) + 1) * channelCount;
+    }
 
-        const std::array<LutEntry, 128> &lut = [step] {
-            if (step > 0xAAAA)
-                return CurveLut0;
-            else if (step <= 0x8000)
-                return CurveLut1;
-            else
-                return CurveLut2;
-        }();
+    size_t Resampler::ResampleBuffer(span<i16> inputBuffer, double ratio, u8 channelCount, span<i16> outputBuffer, bool upmix) {
+        if (channelCount > MaxChannelCount)
+            throw exception("Unsupported quantity of channels for resampling: {}", channelCount);
+        if (upmix && channelCount != 1)
+            throw exception("Cannot upmix {} channels to stereo while resampling", channelCount);
+        u8 outputChannelCount{static_cast<u8>(upmix ? 2 : channelCount)};
 
-        for (size_t outIndex{}, inIndex{}; outIndex < outputSize; outIndex += channelCount) {
-            u32 lutIndex{fraction >> 8};
+        if (channelCount != historyChannelCount) {
+            history.fill(0);
+            historyChannelCount = channelCount;
+        }
 
-            for (u8 channel{}; channel < channelCount; channel++) {
-                i32 data{inputBuffer[(inIndex + 0) * channelCount + channel] * lut[lutIndex].a +
-                    inputBuffer[(inIndex + 1) * channelCount + channel] * lut[lutIndex].b +
-                    inputBuffer[(inIndex + 2) * channelCount + channel] * lut[lutIndex].c +
-                    inputBuffer[(inIndex + 3) * channelCount + channel] * lut[lutIndex].d};
+        auto step{static_cast<u32>(ratio * 0x8000)};
+        const auto &lut{(step > 0xAAAA) ? CurveLut0 : ((step <= 0x8000) ? CurveLut1 : CurveLut2)};
 
-                outputBuffer[outIndex + channel] = Saturate<i16, i32>(data >> 15);
+        // The input is treated as the history frames followed by the frames of the buffer, so the filter taps are seamless across buffers
+        size_t inputFrames{inputBuffer.size() / channelCount};
+        size_t outputIndex{};
+        std::array<i16, (HistoryFrames + 1) * MaxChannelCount> taps;
+        while (position < inputFrames && outputIndex + outputChannelCount <= outputBuffer.size()) {
+            const i16 *source;
+            if (position >= HistoryFrames) {
+                source = inputBuffer.data() + ((position - HistoryFrames) * channelCount);
+            } else {
+                // Taps which overlap the history are gathered into a contiguous array
+                size_t historySamples{(HistoryFrames - position) * channelCount};
+                std::memcpy(taps.data(), history.data() + (position * channelCount), historySamples * sizeof(i16));
+                std::memcpy(taps.data() + historySamples, inputBuffer.data(), (((HistoryFrames + 1) * channelCount) - historySamples) * sizeof(i16));
+                source = taps.data();
             }
 
-            u32 newOffset{fraction + step};
-            inIndex += newOffset >> 15;
-            fraction = newOffset & 0x7FFF;
+            FilterFrame(source, lut[fraction >> 8], channelCount, upmix, outputBuffer.data() + outputIndex);
+            outputIndex += outputChannelCount;
+
+            fraction += step;
+            position += fraction >> 15;
+            fraction &= 0x7FFF;
+        }
+
+        // The final frames of the history and the buffer become the history of the next buffer
+        size_t samples{inputFrames * channelCount}, historySize{HistoryFrames * channelCount};
+        if (samples >= historySize) {
+            std::memcpy(history.data(), inputBuffer.data() + (samples - historySize), historySize * sizeof(i16));
+        } else {
+            std::memmove(history.data(), history.data() + samples, (historySize - samples) * sizeof(i16));
+            std::memcpy(history.data() + (historySize - samples), inputBuffer.data(), samples * sizeof(i16));
         }
+        position -= std::min(position, inputFrames);
 
-        return outputBuffer;
+        return outputIndex;
     }
 }
@@ -7,19 +7,33 @@
 
 namespace skyline::audio {
     /**
-     * @brief The Resampler class handles resampling audio PCM data
+     * @brief The Resampler class handles resampling audio PCM data, it's stateful so consecutive buffers of a stream are resampled without any seams between them
      */
     class Resampler {
       private:
-        u32 fraction{}; //!< The fractional value used for storing the resamplers last frame
+        static constexpr u8 MaxChannelCount{6}; //!< The maximum amount of channels that the resampler supports
+        static constexpr size_t HistoryFrames{3}; //!< The amount of frames from prior buffers which the filter still needs, as it has 4 taps
+
+        u32 fraction{}; //!< The fractional position of the next output frame between input frames as 0.15 fixed-point
+        size_t position{}; //!< The index of the first input frame used for the next output frame, this is relative to the start of history
+        u8 historyChannelCount{}; //!< The amount of channels in history, it's cleared when this doesn't match the buffer being resampled
+        std::array<i16, HistoryFrames * MaxChannelCount> history{}; //!< The final frames of the previously resampled buffer, this precedes the next buffer
 
       public:
         /**
-         * @brief Resamples the given sample buffer by the given ratio
+         * @return The maximum amount of samples that ResampleBuffer can write for the supplied input buffer size
+         */
+        static size_t GetMaxOutputSize(size_t inputSize, double ratio, u8 channelCount);
+
+        /**
+         * @brief Resamples the given sample buffer by the given ratio, continuing from the previously resampled buffer
          * @param inputBuffer A buffer containing PCM sample data
          * @param ratio The conversion ratio needed
          * @param channelCount The amount of channels the buffer contains
+         * @param outputBuffer The buffer which the resampled data is written into, it should be at least GetMaxOutputSize() samples large or twice that if upmix is set
+         * @param upmix If mono input should be written out as interleaved stereo, this avoids a separate pass over the output to expand it
+         * @return The amount of samples written into outputBuffer
          */
-        std::vector<i16> ResampleBuffer(span<i16> inputBuffer, double ratio, u8 channelCount);
+        size_t ResampleBuffer(span<i16> inputBuffer, double ratio, u8 channelCount, span<i16> outputBuffer, bool upmix = false);
     };
 }
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <arm_neon.h>
+#include "time_stretcher.h"
+
+namespace skyline::audio {
+    /**
+     * @return The dot product of two arrays of PCM samples, this is accumulated in 64-bit integers as it can't overflow them
+     */
+    static i64 DotProduct(const i16 *a, const i16 *b, size_t count) {
+        int64x2_t sums{vdupq_n_s64(0)};
+        size_t index{};
+        for (; index + 8 <= count; index += 8) {
+            auto aSamples{vld1q_s16(a + index)}, bSamples{vld1q_s16(b + index)};
+            sums = vpadalq_s32(sums, vmull_s16(vget_low_s16(aSamples), vget_low_s16(bSamples)));
+            sums = vpadalq_s32(sums, vmull_high_s16(aSamples, bSamples));
+        }
+
+        auto result{vaddvq_s64(sums)};
+        for (; index < count; index++)
+            result += static_cast<i32>(a[index]) * b[index];
+        return result;
+    }
+
+    void TimeStretcher::UpdateTempo(size_t fillFrames) {
+        auto target{std::clamp(static_cast<float>(fillFrames) / TargetFillFrames, MinTempo, 1.0f)};
+        tempo += (target - tempo) * TempoSmoothing;
+        if (tempo > 0.999f)
+            tempo = 1.0f; // The tempo is snapped to 1 so that audio is passed through unaltered once the source has caught up
+    }
+
+    size_t TimeStretcher::FindBestOffset() {
+        constexpr size_t OverlapSamples{OverlapFrames * constant::ChannelCount};
+
+        // The energy of the candidate segment is updated incrementally as the offset slides over the input rather than being recalculated for every offset
+        auto energy{DotProduct(input.data(), input.data(), OverlapSamples)};
+        size_t bestOffset{};
+        double bestScore{-std::numeric_limits<double>::infinity()};
+        for (size_t offset{}; offset < SeekFrames; offset++) {
+            auto candidate{input.data() + offset * constant::ChannelCount};
+            if (energy > 0) {
+                double score{static_cast<double>(DotProduct(overlap.data(), candidate, OverlapSamples)) / std::sqrt(static_cast<double>(energy))};
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestOffset = offset;
+                }
+            }
+
+            for (size_t channel{}; channel < constant::ChannelCount; channel++) {
+                energy -= static_cast<i32>(candidate[channel]) * candidate[channel];
+                energy += static_cast<i32>(candidate[OverlapSamples + channel]) * candidate[OverlapSamples + channel];
+            }
+        }
+        return bestOffset;
+    }
+
+    void TimeStretcher::Step() {
+        // At a tempo of 1 exactly a step's worth of frames is consumed, so the offset of the previous segment continues the input without any discontinuity and searching can be skipped
+        auto offset{tempo < 1.0f ? FindBestOffset() : previousOffset};
+        auto segment{input.data() + offset * constant::ChannelCount};
+
+        for (size_t frame{}; frame < OverlapFrames; frame++) {
+            for (size_t channel{}; channel < constant::ChannelCount; channel++) {
+                size_t index{frame * constant::ChannelCount + channel};
+                output[index] = static_cast<i16>((static_cast<i32>(overlap[index]) * static_cast<i32>(OverlapFrames - frame) + static_cast<i32>(segment[index]) * static_cast<i32>(frame)) / static_cast<i32>(OverlapFrames));
+            }
+        }
+        std::memcpy(output.data() + OverlapFrames * constant::ChannelCount, segment + OverlapFrames * constant::ChannelCount, (StepFrames - OverlapFrames) * constant::ChannelCount * sizeof(i16));
+        std::memcpy(overlap.data(), segment + StepFrames * constant::ChannelCount, overlap.size() * sizeof(i16));
+        outputOffset = 0;
+        outputSamples = output.size();
+        previousOffset = offset;
+
+        // The input is consumed at the nominal rate from the start of the window regardless of the offset, only this determines the tempo
+        auto advance{static_cast<double>(tempo) * StepFrames + skipRemainder};
+        auto skipFrames{static_cast<size_t>(advance)};
+        skipRemainder = advance - static_cast<double>(skipFrames);
+
+        auto skipSamples{skipFrames * constant::ChannelCount};
+        std::memmove(input.data(), input.data() + skipSamples, (inputSamples - skipSamples) * sizeof(i16));
+        inputSamples -= skipSamples;
+    }
+}
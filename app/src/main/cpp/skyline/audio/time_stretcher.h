@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "common.h"
+
+namespace skyline::audio {
+    /**
+     * @brief A WSOLA (Waveform Similarity Overlap-Add) time-stretcher which slows down interleaved stereo audio without changing its pitch
+     * @note The tempo is derived from the amount of buffered samples so playback slows down rather than underrunning when the guest supplies samples too slowly, audio passes through unaltered at a tempo of 1
+     * @url https://www.surina.net/article/time-and-pitch-scaling.html
+     */
+    class TimeStretcher {
+      private:
+        static constexpr size_t SequenceFrames{960}; //!< The length of a segment of the input that's output at once (20ms)
+        static constexpr size_t OverlapFrames{240}; //!< The length of the crossfade between consecutive segments (5ms)
+        static constexpr size_t SeekFrames{360}; //!< The range of offsets that are searched for the segment which is the most similar to the end of the previous one (7.5ms)
+        static constexpr size_t StepFrames{SequenceFrames - OverlapFrames}; //!< The amount of frames that are output for every segment
+        static constexpr size_t WindowFrames{SeekFrames + SequenceFrames}; //!< The amount of input frames that are required to output a segment
+        static constexpr size_t TargetFillFrames{constant::MixBufferSize * 2}; //!< The amount of buffered frames below which playback is slowed down
+        static constexpr float MinTempo{0.5f}; //!< The slowest tempo audio is played back at
+        static constexpr float TempoSmoothing{0.05f}; //!< The fraction of the difference to the target tempo that the tempo is adjusted by per update, this avoids audible warbling from the fill level fluctuating
+
+        std::array<i16, WindowFrames * constant::ChannelCount> input{}; //!< The input samples which haven't been consumed yet, the oldest sample is always at the front
+        size_t inputSamples{}; //!< The amount of valid samples in input
+        std::array<i16, StepFrames * constant::ChannelCount> output{}; //!< The samples of the last segment
+        size_t outputOffset{}; //!< The offset of the first sample in output which hasn't been read yet
+        size_t outputSamples{}; //!< The amount of valid samples in output
+        std::array<i16, OverlapFrames * constant::ChannelCount> overlap{}; //!< The end of the previous segment which the next segment is crossfaded with
+        size_t previousOffset{}; //!< The offset of the previous segment in its window, reusing it at a tempo of 1 continues the input seamlessly
+        double skipRemainder{}; //!< The fraction of a frame that should've been consumed from the input but wasn't yet
+        float tempo{1.0f};
+
+        /**
+         * @return The offset in the input of the segment with the highest normalized cross-correlation with overlap
+         */
+        size_t FindBestOffset();
+
+        /**
+         * @brief Outputs a segment of a full window of input and consumes the input according to the tempo
+         */
+        void Step();
+
+      public:
+        /**
+         * @brief Adjusts the tempo towards the one that the supplied fill level calls for
+         * @param fillFrames The amount of frames that are buffered by the source
+         */
+        void UpdateTempo(size_t fillFrames);
+
+        inline float GetTempo() {
+            return tempo;
+        }
+
+        /**
+         * @brief Fills the supplied buffer with time-stretched samples
+         * @param buffer The buffer to write interleaved stereo samples into
+         * @param source A function that writes up to the size of the supplied span of interleaved stereo samples into it and returns the amount of samples it wrote
+         * @return The amount of samples written into the buffer, this is only less than its size if the source ran out of samples
+         */
+        template<typename Source>
+        size_t Process(span<i16> buffer, Source source) {
+            size_t written{};
+            while (written < buffer.size()) {
+                if (outputOffset < outputSamples) {
+                    size_t size{std::min(outputSamples - outputOffset, buffer.size() - written)};
+                    std::memcpy(buffer.data() + written, output.data() + outputOffset, size * sizeof(i16));
+                    outputOffset += size;
+                    written += size;
+                    continue;
+                }
+
+                if (inputSamples < input.size()) {
+                    inputSamples += source(span(input).subspan(inputSamples));
+                    if (inputSamples < input.size())
+                        break; // The partial window is kept till the source has enough samples to complete it
+                }
+
+                Step();
+            }
+            return written;
+        }
+    };
+}
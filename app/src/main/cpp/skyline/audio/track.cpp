@@ -8,66 +8,82 @@ namespace skyline::audio {
         if (sampleRate != constant::SampleRate)
             throw exception("Unsupported audio sample rate: {}", sampleRate);
 
-        if (channelCount != constant::ChannelCount)
+        if (channelCount != constant::ChannelCount && channelCount != constant::SurroundChannelCount)
             throw exception("Unsupported quantity of audio channels: {}", channelCount);
     }
 
     void AudioTrack::Stop() {
-        while (!identifiers.end()->released);
+        if (playbackState == AudioOutState::Started) {
+            // The audio callback doesn't run while the stream is paused (such as when the app is in the background), so the wait is bounded by the duration of the pending samples with some leeway
+            constexpr u64 StopLeeway{100 * 1000000}; // 100ms
+            auto pendingSamples{samples.GetWritePosition() - std::min(samples.GetReadPosition(), samples.GetWritePosition())};
+            auto deadline{util::GetTimeNs() + (pendingSamples * constant::NsInSecond) / (constant::SampleRate * constant::ChannelCount) + StopLeeway};
+            while (samples.GetReadPosition() < samples.GetWritePosition() && util::GetTimeNs() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
         playbackState = AudioOutState::Stopped;
     }
 
     bool AudioTrack::ContainsBuffer(u64 tag) {
-        // Iterate from front of queue as we don't want released samples
-        for (auto identifier{identifiers.crbegin()}; identifier != identifiers.crend(); identifier++) {
-            if (identifier->released)
-                return false;
+        std::lock_guard guard(bufferLock);
+        auto readPosition{samples.GetReadPosition()};
 
-            if (identifier->tag == tag)
+        // Buffers are released in the order they were appended, so any released buffers are skipped from the oldest one onwards
+        auto index{identifierHead};
+        while (index < identifierTail && identifiers[index % MaxBufferCount].finalSample <= readPosition)
+            index++;
+
+        for (; index < identifierTail; index++)
+            if (identifiers[index % MaxBufferCount].tag == tag)
                 return true;
-        }
 
         return false;
     }
 
-    std::vector<u64> AudioTrack::GetReleasedBuffers(u32 max) {
-        std::vector<u64> bufferIds;
+    size_t AudioTrack::GetReleasedBuffers(span<u64> tags) {
         std::lock_guard trackGuard(bufferLock);
+        auto readPosition{samples.GetReadPosition()};
 
-        for (u32 index{}; index < max; index++) {
-            if (identifiers.empty() || !identifiers.back().released)
+        size_t count{};
+        while (count < tags.size() && identifierHead < identifierTail) {
+            auto &identifier{identifiers[identifierHead % MaxBufferCount]};
+            if (identifier.finalSample > readPosition)
                 break;
-            bufferIds.push_back(identifiers.back().tag);
-            identifiers.pop_back();
+            tags[count++] = identifier.tag;
+            identifierHead++;
         }
 
-        return bufferIds;
+        UpdateReleasePosition();
+        return count;
     }
 
     void AudioTrack::AppendBuffer(u64 tag, span<i16> buffer) {
-        BufferIdentifier identifier{
-            .released = false,
+        std::lock_guard guard(bufferLock);
+
+        if (identifierTail - identifierHead == MaxBufferCount)
+            throw exception("Cannot append more than {} unreleased audio buffers", MaxBufferCount);
+
+        if (channelCount == constant::SurroundChannelCount) {
+            downmixBuffer.resize((buffer.size() / constant::SurroundChannelCount) * constant::ChannelCount);
+            DownmixSurroundToStereo(buffer, downmixBuffer);
+            buffer = downmixBuffer;
+        }
+
+        identifiers[identifierTail++ % MaxBufferCount] = BufferIdentifier{
             .tag = tag,
-            .finalSample = identifiers.empty() ? (buffer.size()) : (buffer.size() + identifiers.front().finalSample)
+            .finalSample = samples.Append(buffer),
         };
+        UpdateReleasePosition();
+    }
 
-        std::lock_guard guard(bufferLock);
-
-        identifiers.push_front(identifier);
-        samples.Append(buffer);
+    void AudioTrack::UpdateReleasePosition() {
+        // The oldest buffer is always the next one to be released, so only its final sample needs to be checked by the audio callback
+        releasePosition.store(identifierHead == identifierTail ? std::numeric_limits<u64>::max() : identifiers[identifierHead % MaxBufferCount].finalSample, std::memory_order_release);
     }
 
     void AudioTrack::CheckReleasedBuffers() {
-        bool anyReleased{};
-
-        for (auto &identifier : identifiers) {
-            if (identifier.finalSample <= sampleCounter && !identifier.released) {
-                anyReleased = true;
-                identifier.released = true;
-            }
-        }
-
-        if (anyReleased)
-            releaseCallback();
+        auto position{releasePosition.load(std::memory_order_acquire)};
+        if (position <= samples.GetReadPosition() && releasePosition.compare_exchange_strong(position, std::numeric_limits<u64>::max(), std::memory_order_acq_rel))
+            releaseCallback(); // The position is only reset if it wasn't updated in the meantime, a newer position will be checked on the next call
     }
 }
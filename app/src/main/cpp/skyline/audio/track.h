@@ -5,6 +5,7 @@
 
 #include <kernel/types/KEvent.h>
 #include "common.h"
+#include "downmix.h"
 
 namespace skyline::audio {
     /**
@@ -13,17 +14,28 @@ namespace skyline::audio {
     class AudioTrack {
       private:
         std::function<void()> releaseCallback; //!< Callback called when a buffer has been played
-        std::deque<BufferIdentifier> identifiers; //!< Queue of all appended buffer identifiers
 
-        u8 channelCount;
+        static constexpr size_t MaxBufferCount{32}; //!< The maximum amount of buffers that can be appended without being released, this is the limit of audout
+        std::array<BufferIdentifier, MaxBufferCount> identifiers; //!< A ring of the identifiers of all appended buffers which haven't been popped, it's indexed by identifierHead and identifierTail modulo its size
+        u64 identifierHead{}; //!< The total amount of identifiers that have been popped, this indexes the oldest identifier
+        u64 identifierTail{}; //!< The total amount of identifiers that have been appended
+
+        u8 channelCount; //!< The amount of channels in appended buffers, surround sound is downmixed to stereo when it's appended
         u32 sampleRate;
+        std::vector<i16> downmixBuffer; //!< The buffer surround sound is downmixed into, this is only a member so its allocation is reused
+
+        /**
+         * @brief Updates releasePosition to the final sample of the oldest buffer that hasn't been popped
+         * @note bufferLock MUST be locked when calling this
+         */
+        void UpdateReleasePosition();
 
       public:
-        CircularBuffer<i16, constant::SampleRate * constant::ChannelCount * 10> samples; //!< A circular buffer with all appended audio samples
-        Mutex bufferLock; //!< Synchronizes appending to audio buffers
+        CircularBuffer<i16, constant::SampleRate * constant::ChannelCount * 10> samples; //!< A circular buffer with all appended audio samples, the audio callback is its only consumer
+        Mutex bufferLock; //!< Synchronizes appending to audio buffers and popping released ones, this is never locked by the audio callback
 
-        AudioOutState playbackState{AudioOutState::Stopped}; //!< The current state of playback
-        u64 sampleCounter{}; //!< A counter used for tracking when buffers have been played and can be released
+        std::atomic<AudioOutState> playbackState{AudioOutState::Stopped}; //!< The current state of playback
+        std::atomic<u64> releasePosition{std::numeric_limits<u64>::max()}; //!< The read position of samples after which releaseCallback should be called, this is the maximum value if there's nothing to notify about
 
         /**
          * @param channelCount The amount channels that will be present in the track
@@ -40,7 +52,8 @@ namespace skyline::audio {
         }
 
         /**
-         * @brief Stops audio playback, this waits for audio playback to finish before returning
+         * @brief Stops audio playback, this waits for all appended samples to be played before returning
+         * @note The wait is abandoned if the samples aren't played within their duration and a short leeway, such as when the stream is paused
          */
         void Stop();
 
@@ -52,22 +65,23 @@ namespace skyline::audio {
         bool ContainsBuffer(u64 tag);
 
         /**
-         * @brief Gets the IDs of all newly released buffers
-         * @param max The maximum amount of buffers to return
-         * @return A vector containing the identifiers of the buffers
+         * @brief Pops the tags of all newly released buffers into the supplied span
+         * @param tags The span to write the tags into, up to its size are popped
+         * @return The amount of tags that were written into the span
          */
-        std::vector<u64> GetReleasedBuffers(u32 max);
+        size_t GetReleasedBuffers(span<u64> tags);
 
         /**
          * @brief Appends audio samples to the output buffer
          * @param tag The tag of the buffer
          * @param buffer A span containing the source sample buffer
+         * @note An exception is thrown if MaxBufferCount buffers are already appended
          */
         void AppendBuffer(u64 tag, span<i16> buffer = {});
 
         /**
-         * @brief Checks if any buffers have been released and calls the appropriate callback for them
-         * @note bufferLock MUST be locked when calling this
+         * @brief Calls the release callback if the oldest buffer has been played since the last call to it
+         * @note This is called by the audio callback after reading samples, it doesn't lock bufferLock
          */
         void CheckReleasedBuffers();
     };
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "statistics.h"
+#include "benchmark.h"
+
+extern std::atomic<bool> Halt;
+extern std::mutex SurfaceMutex;
+extern std::condition_variable SurfaceCondition;
+
+namespace skyline {
+    Benchmark::Benchmark(u64 frameLimit, u64 durationLimit, std::string reportPath, std::string inputPath, std::string gpuTracePath) : frameLimit(frameLimit), durationLimit(durationLimit), reportPath(std::move(reportPath)), inputPath(std::move(inputPath)), gpuTracePath(std::move(gpuTracePath)) {
+        if (frameLimit)
+            frameTimes.reserve(frameLimit);
+    }
+
+    void Benchmark::Update(bool presented) {
+        if (finished)
+            return;
+
+        auto now{util::GetTimeNs()};
+        if (presented) {
+            if (startTimestamp)
+                frameTimes.push_back(static_cast<u32>((now - lastTimestamp) / 1000));
+            else
+                startTimestamp = now;
+            lastTimestamp = now;
+        }
+
+        if (!startTimestamp)
+            return;
+
+        // The frame limit counts the intervals between frames, so the first frame which starts the run isn't included in it
+        if ((frameLimit && frameTimes.size() >= frameLimit) || (durationLimit && now - startTimestamp >= durationLimit)) {
+            finished = true;
+
+            // Halt is set directly rather than through JniMtx as this runs on the presentation thread which holds it, the threads waiting on a surface are woken to exit promptly
+            Halt = true;
+            std::lock_guard guard(SurfaceMutex);
+            SurfaceCondition.notify_all();
+        }
+    }
+
+    void Benchmark::WriteReport(PerformanceStatistics &statistics) {
+        auto sortedTimes{frameTimes};
+        std::sort(sortedTimes.begin(), sortedTimes.end());
+        auto percentile{[&sortedTimes](size_t percent) -> u32 {
+            return sortedTimes.empty() ? 0 : sortedTimes[std::min((sortedTimes.size() * percent) / 100, sortedTimes.size() - 1)];
+        }};
+
+        auto duration{lastTimestamp - startTimestamp};
+        auto frameRate{duration ? static_cast<double>(frameTimes.size()) * constant::NsInSecond / static_cast<double>(duration) : 0.0};
+        auto latency{statistics.presentLatency.GetPercentiles()};
+
+        std::ofstream report(reportPath);
+        report << fmt::format(R"({{
+  "frames": {},
+  "duration_ms": {},
+  "fps": {:.2f},
+  "frame_time_us": {{"p50": {}, "p95": {}, "p99": {}, "max": {}}},
+  "present_latency_us": {{"p50": {}, "p95": {}, "p99": {}, "max": {}}},
+  "skipped_frames": {},
+  "texture_upload_bytes": {},
+  "buffer_upload_bytes": {},
+  "ipc_requests": {},
+  "first_frame_ms": {}
+}}
+)", frameTimes.size(), duration / 1000000, frameRate,
+                              percentile(50), percentile(95), percentile(99), percentile(100),
+                              latency.p50, latency.p95, latency.p99, latency.max,
+                              statistics.skippedFrames.load(std::memory_order_relaxed),
+                              statistics.textureUploadBytes.load(std::memory_order_relaxed),
+                              statistics.bufferUploadBytes.load(std::memory_order_relaxed),
+                              statistics.ipcRequestCount.load(std::memory_order_relaxed),
+                              statistics.boot.GetTimeline()[static_cast<size_t>(BootPhase::FirstFrame) * 2] / 1000);
+    }
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "common.h"
+
+namespace skyline {
+    class PerformanceStatistics;
+
+    /**
+     * @brief A headless benchmark run, the application runs without a surface or an audio stream until it reaches either of its limits and a report of its performance is written after it's done
+     * @note Frames are discarded by a null presenter and audio is consumed by a null sink in real time, so neither requires any UI
+     * @note The run is timed from the first frame onwards, so loading the application isn't included in it
+     * @note Replaying an input recording during the run makes it reproduce the same scene every time, as the recording is timed against the guest's frames
+     */
+    class Benchmark {
+      private:
+        u64 frameLimit; //!< The amount of frames to run for, this is 0 if the amount of frames isn't limited
+        u64 durationLimit; //!< The duration to run for in nanoseconds, this is 0 if the duration isn't limited
+        std::string reportPath; //!< The path of the file that the report is written to
+        u64 startTimestamp{}; //!< The time at which the first frame was presented in nanoseconds, this is 0 prior to it
+        u64 lastTimestamp{}; //!< The time at which the last frame was presented in nanoseconds
+        std::vector<u32> frameTimes; //!< The time between every consecutive pair of frames in microseconds, percentiles of the entire run are calculated over these
+        bool finished{}; //!< If a limit has been reached and emulation has been halted
+
+      public:
+        std::string inputPath; //!< The path of an input recording which is replayed during the run, this is empty if no input is replayed
+        std::string gpuTracePath; //!< The path of a GPFIFO trace which is replayed once the title first submits GPU work, this is empty if no trace is replayed
+
+        /**
+         * @param frameLimit The amount of frames to run for or 0 for no limit
+         * @param durationLimit The duration to run for in nanoseconds or 0 for no limit
+         * @param inputPath The path of an input recording to replay or an empty string to run without any input
+         * @param gpuTracePath The path of a GPFIFO trace to replay or an empty string to not replay one
+         */
+        Benchmark(u64 frameLimit, u64 durationLimit, std::string reportPath, std::string inputPath = {}, std::string gpuTracePath = {});
+
+        /**
+         * @brief Updates the run from the presentation thread, emulation is halted once either limit is reached
+         * @param presented If a frame was presented since the last update
+         * @note This must be called regularly even while no frames are presented, so the duration limit is reached regardless
+         */
+        void Update(bool presented);
+
+        /**
+         * @brief Writes a JSON report of the throughput and latency of the run to the report file
+         */
+        void WriteReport(PerformanceStatistics &statistics);
+    };
+}
@@ -1,77 +1,88 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <charconv>
 #include <tinyxml2.h>
 #include <android/log.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include "common.h"
 #include "nce.h"
 #include "gpu.h"
 #include "audio.h"
 #include "input.h"
+#include "thread_pool.h"
+#include "statistics.h"
 #include "kernel/types/KThread.h"
 
 namespace skyline {
     void Mutex::lock() {
-        while (true) {
-            for (int i{}; i < 1000; ++i) {
-                if (!flag.test_and_set(std::memory_order_acquire))
-                    return;
+        if (try_lock())
+            return;
 
-                asm volatile("yield");
-            }
-            sched_yield();
-        }
-    }
+        for (size_t i{}; i < SpinCount; ++i) {
+            if (state.load(std::memory_order_relaxed) == Unlocked && try_lock())
+                return;
 
-    void GroupMutex::lock(Group group) {
-        auto none{Group::None};
-        constexpr u64 timeout{100}; // The timeout in ns
-        auto end{util::GetTimeNs() + timeout};
+            asm volatile("yield");
+        }
 
-        while (true) {
-            if (next == group) {
-                if (flag == group) {
-                    std::lock_guard lock(mtx);
-
-                    if (flag == group) {
-                        auto groupT{group};
-                        next.compare_exchange_strong(groupT, Group::None);
-                        num++;
-
-                        return;
-                    }
-                } else {
-                    flag.compare_exchange_weak(none, group);
-                }
-            } else if (flag == group && (next == Group::None || util::GetTimeNs() >= end)) {
-                std::lock_guard lock(mtx);
+        // The mutex is marked as contended whenever a thread might sleep on it, it stays that way until it's unlocked so the holder knows to wake a waiter
+        while (state.exchange(Contended, std::memory_order_acquire) != Unlocked)
+            syscall(__NR_futex, &state, FUTEX_WAIT_PRIVATE, Contended, nullptr);
+    }
 
-                if (flag == group) {
-                    num++;
-                    return;
-                }
-            } else {
-                next.compare_exchange_weak(none, group);
-            }
+    void Mutex::Wake() {
+        syscall(__NR_futex, &state, FUTEX_WAKE_PRIVATE, 1);
+    }
 
-            none = Group::None;
-            asm volatile("yield");
+    void GroupMutex::lock(Group group) {
+        auto index{GetIndex(group)};
+        auto otherIndex{index ^ 1};
+
+        std::unique_lock lock(mutex);
+        if (owner == Group::None || (owner == group && !waiters[otherIndex])) {
+            owner = group;
+            holders++;
+            return;
         }
+
+        waiters[index]++;
+        conditions[index].wait(lock, [&] { return owner == group && (handoverWaiters || !waiters[otherIndex]); });
+        waiters[index]--;
+        if (handoverWaiters)
+            handoverWaiters--;
+        holders++;
     }
 
     void GroupMutex::unlock() {
-        std::lock_guard lock(mtx);
-
-        if (!--num)
-            flag.exchange(next);
+        std::lock_guard lock(mutex);
+        if (--holders)
+            return;
+
+        // The mutex is handed over to the other group if it's waiting, otherwise any waiters of the owning group are let in as the other group can't be waiting anymore
+        auto otherIndex{GetIndex(owner) ^ 1};
+        if (waiters[otherIndex])
+            owner = static_cast<Group>(otherIndex + 1);
+        else if (!waiters[otherIndex ^ 1])
+            owner = Group::None;
+
+        if (owner != Group::None) {
+            auto ownerIndex{GetIndex(owner)};
+            handoverWaiters = waiters[ownerIndex];
+            conditions[ownerIndex].notify_all();
+        }
     }
 
     Settings::Settings(int fd) {
-        tinyxml2::XMLDocument pref;
-
         auto fileDeleter = [](FILE *file) { fclose(file); };
         std::unique_ptr<FILE, decltype(fileDeleter)> file{fdopen(fd, "r"), fileDeleter};
-        if (pref.LoadFile(file.get()))
+        Load(file.get());
+    }
+
+    void Settings::Load(FILE *file) {
+        tinyxml2::XMLDocument pref;
+        if (pref.LoadFile(file))
             throw exception("TinyXML2 Error: " + std::string(pref.ErrorStr()));
 
         tinyxml2::XMLElement *elem{pref.LastChild()->FirstChild()->ToElement()};
@@ -103,18 +114,50 @@ namespace skyline {
         pref.Clear();
     }
 
+    bool Settings::ApplyProfile(const std::string &path) {
+        auto fileDeleter = [](FILE *file) { fclose(file); };
+        std::unique_ptr<FILE, decltype(fileDeleter)> file{fopen(path.c_str(), "r"), fileDeleter};
+        if (!file)
+            return false;
+
+        Load(file.get());
+        return true;
+    }
+
     std::string Settings::GetString(const std::string &key) {
         return stringMap.at(key);
     }
 
+    std::string Settings::GetString(const std::string &key, const std::string &fallback) {
+        auto value{stringMap.find(key)};
+        return value != stringMap.end() ? value->second : fallback;
+    }
+
     bool Settings::GetBool(const std::string &key) {
         return boolMap.at(key);
     }
 
+    bool Settings::GetBool(const std::string &key, bool fallback) {
+        auto value{boolMap.find(key)};
+        return value != boolMap.end() ? value->second : fallback;
+    }
+
     int Settings::GetInt(const std::string &key) {
         return intMap.at(key);
     }
 
+    int Settings::GetStringInt(const std::string &key, int fallback) {
+        auto value{stringMap.find(key)};
+        if (value == stringMap.end())
+            return fallback;
+
+        // A malformed value shouldn't prevent booting, the value is only used once it was parsed entirely
+        int result{};
+        auto &string{value->second};
+        auto [end, error]{std::from_chars(string.data(), string.data() + string.size(), result)};
+        return (error == std::errc{} && end == string.data() + string.size()) ? result : fallback;
+    }
+
     void Settings::List(const std::shared_ptr<Logger> &logger) {
         for (auto &iter : stringMap)
             logger->Info("Key: {}, Value: {}, Type: String", iter.first, GetString(iter.first));
@@ -123,40 +166,197 @@ namespace skyline {
             logger->Info("Key: {}, Value: {}, Type: Bool", iter.first, GetBool(iter.first));
     }
 
-    Logger::Logger(const std::string &path, LogLevel configLevel) : configLevel(configLevel) {
+    Logger::Logger(const std::string &path, LogLevel configLevel, bool logcat) : logcat(logcat), configLevel(configLevel) {
+        for (size_t index{}; index < RingSize; index++)
+            ring[index].sequence.store(index, std::memory_order_relaxed);
+
         logFile.open(path, std::ios::trunc);
+        writerThread = std::thread(&Logger::Run, this);
         WriteHeader("Logging started");
     }
 
     Logger::~Logger() {
         WriteHeader("Logging ended");
-        logFile.flush();
+
+        running.store(false, std::memory_order_release);
+        {
+            std::lock_guard guard(writerMutex);
+            writerCondition.notify_one();
+        }
+        writerThread.join();
     }
 
-    void Logger::WriteHeader(const std::string &str) {
-        __android_log_write(ANDROID_LOG_INFO, "emu-cpp", str.c_str());
+    Logger::Record *Logger::Claim(size_t &position) {
+        // This is a bounded MPMC queue (Vyukov) with a single consumer, a producer claims a position and then publishes it by advancing the sequence of its record
+        position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            auto &record{ring[position % RingSize]};
+            auto difference{static_cast<ssize_t>(record.sequence.load(std::memory_order_acquire) - position)};
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    return &record;
+            } else if (difference < 0) {
+                // The writer hasn't freed this record yet, blocking on it would stall the logging thread on the I/O anyway
+                dropCount.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
 
-        std::lock_guard guard(mtx);
-        logFile << "0|" << str << "\n";
+    void Logger::Publish(Record &record, size_t position) {
+        bool flush{record.level == LogLevel::Error && !record.header && std::this_thread::get_id() != writerThread.get_id()}; // The record can't be read after it's published as the writer may reuse it
+        record.sequence.store(position + 1, std::memory_order_release);
+
+        if (flush) {
+            // Errors are frequently followed by a crash, so they're waited on rather than potentially being lost with the batch they'd be written in
+            std::unique_lock lock(writerMutex);
+            writerCondition.notify_one();
+            flushCondition.wait_for(lock, FlushTimeout, [&] { return flushedPosition.load(std::memory_order_acquire) > position; });
+            return;
+        }
+
+        // This pairs with the fence in Run(), either the writer sees the record prior to waiting or this sees the writer waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writerWaiting.load(std::memory_order_relaxed)) {
+            // The writer checks for records with the mutex held, so notifying with it held ensures the notification can't land between that check and the writer waiting
+            std::lock_guard guard(writerMutex);
+            writerCondition.notify_one();
+        }
     }
 
-    void Logger::Write(LogLevel level, std::string str) {
+    bool Logger::Drain(std::string &batch) {
         constexpr std::array<char, 4> levelCharacter{'0', '1', '2', '3'}; // The LogLevel as written out to a file
         constexpr std::array<int, 4> levelAlog{ANDROID_LOG_ERROR, ANDROID_LOG_WARN, ANDROID_LOG_INFO, ANDROID_LOG_DEBUG}; // This corresponds to LogLevel and provides it's equivalent for NDK Logging
 
-        __android_log_write(levelAlog[static_cast<u8>(level)], "emu-cpp", str.c_str());
+        bool drained{};
+        while (true) {
+            auto &record{ring[dequeuePosition % RingSize]};
+            if (record.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+                break;
+
+            auto level{record.level};
+            bool header{record.header};
+            std::string message;
+            if (record.format) {
+                auto &arguments{record.arguments};
+                try {
+                    message = fmt::vformat(record.format, fmt::make_format_args(arguments[0], arguments[1], arguments[2], arguments[3]));
+                } catch (const std::exception &e) {
+                    message = fmt::format("Failed to format compact log \"{}\": {}", record.format, e.what());
+                }
+            } else {
+                message = std::move(record.message);
+                record.message = {}; // The record is reset so the allocation of a large message isn't held onto until the record is reused
+            }
+            record.sequence.store(dequeuePosition + RingSize, std::memory_order_release);
+            dequeuePosition++;
+            drained = true;
+
+            if (logcat)
+                __android_log_write(header ? ANDROID_LOG_INFO : levelAlog[static_cast<u8>(level)], "emu-cpp", message.c_str());
+
+            if (header) {
+                batch += "0|";
+            } else {
+                for (auto &character : message)
+                    if (character == '\n')
+                        character = '\\';
 
-        for (auto &character : str)
-            if (character == '\n')
-                character = '\\';
+                batch += "1|";
+                batch += levelCharacter[static_cast<u8>(level)];
+                batch += '|';
+            }
+            batch += message;
+            batch += '\n';
 
-        std::lock_guard guard(mtx);
-        logFile << "1|" << levelCharacter[static_cast<u8>(level)] << "|" << str << "\n";
+            if (batch.size() >= MaxBatchSize) {
+                logFile.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                batch.clear();
+            }
+        }
+
+        return drained;
+    }
+
+    void Logger::Run() {
+        pthread_setname_np(pthread_self(), "Sky-Logger");
+
+        std::string batch;
+        while (true) {
+            bool stopping{!running.load(std::memory_order_acquire)}; // This is read before draining so records pushed before the logger was stopped are always written
+            Drain(batch);
+
+            if (auto dropped{dropCount.exchange(0, std::memory_order_relaxed)}) {
+                batch += fmt::format("1|{}|Dropped {} logs as they were logged faster than they could be written\n", static_cast<u8>(LogLevel::Warn), dropped);
+                if (logcat)
+                    __android_log_print(ANDROID_LOG_WARN, "emu-cpp", "Dropped %zu logs as they were logged faster than they could be written", dropped);
+            }
+
+            if (!batch.empty()) {
+                logFile.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                logFile.flush(); // The file is flushed after every batch so logs leading up to a crash aren't lost
+                batch.clear();
+
+                {
+                    std::lock_guard guard(writerMutex);
+                    flushedPosition.store(dequeuePosition, std::memory_order_release);
+                }
+                flushCondition.notify_all();
+            }
+
+            if (stopping)
+                break;
+
+            std::unique_lock lock(writerMutex);
+            writerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            writerCondition.wait_for(lock, WriterTimeout, [this] {
+                return ring[dequeuePosition % RingSize].sequence.load(std::memory_order_acquire) == dequeuePosition + 1 || !running.load(std::memory_order_acquire);
+            });
+            writerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void Logger::WriteHeader(const std::string &str) {
+        size_t position;
+        if (auto record{Claim(position)}) {
+            record->level = LogLevel::Info;
+            record->header = true;
+            record->message = str;
+            record->format = nullptr;
+            Publish(*record, position);
+        }
+    }
+
+    void Logger::Write(LogLevel level, std::string str) {
+        size_t position;
+        if (auto record{Claim(position)}) {
+            record->level = level;
+            record->header = false;
+            record->message = std::move(str);
+            record->format = nullptr;
+            Publish(*record, position);
+        }
+    }
+
+    void Logger::WriteCompact(LogLevel level, const char *format, const std::array<u64, MaxCompactArguments> &arguments) {
+        size_t position;
+        if (auto record{Claim(position)}) {
+            record->level = level;
+            record->header = false;
+            record->format = format;
+            record->arguments = arguments;
+            Publish(*record, position);
+        }
     }
 
-    DeviceState::DeviceState(kernel::OS *os, std::shared_ptr<kernel::type::KProcess> &process, std::shared_ptr<JvmManager> jvmManager, std::shared_ptr<Settings> settings, std::shared_ptr<Logger> logger)
-        : os(os), jvm(std::move(jvmManager)), settings(std::move(settings)), logger(std::move(logger)), process(process) {
+    DeviceState::DeviceState(kernel::OS *os, std::shared_ptr<kernel::type::KProcess> &process, std::shared_ptr<JvmManager> jvmManager, std::shared_ptr<Settings> settings, std::shared_ptr<Logger> logger, std::shared_ptr<Benchmark> benchmark)
+        : os(os), jvm(std::move(jvmManager)), settings(std::move(settings)), logger(std::move(logger)), process(process), benchmark(std::move(benchmark)) {
         // We assign these later as they use the state in their constructor and we don't want null pointers
+        statistics = std::make_shared<PerformanceStatistics>();
+        threadPool = std::make_shared<ThreadPool>(*this);
         nce = std::make_shared<NCE>(*this);
         gpu = std::make_shared<gpu::GPU>(*this);
         audio = std::make_shared<audio::Audio>(*this);
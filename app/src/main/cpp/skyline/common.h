@@ -4,11 +4,16 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <bit>
 #include <unordered_map>
 #include <span>
 #include <vector>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <thread>
 #include <string>
@@ -65,6 +70,9 @@ namespace skyline {
         constexpr u16 DockedResolutionH{1080}; //!< The height component of the docked resolution
         // Time
         constexpr u64 NsInSecond{1000000000}; //!< The amount of nanoseconds in a second
+        // Kernel
+        constexpr u8 GuestCoreCount{4}; //!< The amount of cores the guest has access to
+        constexpr u64 DefaultAffinityMask{0b0111}; //!< The cores an application may run on by default, the last core is reserved for the system
     }
 
     /**
@@ -94,6 +102,15 @@ namespace skyline {
             return ((ticks / frequency) * constant::NsInSecond) + (((ticks % frequency) * constant::NsInSecond + (frequency / 2)) / frequency);
         }
 
+        /**
+         * @return The frequency of the ticks returned by GetTimeTicks in Hz
+         */
+        inline u64 GetTickFrequency() {
+            u64 frequency;
+            asm("MRS %0, CNTFRQ_EL0" : "=r"(frequency));
+            return frequency;
+        }
+
         /**
          * @brief Returns the current time in arbitrary ticks
          * @return The current time in ticks
@@ -193,6 +210,32 @@ namespace skyline {
         constexpr std::size_t Hash(std::string_view view) {
             return frz::elsa<frz::string>{}(frz::string(view.data(), view.size()), 0);
         }
+
+        /**
+         * @brief Hashes a region of guest memory in order to detect modifications to it, this is several times cheaper than any conversion of the data
+         * @note This isn't stable across versions, so it mustn't be used for anything that's persisted
+         */
+        inline u64 HashMemory(const u8 *data, size_t size) {
+            constexpr u64 Prime{0x9E3779B97F4A7C15};
+            std::array<u64, 4> lanes{Prime, Prime + 1, Prime + 2, Prime + 3}; // Independent lanes allow several words to be hashed in parallel
+
+            auto words{reinterpret_cast<const u64 *>(data)};
+            size_t wordCount{size / sizeof(u64)};
+            size_t index{};
+            for (; index + lanes.size() <= wordCount; index += lanes.size())
+                for (size_t lane{}; lane < lanes.size(); lane++)
+                    lanes[lane] = std::rotl((lanes[lane] ^ words[index + lane]) * Prime, 31);
+
+            u64 hash{size};
+            for (; index < wordCount; index++)
+                hash = std::rotl((hash ^ words[index]) * Prime, 31);
+            for (size_t byte{wordCount * sizeof(u64)}; byte < size; byte++)
+                hash = (hash ^ data[byte]) * Prime;
+            for (auto lane : lanes)
+                hash = std::rotl((hash ^ lane) * Prime, 31);
+
+            return hash;
+        }
     }
 
     /**
@@ -303,10 +346,109 @@ namespace skyline {
     span(const Container &) -> span<const typename Container::value_type>;
 
     /**
-     * @brief The Mutex class is a wrapper around an atomic bool used for low-contention synchronization
+     * @brief A vector with a fixed capacity that is stored inline, it never allocates and is used for containers with a known upper bound on hot paths
+     * @tparam T The type of the elements, it has to be default constructible as the storage for all elements always exists
+     * @tparam Capacity The maximum amount of elements the vector can hold
+     */
+    template<typename T, size_t Capacity>
+    class StaticVector {
+      private:
+        std::array<T, Capacity> storage; //!< The storage for the elements, only the first count elements are valid
+        size_t count{}; //!< The amount of elements in the vector
+
+      public:
+        using value_type = T;
+        using iterator = typename std::array<T, Capacity>::iterator;
+        using const_iterator = typename std::array<T, Capacity>::const_iterator;
+
+        template<typename... Args>
+        constexpr T &emplace_back(Args &&... args) {
+            if (count == Capacity)
+                throw exception("Trying to insert into a full StaticVector (Capacity: {})", Capacity);
+            return storage[count++] = T(std::forward<Args>(args)...);
+        }
+
+        constexpr void push_back(const T &value) {
+            emplace_back(value);
+        }
+
+        constexpr T &at(size_t index) {
+            if (index >= count)
+                throw exception("StaticVector index out of range: {} (Size: {})", index, count);
+            return storage[index];
+        }
+
+        constexpr const T &at(size_t index) const {
+            if (index >= count)
+                throw exception("StaticVector index out of range: {} (Size: {})", index, count);
+            return storage[index];
+        }
+
+        constexpr T &operator[](size_t index) {
+            return storage[index];
+        }
+
+        constexpr const T &operator[](size_t index) const {
+            return storage[index];
+        }
+
+        constexpr T *data() {
+            return storage.data();
+        }
+
+        constexpr const T *data() const {
+            return storage.data();
+        }
+
+        constexpr size_t size() const {
+            return count;
+        }
+
+        constexpr bool empty() const {
+            return count == 0;
+        }
+
+        constexpr void clear() {
+            count = 0;
+        }
+
+        constexpr iterator begin() {
+            return storage.begin();
+        }
+
+        constexpr iterator end() {
+            return storage.begin() + count;
+        }
+
+        constexpr const_iterator begin() const {
+            return storage.begin();
+        }
+
+        constexpr const_iterator end() const {
+            return storage.begin() + count;
+        }
+    };
+
+    /**
+     * @brief The Mutex class is a lightweight mutex for low-contention synchronization, it spins for a bounded duration prior to sleeping on a futex
+     * @note Waiters mark the mutex as contended before sleeping, so an uncontended unlock doesn't need a syscall
      */
     class Mutex {
-        std::atomic_flag flag = ATOMIC_FLAG_INIT; //!< An atomic flag to hold the state of the mutex
+      private:
+        enum State : u32 {
+            Unlocked = 0,
+            Locked = 1, //!< The mutex is locked and no threads are sleeping on it
+            Contended = 2, //!< The mutex is locked and threads might be sleeping on it
+        };
+
+        static constexpr size_t SpinCount{1000}; //!< The amount of times to spin on the mutex prior to sleeping on it, this covers short critical sections without a syscall
+
+        std::atomic<u32> state{Unlocked}; //!< The state of the mutex, it's used as a futex to sleep on
+
+        /**
+         * @brief Wakes a single thread sleeping on the mutex
+         */
+        void Wake();
 
       public:
         /**
@@ -319,19 +461,23 @@ namespace skyline {
          * @return If the mutex was successfully locked or not
          */
         inline bool try_lock() {
-            return !flag.test_and_set(std::memory_order_acquire);
+            u32 expected{Unlocked};
+            return state.compare_exchange_strong(expected, Locked, std::memory_order_acquire, std::memory_order_relaxed);
         }
 
         /**
          * @brief Unlock the mutex if it is held by this thread
          */
         inline void unlock() {
-            flag.clear(std::memory_order_release);
+            if (state.exchange(Unlocked, std::memory_order_release) == Contended)
+                Wake();
         }
     };
 
     /**
      * @brief The GroupMutex class is a special type of mutex that allows two groups of users and only allows one group to run in parallel
+     * @note Ownership is handed over to the other group once the holding group releases the mutex if the other group is waiting, new users of the holding group wait behind it, so neither group can starve the other
+     * @note Waiters sleep on a condition variable rather than spinning
      */
     class GroupMutex {
       public:
@@ -356,20 +502,26 @@ namespace skyline {
         void unlock();
 
       private:
-        std::atomic<Group> flag{Group::None}; //!< An atomic flag to hold which group holds the mutex
-        std::atomic<Group> next{Group::None}; //!< An atomic flag to hold which group will hold the mutex next
-        std::atomic<u8> num{}; //!< An atomic u8 keeping track of how many users are holding the mutex
-        Mutex mtx; //!< A mutex to lock before changing of num and flag
+        std::mutex mutex; //!< Synchronizes access to all state of the mutex
+        std::array<std::condition_variable, 2> conditions; //!< The conditions waiters of each group sleep on, they're signalled when ownership is handed over to the group
+        Group owner{Group::None}; //!< The group which holds the mutex, this is set on a handover prior to any waiters of the group taking it
+        u32 holders{}; //!< The amount of users holding the mutex
+        std::array<u32, 2> waiters{}; //!< The amount of users of each group waiting on the mutex
+        u32 handoverWaiters{}; //!< The amount of waiters which were admitted by the last handover and haven't taken the mutex yet, they're allowed in even if the other group is waiting
+
+        /**
+         * @return The index of a group into arrays that are indexed by group
+         */
+        static constexpr size_t GetIndex(Group group) {
+            return static_cast<size_t>(group) - 1;
+        }
     };
 
     /**
      * @brief The Logger class is to write log output to file and logcat
+     * @note Records are pushed into a lock-free ring and written out in batches by a dedicated writer thread, so logging threads never wait on I/O or on each other
      */
     class Logger {
-      private:
-        std::ofstream logFile; //!< An output stream to the log file
-        Mutex mtx; //!< A mutex to lock before logging anything
-
       public:
         enum class LogLevel {
             Error,
@@ -378,16 +530,79 @@ namespace skyline {
             Debug,
         };
 
-        LogLevel configLevel; //!< The minimum level of logs to write
+#ifdef SKYLINE_NO_DEBUG_LOGS
+        static constexpr bool DebugLogs{false}; //!< If Debug logs are compiled in, they're compiled out of builds with the DEBUG_LOGS CMake option disabled
+#else
+        static constexpr bool DebugLogs{true}; //!< If Debug logs are compiled in, they're compiled out of builds with the DEBUG_LOGS CMake option disabled
+#endif
+        static constexpr size_t MaxCompactArguments{4}; //!< The maximum amount of arguments of a compact record
+
+      private:
+        /**
+         * @brief A slot in the ring of records, its sequence determines if it's free to be written by a producer or ready to be read by the writer
+         */
+        struct Record {
+            std::atomic<size_t> sequence;
+            LogLevel level;
+            bool header; //!< If the record is a header rather than a regular log
+            std::string message;
+            const char *format; //!< The format string of a compact record or nullptr for records with a preformatted message
+            std::array<u64, MaxCompactArguments> arguments; //!< The arguments of a compact record, they're formatted by the writer thread
+        };
+
+        static constexpr size_t RingSize{0x1000}; //!< The amount of records in the ring, records which are logged while it's full are dropped
+        static constexpr size_t MaxBatchSize{0x10000}; //!< The size of the batch of formatted records after which it's written out to the file
+        static constexpr std::chrono::milliseconds WriterTimeout{50}; //!< The maximum duration the writer sleeps for before polling the ring, this is only a fallback as producers wake it up
+        static constexpr std::chrono::milliseconds FlushTimeout{500}; //!< The maximum duration an error log blocks for until it's flushed, this prevents a stalled writer from hanging the thread that logged it
+
+        std::ofstream logFile; //!< An output stream to the log file
+        bool logcat; //!< If records should be mirrored to logcat, this is done by the writer thread
+        std::array<Record, RingSize> ring;
+        alignas(64) std::atomic<size_t> enqueuePosition{}; //!< The position of the next record to be claimed by a producer
+        alignas(64) size_t dequeuePosition{}; //!< The position of the next record to be read by the writer, this is only accessed by the writer thread
+        std::atomic<size_t> dropCount{}; //!< The amount of records dropped since the writer last checked
+        std::atomic<size_t> flushedPosition{}; //!< The position up to which records have been written out and flushed to the file
+        std::atomic_bool writerWaiting{}; //!< If the writer is waiting on the condition, producers only notify it while this is set so they don't need to make a syscall for every record
+        std::atomic_bool running{true};
+        std::mutex writerMutex; //!< The mutex used by the writer while waiting on the condition, producers only lock it to notify the writer while it's waiting or to wait on a flush
+        std::condition_variable writerCondition;
+        std::condition_variable flushCondition; //!< Signalled by the writer whenever flushedPosition advances
+        std::thread writerThread;
+
+        /**
+         * @brief Claims the next free record in the ring for a producer to fill in
+         * @return The claimed record or nullptr if the ring is full, in which case the record is counted as dropped
+         */
+        Record *Claim(size_t &position);
+
+        /**
+         * @brief Makes a claimed record visible to the writer thread, error logs are waited on until they've been flushed to the file
+         */
+        void Publish(Record &record, size_t position);
+
+        /**
+         * @brief Appends every record that's ready in the ring to the batch, mirroring it to logcat if enabled
+         * @return If any records were read from the ring
+         */
+        bool Drain(std::string &batch);
+
+        /**
+         * @brief The loop of the writer thread, it writes out every record in batches until the logger is destroyed
+         */
+        void Run();
+
+      public:
+        std::atomic<LogLevel> configLevel; //!< The minimum level of logs to write, this can be changed by a per-title profile after the logger is created
 
         /**
          * @param path The path of the log file
          * @param configLevel The minimum level of logs to write
+         * @param logcat If logs should be mirrored to logcat
          */
-        Logger(const std::string &path, LogLevel configLevel);
+        Logger(const std::string &path, LogLevel configLevel, bool logcat = true);
 
         /**
-         * @brief Writes the termination message to the log file
+         * @brief Writes the termination message to the log file and stops the writer thread after all records have been written
          */
         ~Logger();
 
@@ -401,9 +616,27 @@ namespace skyline {
          * @brief Write a log to the log file
          * @param level The level of the log
          * @param str The value to be written
+         * @note This doesn't block unless it's an error log, the log is written out by the writer thread
          */
         void Write(LogLevel level, std::string str);
 
+        /**
+         * @brief Writes a compact log which is only formatted by the writer thread, this avoids formatting and allocating on the logging thread
+         * @param format The libfmt format string, it must have a static lifetime such as a string literal
+         * @param arguments The arguments of the format string, unused arguments are ignored
+         */
+        void WriteCompact(LogLevel level, const char *format, const std::array<u64, MaxCompactArguments> &arguments);
+
+        /**
+         * @return If logs of the given level are written, this can be used to skip any work done to build the arguments of a log
+         */
+        inline bool IsEnabled(LogLevel level) {
+            if constexpr (!DebugLogs)
+                if (level == LogLevel::Debug)
+                    return false;
+            return level <= configLevel;
+        }
+
         /**
          * @brief Write an error log with libfmt formatting
          * @param formatStr The value to be written, with libfmt formatting
@@ -447,8 +680,26 @@ namespace skyline {
          */
         template<typename S, typename... Args>
         inline void Debug(const S &formatStr, Args &&... args) {
-            if (LogLevel::Debug <= configLevel) {
-                Write(LogLevel::Debug, fmt::format(formatStr, args...));
+            if constexpr (DebugLogs) {
+                if (LogLevel::Debug <= configLevel) {
+                    Write(LogLevel::Debug, fmt::format(formatStr, args...));
+                }
+            }
+        }
+
+        /**
+         * @brief Write a debug log in the compact format, this should be used by call sites which are hit too frequently to format on the logging thread
+         * @param format The libfmt format string, it must have a static lifetime such as a string literal
+         * @param args Up to MaxCompactArguments integral arguments
+         */
+        template<typename... Args>
+        inline void DebugCompact(const char *format, Args... args) {
+            static_assert(sizeof...(Args) <= MaxCompactArguments, "Compact logs can only hold up to MaxCompactArguments arguments");
+            static_assert((std::is_integral_v<Args> && ...), "Compact logs can only hold integral arguments");
+            if constexpr (DebugLogs) {
+                if (LogLevel::Debug <= configLevel) {
+                    WriteCompact(LogLevel::Debug, format, {static_cast<u64>(args)...});
+                }
             }
         }
     };
@@ -462,6 +713,11 @@ namespace skyline {
         std::unordered_map<std::string, bool> boolMap; //!< A mapping from all keys to their corresponding boolean value
         std::unordered_map<std::string, int> intMap; //!< A mapping from all keys to their corresponding integer value
 
+        /**
+         * @brief Parses a preference XML file and sets all keys in it, any existing values of the keys are replaced
+         */
+        void Load(FILE *file);
+
       public:
         /**
          * @param fd An FD to the preference XML file
@@ -475,6 +731,12 @@ namespace skyline {
          */
         std::string GetString(const std::string &key);
 
+        /**
+         * @brief Retrieves a particular setting as a string or a fallback if the preference file doesn't contain it
+         * @param fallback The value to use for keys which were added after the preference file was written, this should match the default of the preference
+         */
+        std::string GetString(const std::string &key, const std::string &fallback);
+
         /**
          * @brief Retrieves a particular setting as a boolean
          * @param key The key of the setting
@@ -482,6 +744,12 @@ namespace skyline {
          */
         bool GetBool(const std::string &key);
 
+        /**
+         * @brief Retrieves a particular setting as a boolean or a fallback if the preference file doesn't contain it
+         * @param fallback The value to use for keys which were added after the preference file was written, this should match the default of the preference
+         */
+        bool GetBool(const std::string &key, bool fallback);
+
         /**
          * @brief Retrieves a particular setting as a integer
          * @param key The key of the setting
@@ -489,6 +757,20 @@ namespace skyline {
          */
         int GetInt(const std::string &key);
 
+        /**
+         * @brief Retrieves a particular string setting as an integer, this is used for list preferences as they're always stored as strings
+         * @param fallback The value to use if the preference file doesn't contain the key or its value isn't a valid integer
+         */
+        int GetStringInt(const std::string &key, int fallback);
+
+        /**
+         * @brief Overlays the settings of a per-title profile onto the current settings, only the keys present in the profile are replaced
+         * @param path The path to a profile, it's in the same XML format as the preference file
+         * @return If the profile exists and was applied
+         * @note This must only be called prior to the guest being started as settings aren't synchronized
+         */
+        bool ApplyProfile(const std::string &path);
+
         /**
          * @brief Writes all settings keys and values to syslog, this function is for development purposes
          */
@@ -497,6 +779,9 @@ namespace skyline {
 
     class NCE;
     class JvmManager;
+    class ThreadPool;
+    class PerformanceStatistics;
+    class Benchmark;
     namespace gpu {
         class GPU;
     }
@@ -521,12 +806,15 @@ namespace skyline {
      * @brief The state of the entire emulator is contained within this class, all objects related to emulation are tied into it
      */
     struct DeviceState {
-        DeviceState(kernel::OS *os, std::shared_ptr<kernel::type::KProcess> &process, std::shared_ptr<JvmManager> jvmManager, std::shared_ptr<Settings> settings, std::shared_ptr<Logger> logger);
+        DeviceState(kernel::OS *os, std::shared_ptr<kernel::type::KProcess> &process, std::shared_ptr<JvmManager> jvmManager, std::shared_ptr<Settings> settings, std::shared_ptr<Logger> logger, std::shared_ptr<Benchmark> benchmark = nullptr);
 
         kernel::OS *os;
         std::shared_ptr<kernel::type::KProcess> &process;
         thread_local static std::shared_ptr<kernel::type::KThread> thread; //!< The KThread of the thread which accesses this object
         thread_local static ThreadContext *ctx; //!< The context of the guest thread for the corresponding host thread
+        std::shared_ptr<PerformanceStatistics> statistics; //!< Performance counters which are updated by every subsystem, they're created first so they can be updated throughout the lifetime of all of them
+        std::shared_ptr<Benchmark> benchmark; //!< The headless benchmark which is being run, this is nullptr unless the application is run headless and it's assigned prior to all subsystems as they depend on it
+        std::shared_ptr<ThreadPool> threadPool; //!< A pool of workers shared by all subsystems for splitting up expensive work, this is destroyed after them so they can use it until they're destroyed
         std::shared_ptr<NCE> nce;
         std::shared_ptr<gpu::GPU> gpu;
         std::shared_ptr<audio::Audio> audio;
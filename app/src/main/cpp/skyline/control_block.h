@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline {
+    /**
+     * @brief The state of emulation as seen by the host
+     */
+    enum class RunState : u32 {
+        Stopped, //!< No application is being emulated
+        Running,
+        Paused, //!< The guest process is stopped as there's no surface to present to
+    };
+
+    /**
+     * @brief A block of state which is shared between native code and Kotlin through a direct ByteBuffer, so either side can poll it without any JNI calls
+     * @note Every field is a naturally aligned 32-bit value which is written atomically, Kotlin reads them at the offsets defined in EmulationActivity.kt
+     * @note Any changes to the layout must be mirrored in Kotlin
+     */
+    struct ControlBlock {
+        std::atomic<RunState> runState; //!< 0x0
+        std::atomic<u32> fps; //!< 0x4: The amount of frames presented in a second, based on the duration of the last frame
+        std::atomic<u32> frametime; //!< 0x8: The duration of the last frame in hundredths of a millisecond
+    };
+    static_assert(sizeof(ControlBlock) == 0xC);
+    static_assert(std::atomic<u32>::is_always_lock_free);
+}
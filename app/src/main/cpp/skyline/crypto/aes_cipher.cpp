@@ -1,9 +1,89 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_neon.h>
 #include "aes_cipher.h"
 
 namespace skyline::crypto {
+    constexpr size_t BlockSize{0x10};
+    constexpr size_t ParallelBlocks{8}; //!< The amount of blocks which are processed at once, this hides the latency of the AES instructions as the blocks are independent
+
+    /**
+     * @return The word with the AES S-box applied to each of its bytes, this is done with AESE on a vector of the duplicated word so ShiftRows has no effect
+     */
+    static u32 SubWord(u32 word) {
+        auto substituted{vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(word)), vdupq_n_u8(0))};
+        return vgetq_lane_u32(vreinterpretq_u32_u8(substituted), 0);
+    }
+
+    /**
+     * @brief Expands an AES-128 key into the 11 round keys used for encryption
+     */
+    static std::array<uint8x16_t, 11> ExpandKey(const u8 *key) {
+        constexpr std::array<u8, 10> RoundConstants{0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+
+        std::array<u32, 44> words;
+        std::memcpy(words.data(), key, BlockSize);
+        for (size_t index{4}; index < words.size(); index++) {
+            auto word{words[index - 1]};
+            if (index % 4 == 0)
+                word = SubWord(std::rotr(word, 8)) ^ RoundConstants[(index / 4) - 1];
+            words[index] = words[index - 4] ^ word;
+        }
+
+        std::array<uint8x16_t, 11> roundKeys;
+        for (size_t round{}; round < roundKeys.size(); round++)
+            roundKeys[round] = vreinterpretq_u8_u32(vld1q_u32(words.data() + (round * 4)));
+        return roundKeys;
+    }
+
+    template<size_t Count>
+    static inline void EncryptBlocks(std::array<uint8x16_t, Count> &blocks, const std::array<uint8x16_t, 11> &keys) {
+        for (size_t round{}; round < 9; round++)
+            for (auto &block : blocks)
+                block = vaesmcq_u8(vaeseq_u8(block, keys[round]));
+        for (auto &block : blocks)
+            block = veorq_u8(vaeseq_u8(block, keys[9]), keys[10]);
+    }
+
+    /**
+     * @note The keys must be the decryption keys of the equivalent inverse cipher
+     */
+    template<size_t Count>
+    static inline void DecryptBlocks(std::array<uint8x16_t, Count> &blocks, const std::array<uint8x16_t, 11> &keys) {
+        for (size_t round{}; round < 9; round++)
+            for (auto &block : blocks)
+                block = vaesimcq_u8(vaesdq_u8(block, keys[round]));
+        for (auto &block : blocks)
+            block = veorq_u8(vaesdq_u8(block, keys[9]), keys[10]);
+    }
+
+    /**
+     * @brief Multiplies an XTS tweak by x in GF(2^128), the tweak is a little-endian integer
+     */
+    static inline uint8x16_t MultiplyTweak(uint8x16_t tweak) {
+        auto words{vreinterpretq_u64_u8(tweak)};
+        u64 low{vgetq_lane_u64(words, 0)}, high{vgetq_lane_u64(words, 1)};
+        u64 carry{high >> 63};
+        high = (high << 1) | (low >> 63);
+        low = (low << 1) ^ (carry * 0x87);
+        return vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(low), vcreate_u64(high)));
+    }
+
+    static void StoreRoundKeys(const std::array<uint8x16_t, 11> &roundKeys, std::array<std::array<u8, BlockSize>, 11> &output) {
+        for (size_t round{}; round < roundKeys.size(); round++)
+            vst1q_u8(output[round].data(), roundKeys[round]);
+    }
+
+    static std::array<uint8x16_t, 11> LoadRoundKeys(const std::array<std::array<u8, BlockSize>, 11> &input) {
+        std::array<uint8x16_t, 11> roundKeys;
+        for (size_t round{}; round < roundKeys.size(); round++)
+            roundKeys[round] = vld1q_u8(input[round].data());
+        return roundKeys;
+    }
+
     AesCipher::AesCipher(span<u8> key, mbedtls_cipher_type_t type) {
         mbedtls_cipher_init(&decryptContext);
         if (mbedtls_cipher_setup(&decryptContext, mbedtls_cipher_info_from_type(type)) != 0)
@@ -11,6 +91,25 @@ namespace skyline::crypto {
 
         if (mbedtls_cipher_setkey(&decryptContext, key.data(), key.size() * 8, MBEDTLS_DECRYPT) != 0)
             throw exception("Failed to set key for decryption context");
+
+        mode = mbedtls_cipher_get_cipher_mode(&decryptContext);
+        hardware = (getauxval(AT_HWCAP) & HWCAP_AES) && ((type == MBEDTLS_CIPHER_AES_128_CTR && key.size() == BlockSize) || (type == MBEDTLS_CIPHER_AES_128_XTS && key.size() == BlockSize * 2));
+        if (hardware) {
+            if (mode == MBEDTLS_MODE_CTR) {
+                StoreRoundKeys(ExpandKey(key.data()), dataKeys); // CTR only ever encrypts the counter
+            } else {
+                // The first half of an XTS key decrypts the data and the second half encrypts the tweak, decryption uses the round keys in reverse with InvMixColumns applied to the inner ones
+                auto encryptionKeys{ExpandKey(key.data())};
+                std::array<uint8x16_t, 11> decryptionKeys;
+                decryptionKeys[0] = encryptionKeys[10];
+                for (size_t round{1}; round < 10; round++)
+                    decryptionKeys[round] = vaesimcq_u8(encryptionKeys[10 - round]);
+                decryptionKeys[10] = encryptionKeys[0];
+
+                StoreRoundKeys(decryptionKeys, dataKeys);
+                StoreRoundKeys(ExpandKey(key.data() + BlockSize), tweakKeys);
+            }
+        }
     }
 
     AesCipher::~AesCipher() {
@@ -20,9 +119,87 @@ namespace skyline::crypto {
     void AesCipher::SetIV(const std::array<u8, 0x10> &iv) {
         if (mbedtls_cipher_set_iv(&decryptContext, iv.data(), iv.size()) != 0)
             throw exception("Failed to set IV for decryption context");
+        this->iv = iv;
+    }
+
+    void AesCipher::HardwareDecrypt(u8 *destination, u8 *source, size_t size) {
+        auto keys{LoadRoundKeys(dataKeys)};
+        size_t offset{};
+
+        if (mode == MBEDTLS_MODE_CTR) {
+            // The counter is a 128-bit big-endian integer, it's held in host order so it can be incremented cheaply
+            u64 high, low;
+            std::memcpy(&high, iv.data(), sizeof(u64));
+            std::memcpy(&low, iv.data() + sizeof(u64), sizeof(u64));
+            high = __builtin_bswap64(high);
+            low = __builtin_bswap64(low);
+
+            auto nextCounter{[&]() {
+                auto counter{vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(__builtin_bswap64(high)), vcreate_u64(__builtin_bswap64(low))))};
+                if (++low == 0)
+                    high++;
+                return counter;
+            }};
+
+            for (; offset + (ParallelBlocks * BlockSize) <= size; offset += ParallelBlocks * BlockSize) {
+                std::array<uint8x16_t, ParallelBlocks> keystream;
+                for (auto &block : keystream)
+                    block = nextCounter();
+                EncryptBlocks(keystream, keys);
+
+                for (size_t index{}; index < ParallelBlocks; index++) {
+                    size_t blockOffset{offset + (index * BlockSize)};
+                    vst1q_u8(destination + blockOffset, veorq_u8(vld1q_u8(source + blockOffset), keystream[index]));
+                }
+            }
+
+            for (; offset < size; offset += BlockSize) {
+                std::array<uint8x16_t, 1> keystream{nextCounter()};
+                EncryptBlocks(keystream, keys);
+
+                if (size - offset >= BlockSize) {
+                    vst1q_u8(destination + offset, veorq_u8(vld1q_u8(source + offset), keystream[0]));
+                } else {
+                    std::array<u8, BlockSize> keystreamBytes;
+                    vst1q_u8(keystreamBytes.data(), keystream[0]);
+                    for (size_t index{}; index < size - offset; index++)
+                        destination[offset + index] = source[offset + index] ^ keystreamBytes[index];
+                }
+            }
+
+            high = __builtin_bswap64(high);
+            low = __builtin_bswap64(low);
+            std::memcpy(iv.data(), &high, sizeof(u64));
+            std::memcpy(iv.data() + sizeof(u64), &low, sizeof(u64));
+        } else {
+            std::array<uint8x16_t, 1> tweak{vld1q_u8(iv.data())};
+            EncryptBlocks(tweak, LoadRoundKeys(tweakKeys));
+
+            while (offset < size) {
+                size_t count{std::min(ParallelBlocks, (size - offset) / BlockSize)};
+                std::array<uint8x16_t, ParallelBlocks> tweaks, blocks{};
+                for (size_t index{}; index < count; index++) {
+                    tweaks[index] = tweak[0];
+                    tweak[0] = MultiplyTweak(tweak[0]);
+                    blocks[index] = veorq_u8(vld1q_u8(source + offset + (index * BlockSize)), tweaks[index]);
+                }
+
+                DecryptBlocks(blocks, keys); // Any blocks past count are decrypted but discarded, the partial batch only occurs at the end of the data unit
+
+                for (size_t index{}; index < count; index++)
+                    vst1q_u8(destination + offset + (index * BlockSize), veorq_u8(blocks[index], tweaks[index]));
+                offset += count * BlockSize;
+            }
+        }
     }
 
     void AesCipher::Decrypt(u8 *destination, u8 *source, size_t size) {
+        // The hardware implementation doesn't support ciphertext stealing, so XTS data units which aren't block-aligned use mbedtls
+        if (hardware && (mode == MBEDTLS_MODE_CTR || size % BlockSize == 0)) {
+            HardwareDecrypt(destination, source, size);
+            return;
+        }
+
         constexpr size_t maxBufferSize = 1024 * 1024; //!< Buffer shouldn't grow larger than 1 MiB
 
         std::optional<std::vector<u8>> buf{};
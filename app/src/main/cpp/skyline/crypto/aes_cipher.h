@@ -9,12 +9,27 @@
 namespace skyline::crypto {
     /**
      * @brief Wrapper for mbedtls for AES decryption using a cipher
+     * @note AES-128-CTR and AES-128-XTS are implemented with the ARMv8 Crypto Extensions when they're supported, mbedtls is used as a fallback
      */
     class AesCipher {
       private:
+        using Block = std::array<u8, 0x10>;
+        using RoundKeys = std::array<Block, 11>; //!< The expanded key schedule of AES-128
+
         mbedtls_cipher_context_t decryptContext;
         std::vector<u8> buffer; //!< A buffer used to avoid constant memory allocation
 
+        mbedtls_cipher_mode_t mode;
+        bool hardware{}; //!< If the cipher is implemented with the ARMv8 Crypto Extensions rather than mbedtls
+        RoundKeys dataKeys; //!< The round keys for the data, these are encryption keys for CTR and decryption keys for XTS
+        RoundKeys tweakKeys; //!< The round keys for encrypting the tweak of XTS
+        Block iv; //!< The IV of the hardware implementation, this is advanced past the decrypted blocks for CTR
+
+        /**
+         * @brief Decrypts the supplied data with the ARMv8 Crypto Extensions, this works in-place and on several blocks at once
+         */
+        void HardwareDecrypt(u8 *destination, u8 *source, size_t size);
+
         /**
          * @brief Calculates IV for XTS, basically just big to little endian conversion
          */
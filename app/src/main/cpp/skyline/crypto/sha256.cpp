@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_neon.h>
+#include <mbedtls/sha256.h>
+#include "sha256.h"
+
+namespace skyline::crypto {
+    constexpr size_t BlockSize{0x40};
+
+    constexpr std::array<u32, 64> RoundConstants{
+        0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+        0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+        0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+        0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+        0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+        0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+        0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+        0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+    };
+
+    /**
+     * @brief Compresses the supplied 64-byte blocks into the state with the ARMv8 SHA2 instructions
+     */
+    static void HardwareCompress(uint32x4_t &abcd, uint32x4_t &efgh, const u8 *data, size_t blockCount) {
+        for (; blockCount; blockCount--, data += BlockSize) {
+            auto savedAbcd{abcd}, savedEfgh{efgh};
+
+            std::array<uint32x4_t, 4> schedule;
+            for (size_t index{}; index < schedule.size(); index++)
+                schedule[index] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + index * 16))); // The message words are big-endian
+
+            // Every iteration does 4 rounds, the schedule is extended in place as every vector of words is only needed by the 4 iterations after it was used
+            for (size_t group{}; group < 16; group++) {
+                auto &words{schedule[group % 4]};
+                auto roundInput{vaddq_u32(words, vld1q_u32(RoundConstants.data() + group * 4))};
+                if (group < 12)
+                    words = vsha256su1q_u32(vsha256su0q_u32(words, schedule[(group + 1) % 4]), schedule[(group + 2) % 4], schedule[(group + 3) % 4]);
+
+                auto previousAbcd{abcd};
+                abcd = vsha256hq_u32(abcd, efgh, roundInput);
+                efgh = vsha256h2q_u32(efgh, previousAbcd, roundInput);
+            }
+
+            abcd = vaddq_u32(abcd, savedAbcd);
+            efgh = vaddq_u32(efgh, savedEfgh);
+        }
+    }
+
+    Sha256Hash Sha256(span<const u8> data) {
+        Sha256Hash hash;
+        static const bool hardware{(getauxval(AT_HWCAP) & HWCAP_SHA2) != 0};
+        if (!hardware) {
+            mbedtls_sha256_ret(data.data(), data.size(), hash.data(), 0);
+            return hash;
+        }
+
+        constexpr std::array<u32, 8> InitialState{0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+        auto abcd{vld1q_u32(InitialState.data())}, efgh{vld1q_u32(InitialState.data() + 4)};
+
+        size_t fullBlocks{data.size() / BlockSize};
+        HardwareCompress(abcd, efgh, data.data(), fullBlocks);
+
+        // The remaining data is followed by a set bit and the big-endian length of the data in bits, this spills into a second block if it doesn't fit after the data
+        std::array<u8, BlockSize * 2> tail{};
+        size_t remaining{data.size() % BlockSize};
+        std::memcpy(tail.data(), data.data() + fullBlocks * BlockSize, remaining);
+        tail[remaining] = 0x80;
+        size_t tailSize{remaining + 1 + sizeof(u64) > BlockSize ? BlockSize * 2 : BlockSize};
+        u64 bitLength{__builtin_bswap64(static_cast<u64>(data.size()) * 8)};
+        std::memcpy(tail.data() + tailSize - sizeof(u64), &bitLength, sizeof(u64));
+        HardwareCompress(abcd, efgh, tail.data(), tailSize / BlockSize);
+
+        vst1q_u8(hash.data(), vrev32q_u8(vreinterpretq_u8_u32(abcd)));
+        vst1q_u8(hash.data() + 16, vrev32q_u8(vreinterpretq_u8_u32(efgh)));
+        return hash;
+    }
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline::crypto {
+    using Sha256Hash = std::array<u8, 0x20>;
+
+    /**
+     * @return The SHA-256 hash of the supplied data
+     * @note This is implemented with the ARMv8 SHA2 instructions when they're supported, mbedtls is used as a fallback
+     */
+    Sha256Hash Sha256(span<const u8> data);
+}
@@ -3,76 +3,284 @@
 
 #include "gpu.h"
 #include "jvm.h"
+#include "trace.h"
+#include "statistics.h"
+#include "benchmark.h"
+#include "control_block.h"
+#include "os.h"
 #include <kernel/types/KProcess.h>
 #include <android/native_window_jni.h>
 
-extern bool Halt;
+extern std::atomic<bool> Halt;
 extern jobject Surface;
-extern skyline::u16 fps;
-extern skyline::u32 frametime;
+extern skyline::ControlBlock Control;
 
 namespace skyline::gpu {
-    GPU::GPU(const DeviceState &state) : state(state), memoryManager(state), gpfifo(state), fermi2D(std::make_shared<engine::Engine>(state)), keplerMemory(std::make_shared<engine::Engine>(state)), maxwell3D(std::make_shared<engine::Maxwell3D>(state)), maxwellCompute(std::make_shared<engine::Engine>(state)), maxwellDma(std::make_shared<engine::Engine>(state)), window(ANativeWindow_fromSurface(state.jvm->GetEnv(), Surface)), vsyncEvent(std::make_shared<kernel::type::KEvent>(state)), bufferEvent(std::make_shared<kernel::type::KEvent>(state)) {
-        ANativeWindow_acquire(window);
-        resolution.width = static_cast<u32>(ANativeWindow_getWidth(window));
-        resolution.height = static_cast<u32>(ANativeWindow_getHeight(window));
-        format = ANativeWindow_getFormat(window);
+    vk::UniqueInstance GPU::CreateInstance() {
+        vk::ApplicationInfo applicationInfo{"Skyline", VK_MAKE_VERSION(0, 3, 0), "Skyline", VK_MAKE_VERSION(0, 3, 0), VK_API_VERSION_1_0};
+        std::vector<const char *> extensions{VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_ANDROID_SURFACE_EXTENSION_NAME};
+        auto instanceExtensions{vk::enumerateInstanceExtensionProperties()};
+        auto properties2{std::any_of(instanceExtensions.begin(), instanceExtensions.end(), [](const vk::ExtensionProperties &extension) {
+            return std::strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+        })};
+        if (properties2)
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME); // This is required to query the properties of device extensions, such as the import alignment of VK_EXT_external_memory_host
+
+        vk::InstanceCreateInfo createInfo{};
+        createInfo.pApplicationInfo = &applicationInfo;
+        createInfo.enabledExtensionCount = static_cast<u32>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
+        return vk::createInstanceUnique(createInfo);
+    }
+
+    vk::PhysicalDevice GPU::SelectPhysicalDevice() {
+        auto physicalDevices{vkInstance->enumeratePhysicalDevices()};
+        if (physicalDevices.empty())
+            throw exception("Cannot find any Vulkan physical devices, the device's Vulkan driver might not be installed correctly");
+
+        for (const auto &physicalDevice : physicalDevices) {
+            auto queueFamilies{physicalDevice.getQueueFamilyProperties()};
+            bool queueSupported{std::any_of(queueFamilies.begin(), queueFamilies.end(), [](const vk::QueueFamilyProperties &family) {
+                constexpr vk::QueueFlags RequiredFlags{vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute};
+                return (family.queueFlags & RequiredFlags) == RequiredFlags;
+            })};
+
+            auto deviceExtensions{physicalDevice.enumerateDeviceExtensionProperties()};
+            bool swapchainSupported{std::any_of(deviceExtensions.begin(), deviceExtensions.end(), [](const vk::ExtensionProperties &extension) {
+                return std::strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+            })};
+
+            auto properties{physicalDevice.getProperties()};
+            if (queueSupported && swapchainSupported) {
+                state.logger->Info("Using Vulkan physical device: {}", &properties.deviceName[0]); // deviceName is a NUL-terminated string in a fixed-size array
+                return physicalDevice;
+            }
+            state.logger->Info("Skipping Vulkan physical device as it doesn't support {}: {}", !queueSupported ? "a graphics and compute queue" : VK_KHR_SWAPCHAIN_EXTENSION_NAME, &properties.deviceName[0]);
+        }
+
+        throw exception("Cannot find a Vulkan physical device with a graphics and compute queue and {} out of {} devices", VK_KHR_SWAPCHAIN_EXTENSION_NAME, physicalDevices.size());
+    }
+
+    vk::UniqueDevice GPU::CreateDevice() {
+        auto queueFamilies{vkPhysicalDevice.getQueueFamilyProperties()};
+        auto queueFamily{std::find_if(queueFamilies.begin(), queueFamilies.end(), [](const vk::QueueFamilyProperties &family) {
+            constexpr vk::QueueFlags RequiredFlags{vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute};
+            return (family.queueFlags & RequiredFlags) == RequiredFlags;
+        })};
+        if (queueFamily == queueFamilies.end())
+            throw exception("Cannot find a queue family with graphics and compute support");
+        vkQueueFamilyIndex = static_cast<u32>(std::distance(queueFamilies.begin(), queueFamily));
+
+        // Families which support transfers but not graphics or compute generally correspond to dedicated copy engines, uploads on them don't occupy the graphics queue
+        auto transferFamily{std::find_if(queueFamilies.begin(), queueFamilies.end(), [](const vk::QueueFamilyProperties &family) {
+            return (family.queueFlags & vk::QueueFlagBits::eTransfer) && !(family.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)) && family.queueCount;
+        })};
+        if (transferFamily != queueFamilies.end())
+            vkTransferQueueFamilyIndex = static_cast<u32>(std::distance(queueFamilies.begin(), transferFamily));
+
+        std::vector<const char *> extensions{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        auto deviceExtensions{vkPhysicalDevice.enumerateDeviceExtensionProperties()};
+        vkDisplayTiming = std::any_of(deviceExtensions.begin(), deviceExtensions.end(), [](const vk::ExtensionProperties &extension) {
+            return std::strcmp(extension.extensionName, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) == 0;
+        });
+        if (vkDisplayTiming)
+            extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+
+        auto hasExtension{[&deviceExtensions](const char *name) {
+            return std::any_of(deviceExtensions.begin(), deviceExtensions.end(), [name](const vk::ExtensionProperties &extension) {
+                return std::strcmp(extension.extensionName, name) == 0;
+            });
+        }};
+        vk::DispatchLoaderDynamic instanceDispatch(*vkInstance, vkGetInstanceProcAddr);
+        vkHostMemoryImport = instanceDispatch.vkGetPhysicalDeviceProperties2KHR && hasExtension(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME) && hasExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        if (vkHostMemoryImport) {
+            auto properties{vkPhysicalDevice.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>(instanceDispatch)};
+            vkHostImportAlignment = properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment;
+            extensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        }
+
+        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+        vkExtendedDynamicState = instanceDispatch.vkGetPhysicalDeviceFeatures2KHR && hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        if (vkExtendedDynamicState) {
+            // The extension being present doesn't imply support for the feature, so that has to be queried separately
+            auto features{vkPhysicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>(instanceDispatch)};
+            vkExtendedDynamicState = features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
+            if (vkExtendedDynamicState) {
+                extendedDynamicStateFeatures.extendedDynamicState = true;
+                extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+            }
+        }
+
+        vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+        vkTimelineSemaphore = instanceDispatch.vkGetPhysicalDeviceFeatures2KHR && hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        if (vkTimelineSemaphore) {
+            auto features{vkPhysicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>(instanceDispatch)};
+            vkTimelineSemaphore = features.get<vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>().timelineSemaphore;
+            if (vkTimelineSemaphore) {
+                timelineSemaphoreFeatures.timelineSemaphore = true;
+                extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            }
+        }
+
+        vk::PhysicalDeviceFeatures enabledFeatures{};
+        auto supportedFeatures{vkPhysicalDevice.getFeatures()};
+        vkTextureCompressionBc = supportedFeatures.textureCompressionBC;
+        enabledFeatures.textureCompressionBC = vkTextureCompressionBc;
+        vkPipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        enabledFeatures.pipelineStatisticsQuery = vkPipelineStatisticsQuery;
+        vkOcclusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+        enabledFeatures.occlusionQueryPrecise = vkOcclusionQueryPrecise;
+        vkSamplerAnisotropy = supportedFeatures.samplerAnisotropy;
+        enabledFeatures.samplerAnisotropy = vkSamplerAnisotropy;
+
+        float queuePriority{1.0f};
+        std::vector<vk::DeviceQueueCreateInfo> queueInfos{vk::DeviceQueueCreateInfo{{}, vkQueueFamilyIndex, 1, &queuePriority}};
+        if (vkTransferQueueFamilyIndex)
+            queueInfos.emplace_back(vk::DeviceQueueCreateFlags{}, *vkTransferQueueFamilyIndex, 1, &queuePriority);
+
+        vk::DeviceCreateInfo createInfo{};
+        createInfo.queueCreateInfoCount = static_cast<u32>(queueInfos.size());
+        createInfo.pQueueCreateInfos = queueInfos.data();
+        createInfo.enabledExtensionCount = static_cast<u32>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
+        createInfo.pEnabledFeatures = &enabledFeatures;
+
+        // The feature structures of all enabled extensions are chained in front of each other
+        void *features{};
+        if (vkExtendedDynamicState) {
+            extendedDynamicStateFeatures.pNext = features;
+            features = &extendedDynamicStateFeatures;
+        }
+        if (vkTimelineSemaphore) {
+            timelineSemaphoreFeatures.pNext = features;
+            features = &timelineSemaphoreFeatures;
+        }
+        createInfo.pNext = features;
+        return vkPhysicalDevice.createDeviceUnique(createInfo);
+    }
+
+    GPU::GPU(const DeviceState &state) : state(state), vkInstance(CreateInstance()), vkPhysicalDevice(SelectPhysicalDevice()), vkDevice(CreateDevice()), vkQueue(vkDevice->getQueue(vkQueueFamilyIndex, 0)), vkTransferQueue(vkTransferQueueFamilyIndex ? vkDevice->getQueue(*vkTransferQueueFamilyIndex, 0) : vk::Queue{}), vkDispatch(*vkInstance, vkGetInstanceProcAddr, *vkDevice, vkGetDeviceProcAddr), memoryManager(state), textureCache(state), pipelineCache(state, *this), scheduler(state), presentation(state, *this), frameLimiter(state), vsyncEvent(std::make_shared<kernel::type::KEvent>(state)), bufferEvent(std::make_shared<kernel::type::KEvent>(state)), graphicsContext(state, *this) {
+        ApplySettings();
+
+        if (vkTimelineSemaphore)
+            for (auto &syncpoint : syncpoints)
+                syncpoint.CreateSemaphore(*vkDevice, vkDispatch);
+
+        if (!state.benchmark)
+            presentation.UpdateSurface(ANativeWindow_fromSurface(state.jvm->GetEnv(), Surface));
         vsyncEvent->Signal();
     }
 
     GPU::~GPU() {
-        ANativeWindow_release(window);
+        scheduler.Stop();
     }
 
-    void GPU::Loop() {
-        gpfifo.Run();
-        vsyncEvent->Signal();
+    void GPU::ApplySettings() {
+        resolutionScale = static_cast<float>(std::clamp(state.settings->GetStringInt("resolution_scale", 100), 25, 400)) / 100.0f;
+        maxSkippedFrames = static_cast<u32>(std::max(state.settings->GetStringInt("frame_skip", 0), 0));
+        frameLimiter.ApplySettings();
+    }
 
-        if (surfaceUpdate) {
-            if (Surface == nullptr)
+    void GPU::QueuePresentation(u64 layerId, const std::shared_ptr<PresentationTexture> &texture) {
+        std::lock_guard guard(presentationMutex);
+        presentationQueue.push_back({layerId, texture, util::GetTimeNs()});
+        trace::SetCounter("Presentation Queue Depth", static_cast<i64>(presentationQueue.size()));
+        presentationCondition.notify_one();
+    }
+
+    void GPU::Loop() {
+        // Headless runs never have a surface, their frames are discarded by the null presenter instead
+        if (!state.benchmark) {
+            if (surfaceUpdate) {
+                if (Surface == nullptr)
+                    return;
+                presentation.UpdateSurface(ANativeWindow_fromSurface(state.jvm->GetEnv(), Surface));
+                surfaceUpdate = false;
+            } else if (Surface == nullptr) {
+                surfaceUpdate = true;
                 return;
-            window = ANativeWindow_fromSurface(state.jvm->GetEnv(), Surface);
-            ANativeWindow_acquire(window);
-            resolution.width = static_cast<u32>(ANativeWindow_getWidth(window));
-            resolution.height = static_cast<u32>(ANativeWindow_getHeight(window));
-            format = ANativeWindow_getFormat(window);
-            surfaceUpdate = false;
-        } else if (Surface == nullptr) {
-            surfaceUpdate = true;
-            return;
+            }
         }
 
-        if (!presentationQueue.empty()) {
-            auto &texture{presentationQueue.front()};
-            presentationQueue.pop();
+        u64 layerId{};
+        std::shared_ptr<PresentationTexture> texture;
+        std::function<void()> acquireCallback, releaseCallback;
+        u64 queueTimestamp{};
+        bool skip{};
+        {
+            // The wait is bounded so that surface changes and halting are still handled promptly while no frames are queued
+            constexpr std::chrono::milliseconds PresentationWaitTimeout{5};
+            std::unique_lock lock(presentationMutex);
+            if (presentationCondition.wait_for(lock, PresentationWaitTimeout, [this]() { return !presentationQueue.empty(); })) {
+                layerId = presentationQueue.front().layerId;
+                texture = presentationQueue.front().texture;
+                queueTimestamp = presentationQueue.front().timestamp;
+                presentationQueue.pop_front();
+                trace::SetCounter("Presentation Queue Depth", static_cast<i64>(presentationQueue.size()));
 
-            auto textureFormat{texture->GetAndroidFormat()};
-            if (resolution != texture->dimensions || textureFormat != format) {
-                ANativeWindow_setBuffersGeometry(window, texture->dimensions.width, texture->dimensions.height, textureFormat);
-                resolution = texture->dimensions;
-                format = textureFormat;
-            }
+                // The callbacks are copied as the guest can replace them as soon as the texture is released
+                acquireCallback = texture->acquireCallback;
+                releaseCallback = texture->releaseCallback;
 
-            ANativeWindow_Buffer windowBuffer;
-            ARect rect;
+                // A newer frame of the same layer being queued already means presentation can't keep up, so this one is dropped unless too many have been dropped in a row
+                skip = skippedFrames < maxSkippedFrames && std::any_of(presentationQueue.begin(), presentationQueue.end(), [layerId](const QueuedPresentation &queued) { return queued.layerId == layerId; });
+            }
+        }
 
-            ANativeWindow_lock(window, &windowBuffer, &rect);
-            std::memcpy(windowBuffer.bits, texture->backing.data(), texture->backing.size());
-            ANativeWindow_unlockAndPost(window);
+        if (texture)
+            state.statistics->queuedFrames.fetch_add(1, std::memory_order_relaxed);
 
+        if (texture && skip) {
+            // The frame is never synchronized to the host, it's only released so the guest's buffer queue and vsync pacing proceed as if it was shown
+            TRACE_SCOPE("GPU::SkipPresent");
+            if (acquireCallback)
+                acquireCallback();
+            if (releaseCallback)
+                releaseCallback();
             vsyncEvent->Signal();
-            texture->releaseCallback();
 
-            if (frameTimestamp) {
-                auto now{util::GetTimeNs()};
+            skippedFrames++;
+            state.statistics->skippedFrames.fetch_add(1, std::memory_order_relaxed);
+        } else if (texture) {
+            skippedFrames = 0;
+            TRACE_SCOPE("GPU::Present");
+
+            // Frames of layers above the lowest visible one are only retained for compositing, so they're neither limited nor measured as frames of their own
+            if (state.benchmark || presentation.IsBaseLayer(layerId))
+                frameLimiter.Limit();
+            auto presentStart{util::GetTimeNs()};
+            if (acquireCallback)
+                acquireCallback();
+            bool presented{true};
+            if (state.benchmark)
+                vsyncEvent->Signal(); // The null presenter discards the frame, vsync is signalled for every frame so the guest isn't paced to a display
+            else
+                presented = presentation.Present(layerId, texture);
+            if (releaseCallback)
+                releaseCallback();
 
-                frametime = static_cast<u32>((now - frameTimestamp) / 10000); // frametime / 100 is the real ms value, this is to retain the first two decimals
-                fps = static_cast<u16>(constant::NsInSecond / (now - frameTimestamp));
+            if (presented) {
+                if (state.statistics->boot.Mark(BootPhase::FirstFrame))
+                    state.logger->Info("{}", state.statistics->boot.Format());
 
+                auto now{util::GetTimeNs()};
+                state.statistics->presentLatency.Record(now - queueTimestamp);
+                state.os->performanceHint.AddWork(now - presentStart);
+                if (frameTimestamp) {
+                    Control.frametime.store(static_cast<u32>((now - frameTimestamp) / 10000), std::memory_order_relaxed); // frametime / 100 is the real ms value, this is to retain the first two decimals
+                    Control.fps.store(static_cast<u32>(constant::NsInSecond / (now - frameTimestamp)), std::memory_order_relaxed);
+                    state.statistics->frameTimes.Record(now - frameTimestamp);
+
+                    // The guest is paced to the display, so the work of a frame fits into the refreshes it's shown for unless it missed its deadline
+                    state.os->performanceHint.SetTargetDuration(presentation.GetFrameDuration());
+                }
+                state.os->performanceHint.ReportFrame();
                 frameTimestamp = now;
-            } else {
-                frameTimestamp = util::GetTimeNs();
             }
         }
+
+        if (state.benchmark)
+            state.benchmark->Update(texture && !skip);
     }
 }
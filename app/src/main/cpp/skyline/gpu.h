@@ -3,11 +3,20 @@
 
 #pragma once
 
-#include <android/native_window.h>
 #include "services/nvdrv/devices/nvmap.h"
 #include "gpu/gpfifo.h"
 #include "gpu/syncpoint.h"
+#include "gpu/texture_cache.h"
+#include "gpu/pipeline_cache.h"
+#include "gpu/graphics_context.h"
+#include "gpu/host_buffer.h"
+#include "gpu/presentation_engine.h"
+#include "gpu/frame_limiter.h"
+#include "gpu/engines/fermi_2d.h"
+#include "gpu/engines/kepler_memory.h"
 #include "gpu/engines/maxwell_3d.h"
+#include "gpu/engines/maxwell_compute.h"
+#include "gpu/engines/maxwell_dma.h"
 
 namespace skyline::gpu {
     /**
@@ -15,30 +24,98 @@ namespace skyline::gpu {
      */
     class GPU {
       private:
-        ANativeWindow *window; //!< The ANativeWindow that is presented to
         const DeviceState &state;
         bool surfaceUpdate{}; //!< If the surface needs to be updated
         u64 frameTimestamp{}; //!< The timestamp of the last frame being shown
+        u32 maxSkippedFrames{}; //!< The maximum amount of consecutive queued frames which are skipped when a newer frame is queued behind them, this is controlled by the "frame_skip" setting and is 0 if frames are never skipped
+        u32 skippedFrames{}; //!< The amount of consecutive frames which have been skipped
+
+        /**
+         * @brief Creates a Vulkan instance with the extensions required for presenting to an Android surface
+         */
+        static vk::UniqueInstance CreateInstance();
+
+        /**
+         * @return The first physical device with a queue family that supports graphics and compute operations and VK_KHR_swapchain, all queue families can present on Android so that's not checked separately
+         */
+        vk::PhysicalDevice SelectPhysicalDevice();
+
+        /**
+         * @brief Creates a logical device with a queue that supports graphics, compute and transfer operations and a dedicated transfer queue if the device exposes one, this sets vkQueueFamilyIndex, vkTransferQueueFamilyIndex, vkDisplayTiming, vkHostMemoryImport, vkHostImportAlignment, vkExtendedDynamicState, vkTextureCompressionBc, vkPipelineStatisticsQuery, vkOcclusionQueryPrecise and vkSamplerAnisotropy
+         */
+        vk::UniqueDevice CreateDevice();
 
       public:
-        std::queue<std::shared_ptr<PresentationTexture>> presentationQueue; //!< A queue of all the PresentationTextures to be posted to the display
-        texture::Dimensions resolution{}; //!< The resolution of the surface
-        i32 format{}; //!< The format of the display window
+        float resolutionScale{1.0f}; //!< The scale of the host resolution relative to the guest resolution, render targets, viewports, scissors and presented frames are all scaled by it
+
+        /**
+         * @return The dimensions scaled from the guest resolution to the host resolution, this is at least 1x1
+         */
+        texture::Dimensions ScaleDimensions(texture::Dimensions dimensions) {
+            return texture::Dimensions{std::max(static_cast<u32>(dimensions.width * resolutionScale), 1U), std::max(static_cast<u32>(dimensions.height * resolutionScale), 1U), dimensions.depth};
+        }
+
+        vk::UniqueInstance vkInstance;
+        vk::PhysicalDevice vkPhysicalDevice;
+        u32 vkQueueFamilyIndex{}; //!< The index of the queue family that vkQueue is from
+        std::optional<u32> vkTransferQueueFamilyIndex; //!< The index of the queue family that vkTransferQueue is from, this is only set if the device has a queue family which supports transfers but neither graphics nor compute
+        bool vkDisplayTiming{}; //!< If VK_GOOGLE_display_timing is supported and was enabled on vkDevice
+        bool vkHostMemoryImport{}; //!< If VK_EXT_external_memory_host is supported and was enabled on vkDevice, host memory can be imported into a HostBuffer when this is set
+        vk::DeviceSize vkHostImportAlignment{}; //!< The alignment of the address and size of all host memory that's imported
+        bool vkExtendedDynamicState{}; //!< If VK_EXT_extended_dynamic_state is supported and was enabled on vkDevice, the culling, depth and stencil state is dynamic when this is set
+        bool vkTimelineSemaphore{}; //!< If VK_KHR_timeline_semaphore is supported and was enabled on vkDevice, syncpoints are backed by timeline semaphores when this is set
+        bool vkTextureCompressionBc{}; //!< If the textureCompressionBC feature is supported and was enabled on vkDevice, BCn textures can't be sampled directly when this isn't set
+        bool vkPipelineStatisticsQuery{}; //!< If the pipelineStatisticsQuery feature is supported and was enabled on vkDevice, guest pipeline statistics counters always report zero when this isn't set
+        bool vkOcclusionQueryPrecise{}; //!< If the occlusionQueryPrecise feature is supported and was enabled on vkDevice, occlusion queries only report if any samples passed when this isn't set
+        bool vkSamplerAnisotropy{}; //!< If the samplerAnisotropy feature is supported and was enabled on vkDevice, guest samplers are created without anisotropic filtering when this isn't set
+        vk::UniqueDevice vkDevice;
+        vk::Queue vkQueue; //!< A queue which supports graphics, compute, transfer and presentation operations
+        std::mutex queueMutex; //!< Synchronizes all submissions and presentations to vkQueue as it's externally synchronized while it's used by multiple threads
+        vk::Queue vkTransferQueue; //!< A queue which is dedicated to transfers that run alongside work on vkQueue, this is only valid if vkTransferQueueFamilyIndex is set and it's also synchronized by queueMutex as waiting on the device requires that of all queues
+        vk::DispatchLoaderDynamic vkDispatch; //!< A dispatcher for extension functions which aren't exported by the Vulkan loader
+        std::mutex presentationMutex; //!< Synchronizes access to presentationQueue
+        std::condition_variable presentationCondition; //!< Signalled when a texture is pushed onto presentationQueue
+        /**
+         * @brief A PresentationTexture which has been queued by the guest along with the layer and when it was queued
+         */
+        struct QueuedPresentation {
+            u64 layerId; //!< The ID of the layer that the texture is a frame of
+            std::shared_ptr<PresentationTexture> texture;
+            u64 timestamp; //!< The time at which the texture was queued in nanoseconds, this is used to measure the latency of presentation
+        };
+        std::deque<QueuedPresentation> presentationQueue; //!< A queue of all the PresentationTextures of every layer to be posted to the display
         std::shared_ptr<kernel::type::KEvent> vsyncEvent; //!< This KEvent is triggered every time a frame is drawn
         std::shared_ptr<kernel::type::KEvent> bufferEvent; //!< This KEvent is triggered every time a buffer is freed
         vmm::MemoryManager memoryManager; //!< The GPU Virtual Memory Manager
-        std::shared_ptr<engine::Engine> fermi2D;
-        std::shared_ptr<engine::Maxwell3D> maxwell3D;
-        std::shared_ptr<engine::Engine> maxwellCompute;
-        std::shared_ptr<engine::Engine> maxwellDma;
-        std::shared_ptr<engine::Engine> keplerMemory;
-        gpfifo::GPFIFO gpfifo;
+        TextureCache textureCache;
+        PipelineCache pipelineCache;
+        gpfifo::Scheduler scheduler; //!< Runs the GPFIFOs of all channels, every channel owns its own GPFIFO and engines
+        PresentationEngine presentation;
+        FrameLimiter frameLimiter;
         std::array<Syncpoint, constant::MaxHwSyncpointCount> syncpoints{};
+        GraphicsContext graphicsContext; //!< This is declared after syncpoints so it's destroyed prior to them, as it increments them from its own thread
 
         GPU(const DeviceState &state);
 
+        /**
+         * @note The GPFIFO thread is stopped before any member is destroyed, as it records into graphicsContext which is destroyed prior to scheduler
+         */
         ~GPU();
 
+        /**
+         * @brief Reads the "resolution_scale", "frame_skip" and "frame_limit" settings again
+         * @note This must be called prior to the first frame being presented
+         */
+        void ApplySettings();
+
+        /**
+         * @brief Queues a frame of a layer to be presented, the texture's acquire callback is called when the presentation thread takes it off the queue
+         */
+        void QueuePresentation(u64 layerId, const std::shared_ptr<PresentationTexture> &texture);
+
+        /**
+         * @brief Presents the next queued frame to the surface if there is one, GPFIFO commands of all channels are processed separately on the GPFIFO thread
+         */
         void Loop();
     };
 }
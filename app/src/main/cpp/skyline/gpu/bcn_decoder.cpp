@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <arm_neon.h>
+#include <bit>
+#include "bcn_decoder.h"
+
+namespace skyline::gpu::texture {
+    constexpr u32 BlockSize{4}; //!< The width and height of all BCn blocks in pixels
+    using Tile = std::array<u8, BlockSize * BlockSize * 4>; //!< The RGBA8888 pixels of a single decoded block, the lines of the block are packed
+
+    bool IsBcnDecodable(Format format) {
+        return format == format::BC1RGBAUnorm || format == format::BC2Unorm || format == format::BC3Unorm || format == format::BC4Unorm || format == format::BC5Unorm || format == format::BC7Unorm;
+    }
+
+    /**
+     * @brief The offsets of the bytes of every pixel of a line of a BC1 block in its palette, indexed by the byte of the block's indices for the line
+     */
+    constexpr auto ColorLineOffsets{[] {
+        std::array<std::array<u8, 16>, 256> offsets{};
+        for (u32 indices{}; indices < offsets.size(); indices++)
+            for (u32 pixel{}; pixel < BlockSize; pixel++)
+                for (u32 channel{}; channel < 4; channel++)
+                    offsets[indices][(pixel * 4) + channel] = static_cast<u8>((((indices >> (pixel * 2)) & 0b11) * 4) + channel);
+        return offsets;
+    }()};
+
+    /**
+     * @brief Decodes the color part of a BC1, BC2 or BC3 block, every line is expanded from the palette by a single table lookup
+     * @param transparent If the block can use the 3-color mode with a transparent color, this is only the case for BC1
+     */
+    static void DecodeColorBlock(const u8 *block, Tile &tile, bool transparent) {
+        u16 color0{static_cast<u16>(block[0] | (block[1] << 8))}, color1{static_cast<u16>(block[2] | (block[3] << 8))};
+        auto expand{[](u16 color, u8 *pixel) {
+            u8 red{static_cast<u8>(color >> 11)}, green{static_cast<u8>((color >> 5) & 0x3F)}, blue{static_cast<u8>(color & 0x1F)};
+            pixel[0] = static_cast<u8>((red << 3) | (red >> 2));
+            pixel[1] = static_cast<u8>((green << 2) | (green >> 4));
+            pixel[2] = static_cast<u8>((blue << 3) | (blue >> 2));
+            pixel[3] = 0xFF;
+        }};
+
+        alignas(16) std::array<u8, 16> palette;
+        expand(color0, palette.data());
+        expand(color1, palette.data() + 4);
+        for (u32 channel{}; channel < 3; channel++) {
+            u32 endpoint0{palette[channel]}, endpoint1{palette[4 + channel]};
+            if (!transparent || color0 > color1) {
+                palette[8 + channel] = static_cast<u8>(((2 * endpoint0) + endpoint1 + 1) / 3);
+                palette[12 + channel] = static_cast<u8>((endpoint0 + (2 * endpoint1) + 1) / 3);
+            } else {
+                palette[8 + channel] = static_cast<u8>((endpoint0 + endpoint1) / 2);
+                palette[12 + channel] = 0;
+            }
+        }
+        palette[11] = 0xFF;
+        palette[15] = (!transparent || color0 > color1) ? 0xFF : 0x00;
+
+        auto table{vld1q_u8(palette.data())};
+        for (u32 line{}; line < BlockSize; line++)
+            vst1q_u8(tile.data() + (line * 16), vqtbl1q_u8(table, vld1q_u8(ColorLineOffsets[block[4 + line]].data())));
+    }
+
+    /**
+     * @brief Decodes a BC3/BC4/BC5 channel block which interpolates between two 8-bit endpoints with 3-bit indices
+     * @return The value of the channel for every pixel in the block
+     */
+    static uint8x16_t DecodeChannelBlock(const u8 *block) {
+        alignas(16) std::array<u8, 16> palette{};
+        u32 endpoint0{block[0]}, endpoint1{block[1]};
+        palette[0] = static_cast<u8>(endpoint0);
+        palette[1] = static_cast<u8>(endpoint1);
+        if (endpoint0 > endpoint1) {
+            for (u32 step{1}; step < 7; step++)
+                palette[1 + step] = static_cast<u8>((((7 - step) * endpoint0) + (step * endpoint1) + 3) / 7);
+        } else {
+            for (u32 step{1}; step < 5; step++)
+                palette[1 + step] = static_cast<u8>((((5 - step) * endpoint0) + (step * endpoint1) + 2) / 5);
+            palette[6] = 0x00;
+            palette[7] = 0xFF;
+        }
+
+        u64 indices{};
+        std::memcpy(&indices, block + 2, 6);
+        alignas(16) std::array<u8, 16> pixelIndices;
+        for (u32 pixel{}; pixel < pixelIndices.size(); pixel++)
+            pixelIndices[pixel] = static_cast<u8>((indices >> (pixel * 3)) & 0b111);
+
+        return vqtbl1q_u8(vld1q_u8(palette.data()), vld1q_u8(pixelIndices.data()));
+    }
+
+    /**
+     * @brief Decodes the explicit 4-bit alpha of a BC2 block
+     */
+    static uint8x16_t DecodeExplicitAlpha(const u8 *block) {
+        auto alpha{vld1_u8(block)}; // Every byte holds the alpha of two consecutive pixels, the first pixel is in the low nibble
+        auto pixels{vzip_u8(vand_u8(alpha, vdup_n_u8(0xF)), vshr_n_u8(alpha, 4))};
+        return vmulq_u8(vcombine_u8(pixels.val[0], pixels.val[1]), vdupq_n_u8(0x11)); // Multiplying by 17 expands 4 bits to 8 bits exactly
+    }
+
+    /**
+     * @brief Replaces a channel of every pixel in a decoded tile
+     */
+    static void ReplaceChannel(Tile &tile, u32 channel, uint8x16_t values) {
+        auto planes{vld4q_u8(tile.data())};
+        planes.val[channel] = values;
+        vst4q_u8(tile.data(), planes);
+    }
+
+    /**
+     * @brief The parameters of every BC7 mode, as covered by the BPTC section of the Khronos Data Format Specification
+     */
+    struct Bc7Mode {
+        u8 subsets;
+        u8 partitionBits;
+        u8 rotationBits;
+        u8 indexSelectionBits;
+        u8 colorBits; //!< The bits of every color channel of an endpoint, excluding P-bits
+        u8 alphaBits; //!< The bits of the alpha channel of an endpoint excluding P-bits, this is 0 if alpha is always 0xFF
+        u8 endpointPBits; //!< If every endpoint has its own P-bit
+        u8 sharedPBits; //!< If both endpoints of a subset share a P-bit
+        u8 indexBits;
+        u8 secondaryIndexBits; //!< The bits of the second set of indices, this is 0 if there isn't a second set
+    };
+
+    constexpr std::array<Bc7Mode, 8> Bc7Modes{{
+        {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+        {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+        {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+        {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+        {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+        {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+        {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+        {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+    }};
+
+    /**
+     * @brief The subset of every pixel in each of the 2-subset partitions, bit N is set if pixel N is in the second subset
+     */
+    constexpr std::array<u16, 64> Bc7Partitions2{
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    /**
+     * @brief The subset of every pixel in each of the 3-subset partitions, bits 2N and 2N+1 are the subset of pixel N
+     */
+    constexpr std::array<u32, 64> Bc7Partitions3{
+        0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+    };
+
+    /**
+     * @brief The anchor pixel of the second subset of every 2-subset partition, the first subset is always anchored at the first pixel
+     */
+    constexpr std::array<u8, 64> Bc7Anchors2{
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+    };
+
+    constexpr std::array<u8, 64> Bc7Anchors3Second{
+        3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+        3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+        8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+        3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+    };
+
+    constexpr std::array<u8, 64> Bc7Anchors3Third{
+        15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+        15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+        15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+        15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+    };
+
+    constexpr std::array<u8, 4> Bc7Weights2{0, 21, 43, 64};
+    constexpr std::array<u8, 8> Bc7Weights3{0, 9, 18, 27, 37, 46, 55, 64};
+    constexpr std::array<u8, 16> Bc7Weights4{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    /**
+     * @brief Reads consecutive fields out of a 128-bit block, starting from the least significant bit of the first byte
+     */
+    class BlockReader {
+      private:
+        u64 low;
+        u64 high;
+        u32 offset{};
+
+      public:
+        BlockReader(const u8 *block) {
+            std::memcpy(&low, block, sizeof(u64));
+            std::memcpy(&high, block + sizeof(u64), sizeof(u64));
+        }
+
+        u32 Read(u32 bits) {
+            if (!bits)
+                return 0;
+
+            u64 value{offset < 64 ? (low >> offset) : (high >> (offset - 64))};
+            if (offset < 64 && offset + bits > 64)
+                value |= high << (64 - offset);
+            offset += bits;
+            return static_cast<u32>(value & ((1ULL << bits) - 1));
+        }
+    };
+
+    static u8 InterpolateBc7(u32 endpoint0, u32 endpoint1, u32 index, u32 bits) {
+        u32 weight{bits == 2 ? Bc7Weights2[index] : (bits == 3 ? Bc7Weights3[index] : Bc7Weights4[index])};
+        return static_cast<u8>((((64 - weight) * endpoint0) + (weight * endpoint1) + 32) >> 6);
+    }
+
+    static void DecodeBc7Block(const u8 *block, Tile &tile) {
+        if (!block[0]) {
+            tile.fill(0); // Blocks with a reserved mode are decoded to transparent black
+            return;
+        }
+
+        auto modeIndex{static_cast<u32>(std::countr_zero(block[0]))};
+        auto &mode{Bc7Modes[modeIndex]};
+        BlockReader reader(block);
+        reader.Read(modeIndex + 1);
+
+        u32 partition{reader.Read(mode.partitionBits)};
+        u32 rotation{reader.Read(mode.rotationBits)};
+        u32 indexSelection{reader.Read(mode.indexSelectionBits)};
+
+        std::array<std::array<u32, 4>, 6> endpoints{}; // The RGBA channels of both endpoints of every subset
+        u32 endpointCount{mode.subsets * 2U};
+        for (u32 channel{}; channel < 3; channel++)
+            for (u32 endpoint{}; endpoint < endpointCount; endpoint++)
+                endpoints[endpoint][channel] = reader.Read(mode.colorBits);
+        if (mode.alphaBits)
+            for (u32 endpoint{}; endpoint < endpointCount; endpoint++)
+                endpoints[endpoint][3] = reader.Read(mode.alphaBits);
+
+        u32 channelCount{mode.alphaBits ? 4U : 3U};
+        auto applyPBit{[&](u32 endpoint, u32 pBit) {
+            for (u32 channel{}; channel < channelCount; channel++)
+                endpoints[endpoint][channel] = (endpoints[endpoint][channel] << 1) | pBit;
+        }};
+        if (mode.endpointPBits) {
+            for (u32 endpoint{}; endpoint < endpointCount; endpoint++)
+                applyPBit(endpoint, reader.Read(1));
+        } else if (mode.sharedPBits) {
+            for (u32 subset{}; subset < mode.subsets; subset++) {
+                auto pBit{reader.Read(1)};
+                applyPBit(subset * 2, pBit);
+                applyPBit((subset * 2) + 1, pBit);
+            }
+        }
+
+        // The endpoints are expanded to 8 bits by replicating their most significant bits into the low bits
+        u32 pBits{mode.endpointPBits || mode.sharedPBits ? 1U : 0U};
+        auto expand{[](u32 value, u32 bits) {
+            return (value << (8 - bits)) | (value >> ((2 * bits) - 8));
+        }};
+        for (u32 endpoint{}; endpoint < endpointCount; endpoint++) {
+            for (u32 channel{}; channel < 3; channel++)
+                endpoints[endpoint][channel] = expand(endpoints[endpoint][channel], mode.colorBits + pBits);
+            endpoints[endpoint][3] = mode.alphaBits ? expand(endpoints[endpoint][3], mode.alphaBits + pBits) : 0xFF;
+        }
+
+        auto subsetOf{[&](u32 pixel) -> u32 {
+            if (mode.subsets == 2)
+                return (Bc7Partitions2[partition] >> pixel) & 0b1;
+            else if (mode.subsets == 3)
+                return (Bc7Partitions3[partition] >> (pixel * 2)) & 0b11;
+            return 0;
+        }};
+
+        // The most significant bit of the index of the anchor pixel of every subset is implicitly 0, so it isn't stored
+        auto isAnchor{[&](u32 pixel) {
+            if (pixel == 0)
+                return true;
+            else if (mode.subsets == 2)
+                return pixel == Bc7Anchors2[partition];
+            else if (mode.subsets == 3)
+                return pixel == Bc7Anchors3Second[partition] || pixel == Bc7Anchors3Third[partition];
+            return false;
+        }};
+
+        std::array<u8, 16> indices, secondaryIndices{};
+        for (u32 pixel{}; pixel < indices.size(); pixel++)
+            indices[pixel] = static_cast<u8>(reader.Read(mode.indexBits - (isAnchor(pixel) ? 1 : 0)));
+        if (mode.secondaryIndexBits)
+            for (u32 pixel{}; pixel < secondaryIndices.size(); pixel++)
+                secondaryIndices[pixel] = static_cast<u8>(reader.Read(mode.secondaryIndexBits - (pixel == 0 ? 1 : 0)));
+
+        for (u32 pixel{}; pixel < indices.size(); pixel++) {
+            auto subset{subsetOf(pixel)};
+            auto &endpoint0{endpoints[subset * 2]}, &endpoint1{endpoints[(subset * 2) + 1]};
+
+            // Modes with a second set of indices use one set for color and the other for alpha, the index selection bit swaps them around
+            u32 colorIndex{indices[pixel]}, colorIndexBits{mode.indexBits}, alphaIndex{indices[pixel]}, alphaIndexBits{mode.indexBits};
+            if (mode.secondaryIndexBits) {
+                alphaIndex = secondaryIndices[pixel];
+                alphaIndexBits = mode.secondaryIndexBits;
+                if (indexSelection) {
+                    std::swap(colorIndex, alphaIndex);
+                    std::swap(colorIndexBits, alphaIndexBits);
+                }
+            }
+
+            auto output{tile.data() + (pixel * 4)};
+            for (u32 channel{}; channel < 3; channel++)
+                output[channel] = InterpolateBc7(endpoint0[channel], endpoint1[channel], colorIndex, colorIndexBits);
+            output[3] = InterpolateBc7(endpoint0[3], endpoint1[3], alphaIndex, alphaIndexBits);
+
+            if (rotation)
+                std::swap(output[3], output[rotation - 1]); // The rotation swaps alpha with the red, green or blue channel
+        }
+    }
+
+    void DecodeBcn(Format format, const u8 *source, size_t sourceStride, u8 *destination, size_t destinationStride, u32 width, u32 height) {
+        Tile tile;
+        auto decodeBlock{[&](const u8 *block) {
+            if (format == format::BC1RGBAUnorm) {
+                DecodeColorBlock(block, tile, true);
+            } else if (format == format::BC2Unorm) {
+                DecodeColorBlock(block + 8, tile, false);
+                ReplaceChannel(tile, 3, DecodeExplicitAlpha(block));
+            } else if (format == format::BC3Unorm) {
+                DecodeColorBlock(block + 8, tile, false);
+                ReplaceChannel(tile, 3, DecodeChannelBlock(block));
+            } else if (format == format::BC4Unorm) {
+                vst4q_u8(tile.data(), uint8x16x4_t{DecodeChannelBlock(block), vdupq_n_u8(0), vdupq_n_u8(0), vdupq_n_u8(0xFF)});
+            } else if (format == format::BC5Unorm) {
+                vst4q_u8(tile.data(), uint8x16x4_t{DecodeChannelBlock(block), DecodeChannelBlock(block + 8), vdupq_n_u8(0), vdupq_n_u8(0xFF)});
+            } else if (format == format::BC7Unorm) {
+                DecodeBc7Block(block, tile);
+            } else {
+                throw exception("Cannot decode a texture with format: {}", vk::to_string(format.vkFormat));
+            }
+        }};
+
+        for (u32 y{}; y < height; y += BlockSize) {
+            auto block{source + ((y / BlockSize) * sourceStride)};
+            auto lines{std::min(BlockSize, height - y)};
+            for (u32 x{}; x < width; x += BlockSize, block += format.bpb) {
+                decodeBlock(block);
+
+                // Blocks on the right or bottom edge are only partially written as the surface doesn't have to be a multiple of the block size
+                auto columns{std::min(BlockSize, width - x)};
+                auto output{destination + (y * destinationStride) + (x * 4)};
+                for (u32 line{}; line < lines; line++)
+                    std::memcpy(output + (line * destinationStride), tile.data() + (line * 16), columns * 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "format.h"
+
+namespace skyline::gpu::texture {
+    /**
+     * @return If the format is a BCn format which can be decoded into RGBA8888Unorm by DecodeBcn
+     * @note BC6H isn't decodable as its HDR values can't be represented in RGBA8888Unorm
+     */
+    bool IsBcnDecodable(Format format);
+
+    /**
+     * @brief Decodes a linear BCn surface into RGBA8888Unorm pixels on the CPU, this is used for textures which the device can't sample as it lacks the textureCompressionBC feature
+     * @param source The first row of blocks of the surface
+     * @param sourceStride The distance between two rows of blocks in bytes
+     * @param destination The first line of pixels of the decoded surface
+     * @param destinationStride The distance between two lines of pixels in bytes
+     * @param width The width of the surface in pixels, pixels of partial blocks beyond it aren't written
+     * @param height The height of the surface in pixels, this doesn't have to be a multiple of the block height
+     * @note The palettes of BC1-BC5 blocks are expanded with NEON table lookups, BC7 blocks are decoded one pixel at a time
+     */
+    void DecodeBcn(Format format, const u8 *source, size_t sourceStride, u8 *destination, size_t destinationStride, u32 width, u32 height);
+}
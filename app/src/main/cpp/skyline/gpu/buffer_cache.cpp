@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include <trace.h>
+#include "buffer_cache.h"
+
+namespace skyline::gpu {
+    BufferCache::BufferCache(const DeviceState &state, GPU &gpu, GraphicsContext &context) : state(state), gpu(gpu), context(context) {}
+
+    BufferCache::Buffer *BufferCache::FindBuffer(u64 address, u64 size) {
+        auto next{buffers.upper_bound(address)};
+        if (next == buffers.begin())
+            return nullptr;
+
+        auto &buffer{*std::prev(next)->second};
+        return (address + size <= buffer.address + buffer.size) ? &buffer : nullptr;
+    }
+
+    BufferCache::Buffer &BufferCache::CreateBuffer(u64 address, u64 size) {
+        u64 start{util::AlignDown(address, TrackingPageSize)}, end{util::AlignUp(address + size, TrackingPageSize)};
+
+        // All buffers which overlap the region are merged into the new buffer, this is rare as guests generally use the same regions for the same purposes
+        auto overlap{buffers.upper_bound(start)};
+        if (overlap != buffers.begin() && std::prev(overlap)->second->address + std::prev(overlap)->second->size > start)
+            overlap--;
+        while (overlap != buffers.end() && overlap->second->address < end) {
+            start = std::min(start, overlap->second->address);
+            end = std::max(end, overlap->second->address + overlap->second->size);
+            context.ReleaseWhenDone(std::move(overlap->second)); // The device might still be reading from the retired buffer
+            overlap = buffers.erase(overlap);
+        }
+
+        auto buffer{std::make_shared<Buffer>()};
+        buffer->address = start;
+        buffer->size = end - start;
+
+        auto &device{*gpu.vkDevice};
+        vk::BufferCreateInfo bufferInfo{};
+        bufferInfo.size = buffer->size;
+        bufferInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        // Buffers are shared concurrently with the transfer queue family, so uploads on it don't require ownership transfers
+        std::array<u32, 2> queueFamilies{gpu.vkQueueFamilyIndex, gpu.vkTransferQueueFamilyIndex.value_or(0)};
+        if (context.HasUploadQueue()) {
+            bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+            bufferInfo.queueFamilyIndexCount = static_cast<u32>(queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+        }
+        buffer->buffer = device.createBufferUnique(bufferInfo);
+
+        auto requirements{device.getBufferMemoryRequirements(*buffer->buffer)};
+        if (!memoryType) {
+            auto memoryProperties{gpu.vkPhysicalDevice.getMemoryProperties()};
+            for (u32 index{}; index < memoryProperties.memoryTypeCount; index++) {
+                if ((requirements.memoryTypeBits & (1U << index)) && (memoryProperties.memoryTypes[index].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+                    memoryType = index;
+                    break;
+                }
+            }
+            if (!memoryType)
+                throw exception("Cannot find a device-local memory type for buffers");
+        }
+
+        buffer->memory = device.allocateMemoryUnique(vk::MemoryAllocateInfo{requirements.size, *memoryType});
+        device.bindBufferMemory(*buffer->buffer, *buffer->memory, 0);
+
+        auto pageCount{buffer->size / TrackingPageSize};
+        buffer->pageHashes.resize(pageCount);
+        buffer->pageValid.resize(pageCount);
+        buffer->pageChecked.resize(pageCount, std::numeric_limits<u64>::max());
+
+        return *buffers.emplace(start, std::move(buffer)).first->second;
+    }
+
+    void BufferCache::Synchronize(Buffer &buffer, u64 address, u64 size) {
+        auto submission{context.GetSubmission()};
+        size_t firstPage{(address - buffer.address) / TrackingPageSize}, endPage{util::AlignUp(address + size - buffer.address, TrackingPageSize) / TrackingPageSize};
+        while (firstPage < endPage && buffer.pageChecked[firstPage] == submission)
+            firstPage++;
+        while (endPage > firstPage && buffer.pageChecked[endPage - 1] == submission)
+            endPage--;
+        if (firstPage == endPage)
+            return;
+
+        // The previous access is checked prior to updating it, as uploads on the transfer queue aren't ordered against in-flight work on the graphics queue
+        bool asynchronous{buffer.usedSubmission == std::numeric_limits<u64>::max() || context.IsSubmissionDone(buffer.usedSubmission)};
+        buffer.usedSubmission = submission;
+
+        TRACE_SCOPE("BufferCache::Synchronize");
+        gpu.memoryManager.Access(buffer.address + (firstPage * TrackingPageSize), (endPage - firstPage) * TrackingPageSize, false, [&](u8 *guest) {
+            auto pagePointer{[&](size_t page) { return guest + ((page - firstPage) * TrackingPageSize); }}; // The mapping only starts at the first page that's checked
+
+            // Only pages which weren't checked in this submission are hashed, consecutive dirty pages are coalesced into a single upload so buffers written as a whole are uploaded with a single copy
+            auto isDirty{[&](size_t page, u64 &hash) {
+                if (buffer.pageChecked[page] == submission)
+                    return false;
+                hash = util::HashMemory(pagePointer(page), TrackingPageSize);
+                buffer.pageChecked[page] = submission;
+                return !buffer.pageValid[page] || buffer.pageHashes[page] != hash;
+            }};
+
+            u64 hash{};
+            for (size_t page{firstPage}; page < endPage;) {
+                if (!isDirty(page, hash)) {
+                    page++;
+                    continue;
+                }
+
+                size_t runStart{page};
+                do {
+                    buffer.pageHashes[page] = hash;
+                    buffer.pageValid[page] = true;
+                } while (++page < endPage && (page - runStart) * TrackingPageSize < UploadChunkSize && isDirty(page, hash));
+
+                auto offset{runStart * TrackingPageSize}, runSize{(page - runStart) * TrackingPageSize};
+                context.UploadBuffer(span<u8>(pagePointer(runStart), runSize), *buffer.buffer, offset, asynchronous);
+                state.statistics->bufferUploadBytes.fetch_add(runSize, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    BufferCache::BufferView BufferCache::GetBuffer(u64 address, u64 size) {
+        auto buffer{FindBuffer(address, size)};
+        if (!buffer)
+            buffer = &CreateBuffer(address, size);
+
+        Synchronize(*buffer, address, size);
+        return BufferView{*buffer->buffer, address - buffer->address};
+    }
+
+    void BufferCache::Write(u64 address, span<u8> data) {
+        gpu.memoryManager.Write(data.data(), address, data.size());
+
+        // The write might straddle the end of a buffer or span several of them, so the part of it within every overlapping buffer is applied separately
+        auto submission{context.GetSubmission()};
+        u64 end{address + data.size()};
+        auto it{buffers.upper_bound(address)};
+        if (it != buffers.begin())
+            it--;
+        for (; it != buffers.end() && it->second->address < end; it++) {
+            auto &buffer{*it->second};
+            u64 start{std::max(address, buffer.address)}, limit{std::min(end, buffer.address + buffer.size)};
+            if (start >= limit)
+                continue;
+
+            context.UpdateBuffer(*buffer.buffer, start - buffer.address, span<u8>(data.data() + (start - address), limit - start));
+            buffer.usedSubmission = submission;
+
+            // The hashes of the written pages are updated so they aren't detected as having been written by the guest, this is only valid if they were up to date prior to the write
+            auto firstPage{(start - buffer.address) / TrackingPageSize}, lastPage{(limit - 1 - buffer.address) / TrackingPageSize};
+            for (auto page{firstPage}; page <= lastPage; page++) {
+                if (!buffer.pageValid[page] || buffer.pageChecked[page] != submission)
+                    continue;
+
+                gpu.memoryManager.Access(buffer.address + (page * TrackingPageSize), TrackingPageSize, false, [&](u8 *guest) {
+                    buffer.pageHashes[page] = util::HashMemory(guest, TrackingPageSize);
+                });
+            }
+        }
+    }
+}
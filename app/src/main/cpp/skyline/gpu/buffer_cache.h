@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <common.h>
+
+namespace skyline::gpu {
+    class GPU;
+    class GraphicsContext;
+
+    /**
+     * @brief The BufferCache maps regions of the GPU virtual address space used as vertex, index and constant buffers onto host buffers, so they're only uploaded again when the guest writes to them
+     * @note Guest writes are detected by hashing the tracked pages which a lookup covers, only pages with a different hash are uploaded; every page is hashed at most once per submission of the GraphicsContext as the guest can't observe the buffer being read in between
+     * @note Uploads are recorded on the transfer queue when no in-flight work accesses the buffer, this is the case for new buffers and ones that are only written to rarely
+     * @note Buffers which overlap are merged into a single buffer covering all of them, the retired buffers are kept alive until the device is done with them
+     * @note This must only be used by the thread which uses the GraphicsContext
+     */
+    class BufferCache {
+      private:
+        static constexpr u64 TrackingPageSize{PAGE_SIZE}; //!< The granularity at which guest writes are tracked and uploaded
+        static constexpr u64 UploadChunkSize{0x100000}; //!< The maximum size of a single upload from the streaming buffer, larger uploads are split so they always fit into a frame
+
+        /**
+         * @brief A host buffer which mirrors a region of the GPU virtual address space
+         */
+        struct Buffer {
+            u64 address; //!< The GPU address of the region, this is aligned to TrackingPageSize
+            u64 size; //!< The size of the region, this is aligned to TrackingPageSize
+            vk::UniqueBuffer buffer;
+            vk::UniqueDeviceMemory memory;
+            std::vector<u64> pageHashes; //!< The hash of every page from when it was last uploaded
+            std::vector<bool> pageValid; //!< If every page has been uploaded at all, pages which haven't are uploaded regardless of their hash
+            std::vector<u64> pageChecked; //!< The submission of the GraphicsContext in which every page was last checked for writes
+            u64 usedSubmission{std::numeric_limits<u64>::max()}; //!< The last submission of the GraphicsContext which accessed the buffer, uploads can only be asynchronous once the device is done with it
+        };
+
+        const DeviceState &state;
+        GPU &gpu;
+        GraphicsContext &context;
+        std::map<u64, std::shared_ptr<Buffer>> buffers; //!< All buffers keyed by their GPU address, these never overlap
+        std::optional<u32> memoryType; //!< The device-local memory type all buffers are allocated from, this is determined on the first allocation
+
+        /**
+         * @return The buffer which contains the entire region or nullptr if there's none
+         */
+        Buffer *FindBuffer(u64 address, u64 size);
+
+        /**
+         * @brief Creates a buffer for the supplied region, every buffer that overlaps it is merged into it and retired
+         */
+        Buffer &CreateBuffer(u64 address, u64 size);
+
+        /**
+         * @brief Uploads every page of a region of the buffer which the guest has written to since it was last uploaded, pages which were already checked in the current submission are skipped
+         */
+        void Synchronize(Buffer &buffer, u64 address, u64 size);
+
+      public:
+        /**
+         * @brief A region of a host buffer, this is only valid until the submission of the GraphicsContext changes as buffers that are retired by merging them are only kept alive until the device is done with it
+         */
+        struct BufferView {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+        };
+
+        BufferCache(const DeviceState &state, GPU &gpu, GraphicsContext &context);
+
+        /**
+         * @return The host buffer for a region of the GPU virtual address space, any pages of it that were written to by the guest are uploaded prior to this returning
+         * @note The upload is made visible to draws recorded after this, it must not be called while a render pass is active
+         */
+        BufferView GetBuffer(u64 address, u64 size);
+
+        /**
+         * @brief Writes data to the GPU virtual address space and in place to every host buffer overlapping it, so draws recorded after this read it without the buffers being checked for writes again
+         * @note This is used for constant buffer updates pushed through methods, draws recorded prior to this still read the previous data
+         */
+        void Write(u64 address, span<u8> data);
+    };
+}
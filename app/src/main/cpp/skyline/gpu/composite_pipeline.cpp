@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "composite_pipeline.h"
+
+namespace skyline::gpu {
+    /**
+     * @brief The SPIR-V of shaders/composite.vert and shaders/composite.frag, these are compiled by glslc at build time
+     */
+    constexpr u32 CompositeVertexShader[]
+#include "composite.vert.inc"
+    ;
+    constexpr u32 CompositeFragmentShader[]
+#include "composite.frag.inc"
+    ;
+
+    CompositePipeline::CompositePipeline(GPU &gpu, u32 maxSets) : gpu(gpu) {
+        auto &device{*gpu.vkDevice};
+
+        vertexShader = device.createShaderModuleUnique(vk::ShaderModuleCreateInfo{{}, sizeof(CompositeVertexShader), CompositeVertexShader});
+        fragmentShader = device.createShaderModuleUnique(vk::ShaderModuleCreateInfo{{}, sizeof(CompositeFragmentShader), CompositeFragmentShader});
+
+        vk::SamplerCreateInfo samplerInfo{};
+        samplerInfo.magFilter = vk::Filter::eLinear;
+        samplerInfo.minFilter = vk::Filter::eLinear;
+        samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        linearSampler = device.createSamplerUnique(samplerInfo);
+        samplerInfo.magFilter = vk::Filter::eNearest;
+        samplerInfo.minFilter = vk::Filter::eNearest;
+        nearestSampler = device.createSamplerUnique(samplerInfo);
+
+        vk::DescriptorSetLayoutBinding binding{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment};
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+        descriptorSetLayout = device.createDescriptorSetLayoutUnique(layoutInfo);
+
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
+        pipelineLayout = device.createPipelineLayoutUnique(pipelineLayoutInfo);
+
+        // Descriptor sets are freed individually as layers are created and destroyed at runtime
+        vk::DescriptorPoolSize poolSize{vk::DescriptorType::eCombinedImageSampler, maxSets};
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        descriptorPool = device.createDescriptorPoolUnique(poolInfo);
+    }
+
+    void CompositePipeline::SetFormat(vk::Format newFormat) {
+        if (renderPass && format == newFormat)
+            return;
+
+        auto &device{*gpu.vkDevice};
+
+        // The previous contents of the image are never required, it's cleared so any part of it that no layer is drawn over is black
+        vk::AttachmentDescription attachment{{}, newFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR};
+        vk::AttachmentReference colorReference{0, vk::ImageLayout::eColorAttachmentOptimal};
+        vk::SubpassDescription subpass{};
+        subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+
+        // The swapchain image's acquire semaphore is waited on in the color attachment output stage, so the layout transition of the image must wait on that stage as well
+        vk::SubpassDependency dependency{VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, {}, vk::AccessFlagBits::eColorAttachmentWrite};
+
+        vk::RenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        renderPass = device.createRenderPassUnique(renderPassInfo);
+        format = newFormat;
+
+        std::array<vk::PipelineShaderStageCreateInfo, 2> stages{
+            vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eVertex, *vertexShader, "main"},
+            vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eFragment, *fragmentShader, "main"},
+        };
+        vk::PipelineVertexInputStateCreateInfo vertexInputState{};
+        vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState{{}, vk::PrimitiveTopology::eTriangleList};
+
+        vk::PipelineViewportStateCreateInfo viewportState{};
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        vk::PipelineRasterizationStateCreateInfo rasterizationState{};
+        rasterizationState.polygonMode = vk::PolygonMode::eFill;
+        rasterizationState.cullMode = vk::CullModeFlagBits::eNone;
+        rasterizationState.lineWidth = 1.0f;
+
+        vk::PipelineMultisampleStateCreateInfo multisampleState{};
+        multisampleState.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+        vk::PipelineColorBlendAttachmentState blendAttachment{};
+        blendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+        vk::PipelineColorBlendStateCreateInfo colorBlendState{};
+        colorBlendState.attachmentCount = 1;
+        colorBlendState.pAttachments = &blendAttachment;
+
+        // The viewport and scissor are dynamic so the pipelines don't need to be recreated when only the extent of the swapchain changes
+        std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+        vk::PipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.dynamicStateCount = static_cast<u32>(dynamicStates.size());
+        dynamicState.pDynamicStates = dynamicStates.data();
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.stageCount = static_cast<u32>(stages.size());
+        pipelineInfo.pStages = stages.data();
+        pipelineInfo.pVertexInputState = &vertexInputState;
+        pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizationState;
+        pipelineInfo.pMultisampleState = &multisampleState;
+        pipelineInfo.pColorBlendState = &colorBlendState;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = *pipelineLayout;
+        pipelineInfo.renderPass = *renderPass;
+        opaquePipeline = gpu.pipelineCache.CreateGraphicsPipeline(pipelineInfo);
+
+        blendAttachment.blendEnable = true;
+        blendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        blendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        blendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+        blendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        blendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        blendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
+        blendPipeline = gpu.pipelineCache.CreateGraphicsPipeline(pipelineInfo);
+    }
+
+    vk::UniqueDescriptorSet CompositePipeline::AllocateDescriptorSet(vk::ImageView view, bool linear) {
+        vk::DescriptorSetAllocateInfo allocateInfo{};
+        allocateInfo.descriptorPool = *descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &*descriptorSetLayout;
+        auto descriptorSet{std::move(gpu.vkDevice->allocateDescriptorSetsUnique(allocateInfo).front())};
+
+        vk::DescriptorImageInfo imageInfo{linear ? *linearSampler : *nearestSampler, view, vk::ImageLayout::eShaderReadOnlyOptimal};
+        vk::WriteDescriptorSet write{};
+        write.dstSet = *descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        write.pImageInfo = &imageInfo;
+        gpu.vkDevice->updateDescriptorSets(write, {});
+
+        return descriptorSet;
+    }
+
+    void CompositePipeline::Record(vk::CommandBuffer commandBuffer, vk::Framebuffer framebuffer, vk::Extent2D extent, span<const vk::DescriptorSet> layers) {
+        vk::ClearValue clearValue{vk::ClearColorValue{std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}}};
+        vk::RenderPassBeginInfo beginInfo{*renderPass, framebuffer, vk::Rect2D{{}, extent}, 1, &clearValue};
+        commandBuffer.beginRenderPass(beginInfo, vk::SubpassContents::eInline);
+
+        commandBuffer.setViewport(0, vk::Viewport{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f});
+        commandBuffer.setScissor(0, vk::Rect2D{{}, extent});
+
+        for (size_t index{}; index < layers.size(); index++) {
+            // The pipeline only changes between the lowest layer and the one above it
+            if (index <= 1)
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, index ? *blendPipeline : *opaquePipeline);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipelineLayout, 0, layers[index], {});
+            commandBuffer.draw(3, 1, 0, 0);
+        }
+
+        commandBuffer.endRenderPass();
+    }
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <common.h>
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief A graphics pipeline which composites the layers of the display onto a swapchain image in a single render pass, every layer is drawn as a triangle that covers the entire image
+     * @note The lowest layer replaces the contents of the image while every layer above it is blended over the ones below by its alpha
+     */
+    class CompositePipeline {
+      private:
+        GPU &gpu;
+        vk::UniqueShaderModule vertexShader;
+        vk::UniqueShaderModule fragmentShader;
+        vk::UniqueSampler linearSampler;
+        vk::UniqueSampler nearestSampler; //!< The sampler used for layers in formats which don't support linear filtering
+        vk::UniqueDescriptorSetLayout descriptorSetLayout;
+        vk::UniquePipelineLayout pipelineLayout;
+        vk::UniqueDescriptorPool descriptorPool;
+        vk::Format format{}; //!< The format of the images that renderPass and the pipelines are compatible with
+        vk::UniqueRenderPass renderPass;
+        vk::UniquePipeline opaquePipeline; //!< The pipeline that the lowest layer is drawn with
+        vk::UniquePipeline blendPipeline; //!< The pipeline that all layers above the lowest one are drawn with
+
+      public:
+        /**
+         * @param maxSets The maximum amount of descriptor sets that can be allocated from the pipeline at once
+         */
+        CompositePipeline(GPU &gpu, u32 maxSets);
+
+        /**
+         * @brief Recreates the render pass and the pipelines for images of the supplied format, they're kept if they're compatible with it already
+         * @note This must not be called while any command buffer which uses the render pass is pending
+         */
+        void SetFormat(vk::Format newFormat);
+
+        vk::RenderPass GetRenderPass() {
+            return *renderPass;
+        }
+
+        /**
+         * @return A descriptor set which samples the supplied image view, it's freed back to the pipeline when it's destroyed
+         * @param linear If the view can be sampled with linear filtering, the nearest texel is sampled otherwise
+         */
+        vk::UniqueDescriptorSet AllocateDescriptorSet(vk::ImageView view, bool linear);
+
+        /**
+         * @brief Records compositing layers onto a framebuffer of the render pass, the framebuffer is transitioned into the layout for presentation by it
+         * @param layers The descriptor sets of the layers ordered from the lowest to the highest one, the framebuffer is cleared to black if this is empty
+         * @note The images of all layers must be in the shader read-only layout and visible to the fragment shader stage
+         */
+        void Record(vk::CommandBuffer commandBuffer, vk::Framebuffer framebuffer, vk::Extent2D extent, span<const vk::DescriptorSet> layers);
+    };
+}
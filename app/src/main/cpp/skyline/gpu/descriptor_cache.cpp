@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "format.h"
+#include "descriptor_cache.h"
+
+namespace skyline::gpu {
+    DescriptorCache::DescriptorCache(const DeviceState &state, GPU &gpu) : state(state), gpu(gpu) {}
+
+    std::pair<DescriptorCache::Descriptor, u64> DescriptorCache::ReadDescriptor(const Pool &pool, u32 index) {
+        auto descriptor{gpu.memoryManager.Read<Descriptor>(pool.address + (static_cast<u64>(index) * DescriptorSize))};
+        return {descriptor, util::HashMemory(reinterpret_cast<u8 *>(descriptor.data()), DescriptorSize)};
+    }
+
+    vk::UniqueSampler DescriptorCache::CreateSampler(const Descriptor &descriptor) {
+        auto convertWrap{[](u32 wrap) {
+            switch (wrap) {
+                case 0:
+                    return vk::SamplerAddressMode::eRepeat;
+                case 1:
+                    return vk::SamplerAddressMode::eMirroredRepeat;
+                case 3:
+                    return vk::SamplerAddressMode::eClampToBorder;
+                case 5:
+                case 6:
+                case 7:
+                    return vk::SamplerAddressMode::eMirroredRepeat; // The mirror-once modes require VK_KHR_sampler_mirror_clamp_to_edge, they only differ from mirrored repeat outside of [-1, 2]
+                default:
+                    return vk::SamplerAddressMode::eClampToEdge; // The legacy clamp mode which blends with the border is approximated by clamping to the edge
+            }
+        }};
+        auto convertFilter{[](u32 filter) {
+            return filter == 2 ? vk::Filter::eLinear : vk::Filter::eNearest;
+        }};
+        auto lod{[](u32 value) {
+            return static_cast<float>(value) / 256.0f;
+        }};
+
+        vk::SamplerCreateInfo samplerInfo{};
+        samplerInfo.addressModeU = convertWrap(descriptor[0] & 0x7);
+        samplerInfo.addressModeV = convertWrap((descriptor[0] >> 3) & 0x7);
+        samplerInfo.addressModeW = convertWrap((descriptor[0] >> 6) & 0x7);
+        samplerInfo.compareEnable = (descriptor[0] >> 9) & 0x1;
+        samplerInfo.compareOp = static_cast<vk::CompareOp>((descriptor[0] >> 10) & 0x7); // The guest comparison functions are in the same order as vk::CompareOp
+
+        auto anisotropy{(descriptor[0] >> 20) & 0x7};
+        if (anisotropy && gpu.vkSamplerAnisotropy) {
+            samplerInfo.anisotropyEnable = true;
+            samplerInfo.maxAnisotropy = std::min(static_cast<float>(1U << anisotropy), gpu.vkPhysicalDevice.getProperties().limits.maxSamplerAnisotropy);
+        }
+
+        samplerInfo.magFilter = convertFilter(descriptor[1] & 0x3);
+        samplerInfo.minFilter = convertFilter((descriptor[1] >> 4) & 0x3);
+
+        auto mipFilter{(descriptor[1] >> 6) & 0x3};
+        samplerInfo.mipmapMode = mipFilter == 3 ? vk::SamplerMipmapMode::eLinear : vk::SamplerMipmapMode::eNearest;
+        samplerInfo.mipLodBias = static_cast<float>(static_cast<i32>(descriptor[1] << 7) >> 19) / 256.0f; // A signed 13-bit value at bit 12
+        samplerInfo.minLod = lod(descriptor[2] & 0xFFF);
+        samplerInfo.maxLod = mipFilter == 1 ? samplerInfo.minLod : lod((descriptor[2] >> 12) & 0xFFF); // Only the base level is sampled without mip filtering
+
+        // Vulkan only supports a few preset border colors, the closest one to the guest's color is used
+        std::array<float, 4> border;
+        std::memcpy(border.data(), descriptor.data() + 4, sizeof(border));
+        bool white{border[0] >= 0.5f && border[1] >= 0.5f && border[2] >= 0.5f};
+        if (border[3] < 0.5f)
+            samplerInfo.borderColor = vk::BorderColor::eFloatTransparentBlack;
+        else
+            samplerInfo.borderColor = white ? vk::BorderColor::eFloatOpaqueWhite : vk::BorderColor::eFloatOpaqueBlack;
+
+        return gpu.vkDevice->createSamplerUnique(samplerInfo);
+    }
+
+    std::optional<DescriptorCache::TextureView> DescriptorCache::CreateTextureView(const Descriptor &descriptor) {
+        constexpr u32 ComponentUnorm{2}, ComponentFloat{7};
+        auto componentType{(descriptor[0] >> 7) & 0x7};
+
+        texture::Format guestFormat{};
+        switch (descriptor[0] & 0x7F) {
+            case 0x08:
+                guestFormat = componentType == ComponentUnorm ? format::RGBA8888Unorm : texture::Format{};
+                break;
+            case 0x03:
+                guestFormat = componentType == ComponentFloat ? format::RGBA16Float : texture::Format{};
+                break;
+            case 0x09:
+                guestFormat = format::RGB10A2Unorm;
+                break;
+            case 0x15:
+                guestFormat = format::RGB565Unorm;
+                break;
+            case 0x24:
+                guestFormat = format::BC1RGBAUnorm;
+                break;
+            case 0x25:
+                guestFormat = format::BC2Unorm;
+                break;
+            case 0x26:
+                guestFormat = format::BC3Unorm;
+                break;
+            case 0x27:
+                guestFormat = format::BC4Unorm;
+                break;
+            case 0x28:
+                guestFormat = format::BC5Unorm;
+                break;
+            case 0x10:
+                guestFormat = format::BC6HSfloat;
+                break;
+            case 0x11:
+                guestFormat = format::BC6HUfloat;
+                break;
+            case 0x17:
+                guestFormat = format::BC7Unorm;
+                break;
+            default:
+                break;
+        }
+        if (!guestFormat) {
+            state.logger->Warn("Unsupported TIC format: 0x{:X} (Component Type: {})", descriptor[0] & 0x7F, componentType);
+            return std::nullopt;
+        }
+
+        auto address{gpu.memoryManager.Translate((static_cast<u64>(descriptor[2] & 0xFFFF) << 32) | descriptor[1])};
+        if (!address)
+            return std::nullopt;
+
+        texture::Dimensions dimensions{(descriptor[4] & 0xFFFF) + 1, (descriptor[5] & 0xFFFF) + 1};
+        u32 depth{((descriptor[5] >> 16) & 0x3FFF) + 1};
+
+        auto tileMode{texture::TileMode::Linear};
+        texture::TileConfig tileConfig{};
+        switch ((descriptor[2] >> 21) & 0x7) {
+            case 2: // Pitch
+                tileMode = texture::TileMode::Pitch;
+                tileConfig.pitch = static_cast<u32>(((descriptor[3] & 0xFFFF) << 5) / guestFormat.bpb * guestFormat.blockWidth); // The guest pitch is in bytes while TileConfig::pitch is in pixels
+                break;
+            case 3: // Block Linear
+            case 4: // Block Linear with a color key
+                tileMode = texture::TileMode::Block;
+                tileConfig.blockHeight = static_cast<u8>(1U << ((descriptor[3] >> 3) & 0x7));
+                tileConfig.blockDepth = static_cast<u8>(1U << ((descriptor[3] >> 6) & 0x7));
+                break;
+            default:
+                break;
+        }
+
+        auto guest{std::make_shared<GuestTexture>(state, address, dimensions, guestFormat, tileMode, tileConfig)};
+        switch ((descriptor[4] >> 23) & 0xF) {
+            case 2: // 3D
+                guest->dimensions.depth = depth;
+                break;
+            case 3: // Cube
+                guest->layerCount = 6;
+                break;
+            case 4: // 1D Array
+            case 5: // 2D Array
+                guest->layerCount = depth;
+                break;
+            case 8: // Cube Array
+                guest->layerCount = depth * 6;
+                break;
+            default:
+                break;
+        }
+        guest->levelCount = ((descriptor[3] >> 28) & 0xF) + 1;
+
+        auto convertSwizzle{[](u32 source, texture::SwizzleChannel fallback) {
+            switch (source) {
+                case 0:
+                    return texture::SwizzleChannel::Zero;
+                case 2:
+                    return texture::SwizzleChannel::Red;
+                case 3:
+                    return texture::SwizzleChannel::Green;
+                case 4:
+                    return texture::SwizzleChannel::Blue;
+                case 5:
+                    return texture::SwizzleChannel::Alpha;
+                case 6: // One (Integer)
+                case 7: // One (Float)
+                    return texture::SwizzleChannel::One;
+                default:
+                    return fallback;
+            }
+        }};
+
+        return TextureView{
+            .texture = std::move(guest),
+            .swizzle = {
+                .red = convertSwizzle((descriptor[0] >> 19) & 0x7, texture::SwizzleChannel::Red),
+                .green = convertSwizzle((descriptor[0] >> 22) & 0x7, texture::SwizzleChannel::Green),
+                .blue = convertSwizzle((descriptor[0] >> 25) & 0x7, texture::SwizzleChannel::Blue),
+                .alpha = convertSwizzle((descriptor[0] >> 28) & 0x7, texture::SwizzleChannel::Alpha),
+            },
+        };
+    }
+
+    void DescriptorCache::SetPools(Pool newHeaderPool, Pool newSamplerPool) {
+        if (headerPool != newHeaderPool) {
+            headerPool = newHeaderPool;
+            textures.clear();
+            textureCount = headerPool.address ? static_cast<size_t>(std::min(headerPool.maximumIndex, MaxTextureIndex)) + 1 : 0; // The maximum index is supplied by the guest, it could otherwise be arbitrarily large
+        }
+
+        if (samplerPool != newSamplerPool) {
+            samplerPool = newSamplerPool;
+            samplers.clear();
+            samplerCount = samplerPool.address ? static_cast<size_t>(std::min(samplerPool.maximumIndex, MaxSamplerIndex)) + 1 : 0;
+        }
+    }
+
+    vk::Sampler DescriptorCache::GetSampler(u32 index) {
+        if (index >= samplerCount)
+            return {};
+        if (index >= samplers.size())
+            samplers.resize(index + 1);
+
+        auto [descriptor, hash]{ReadDescriptor(samplerPool, index)};
+        auto &entry{samplers[index]};
+        if (entry && entry->hash == hash)
+            return entry->object;
+
+        auto &sampler{samplerObjects[hash]};
+        if (!sampler)
+            sampler = CreateSampler(descriptor);
+        entry = Entry<vk::Sampler>{hash, *sampler};
+        return *sampler;
+    }
+
+    std::optional<DescriptorCache::TextureView> DescriptorCache::GetTexture(u32 index) {
+        if (index >= textureCount)
+            return std::nullopt;
+        if (index >= textures.size())
+            textures.resize(index + 1);
+
+        auto [descriptor, hash]{ReadDescriptor(headerPool, index)};
+        auto &entry{textures[index]};
+        if (entry && entry->hash == hash)
+            return entry->object;
+
+        auto view{CreateTextureView(descriptor)};
+        if (view)
+            entry = Entry<TextureView>{hash, *view};
+        else
+            entry.reset();
+        return view;
+    }
+}
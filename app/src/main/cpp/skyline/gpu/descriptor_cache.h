@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "texture.h"
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief The DescriptorCache maps entries of the TIC (Texture Image Control) and TSC (Texture Sampler Control) pools in guest memory onto host objects, so descriptors are only decoded again when the guest writes to them
+     * @note Every lookup reads the 0x20-byte descriptor and compares its hash against the cached one, this is far cheaper than decoding it or creating a host object from it
+     * @note Samplers are deduplicated by the hash of their descriptor, identical descriptors in different pools or at different indices share a single vk::Sampler
+     * @note This must only be used by the thread which uses the GraphicsContext
+     */
+    class DescriptorCache {
+      public:
+        /**
+         * @brief The location of a descriptor pool in the GPU virtual address space
+         */
+        struct Pool {
+            u64 address;
+            u32 maximumIndex; //!< The highest index of a valid descriptor in the pool
+
+            constexpr bool operator==(const Pool &) const = default;
+        };
+
+        /**
+         * @brief The guest texture which is described by a TIC entry alongside the swizzle it's sampled with
+         * @note Textures aren't backed by host images yet, so there's no vk::ImageView as there's nothing for one to view
+         */
+        struct TextureView {
+            std::shared_ptr<GuestTexture> texture;
+            texture::Swizzle swizzle;
+        };
+
+      private:
+        static constexpr size_t DescriptorSize{0x20}; //!< The size of a single TIC or TSC entry
+        static constexpr u32 MaxTextureIndex{(1U << 20) - 1}; //!< The highest TIC index which a texture handle can encode, it's 20 bits wide
+        static constexpr u32 MaxSamplerIndex{(1U << 12) - 1}; //!< The highest TSC index which a texture handle can encode, it's 12 bits wide
+
+        using Descriptor = std::array<u32, DescriptorSize / sizeof(u32)>;
+
+        /**
+         * @brief A decoded descriptor alongside the hash of the descriptor it was decoded from
+         */
+        template<typename Type>
+        struct Entry {
+            u64 hash;
+            Type object;
+        };
+
+        const DeviceState &state;
+        GPU &gpu;
+        Pool headerPool{}; //!< The TIC pool that textures are looked up in
+        Pool samplerPool{}; //!< The TSC pool that samplers are looked up in
+        size_t textureCount{}; //!< The amount of valid entries in the header pool, the guest-supplied maximum index is clamped to MaxTextureIndex
+        size_t samplerCount{}; //!< The amount of valid entries in the sampler pool, the guest-supplied maximum index is clamped to MaxSamplerIndex
+        std::vector<std::optional<Entry<TextureView>>> textures; //!< The decoded TIC entries indexed by their index in the header pool, this only grows up to the highest index that has been looked up
+        std::vector<std::optional<Entry<vk::Sampler>>> samplers; //!< The decoded TSC entries indexed by their index in the sampler pool, this only grows up to the highest index that has been looked up
+        std::unordered_map<u64, vk::UniqueSampler> samplerObjects; //!< All host samplers keyed by the hash of the descriptor they were created from, these are never destroyed as the amount of unique descriptors is small
+
+        /**
+         * @return The descriptor at the supplied index of a pool alongside its hash
+         */
+        std::pair<Descriptor, u64> ReadDescriptor(const Pool &pool, u32 index);
+
+        vk::UniqueSampler CreateSampler(const Descriptor &descriptor);
+
+        std::optional<TextureView> CreateTextureView(const Descriptor &descriptor);
+
+      public:
+        DescriptorCache(const DeviceState &state, GPU &gpu);
+
+        /**
+         * @brief Binds the pools which descriptors are looked up in, all cached entries of a pool are discarded when it's bound to a different location
+         */
+        void SetPools(Pool headerPool, Pool samplerPool);
+
+        /**
+         * @return The host sampler for the TSC entry at the supplied index, this is a null handle if the index is out of the pool's bounds
+         */
+        vk::Sampler GetSampler(u32 index);
+
+        /**
+         * @return The texture for the TIC entry at the supplied index, this is nullopt if the index is out of the pool's bounds or the entry uses an unsupported format
+         */
+        std::optional<TextureView> GetTexture(u32 index);
+    };
+}
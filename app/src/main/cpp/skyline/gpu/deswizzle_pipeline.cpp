@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "deswizzle_pipeline.h"
+
+namespace skyline::gpu {
+    /**
+     * @brief The SPIR-V of shaders/block_linear.comp, this is compiled by glslc at build time
+     */
+    constexpr u32 BlockLinearShader[]
+#include "block_linear.comp.inc"
+    ;
+
+    DeswizzlePipeline::DeswizzlePipeline(GPU &gpu, u32 maxSets) : gpu(gpu) {
+        auto &device{*gpu.vkDevice};
+
+        shaderModule = device.createShaderModuleUnique(vk::ShaderModuleCreateInfo{{}, sizeof(BlockLinearShader), BlockLinearShader});
+
+        std::array<vk::DescriptorSetLayoutBinding, 2> bindings{
+            vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.bindingCount = static_cast<u32>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        descriptorSetLayout = device.createDescriptorSetLayoutUnique(layoutInfo);
+
+        vk::PushConstantRange pushConstantRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(Parameters)};
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        pipelineLayout = device.createPipelineLayoutUnique(pipelineLayoutInfo);
+
+        vk::ComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.stage = vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eCompute, *shaderModule, "main"};
+        pipelineInfo.layout = *pipelineLayout;
+        pipeline = gpu.pipelineCache.CreateComputePipeline(pipelineInfo);
+
+        vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageBuffer, static_cast<u32>(bindings.size()) * maxSets};
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        descriptorPool = device.createDescriptorPoolUnique(poolInfo);
+    }
+
+    vk::DescriptorSet DeswizzlePipeline::AllocateDescriptorSet() {
+        vk::DescriptorSetAllocateInfo allocateInfo{};
+        allocateInfo.descriptorPool = *descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &*descriptorSetLayout;
+        return gpu.vkDevice->allocateDescriptorSets(allocateInfo).front();
+    }
+
+    void DeswizzlePipeline::Record(vk::CommandBuffer commandBuffer, vk::DescriptorSet descriptorSet, Texture &texture, vk::Buffer guestBuffer, vk::DeviceSize guestOffset, vk::DeviceSize guestSize, vk::Buffer hostBuffer, vk::DeviceSize hostOffset, vk::DeviceSize hostSize, texture::PixelConversion conversion) {
+        std::array<vk::DescriptorBufferInfo, 2> bufferInfos{
+            vk::DescriptorBufferInfo{guestBuffer, guestOffset, guestSize},
+            vk::DescriptorBufferInfo{hostBuffer, hostOffset, hostSize},
+        };
+        std::array<vk::WriteDescriptorSet, 2> writes{};
+        for (u32 binding{}; binding < writes.size(); binding++) {
+            auto &write{writes[binding]};
+            write.dstSet = descriptorSet;
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.pBufferInfo = &bufferInfos[binding];
+        }
+        gpu.vkDevice->updateDescriptorSets(writes, {});
+
+        Parameters parameters{
+            .hostStride = static_cast<u32>(texture.GetHostStride()),
+            .blockHeight = texture.guest->tileConfig.blockHeight,
+            .lines = texture.dimensions.height / texture.format.blockHeight,
+            .conversion = conversion,
+        };
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, descriptorSet, {});
+        commandBuffer.pushConstants(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Parameters), &parameters);
+        commandBuffer.dispatch(util::AlignUp(parameters.hostStride / 16, WorkgroupWidth) / WorkgroupWidth, util::AlignUp(parameters.lines, WorkgroupHeight) / WorkgroupHeight, 1);
+    }
+}
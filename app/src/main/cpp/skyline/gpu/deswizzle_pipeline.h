@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "pixel_conversion.h"
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief A compute pipeline which deswizzles block-linear surfaces into linear memory on the host GPU, the guest surface is uploaded to it unmodified
+     * @note Pixels can be converted by texture::PixelConversion in the same pass, this is used to present formats which Android surfaces don't support
+     */
+    class DeswizzlePipeline {
+      private:
+        GPU &gpu;
+        vk::UniqueShaderModule shaderModule;
+        vk::UniqueDescriptorSetLayout descriptorSetLayout;
+        vk::UniquePipelineLayout pipelineLayout;
+        vk::UniquePipeline pipeline;
+        vk::UniqueDescriptorPool descriptorPool;
+
+        /**
+         * @brief The push constants of the shader, these are derived from the texture::TileConfig and texture::Format of the surface
+         */
+        struct Parameters {
+            u32 hostStride; //!< The distance between two lines of the linear surface in bytes, this is the width of a ROB in bytes
+            u32 blockHeight; //!< The height of the blocks in GOBs
+            u32 lines; //!< The height of the surface in lines
+            texture::PixelConversion conversion; //!< The conversion applied to every pixel as it's deswizzled
+        };
+
+        static constexpr u32 WorkgroupWidth{16}; //!< The width of a workgroup in sectors, this must match the shader
+        static constexpr u32 WorkgroupHeight{4}; //!< The height of a workgroup in lines, this must match the shader
+
+      public:
+        /**
+         * @param maxSets The maximum amount of descriptor sets that can be allocated from the pipeline
+         */
+        DeswizzlePipeline(GPU &gpu, u32 maxSets);
+
+        /**
+         * @return A descriptor set that's compatible with the pipeline, it's valid for as long as the pipeline is
+         */
+        vk::DescriptorSet AllocateDescriptorSet();
+
+        /**
+         * @brief Records deswizzling a guest surface from one buffer region into another, the destination is laid out as described by Texture::GetHostStride()
+         * @param descriptorSet A descriptor set from AllocateDescriptorSet() which isn't used by any pending command buffer
+         * @param guestBuffer The buffer containing the guest surface, this can be guest memory which was imported into a HostBuffer
+         * @param conversion The conversion applied to every pixel, the stride of the destination is scaled by the ratio of the pixel sizes if it changes their size
+         * @note The destination region is written to in the compute shader stage, a barrier is required prior to reading it
+         */
+        void Record(vk::CommandBuffer commandBuffer, vk::DescriptorSet descriptorSet, Texture &texture, vk::Buffer guestBuffer, vk::DeviceSize guestOffset, vk::DeviceSize guestSize, vk::Buffer hostBuffer, vk::DeviceSize hostOffset, vk::DeviceSize hostSize, texture::PixelConversion conversion = texture::PixelConversion::None);
+    };
+}
@@ -45,6 +45,16 @@ namespace skyline::gpu {
             virtual void CallMethod(MethodParams params) {
                 state.logger->Warn("Called method in unimplemented engine: 0x{:X} args: 0x{:X}", params.method, params.argument);
             };
+
+            /**
+             * @brief Calls a sequence of engine methods from a single pushbuffer entry, the last argument is treated as the last call of the entry
+             * @param incrementing If the method is incremented after every argument, otherwise all arguments are for the same method
+             * @note Engines can override this to handle entire register ranges or data uploads at once, by default this is split into individual calls
+             */
+            virtual void CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) {
+                for (size_t index{}; index < arguments.size(); index++)
+                    CallMethod(MethodParams{static_cast<u16>(incrementing ? method + index : method), arguments[index], subChannel, index == arguments.size() - 1});
+            }
         };
     }
 }
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <arm_neon.h>
+#include <gpu.h>
+#include <gpu/gpfifo_trace.h>
+#include "fermi_2d.h"
+
+namespace skyline::gpu::engine {
+    using SurfaceFormat = Fermi2D::Registers::SurfaceFormat;
+
+    /**
+     * @return The size of a single pixel of the format in bytes or 0 if the format is unknown
+     */
+    static constexpr u32 GetBytesPerPixel(SurfaceFormat format) {
+        auto value{static_cast<u32>(format)};
+        if (value >= 0xC0 && value <= 0xC2)
+            return 16;
+        else if (value >= 0xC6 && value <= 0xCE)
+            return 8;
+        else if ((value >= 0xCF && value <= 0xE7) || value == 0xF9 || value == 0xFA)
+            return 4;
+        else if (value >= 0xE8 && value <= 0xF2)
+            return 2;
+        else if (value >= 0xF3 && value <= 0xF6)
+            return 1;
+        return 0;
+    }
+
+    /**
+     * @brief The order of the color components of a format with 8-bit RGBA components, formats in different orders can be converted between each other by swapping the red and blue components
+     */
+    enum class ComponentOrder {
+        Other, //!< The format isn't an 8-bit RGBA format
+        Rgba, //!< The components are laid out as R, G, B, A in memory
+        Bgra, //!< The components are laid out as B, G, R, A in memory
+    };
+
+    static constexpr ComponentOrder GetComponentOrder(SurfaceFormat format) {
+        switch (format) {
+            case SurfaceFormat::A8B8G8R8Unorm:
+            case SurfaceFormat::A8B8G8R8Srgb:
+            case SurfaceFormat::A8B8G8R8Snorm:
+            case SurfaceFormat::A8B8G8R8Sint:
+            case SurfaceFormat::A8B8G8R8Uint:
+            case SurfaceFormat::X8B8G8R8Unorm:
+            case SurfaceFormat::X8B8G8R8Srgb:
+                return ComponentOrder::Rgba;
+            case SurfaceFormat::B8G8R8A8Unorm:
+            case SurfaceFormat::B8G8R8A8Srgb:
+            case SurfaceFormat::X8R8G8B8Unorm:
+            case SurfaceFormat::X8R8G8B8Srgb:
+                return ComponentOrder::Bgra;
+            default:
+                return ComponentOrder::Other;
+        }
+    }
+
+    /**
+     * @return If the format has 8-bit unsigned normalized RGBA components, these can be filtered with the NEON bilinear filter
+     * @note sRGB formats are filtered without being linearized first
+     */
+    static constexpr bool IsUnorm8888(SurfaceFormat format) {
+        switch (format) {
+            case SurfaceFormat::A8B8G8R8Unorm:
+            case SurfaceFormat::A8B8G8R8Srgb:
+            case SurfaceFormat::X8B8G8R8Unorm:
+            case SurfaceFormat::X8B8G8R8Srgb:
+            case SurfaceFormat::B8G8R8A8Unorm:
+            case SurfaceFormat::B8G8R8A8Srgb:
+            case SurfaceFormat::X8R8G8B8Unorm:
+            case SurfaceFormat::X8R8G8B8Srgb:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Swaps the red and blue components of a line of 8-bit RGBA pixels in-place
+     */
+    static void SwapRedBlue(u8 *line, u32 width) {
+        u32 x{};
+        for (; x + 16 <= width; x += 16) {
+            auto pixels{vld4q_u8(line + (x * 4))};
+            std::swap(pixels.val[0], pixels.val[2]);
+            vst4q_u8(line + (x * 4), pixels);
+        }
+        for (; x < width; x++)
+            std::swap(line[(x * 4)], line[(x * 4) + 2]);
+    }
+
+    /**
+     * @brief Bilinearly filters four 8-bit RGBA pixels, every component is filtered in its own lane
+     * @param fx The horizontal weight of the right pixels as 1.7 fixed-point
+     * @param fy The vertical weight of the bottom pixels as 1.7 fixed-point
+     */
+    static FORCE_INLINE u32 FilterBilinear(u32 topLeft, u32 topRight, u32 bottomLeft, u32 bottomRight, u8 fx, u8 fy) {
+        auto top{vcreate_u8(static_cast<u64>(topLeft) | (static_cast<u64>(topRight) << 32))};
+        auto bottom{vcreate_u8(static_cast<u64>(bottomLeft) | (static_cast<u64>(bottomRight) << 32))};
+        auto vertical{vmlal_u8(vmull_u8(top, vdup_n_u8(128 - fy)), bottom, vdup_n_u8(fy))}; // The left pixel is in the lower half while the right pixel is in the upper half
+        auto horizontal{vmlal_n_u16(vmull_n_u16(vget_low_u16(vertical), 128 - fx), vget_high_u16(vertical), fx)};
+        auto narrowed{vrshrn_n_u32(horizontal, 14)}; // Both weights are 1.7 fixed-point, so the result has 14 fractional bits
+        return vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(narrowed, narrowed))), 0);
+    }
+
+    Fermi2D::Fermi2D(const DeviceState &state) : Engine(state) {}
+
+    void Fermi2D::CallMethod(MethodParams params) {
+        state.logger->Debug("Called method in Fermi 2D: 0x{:X} args: 0x{:X}", params.method, params.argument);
+
+        if (params.method >= constant::Fermi2DRegisterCounter) {
+            state.logger->Warn("Called out of range method in Fermi 2D: 0x{:X} args: 0x{:X}", params.method, params.argument);
+            return;
+        }
+
+        registers.raw[params.method] = params.argument;
+
+        if (params.method == FERMI2D_OFFSET(pixelsFromMemory.srcY0) + 1)
+            Blit();
+    }
+
+    void Fermi2D::Blit() {
+        auto &src{registers.src};
+        auto &dst{registers.dst};
+        auto &pixels{registers.pixelsFromMemory};
+
+        u32 bytesPerPixel{GetBytesPerPixel(src.format)};
+        if (!bytesPerPixel || !GetBytesPerPixel(dst.format))
+            throw exception("Fermi 2D blit with an unknown surface format: Source: 0x{:X}, Destination: 0x{:X}", static_cast<u32>(src.format), static_cast<u32>(dst.format));
+        if (bytesPerPixel != GetBytesPerPixel(dst.format))
+            throw exception("Fermi 2D blits between formats of different sizes are unimplemented: Source: 0x{:X}, Destination: 0x{:X}", static_cast<u32>(src.format), static_cast<u32>(dst.format));
+
+        auto srcOrder{GetComponentOrder(src.format)}, dstOrder{GetComponentOrder(dst.format)};
+        bool swapRedBlue{srcOrder != dstOrder && srcOrder != ComponentOrder::Other && dstOrder != ComponentOrder::Other};
+        if (src.format != dst.format && !swapRedBlue && (srcOrder == ComponentOrder::Other || dstOrder == ComponentOrder::Other))
+            state.logger->Warn("Fermi 2D conversion from 0x{:X} to 0x{:X} is unimplemented, the pixels are copied as-is", static_cast<u32>(src.format), static_cast<u32>(dst.format));
+
+        // The destination region is clipped to the destination surface, any clipped pixels shift the source region accordingly
+        i64 srcX0{pixels.srcX0}, srcY0{pixels.srcY0};
+        i64 dstX0{pixels.dstX0}, dstY0{pixels.dstY0}, dstWidth{pixels.dstWidth}, dstHeight{pixels.dstHeight};
+        if (dstX0 < 0) {
+            srcX0 -= dstX0 * pixels.duDx;
+            dstWidth += dstX0;
+            dstX0 = 0;
+        }
+        if (dstY0 < 0) {
+            srcY0 -= dstY0 * pixels.dvDy;
+            dstHeight += dstY0;
+            dstY0 = 0;
+        }
+        dstWidth = std::min<i64>(dstWidth, static_cast<i64>(dst.width) - dstX0);
+        dstHeight = std::min<i64>(dstHeight, static_cast<i64>(dst.height) - dstY0);
+        if (dstWidth <= 0 || dstHeight <= 0 || !src.width || !src.height)
+            return;
+
+        auto regionWidth{static_cast<u32>(dstWidth)}, regionHeight{static_cast<u32>(dstHeight)};
+        auto regionLine{regionWidth * bytesPerPixel}; // The size of a line of the destination region in bytes
+        auto srcLine{src.width * bytesPerPixel}, dstLine{dst.width * bytesPerPixel}; // The size of a line of the surfaces in bytes
+
+        auto &memoryManager{state.gpu->memoryManager};
+        auto getSurfaceRegion{[](Registers::Surface &surface, u32 bytesPerPixel) -> std::pair<u64, size_t> {
+            if (surface.memoryLayout == Registers::Surface::MemoryLayout::Pitch)
+                return {surface.address.Pack(), (static_cast<size_t>(surface.pitch) * (surface.height - 1)) + (surface.width * bytesPerPixel)};
+
+            if (surface.blockSize.depthLog2)
+                throw exception("Fermi 2D blits with a block depth of {} are unimplemented", 1U << surface.blockSize.depthLog2);
+            auto layerSize{texture::GetBlockLinearSize(surface.width * bytesPerPixel, surface.height, 1U << surface.blockSize.heightLog2)};
+            return {surface.address.Pack() + (layerSize * surface.layer), layerSize};
+        }};
+        auto srcRegion{getSurfaceRegion(src, bytesPerPixel)};
+        auto dstRegion{getSurfaceRegion(dst, bytesPerPixel)};
+
+        bool srcBlockLinear{src.memoryLayout == Registers::Surface::MemoryLayout::BlockLinear};
+        bool dstBlockLinear{dst.memoryLayout == Registers::Surface::MemoryLayout::BlockLinear};
+
+        memoryManager.Access(srcRegion.first, srcRegion.second, false, [&](u8 *srcMemory) {
+            if (auto trace{state.gpu->scheduler.GetTrace()})
+                trace->WriteMemory(srcRegion.first, span<const u8>(srcMemory, srcRegion.second)); // The source is captured, as replaying the blit can't rely on guest memory
+
+            // Block-linear sources are deswizzled in their entirety as the sampled region is arbitrary
+            std::vector<u8> srcBuffer;
+            u8 *srcBase{srcMemory};
+            size_t srcStride{src.pitch};
+            if (srcBlockLinear) {
+                srcBuffer.resize(static_cast<size_t>(srcLine) * src.height);
+                texture::CopyBlockLinearRegion<false>(srcMemory, srcLine, 1U << src.blockSize.heightLog2, 0, 0, srcBuffer.data(), srcLine, srcLine, src.height);
+                srcBase = srcBuffer.data();
+                srcStride = srcLine;
+            }
+
+            memoryManager.Access(dstRegion.first, dstRegion.second, true, [&](u8 *dstMemory) {
+                // Block-linear destinations are rendered into a temporary pitch-linear buffer which is swizzled into the surface afterwards
+                std::vector<u8> dstBuffer;
+                u8 *dstBase;
+                size_t dstStride;
+                if (dstBlockLinear) {
+                    dstBuffer.resize(static_cast<size_t>(regionLine) * regionHeight);
+                    dstBase = dstBuffer.data();
+                    dstStride = regionLine;
+                } else {
+                    dstBase = dstMemory + (dstY0 * dst.pitch) + (dstX0 * bytesPerPixel);
+                    dstStride = dst.pitch;
+                }
+
+                constexpr i64 One{1LL << 32}; // 1.0 as 32.32 fixed-point
+                i64 srcX{srcX0 >> 32}, srcY{srcY0 >> 32};
+                bool unscaled{pixels.duDx == One && pixels.dvDy == One && !(srcX0 & (One - 1)) && !(srcY0 & (One - 1))};
+                if (unscaled && srcX >= 0 && srcY >= 0 && srcX + regionWidth <= src.width && srcY + regionHeight <= src.height) {
+                    // Unscaled blits of regions within the source surface are straight copies of every line
+                    for (u32 y{}; y < regionHeight; y++)
+                        std::memcpy(dstBase + (y * dstStride), srcBase + ((srcY + y) * srcStride) + (srcX * bytesPerPixel), regionLine);
+                } else {
+                    bool center{pixels.sampleMode.origin == Registers::SampleMode::Origin::Center};
+                    auto sourcePosition{[center](i64 start, i64 step, u32 index) {
+                        return start + (step * index) + (center ? (step / 2) : 0); // The position of the sample in the source as 32.32 fixed-point
+                    }};
+
+                    if (pixels.sampleMode.filter == Registers::SampleMode::Filter::Bilinear && bytesPerPixel == 4 && IsUnorm8888(src.format)) {
+                        // The sample positions of every column are the same for all lines, so they're only calculated once
+                        struct Column {
+                            u32 left, right; //!< The offsets of the left and right source pixels in bytes
+                            u8 weight; //!< The weight of the right pixel as 1.7 fixed-point
+                        };
+                        std::vector<Column> columns(regionWidth);
+                        for (u32 x{}; x < regionWidth; x++) {
+                            auto position{sourcePosition(srcX0, pixels.duDx, x) - (center ? (One / 2) : 0)};
+                            auto left{std::clamp<i64>(position >> 32, 0, src.width - 1)};
+                            auto right{std::min<i64>(left + 1, src.width - 1)};
+                            columns[x] = {static_cast<u32>(left * 4), static_cast<u32>(right * 4), static_cast<u8>(position < 0 ? 0 : ((position & (One - 1)) >> 25))};
+                        }
+
+                        for (u32 y{}; y < regionHeight; y++) {
+                            auto position{sourcePosition(srcY0, pixels.dvDy, y) - (center ? (One / 2) : 0)};
+                            auto top{std::clamp<i64>(position >> 32, 0, src.height - 1)};
+                            auto bottom{std::min<i64>(top + 1, src.height - 1)};
+                            auto weight{static_cast<u8>(position < 0 ? 0 : ((position & (One - 1)) >> 25))};
+
+                            auto topLine{srcBase + (top * srcStride)}, bottomLine{srcBase + (bottom * srcStride)};
+                            auto line{reinterpret_cast<u32 *>(dstBase + (y * dstStride))};
+                            for (const auto &column : columns) {
+                                u32 topLeft, topRight, bottomLeft, bottomRight;
+                                std::memcpy(&topLeft, topLine + column.left, sizeof(u32));
+                                std::memcpy(&topRight, topLine + column.right, sizeof(u32));
+                                std::memcpy(&bottomLeft, bottomLine + column.left, sizeof(u32));
+                                std::memcpy(&bottomRight, bottomLine + column.right, sizeof(u32));
+                                *line++ = FilterBilinear(topLeft, topRight, bottomLeft, bottomRight, column.weight, weight);
+                            }
+                        }
+                    } else {
+                        if (pixels.sampleMode.filter == Registers::SampleMode::Filter::Bilinear)
+                            state.logger->Debug("Fermi 2D bilinear filtering of format 0x{:X} is unimplemented, it's point sampled instead", static_cast<u32>(src.format));
+
+                        std::vector<u32> columns(regionWidth); // The offset of the source pixel of every column in bytes
+                        for (u32 x{}; x < regionWidth; x++)
+                            columns[x] = static_cast<u32>(std::clamp<i64>(sourcePosition(srcX0, pixels.duDx, x) >> 32, 0, src.width - 1) * bytesPerPixel);
+
+                        for (u32 y{}; y < regionHeight; y++) {
+                            auto srcLinePointer{srcBase + (std::clamp<i64>(sourcePosition(srcY0, pixels.dvDy, y) >> 32, 0, src.height - 1) * srcStride)};
+                            auto dstLinePointer{dstBase + (y * dstStride)};
+                            for (auto column : columns) {
+                                std::memcpy(dstLinePointer, srcLinePointer + column, bytesPerPixel);
+                                dstLinePointer += bytesPerPixel;
+                            }
+                        }
+                    }
+                }
+
+                if (swapRedBlue)
+                    for (u32 y{}; y < regionHeight; y++)
+                        SwapRedBlue(dstBase + (y * dstStride), regionWidth);
+
+                if (dstBlockLinear)
+                    texture::CopyBlockLinearRegion<true>(dstMemory, dstLine, 1U << dst.blockSize.heightLog2, static_cast<u32>(dstX0) * bytesPerPixel, static_cast<u32>(dstY0), dstBase, regionLine, regionLine, regionHeight);
+            });
+        });
+
+        state.gpu->textureCache.InvalidateGpu(dstRegion.first, dstRegion.second);
+    }
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "engine.h"
+
+#define FERMI2D_OFFSET(field) U32_OFFSET(skyline::gpu::engine::Fermi2D::Registers, field)
+
+namespace skyline {
+    namespace constant {
+        constexpr u32 Fermi2DRegisterCounter{0x258}; //!< The number of Fermi 2D registers
+    }
+
+    namespace gpu::engine {
+        /**
+         * @brief The Fermi 2D engine (Class 902D) blits between surfaces with optional scaling and format conversion
+         * @url https://github.com/devkitPro/deko3d/blob/master/source/maxwell/engine_2d.def
+         */
+        class Fermi2D : public Engine {
+          public:
+#pragma pack(push, 1)
+            union Registers {
+                std::array<u32, constant::Fermi2DRegisterCounter> raw;
+
+                struct Address {
+                    u32 high;
+                    u32 low;
+
+                    u64 Pack() {
+                        return (static_cast<u64>(high) << 32) | low;
+                    }
+                };
+                static_assert(sizeof(Address) == sizeof(u64));
+
+                /**
+                 * @brief The formats of a surface, these are the same as the render target formats of the Maxwell 3D engine
+                 * @note Formats with the components in the order of A8B8G8R8 are laid out as R8G8B8A8 in memory, as the names are from the MSB to the LSB
+                 */
+                enum class SurfaceFormat : u32 {
+                    R32G32B32A32Float = 0xC0,
+                    R32G32B32A32Sint = 0xC1,
+                    R32G32B32A32Uint = 0xC2,
+                    R16G16B16A16Unorm = 0xC6,
+                    R16G16B16A16Snorm = 0xC7,
+                    R16G16B16A16Sint = 0xC8,
+                    R16G16B16A16Uint = 0xC9,
+                    R16G16B16A16Float = 0xCA,
+                    R32G32Float = 0xCB,
+                    R32G32Sint = 0xCC,
+                    R32G32Uint = 0xCD,
+                    R16G16B16X16Float = 0xCE,
+                    B8G8R8A8Unorm = 0xCF,
+                    B8G8R8A8Srgb = 0xD0,
+                    A2B10G10R10Unorm = 0xD1,
+                    A2B10G10R10Uint = 0xD2,
+                    A8B8G8R8Unorm = 0xD5,
+                    A8B8G8R8Srgb = 0xD6,
+                    A8B8G8R8Snorm = 0xD7,
+                    A8B8G8R8Sint = 0xD8,
+                    A8B8G8R8Uint = 0xD9,
+                    R16G16Unorm = 0xDA,
+                    R16G16Snorm = 0xDB,
+                    R16G16Sint = 0xDC,
+                    R16G16Uint = 0xDD,
+                    R16G16Float = 0xDE,
+                    B10G11R11Float = 0xE0,
+                    R32Sint = 0xE3,
+                    R32Uint = 0xE4,
+                    R32Float = 0xE5,
+                    X8R8G8B8Unorm = 0xE6,
+                    X8R8G8B8Srgb = 0xE7,
+                    R5G6B5Unorm = 0xE8,
+                    A1R5G5B5Unorm = 0xE9,
+                    R8G8Unorm = 0xEA,
+                    R8G8Snorm = 0xEB,
+                    R8G8Sint = 0xEC,
+                    R8G8Uint = 0xED,
+                    R16Unorm = 0xEE,
+                    R16Snorm = 0xEF,
+                    R16Sint = 0xF0,
+                    R16Uint = 0xF1,
+                    R16Float = 0xF2,
+                    R8Unorm = 0xF3,
+                    R8Snorm = 0xF4,
+                    R8Sint = 0xF5,
+                    R8Uint = 0xF6,
+                    X8B8G8R8Unorm = 0xF9,
+                    X8B8G8R8Srgb = 0xFA,
+                };
+
+                struct Surface {
+                    enum class MemoryLayout : u32 {
+                        BlockLinear = 0,
+                        Pitch = 1,
+                    };
+
+                    SurfaceFormat format;
+                    MemoryLayout memoryLayout;
+                    struct {
+                        u8 widthLog2 : 4; //!< The width of the blocks in GOBs, this is always 1 on the Tegra X1
+                        u8 heightLog2 : 4; //!< The height of the blocks in GOBs
+                        u8 depthLog2 : 4; //!< The depth of the blocks in GOBs
+                        u8 _pad0_ : 4;
+                        u16 _pad1_;
+                    } blockSize;
+                    u32 depth;
+                    u32 layer;
+                    u32 pitch; //!< The distance between two lines of a pitch-linear surface in bytes
+                    u32 width; //!< The width of the surface in pixels
+                    u32 height; //!< The height of the surface in pixels
+                    Address address;
+                };
+                static_assert(sizeof(Surface) == (0xA * sizeof(u32)));
+
+                struct SampleMode {
+                    enum class Origin : u8 {
+                        Center = 0, //!< Pixels are sampled at their centers
+                        Corner = 1, //!< Pixels are sampled at their top-left corners
+                    };
+
+                    enum class Filter : u8 {
+                        Point = 0,
+                        Bilinear = 1,
+                    };
+
+                    Origin origin : 1;
+                    u8 _pad0_ : 3;
+                    Filter filter : 1;
+                    u32 _pad1_ : 27;
+                };
+                static_assert(sizeof(SampleMode) == sizeof(u32));
+
+                struct {
+                    u32 _pad0_[0x80]; // 0x0
+                    Surface dst; // 0x80
+                    u32 _pad1_[0x2]; // 0x8A
+                    Surface src; // 0x8C
+                    u32 _pad2_[0x18A]; // 0x96
+
+                    struct {
+                        u32 blockShape; // 0x220
+                        u32 corralSize; // 0x221
+                        u32 safeOverlap; // 0x222
+                        SampleMode sampleMode; // 0x223
+                        u32 _pad_[0x8]; // 0x224
+                        i32 dstX0; // 0x22C
+                        i32 dstY0; // 0x22D
+                        i32 dstWidth; // 0x22E
+                        i32 dstHeight; // 0x22F
+                        i64 duDx; // 0x230 The horizontal distance in the source of two adjacent destination pixels as 32.32 fixed-point
+                        i64 dvDy; // 0x232 The vertical distance in the source of two adjacent destination pixels as 32.32 fixed-point
+                        i64 srcX0; // 0x234 As 32.32 fixed-point
+                        i64 srcY0; // 0x236 As 32.32 fixed-point, writing to the upper word of this triggers the blit
+                    } pixelsFromMemory;
+                };
+            };
+            static_assert(sizeof(Registers) == (constant::Fermi2DRegisterCounter * sizeof(u32)));
+#pragma pack(pop)
+
+          private:
+            Registers registers{};
+
+            /**
+             * @brief Blits the source region into the destination region, this is triggered by a write to the upper word of pixelsFromMemory.srcY0
+             */
+            void Blit();
+
+          public:
+            Fermi2D(const DeviceState &state);
+
+            void CallMethod(MethodParams params) override;
+        };
+    }
+}
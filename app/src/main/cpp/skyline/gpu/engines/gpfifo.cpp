@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "gpfifo.h"
+
+extern std::atomic<bool> Halt;
+
+namespace skyline::gpu::engine {
+    void GPFIFO::CallMethod(MethodParams params) {
+        state.logger->Debug("Called method in GPFIFO: 0x{:X} args: 0x{:X}", params.method, params.argument);
+
+        registers.raw[params.method] = params.argument;
+
+        if (params.method == SyncpointOperationMethod) {
+            if (registers.syncpoint.operation == Registers::SyncpointOperation::Incr) {
+                state.gpu->graphicsContext.IncrementSyncpoint(registers.syncpoint.index); // This is ordered after all work which was recorded prior to it
+            } else {
+                auto &syncpoint{state.gpu->syncpoints.at(registers.syncpoint.index)};
+                constexpr std::chrono::milliseconds WaitSlice{100}; // The maximum duration to wait on the syncpoint for prior to checking Halt (100ms)
+                while (!syncpoint.Wait(registers.syncpoint.payload, WaitSlice))
+                    if (Halt)
+                        return;
+            }
+        }
+    }
+}
@@ -17,6 +17,9 @@ namespace skyline {
         */
         class GPFIFO : public Engine {
           private:
+            static constexpr u32 SyncpointIndexShift{8}; //!< The bit offset of the syncpoint ID in the syncpoint operation register
+            static constexpr u32 SyncpointIndexBits{12}; //!< The width of the syncpoint ID in the syncpoint operation register
+
             /**
              * @url https://github.com/NVIDIA/open-gpu-doc/blob/ab27fc22db5de0d02a4cabe08e555663b62db4d4/classes/host/clb06f.h#L65
              */
@@ -68,12 +71,12 @@ namespace skyline {
                     All = 1,
                 };
 
-                enum class SyncpointOperation : u8 {
+                enum class SyncpointOperation : u32 {
                     Wait = 0,
                     Incr = 1,
                 };
 
-                enum class SyncpointWaitSwitch : u8 {
+                enum class SyncpointWaitSwitch : u32 {
                     Dis = 0,
                     En = 1,
                 };
@@ -140,13 +143,14 @@ namespace skyline {
                     struct {
                         u32 payload;
 
+                        // All fields share a single u32 unit, so index can't be moved to the start of a new unit by the compiler
                         struct {
                             SyncpointOperation operation : 1;
-                            u8 _pad0_ : 3;
+                            u32 _pad0_ : 3;
                             SyncpointWaitSwitch waitSwitch : 1;
-                            u8 _pad1_ : 3;
-                            u16 index : 12;
-                            u16 _pad2_ : 12;
+                            u32 _pad1_ : SyncpointIndexShift - 5;
+                            u32 index : SyncpointIndexBits;
+                            u32 _pad2_ : 32 - SyncpointIndexShift - SyncpointIndexBits;
                         };
                     } syncpoint;
 
@@ -167,13 +171,33 @@ namespace skyline {
 #pragma pack(pop)
 
           public:
-            GPFIFO(const DeviceState &state) : Engine(state) {}
+            static constexpr u16 SyncpointPayloadMethod{U32_OFFSET(Registers, syncpoint)}; //!< The method of the syncpoint payload register, this is the threshold for waits
+            static constexpr u16 SyncpointOperationMethod{SyncpointPayloadMethod + 1}; //!< The method of the syncpoint operation register, writing to it performs the operation
+
+            /**
+             * @return The argument to SyncpointOperationMethod for incrementing or waiting on the supplied syncpoint
+             */
+            static constexpr u32 SyncpointOperationArgument(bool increment, u32 id) {
+                return static_cast<u32>(increment) | (id << SyncpointIndexShift);
+            }
+
+            /**
+             * @return The syncpoint ID encoded in an argument to SyncpointOperationMethod, this mirrors the layout of Registers::syncpoint
+             */
+            static constexpr u32 SyncpointOperationIndex(u32 argument) {
+                return (argument >> SyncpointIndexShift) & ((1U << SyncpointIndexBits) - 1);
+            }
 
-            void CallMethod(MethodParams params) {
-                state.logger->Debug("Called method in GPFIFO: 0x{:X} args: 0x{:X}", params.method, params.argument);
+            GPFIFO(const DeviceState &state) : Engine(state) {}
 
-                registers.raw[params.method] = params.argument;
-            };
+            /**
+             * @note Syncpoint waits stall the GPFIFO until the syncpoint reaches the payload, this is how fences are acquired on the GPU timeline
+             */
+            void CallMethod(MethodParams params);
         };
+
+        // The register layout is declared with the same offsets as the arguments are encoded with, these verify that the encoding round-trips through them
+        static_assert(GPFIFO::SyncpointOperationIndex(GPFIFO::SyncpointOperationArgument(true, 0xABC)) == 0xABC && (GPFIFO::SyncpointOperationArgument(true, 0xABC) & 1) == 1);
+        static_assert(GPFIFO::SyncpointOperationIndex(GPFIFO::SyncpointOperationArgument(false, 0xFFF)) == 0xFFF && (GPFIFO::SyncpointOperationArgument(false, 0xFFF) & 1) == 0);
     }
 }
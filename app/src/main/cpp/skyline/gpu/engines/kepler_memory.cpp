@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "kepler_memory.h"
+
+namespace skyline::gpu::engine {
+    KeplerMemory::KeplerMemory(const DeviceState &state) : Engine(state) {}
+
+    void KeplerMemory::CallMethod(MethodParams params) {
+        state.logger->Debug("Called method in Kepler Memory: 0x{:X} args: 0x{:X}", params.method, params.argument);
+
+        if (params.method >= constant::KeplerMemoryRegisterCounter) {
+            state.logger->Warn("Called out of range method in Kepler Memory: 0x{:X} args: 0x{:X}", params.method, params.argument);
+            return;
+        }
+
+        registers.raw[params.method] = params.argument;
+
+        switch (params.method) {
+            case KEPLERMEMORY_OFFSET(launchDma):
+                LaunchDma();
+                break;
+            case KEPLERMEMORY_OFFSET(loadInlineData):
+                LoadInlineData(span<u32>(&params.argument, 1));
+                break;
+        }
+    }
+
+    void KeplerMemory::CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) {
+        if (method == KEPLERMEMORY_OFFSET(loadInlineData) && !incrementing && !arguments.empty()) {
+            state.logger->Debug("Called batched inline data upload in Kepler Memory: {} words", arguments.size());
+            registers.loadInlineData = arguments.back();
+            LoadInlineData(arguments);
+            return;
+        }
+
+        Engine::CallMethodBatch(method, arguments, subChannel, incrementing);
+    }
+
+    void KeplerMemory::LaunchDma() {
+        if (upload.offset < upload.size)
+            state.logger->Warn("Kepler Memory upload was restarted with {} bytes of data remaining", upload.size - upload.offset);
+
+        upload.address = registers.offsetOut.Pack();
+        upload.size = static_cast<size_t>(registers.lineLengthIn) * registers.lineCount;
+        upload.offset = 0;
+        upload.host = nullptr;
+        if (!upload.size)
+            return;
+
+        // Pitch-linear destinations are written to directly when they're contiguous in host memory, this avoids staging the data entirely
+        if (registers.launchDma.linear) {
+            size_t regionSize{(static_cast<size_t>(registers.pitchOut) * (registers.lineCount - 1)) + registers.lineLengthIn};
+            upload.host = state.gpu->memoryManager.GetHostPointer(upload.address, regionSize);
+        }
+
+        if (!upload.host)
+            upload.buffer.resize(upload.size);
+    }
+
+    void KeplerMemory::LoadInlineData(span<u32> data) {
+        if (upload.offset >= upload.size) {
+            state.logger->Warn("Kepler Memory received {} words of inline data without an upload in progress", data.size());
+            return;
+        }
+
+        auto source{data.cast<u8>()};
+        size_t size{std::min(source.size(), upload.size - upload.offset)}; // The final word of the data might only be partially used
+
+        if (upload.host) {
+            // The data is written directly into the destination one line at a time, tightly packed lines are written at once
+            size_t lineLength{registers.lineLengthIn};
+            size_t pitch{registers.pitchOut};
+            for (size_t written{}; written < size;) {
+                size_t offset{upload.offset + written};
+                size_t line{offset / lineLength}, column{offset % lineLength};
+                size_t length{pitch == lineLength ? size - written : std::min(lineLength - column, size - written)};
+                std::memcpy(upload.host + (line * pitch) + column, source.data() + written, length);
+                written += length;
+            }
+        } else {
+            std::memcpy(upload.buffer.data() + upload.offset, source.data(), size);
+        }
+
+        upload.offset += size;
+        if (upload.offset == upload.size)
+            CompleteUpload();
+    }
+
+    void KeplerMemory::CompleteUpload() {
+        auto &memoryManager{state.gpu->memoryManager};
+        u32 lineLength{registers.lineLengthIn}, lineCount{registers.lineCount};
+
+        if (registers.launchDma.linear) {
+            u32 pitch{registers.pitchOut};
+            if (!upload.host) {
+                if (pitch == lineLength)
+                    memoryManager.Write(upload.buffer.data(), upload.address, upload.size);
+                else
+                    for (u32 line{}; line < lineCount; line++)
+                        memoryManager.Write(upload.buffer.data() + (static_cast<size_t>(line) * lineLength), upload.address + (static_cast<u64>(line) * pitch), lineLength);
+            }
+
+            state.gpu->textureCache.InvalidateGpu(upload.address, (static_cast<u64>(pitch) * (lineCount - 1)) + lineLength);
+        } else {
+            if (registers.dstBlockSize.depthLog2)
+                throw exception("Kepler Memory uploads with a block depth of {} are unimplemented", 1U << registers.dstBlockSize.depthLog2);
+
+            // The region is swizzled with the surface's own layout, so any part of it outside the surface would land in the memory after the layer
+            if (static_cast<u64>(registers.dstOriginX) + lineLength > registers.dstWidth || static_cast<u64>(registers.dstOriginY) + lineCount > registers.dstHeight) {
+                state.logger->Warn("Kepler Memory upload of {}x{} at ({}, {}) exceeds the {}x{} destination surface", lineLength, lineCount, registers.dstOriginX, registers.dstOriginY, registers.dstWidth, registers.dstHeight);
+                return;
+            }
+
+            // Block-linear destinations are swizzled from the staging buffer into the layer they're uploaded to
+            u32 blockHeight{1U << registers.dstBlockSize.heightLog2};
+            auto layerSize{texture::GetBlockLinearSize(registers.dstWidth, registers.dstHeight, blockHeight)};
+            u64 layerAddress{upload.address + (layerSize * registers.dstLayer)};
+            memoryManager.Access(layerAddress, layerSize, true, [&](u8 *layer) {
+                texture::CopyBlockLinearRegion<true>(layer, registers.dstWidth, blockHeight, registers.dstOriginX, registers.dstOriginY, upload.buffer.data(), lineLength, lineLength, lineCount);
+            });
+
+            state.gpu->textureCache.InvalidateGpu(layerAddress, layerSize);
+        }
+    }
+}
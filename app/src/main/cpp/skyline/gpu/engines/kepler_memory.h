@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "engine.h"
+
+#define KEPLERMEMORY_OFFSET(field) U32_OFFSET(skyline::gpu::engine::KeplerMemory::Registers, field)
+
+namespace skyline {
+    namespace constant {
+        constexpr u32 KeplerMemoryRegisterCounter{0x80}; //!< The number of Kepler Memory registers
+    }
+
+    namespace gpu::engine {
+        /**
+         * @brief The Kepler Memory engine (Class A140) uploads data which is inline in the pushbuffer into the GPU address space, it's used for streaming small amounts of data such as constants
+         * @url https://github.com/devkitPro/deko3d/blob/master/source/maxwell/engine_inline.def
+         */
+        class KeplerMemory : public Engine {
+          public:
+#pragma pack(push, 1)
+            union Registers {
+                std::array<u32, constant::KeplerMemoryRegisterCounter> raw;
+
+                struct Address {
+                    u32 high;
+                    u32 low;
+
+                    u64 Pack() {
+                        return (static_cast<u64>(high) << 32) | low;
+                    }
+                };
+                static_assert(sizeof(Address) == sizeof(u64));
+
+                struct {
+                    u32 _pad0_[0x60]; // 0x0
+                    u32 lineLengthIn; // 0x60 The length of a line in bytes
+                    u32 lineCount; // 0x61
+                    Address offsetOut; // 0x62
+                    u32 pitchOut; // 0x64
+                    struct {
+                        u8 widthLog2 : 4; //!< The width of the blocks in GOBs, this is always 1 on the Tegra X1
+                        u8 heightLog2 : 4; //!< The height of the blocks in GOBs
+                        u8 depthLog2 : 4; //!< The depth of the blocks in GOBs
+                        u8 _pad0_ : 4;
+                        u16 _pad1_;
+                    } dstBlockSize; // 0x65
+                    u32 dstWidth; // 0x66 The width of a block-linear destination in bytes
+                    u32 dstHeight; // 0x67
+                    u32 dstDepth; // 0x68
+                    u32 dstLayer; // 0x69
+                    u32 dstOriginX; // 0x6A In bytes
+                    u32 dstOriginY; // 0x6B
+
+                    struct {
+                        bool linear : 1; //!< If the destination is pitch-linear rather than block-linear
+                        u32 _pad_ : 31;
+                    } launchDma; // 0x6C
+
+                    u32 loadInlineData; // 0x6D
+                };
+            };
+            static_assert(sizeof(Registers) == (constant::KeplerMemoryRegisterCounter * sizeof(u32)));
+#pragma pack(pop)
+
+          private:
+            Registers registers{};
+
+            /**
+             * @brief The state of the upload started by the last write to launchDma
+             */
+            struct {
+                u64 address; //!< The GPU address of the destination region
+                size_t size; //!< The size of the data that's uploaded in bytes
+                size_t offset; //!< The amount of bytes of the data that have been uploaded so far
+                u8 *host; //!< A host pointer to the destination region if it's pitch-linear and can be written to directly, otherwise the data is staged in 'buffer'
+                std::vector<u8> buffer; //!< A staging buffer for the data when it can't be written into the destination directly
+            } upload{};
+
+            /**
+             * @brief Starts an upload with the parameters in the registers
+             */
+            void LaunchDma();
+
+            /**
+             * @brief Writes the next part of the data of the upload, this completes the upload once all data has been written
+             */
+            void LoadInlineData(span<u32> data);
+
+            /**
+             * @brief Writes any staged data into the destination and invalidates it in the texture cache
+             */
+            void CompleteUpload();
+
+          public:
+            KeplerMemory(const DeviceState &state);
+
+            void CallMethod(MethodParams params) override;
+
+            /**
+             * @note Non-incrementing sequences of inline data are uploaded directly from the pushbuffer rather than one word at a time
+             */
+            void CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) override;
+        };
+    }
+}
@@ -71,71 +71,310 @@ namespace skyline::gpu::engine {
         }
 
         registers.viewportTransformEnable = true;
+
+        dirtyState.set();
+    }
+
+    constexpr u8 NoDirtyState{0xFF}; //!< The group of registers which aren't tracked for modifications
+
+    /**
+     * @brief A mapping from every register to the group it's dirty state is tracked in
+     */
+    constexpr auto DirtyStateMap{[] {
+        using DirtyState = Maxwell3D::DirtyState;
+        using Registers = Maxwell3D::Registers;
+
+        std::array<u8, constant::Maxwell3DRegisterCounter> map{};
+        for (auto &group : map)
+            group = NoDirtyState;
+
+        auto setGroup{[&map](size_t offset, size_t size, DirtyState group) {
+            for (size_t index{offset}; index < offset + (size / sizeof(u32)); index++)
+                map[index] = static_cast<u8>(group);
+        }};
+
+        #define DIRTY_STATE(field, group) setGroup(MAXWELL3D_OFFSET(field), sizeof(Registers::field), DirtyState::group)
+
+        DIRTY_STATE(viewportTransform, Viewport);
+        DIRTY_STATE(viewport, Viewport);
+        DIRTY_STATE(viewportTransformEnable, Viewport);
+
+        DIRTY_STATE(scissor, Scissor);
+
+        DIRTY_STATE(rasterizerEnable, Rasterizer);
+        DIRTY_STATE(polygonMode, Rasterizer);
+        DIRTY_STATE(lineWidthSmooth, Rasterizer);
+        DIRTY_STATE(lineWidthAliased, Rasterizer);
+        DIRTY_STATE(clipDistanceEnable, Rasterizer);
+        DIRTY_STATE(pointSpriteSize, Rasterizer);
+        DIRTY_STATE(pointSpriteEnable, Rasterizer);
+        DIRTY_STATE(polygonOffsetFactor, Rasterizer);
+        DIRTY_STATE(lineSmoothEnable, Rasterizer);
+        DIRTY_STATE(pointCoordReplace, Rasterizer);
+        DIRTY_STATE(cullFaceEnable, Rasterizer);
+        DIRTY_STATE(frontFace, Rasterizer);
+        DIRTY_STATE(cullFace, Rasterizer);
+
+        DIRTY_STATE(multisampleEnable, Multisample);
+        DIRTY_STATE(multisampleControl, Multisample);
+
+        DIRTY_STATE(stencilBackExtra, DepthStencil);
+        DIRTY_STATE(depthTestEnable, DepthStencil);
+        DIRTY_STATE(depthWriteEnable, DepthStencil);
+        DIRTY_STATE(depthTestFunc, DepthStencil);
+        DIRTY_STATE(stencilEnable, DepthStencil);
+        DIRTY_STATE(stencilFront, DepthStencil);
+        DIRTY_STATE(depthTargetEnable, DepthStencil);
+        DIRTY_STATE(stencilTwoSideEnable, DepthStencil);
+        DIRTY_STATE(stencilBack, DepthStencil);
+
+        DIRTY_STATE(alphaTestRef, Blend);
+        DIRTY_STATE(alphaTestFunc, Blend);
+        DIRTY_STATE(blendConstant, Blend);
+        DIRTY_STATE(blend, Blend);
+        DIRTY_STATE(independentBlend, Blend);
+
+        DIRTY_STATE(colorMask, ColorMask);
+
+        DIRTY_STATE(vertexAttributeState, VertexAttributes);
+
+        DIRTY_STATE(texSamplerPool, TexturePools);
+        DIRTY_STATE(texHeaderPool, TexturePools);
+
+        #undef DIRTY_STATE
+
+        return map;
+    }()};
+
+    FORCE_INLINE void Maxwell3D::MarkDirty(u32 method, size_t count) {
+        for (auto index{method}; index < method + count; index++)
+            if (DirtyStateMap[index] != NoDirtyState)
+                dirtyState.set(DirtyStateMap[index]);
+    }
+
+    void Maxwell3D::ExecuteMacro(span<u32> arguments) {
+        // The invocation is reset prior to execution as the arguments are only read from the supplied span from here onwards
+        auto index{macroInvocation.index};
+        macroInvocation.argumentCount = 0;
+        macroInvocation.index = 0;
+
+        macroInterpreter.Execute(macroPositions[index], arguments);
+    }
+
+    template<Maxwell3D::Registers::MmeShadowRamControl Mode, bool Dirty>
+    void Maxwell3D::StoreMethod(u32 method, u32 argument) {
+        registers.raw[method] = argument;
+        if constexpr (Dirty)
+            dirtyState.set(DirtyStateMap[method]);
+        if constexpr (Mode == Registers::MmeShadowRamControl::MethodTrack || Mode == Registers::MmeShadowRamControl::MethodTrackWithFilter)
+            shadowRegisters.raw[method] = argument;
+    }
+
+    template<Maxwell3D::Registers::MmeShadowRamControl Mode, void (Maxwell3D::*Handler)(u32)>
+    void Maxwell3D::SideEffectMethod(u32 method, u32 argument) {
+        registers.raw[method] = argument;
+        MarkDirty(method);
+        if constexpr (Mode == Registers::MmeShadowRamControl::MethodTrack || Mode == Registers::MmeShadowRamControl::MethodTrackWithFilter)
+            shadowRegisters.raw[method] = argument;
+        else if constexpr (Mode == Registers::MmeShadowRamControl::MethodReplay)
+            argument = shadowRegisters.raw[method];
+
+        (this->*Handler)(argument);
+    }
+
+    void Maxwell3D::SetShadowRamControl(u32 method, u32 argument) {
+        registers.raw[method] = argument;
+        shadowRegisters.mme.shadowRamControl = static_cast<Registers::MmeShadowRamControl>(argument);
+        methodTable = &MethodTables[argument % MethodTables.size()];
+    }
+
+    void Maxwell3D::LoadInstructionRam(u32 argument) {
+        if (registers.mme.instructionRamPointer >= macroCode.size())
+            throw exception("Macro memory is full!");
+
+        macroCode[registers.mme.instructionRamPointer++] = argument;
+        macroInterpreter.InvalidateMacros();
+    }
+
+    void Maxwell3D::LoadStartAddressRam(u32 argument) {
+        if (registers.mme.startAddressRamPointer >= macroPositions.size())
+            throw exception("Maximum amount of macros reached!");
+
+        macroPositions[registers.mme.startAddressRamPointer++] = argument;
+    }
+
+    void Maxwell3D::EndDraw(u32 argument) {
+        state.gpu->graphicsContext.Draw(*this);
+    }
+
+    void Maxwell3D::IncrementSyncpoint(u32 argument) {
+        state.gpu->graphicsContext.IncrementSyncpoint(registers.syncpointAction.id);
+    }
+
+    void Maxwell3D::ExecuteSemaphore(u32 argument) {
+        switch (registers.semaphore.info.op) {
+            case Registers::SemaphoreInfo::Op::Release:
+                WriteSemaphoreResult(registers.semaphore.payload);
+                break;
+            case Registers::SemaphoreInfo::Op::Counter:
+                HandleSemaphoreCounterOperation();
+                break;
+            default:
+                state.logger->Warn("Unsupported semaphore operation: 0x{:X}", static_cast<u8>(registers.semaphore.info.op));
+                break;
+        }
+    }
+
+    void Maxwell3D::ResetCounter(u32 argument) {
+        state.gpu->graphicsContext.ResetCounter(argument);
+    }
+
+    void Maxwell3D::CallFirmware(u32 argument) {
+        registers.raw[0xD00] = 1;
+    }
+
+    void Maxwell3D::WriteConstantBufferWord(u32 argument) {
+        WriteConstantBuffer(span<u32>(&argument, 1));
+    }
+
+    template<Maxwell3D::Registers::MmeShadowRamControl Mode>
+    constexpr Maxwell3D::MethodTable Maxwell3D::GenerateMethodTable() {
+        MethodTable table{};
+        for (u32 method{}; method < table.size(); method++)
+            table[method] = DirtyStateMap[method] != NoDirtyState ? &Maxwell3D::StoreMethod<Mode, true> : &Maxwell3D::StoreMethod<Mode, false>;
+
+        #define SIDE_EFFECT(field, handler) table[MAXWELL3D_OFFSET(field)] = &Maxwell3D::SideEffectMethod<Mode, &Maxwell3D::handler>
+
+        SIDE_EFFECT(mme.instructionRamLoad, LoadInstructionRam);
+        SIDE_EFFECT(mme.startAddressRamLoad, LoadStartAddressRam);
+        SIDE_EFFECT(vertexEndGl, EndDraw);
+        SIDE_EFFECT(syncpointAction, IncrementSyncpoint);
+        SIDE_EFFECT(semaphore.info, ExecuteSemaphore);
+        SIDE_EFFECT(counterReset, ResetCounter);
+        SIDE_EFFECT(firmwareCall[4], CallFirmware);
+
+        #undef SIDE_EFFECT
+
+        // Every constant buffer data register writes to the next word of the constant buffer
+        for (u32 method{MAXWELL3D_OFFSET(constantBuffer.data)}; method < MAXWELL3D_OFFSET(constantBuffer.data) + std::tuple_size_v<decltype(Registers::constantBuffer.data)>; method++)
+            table[method] = &Maxwell3D::SideEffectMethod<Mode, &Maxwell3D::WriteConstantBufferWord>;
+
+        table[MAXWELL3D_OFFSET(mme.shadowRamControl)] = &Maxwell3D::SetShadowRamControl;
+        return table;
     }
 
+    const std::array<Maxwell3D::MethodTable, 4> Maxwell3D::MethodTables{
+        GenerateMethodTable<Registers::MmeShadowRamControl::MethodTrack>(),
+        GenerateMethodTable<Registers::MmeShadowRamControl::MethodTrackWithFilter>(),
+        GenerateMethodTable<Registers::MmeShadowRamControl::MethodPassthrough>(),
+        GenerateMethodTable<Registers::MmeShadowRamControl::MethodReplay>(),
+    };
+
     void Maxwell3D::CallMethod(MethodParams params) {
-        state.logger->Debug("Called method in Maxwell 3D: 0x{:X} args: 0x{:X}", params.method, params.argument);
+        state.logger->DebugCompact("Called method in Maxwell 3D: 0x{:X} args: 0x{:X}", params.method, params.argument);
 
-        // Methods that are greater than the register size are for macro control
-        if (params.method > constant::Maxwell3DRegisterCounter) {
+        // Methods that are beyond the registers are for macro control
+        if (params.method >= constant::Maxwell3DRegisterCounter) {
             if (!(params.method & 1))
                 macroInvocation.index = ((params.method - constant::Maxwell3DRegisterCounter) >> 1) % macroPositions.size();
 
-            macroInvocation.arguments.push_back(params.argument);
+            if (macroInvocation.argumentCount >= macroInvocation.arguments.size())
+                throw exception("Macro invocation exceeds the maximum amount of arguments: {}", macroInvocation.arguments.size());
+            macroInvocation.arguments[macroInvocation.argumentCount++] = params.argument;
 
             // Macros are always executed on the last method call in a pushbuffer entry
-            if (params.lastCall) {
-                macroInterpreter.Execute(macroPositions[macroInvocation.index], macroInvocation.arguments);
-
-                macroInvocation.arguments.clear();
-                macroInvocation.index = 0;
-            }
+            if (params.lastCall)
+                ExecuteMacro(span<u32>(macroInvocation.arguments).first(macroInvocation.argumentCount));
             return;
         }
 
-        registers.raw[params.method] = params.argument;
+        (this->*(*methodTable)[params.method])(params.method, params.argument);
+    }
 
-        if (shadowRegisters.mme.shadowRamControl == Registers::MmeShadowRamControl::MethodTrack || shadowRegisters.mme.shadowRamControl == Registers::MmeShadowRamControl::MethodTrackWithFilter)
-            shadowRegisters.raw[params.method] = params.argument;
-        else if (shadowRegisters.mme.shadowRamControl == Registers::MmeShadowRamControl::MethodReplay)
-            params.argument = shadowRegisters.raw[params.method];
+    void Maxwell3D::CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) {
+        if (arguments.empty())
+            return;
 
-        switch (params.method) {
-            case MAXWELL3D_OFFSET(mme.instructionRamLoad):
-                if (registers.mme.instructionRamPointer >= macroCode.size())
-                    throw exception("Macro memory is full!");
+        state.logger->DebugCompact("Called batched method in Maxwell 3D: 0x{:X} count: {} incrementing: {}", method, arguments.size(), incrementing);
 
-                macroCode[registers.mme.instructionRamPointer++] = params.argument;
-                break;
-            case MAXWELL3D_OFFSET(mme.startAddressRamLoad):
-                if (registers.mme.startAddressRamPointer >= macroPositions.size())
-                    throw exception("Maximum amount of macros reached!");
+        auto shadowRamControl{shadowRegisters.mme.shadowRamControl};
+        bool tracking{shadowRamControl == Registers::MmeShadowRamControl::MethodTrack || shadowRamControl == Registers::MmeShadowRamControl::MethodTrackWithFilter};
 
-                macroPositions[registers.mme.startAddressRamPointer++] = params.argument;
-                break;
-            case MAXWELL3D_OFFSET(mme.shadowRamControl):
-                shadowRegisters.mme.shadowRamControl = static_cast<Registers::MmeShadowRamControl>(params.argument);
-                break;
-            case MAXWELL3D_OFFSET(syncpointAction):
-                state.gpu->syncpoints.at(registers.syncpointAction.id).Increment();
-                break;
-            case MAXWELL3D_OFFSET(semaphore.info):
-                switch (registers.semaphore.info.op) {
-                    case Registers::SemaphoreInfo::Op::Release:
-                        WriteSemaphoreResult(registers.semaphore.payload);
-                        break;
-                    case Registers::SemaphoreInfo::Op::Counter:
-                        HandleSemaphoreCounterOperation();
-                        break;
-                    default:
-                        state.logger->Warn("Unsupported semaphore operation: 0x{:X}", static_cast<u8>(registers.semaphore.info.op));
-                        break;
+        // Constant buffer updates are written at once as every write is to the next word regardless of the register it's through, this is the bulk of the methods in most pushbuffers
+        constexpr u32 ConstantBufferData{MAXWELL3D_OFFSET(constantBuffer.data)}, ConstantBufferDataEnd{ConstantBufferData + std::tuple_size_v<decltype(Registers::constantBuffer.data)>};
+        if (shadowRamControl != Registers::MmeShadowRamControl::MethodReplay && method >= ConstantBufferData && (incrementing ? method + arguments.size() : method + 1U) <= ConstantBufferDataEnd) {
+            u32 lastMethod{incrementing ? static_cast<u32>(method + arguments.size() - 1) : method};
+            registers.raw[lastMethod] = arguments.back();
+            if (tracking)
+                shadowRegisters.raw[lastMethod] = arguments.back();
+
+            WriteConstantBuffer(arguments);
+            return;
+        }
+
+        if (!incrementing) {
+            if (method >= constant::Maxwell3DRegisterCounter) {
+                // All arguments are for the same macro which is executed after the last one
+                if (!(method & 1))
+                    macroInvocation.index = ((method - constant::Maxwell3DRegisterCounter) >> 1) % macroPositions.size();
+
+                if (!macroInvocation.argumentCount) {
+                    ExecuteMacro(arguments); // The arguments are used directly from the pushbuffer when there's no pending arguments from prior calls
+                } else {
+                    if (macroInvocation.argumentCount + arguments.size() > macroInvocation.arguments.size())
+                        throw exception("Macro invocation exceeds the maximum amount of arguments: {}", macroInvocation.arguments.size());
+
+                    std::copy(arguments.begin(), arguments.end(), macroInvocation.arguments.begin() + macroInvocation.argumentCount);
+                    ExecuteMacro(span<u32>(macroInvocation.arguments).first(macroInvocation.argumentCount + arguments.size()));
                 }
-                break;
-            case MAXWELL3D_OFFSET(firmwareCall[4]):
-                registers.raw[0xD00] = 1;
-                break;
+                return;
+            }
+
+            // Macro uploads are copied at once unless the arguments are substituted with the shadow register by replaying
+            if (shadowRamControl != Registers::MmeShadowRamControl::MethodReplay && (method == MAXWELL3D_OFFSET(mme.instructionRamLoad) || method == MAXWELL3D_OFFSET(mme.startAddressRamLoad))) {
+                registers.raw[method] = arguments.back();
+                if (tracking)
+                    shadowRegisters.raw[method] = arguments.back();
+
+                if (method == MAXWELL3D_OFFSET(mme.instructionRamLoad)) {
+                    if (registers.mme.instructionRamPointer + arguments.size() > macroCode.size())
+                        throw exception("Macro memory is full!");
+
+                    std::copy(arguments.begin(), arguments.end(), macroCode.begin() + registers.mme.instructionRamPointer);
+                    registers.mme.instructionRamPointer += arguments.size();
+                    macroInterpreter.InvalidateMacros();
+                } else {
+                    if (registers.mme.startAddressRamPointer + arguments.size() > macroPositions.size())
+                        throw exception("Maximum amount of macros reached!");
+
+                    std::copy(arguments.begin(), arguments.end(), macroPositions.begin() + registers.mme.startAddressRamPointer);
+                    registers.mme.startAddressRamPointer += arguments.size();
+                }
+                return;
+            }
+        } else if (method + arguments.size() <= constant::Maxwell3DRegisterCounter) {
+            constexpr std::array<u16, 8> SideEffectMethods{
+                MAXWELL3D_OFFSET(mme.instructionRamLoad),
+                MAXWELL3D_OFFSET(mme.startAddressRamLoad),
+                MAXWELL3D_OFFSET(mme.shadowRamControl),
+                MAXWELL3D_OFFSET(vertexEndGl),
+                MAXWELL3D_OFFSET(syncpointAction),
+                MAXWELL3D_OFFSET(semaphore.info),
+                MAXWELL3D_OFFSET(counterReset),
+                MAXWELL3D_OFFSET(firmwareCall[4]),
+            };
+
+            // A range of registers without any side effects is only stored, replaying doesn't affect these as it only substitutes the argument used for side effects
+            if (std::none_of(SideEffectMethods.begin(), SideEffectMethods.end(), [&](u16 sideEffectMethod) { return sideEffectMethod >= method && sideEffectMethod < method + arguments.size(); }) && (method >= ConstantBufferDataEnd || method + arguments.size() <= ConstantBufferData)) {
+                std::copy(arguments.begin(), arguments.end(), registers.raw.begin() + method);
+                MarkDirty(method, arguments.size());
+                if (tracking)
+                    std::copy(arguments.begin(), arguments.end(), shadowRegisters.raw.begin() + method);
+                return;
+            }
         }
+
+        Engine::CallMethodBatch(method, arguments, subChannel, incrementing);
     }
 
     void Maxwell3D::HandleSemaphoreCounterOperation() {
@@ -144,30 +383,58 @@ namespace skyline::gpu::engine {
                 WriteSemaphoreResult(0);
                 break;
             default:
-                state.logger->Warn("Unsupported semaphore counter type: 0x{:X}", static_cast<u8>(registers.semaphore.info.counterType));
+                // The result is written once the device is done with all work prior to this, as that's when the counter is known
+                state.gpu->graphicsContext.ReportCounter(registers.semaphore.info.counterType, registers.semaphore.address.Pack(), registers.semaphore.info.structureSize);
                 break;
         }
     }
 
+    void Maxwell3D::WriteConstantBuffer(span<u32> data) {
+        auto &constantBuffer{registers.constantBuffer};
+        if (constantBuffer.offset + data.size_bytes() > constantBuffer.size) {
+            state.logger->Warn("Constant buffer update at 0x{:X} of 0x{:X} bytes exceeds its size: 0x{:X}", constantBuffer.offset, data.size_bytes(), constantBuffer.size);
+            return;
+        }
+
+        state.gpu->graphicsContext.bufferCache.Write(constantBuffer.address.Pack() + constantBuffer.offset, data.cast<u8>());
+        constantBuffer.offset += data.size_bytes();
+    }
+
+    /**
+     * @brief The layout of a semaphore result with a FourWords structure size
+     */
+    struct FourWordResult {
+        u64 value;
+        u64 timestamp;
+    };
+
     void Maxwell3D::WriteSemaphoreResult(u64 result) {
-        struct FourWordResult {
-            u64 value;
-            u64 timestamp;
-        };
+        u64 address{registers.semaphore.address.Pack()};
+        u64 generation{state.gpu->memoryManager.GetGeneration()};
+        if (semaphoreCache.address != address || semaphoreCache.generation != generation)
+            semaphoreCache = {address, generation, state.gpu->memoryManager.GetHostPointer(address, sizeof(FourWordResult))};
 
-        switch (registers.semaphore.info.structureSize) {
+        WriteSemaphoreResult(state, address, registers.semaphore.info.structureSize, result, semaphoreCache.host);
+    }
+
+    void Maxwell3D::WriteSemaphoreResult(const DeviceState &state, u64 address, Registers::SemaphoreInfo::StructureSize structureSize, u64 result, u8 *host) {
+        switch (structureSize) {
             case Registers::SemaphoreInfo::StructureSize::OneWord:
-                state.gpu->memoryManager.Write<u32>(static_cast<u32>(result), registers.semaphore.address.Pack());
+                if (host)
+                    *reinterpret_cast<u32 *>(host) = static_cast<u32>(result);
+                else
+                    state.gpu->memoryManager.Write<u32>(static_cast<u32>(result), address);
                 break;
             case Registers::SemaphoreInfo::StructureSize::FourWords: {
-                // Convert the current nanosecond time to GPU ticks
-                constexpr u64 NsToTickNumerator{384};
-                constexpr u64 NsToTickDenominator{625};
-
-                u64 nsTime{util::GetTimeNs()};
-                u64 timestamp{(nsTime / NsToTickDenominator) * NsToTickNumerator + ((nsTime % NsToTickDenominator) * NsToTickNumerator) / NsToTickDenominator};
-
-                state.gpu->memoryManager.Write<FourWordResult>(FourWordResult{result, timestamp}, registers.semaphore.address.Pack());
+                // Convert the current host tick count to GPU ticks, the multiplier is the amount of GPU ticks in a host tick as 32.32 fixed-point
+                constexpr u64 GpuTickFrequency{614400000}; //!< The frequency of the GPU timer (1 GHz * 384 / 625)
+                static const u64 gpuTickMultiplier{static_cast<u64>((static_cast<__uint128_t>(GpuTickFrequency) << 32) / util::GetTickFrequency())};
+                u64 timestamp{static_cast<u64>((static_cast<__uint128_t>(util::GetTimeTicks()) * gpuTickMultiplier) >> 32)};
+
+                if (host)
+                    *reinterpret_cast<FourWordResult *>(host) = FourWordResult{result, timestamp};
+                else
+                    state.gpu->memoryManager.Write<FourWordResult>(FourWordResult{result, timestamp}, address);
                 break;
             }
         }
@@ -22,17 +22,43 @@ namespace skyline {
           private:
             std::array<size_t, 0x80> macroPositions{}; //!< The positions of each individual macro in macro memory, there can be a maximum of 0x80 macros at any one time
 
+            static constexpr size_t MacroArgumentCapacity{0x2000}; //!< The maximum amount of arguments of a macro invocation that's split across calls, this is the maximum amount of arguments in a single pushbuffer method sequence
+
             struct {
                 u32 index;
-                std::vector<u32> arguments;
+                size_t argumentCount; //!< The amount of arguments in 'arguments'
+                std::array<u32, MacroArgumentCapacity> arguments; //!< A reusable buffer of arguments for macro invocations which are split across individual method calls
             } macroInvocation{}; //!< Data for a macro that is pending execution
 
             MacroInterpreter macroInterpreter;
 
+            /**
+             * @brief Executes the pending macro with the macro interpreter and resets the pending invocation
+             * @param arguments The arguments of the macro, these are either the pending arguments or a span directly into the pushbuffer
+             */
+            void ExecuteMacro(span<u32> arguments);
+
+            /**
+             * @brief Marks the groups of a range of registers as dirty after they've been written to
+             */
+            void MarkDirty(u32 method, size_t count = 1);
+
             void HandleSemaphoreCounterOperation();
 
+            struct {
+                u64 address; //!< The GPU address of the semaphore the host pointer was translated from
+                u64 generation; //!< The generation of the GPU mappings at translation
+                u8 *host; //!< A host pointer to the semaphore or nullptr if it couldn't be translated to one
+            } semaphoreCache{}; //!< A cached translation of the semaphore address, semaphores are released very frequently and are almost always at the same address
+
             void WriteSemaphoreResult(u64 result);
 
+            /**
+             * @brief Writes words to the selected constant buffer at its current offset and advances the offset past them
+             * @note The write is applied in place to any host buffer which backs the constant buffer, so it doesn't have to be detected as a guest write
+             */
+            void WriteConstantBuffer(span<u32> data);
+
           public:
             /**
              * @url https://github.com/devkitPro/deko3d/blob/master/source/maxwell/engine_3d.def#L478
@@ -45,7 +71,7 @@ namespace skyline {
                     u32 high;
                     u32 low;
 
-                    u64 Pack() {
+                    u64 Pack() const {
                         return (static_cast<u64>(high) << 32) | low;
                     }
                 };
@@ -113,6 +139,44 @@ namespace skyline {
                 };
                 static_assert(sizeof(Viewport) == (0x4 * sizeof(u32)));
 
+                /**
+                 * @brief A scissor rectangle, it's inclusive of the minimum and exclusive of the maximum bounds
+                 */
+                struct Scissor {
+                    u32 enable;
+
+                    struct {
+                        u16 minX;
+                        u16 maxX;
+                    };
+
+                    struct {
+                        u16 minY;
+                        u16 maxY;
+                    };
+
+                    u32 _pad_;
+                };
+                static_assert(sizeof(Scissor) == (0x4 * sizeof(u32)));
+
+                enum class PrimitiveTopology : u16 {
+                    Points = 0x0,
+                    Lines = 0x1,
+                    LineLoop = 0x2,
+                    LineStrip = 0x3,
+                    Triangles = 0x4,
+                    TriangleStrip = 0x5,
+                    TriangleFan = 0x6,
+                    Quads = 0x7,
+                    QuadStrip = 0x8,
+                    Polygon = 0x9,
+                    LinesAdjacency = 0xA,
+                    LineStripAdjacency = 0xB,
+                    TrianglesAdjacency = 0xC,
+                    TriangleStripAdjacency = 0xD,
+                    Patches = 0xE,
+                };
+
                 enum class PolygonMode : u32 {
                     Point = 0x1B00,
                     Line = 0x1B01,
@@ -262,6 +326,15 @@ namespace skyline {
                     Invert = 6,
                     IncrementAndWrap = 7,
                     DecrementAndWrap = 8,
+
+                    ZeroGL = 0x0,
+                    InvertGL = 0x150A,
+                    KeepGL = 0x1E00,
+                    ReplaceGL = 0x1E01,
+                    IncrementAndClampGL = 0x1E02,
+                    DecrementAndClampGL = 0x1E03,
+                    IncrementAndWrapGL = 0x8507,
+                    DecrementAndWrapGL = 0x8508,
                 };
 
                 enum class FrontFace : u32 {
@@ -287,6 +360,23 @@ namespace skyline {
                 };
                 static_assert(sizeof(ColorWriteMask) == sizeof(u32));
 
+                struct VertexArray {
+                    struct {
+                        u32 stride : 12; //!< The distance between consecutive vertices in bytes
+                        bool enable : 1;
+                        u32 _pad_ : 19;
+                    } config;
+                    Address address;
+                    u32 divisor; //!< The amount of instances that use the same vertex when the array is per-instance
+                };
+                static_assert(sizeof(VertexArray) == (sizeof(u32) * 4));
+
+                enum class IndexFormat : u32 {
+                    Uint8 = 0,
+                    Uint16 = 1,
+                    Uint32 = 2,
+                };
+
                 struct SemaphoreInfo {
                     enum class Op : u8 {
                         Release = 0,
@@ -407,14 +497,23 @@ namespace skyline {
                     u32 _pad4_[0x1A0]; // 0xE0
                     std::array<ViewportTransform, 0x10> viewportTransform; // 0x280
                     std::array<Viewport, 0x10> viewport; // 0x300
-                    u32 _pad5_[0x2B]; // 0x340
+                    u32 _pad5_[0x1D]; // 0x340
+
+                    struct {
+                        u32 first; // 0x35D
+                        u32 count; // 0x35E
+                    } vertexBuffer; //!< The range of vertices drawn by a non-indexed draw
+
+                    u32 _pad6_[0xC]; // 0x35F
 
                     struct {
                         PolygonMode front; // 0x36B
                         PolygonMode back; // 0x36C
                     } polygonMode;
 
-                    u32 _pad6_[0x68]; // 0x36D
+                    u32 _pad7_[0x13]; // 0x36D
+                    std::array<Scissor, 0x10> scissor; // 0x380
+                    u32 _pad8_[0x15]; // 0x3C0
 
                     struct {
                         u32 compareRef; // 0x3D5
@@ -422,11 +521,15 @@ namespace skyline {
                         u32 compareMask; // 0x3D7
                     } stencilBackExtra;
 
-                    u32 _pad7_[0x13]; // 0x3D8
+                    u32 _pad9_[0x13]; // 0x3D8
                     u32 rtSeparateFragData; // 0x3EB
-                    u32 _pad8_[0x6C]; // 0x3EC
+                    u32 _pad10_[0x6C]; // 0x3EC
                     std::array<VertexAttribute, 0x20> vertexAttributeState; // 0x458
-                    u32 _pad9_[0x4B]; // 0x478
+                    u32 _pad11_[0x3B]; // 0x478
+                    u32 depthTestEnable; // 0x4B3
+                    u32 _pad12_[0x6]; // 0x4B4
+                    u32 depthWriteEnable; // 0x4BA
+                    u32 _pad13_[0x8]; // 0x4BB
                     CompareOp depthTestFunc; // 0x4C3
                     float alphaTestRef; // 0x4C4
                     CompareOp alphaTestFunc; // 0x4C5
@@ -439,7 +542,7 @@ namespace skyline {
                         float a; // 0x4CA
                     } blendConstant;
 
-                    u32 _pad10_[0x4]; // 0x4CB
+                    u32 _pad14_[0x4]; // 0x4CB
 
                     struct {
                         u32 seperateAlpha; // 0x4CF
@@ -471,21 +574,22 @@ namespace skyline {
                         u32 writeMask; // 0x4E7
                     } stencilFront;
 
-                    u32 _pad11_[0x4]; // 0x4E8
+                    u32 _pad15_[0x4]; // 0x4E8
                     float lineWidthSmooth; // 0x4EC
                     float lineWidthAliased; // 0x4D
-                    u32 _pad12_[0x1F]; // 0x4EE
+                    u32 _pad16_[0x1F]; // 0x4EE
                     u32 drawBaseVertex; // 0x50D
                     u32 drawBaseInstance; // 0x50E
-                    u32 _pad13_[0x35]; // 0x50F
+                    u32 _pad17_[0x35]; // 0x50F
                     u32 clipDistanceEnable; // 0x544
                     u32 sampleCounterEnable; // 0x545
                     float pointSpriteSize; // 0x546
                     u32 zCullStatCountersEnable; // 0x547
                     u32 pointSpriteEnable; // 0x548
-                    u32 _pad14_; // 0x549
+                    u32 _pad18_; // 0x549
                     u32 shaderExceptions; // 0x54A
-                    u32 _pad15_[0x2]; // 0x54B
+                    u32 _pad19_; // 0x54B
+                    u32 counterReset; // 0x54C Resets the samples passed counter when 1 and the pipeline statistics counters otherwise
                     u32 multisampleEnable; // 0x54D
                     u32 depthTargetEnable; // 0x54E
 
@@ -496,14 +600,14 @@ namespace skyline {
                         u32 _pad1_ : 27;
                     } multisampleControl; // 0x54F
 
-                    u32 _pad16_[0x7]; // 0x550
+                    u32 _pad20_[0x7]; // 0x550
 
                     struct {
                         Address address; // 0x557
                         u32 maximumIndex; // 0x559
                     } texSamplerPool;
 
-                    u32 _pad17_; // 0x55A
+                    u32 _pad21_; // 0x55A
                     u32 polygonOffsetFactor; // 0x55B
                     u32 lineSmoothEnable; // 0x55C
 
@@ -512,7 +616,7 @@ namespace skyline {
                         u32 maximumIndex; // 0x55F
                     } texHeaderPool;
 
-                    u32 _pad18_[0x5]; // 0x560
+                    u32 _pad22_[0x5]; // 0x560
 
                     u32 stencilTwoSideEnable; // 0x565
 
@@ -523,7 +627,7 @@ namespace skyline {
                         CompareOp compareOp; // 0x569
                     } stencilBack;
 
-                    u32 _pad19_[0x17]; // 0x56A
+                    u32 _pad23_[0x17]; // 0x56A
 
                     struct {
                         u8 _unk_ : 2;
@@ -532,16 +636,34 @@ namespace skyline {
                         u32 _pad_ : 19;
                     } pointCoordReplace; // 0x581
 
-                    u32 _pad20_[0xC4]; // 0x582
+                    u32 _pad24_[0x3]; // 0x582
+                    u32 vertexEndGl; // 0x585 Ends the draw which was begun by vertexBeginGl, this performs the draw
+
+                    struct {
+                        PrimitiveTopology topology : 16;
+                        u16 _pad_;
+                    } vertexBeginGl; // 0x586
+
+                    u32 _pad25_[0x6B]; // 0x587
+
+                    struct {
+                        Address start; // 0x5F2
+                        Address limit; // 0x5F4 The address of the last byte of the index buffer
+                        IndexFormat format; // 0x5F6
+                        u32 first; // 0x5F7
+                        u32 count; // 0x5F8
+                    } indexArray; //!< The index buffer of an indexed draw, a draw is indexed if count is non-zero
+
+                    u32 _pad26_[0x4D]; // 0x5F9
                     u32 cullFaceEnable; // 0x646
                     FrontFace frontFace; // 0x647
                     CullFace cullFace; // 0x648
                     u32 pixelCentreImage; // 0x649
-                    u32 _pad21_; // 0x64A
+                    u32 _pad27_; // 0x64A
                     u32 viewportTransformEnable; // 0x64B
-                    u32 _pad22_[0x34]; // 0x64A
+                    u32 _pad28_[0x34]; // 0x64A
                     std::array<ColorWriteMask, 8> colorMask; // 0x680 For each render target
-                    u32 _pad23_[0x38]; // 0x688
+                    u32 _pad29_[0x38]; // 0x688
 
                     struct {
                         Address address; // 0x6C0
@@ -549,10 +671,20 @@ namespace skyline {
                         SemaphoreInfo info; // 0x6C3
                     } semaphore;
 
-                    u32 _pad24_[0xBC]; // 0x6C4
+                    u32 _pad30_[0x3C]; // 0x6C4
+                    std::array<VertexArray, 0x10> vertexArrays; // 0x700
+                    u32 _pad31_[0x40]; // 0x740
                     std::array<Blend, 8> independentBlend; // 0x780 For each render target
-                    u32 _pad25_[0x100]; // 0x7C0
+                    std::array<Address, 0x10> vertexArrayLimits; // 0x7C0 The address of the last byte of every vertex array
+                    u32 _pad32_[0xE0]; // 0x7E0
                     u32 firmwareCall[0x20]; // 0x8C0
+
+                    struct {
+                        u32 size; // 0x8E0
+                        Address address; // 0x8E1
+                        u32 offset; // 0x8E3 The offset of the next word written through data, this is advanced by every write to it
+                        std::array<u32, 0x10> data; // 0x8E4 Every register writes to the offset regardless of its index
+                    } constantBuffer;
                 };
             };
             static_assert(sizeof(Registers) == (constant::Maxwell3DRegisterCounter * sizeof(u32)));
@@ -561,6 +693,85 @@ namespace skyline {
             Registers registers{};
             Registers shadowRegisters{}; //!< The shadow registers, their function is controlled by the 'shadowRamControl' register
 
+            /**
+             * @brief Groups of registers which are tracked for modifications, each group corresponds to a part of the state that has to be rebuilt for a draw when it's modified
+             */
+            enum class DirtyState : u8 {
+                Viewport, //!< The viewports and viewport transforms
+                Scissor, //!< The scissor rectangles
+                Rasterizer, //!< The rasterizer state such as polygon modes, culling, line widths and point sprites
+                Multisample, //!< The multisampling state
+                DepthStencil, //!< The depth test and front/back stencil state
+                Blend, //!< The common and independent blending state including the blend constant and the alpha test
+                ColorMask, //!< The color write masks of all render targets
+                VertexAttributes, //!< The vertex attribute formats
+                TexturePools, //!< The addresses of the texture header and sampler pools
+                Count, //!< The amount of groups, this isn't a valid group
+            };
+
+            std::bitset<static_cast<size_t>(DirtyState::Count)> dirtyState; //!< If each group of registers has been written to since the group was last cleared
+
+            /**
+             * @return If any register in the supplied group has been written to since it was last cleared
+             */
+            bool IsDirty(DirtyState group) const {
+                return dirtyState.test(static_cast<size_t>(group));
+            }
+
+            /**
+             * @brief Clears the dirty state of a group, this should be done after the state derived from the group has been rebuilt
+             */
+            void ClearDirty(DirtyState group) {
+                dirtyState.reset(static_cast<size_t>(group));
+            }
+
+          private:
+            using MethodHandler = void (Maxwell3D::*)(u32 method, u32 argument);
+            using MethodTable = std::array<MethodHandler, constant::Maxwell3DRegisterCounter>;
+
+            /**
+             * @brief Generates the handler of every register for a shadow RAM mode, registers without side effects are plainly stored while the rest have a dedicated handler
+             */
+            template<Registers::MmeShadowRamControl Mode>
+            static constexpr MethodTable GenerateMethodTable();
+
+            static const std::array<MethodTable, 4> MethodTables; //!< The method handlers for every shadow RAM mode, this is indexed by MmeShadowRamControl
+            const MethodTable *methodTable{&MethodTables[static_cast<size_t>(Registers::MmeShadowRamControl::MethodTrack)]}; //!< The method handlers for the current shadow RAM mode
+
+            /**
+             * @brief Stores a register without any side effects, its dirty state group is marked if it has one
+             */
+            template<Registers::MmeShadowRamControl Mode, bool Dirty>
+            void StoreMethod(u32 method, u32 argument);
+
+            /**
+             * @brief Stores a register and calls the handler of its side effect with the argument, this is the shadowed argument when replaying
+             */
+            template<Registers::MmeShadowRamControl Mode, void (Maxwell3D::*Handler)(u32 argument)>
+            void SideEffectMethod(u32 method, u32 argument);
+
+            /**
+             * @brief Switches the method handlers to the new shadow RAM mode, the argument is never substituted by replaying as that'd prevent leaving the mode
+             */
+            void SetShadowRamControl(u32 method, u32 argument);
+
+            void LoadInstructionRam(u32 argument);
+
+            void LoadStartAddressRam(u32 argument);
+
+            void EndDraw(u32 argument);
+
+            void IncrementSyncpoint(u32 argument);
+
+            void ExecuteSemaphore(u32 argument);
+
+            void ResetCounter(u32 argument);
+
+            void CallFirmware(u32 argument);
+
+            void WriteConstantBufferWord(u32 argument);
+
+          public:
             std::array<u32, 0x10000> macroCode{}; //!< This stores GPU macros, the 256kb size is from Ryujinx
 
             Maxwell3D(const DeviceState &state);
@@ -571,6 +782,18 @@ namespace skyline {
             void ResetRegs();
 
             void CallMethod(MethodParams params);
+
+            /**
+             * @note Incrementing writes to plain registers are copied in bulk and macro arguments or macro uploads are appended at once, any range touching a register with side effects is split into individual calls
+             */
+            void CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing);
+
+            /**
+             * @brief Writes a semaphore result to the supplied address rather than the one in the registers, this is used for counters which are resolved asynchronously
+             * @param host A host pointer to the semaphore, if this is nullptr it's written through the GPU virtual address space
+             * @note This doesn't depend on any engine, so it can be called from any thread even after the engine which the result is for has been destroyed
+             */
+            static void WriteSemaphoreResult(const DeviceState &state, u64 address, Registers::SemaphoreInfo::StructureSize structureSize, u64 result, u8 *host = nullptr);
         };
     }
 }
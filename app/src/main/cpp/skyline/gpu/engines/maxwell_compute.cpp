@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "maxwell_compute.h"
+
+namespace skyline::gpu::engine {
+    MaxwellCompute::MaxwellCompute(const DeviceState &state) : Engine(state), inlineUpload(state) {}
+
+    void MaxwellCompute::CallMethod(MethodParams params) {
+        if (params.method < constant::KeplerMemoryRegisterCounter) {
+            inlineUpload.CallMethod(params);
+            return;
+        }
+
+        state.logger->Debug("Called method in Maxwell Compute: 0x{:X} args: 0x{:X}", params.method, params.argument);
+
+        if (params.method >= constant::MaxwellComputeRegisterCounter) {
+            state.logger->Warn("Called out of range method in Maxwell Compute: 0x{:X} args: 0x{:X}", params.method, params.argument);
+            return;
+        }
+
+        registers.raw[params.method] = params.argument;
+
+        if (params.method == MAXWELLCOMPUTE_OFFSET(sendSignalingPcas))
+            Launch();
+    }
+
+    void MaxwellCompute::CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) {
+        if (method < constant::KeplerMemoryRegisterCounter && !incrementing) {
+            inlineUpload.CallMethodBatch(method, arguments, subChannel, incrementing);
+            return;
+        }
+
+        Engine::CallMethodBatch(method, arguments, subChannel, incrementing);
+    }
+
+    void MaxwellCompute::Launch() {
+        auto qmd{state.gpu->memoryManager.Read<Qmd>(static_cast<u64>(registers.sendPcas) << 8)};
+
+        ComputeLaunch launch{
+            .programAddress = registers.codeAddress.Pack() + qmd.programOffset,
+            .gridDimensions = {qmd.ctaRasterWidth, qmd.ctaRasterHeight, qmd.ctaRasterDepth},
+            .blockDimensions = {qmd.ctaThreadDimension0, qmd.ctaThreadDimension1, qmd.ctaThreadDimension2},
+            .sharedMemorySize = qmd.sharedMemorySize,
+        };
+
+        for (u8 index{}; index < constant::ComputeConstantBufferCount; index++) {
+            if (qmd.constantBufferValid & (1U << index)) {
+                auto &constantBuffer{qmd.constantBuffers[index]};
+                launch.constantBuffers[index] = {(static_cast<u64>(constantBuffer.addressUpper) << 32) | constantBuffer.addressLower, constantBuffer.size};
+            }
+        }
+
+        state.logger->Debug("Maxwell Compute dispatch: Program: 0x{:X}, Grid: {}x{}x{}, Block: {}x{}x{}, Shared Memory: 0x{:X}", launch.programAddress, launch.gridDimensions[0], launch.gridDimensions[1], launch.gridDimensions[2], launch.blockDimensions[0], launch.blockDimensions[1], launch.blockDimensions[2], launch.sharedMemorySize);
+
+        if (!launch.gridDimensions[0] || !launch.gridDimensions[1] || !launch.gridDimensions[2])
+            return; // Empty dispatches don't do anything on the guest either
+
+        state.gpu->graphicsContext.Dispatch(launch);
+    }
+}
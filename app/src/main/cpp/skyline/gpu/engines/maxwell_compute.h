@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "kepler_memory.h"
+
+#define MAXWELLCOMPUTE_OFFSET(field) U32_OFFSET(skyline::gpu::engine::MaxwellCompute::Registers, field)
+
+namespace skyline {
+    namespace constant {
+        constexpr u32 MaxwellComputeRegisterCounter{0x1000}; //!< The number of Maxwell Compute registers
+        constexpr u8 ComputeConstantBufferCount{8}; //!< The maximum amount of constant buffers bound to a compute dispatch
+    }
+
+    namespace gpu::engine {
+        /**
+         * @brief A compute dispatch that was decoded from a launch descriptor (QMD)
+         */
+        struct ComputeLaunch {
+            u64 programAddress; //!< The GPU address of the shader program
+            std::array<u32, 3> gridDimensions; //!< The amount of workgroups in every dimension
+            std::array<u16, 3> blockDimensions; //!< The amount of invocations in every dimension of a workgroup
+            u32 sharedMemorySize; //!< The size of the workgroup's shared memory in bytes
+
+            struct ConstantBuffer {
+                u64 address; //!< The GPU address of the constant buffer, this is 0 if it isn't bound
+                u32 size; //!< The size of the constant buffer in bytes
+            };
+            std::array<ConstantBuffer, constant::ComputeConstantBufferCount> constantBuffers;
+        };
+
+        /**
+         * @brief The Maxwell Compute engine (Class B1C0) launches compute dispatches which are described by a QMD in memory, it also has an inline upload identical to Kepler Memory
+         * @url https://github.com/devkitPro/deko3d/blob/master/source/maxwell/engine_compute.def
+         * @url https://github.com/NVIDIA/open-gpu-doc/blob/master/classes/compute/clb1c0qmd.h
+         */
+        class MaxwellCompute : public Engine {
+          public:
+#pragma pack(push, 1)
+            union Registers {
+                std::array<u32, constant::MaxwellComputeRegisterCounter> raw;
+
+                struct Address {
+                    u32 high;
+                    u32 low;
+
+                    u64 Pack() {
+                        return (static_cast<u64>(high) << 32) | low;
+                    }
+                };
+                static_assert(sizeof(Address) == sizeof(u64));
+
+                struct {
+                    u32 _pad0_[0xAD]; // 0x0
+                    u32 sendPcas; // 0xAD The address of the QMD shifted right by 8 bits
+                    u32 _pad1_; // 0xAE
+                    u32 sendSignalingPcas; // 0xAF Writing to this launches the dispatch described by the QMD at sendPcas
+                    u32 _pad2_[0x4D2]; // 0xB0
+                    Address codeAddress; // 0x582 The base GPU address that the program offsets in QMDs are relative to
+                };
+            };
+            static_assert(sizeof(Registers) == (constant::MaxwellComputeRegisterCounter * sizeof(u32)));
+#pragma pack(pop)
+
+            /**
+             * @brief The layout of the fields of a QMD (Version 01_07) that dispatches are translated from, it's 0x100 bytes in total
+             */
+            struct Qmd {
+                u32 _pad0_[0x8]; // 0x0
+                u32 programOffset; // 0x20 The offset of the program from codeAddress
+                u32 _pad1_[0x3]; // 0x24
+                u32 ctaRasterWidth : 31; // 0x30 The amount of workgroups in the X dimension
+                u32 _pad2_ : 1;
+                u16 ctaRasterHeight; // 0x34
+                u16 ctaRasterDepth;
+                u32 _pad3_[0x3]; // 0x38
+                u32 sharedMemorySize : 18; // 0x44
+                u32 _pad4_ : 14;
+                u16 _pad5_; // 0x48
+                u16 ctaThreadDimension0; // The amount of invocations in the X dimension of a workgroup
+                u16 ctaThreadDimension1; // 0x4C
+                u16 ctaThreadDimension2;
+                u8 constantBufferValid; // 0x50 A mask of the constant buffers which are bound
+                u8 _pad6_[0x23]; // 0x51
+
+                struct {
+                    u32 addressLower;
+                    u32 addressUpper : 8;
+                    u32 _pad_ : 7;
+                    u32 size : 17; //!< The size of the constant buffer in bytes
+                } constantBuffers[constant::ComputeConstantBufferCount]; // 0x74
+                u32 _pad7_[0x13]; // 0xB4
+            };
+            static_assert(sizeof(Qmd) == 0x100);
+            static_assert(offsetof(Qmd, constantBuffers) == 0x74);
+
+          private:
+            Registers registers{};
+            KeplerMemory inlineUpload; //!< The inline upload registers are identical to the ones of Kepler Memory, so they're handled by an instance of it
+
+            /**
+             * @brief Reads the QMD at sendPcas and records the dispatch it describes
+             */
+            void Launch();
+
+          public:
+            MaxwellCompute(const DeviceState &state);
+
+            void CallMethod(MethodParams params) override;
+
+            /**
+             * @note Sequences of inline upload data are forwarded to Kepler Memory, so they're uploaded directly from the pushbuffer
+             */
+            void CallMethodBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) override;
+        };
+    }
+}
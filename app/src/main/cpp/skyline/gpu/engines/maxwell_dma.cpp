@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include <gpu/gpfifo_trace.h>
+#include "maxwell_dma.h"
+
+namespace skyline::gpu::engine {
+    MaxwellDma::MaxwellDma(const DeviceState &state) : Engine(state) {
+        constexpr u64 GpuTickFrequency{614400000}; //!< The frequency of the GPU timer (1 GHz * 384 / 625)
+        gpuTickMultiplier = static_cast<u64>((static_cast<__uint128_t>(GpuTickFrequency) << 32) / util::GetTickFrequency());
+    }
+
+    void MaxwellDma::CallMethod(MethodParams params) {
+        state.logger->Debug("Called method in Maxwell DMA: 0x{:X} args: 0x{:X}", params.method, params.argument);
+
+        if (params.method >= constant::MaxwellDmaRegisterCounter) {
+            state.logger->Warn("Called out of range method in Maxwell DMA: 0x{:X} args: 0x{:X}", params.method, params.argument);
+            return;
+        }
+
+        registers.raw[params.method] = params.argument;
+
+        if (params.method == MAXWELLDMA_OFFSET(launchDma))
+            LaunchDma();
+    }
+
+    void MaxwellDma::LaunchDma() {
+        auto &memoryManager{state.gpu->memoryManager};
+        auto trace{state.gpu->scheduler.GetTrace()}; // Everything the copy reads is captured, as replaying it can't rely on guest memory
+        auto &launch{registers.launchDma};
+        if (launch.dataTransferType == Registers::LaunchDma::DataTransferType::None) {
+            ReleaseSemaphore();
+            return;
+        }
+
+        // Remapping allows swizzling the components of every element, only the element size is respected as the components are always copied as-is
+        u32 bytesPerElement{1};
+        if (launch.remapEnable) {
+            auto &remap{registers.remapComponents};
+            bytesPerElement = (remap.componentSizeMinusOne + 1U) * (remap.dstComponentsMinusOne + 1U);
+
+            using Swizzle = Registers::RemapComponents::Swizzle;
+            if (remap.dstX != Swizzle::SrcX || (remap.dstComponentsMinusOne >= 1 && remap.dstY != Swizzle::SrcY) || (remap.dstComponentsMinusOne >= 2 && remap.dstZ != Swizzle::SrcZ) || (remap.dstComponentsMinusOne >= 3 && remap.dstW != Swizzle::SrcW))
+                state.logger->Warn("Maxwell DMA component remapping isn't supported, the components are copied without being swizzled");
+        }
+
+        u32 lineLength{registers.lineLengthIn * bytesPerElement}; // The length of a line in bytes
+        u32 lineCount{launch.multiLineEnable ? registers.lineCount : 1};
+        if (!lineLength || !lineCount) {
+            ReleaseSemaphore();
+            return;
+        }
+
+        u64 srcAddress{registers.offsetIn.Pack()};
+        u64 dstAddress{registers.offsetOut.Pack()};
+        bool srcBlockLinear{launch.srcMemoryLayout == Registers::LaunchDma::MemoryLayout::BlockLinear};
+        bool dstBlockLinear{launch.dstMemoryLayout == Registers::LaunchDma::MemoryLayout::BlockLinear};
+
+        // Only a single layer of a block-linear surface is accessed by a copy, this returns the address and the size of that layer
+        auto getSurfaceLayer{[bytesPerElement](const Registers::Surface &surface, u64 address) -> std::pair<u64, size_t> {
+            if (surface.blockSize.depthLog2)
+                throw exception("Maxwell DMA copies with a block depth of {} are unimplemented", 1U << surface.blockSize.depthLog2);
+
+            auto layerSize{texture::GetBlockLinearSize(surface.width * bytesPerElement, surface.height, 1U << surface.blockSize.heightLog2)};
+            return {address + (layerSize * surface.layer), layerSize};
+        }};
+
+        if (!srcBlockLinear && !dstBlockLinear) {
+            u64 srcSize{(static_cast<u64>(registers.pitchIn) * (lineCount - 1)) + lineLength};
+            u64 dstSize{(static_cast<u64>(registers.pitchOut) * (lineCount - 1)) + lineLength};
+
+            memoryManager.Access(srcAddress, srcSize, false, [&](u8 *src) {
+                if (trace)
+                    trace->WriteMemory(srcAddress, span<const u8>(src, srcSize));
+                memoryManager.Access(dstAddress, dstSize, true, [&](u8 *dst) {
+                    // Tightly packed lines are contiguous in both regions and are copied in bulk
+                    if (lineCount == 1 || (registers.pitchIn == lineLength && registers.pitchOut == lineLength)) {
+                        std::memcpy(dst, src, static_cast<size_t>(lineLength) * lineCount);
+                    } else {
+                        for (u32 line{}; line < lineCount; line++)
+                            std::memcpy(dst + (static_cast<size_t>(registers.pitchOut) * line), src + (static_cast<size_t>(registers.pitchIn) * line), lineLength);
+                    }
+                });
+            });
+
+            state.gpu->textureCache.InvalidateGpu(dstAddress, dstSize);
+        } else if (srcBlockLinear && !dstBlockLinear) {
+            auto &surface{registers.srcSurface};
+            auto [layerAddress, layerSize]{getSurfaceLayer(surface, srcAddress)};
+            u64 dstSize{(static_cast<u64>(registers.pitchOut) * (lineCount - 1)) + lineLength};
+
+            memoryManager.Access(layerAddress, layerSize, false, [&](u8 *src) {
+                if (trace)
+                    trace->WriteMemory(layerAddress, span<const u8>(src, layerSize));
+                memoryManager.Access(dstAddress, dstSize, true, [&](u8 *dst) {
+                    texture::CopyBlockLinearRegion<false>(src, surface.width * bytesPerElement, 1U << surface.blockSize.heightLog2, surface.origin.x * bytesPerElement, surface.origin.y, dst, registers.pitchOut, lineLength, lineCount);
+                });
+            });
+
+            state.gpu->textureCache.InvalidateGpu(dstAddress, dstSize);
+        } else if (!srcBlockLinear && dstBlockLinear) {
+            auto &surface{registers.dstSurface};
+            auto layer{getSurfaceLayer(surface, dstAddress)}; // This isn't a structured binding as it's captured by the lambda below
+            u64 srcSize{(static_cast<u64>(registers.pitchIn) * (lineCount - 1)) + lineLength};
+
+            memoryManager.Access(srcAddress, srcSize, false, [&](u8 *src) {
+                if (trace)
+                    trace->WriteMemory(srcAddress, span<const u8>(src, srcSize));
+                memoryManager.Access(layer.first, layer.second, true, [&](u8 *dst) {
+                    texture::CopyBlockLinearRegion<true>(dst, surface.width * bytesPerElement, 1U << surface.blockSize.heightLog2, surface.origin.x * bytesPerElement, surface.origin.y, src, registers.pitchIn, lineLength, lineCount);
+                });
+            });
+
+            state.gpu->textureCache.InvalidateGpu(layer.first, layer.second);
+        } else {
+            // Copies between two block-linear surfaces are deswizzled into a temporary pitch-linear buffer prior to being swizzled into the destination
+            auto &srcSurface{registers.srcSurface};
+            auto &dstSurface{registers.dstSurface};
+            auto [srcLayerAddress, srcLayerSize]{getSurfaceLayer(srcSurface, srcAddress)};
+            auto [dstLayerAddress, dstLayerSize]{getSurfaceLayer(dstSurface, dstAddress)};
+
+            std::vector<u8> buffer(static_cast<size_t>(lineLength) * lineCount);
+            memoryManager.Access(srcLayerAddress, srcLayerSize, false, [&](u8 *src) {
+                if (trace)
+                    trace->WriteMemory(srcLayerAddress, span<const u8>(src, srcLayerSize));
+                texture::CopyBlockLinearRegion<false>(src, srcSurface.width * bytesPerElement, 1U << srcSurface.blockSize.heightLog2, srcSurface.origin.x * bytesPerElement, srcSurface.origin.y, buffer.data(), lineLength, lineLength, lineCount);
+            });
+            memoryManager.Access(dstLayerAddress, dstLayerSize, true, [&](u8 *dst) {
+                texture::CopyBlockLinearRegion<true>(dst, dstSurface.width * bytesPerElement, 1U << dstSurface.blockSize.heightLog2, dstSurface.origin.x * bytesPerElement, dstSurface.origin.y, buffer.data(), lineLength, lineLength, lineCount);
+            });
+
+            state.gpu->textureCache.InvalidateGpu(dstLayerAddress, dstLayerSize);
+        }
+
+        ReleaseSemaphore();
+    }
+
+    void MaxwellDma::ReleaseSemaphore() {
+        struct FourWordResult {
+            u64 value;
+            u64 timestamp;
+        };
+
+        u64 address{registers.semaphore.address.Pack()};
+        switch (registers.launchDma.semaphoreType) {
+            case Registers::LaunchDma::SemaphoreType::None:
+                break;
+            case Registers::LaunchDma::SemaphoreType::ReleaseOneWord:
+                state.gpu->memoryManager.Write<u32>(registers.semaphore.payload, address);
+                break;
+            case Registers::LaunchDma::SemaphoreType::ReleaseFourWord: {
+                // Convert the current host tick count to GPU ticks
+                u64 timestamp{static_cast<u64>((static_cast<__uint128_t>(util::GetTimeTicks()) * gpuTickMultiplier) >> 32)};
+                state.gpu->memoryManager.Write<FourWordResult>(FourWordResult{registers.semaphore.payload, timestamp}, address);
+                break;
+            }
+            default:
+                state.logger->Warn("Unsupported Maxwell DMA semaphore type: {}", static_cast<u8>(registers.launchDma.semaphoreType));
+                break;
+        }
+    }
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "engine.h"
+
+#define MAXWELLDMA_OFFSET(field) U32_OFFSET(skyline::gpu::engine::MaxwellDma::Registers, field)
+
+namespace skyline {
+    namespace constant {
+        constexpr u32 MaxwellDmaRegisterCounter{0x800}; //!< The number of Maxwell DMA registers
+    }
+
+    namespace gpu::engine {
+        /**
+         * @brief The Maxwell DMA engine (Class B0B5) copies memory within the GPU address space, it's used for buffer uploads and for converting between pitch-linear and block-linear layouts
+         * @url https://github.com/devkitPro/deko3d/blob/master/source/maxwell/engine_dma.def
+         */
+        class MaxwellDma : public Engine {
+          public:
+#pragma pack(push, 1)
+            union Registers {
+                std::array<u32, constant::MaxwellDmaRegisterCounter> raw;
+
+                struct Address {
+                    u32 high;
+                    u32 low;
+
+                    u64 Pack() {
+                        return (static_cast<u64>(high) << 32) | low;
+                    }
+                };
+                static_assert(sizeof(Address) == sizeof(u64));
+
+                struct LaunchDma {
+                    enum class DataTransferType : u8 {
+                        None = 0,
+                        Pipelined = 1,
+                        NonPipelined = 2,
+                    };
+
+                    enum class SemaphoreType : u8 {
+                        None = 0,
+                        ReleaseOneWord = 1,
+                        ReleaseFourWord = 2,
+                    };
+
+                    enum class MemoryLayout : u8 {
+                        BlockLinear = 0,
+                        Pitch = 1,
+                    };
+
+                    DataTransferType dataTransferType : 2;
+                    bool flushEnable : 1;
+                    SemaphoreType semaphoreType : 2;
+                    u8 interruptType : 2;
+                    MemoryLayout srcMemoryLayout : 1;
+                    MemoryLayout dstMemoryLayout : 1;
+                    bool multiLineEnable : 1;
+                    bool remapEnable : 1;
+                    u32 _pad_ : 21;
+                };
+                static_assert(sizeof(LaunchDma) == sizeof(u32));
+
+                struct RemapComponents {
+                    enum class Swizzle : u8 {
+                        SrcX = 0,
+                        SrcY = 1,
+                        SrcZ = 2,
+                        SrcW = 3,
+                        ConstA = 4,
+                        ConstB = 5,
+                        NoWrite = 6,
+                    };
+
+                    Swizzle dstX : 3;
+                    u8 _pad0_ : 1;
+                    Swizzle dstY : 3;
+                    u8 _pad1_ : 1;
+                    Swizzle dstZ : 3;
+                    u8 _pad2_ : 1;
+                    Swizzle dstW : 3;
+                    u8 _pad3_ : 1;
+                    u8 componentSizeMinusOne : 2;
+                    u8 _pad4_ : 2;
+                    u8 srcComponentsMinusOne : 2;
+                    u8 _pad5_ : 2;
+                    u8 dstComponentsMinusOne : 2;
+                    u8 _pad6_ : 6;
+                };
+                static_assert(sizeof(RemapComponents) == sizeof(u32));
+
+                /**
+                 * @brief The layout of a block-linear surface that's copied to or from
+                 */
+                struct Surface {
+                    struct {
+                        u8 widthLog2 : 4; //!< The width of the blocks in GOBs, this is always 1 on the Tegra X1
+                        u8 heightLog2 : 4; //!< The height of the blocks in GOBs
+                        u8 depthLog2 : 4; //!< The depth of the blocks in GOBs
+                        u8 gobHeight : 4;
+                        u16 _pad_;
+                    } blockSize;
+                    u32 width; //!< The width of the surface in bytes or in elements if remapping is enabled
+                    u32 height; //!< The height of the surface in lines
+                    u32 depth;
+                    u32 layer; //!< The layer of the surface which is copied to or from
+                    struct {
+                        u16 x; //!< The X-axis offset of the region in the surface in bytes or in elements if remapping is enabled
+                        u16 y; //!< The Y-axis offset of the region in the surface in lines
+                    } origin;
+                };
+                static_assert(sizeof(Surface) == (0x6 * sizeof(u32)));
+
+                struct {
+                    u32 _pad0_[0x90]; // 0x0
+
+                    struct {
+                        Address address; // 0x90
+                        u32 payload; // 0x92
+                    } semaphore;
+
+                    u32 _pad1_[0x2D]; // 0x93
+                    LaunchDma launchDma; // 0xC0
+                    u32 _pad2_[0x3F]; // 0xC1
+                    Address offsetIn; // 0x100
+                    Address offsetOut; // 0x102
+                    u32 pitchIn; // 0x104
+                    u32 pitchOut; // 0x105
+                    u32 lineLengthIn; // 0x106
+                    u32 lineCount; // 0x107
+                    u32 _pad3_[0xB8]; // 0x108
+                    u32 remapConstA; // 0x1C0
+                    u32 remapConstB; // 0x1C1
+                    RemapComponents remapComponents; // 0x1C2
+                    Surface dstSurface; // 0x1C3
+                    u32 _pad4_; // 0x1C9
+                    Surface srcSurface; // 0x1CA
+                };
+            };
+            static_assert(sizeof(Registers) == (constant::MaxwellDmaRegisterCounter * sizeof(u32)));
+#pragma pack(pop)
+
+          private:
+            Registers registers{};
+            u64 gpuTickMultiplier; //!< The amount of GPU ticks in a host tick as 32.32 fixed-point
+
+            /**
+             * @brief Performs the copy described by the registers, this is triggered by a write to launchDma
+             */
+            void LaunchDma();
+
+            /**
+             * @brief Releases the semaphore after a copy has been completed
+             */
+            void ReleaseSemaphore();
+
+          public:
+            MaxwellDma(const DeviceState &state);
+
+            void CallMethod(MethodParams params) override;
+        };
+    }
+}
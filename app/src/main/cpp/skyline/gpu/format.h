@@ -9,5 +9,16 @@ namespace skyline::gpu::format {
     using Format = gpu::texture::Format;
 
     constexpr Format RGBA8888Unorm{sizeof(u8) * 4, 1, 1, vk::Format::eR8G8B8A8Unorm}; //!< 8-bits per channel 4-channel pixels
+    constexpr Format BGRA8888Unorm{sizeof(u8) * 4, 1, 1, vk::Format::eB8G8R8A8Unorm}; //!< 8-bits per channel 4-channel pixels with the red and blue channels swapped
+    constexpr Format RGBA16Float{sizeof(u16) * 4, 1, 1, vk::Format::eR16G16B16A16Sfloat}; //!< 16-bit floating-point per channel 4-channel pixels
+    constexpr Format RGB10A2Unorm{sizeof(u32), 1, 1, vk::Format::eA2B10G10R10UnormPack32}; //!< Red, green and blue channels: 10-bit, Alpha channel: 2-bit, red is in the lowest bits
     constexpr Format RGB565Unorm{sizeof(u8) * 2, 1, 1, vk::Format::eR5G6B5UnormPack16}; //!< Red channel: 5-bit, Green channel: 6-bit, Blue channel: 5-bit
+    constexpr Format BC1RGBAUnorm{sizeof(u64), 4, 4, vk::Format::eBc1RgbaUnormBlock}; //!< 4x4 blocks of two RGB565 endpoints with 2-bit indices, 1-bit alpha
+    constexpr Format BC2Unorm{sizeof(u64) * 2, 4, 4, vk::Format::eBc2UnormBlock}; //!< 4x4 blocks of explicit 4-bit alpha followed by a BC1 color block
+    constexpr Format BC3Unorm{sizeof(u64) * 2, 4, 4, vk::Format::eBc3UnormBlock}; //!< 4x4 blocks of interpolated alpha followed by a BC1 color block
+    constexpr Format BC4Unorm{sizeof(u64), 4, 4, vk::Format::eBc4UnormBlock}; //!< 4x4 blocks of a single interpolated channel
+    constexpr Format BC5Unorm{sizeof(u64) * 2, 4, 4, vk::Format::eBc5UnormBlock}; //!< 4x4 blocks of two interpolated channels
+    constexpr Format BC6HUfloat{sizeof(u64) * 2, 4, 4, vk::Format::eBc6HUfloatBlock}; //!< 4x4 blocks of unsigned HDR RGB
+    constexpr Format BC6HSfloat{sizeof(u64) * 2, 4, 4, vk::Format::eBc6HSfloatBlock}; //!< 4x4 blocks of signed HDR RGB
+    constexpr Format BC7Unorm{sizeof(u64) * 2, 4, 4, vk::Format::eBc7UnormBlock}; //!< 4x4 blocks of RGBA with one of 8 modes
 }
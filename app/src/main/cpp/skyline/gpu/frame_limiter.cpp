@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <algorithm>
+#include <dlfcn.h>
+#include <ctime>
+#include "frame_limiter.h"
+
+namespace skyline::gpu {
+    FrameLimiter::FrameLimiter(const DeviceState &state) : state(state) {
+        ApplySettings();
+
+        if (!state.settings->GetBool("thermal_limiter", false))
+            return;
+
+        // AThermal was added in API 30, it's loaded at runtime so the thermal policy is just inactive on older versions
+        auto libandroid{dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL)};
+        if (!libandroid)
+            return;
+
+        auto acquireManager{reinterpret_cast<AcquireManagerFunction>(dlsym(libandroid, "AThermal_acquireManager"))};
+        getCurrentThermalStatus = reinterpret_cast<GetCurrentThermalStatusFunction>(dlsym(libandroid, "AThermal_getCurrentThermalStatus"));
+        releaseManager = reinterpret_cast<ReleaseManagerFunction>(dlsym(libandroid, "AThermal_releaseManager"));
+        if (acquireManager && getCurrentThermalStatus && releaseManager)
+            thermalManager = acquireManager();
+
+        if (!thermalManager)
+            state.logger->Info("The thermal status isn't available on this device, frames will only be limited to the frame limit");
+    }
+
+    void FrameLimiter::ApplySettings() {
+        frameRate = static_cast<u32>(std::max(state.settings->GetStringInt("frame_limit", 0), 0));
+    }
+
+    FrameLimiter::~FrameLimiter() {
+        if (thermalManager)
+            releaseManager(thermalManager);
+    }
+
+    u32 FrameLimiter::GetFrameRate(u64 now) {
+        if (thermalManager && now >= nextThermalPoll) {
+            auto status{getCurrentThermalStatus(thermalManager)};
+            if (status != thermalStatus) {
+                state.logger->Info("Thermal status changed from {} to {}", thermalStatus, status);
+                thermalStatus = status;
+            }
+            nextThermalPoll = now + ThermalPollInterval;
+        }
+
+        u32 thermalFrameRate{ThermalFrameRates[static_cast<size_t>(std::clamp(thermalStatus, 0, static_cast<int>(ThermalFrameRates.size() - 1)))]};
+        if (!thermalFrameRate)
+            return frameRate;
+        else if (!frameRate)
+            return thermalFrameRate;
+        return std::min(frameRate, thermalFrameRate);
+    }
+
+    void FrameLimiter::Limit() {
+        auto now{util::GetTimeNs()};
+        auto limit{GetFrameRate(now)};
+        if (limit != activeFrameRate) {
+            if (limit)
+                state.logger->Info("Limiting frames to {} FPS", limit);
+            else
+                state.logger->Info("Frames are no longer limited");
+            activeFrameRate = limit;
+        }
+
+        if (!limit) {
+            nextFrameTime = 0;
+            return;
+        }
+
+        if (nextFrameTime > now) {
+            auto remaining{nextFrameTime - now};
+            if (remaining > SpinDuration) {
+                timespec duration{
+                    .tv_sec = static_cast<time_t>((remaining - SpinDuration) / constant::NsInSecond),
+                    .tv_nsec = static_cast<long>((remaining - SpinDuration) % constant::NsInSecond),
+                };
+                nanosleep(&duration, nullptr);
+            }
+
+            while ((now = util::GetTimeNs()) < nextFrameTime)
+                asm volatile("YIELD");
+        }
+
+        // A frame that's later than an entire frame duration resets the pacing rather than letting the following frames catch up on it
+        u64 frameDuration{constant::NsInSecond / limit};
+        if (nextFrameTime && now - nextFrameTime < frameDuration)
+            nextFrameTime += frameDuration;
+        else
+            nextFrameTime = now + frameDuration;
+    }
+}
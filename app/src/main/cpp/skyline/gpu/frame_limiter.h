@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline::gpu {
+    /**
+     * @brief The FrameLimiter class paces the presentation of guest frames to a maximum frame rate, this holds back the guest as it can't reuse a buffer till it has been presented
+     * @details The cap can additionally be lowered based on the thermal status of the device (AThermal), so that the device doesn't reach the point of thermal throttling which would ruin performance for far longer
+     */
+    class FrameLimiter {
+      private:
+        using AcquireManagerFunction = void *(*)();
+        using GetCurrentThermalStatusFunction = int (*)(void *manager);
+        using ReleaseManagerFunction = void (*)(void *manager);
+
+        static constexpr u64 SpinDuration{1000000}; //!< The duration at the end of every wait that's spun for rather than slept, as the wakeup from a sleep can be late by up to a millisecond (1ms)
+        static constexpr u64 ThermalPollInterval{constant::NsInSecond}; //!< The interval at which the thermal status is checked, the status is retrieved through a binder call so it isn't checked on every frame (1s)
+
+        /**
+         * @brief The frame rate caps for every AThermalStatus, a cap of 0 doesn't limit the frame rate
+         * @note The caps are applied from THERMAL_STATUS_LIGHT onwards, by THERMAL_STATUS_SEVERE the device would already be throttling
+         */
+        static constexpr std::array<u32, 7> ThermalFrameRates{0, 60, 45, 30, 30, 30, 30};
+
+        const DeviceState &state;
+        u32 frameRate{}; //!< The frame rate cap set by the user, this is controlled by the "frame_limit" setting and is 0 if frames aren't limited
+        u32 activeFrameRate{}; //!< The frame rate cap that was applied to the last frame
+        u64 nextFrameTime{}; //!< The time at which the next frame can be presented at, this is 0 if there's no prior frame to pace against
+
+        void *thermalManager{}; //!< The AThermalManager of the process, this is nullptr if the thermal policy is disabled or unsupported
+        GetCurrentThermalStatusFunction getCurrentThermalStatus{};
+        ReleaseManagerFunction releaseManager{};
+        int thermalStatus{}; //!< The latest AThermalStatus of the device
+        u64 nextThermalPoll{}; //!< The time at which the thermal status should be checked next
+
+        /**
+         * @return The frame rate cap for the next frame based on the user's cap and the thermal status of the device
+         */
+        u32 GetFrameRate(u64 now);
+
+      public:
+        FrameLimiter(const DeviceState &state);
+
+        ~FrameLimiter();
+
+        /**
+         * @brief Reads the "frame_limit" setting again, the thermal policy is only configured on construction
+         */
+        void ApplySettings();
+
+        /**
+         * @brief Blocks till the next frame can be presented according to the current frame rate cap
+         * @note The wait is a sleep followed by spinning for the final part, so frames are paced precisely rather than to the granularity of the sleep
+         */
+        void Limit();
+    };
+}
@@ -1,36 +1,54 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <gpu.h>
 #include <gpu/engines/maxwell_3d.h>
-#include "gpfifo.h"
+#include <os.h>
+#include <statistics.h>
+#include <allocation.h>
+#include <trace.h>
+#include <benchmark.h>
+#include "gpfifo_trace.h"
+
+extern std::atomic<bool> Halt;
 
 namespace skyline::gpu::gpfifo {
     void GPFIFO::Send(MethodParams params) {
-        state.logger->Debug("Called GPU method - method: 0x{:X} argument: 0x{:X} subchannel: 0x{:X} last: {}", params.method, params.argument, params.subChannel, params.lastCall);
+        state.logger->DebugCompact("Called GPU method - method: 0x{:X} argument: 0x{:X} subchannel: 0x{:X} last: {}", params.method, params.argument, params.subChannel, params.lastCall);
 
         if (params.method == 0) {
+            // Engines are created on their first binding, as most channels only use a subset of them
+            auto bind{[&](auto &engine) {
+                using EngineType = typename std::decay_t<decltype(engine)>::element_type;
+                if (!engine)
+                    engine = std::make_shared<EngineType>(state);
+                subchannels.at(params.subChannel) = engine;
+            }};
+
             switch (static_cast<EngineID>(params.argument)) {
                 case EngineID::Fermi2D:
-                    subchannels.at(params.subChannel) = state.gpu->fermi2D;
+                    bind(fermi2D);
                     break;
                 case EngineID::KeplerMemory:
-                    subchannels.at(params.subChannel) = state.gpu->keplerMemory;
+                    bind(keplerMemory);
                     break;
                 case EngineID::Maxwell3D:
-                    subchannels.at(params.subChannel) = state.gpu->maxwell3D;
+                    bind(maxwell3D);
                     break;
                 case EngineID::MaxwellCompute:
-                    subchannels.at(params.subChannel) = state.gpu->maxwellCompute;
+                    bind(maxwellCompute);
                     break;
                 case EngineID::MaxwellDma:
-                    subchannels.at(params.subChannel) = state.gpu->maxwellDma;
+                    bind(maxwellDma);
                     break;
                 default:
                     throw exception("Unknown engine 0x{:X} cannot be bound to subchannel {}", params.argument, params.subChannel);
             }
 
-            state.logger->Info("Bound GPU engine 0x{:X} to subchannel {}", params.argument, params.subChannel);
+            state.logger->Info("Bound GPU engine 0x{:X} to subchannel {} of channel {}", params.argument, params.subChannel, id);
             return;
         } else if (params.method < constant::GpfifoRegisterCount) {
             gpfifoEngine.CallMethod(params);
@@ -42,32 +60,64 @@ namespace skyline::gpu::gpfifo {
         }
     }
 
-    void GPFIFO::Process(const std::vector<u32> &segment) {
-        for (auto entry{segment.begin()}; entry != segment.end(); entry++) {
+    void GPFIFO::SendBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing) {
+        if (method < constant::GpfifoRegisterCount) {
+            for (size_t index{}; index < arguments.size(); index++)
+                Send(MethodParams{static_cast<u16>(incrementing ? method + index : method), arguments[index], subChannel, index == arguments.size() - 1});
+            return;
+        }
+
+        if (subchannels.at(subChannel) == nullptr)
+            throw exception("Calling method on unbound channel");
+
+        subchannels[subChannel]->CallMethodBatch(method, arguments, subChannel, incrementing);
+    }
+
+    void GPFIFO::ExecuteSyncpoint(bool increment, SyncpointOperation operation) {
+        auto argument{engine::GPFIFO::SyncpointOperationArgument(increment, operation.id)};
+        if (increment) {
+            for (u32 count{}; count < operation.value; count++)
+                gpfifoEngine.CallMethod(MethodParams{engine::GPFIFO::SyncpointOperationMethod, argument});
+        } else {
+            gpfifoEngine.CallMethod(MethodParams{engine::GPFIFO::SyncpointPayloadMethod, operation.value});
+            gpfifoEngine.CallMethod(MethodParams{engine::GPFIFO::SyncpointOperationMethod, argument});
+        }
+    }
+
+    void GPFIFO::Process(span<u32> segment) {
+        for (size_t index{}; index < segment.size(); index++) {
             // An entry containing all zeroes is a NOP, skip over it
-            if (*entry == 0)
+            if (segment[index] == 0)
                 continue;
 
-            auto methodHeader{reinterpret_cast<const PushBufferMethodHeader *>(&*entry)};
+            PushBufferMethodHeader methodHeader{.raw = segment[index]};
 
-            switch (methodHeader->secOp) {
-                case PushBufferMethodHeader::SecOp::IncMethod:
-                    for (u16 i{}; i < methodHeader->methodCount; i++)
-                        Send(MethodParams{static_cast<u16>(methodHeader->methodAddress + i), *++entry, methodHeader->methodSubChannel, i == methodHeader->methodCount - 1});
+            // The arguments of a method sequence directly follow the header
+            auto arguments{[&]() {
+                if (index + methodHeader.methodCount >= segment.size())
+                    throw exception("Pushbuffer method sequence with {} arguments exceeds the segment", methodHeader.methodCount);
+
+                auto arguments{segment.subspan(index + 1, methodHeader.methodCount)};
+                index += methodHeader.methodCount;
+                return arguments;
+            }};
 
+            switch (methodHeader.secOp) {
+                case PushBufferMethodHeader::SecOp::IncMethod:
+                    SendBatch(methodHeader.methodAddress, arguments(), methodHeader.methodSubChannel, true);
                     break;
                 case PushBufferMethodHeader::SecOp::NonIncMethod:
-                    for (u16 i{}; i < methodHeader->methodCount; i++)
-                        Send(MethodParams{methodHeader->methodAddress, *++entry, methodHeader->methodSubChannel, i == methodHeader->methodCount - 1});
-
+                    SendBatch(methodHeader.methodAddress, arguments(), methodHeader.methodSubChannel, false);
                     break;
-                case PushBufferMethodHeader::SecOp::OneInc:
-                    for (u16 i{}; i < methodHeader->methodCount; i++)
-                        Send(MethodParams{static_cast<u16>(methodHeader->methodAddress + bool(i)), *++entry, methodHeader->methodSubChannel, i == methodHeader->methodCount - 1});
+                case PushBufferMethodHeader::SecOp::OneInc: {
+                    auto oneIncArguments{arguments()};
+                    for (size_t i{}; i < oneIncArguments.size(); i++)
+                        Send(MethodParams{static_cast<u16>(methodHeader.methodAddress + bool(i)), oneIncArguments[i], methodHeader.methodSubChannel, i == oneIncArguments.size() - 1});
 
                     break;
+                }
                 case PushBufferMethodHeader::SecOp::ImmdDataMethod:
-                    Send(MethodParams{methodHeader->methodAddress, methodHeader->immdData, methodHeader->methodSubChannel, true});
+                    Send(MethodParams{methodHeader.methodAddress, methodHeader.immdData, methodHeader.methodSubChannel, true});
                     break;
                 case PushBufferMethodHeader::SecOp::EndPbSegment:
                     return;
@@ -77,27 +127,238 @@ namespace skyline::gpu::gpfifo {
         }
     }
 
-    void GPFIFO::Run() {
-        std::lock_guard lock(pushBufferQueueLock);
-        while (!pushBufferQueue.empty()) {
-            auto pushBuffer{pushBufferQueue.front()};
-            if (pushBuffer.segment.empty())
-                pushBuffer.Fetch(state.gpu->memoryManager);
+    GPFIFO::GPFIFO(const DeviceState &state, Scheduler &scheduler) : state(state), scheduler(scheduler), gpfifoEngine(state), timeslice(static_cast<u32>(DefaultTimeslice.count())) {}
+
+    GPFIFO::RunResult GPFIFO::Run(std::chrono::steady_clock::time_point deadline) {
+        if (pendingWait) {
+            // A waiter on the syncpoint wakes the scheduler once it's reached, until then the channel is skipped
+            if (state.gpu->syncpoints.at(pendingWait->id).value < pendingWait->value)
+                return RunResult::Blocked;
+
+            if (auto trace{scheduler.GetTrace()})
+                trace->WriteSyncpoint(id, false, *pendingWait);
+            pendingWait.reset();
+        }
+
+        while (true) {
+            auto write{__atomic_load_n(&writeIndex, __ATOMIC_ACQUIRE)};
+            if (readIndex == write)
+                return RunResult::Idle;
+
+            auto ringEntry{ring[readIndex & (RingSize - 1)]};
+            __atomic_store_n(&readIndex, readIndex + 1, __ATOMIC_RELEASE); // The entry has been copied out so its slot can be reused immediately
+
+            if (ringEntry.type == RingEntry::Type::SyncpointWait) {
+                if (state.gpu->syncpoints.at(ringEntry.syncpoint.id).RegisterWaiter(ringEntry.syncpoint.value, [&scheduler = scheduler] { scheduler.Wake(); })) {
+                    pendingWait = ringEntry.syncpoint;
+                    return RunResult::Blocked;
+                }
+
+                if (auto trace{scheduler.GetTrace()})
+                    trace->WriteSyncpoint(id, false, ringEntry.syncpoint);
+            } else if (ringEntry.type == RingEntry::Type::SyncpointIncrement) {
+                if (auto trace{scheduler.GetTrace()})
+                    trace->WriteSyncpoint(id, true, ringEntry.syncpoint);
+                ExecuteSyncpoint(true, ringEntry.syncpoint);
+            } else if (auto &entry{ringEntry.gpEntry}; entry.size) {
+                // The pushbuffer is parsed directly from guest memory when possible, it's only copied when it's split across chunks
+                u64 address{(static_cast<u64>(entry.getHi) << 32) | (static_cast<u64>(entry.get) << 2)};
+                auto pushbuffer{state.gpu->memoryManager.GetHostSpan<u32>(address, entry.size)};
+                if (pushbuffer.empty()) {
+                    segment.resize(entry.size);
+                    state.gpu->memoryManager.Read<u32>(segment, address);
+                    pushbuffer = segment;
+                }
+
+                if (auto trace{scheduler.GetTrace()})
+                    trace->WritePushbuffer(id, entry, pushbuffer);
+
+                TRACE_SCOPE("GPFIFO::Process");
+                Process(pushbuffer);
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline)
+                return (readIndex == __atomic_load_n(&writeIndex, __ATOMIC_ACQUIRE)) ? RunResult::Idle : RunResult::Preempted;
+        }
+    }
+
+    bool GPFIFO::PushEntry(const RingEntry &entry) {
+        while (writeIndex - __atomic_load_n(&readIndex, __ATOMIC_ACQUIRE) >= RingSize) {
+            if (!scheduler.IsRunning() || Halt)
+                return false;
+            sched_yield(); // The ring is full, the GPFIFO thread has been woken up and will drain it once this channel runs
+        }
+
+        ring[writeIndex & (RingSize - 1)] = entry;
+        __atomic_store_n(&writeIndex, writeIndex + 1, __ATOMIC_RELEASE);
+        scheduler.Wake();
+        return true;
+    }
+
+    void GPFIFO::Push(span<GpEntry> entries, std::optional<SyncpointOperation> wait, std::optional<SyncpointOperation> increment) {
+        std::lock_guard lock(pushLock);
+        if (wait && !PushEntry(RingEntry{.type = RingEntry::Type::SyncpointWait, .syncpoint = *wait}))
+            return;
+
+        for (const auto &entry : entries)
+            if (!PushEntry(RingEntry{.type = RingEntry::Type::GpEntry, .gpEntry = entry}))
+                return;
+
+        if (increment)
+            PushEntry(RingEntry{.type = RingEntry::Type::SyncpointIncrement, .syncpoint = *increment});
+    }
+
+    Scheduler::Scheduler(const DeviceState &state) : state(state) {}
+
+    Scheduler::~Scheduler() {
+        Stop();
+    }
+
+    void Scheduler::Stop() {
+        running = false;
+        Wake();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void Scheduler::AddChannel(const std::shared_ptr<GPFIFO> &channel) {
+        std::lock_guard guard(channelMutex);
+        channel->id = nextChannelId++;
+        channels.emplace_back(channel);
+
+        if (!thread.joinable())
+            thread = std::thread(&Scheduler::Run, this);
+    }
+
+    void Scheduler::Wake() {
+        __atomic_add_fetch(&workCounter, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST))
+            syscall(__NR_futex, &workCounter, FUTEX_WAKE, 1);
+    }
+
+    void Scheduler::Run() {
+        pthread_setname_np(pthread_self(), "Sky-GPFIFO");
+        allocation::Scope allocationScope(allocation::Tag::Gpfifo);
+        state.os->performanceHint.SetThread(kernel::PerformanceHintManager::HintThread::Gpfifo, gettid());
+        constexpr timespec WaitTimeout{.tv_nsec = 100000000}; // The maximum duration to sleep on workCounter for prior to checking running (100ms)
+
+        try {
+            // A trace that's replayed by a benchmark is executed once the title first submits work, so the GPU address space is set up by then; nothing is captured meanwhile
+            std::optional<TraceReader> replay;
+            if (state.benchmark && !state.benchmark->gpuTracePath.empty()) {
+                try {
+                    replay.emplace(state.benchmark->gpuTracePath);
+                } catch (const std::exception &e) {
+                    state.logger->Warn("GPFIFO trace can't be replayed: {}", e.what());
+                }
+            } else if (state.settings->GetBool("gpu_trace", false)) {
+                auto path{state.os->appFilesPath + "gpu_trace.skgt"};
+                try {
+                    trace = std::make_unique<TraceWriter>(path);
+                    state.logger->Info("Capturing GPFIFO trace to {}", path);
+                } catch (const std::exception &e) {
+                    state.logger->Warn("GPFIFO trace can't be captured: {}", e.what());
+                }
+            }
+
+            while (running) {
+                // The counter is read prior to running channels, so anything that becomes runnable during the round prevents sleeping after it
+                auto work{__atomic_load_n(&workCounter, __ATOMIC_SEQ_CST)};
+                {
+                    std::lock_guard guard(channelMutex);
+                    std::erase_if(channels, [this](const std::weak_ptr<GPFIFO> &weakChannel) {
+                        auto channel{weakChannel.lock()};
+                        if (channel)
+                            runQueue.push_back(std::move(channel));
+                        return !channel;
+                    });
+                }
+
+                if (replay && std::any_of(runQueue.begin(), runQueue.end(), [](const std::shared_ptr<GPFIFO> &channel) { return channel->GetQueueDepth(); })) {
+                    state.logger->Info("Replaying GPFIFO trace from {}", state.benchmark->gpuTracePath);
+                    try {
+                        TRACE_SCOPE("Scheduler::Replay");
+                        Replay(*replay);
+                    } catch (const std::exception &e) {
+                        state.logger->Warn("GPFIFO trace replay failed: {}", e.what());
+                    }
+                    replay.reset();
+                }
+
+                bool preempted{};
+                u32 queueDepth{};
+                auto roundStart{util::GetTimeNs()};
+                for (size_t index{}; index < runQueue.size() && running; index++) {
+                    auto &channel{*runQueue[(firstChannel + index) % runQueue.size()]};
+                    auto result{channel.Run(std::chrono::steady_clock::now() + std::chrono::microseconds(channel.timeslice.load(std::memory_order_relaxed)))};
+                    preempted |= result == GPFIFO::RunResult::Preempted;
+                    queueDepth += channel.GetQueueDepth();
+                }
+                if (!runQueue.empty())
+                    state.os->performanceHint.AddWork(util::GetTimeNs() - roundStart); // Only executing channels is a part of the frame's work, sleeping on workCounter isn't
+                firstChannel = runQueue.empty() ? 0 : (firstChannel + 1) % runQueue.size();
+                runQueue.clear(); // Channels are only kept alive for the round, so they're destroyed once their device is closed
+
+                state.statistics->gpfifoQueueDepth.store(queueDepth, std::memory_order_relaxed);
+                skyline::trace::SetCounter("GPFIFO Queue Depth", static_cast<i64>(queueDepth));
 
-            Process(pushBuffer.segment);
-            pushBufferQueue.pop();
+                if (!preempted) {
+                    // The flag is set prior to checking workCounter again, so a waker either sees the flag and wakes us or we see its increment
+                    __atomic_store_n(&sleeping, true, __ATOMIC_SEQ_CST);
+                    if (__atomic_load_n(&workCounter, __ATOMIC_SEQ_CST) == work && running)
+                        syscall(__NR_futex, &workCounter, FUTEX_WAIT, work, &WaitTimeout);
+                    __atomic_store_n(&sleeping, false, __ATOMIC_RELAXED);
+                }
+            }
+        } catch (const std::exception &e) {
+            state.logger->Error(e.what());
+            Halt = true;
+        } catch (...) {
+            state.logger->Error("An unknown exception has occurred");
+            Halt = true;
         }
+
+        trace.reset(); // The trace is written out on the GPFIFO thread as it's the only one which touches it
     }
 
-    void GPFIFO::Push(span<GpEntry> entries) {
-        std::lock_guard lock(pushBufferQueueLock);
-        bool beforeBarrier{false};
+    void Scheduler::Replay(TraceReader &reader) {
+        std::unordered_map<u8, std::shared_ptr<GPFIFO>> replayChannels;
+        auto getChannel{[&](u8 id) -> GPFIFO & {
+            auto &channel{replayChannels[id]};
+            if (!channel) {
+                channel = std::make_shared<GPFIFO>(state, *this);
+                channel->id = id;
+            }
+            return *channel;
+        }};
+
+        TraceReader::Record record;
+        std::vector<u32> pushbuffer; // The pushbuffer is copied out as the records which follow it are read prior to it being executed
+        bool pending{reader.Next(record)};
+        while (pending) {
+            switch (record.type) {
+                case trace::RecordType::Pushbuffer: {
+                    auto &channel{getChannel(record.channel)};
+                    pushbuffer.assign(record.pushbuffer.begin(), record.pushbuffer.end());
 
-        for (const auto &entry : entries) {
-            if (entry.sync == GpEntry::Sync::Wait)
-                beforeBarrier = false;
+                    // The memory which the engines read while executing the pushbuffer is recorded after it, it's written back first so they read the same data
+                    while ((pending = reader.Next(record)) && record.type == trace::RecordType::Memory)
+                        state.gpu->memoryManager.Write(record.memory.data(), record.address, record.memory.size());
 
-            pushBufferQueue.emplace(PushBuffer(entry, state.gpu->memoryManager, beforeBarrier));
+                    channel.Process(pushbuffer);
+                    continue;
+                }
+                case trace::RecordType::SyncpointIncrement:
+                    getChannel(record.channel).ExecuteSyncpoint(true, record.syncpoint);
+                    break;
+                case trace::RecordType::SyncpointWait:
+                    break;
+                case trace::RecordType::Memory:
+                    state.gpu->memoryManager.Write(record.memory.data(), record.address, record.memory.size());
+                    break;
+            }
+            pending = reader.Next(record);
         }
     }
 }
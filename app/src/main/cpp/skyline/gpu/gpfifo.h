@@ -3,11 +3,18 @@
 
 #pragma once
 
-#include <queue>
 #include "engines/gpfifo.h"
 #include "memory_manager.h"
 
 namespace skyline::gpu {
+    namespace engine {
+        class Fermi2D;
+        class KeplerMemory;
+        class Maxwell3D;
+        class MaxwellCompute;
+        class MaxwellDma;
+    }
+
     namespace gpfifo {
         /**
          * @brief A GPFIFO entry as submitted through 'SubmitGpfifo'
@@ -121,57 +128,202 @@ namespace skyline::gpu {
         static_assert(sizeof(PushBufferMethodHeader) == sizeof(u32));
 
         /**
-         * @brief The GPFIFO class handles creating pushbuffers from GP entries and then processing them
+         * @brief A syncpoint operation that's executed by the GPFIFO in order with the GP entries around it, it's used for the fences of a submission
+         */
+        struct SyncpointOperation {
+            u32 id; //!< The ID of the syncpoint
+            u32 value; //!< The threshold to wait for the syncpoint to reach or the amount of times to increment it
+        };
+
+        class TraceWriter;
+        class TraceReader;
+        class Scheduler;
+
+        /**
+         * @brief The GPFIFO class handles creating pushbuffers from GP entries and then processing them, every channel has its own GPFIFO with its own engines and subchannel bindings
+         * @note The entries of all channels are executed by the Scheduler on a single thread, as all channels record into the same GraphicsContext
          * @url https://github.com/NVIDIA/open-gpu-doc/blob/ab27fc22db5de0d02a4cabe08e555663b62db4d4/manuals/volta/gv100/dev_pbdma.ref.txt#L62
          */
         class GPFIFO {
           private:
+            static constexpr size_t RingSize{0x400}; //!< The amount of GP entries the ring can hold, this must be a power of two
+
             /**
-             * @brief A pushbuffer is a descriptor of tasks that need to be executed for a specific client
+             * @brief An entry in the ring, this is either a GP entry or a syncpoint operation inserted by the host
              */
-            struct PushBuffer {
-                GpEntry gpEntry;
-                std::vector<u32> segment;
+            struct RingEntry {
+                enum class Type : u8 {
+                    GpEntry,
+                    SyncpointWait,
+                    SyncpointIncrement,
+                } type;
 
-                PushBuffer(const GpEntry &gpEntry, const vmm::MemoryManager &memoryManager, bool fetch) : gpEntry(gpEntry) {
-                    if (fetch)
-                        Fetch(memoryManager);
-                }
-
-                inline void Fetch(const vmm::MemoryManager &memoryManager) {
-                    segment.resize(gpEntry.size);
-                    memoryManager.Read<u32>(segment, (static_cast<u64>(gpEntry.getHi) << 32) | (static_cast<u64>(gpEntry.get) << 2));
-                }
+                union {
+                    GpEntry gpEntry;
+                    SyncpointOperation syncpoint;
+                };
             };
 
             const DeviceState &state;
+            Scheduler &scheduler;
+            u8 id{}; //!< The ID of the channel in traces, this is assigned by the scheduler
             engine::GPFIFO gpfifoEngine; //!< The engine for processing GPFIFO method calls
             std::array<std::shared_ptr<engine::Engine>, 8> subchannels;
-            std::queue<PushBuffer> pushBufferQueue;
-            skyline::Mutex pushBufferQueueLock; //!< Synchronizes pushbuffer queue insertions as the GPU is multi-threaded
+            std::shared_ptr<engine::Fermi2D> fermi2D; //!< The engine instances of the channel, these are only created once they're bound to a subchannel
+            std::shared_ptr<engine::KeplerMemory> keplerMemory;
+            std::shared_ptr<engine::Maxwell3D> maxwell3D;
+            std::shared_ptr<engine::MaxwellCompute> maxwellCompute;
+            std::shared_ptr<engine::MaxwellDma> maxwellDma;
+            std::array<RingEntry, RingSize> ring; //!< A bounded ring of entries which are written by submitters and read by the GPFIFO thread
+            u32 writeIndex{}; //!< The unwrapped index after the last entry written to the ring
+            u32 readIndex{}; //!< The unwrapped index of the next entry read from the ring, this is only written to by the GPFIFO thread
+            std::optional<SyncpointOperation> pendingWait; //!< A syncpoint wait which the channel is blocked on, this is only used by the GPFIFO thread
+            std::atomic<u32> timeslice; //!< The maximum duration the channel runs for before other channels are run in microseconds
+            skyline::Mutex pushLock; //!< Serializes submitters as multiple threads can submit entries to the same channel concurrently, the GPFIFO thread never takes this
+            std::vector<u32> segment; //!< The buffer pushbuffer segments which can't be accessed directly are fetched into, it's reused for every entry to avoid allocations
+
+            friend Scheduler;
 
             /**
              * @brief Processes a pushbuffer segment, calling methods as needed
              */
-            void Process(const std::vector<u32> &segment);
+            void Process(span<u32> segment);
 
             /**
              * @brief Sends a method call to the GPU hardware
              */
             void Send(MethodParams params);
 
+            /**
+             * @brief Sends all method calls of a single pushbuffer entry to the GPU hardware
+             * @note Calls to engines bound to subchannels are dispatched as a single batch, calls to the GPFIFO engine or for binding engines are sent individually
+             */
+            void SendBatch(u16 method, span<u32> arguments, u32 subChannel, bool incrementing);
+
+            /**
+             * @brief Executes a syncpoint operation from the host as the equivalent GPFIFO methods, exactly as a kernel-inserted pushbuffer would be
+             */
+            void ExecuteSyncpoint(bool increment, SyncpointOperation operation);
+
+            /**
+             * @brief Writes a single entry to the ring, this blocks while the ring is full
+             * @return If the entry was written, this is false if the GPFIFO thread has been stopped
+             * @note pushLock must be held when calling this
+             */
+            bool PushEntry(const RingEntry &entry);
+
           public:
-            GPFIFO(const DeviceState &state) : state(state), gpfifoEngine(state) {}
+            /**
+             * @brief The reason why Run returned
+             */
+            enum class RunResult : u8 {
+                Idle, //!< All entries in the ring have been executed
+                Blocked, //!< The channel is waiting on a syncpoint, the scheduler is woken once it's reached
+                Preempted, //!< The timeslice of the channel ended while it still had entries to execute
+            };
+
+            static constexpr std::chrono::microseconds DefaultTimeslice{2600}; //!< The timeslice of channels which haven't had their priority set, this is the timeslice of a medium priority channel
+
+            GPFIFO(const DeviceState &state, Scheduler &scheduler);
+
+            /**
+             * @brief Sets the maximum duration the channel runs for before other channels get to run
+             */
+            void SetTimeslice(std::chrono::microseconds duration) {
+                timeslice.store(static_cast<u32>(duration.count()), std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Executes entries from the ring until it's empty, the channel is blocked on a syncpoint wait or the deadline has passed
+             * @note This must only be called by the GPFIFO thread, at least one entry is executed if there are any regardless of the deadline
+             */
+            RunResult Run(std::chrono::steady_clock::time_point deadline);
 
             /**
-             * @brief Executes all pending entries in the FIFO
+             * @return The amount of entries which are pending in the ring
+             */
+            u32 GetQueueDepth() {
+                return __atomic_load_n(&writeIndex, __ATOMIC_RELAXED) - __atomic_load_n(&readIndex, __ATOMIC_RELAXED);
+            }
+
+            /**
+             * @brief Pushes a list of entries to the FIFO, these commands are executed asynchronously by the GPFIFO thread
+             * @param wait A syncpoint threshold which is waited on by the GPFIFO prior to executing the entries, other channels run in the meantime
+             * @param increment A syncpoint which is incremented by the GPFIFO after the entries have been executed
+             * @note This only blocks while the ring is full
+             */
+            void Push(span<GpEntry> entries, std::optional<SyncpointOperation> wait = std::nullopt, std::optional<SyncpointOperation> increment = std::nullopt);
+        };
+
+        /**
+         * @brief The Scheduler runs the GPFIFOs of all channels on the GPFIFO thread in time slices, so no channel can starve the others
+         * @note Channels blocked on a syncpoint wait from a submission are skipped until it's reached rather than stalling all channels, waits through GPFIFO methods within a pushbuffer still stall the thread
+         */
+        class Scheduler {
+          private:
+            const DeviceState &state;
+            std::mutex channelMutex; //!< Synchronizes access to channels
+            std::vector<std::weak_ptr<GPFIFO>> channels; //!< The channels to run, these are owned by the channel devices and are removed once they expire
+            std::vector<std::shared_ptr<GPFIFO>> runQueue; //!< The channels which are run in the current round, this is only used by the GPFIFO thread
+            size_t firstChannel{}; //!< The index of the channel in runQueue which runs first in the round, this rotates every round so channels are treated fairly
+            u8 nextChannelId{};
+            u32 workCounter{}; //!< A counter which is incremented whenever any channel might have become runnable, it's also the futex the GPFIFO thread sleeps on
+            u32 sleeping{}; //!< If the GPFIFO thread is sleeping on workCounter and needs to be woken up
+            std::atomic<bool> running{true}; //!< If the GPFIFO thread should keep running channels
+            std::thread thread; //!< The thread which runs all channels, it's started when the first channel is added as the GPU must be fully constructed by then
+            std::unique_ptr<TraceWriter> trace; //!< Captures all executed entries when the "gpu_trace" setting is enabled, it's created by the GPFIFO thread
+
+            /**
+             * @brief The loop of the GPFIFO thread, it runs all channels with entries in rounds until the scheduler is stopped
              */
             void Run();
 
+          public:
+            Scheduler(const DeviceState &state);
+
+            /**
+             * @brief Stops the GPFIFO thread after the channel that's running finishes its timeslice
+             */
+            ~Scheduler();
+
+            /**
+             * @brief Stops the GPFIFO thread and joins it, this does nothing if it has already been stopped
+             * @note This must be called prior to destroying anything the GPFIFO thread might access
+             */
+            void Stop();
+
+            /**
+             * @brief Adds a channel to be run, it's removed automatically once it's destroyed
+             */
+            void AddChannel(const std::shared_ptr<GPFIFO> &channel);
+
+            /**
+             * @brief Wakes the GPFIFO thread if it's sleeping, this must be called whenever a channel might have become runnable
+             */
+            void Wake();
+
+            /**
+             * @return If the scheduler is still running, submitters stop pushing entries once it isn't
+             */
+            bool IsRunning() {
+                return running;
+            }
+
+            /**
+             * @return The writer which all executed entries are captured with or nullptr if they aren't captured
+             * @note This must only be used by the GPFIFO thread
+             */
+            TraceWriter *GetTrace() {
+                return trace.get();
+            }
+
             /**
-             * @brief Pushes a list of entries to the FIFO, these commands will be executed on calls to 'Step'
+             * @brief Executes all pushbuffers and syncpoint increments of a trace on the calling thread, this is deterministic as the pushbuffers and the memory engines read are taken from the trace rather than guest memory
+             * @note Syncpoint waits are skipped as the trace is already in the order the waits resolved in, every channel of the trace is recreated with fresh engines
+             * @note GPU address space mappings aren't recorded, so the trace must be replayed while the title which it was captured from has set up the same mappings
+             * @note This is run by the GPFIFO thread when a benchmark replays a trace (See Benchmark::gpuTracePath)
              */
-            void Push(span<GpEntry> entries);
+            void Replay(TraceReader &reader);
         };
     }
 }
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <lz4.h>
+#include "gpfifo_trace.h"
+
+namespace skyline::gpu::gpfifo {
+    TraceWriter::TraceWriter(const std::string &path) : file(path, std::ios::binary | std::ios::trunc) {
+        if (!file)
+            throw exception("Failed to open GPFIFO trace file: {}", path);
+
+        trace::TraceHeader header{trace::Magic, trace::Version};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        block.reserve(trace::BlockSize);
+    }
+
+    TraceWriter::~TraceWriter() {
+        WriteBlock();
+    }
+
+    void TraceWriter::WriteRecord(const trace::RecordHeader &header, span<const u8> payload) {
+        auto recordSize{sizeof(header) + util::AlignUp(payload.size(), sizeof(u32))}; // The padding keeps pushbuffers in subsequent records word-aligned
+        if (!block.empty() && block.size() + recordSize > trace::BlockSize)
+            WriteBlock();
+
+        auto offset{block.size()};
+        block.resize(offset + recordSize);
+        std::memcpy(block.data() + offset, &header, sizeof(header));
+        if (!payload.empty())
+            std::memcpy(block.data() + offset + sizeof(header), payload.data(), payload.size());
+    }
+
+    void TraceWriter::WriteBlock() {
+        if (block.empty())
+            return;
+
+        compressed.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(block.size()))));
+        auto compressedSize{LZ4_compress_default(reinterpret_cast<const char *>(block.data()), reinterpret_cast<char *>(compressed.data()), static_cast<int>(block.size()), static_cast<int>(compressed.size()))};
+        if (compressedSize <= 0)
+            throw exception("Failed to compress GPFIFO trace block of 0x{:X} bytes", block.size());
+
+        trace::BlockHeader header{static_cast<u32>(block.size()), static_cast<u32>(compressedSize)};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(compressed.data()), compressedSize);
+        block.clear();
+    }
+
+    void TraceWriter::WritePushbuffer(u8 channel, GpEntry entry, span<const u32> pushbuffer) {
+        trace::RecordHeader header{
+            .type = trace::RecordType::Pushbuffer,
+            .channel = channel,
+            .size = static_cast<u32>(pushbuffer.size()),
+            .gpEntry = entry,
+        };
+        WriteRecord(header, span(reinterpret_cast<const u8 *>(pushbuffer.data()), pushbuffer.size_bytes()));
+    }
+
+    void TraceWriter::WriteSyncpoint(u8 channel, bool increment, SyncpointOperation operation) {
+        trace::RecordHeader header{
+            .type = increment ? trace::RecordType::SyncpointIncrement : trace::RecordType::SyncpointWait,
+            .channel = channel,
+            .size = 0,
+            .syncpoint = operation,
+        };
+        WriteRecord(header);
+    }
+
+    void TraceWriter::WriteMemory(u64 address, span<const u8> memory) {
+        trace::RecordHeader header{
+            .type = trace::RecordType::Memory,
+            .size = static_cast<u32>(memory.size()),
+            .address = address,
+        };
+        WriteRecord(header, memory);
+    }
+
+    TraceReader::TraceReader(const std::string &path) : file(path, std::ios::binary) {
+        if (!file)
+            throw exception("Failed to open GPFIFO trace file: {}", path);
+
+        trace::TraceHeader header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || header.magic != trace::Magic)
+            throw exception("Invalid GPFIFO trace: {}", path);
+        if (header.version != trace::Version)
+            throw exception("Unsupported GPFIFO trace version: {} (Expected {})", header.version, trace::Version);
+    }
+
+    bool TraceReader::ReadBlock() {
+        trace::BlockHeader header{};
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return false;
+
+        compressed.resize(header.compressedSize);
+        if (!file.read(reinterpret_cast<char *>(compressed.data()), header.compressedSize))
+            throw exception("GPFIFO trace is truncated");
+
+        block.resize(header.size);
+        if (LZ4_decompress_safe(reinterpret_cast<const char *>(compressed.data()), reinterpret_cast<char *>(block.data()), static_cast<int>(header.compressedSize), static_cast<int>(header.size)) != static_cast<int>(header.size))
+            throw exception("Failed to decompress GPFIFO trace block");
+
+        offset = 0;
+        return true;
+    }
+
+    bool TraceReader::Next(Record &record) {
+        if (offset == block.size() && !ReadBlock())
+            return false;
+
+        if (offset + sizeof(trace::RecordHeader) > block.size())
+            throw exception("GPFIFO trace record exceeds its block");
+
+        trace::RecordHeader header;
+        std::memcpy(&header, block.data() + offset, sizeof(header));
+        offset += sizeof(header);
+
+        record.type = header.type;
+        record.channel = header.channel;
+        switch (header.type) {
+            case trace::RecordType::Pushbuffer: {
+                auto size{static_cast<size_t>(header.size) * sizeof(u32)};
+                if (offset + size > block.size())
+                    throw exception("GPFIFO trace pushbuffer exceeds its block");
+
+                record.gpEntry = header.gpEntry;
+                record.pushbuffer = span(reinterpret_cast<u32 *>(block.data() + offset), header.size);
+                offset += size;
+                break;
+            }
+            case trace::RecordType::SyncpointWait:
+            case trace::RecordType::SyncpointIncrement:
+                record.syncpoint = header.syncpoint;
+                record.pushbuffer = {};
+                break;
+            case trace::RecordType::Memory: {
+                auto size{util::AlignUp(static_cast<size_t>(header.size), sizeof(u32))};
+                if (offset + size > block.size())
+                    throw exception("GPFIFO trace memory exceeds its block");
+
+                record.address = header.address;
+                record.memory = span(block.data() + offset, header.size);
+                record.pushbuffer = {};
+                offset += size;
+                break;
+            }
+            default:
+                throw exception("Unknown GPFIFO trace record type: {}", static_cast<u8>(header.type));
+        }
+
+        return true;
+    }
+}
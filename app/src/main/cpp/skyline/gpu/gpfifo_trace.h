@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "gpfifo.h"
+
+namespace skyline::gpu::gpfifo {
+    /**
+     * @brief The on-disk format of a GPFIFO trace, it's a TraceHeader followed by LZ4-compressed blocks of records
+     * @note Every record is a RecordHeader followed by its payload which is padded to a word boundary, records never span across blocks
+     */
+    namespace trace {
+        constexpr u32 Magic{util::MakeMagic<u32>("SKGT")};
+        constexpr u32 Version{3}; //!< The version of the format, this is incremented whenever the format changes incompatibly
+        constexpr size_t BlockSize{0x100000}; //!< The size of the uncompressed records after which a block is compressed and written out, a single record larger than this gets a block of its own
+
+        struct TraceHeader {
+            u32 magic;
+            u32 version;
+        };
+        static_assert(sizeof(TraceHeader) == 0x8);
+
+        struct BlockHeader {
+            u32 size; //!< The size of the records in the block after decompression
+            u32 compressedSize; //!< The size of the compressed records which follow this header
+        };
+        static_assert(sizeof(BlockHeader) == 0x8);
+
+        enum class RecordType : u8 {
+            Pushbuffer, //!< The contents of the pushbuffer of a GP entry
+            SyncpointWait,
+            SyncpointIncrement,
+            Memory, //!< The contents of a region of the GPU address space which an engine read while executing the preceding pushbuffer
+        };
+
+        struct RecordHeader {
+            RecordType type;
+            u8 channel; //!< The ID of the channel which executed the record, every channel has its own engines and subchannel bindings
+            u8 _pad_[2]{};
+            u32 size; //!< The size of the pushbuffer in words or of the memory in bytes, this is 0 for syncpoint records
+
+            union {
+                GpEntry gpEntry;
+                SyncpointOperation syncpoint;
+                u64 address; //!< The GPU address of the memory of a memory record
+            };
+        };
+        static_assert(sizeof(RecordHeader) == 0x10);
+    }
+
+    /**
+     * @brief Captures everything the GPFIFO thread executes on all channels into a trace file, so GPU workloads can be replayed without running the title
+     * @note This must only be used by a single thread, which is the GPFIFO thread
+     */
+    class TraceWriter {
+      private:
+        std::ofstream file;
+        std::vector<u8> block; //!< The uncompressed records of the block that's currently being written
+        std::vector<u8> compressed; //!< A buffer for compressing blocks into, it's reused across blocks to avoid allocations
+
+        /**
+         * @brief Appends a record to the current block, writing out the block first if the record doesn't fit in it
+         */
+        void WriteRecord(const trace::RecordHeader &header, span<const u8> payload = {});
+
+        /**
+         * @brief Compresses the current block and writes it out to the file
+         */
+        void WriteBlock();
+
+      public:
+        TraceWriter(const std::string &path);
+
+        /**
+         * @brief Writes out any records which haven't been written yet
+         */
+        ~TraceWriter();
+
+        void WritePushbuffer(u8 channel, GpEntry entry, span<const u32> pushbuffer);
+
+        void WriteSyncpoint(u8 channel, bool increment, SyncpointOperation operation);
+
+        /**
+         * @brief Records guest memory which an engine read, this must be called while the pushbuffer which read it is executed
+         * @note The memory is written back prior to the pushbuffer being executed during replay, so it reads the same data regardless of the state of guest memory
+         */
+        void WriteMemory(u64 address, span<const u8> memory);
+    };
+
+    /**
+     * @brief Reads back the records of a trace written by TraceWriter
+     */
+    class TraceReader {
+      private:
+        std::ifstream file;
+        std::vector<u8> block; //!< The decompressed records of the current block
+        std::vector<u8> compressed;
+        size_t offset{}; //!< The offset of the next record in the block
+
+        /**
+         * @brief Reads and decompresses the next block from the file
+         * @return If a block was read, this is false at the end of the file
+         */
+        bool ReadBlock();
+
+      public:
+        struct Record {
+            trace::RecordType type;
+            u8 channel; //!< The ID of the channel which executed the record
+            GpEntry gpEntry; //!< The GP entry of a pushbuffer record
+            SyncpointOperation syncpoint; //!< The operation of a syncpoint record
+            span<u32> pushbuffer; //!< The contents of the pushbuffer of a pushbuffer record, this is valid until the next call to Next
+            u64 address; //!< The GPU address of a memory record
+            span<u8> memory; //!< The contents of a memory record, this is valid until the next call to Next
+        };
+
+        TraceReader(const std::string &path);
+
+        /**
+         * @brief Reads the next record from the trace
+         * @return If a record was read, this is false at the end of the trace
+         */
+        bool Next(Record &record);
+    };
+}
@@ -0,0 +1,844 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "graphics_context.h"
+
+namespace skyline::gpu {
+    GraphicsContext::GraphicsContext(const DeviceState &state, GPU &gpu) : state(state), gpu(gpu), fastQueries(state.settings->GetBool("fast_queries", false)), bufferCache(state, gpu, *this), descriptorCache(state, gpu) {
+        auto &device{*gpu.vkDevice};
+
+        std::array<vk::DescriptorPoolSize, 4> poolSizes{
+            vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, DescriptorCount},
+            vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, DescriptorCount},
+            vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, DescriptorCount},
+            vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage, DescriptorCount},
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.maxSets = DescriptorSetCount;
+        poolInfo.poolSizeCount = static_cast<u32>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        constexpr vk::QueryPipelineStatisticFlags StatisticFlags{static_cast<vk::QueryPipelineStatisticFlags::MaskType>((1U << StatisticCount) - 1)};
+        static_assert(static_cast<u32>(vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices) == 1 && static_cast<u32>(vk::QueryPipelineStatisticFlagBits::eTessellationEvaluationShaderInvocations) == (1U << (StatisticCount - 1)));
+
+        for (auto &frame : frames) {
+            frame.commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eTransient, gpu.vkQueueFamilyIndex});
+            frame.commandBuffer = std::move(device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{*frame.commandPool, vk::CommandBufferLevel::ePrimary, 1}).front());
+            frame.descriptorPool = device.createDescriptorPoolUnique(poolInfo);
+            frame.fence = device.createFenceUnique(vk::FenceCreateInfo{});
+            frame.occlusionPool = device.createQueryPoolUnique(vk::QueryPoolCreateInfo{{}, vk::QueryType::eOcclusion, QueryCount});
+            if (gpu.vkPipelineStatisticsQuery)
+                frame.statisticsPool = device.createQueryPoolUnique(vk::QueryPoolCreateInfo{{}, vk::QueryType::ePipelineStatistics, QueryCount, StatisticFlags});
+        }
+
+        vk::BufferCreateInfo bufferInfo{};
+        bufferInfo.size = StreamSize * FrameCount;
+        bufferInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        streamBuffer = device.createBufferUnique(bufferInfo);
+
+        auto requirements{device.getBufferMemoryRequirements(*streamBuffer)};
+        auto memoryProperties{gpu.vkPhysicalDevice.getMemoryProperties()};
+        constexpr vk::MemoryPropertyFlags StreamMemoryFlags{vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent};
+
+        std::optional<u32> memoryType;
+        for (u32 index{}; index < memoryProperties.memoryTypeCount; index++) {
+            if ((requirements.memoryTypeBits & (1U << index)) && (memoryProperties.memoryTypes[index].propertyFlags & StreamMemoryFlags) == StreamMemoryFlags) {
+                memoryType = index;
+                break;
+            }
+        }
+        if (!memoryType)
+            throw exception("Cannot find a host-visible and host-coherent memory type for the streaming buffer");
+
+        streamMemory = device.allocateMemoryUnique(vk::MemoryAllocateInfo{requirements.size, *memoryType});
+        device.bindBufferMemory(*streamBuffer, *streamMemory, 0);
+        streamMapping = static_cast<u8 *>(device.mapMemory(*streamMemory, 0, bufferInfo.size));
+
+        auto limits{gpu.vkPhysicalDevice.getProperties().limits};
+        streamAlignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+
+        if (gpu.vkTransferQueueFamilyIndex)
+            uploadQueue.emplace(gpu);
+
+        dynamicStates = {
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
+            vk::DynamicState::eBlendConstants,
+            vk::DynamicState::eStencilCompareMask,
+            vk::DynamicState::eStencilWriteMask,
+            vk::DynamicState::eStencilReference,
+        };
+        if (gpu.vkExtendedDynamicState) {
+            dynamicStates.insert(dynamicStates.end(), {
+                vk::DynamicState::eCullModeEXT,
+                vk::DynamicState::eFrontFaceEXT,
+                vk::DynamicState::ePrimitiveTopologyEXT,
+                vk::DynamicState::eDepthTestEnableEXT,
+                vk::DynamicState::eDepthWriteEnableEXT,
+                vk::DynamicState::eDepthCompareOpEXT,
+                vk::DynamicState::eStencilTestEnableEXT,
+                vk::DynamicState::eStencilOpEXT,
+            });
+        }
+
+        rasterizerState.polygonMode = vk::PolygonMode::eFill;
+        rasterizerState.lineWidth = 1.0f; // Any other width requires the wideLines feature which isn't enabled
+
+        completionThread = std::thread(&GraphicsContext::CompletionThread, this);
+    }
+
+    GraphicsContext::~GraphicsContext() {
+        {
+            std::lock_guard guard(completionMutex);
+            running = false;
+            completionCondition.notify_all();
+        }
+        completionThread.join();
+
+        for (auto &frame : frames)
+            if (frame.inFlight)
+                static_cast<void>(gpu.vkDevice->waitForFences(*frame.fence, true, std::numeric_limits<u64>::max()));
+        if (gpu.vkTimelineSemaphore) {
+            // Signals of syncpoint semaphores are submitted without a fence, so the queue is waited on to ensure none of them are pending when the semaphores are destroyed
+            std::lock_guard guard(gpu.queueMutex);
+            gpu.vkQueue.waitIdle();
+        }
+        gpu.vkDevice->unmapMemory(*streamMemory);
+    }
+
+    void GraphicsContext::Begin() {
+        if (recording)
+            return;
+
+        auto &frame{frames[frameIndex]};
+        {
+            std::unique_lock lock(completionMutex);
+            completionCondition.wait(lock, [&frame] { return !frame.inFlight; });
+            frame.resources.clear();
+        }
+        frame.uploadSemaphores.clear();
+
+        // All resources of the frame are reset at once, this is far cheaper than freeing or resetting them individually
+        auto &device{*gpu.vkDevice};
+        device.resetCommandPool(*frame.commandPool, {});
+        device.resetDescriptorPool(*frame.descriptorPool);
+        frame.streamOffset = 0;
+
+        frame.commandBuffer->begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        frame.commandBuffer->resetQueryPool(*frame.occlusionPool, 0, QueryCount);
+        if (frame.statisticsPool)
+            frame.commandBuffer->resetQueryPool(*frame.statisticsPool, 0, QueryCount);
+        frame.occlusionCount = 0;
+        frame.statisticsCount = 0;
+        occlusionActive = false;
+        statisticsActive = false;
+
+        recording = true;
+        emitAll = true;
+    }
+
+    void GraphicsContext::SubmitFrame(Syncpoint *syncpoint) {
+        EndQueries(true, true);
+
+        auto &frame{frames[frameIndex]};
+        frame.commandBuffer->end();
+        recording = false;
+
+        vk::SubmitInfo submitInfo{};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &*frame.commandBuffer;
+
+        // The frame waits on all uploads recorded while it was, the transfer stage is included so they're ordered before any in-place updates in it
+        constexpr vk::PipelineStageFlags UploadWaitStages{vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader};
+        std::vector<vk::Semaphore> waitSemaphores;
+        std::vector<vk::PipelineStageFlags> waitStages;
+        if (uploadQueue) {
+            frame.uploadSemaphores = uploadQueue->TakeSemaphores();
+            for (const auto &semaphore : frame.uploadSemaphores) {
+                waitSemaphores.push_back(*semaphore);
+                waitStages.push_back(UploadWaitStages);
+            }
+            submitInfo.waitSemaphoreCount = static_cast<u32>(waitSemaphores.size());
+            submitInfo.pWaitSemaphores = waitSemaphores.data();
+            submitInfo.pWaitDstStageMask = waitStages.data();
+        }
+
+        u64 syncpointValue{};
+        vk::Semaphore syncpointSemaphore{};
+        vk::TimelineSemaphoreSubmitInfoKHR timelineInfo{};
+        if (syncpoint) {
+            syncpointValue = syncpoint->Queue();
+            syncpointSemaphore = syncpoint->GetSemaphore();
+            if (syncpointSemaphore) {
+                submitInfo.signalSemaphoreCount = 1;
+                submitInfo.pSignalSemaphores = &syncpointSemaphore;
+                timelineInfo.signalSemaphoreValueCount = 1;
+                timelineInfo.pSignalSemaphoreValues = &syncpointValue;
+                submitInfo.pNext = &timelineInfo;
+            }
+        }
+
+        gpu.vkDevice->resetFences(*frame.fence);
+        {
+            std::lock_guard guard(gpu.queueMutex);
+            gpu.vkQueue.submit(submitInfo, *frame.fence);
+        }
+
+        {
+            std::lock_guard guard(completionMutex);
+            frame.inFlight = true;
+            if (syncpoint)
+                frame.syncpoints.emplace_back(syncpoint, syncpointValue);
+            submittedFrames.push(frameIndex);
+            completionCondition.notify_all();
+        }
+
+        frameIndex = (frameIndex + 1) % FrameCount;
+        submission++;
+    }
+
+    void GraphicsContext::SubmitSyncpointSignal(vk::Semaphore semaphore, u64 value) {
+        vk::TimelineSemaphoreSubmitInfoKHR timelineInfo{};
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &value;
+
+        vk::SubmitInfo submitInfo{};
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &semaphore;
+
+        std::lock_guard guard(gpu.queueMutex);
+        gpu.vkQueue.submit(submitInfo, vk::Fence{});
+    }
+
+    void GraphicsContext::FlushTransfers() {
+        if (!pendingTransfers)
+            return;
+
+        // A single global barrier covers all buffers, this is cheaper than a barrier per buffer as transfers are generally batched prior to a draw
+        vk::MemoryBarrier barrier{vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eUniformRead | vk::AccessFlagBits::eShaderRead};
+        frames[frameIndex].commandBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, {}, barrier, {}, {});
+        pendingTransfers = false;
+    }
+
+    void GraphicsContext::BindBuffers(const Registers &registers) {
+        constexpr size_t VertexArrayCount{std::tuple_size_v<decltype(registers.vertexArrays)>};
+        std::array<std::optional<BufferCache::BufferView>, VertexArrayCount> vertexBuffers;
+        std::optional<BufferCache::BufferView> indexBuffer;
+        vk::IndexType indexType{};
+
+        u32 indexSize{};
+        switch (registers.indexArray.format) {
+            case Registers::IndexFormat::Uint16:
+                indexType = vk::IndexType::eUint16;
+                indexSize = sizeof(u16);
+                break;
+            case Registers::IndexFormat::Uint32:
+                indexType = vk::IndexType::eUint32;
+                indexSize = sizeof(u32);
+                break;
+            default:
+                // 8-bit indices require VK_EXT_index_type_uint8, which isn't enabled
+                if (registers.indexArray.count && !indexWarned) {
+                    state.logger->Warn("Unsupported index format: 0x{:X}", static_cast<u32>(registers.indexArray.format));
+                    indexWarned = true;
+                }
+                break;
+        }
+
+        // All lookups are redone if one of them submitted the frame to make room for an upload, as the views are only valid within a single submission
+        u64 lookupSubmission;
+        do {
+            lookupSubmission = submission;
+
+            for (size_t index{}; index < VertexArrayCount; index++) {
+                auto &vertexArray{registers.vertexArrays[index]};
+                u64 start{vertexArray.address.Pack()}, limit{registers.vertexArrayLimits[index].Pack()};
+                if (vertexArray.config.enable && start && limit >= start)
+                    vertexBuffers[index] = bufferCache.GetBuffer(start, limit - start + 1);
+                else
+                    vertexBuffers[index].reset();
+            }
+
+            indexBuffer.reset();
+            if (registers.indexArray.count && indexSize) {
+                u64 start{registers.indexArray.start.Pack() + (static_cast<u64>(registers.indexArray.first) * indexSize)}, limit{registers.indexArray.limit.Pack()};
+                if (start && limit >= start)
+                    indexBuffer = bufferCache.GetBuffer(start, std::min<u64>(static_cast<u64>(registers.indexArray.count) * indexSize, limit - start + 1));
+            }
+        } while (lookupSubmission != submission);
+
+        FlushTransfers();
+
+        vk::CommandBuffer commands{*frames[frameIndex].commandBuffer};
+        for (u32 index{}; index < VertexArrayCount; index++)
+            if (vertexBuffers[index])
+                commands.bindVertexBuffers(index, vertexBuffers[index]->buffer, vertexBuffers[index]->offset);
+        if (indexBuffer)
+            commands.bindIndexBuffer(indexBuffer->buffer, indexBuffer->offset, indexType);
+    }
+
+    void GraphicsContext::CompletionThread() {
+        pthread_setname_np(pthread_self(), "Sky-GpuFence");
+
+        std::vector<std::pair<Syncpoint *, u64>> syncpoints; // This is swapped with the syncpoints of every completed frame, so neither of them are reallocated
+        std::unique_lock lock(completionMutex);
+        while (true) {
+            completionCondition.wait(lock, [this] { return !running || !submittedFrames.empty(); });
+            if (!running)
+                return;
+
+            // The fence is waited on without holding the mutex, so work can still be submitted in the meantime
+            auto &frame{frames[submittedFrames.front()]};
+            lock.unlock();
+            static_cast<void>(gpu.vkDevice->waitForFences(*frame.fence, true, std::numeric_limits<u64>::max()));
+            lock.lock();
+
+            // Counters are resolved prior to the frame being reusable, as resetting its query pools would discard the results
+            if (!frame.queryEvents.empty()) {
+                queryResults.resize(frame.occlusionCount + (frame.statisticsCount * StatisticCount));
+                if (frame.occlusionCount)
+                    static_cast<void>(gpu.vkDevice->getQueryPoolResults(*frame.occlusionPool, 0, frame.occlusionCount, frame.occlusionCount * sizeof(u64), queryResults.data(), sizeof(u64), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait));
+                if (frame.statisticsCount)
+                    static_cast<void>(gpu.vkDevice->getQueryPoolResults(*frame.statisticsPool, 0, frame.statisticsCount, frame.statisticsCount * StatisticCount * sizeof(u64), queryResults.data() + frame.occlusionCount, StatisticCount * sizeof(u64), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait));
+
+                for (const auto &event : frame.queryEvents)
+                    ApplyQueryEvent(event, frame);
+                frame.queryEvents.clear();
+            }
+
+            submittedFrames.pop();
+            frame.inFlight = false;
+            completedSubmissions.fetch_add(1, std::memory_order_release);
+            syncpoints.swap(frame.syncpoints);
+            completionCondition.notify_all();
+
+            lock.unlock();
+            for (auto [syncpoint, value] : syncpoints)
+                syncpoint->Complete(value);
+            syncpoints.clear();
+            lock.lock();
+        }
+    }
+
+    GraphicsContext::StreamAllocation GraphicsContext::AllocateStream(vk::DeviceSize size, vk::DeviceSize alignment) {
+        if (size > StreamSize)
+            throw exception("A stream allocation of 0x{:X} bytes doesn't fit into a frame", size);
+
+        Begin();
+        alignment = std::max(alignment, streamAlignment);
+        auto offset{util::AlignUp(frames[frameIndex].streamOffset, alignment)};
+        if (offset + size > StreamSize) {
+            SubmitFrame();
+            Begin();
+            offset = 0;
+        }
+        frames[frameIndex].streamOffset = offset + size;
+
+        auto bufferOffset{(frameIndex * StreamSize) + offset};
+        return StreamAllocation{*streamBuffer, bufferOffset, streamMapping + bufferOffset};
+    }
+
+    vk::DescriptorSet GraphicsContext::AllocateDescriptorSet(vk::DescriptorSetLayout layout) {
+        Begin();
+
+        vk::DescriptorSetAllocateInfo allocateInfo{};
+        allocateInfo.descriptorPool = *frames[frameIndex].descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout;
+
+        // The non-throwing overload is used as running out of the pool is expected, the frame is submitted early and the set is allocated from the next one
+        vk::DescriptorSet descriptorSet;
+        auto result{gpu.vkDevice->allocateDescriptorSets(&allocateInfo, &descriptorSet)};
+        if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool) {
+            SubmitFrame();
+            Begin();
+            allocateInfo.descriptorPool = *frames[frameIndex].descriptorPool;
+            result = gpu.vkDevice->allocateDescriptorSets(&allocateInfo, &descriptorSet);
+        }
+        if (result != vk::Result::eSuccess)
+            throw exception("Failed to allocate a descriptor set: {}", vk::to_string(result));
+        return descriptorSet;
+    }
+
+    void GraphicsContext::UploadBuffer(span<u8> data, vk::Buffer buffer, vk::DeviceSize offset, bool asynchronous) {
+        if (asynchronous && uploadQueue) {
+            Begin(); // The frame which waits on the upload has to be recorded, otherwise its semaphore would never be waited on
+            auto allocation{uploadQueue->Allocate(data.size())};
+            std::memcpy(allocation.pointer, data.data(), data.size());
+            uploadQueue->CopyToBuffer(allocation, buffer, offset, data.size());
+            return;
+        }
+
+        auto allocation{AllocateStream(data.size())};
+        std::memcpy(allocation.pointer, data.data(), data.size());
+        CopyFromStream(allocation, buffer, offset, data.size());
+    }
+
+    void GraphicsContext::CopyFromStream(const StreamAllocation &allocation, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size) {
+        frames[frameIndex].commandBuffer->copyBuffer(allocation.buffer, buffer, vk::BufferCopy{allocation.offset, offset, size});
+        pendingTransfers = true;
+    }
+
+    void GraphicsContext::UpdateBuffer(vk::Buffer buffer, vk::DeviceSize offset, span<u8> data) {
+        Begin();
+        frames[frameIndex].commandBuffer->updateBuffer(buffer, offset, data.size(), data.data());
+        pendingTransfers = true;
+    }
+
+    void GraphicsContext::ReleaseWhenDone(std::shared_ptr<void> resource) {
+        std::lock_guard guard(completionMutex);
+        if (recording)
+            frames[frameIndex].resources.push_back(std::move(resource));
+        else if (!submittedFrames.empty())
+            frames[submittedFrames.back()].resources.push_back(std::move(resource));
+    }
+
+    void GraphicsContext::BeginQueries(bool countSamples) {
+        if (!countSamples)
+            EndQueries(true, false);
+
+        auto &frame{frames[frameIndex]};
+
+        bool beginSamples{countSamples && !occlusionActive}, beginStatistics{statisticsUsed && frame.statisticsPool && !statisticsActive};
+        if ((beginSamples && frame.occlusionCount == QueryCount) || (beginStatistics && frame.statisticsCount == QueryCount)) {
+            // The pools of the frame are exhausted, so it's submitted early and the queries are begun in the next one
+            SubmitFrame();
+            Begin();
+            beginSamples = countSamples;
+            beginStatistics = statisticsUsed && frames[frameIndex].statisticsPool;
+        }
+
+        auto &current{frames[frameIndex]};
+        if (beginSamples) {
+            current.commandBuffer->beginQuery(*current.occlusionPool, current.occlusionCount++, gpu.vkOcclusionQueryPrecise ? vk::QueryControlFlagBits::ePrecise : vk::QueryControlFlags{});
+            occlusionActive = true;
+        }
+        if (beginStatistics) {
+            current.commandBuffer->beginQuery(*current.statisticsPool, current.statisticsCount++, {});
+            statisticsActive = true;
+        }
+    }
+
+    void GraphicsContext::EndQueries(bool samples, bool statistics) {
+        auto &frame{frames[frameIndex]};
+        if (samples && occlusionActive) {
+            frame.commandBuffer->endQuery(*frame.occlusionPool, frame.occlusionCount - 1);
+            occlusionActive = false;
+            PushQueryEvent(QueryEvent{QueryEvent::Type::Occlusion, SamplesCounter, frame.occlusionCount - 1});
+        }
+        if (statistics && statisticsActive) {
+            frame.commandBuffer->endQuery(*frame.statisticsPool, frame.statisticsCount - 1);
+            statisticsActive = false;
+            PushQueryEvent(QueryEvent{QueryEvent::Type::Statistics, StatisticsCounter, frame.statisticsCount - 1});
+        }
+    }
+
+    void GraphicsContext::PushQueryEvent(const QueryEvent &event) {
+        std::lock_guard guard(completionMutex);
+        if (recording)
+            frames[frameIndex].queryEvents.push_back(event);
+        else if (!submittedFrames.empty())
+            frames[submittedFrames.back()].queryEvents.push_back(event);
+        else
+            ApplyQueryEvent(event, frames[frameIndex]);
+    }
+
+    void GraphicsContext::ApplyQueryEvent(const QueryEvent &event, const Frame &frame) {
+        switch (event.type) {
+            case QueryEvent::Type::Occlusion:
+                counterValues[SamplesCounter] += queryResults[event.query];
+                break;
+            case QueryEvent::Type::Statistics: {
+                auto results{queryResults.data() + frame.occlusionCount + (event.query * StatisticCount)};
+                for (size_t index{}; index < StatisticCount; index++)
+                    counterValues[StatisticsCounter + index] += results[index];
+                break;
+            }
+            case QueryEvent::Type::Report:
+                engine::Maxwell3D::WriteSemaphoreResult(state, event.address, event.structureSize, counterValues[event.counter]);
+                break;
+            case QueryEvent::Type::Reset:
+                counterValues[event.counter] = 0;
+                break;
+        }
+    }
+
+    std::optional<u8> GraphicsContext::GetCounterIndex(SemaphoreInfo::CounterType type) {
+        using CounterType = SemaphoreInfo::CounterType;
+        switch (type) {
+            case CounterType::SamplesPassed:
+                return SamplesCounter;
+            case CounterType::InputVertices:
+                return StatisticsCounter;
+            case CounterType::InputPrimitives:
+                return StatisticsCounter + 1;
+            case CounterType::VertexShaderInvocations:
+                return StatisticsCounter + 2;
+            case CounterType::GeometryShaderInvocations:
+                return StatisticsCounter + 3;
+            case CounterType::GeometryShaderPrimitives:
+                return StatisticsCounter + 4;
+            case CounterType::ClipperInputPrimitives:
+                return StatisticsCounter + 5;
+            case CounterType::ClipperOutputPrimitives:
+                return StatisticsCounter + 6;
+            case CounterType::FragmentShaderInvocations:
+                return StatisticsCounter + 7;
+            case CounterType::TessControlShaderInvocations:
+                return StatisticsCounter + 8; // Vulkan only counts the patches rather than the invocations, this is the closest equivalent
+            case CounterType::TessEvaluationShaderInvocations:
+                return StatisticsCounter + 9;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    void GraphicsContext::ReportCounter(SemaphoreInfo::CounterType type, u64 address, SemaphoreInfo::StructureSize structureSize) {
+        auto counter{GetCounterIndex(type)};
+        if (!counter || (*counter != SamplesCounter && !gpu.vkPipelineStatisticsQuery)) {
+            if (!countersWarned) {
+                state.logger->Warn("Unsupported semaphore counter type: 0x{:X}, it'll be reported as zero", static_cast<u8>(type));
+                countersWarned = true;
+            }
+            engine::Maxwell3D::WriteSemaphoreResult(state, address, structureSize, 0);
+            return;
+        }
+
+        bool samples{*counter == SamplesCounter};
+        statisticsUsed |= !samples;
+
+        if (fastQueries) {
+            // The result is conservative rather than exact, samples are never reported as zero so nothing is culled that could be visible
+            u64 value;
+            {
+                std::lock_guard guard(completionMutex);
+                value = counterValues[*counter];
+            }
+            engine::Maxwell3D::WriteSemaphoreResult(state, address, structureSize, samples ? std::max<u64>(value, 1) : value);
+            return;
+        }
+
+        if (recording)
+            EndQueries(samples, !samples);
+        PushQueryEvent(QueryEvent{QueryEvent::Type::Report, *counter, 0, address, structureSize});
+    }
+
+    void GraphicsContext::ResetCounter(u32 counters) {
+        bool samples{counters == 1};
+        if (recording)
+            EndQueries(samples, !samples);
+
+        if (samples) {
+            PushQueryEvent(QueryEvent{QueryEvent::Type::Reset, SamplesCounter});
+        } else {
+            for (u8 counter{StatisticsCounter}; counter < StatisticsCounter + StatisticCount; counter++)
+                PushQueryEvent(QueryEvent{QueryEvent::Type::Reset, counter});
+        }
+    }
+
+    vk::CompareOp GraphicsContext::ConvertCompareOp(Registers::CompareOp op) {
+        using CompareOp = Registers::CompareOp;
+
+        // The GL variants are in the same order as the regular ones, so they're rebased onto them
+        auto value{static_cast<u32>(op)};
+        if (value >= static_cast<u32>(CompareOp::NeverGL))
+            value = value - static_cast<u32>(CompareOp::NeverGL) + static_cast<u32>(CompareOp::Never);
+
+        switch (static_cast<CompareOp>(value)) {
+            case CompareOp::Never:
+                return vk::CompareOp::eNever;
+            case CompareOp::Less:
+                return vk::CompareOp::eLess;
+            case CompareOp::Equal:
+                return vk::CompareOp::eEqual;
+            case CompareOp::LessOrEqual:
+                return vk::CompareOp::eLessOrEqual;
+            case CompareOp::Greater:
+                return vk::CompareOp::eGreater;
+            case CompareOp::NotEqual:
+                return vk::CompareOp::eNotEqual;
+            case CompareOp::GreaterOrEqual:
+                return vk::CompareOp::eGreaterOrEqual;
+            case CompareOp::Always:
+                return vk::CompareOp::eAlways;
+            default:
+                throw exception("Unsupported compare op: 0x{:X}", static_cast<u32>(op));
+        }
+    }
+
+    vk::StencilOp GraphicsContext::ConvertStencilOp(Registers::StencilOp op) {
+        using StencilOp = Registers::StencilOp;
+        switch (op) {
+            case StencilOp::Keep:
+            case StencilOp::KeepGL:
+                return vk::StencilOp::eKeep;
+            case StencilOp::Zero:
+            case StencilOp::ZeroGL:
+                return vk::StencilOp::eZero;
+            case StencilOp::Replace:
+            case StencilOp::ReplaceGL:
+                return vk::StencilOp::eReplace;
+            case StencilOp::IncrementAndClamp:
+            case StencilOp::IncrementAndClampGL:
+                return vk::StencilOp::eIncrementAndClamp;
+            case StencilOp::DecrementAndClamp:
+            case StencilOp::DecrementAndClampGL:
+                return vk::StencilOp::eDecrementAndClamp;
+            case StencilOp::Invert:
+            case StencilOp::InvertGL:
+                return vk::StencilOp::eInvert;
+            case StencilOp::IncrementAndWrap:
+            case StencilOp::IncrementAndWrapGL:
+                return vk::StencilOp::eIncrementAndWrap;
+            case StencilOp::DecrementAndWrap:
+            case StencilOp::DecrementAndWrapGL:
+                return vk::StencilOp::eDecrementAndWrap;
+            default:
+                throw exception("Unsupported stencil op: 0x{:X}", static_cast<u32>(op));
+        }
+    }
+
+    std::optional<vk::PrimitiveTopology> GraphicsContext::ConvertPrimitiveTopology(Registers::PrimitiveTopology topology) {
+        using PrimitiveTopology = Registers::PrimitiveTopology;
+        switch (topology) {
+            case PrimitiveTopology::Points:
+                return vk::PrimitiveTopology::ePointList;
+            case PrimitiveTopology::Lines:
+                return vk::PrimitiveTopology::eLineList;
+            case PrimitiveTopology::LineStrip:
+                return vk::PrimitiveTopology::eLineStrip;
+            case PrimitiveTopology::Triangles:
+                return vk::PrimitiveTopology::eTriangleList;
+            case PrimitiveTopology::TriangleStrip:
+            case PrimitiveTopology::QuadStrip: // A quad strip covers the same area as a triangle strip of the same vertices
+                return vk::PrimitiveTopology::eTriangleStrip;
+            case PrimitiveTopology::TriangleFan:
+            case PrimitiveTopology::Polygon: // Polygons are required to be convex, so they're equivalent to a triangle fan
+                return vk::PrimitiveTopology::eTriangleFan;
+            case PrimitiveTopology::LinesAdjacency:
+                return vk::PrimitiveTopology::eLineListWithAdjacency;
+            case PrimitiveTopology::LineStripAdjacency:
+                return vk::PrimitiveTopology::eLineStripWithAdjacency;
+            case PrimitiveTopology::TrianglesAdjacency:
+                return vk::PrimitiveTopology::eTriangleListWithAdjacency;
+            case PrimitiveTopology::TriangleStripAdjacency:
+                return vk::PrimitiveTopology::eTriangleStripWithAdjacency;
+            case PrimitiveTopology::Patches:
+                return vk::PrimitiveTopology::ePatchList;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    void GraphicsContext::UpdateViewport(const Registers &registers) {
+        auto &guestViewport{registers.viewport[0]};
+        if (registers.viewportTransformEnable) {
+            // The transform maps [-1, 1] onto [translate - scale, translate + scale], a negative scale flips the axis which is left to the translated shaders as a negative viewport size requires VK_KHR_maintenance1
+            auto &transform{registers.viewportTransform[0]};
+            viewport.x = transform.translateX - std::abs(transform.scaleX);
+            viewport.y = transform.translateY - std::abs(transform.scaleY);
+            viewport.width = std::abs(transform.scaleX) * 2;
+            viewport.height = std::abs(transform.scaleY) * 2;
+        } else {
+            viewport.x = guestViewport.x;
+            viewport.y = guestViewport.y;
+            viewport.width = guestViewport.width;
+            viewport.height = guestViewport.height;
+        }
+
+        // Render targets are at the host resolution, so the viewport is scaled alongside them
+        viewport.x *= gpu.resolutionScale;
+        viewport.y *= gpu.resolutionScale;
+        viewport.width *= gpu.resolutionScale;
+        viewport.height *= gpu.resolutionScale;
+
+        // Vulkan doesn't allow an empty viewport or a depth range outside of [0, 1] without VK_EXT_depth_range_unrestricted
+        viewport.width = std::max(viewport.width, 1.0f);
+        viewport.height = std::max(viewport.height, 1.0f);
+        viewport.minDepth = std::clamp(guestViewport.depthRangeNear, 0.0f, 1.0f);
+        viewport.maxDepth = std::clamp(guestViewport.depthRangeFar, 0.0f, 1.0f);
+    }
+
+    void GraphicsContext::UpdateScissor(const Registers &registers) {
+        auto &guestScissor{registers.scissor[0]};
+        if (guestScissor.enable) {
+            // The scissor is scaled like the viewport, the edges are rounded outwards so scaled pixels on them aren't clipped
+            auto scale{gpu.resolutionScale};
+            i32 minX{static_cast<i32>(std::floor(guestScissor.minX * scale))}, minY{static_cast<i32>(std::floor(guestScissor.minY * scale))};
+            i32 maxX{static_cast<i32>(std::ceil(std::max(guestScissor.maxX, guestScissor.minX) * scale))}, maxY{static_cast<i32>(std::ceil(std::max(guestScissor.maxY, guestScissor.minY) * scale))};
+            scissor.offset = vk::Offset2D{minX, minY};
+            scissor.extent = vk::Extent2D{static_cast<u32>(maxX - minX), static_cast<u32>(maxY - minY)};
+        } else {
+            // A disabled scissor doesn't restrict rendering at all, the extent is the largest one which can't overflow when added to the offset
+            scissor = vk::Rect2D{{}, vk::Extent2D{std::numeric_limits<i32>::max(), std::numeric_limits<i32>::max()}};
+        }
+    }
+
+    void GraphicsContext::UpdateRasterizer(const Registers &registers) {
+        // The polygon mode isn't translated as modes other than fill require the fillModeNonSolid feature which isn't enabled
+        rasterizerState.rasterizerDiscardEnable = !registers.rasterizerEnable;
+
+        if (registers.cullFaceEnable) {
+            switch (registers.cullFace) {
+                case Registers::CullFace::Front:
+                    rasterizerState.cullMode = vk::CullModeFlagBits::eFront;
+                    break;
+                case Registers::CullFace::Back:
+                    rasterizerState.cullMode = vk::CullModeFlagBits::eBack;
+                    break;
+                case Registers::CullFace::FrontAndBack:
+                    rasterizerState.cullMode = vk::CullModeFlagBits::eFrontAndBack;
+                    break;
+                default:
+                    throw exception("Unsupported cull face: 0x{:X}", static_cast<u32>(registers.cullFace));
+            }
+        } else {
+            rasterizerState.cullMode = vk::CullModeFlagBits::eNone;
+        }
+
+        rasterizerState.frontFace = registers.frontFace == Registers::FrontFace::Clockwise ? vk::FrontFace::eClockwise : vk::FrontFace::eCounterClockwise;
+    }
+
+    void GraphicsContext::UpdateDepthStencil(const Registers &registers) {
+        depthStencilState.depthTestEnable = registers.depthTestEnable;
+        depthStencilState.depthWriteEnable = registers.depthWriteEnable;
+        depthStencilState.depthCompareOp = ConvertCompareOp(registers.depthTestFunc);
+        depthStencilState.stencilTestEnable = registers.stencilEnable;
+
+        auto &front{registers.stencilFront};
+        depthStencilState.front = vk::StencilOpState{ConvertStencilOp(front.failOp), ConvertStencilOp(front.zPassOp), ConvertStencilOp(front.zFailOp), ConvertCompareOp(front.compare.op), front.compare.mask, front.writeMask, static_cast<u32>(front.compare.ref)};
+
+        if (registers.stencilTwoSideEnable) {
+            auto &back{registers.stencilBack};
+            auto &backExtra{registers.stencilBackExtra};
+            depthStencilState.back = vk::StencilOpState{ConvertStencilOp(back.failOp), ConvertStencilOp(back.zPassOp), ConvertStencilOp(back.zFailOp), ConvertCompareOp(back.compareOp), backExtra.compareMask, backExtra.writeMask, backExtra.compareRef};
+        } else {
+            depthStencilState.back = depthStencilState.front;
+        }
+    }
+
+    void GraphicsContext::UpdateBlend(const Registers &registers) {
+        blendConstants = {registers.blendConstant.r, registers.blendConstant.g, registers.blendConstant.b, registers.blendConstant.a};
+    }
+
+    void GraphicsContext::UpdateTexturePools(const Registers &registers) {
+        descriptorCache.SetPools({registers.texHeaderPool.address.Pack(), registers.texHeaderPool.maximumIndex}, {registers.texSamplerPool.address.Pack(), registers.texSamplerPool.maximumIndex});
+    }
+
+    void GraphicsContext::Draw(engine::Maxwell3D &maxwell3D) {
+        auto &registers{maxwell3D.registers};
+        if (&maxwell3D != lastMaxwell3D) {
+            // The translated state is from another channel's engine, so none of it can be reused
+            maxwell3D.dirtyState.set();
+            lastMaxwell3D = &maxwell3D;
+        }
+
+        auto hostTopology{ConvertPrimitiveTopology(registers.vertexBeginGl.topology)};
+        if (!hostTopology) {
+            state.logger->Warn("Unsupported primitive topology: 0x{:X}", static_cast<u16>(registers.vertexBeginGl.topology));
+            return;
+        }
+
+        Begin();
+        BindBuffers(registers);
+        BeginQueries(registers.sampleCounterEnable);
+        vk::CommandBuffer commands{*frames[frameIndex].commandBuffer};
+        bool extendedDynamicState{gpu.vkExtendedDynamicState};
+
+        // A group is only translated again when it's dirty but it's emitted whenever the command buffer doesn't have it yet
+        auto update{[&](DirtyState group, void (GraphicsContext::*updateGroup)(const Registers &)) {
+            bool dirty{maxwell3D.IsDirty(group)};
+            if (dirty) {
+                (this->*updateGroup)(registers);
+                maxwell3D.ClearDirty(group);
+            }
+            return dirty || emitAll;
+        }};
+
+        if (update(DirtyState::Viewport, &GraphicsContext::UpdateViewport))
+            commands.setViewport(0, viewport);
+
+        if (update(DirtyState::Scissor, &GraphicsContext::UpdateScissor))
+            commands.setScissor(0, scissor);
+
+        if (update(DirtyState::Rasterizer, &GraphicsContext::UpdateRasterizer) && extendedDynamicState) {
+            commands.setCullModeEXT(rasterizerState.cullMode, gpu.vkDispatch);
+            commands.setFrontFaceEXT(rasterizerState.frontFace, gpu.vkDispatch);
+        }
+
+        if (update(DirtyState::DepthStencil, &GraphicsContext::UpdateDepthStencil)) {
+            commands.setStencilCompareMask(vk::StencilFaceFlagBits::eFront, depthStencilState.front.compareMask);
+            commands.setStencilCompareMask(vk::StencilFaceFlagBits::eBack, depthStencilState.back.compareMask);
+            commands.setStencilWriteMask(vk::StencilFaceFlagBits::eFront, depthStencilState.front.writeMask);
+            commands.setStencilWriteMask(vk::StencilFaceFlagBits::eBack, depthStencilState.back.writeMask);
+            commands.setStencilReference(vk::StencilFaceFlagBits::eFront, depthStencilState.front.reference);
+            commands.setStencilReference(vk::StencilFaceFlagBits::eBack, depthStencilState.back.reference);
+
+            if (extendedDynamicState) {
+                commands.setDepthTestEnableEXT(depthStencilState.depthTestEnable, gpu.vkDispatch);
+                commands.setDepthWriteEnableEXT(depthStencilState.depthWriteEnable, gpu.vkDispatch);
+                commands.setDepthCompareOpEXT(depthStencilState.depthCompareOp, gpu.vkDispatch);
+                commands.setStencilTestEnableEXT(depthStencilState.stencilTestEnable, gpu.vkDispatch);
+                for (auto [face, opState] : {std::pair{vk::StencilFaceFlagBits::eFront, depthStencilState.front}, std::pair{vk::StencilFaceFlagBits::eBack, depthStencilState.back}})
+                    commands.setStencilOpEXT(face, opState.failOp, opState.passOp, opState.depthFailOp, opState.compareOp, gpu.vkDispatch);
+            }
+        }
+
+        if (update(DirtyState::Blend, &GraphicsContext::UpdateBlend))
+            commands.setBlendConstants(blendConstants.data());
+
+        update(DirtyState::TexturePools, &GraphicsContext::UpdateTexturePools);
+
+        if ((emitAll || topology != *hostTopology) && extendedDynamicState)
+            commands.setPrimitiveTopologyEXT(*hostTopology, gpu.vkDispatch);
+        topology = *hostTopology;
+
+        emitAll = false;
+
+        // There's no pipeline to draw with until guest shaders are translated and render targets are backed by host images, so only the state is recorded
+        if (!drawWarned) {
+            state.logger->Warn("Skipping draws as guest shaders can't be translated yet, first draw: {} vertices from {}", registers.vertexBuffer.count, registers.vertexBuffer.first);
+            drawWarned = true;
+        }
+    }
+
+    void GraphicsContext::Dispatch(const engine::ComputeLaunch &launch) {
+        // Dispatches have the same limitation as draws, so the constant buffers aren't uploaded either as nothing would read them
+        if (!dispatchWarned) {
+            state.logger->Warn("Skipping compute dispatches as guest shaders can't be translated yet, first dispatch: {}x{}x{} workgroups of program 0x{:X}", launch.gridDimensions[0], launch.gridDimensions[1], launch.gridDimensions[2], launch.programAddress);
+            dispatchWarned = true;
+        }
+    }
+
+    void GraphicsContext::Submit() {
+        if (recording)
+            SubmitFrame();
+    }
+
+    void GraphicsContext::IncrementSyncpoint(u32 id) {
+        auto &syncpoint{gpu.syncpoints.at(id)};
+        if (recording) {
+            SubmitFrame(&syncpoint);
+            return;
+        }
+
+        // The semaphore is signalled on the queue even if no work is in flight, as a signal from the host could precede earlier signals which are still pending
+        auto value{syncpoint.Queue()};
+        if (auto semaphore{syncpoint.GetSemaphore()})
+            SubmitSyncpointSignal(semaphore, value);
+
+        {
+            // The increment can't be observed prior to any work in flight being done, so it's deferred to the latest submitted frame
+            std::lock_guard guard(completionMutex);
+            if (!submittedFrames.empty()) {
+                frames[submittedFrames.back()].syncpoints.emplace_back(&syncpoint, value);
+                return;
+            }
+        }
+
+        syncpoint.Complete(value);
+    }
+}
@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <optional>
+#include <queue>
+#include "syncpoint.h"
+#include "buffer_cache.h"
+#include "descriptor_cache.h"
+#include "upload_queue.h"
+#include "engines/maxwell_3d.h"
+#include "engines/maxwell_compute.h"
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief The GraphicsContext records the draws of Maxwell3D into a Vulkan command buffer, the fixed-function state is translated into dynamic state so changing it doesn't require a new pipeline
+     * @note Only the register groups which Maxwell3D marked as dirty are translated again, the translated state is re-emitted as a whole whenever a new command buffer is begun
+     * @note Work is recorded into a ring of frames, each of which owns a command pool, a descriptor pool and a region of a streaming buffer that are all reset as a whole once the device is done with the frame
+     * @note Buffer uploads which don't have to be ordered against in-flight work are recorded on the dedicated transfer queue if the device has one, frames only wait on the uploads that were recorded while they were
+     * @note The completion of submitted frames is tracked by a dedicated thread, which increments any syncpoints that were waiting on them and makes them available for reuse
+     * @note This must only be used by a single thread, which is the GPFIFO thread
+     */
+    class GraphicsContext {
+      private:
+        using Registers = engine::Maxwell3D::Registers;
+        using DirtyState = engine::Maxwell3D::DirtyState;
+        using SemaphoreInfo = Registers::SemaphoreInfo;
+
+        static constexpr size_t FrameCount{3}; //!< The maximum amount of frames that can be in flight at once
+        static constexpr vk::DeviceSize StreamSize{0x400000}; //!< The size of the region of the streaming buffer that every frame allocates from
+        static constexpr u32 DescriptorSetCount{0x400}; //!< The maximum amount of descriptor sets that a frame can allocate
+        static constexpr u32 DescriptorCount{0x1000}; //!< The maximum amount of descriptors of each type that a frame can allocate
+        static constexpr u32 QueryCount{0x400}; //!< The maximum amount of queries of each type that a frame can record
+        static constexpr size_t SamplesCounter{0}; //!< The index of the samples passed counter in counterValues
+        static constexpr size_t StatisticsCounter{1}; //!< The index of the first pipeline statistics counter in counterValues, these are in the order of their bits in vk::QueryPipelineStatisticFlagBits
+        static constexpr size_t StatisticCount{10}; //!< The amount of pipeline statistics which are queried, all of their bits are contiguous from the first one
+
+        /**
+         * @brief An operation on the guest counters, these are applied in order once the device is done with the frame they were recorded in
+         */
+        struct QueryEvent {
+            enum class Type : u8 {
+                Occlusion, //!< The result of an occlusion query is added to the samples passed counter
+                Statistics, //!< The results of a pipeline statistics query are added to all pipeline statistics counters
+                Report, //!< The value of a counter is written to a semaphore
+                Reset, //!< The value of a counter is reset to zero
+            } type;
+            u8 counter{}; //!< The index of the counter in counterValues for reports and resets
+            u32 query{}; //!< The index of the query in the pool of the frame for query results
+            u64 address{}; //!< The address of the semaphore for reports
+            SemaphoreInfo::StructureSize structureSize{};
+        };
+
+        /**
+         * @brief The resources which work is recorded with, none of these can be reused until the device is done with the frame
+         */
+        struct Frame {
+            vk::UniqueCommandPool commandPool; //!< A transient pool that's reset as a whole rather than resetting individual command buffers
+            vk::UniqueCommandBuffer commandBuffer;
+            vk::UniqueDescriptorPool descriptorPool; //!< A pool that's reset as a whole rather than freeing individual sets
+            vk::UniqueFence fence; //!< Signalled once the device is done with the frame
+            vk::DeviceSize streamOffset{}; //!< The offset of the next allocation in the frame's region of the streaming buffer
+            bool inFlight{}; //!< If the frame has been submitted and the device might not be done with it yet, this is protected by completionMutex
+            std::vector<std::pair<Syncpoint *, u64>> syncpoints; //!< The syncpoints to complete the queued increments of once the device is done with the frame, this is protected by completionMutex
+            std::vector<std::shared_ptr<void>> resources; //!< The resources which are kept alive until the device is done with the frame, this is protected by completionMutex
+            vk::UniqueQueryPool occlusionPool;
+            vk::UniqueQueryPool statisticsPool; //!< This is only created if the device supports pipeline statistics queries
+            u32 occlusionCount{}; //!< The amount of queries in occlusionPool which have been begun
+            u32 statisticsCount{}; //!< The amount of queries in statisticsPool which have been begun
+            std::vector<QueryEvent> queryEvents; //!< The counter operations to apply once the device is done with the frame, this is protected by completionMutex
+            std::vector<vk::UniqueSemaphore> uploadSemaphores; //!< The semaphores of the uploads on the transfer queue which the frame waited on
+        };
+
+        const DeviceState &state;
+        GPU &gpu;
+        std::array<Frame, FrameCount> frames;
+        size_t frameIndex{}; //!< The index of the frame in frames which is recorded into
+        bool recording{}; //!< If the current frame has been begun and not submitted yet
+        bool emitAll{}; //!< If all dynamic state has to be emitted for the next draw regardless of whether it changed, as dynamic state doesn't persist across command buffers
+        bool drawWarned{}; //!< If a warning about draws being skipped has been logged, this is used to only log it once
+        bool dispatchWarned{}; //!< If a warning about compute dispatches being skipped has been logged, this is used to only log it once
+        bool indexWarned{}; //!< If a warning about an unsupported index format has been logged, this is used to only log it once
+        engine::Maxwell3D *lastMaxwell3D{}; //!< The engine which the last draw was recorded from, every channel has its own engine so all state has to be rebuilt when it changes
+        bool fastQueries; //!< If counter reports are written immediately with the values from the last frame the device is done with rather than waiting on the work prior to them
+        bool occlusionActive{}; //!< If an occlusion query is active in the current command buffer
+        bool statisticsActive{}; //!< If a pipeline statistics query is active in the current command buffer
+        bool statisticsUsed{}; //!< If the guest has reported any pipeline statistics counter, these are only queried after that as they aren't free on all devices
+        bool countersWarned{}; //!< If a warning about an unsupported counter has been logged, this is used to only log it once
+        bool pendingTransfers{}; //!< If transfers to buffers have been recorded which haven't been made visible to draws yet
+        u64 submission{}; //!< The amount of frames which have been submitted, this identifies the frame that's recorded into
+        std::atomic<u64> completedSubmissions{}; //!< The amount of submitted frames which the device is done with, frames are completed in the order they were submitted
+
+        vk::Viewport viewport{}; //!< The first guest viewport, the others aren't used as the multiViewport feature isn't enabled
+        vk::Rect2D scissor{}; //!< The first guest scissor, this corresponds to viewport
+        vk::PrimitiveTopology topology{vk::PrimitiveTopology::eTriangleList};
+        std::array<float, 4> blendConstants{};
+
+        vk::UniqueBuffer streamBuffer; //!< A host-visible buffer for uniform and streamed data, it's split into a region for every frame
+        vk::UniqueDeviceMemory streamMemory;
+        u8 *streamMapping{}; //!< A persistent host mapping of streamMemory
+        vk::DeviceSize streamAlignment{}; //!< The minimum alignment of every allocation from the streaming buffer, this satisfies the offset requirements of all uses of it
+
+        std::optional<UploadQueue> uploadQueue; //!< The queue which uploads are recorded on asynchronously, this is only created if the device has a dedicated transfer queue
+
+        std::mutex completionMutex; //!< Synchronizes access to submittedFrames and the completion state of frames
+        std::condition_variable completionCondition; //!< Signalled when a frame is submitted, the device is done with a frame or the thread should exit
+        std::queue<size_t> submittedFrames; //!< The indices of frames which are in flight in the order they were submitted
+        bool running{true};
+        std::array<u64, StatisticsCounter + StatisticCount> counterValues{}; //!< The value of every counter as of the last frame the device is done with, this is protected by completionMutex
+        std::vector<u64> queryResults; //!< The results of the queries of a completed frame, this is only used by the completion thread
+        std::thread completionThread; //!< The thread which waits on the fences of submitted frames, it's started last as it accesses all other members
+
+        /**
+         * @brief Begins recording into the current frame if it isn't being recorded into already, this waits for the device to be done with it and resets all its resources
+         */
+        void Begin();
+
+        /**
+         * @brief Submits the current frame to the device without waiting on it, the supplied syncpoint is incremented once the device is done with it
+         * @note The semaphore of the syncpoint is signalled by the submission itself, so waits on it don't have to wait on the completion thread
+         */
+        void SubmitFrame(Syncpoint *syncpoint = nullptr);
+
+        /**
+         * @brief Submits a signal of the semaphore of a syncpoint without any work, it's ordered after all work that was submitted prior to it
+         */
+        void SubmitSyncpointSignal(vk::Semaphore semaphore, u64 value);
+
+        /**
+         * @brief Makes all transfers to buffers that were recorded prior to this visible to the shader and vertex input stages
+         */
+        void FlushTransfers();
+
+        /**
+         * @brief Looks up the enabled vertex arrays and the index buffer of an indexed draw in the buffer cache and binds them, this flushes the transfers that the lookups recorded
+         */
+        void BindBuffers(const Registers &registers);
+
+        /**
+         * @brief Begins the queries which the next draw has to be counted by, this ends the occlusion query if counting samples was disabled
+         */
+        void BeginQueries(bool countSamples);
+
+        /**
+         * @brief Ends the active queries that are added to the supplied counter, so a report of it includes all work recorded prior to this
+         */
+        void EndQueries(bool samples, bool statistics);
+
+        /**
+         * @brief Queues a counter operation after all work which has been recorded prior to this, it's applied immediately if no work is in flight or recorded
+         */
+        void PushQueryEvent(const QueryEvent &event);
+
+        /**
+         * @brief Applies a counter operation, results of queries are read from queryResults
+         * @note completionMutex must be locked when this is called
+         */
+        void ApplyQueryEvent(const QueryEvent &event, const Frame &frame);
+
+        /**
+         * @return The index of the guest counter in counterValues or nullopt if it can't be queried
+         */
+        static std::optional<u8> GetCounterIndex(SemaphoreInfo::CounterType type);
+
+        /**
+         * @brief The loop of the completion thread, it waits on submitted frames in order until the context is destroyed
+         */
+        void CompletionThread();
+
+        static vk::CompareOp ConvertCompareOp(Registers::CompareOp op);
+
+        static vk::StencilOp ConvertStencilOp(Registers::StencilOp op);
+
+        /**
+         * @return The Vulkan topology corresponding to the guest topology, this is nullopt for topologies that'd need to be converted into another topology with a generated index buffer
+         */
+        static std::optional<vk::PrimitiveTopology> ConvertPrimitiveTopology(Registers::PrimitiveTopology topology);
+
+        void UpdateViewport(const Registers &registers);
+
+        void UpdateScissor(const Registers &registers);
+
+        void UpdateRasterizer(const Registers &registers);
+
+        void UpdateDepthStencil(const Registers &registers);
+
+        void UpdateBlend(const Registers &registers);
+
+        void UpdateTexturePools(const Registers &registers);
+
+      public:
+        std::vector<vk::DynamicState> dynamicStates; //!< All the state which is supplied dynamically, this is the same for every pipeline
+        vk::PipelineRasterizationStateCreateInfo rasterizerState{}; //!< The static rasterizer state of pipelines, the culling and front face are dynamic when VK_EXT_extended_dynamic_state is supported
+        vk::PipelineDepthStencilStateCreateInfo depthStencilState{}; //!< The static depth and stencil state of pipelines, all but the bounds test are dynamic when VK_EXT_extended_dynamic_state is supported
+        BufferCache bufferCache; //!< The host buffers backing guest vertex, index and constant buffers, these are only used by work recorded into this context
+        DescriptorCache descriptorCache; //!< The host objects for entries of the bound texture header and sampler pools, draws look up the textures and samplers they use in it
+
+        /**
+         * @brief A region of the streaming buffer which is valid until the device is done with the frame that it was allocated in
+         */
+        struct StreamAllocation {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+            u8 *pointer; //!< A host mapping of the region, it's host-coherent so writes don't need to be flushed
+        };
+
+        GraphicsContext(const DeviceState &state, GPU &gpu);
+
+        /**
+         * @note The device is waited on prior to any resource being destroyed, syncpoints of work which is still in flight aren't incremented
+         */
+        ~GraphicsContext();
+
+        /**
+         * @brief Allocates a region of the streaming buffer in the current frame, this is only a bump of an offset
+         * @note If the region of the frame is exhausted then it's submitted and the allocation is made from the next frame, so this must be called before recording any work that depends on it
+         */
+        StreamAllocation AllocateStream(vk::DeviceSize size, vk::DeviceSize alignment = 1);
+
+        /**
+         * @brief Allocates a descriptor set from the pool of the current frame, it's freed implicitly once the frame is reused
+         * @note The same caveat around submission applies as for AllocateStream
+         */
+        vk::DescriptorSet AllocateDescriptorSet(vk::DescriptorSetLayout layout);
+
+        /**
+         * @return The submission which work is currently recorded into, this changes whenever a frame is submitted
+         */
+        u64 GetSubmission() {
+            return submission;
+        }
+
+        /**
+         * @return If the device is done with all work of the supplied submission
+         */
+        bool IsSubmissionDone(u64 target) {
+            return target < completedSubmissions.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Records an upload of data into a buffer, this is visible to all draws recorded after it
+         * @param asynchronous If the upload can be recorded on the transfer queue, this is only valid if no in-flight work accesses the range and is ignored if there's no transfer queue
+         * @note The size of the data must not exceed the size of a frame's region of the streaming buffer
+         */
+        void UploadBuffer(span<u8> data, vk::Buffer buffer, vk::DeviceSize offset, bool asynchronous);
+
+        /**
+         * @return If buffers have to be shared concurrently with the transfer queue family, as uploads to them might be recorded on it
+         */
+        bool HasUploadQueue() {
+            return uploadQueue.has_value();
+        }
+
+        /**
+         * @brief Records a copy from the streaming buffer into a buffer, this is visible to all draws recorded after it
+         * @note The allocation must be from the current frame, so this must be called right after AllocateStream
+         */
+        void CopyFromStream(const StreamAllocation &allocation, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size);
+
+        /**
+         * @brief Records an in-place update of a buffer with data that's copied into the command buffer, this is visible to all draws recorded after it
+         * @note The offset and size must be multiples of 4 and the size must not exceed 64KiB as vkCmdUpdateBuffer requires
+         */
+        void UpdateBuffer(vk::Buffer buffer, vk::DeviceSize offset, span<u8> data);
+
+        /**
+         * @brief Keeps a resource alive until the device is done with all work which has been recorded prior to this
+         * @note The resource is released immediately if no work is in flight or recorded
+         */
+        void ReleaseWhenDone(std::shared_ptr<void> resource);
+
+        /**
+         * @brief Writes the value of a guest counter to a semaphore once the device is done with all work which has been recorded prior to this
+         * @note Samples passed are counted with occlusion queries and most pipeline statistics with pipeline statistics queries, counters without a Vulkan equivalent always report zero
+         * @note Queries are begun outside of render passes, so anything which records render passes must not end them within one
+         */
+        void ReportCounter(SemaphoreInfo::CounterType type, u64 address, SemaphoreInfo::StructureSize structureSize);
+
+        /**
+         * @brief Resets guest counters to zero after all work which has been recorded prior to this
+         * @param counters The value written to the counter reset register, which selects the counters to reset
+         */
+        void ResetCounter(u32 counters);
+
+        /**
+         * @brief Records a draw with the current state of Maxwell3D, this rebuilds and clears all its dirty groups
+         */
+        void Draw(engine::Maxwell3D &maxwell3D);
+
+        /**
+         * @brief Records a compute dispatch which was decoded from a QMD by Maxwell Compute
+         */
+        void Dispatch(const engine::ComputeLaunch &launch);
+
+        /**
+         * @brief Submits all recorded work to the device without waiting on it, this does nothing if nothing was recorded
+         */
+        void Submit();
+
+        /**
+         * @brief Increments a syncpoint once the device is done with all work which has been recorded prior to this
+         * @note The syncpoint is incremented immediately if no work is in flight or recorded
+         */
+        void IncrementSyncpoint(u32 id);
+    };
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <bit>
+#include <gpu.h>
+#include "host_buffer.h"
+
+namespace skyline::gpu {
+    std::optional<HostBuffer> HostBuffer::Import(GPU &gpu, u8 *pointer, size_t size, vk::BufferUsageFlags usage) {
+        if (!gpu.vkHostMemoryImport)
+            return std::nullopt;
+
+        auto &device{*gpu.vkDevice};
+        auto address{reinterpret_cast<u64>(pointer)};
+        auto base{util::AlignDown(address, gpu.vkHostImportAlignment)};
+        auto importSize{util::AlignUp(address + size, gpu.vkHostImportAlignment) - base};
+
+        try {
+            auto hostPointerProperties{device.getMemoryHostPointerPropertiesEXT(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, reinterpret_cast<void *>(base), gpu.vkDispatch)};
+
+            HostBuffer hostBuffer;
+            vk::ExternalMemoryBufferCreateInfo externalInfo{vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT};
+            vk::BufferCreateInfo bufferInfo{};
+            bufferInfo.pNext = &externalInfo;
+            bufferInfo.size = importSize;
+            bufferInfo.usage = usage;
+            bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+            hostBuffer.buffer = device.createBufferUnique(bufferInfo);
+
+            auto requirements{device.getBufferMemoryRequirements(*hostBuffer.buffer)};
+            auto memoryTypes{requirements.memoryTypeBits & hostPointerProperties.memoryTypeBits};
+            if (!memoryTypes)
+                return std::nullopt;
+
+            vk::ImportMemoryHostPointerInfoEXT importInfo{vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, reinterpret_cast<void *>(base)};
+            vk::MemoryAllocateInfo allocateInfo{importSize, static_cast<u32>(std::countr_zero(memoryTypes))};
+            allocateInfo.pNext = &importInfo;
+            hostBuffer.memory = device.allocateMemoryUnique(allocateInfo);
+            device.bindBufferMemory(*hostBuffer.buffer, *hostBuffer.memory, 0);
+
+            hostBuffer.offset = address - base;
+            return hostBuffer;
+        } catch (const vk::SystemError &) {
+            // Regions can't be imported if they're backed by memory that the driver can't pin, such as regions which extend outside of a mapping after being aligned
+            return std::nullopt;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <common.h>
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief A Vulkan buffer which is backed by host memory imported with VK_EXT_external_memory_host, this lets the device access guest memory directly rather than through a staging copy
+     * @note The imported memory must stay mapped for as long as the buffer is used by the device
+     */
+    class HostBuffer {
+      private:
+        vk::UniqueDeviceMemory memory; //!< The imported memory, the buffer is destroyed prior to it
+        HostBuffer() = default;
+
+      public:
+        vk::UniqueBuffer buffer;
+        vk::DeviceSize offset{}; //!< The offset of the imported pointer in buffer, the imported region is extended to the import alignment of the device
+
+        /**
+         * @brief Imports a region of host memory into a buffer
+         * @return The buffer or std::nullopt if the device doesn't support importing the region, in which case it needs to be staged
+         */
+        static std::optional<HostBuffer> Import(GPU &gpu, u8 *pointer, size_t size, vk::BufferUsageFlags usage);
+    };
+}
@@ -1,12 +1,15 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <trace.h>
 #include "engines/maxwell_3d.h"
 #include "memory_manager.h"
 #include "macro_interpreter.h"
 
 namespace skyline::gpu {
-    void MacroInterpreter::Execute(size_t offset, const std::vector<u32> &args) {
+    void MacroInterpreter::Execute(size_t offset, span<u32> args) {
+        TRACE_SCOPE("MacroInterpreter::Execute");
+
         // Reset the interpreter state
         registers = {};
         carryFlag = false;
@@ -17,7 +20,143 @@ namespace skyline::gpu {
         // The first argument is stored in register 1
         registers[1] = *argument++;
 
-        while (Step());
+        auto compiled{compiledMacros.find(offset)};
+        if (compiled == compiledMacros.end())
+            compiled = compiledMacros.emplace(offset, Compile(offset)).first;
+
+        if (compiled->second)
+            Execute(*compiled->second);
+        else
+            while (Step());
+    }
+
+    void MacroInterpreter::InvalidateMacros() {
+        compiledMacros.clear();
+    }
+
+    std::shared_ptr<MacroInterpreter::CompiledMacro> MacroInterpreter::Compile(size_t offset) {
+        auto code{span<u32>(maxwell3D.macroCode).subspan(offset)};
+
+        // Walk every reachable instruction to find the extent of the macro and validate it, an instruction can be reached normally or as a delay slot
+        std::vector<u8> reached(code.size()); // Bit 0 is set if it's reached normally and bit 1 if it's reached as a delay slot
+        std::vector<std::pair<i64, bool>> pending{{0, false}};
+        size_t length{};
+        while (!pending.empty()) {
+            auto [index, delaySlot]{pending.back()};
+            pending.pop_back();
+
+            if (index < 0 || static_cast<size_t>(index) >= code.size())
+                return nullptr; // The macro would run outside of macro memory
+
+            u8 reachedBit{static_cast<u8>(delaySlot ? 0b10 : 0b01)};
+            if (reached[index] & reachedBit)
+                continue;
+            reached[index] |= reachedBit;
+            length = std::max(length, static_cast<size_t>(index) + 1);
+
+            Opcode opcode{.raw = code[index]};
+            if (delaySlot) {
+                if (opcode.operation == Opcode::Operation::Branch)
+                    return nullptr; // Branching inside a delay slot is an error that is left to the interpreter
+                continue; // The instruction after a delay slot is determined by the instruction that owns it
+            }
+
+            if (opcode.operation == Opcode::Operation::Branch) {
+                pending.emplace_back(index + opcode.immediate, false);
+                if (!opcode.noDelay)
+                    pending.emplace_back(index + 1, true);
+            }
+
+            // The instruction after the current one is either its delay slot when exiting or the next instruction
+            pending.emplace_back(index + 1, opcode.exit);
+        }
+
+        auto program{code.first(length)};
+        u64 hash{util::Hash(std::string_view(reinterpret_cast<const char *>(program.data()), program.size_bytes()))};
+
+        auto &macro{macroCache[hash]};
+        if (macro)
+            return macro;
+
+        macro = std::make_shared<CompiledMacro>();
+        macro->hash = hash;
+        macro->opcodes.reserve(length);
+        for (size_t index{}; index < length; index++) {
+            Opcode opcode{.raw = program[index]};
+            macro->opcodes.push_back(DecodedOpcode{
+                .operation = opcode.operation,
+                .assignmentOperation = opcode.assignmentOperation,
+                .aluOperation = opcode.aluOperation,
+                .dest = opcode.dest,
+                .srcA = opcode.srcA,
+                .srcB = opcode.srcB,
+                .srcBit = opcode.bitfield.srcBit,
+                .destBit = opcode.bitfield.destBit,
+                .mask = opcode.bitfield.GetMask(),
+                .immediate = opcode.immediate,
+                .target = static_cast<u32>(index + opcode.immediate),
+                .exit = static_cast<bool>(opcode.exit),
+                .branchOnZero = opcode.branchCondition == Opcode::BranchCondition::Zero,
+                .noDelay = opcode.noDelay,
+            });
+        }
+
+        return macro;
+    }
+
+    void MacroInterpreter::Execute(const CompiledMacro &macro) {
+        // Every branch target and delay slot has been validated while compiling so they can be followed without any checks
+        size_t index{};
+        while (true) {
+            const auto &opcode{macro.opcodes[index]};
+            if (opcode.operation == Opcode::Operation::Branch) {
+                if (opcode.branchOnZero == (registers[opcode.srcA] == 0)) {
+                    if (!opcode.noDelay)
+                        ExecuteOpcode(macro.opcodes[index + 1]);
+
+                    index = opcode.target;
+                    continue;
+                }
+            } else {
+                ExecuteOpcode(opcode);
+            }
+
+            if (opcode.exit) {
+                // Exit has a delay slot
+                ExecuteOpcode(macro.opcodes[index + 1]);
+                return;
+            }
+
+            index++;
+        }
+    }
+
+    FORCE_INLINE void MacroInterpreter::ExecuteOpcode(const DecodedOpcode &opcode) {
+        switch (opcode.operation) {
+            case Opcode::Operation::AluRegister:
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, HandleAlu(opcode.aluOperation, registers[opcode.srcA], registers[opcode.srcB]));
+                break;
+            case Opcode::Operation::AddImmediate:
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, registers[opcode.srcA] + opcode.immediate);
+                break;
+            case Opcode::Operation::BitfieldReplace: {
+                u32 src{(registers[opcode.srcB] >> opcode.srcBit) & opcode.mask};
+                u32 dest{registers[opcode.srcA] & ~(opcode.mask << opcode.destBit)};
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, dest | (src << opcode.destBit));
+                break;
+            }
+            case Opcode::Operation::BitfieldExtractShiftLeftImmediate:
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, ((registers[opcode.srcB] >> registers[opcode.srcA]) & opcode.mask) << opcode.destBit);
+                break;
+            case Opcode::Operation::BitfieldExtractShiftLeftRegister:
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, ((registers[opcode.srcB] >> opcode.srcBit) & opcode.mask) << registers[opcode.srcA]);
+                break;
+            case Opcode::Operation::ReadImmediate:
+                HandleAssignment(opcode.assignmentOperation, opcode.dest, maxwell3D.registers.raw[registers[opcode.srcA] + opcode.immediate]);
+                break;
+            default:
+                break;
+        }
     }
 
     FORCE_INLINE bool MacroInterpreter::Step(Opcode *delayedOpcode) {
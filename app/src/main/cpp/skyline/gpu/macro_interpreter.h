@@ -105,8 +105,39 @@ namespace skyline::gpu {
             };
         };
 
+        /**
+         * @brief A macro instruction with all of its fields decoded ahead of time
+         */
+        struct DecodedOpcode {
+            Opcode::Operation operation;
+            Opcode::AssignmentOperation assignmentOperation;
+            Opcode::AluOperation aluOperation;
+            u8 dest;
+            u8 srcA;
+            u8 srcB;
+            u8 srcBit;
+            u8 destBit;
+            u32 mask; //!< The mask of the bitfield for bitfield operations
+            i32 immediate;
+            u32 target; //!< The index of the branch target relative to the start of the macro
+            bool exit;
+            bool branchOnZero;
+            bool noDelay;
+        };
+
+        /**
+         * @brief A macro that has been decoded into a flat program with every branch target and delay slot validated, this avoids decoding every opcode each time a macro is executed
+         */
+        struct CompiledMacro {
+            u64 hash; //!< The hash of the macro's code up until the last reachable instruction
+            std::vector<DecodedOpcode> opcodes;
+        };
+
         engine::Maxwell3D &maxwell3D;
 
+        std::unordered_map<u64, std::shared_ptr<CompiledMacro>> macroCache; //!< All macros which have been compiled so far keyed by their hash, identical macros uploaded again are reused from this
+        std::unordered_map<size_t, std::shared_ptr<CompiledMacro>> compiledMacros; //!< The compiled macro at every offset in macro memory which has been executed, this is nullptr for macros which can only be interpreted
+
         std::array<u32, 8> registers{};
 
         Opcode *opcode{};
@@ -120,6 +151,22 @@ namespace skyline::gpu {
          */
         bool Step(Opcode *delayedOpcode = nullptr);
 
+        /**
+         * @brief Compiles the macro at the supplied offset in macro memory
+         * @return The compiled macro or nullptr if the macro uses patterns that aren't supported by compiled execution
+         */
+        std::shared_ptr<CompiledMacro> Compile(size_t offset);
+
+        /**
+         * @brief Executes a compiled macro, the interpreter state must have been reset prior to this
+         */
+        void Execute(const CompiledMacro &macro);
+
+        /**
+         * @brief Executes a single decoded non-branch instruction
+         */
+        void ExecuteOpcode(const DecodedOpcode &opcode);
+
         /**
          * @brief Performs an ALU operation on the given source values and returns the result as a u32
          */
@@ -142,7 +189,14 @@ namespace skyline::gpu {
 
         /**
          * @brief Executes a GPU macro from macro memory with the given arguments
+         * @param args The arguments of the macro, these can point directly into a pushbuffer as they're only read during execution
+         */
+        void Execute(size_t offset, span<u32> args);
+
+        /**
+         * @brief Drops all compiled macros at offsets in macro memory, this must be called whenever macro memory is written to
+         * @note Compiled macros are still cached by their hash so reuploading an identical macro doesn't require compiling it again
          */
-        void Execute(size_t offset, const std::vector<u32> &args);
+        void InvalidateMacros();
     };
 }
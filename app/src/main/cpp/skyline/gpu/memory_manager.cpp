@@ -2,85 +2,76 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <kernel/types/KProcess.h>
+#include <os.h>
 #include "memory_manager.h"
 
 namespace skyline::gpu::vmm {
     MemoryManager::MemoryManager(const DeviceState &state) : state(state) {
-        constexpr u64 GpuAddressSpaceSize{1ul << 40}; //!< The size of the GPU address space
-        constexpr u64 GpuAddressSpaceBase{0x100000}; //!< The base of the GPU address space - must be non-zero
-
         // Create the initial chunk that will be split to create new chunks
-        ChunkDescriptor baseChunk(GpuAddressSpaceBase, GpuAddressSpaceSize, 0, ChunkState::Unmapped);
-        chunks.push_back(baseChunk);
+        chunks.emplace(GpuAddressSpaceBase, ChunkDescriptor(GpuAddressSpaceBase, GpuAddressSpaceSize, 0, ChunkState::Unmapped));
+    }
+
+    void MemoryManager::MapPages(u64 address, u64 size, u64 cpuAddress) {
+        for (u64 page{address}, end{address + size}; page < end; page += constant::GpuPageSize) {
+            auto directoryIndex{page >> (PageTableBits + PageBits)};
+            auto &table{pageDirectory[directoryIndex]};
+            if (!table) {
+                if (!cpuAddress) {
+                    page = ((directoryIndex + 1) << (PageTableBits + PageBits)) - constant::GpuPageSize; // There's nothing to unmap in a table that was never allocated
+                    continue;
+                }
+                table = std::make_unique<PageTable>();
+                table->fill(0);
+            }
+
+            (*table)[(page >> PageBits) & ((1 << PageTableBits) - 1)] = cpuAddress ? cpuAddress + (page - address) : 0;
+        }
     }
 
     std::optional<ChunkDescriptor> MemoryManager::FindChunk(u64 size, ChunkState state) {
-        auto chunk{std::find_if(chunks.begin(), chunks.end(), [size, state](const ChunkDescriptor &chunk) -> bool {
-            return chunk.size > size && chunk.state == state;
+        auto chunk{std::find_if(chunks.begin(), chunks.end(), [size, state](const auto &entry) -> bool {
+            return entry.second.size > size && entry.second.state == state;
         })};
 
         if (chunk != chunks.end())
-            return *chunk;
+            return chunk->second;
 
         return std::nullopt;
     }
 
-    u64 MemoryManager::InsertChunk(const ChunkDescriptor &newChunk) {
-        auto chunkEnd{chunks.end()};
-        for (auto chunk{chunks.begin()}; chunk != chunkEnd; chunk++) {
-            if (chunk->CanContain(newChunk)) {
-                auto oldChunk{*chunk};
-                u64 newSize{newChunk.address - chunk->address};
-                u64 extension{chunk->size - newSize - newChunk.size};
-
-                if (newSize == 0) {
-                    *chunk = newChunk;
-                } else {
-                    chunk->size = newSize;
-
-                    chunk = chunks.insert(std::next(chunk), newChunk);
-                }
-
-                if (extension)
-                    chunks.insert(std::next(chunk), ChunkDescriptor(newChunk.address + newChunk.size, extension, (oldChunk.state == ChunkState::Mapped) ? (oldChunk.cpuAddress + newSize + newChunk.size) : 0, oldChunk.state));
-
-                return newChunk.address;
-            } else if (chunk->address + chunk->size > newChunk.address) {
-                chunk->size = newChunk.address - chunk->address;
+    std::map<u64, ChunkDescriptor>::iterator MemoryManager::SplitChunk(std::map<u64, ChunkDescriptor>::iterator chunk, u64 address) {
+        auto &head{chunk->second};
+        u64 offset{address - head.address};
+        ChunkDescriptor tail(address, head.size - offset, (head.state == ChunkState::Mapped) ? (head.cpuAddress + offset) : 0, head.state);
+        head.size = offset;
 
-                // Deletes all chunks that are within the chunk being inserted and split the final one
-                auto tailChunk{std::next(chunk)};
-                while (tailChunk != chunkEnd) {
-                    if (tailChunk->address + tailChunk->size >= newChunk.address + newChunk.size)
-                        break;
-
-                    tailChunk = chunks.erase(tailChunk);
-                    chunkEnd = chunks.end();
-                }
-
-                // The given chunk is too large to fit into existing chunks
-                if (tailChunk == chunkEnd)
-                    break;
+        return chunks.emplace_hint(std::next(chunk), address, tail);
+    }
 
-                u64 chunkSliceOffset{newChunk.address + newChunk.size - tailChunk->address};
-                tailChunk->address += chunkSliceOffset;
-                tailChunk->size -= chunkSliceOffset;
-                if (tailChunk->state == ChunkState::Mapped)
-                    tailChunk->cpuAddress += chunkSliceOffset;
+    u64 MemoryManager::InsertChunk(const ChunkDescriptor &newChunk, bool invalidate) {
+        u64 end{newChunk.address + newChunk.size};
+        if (newChunk.address < GpuAddressSpaceBase || end > GpuAddressSpaceBase + GpuAddressSpaceSize || end <= newChunk.address)
+            throw exception("Failed to insert chunk into GPU address space!");
 
+        if (invalidate)
+            generation.fetch_add(1, std::memory_order_release);
 
-                // If the size of the head chunk is zero then we can directly replace it with our new one rather than inserting it
-                auto headChunk{std::prev(tailChunk)};
-                if (headChunk->size == 0)
-                    *headChunk = newChunk;
-                else
-                    chunks.insert(std::next(headChunk), newChunk);
+        // The chunks cover the entire address space, so the chunk containing the start of the new chunk always exists
+        auto chunk{std::prev(chunks.upper_bound(newChunk.address))};
+        if (chunk->first < newChunk.address)
+            chunk = SplitChunk(chunk, newChunk.address);
 
-                return newChunk.address;
-            }
+        // Deletes all chunks that are within the chunk being inserted and split the final one
+        while (chunk != chunks.end() && chunk->first < end) {
+            if (chunk->first + chunk->second.size > end)
+                SplitChunk(chunk, end);
+            chunk = chunks.erase(chunk);
         }
 
-        throw exception("Failed to insert chunk into GPU address space!");
+        chunks.emplace_hint(chunk, newChunk.address, newChunk);
+        MapPages(newChunk.address, newChunk.size, (newChunk.state == ChunkState::Mapped) ? newChunk.cpuAddress : 0);
+
+        return newChunk.address;
     }
 
     u64 MemoryManager::ReserveSpace(u64 size) {
@@ -128,80 +119,104 @@ namespace skyline::gpu::vmm {
         return InsertChunk(ChunkDescriptor(address, size, cpuAddress, ChunkState::Mapped));
     }
 
+    bool MemoryManager::MapFixed(span<const ChunkDescriptor> regions) {
+        for (const auto &region : regions)
+            if (!util::IsAligned(region.address, constant::GpuPageSize))
+                return false;
+
+        generation.fetch_add(1, std::memory_order_release); // The entire batch is a single change to the address space, so cached translations only need to be invalidated once
+        for (const auto &region : regions) {
+            auto mapped{region.state == ChunkState::Mapped};
+            InsertChunk(ChunkDescriptor(region.address, util::AlignUp(region.size, constant::GpuPageSize), mapped ? region.cpuAddress : 0, mapped ? ChunkState::Mapped : ChunkState::Reserved), false);
+        }
+
+        return true;
+    }
+
     bool MemoryManager::Unmap(u64 address) {
         if (!util::IsAligned(address, constant::GpuPageSize))
             return false;
 
-        auto chunk{std::find_if(chunks.begin(), chunks.end(), [address](const ChunkDescriptor &chunk) -> bool {
-            return chunk.address == address;
-        })};
-
+        auto chunk{chunks.find(address)};
         if (chunk == chunks.end())
             return false;
 
-        chunk->state = ChunkState::Reserved;
-        chunk->cpuAddress = 0;
+        chunk->second.state = ChunkState::Reserved;
+        chunk->second.cpuAddress = 0;
+        generation.fetch_add(1, std::memory_order_release);
+        MapPages(chunk->second.address, chunk->second.size, 0);
 
         return true;
     }
 
-    void MemoryManager::Read(u8 *destination, u64 address, u64 size) const {
-        auto chunk{std::upper_bound(chunks.begin(), chunks.end(), address, [](const u64 address, const ChunkDescriptor &chunk) -> bool {
-            return address < chunk.address;
-        })};
-
-        if (chunk == chunks.end() || chunk->state != ChunkState::Mapped)
-            throw exception("Failed to read region in GPU address space: Address: 0x{:X}, Size: 0x{:X}", address, size);
+    u8 *MemoryManager::GetHostPointer(u64 address, u64 size) const {
+        u64 cpuAddress{Translate(address)};
+        if (!cpuAddress)
+            return nullptr;
 
-        chunk--;
+        // Every page after the first one needs to directly follow the previous page in the CPU address space
+        for (u64 page{util::AlignDown(address, constant::GpuPageSize) + constant::GpuPageSize}; page < address + size; page += constant::GpuPageSize)
+            if (Translate(page) != cpuAddress + (page - address))
+                return nullptr;
 
-        u64 initialSize{size};
-        u64 chunkOffset{address - chunk->address};
-        u64 readAddress{chunk->cpuAddress + chunkOffset};
-        u64 readSize{std::min(chunk->size - chunkOffset, size)};
+        if (!state.os->memory.IsHostContiguous(cpuAddress, size))
+            return nullptr;
 
-        // A continuous region in the GPU address space may be made up of several discontinuous regions in physical memory so we have to iterate over all chunks
-        while (size) {
-            state.process->ReadMemory(destination + (initialSize - size), readAddress, readSize);
-
-            size -= readSize;
-            if (size) {
-                if (++chunk == chunks.end() || chunk->state != ChunkState::Mapped)
-                    throw exception("Failed to read region in GPU address space: Address: 0x{:X}, Size: 0x{:X}", address, size);
+        return state.process->GetPointer<u8>(cpuAddress);
+    }
 
-                readAddress = chunk->cpuAddress;
-                readSize = std::min(chunk->size, size);
+    void MemoryManager::Transfer(u8 *buffer, u64 address, u64 size, bool write) const {
+        // A continuous region in the GPU address space may be made up of several discontinuous regions in the CPU address space, the pages of the region are coalesced into ranges which are transferred as a single batch
+        kernel::type::KProcess::MemoryTransfer current{buffer, 0, 0};
+        std::vector<kernel::type::KProcess::MemoryTransfer> transfers; // This is only used when there's more than a single range
+        for (u64 offset{}; offset < size;) {
+            u64 cpuAddress{Translate(address + offset)};
+            if (!cpuAddress)
+                throw exception("Failed to {} region in GPU address space: Address: 0x{:X}, Size: 0x{:X}", write ? "write" : "read", address, size);
+
+            u64 pageSize{std::min(constant::GpuPageSize - ((address + offset) & (constant::GpuPageSize - 1)), size - offset)};
+            if (current.size && current.guest + current.size != cpuAddress) {
+                transfers.push_back(current);
+                current = {buffer + offset, cpuAddress, 0};
+            } else if (!current.size) {
+                current.guest = cpuAddress;
             }
-        }
-    }
 
-    void MemoryManager::Write(u8 *source, u64 address, u64 size) const {
-        auto chunk{std::upper_bound(chunks.begin(), chunks.end(), address, [](const u64 address, const ChunkDescriptor &chunk) -> bool {
-            return address < chunk.address;
-        })};
+            current.size += pageSize;
+            offset += pageSize;
+        }
 
-        if (chunk == chunks.end() || chunk->state != ChunkState::Mapped)
-            throw exception("Failed to write region in GPU address space: Address: 0x{:X}, Size: 0x{:X}", address, size);
+        span<const kernel::type::KProcess::MemoryTransfer> batch{&current, 1};
+        if (!transfers.empty()) {
+            transfers.push_back(current);
+            batch = transfers;
+        }
 
-        chunk--;
+        if (write)
+            state.process->WriteMemoryBatch(batch);
+        else
+            state.process->ReadMemoryBatch(batch);
+    }
 
-        u64 initialSize{size};
-        u64 chunkOffset{address - chunk->address};
-        u64 writeAddress{chunk->cpuAddress + chunkOffset};
-        u64 writeSize{std::min(chunk->size - chunkOffset, size)};
+    void MemoryManager::Access(u64 address, u64 size, bool write, const std::function<void(u8 *)> &function) const {
+        if (auto pointer{GetHostPointer(address, size)}) {
+            function(pointer);
+            return;
+        }
 
-        // A continuous region in the GPU address space may be made up of several discontinuous regions in physical memory so we have to iterate over all chunks
-        while (size) {
-            state.process->WriteMemory(source + (initialSize - size), writeAddress, writeSize);
+        // The region is always read in as the function might only write to parts of it
+        std::vector<u8> staging(size);
+        Read(staging.data(), address, size);
+        function(staging.data());
+        if (write)
+            Write(staging.data(), address, size);
+    }
 
-            size -= writeSize;
-            if (size) {
-                if (++chunk == chunks.end() || chunk->state != ChunkState::Mapped)
-                    throw exception("Failed to write region in GPU address space: Address: 0x{:X}, Size: 0x{:X}", address, size);
+    void MemoryManager::Read(u8 *destination, u64 address, u64 size) const {
+        Transfer(destination, address, size, false);
+    }
 
-                writeAddress = chunk->cpuAddress;
-                writeSize = std::min(chunk->size, size);
-            }
-        }
+    void MemoryManager::Write(u8 *source, u64 address, u64 size) const {
+        Transfer(source, address, size, true);
     }
 }
@@ -38,8 +38,37 @@ namespace skyline {
          */
         class MemoryManager {
           private:
+            static constexpr u64 GpuAddressSpaceSize{1ul << 40}; //!< The size of the GPU address space
+            static constexpr u64 GpuAddressSpaceBase{0x100000}; //!< The base of the GPU address space - must be non-zero
+            static constexpr u8 PageBits{16}; //!< The amount of bits in an address which are an offset into a GPU page
+            static constexpr u8 PageTableBits{12}; //!< The amount of bits in an address which index into a second-level page table
+            static constexpr u8 PageDirectoryBits{41 - PageTableBits - PageBits}; //!< The amount of bits in an address which index into the first-level page directory, this covers the end of the address space
+            using PageTable = std::array<u64, 1 << PageTableBits>; //!< A second-level page table mapping GPU pages to the CPU address of each page
+            static_assert((1ul << PageBits) == constant::GpuPageSize);
+
             const DeviceState &state;
-            std::vector<ChunkDescriptor> chunks;
+            std::map<u64, ChunkDescriptor> chunks; //!< All chunks in the GPU address space keyed by their address, these cover the entire address space without any overlaps
+            std::atomic<u64> generation{}; //!< A counter that's incremented on every change to the mappings of the address space, it's used to invalidate cached translations
+            std::array<std::unique_ptr<PageTable>, 1 << PageDirectoryBits> pageDirectory{}; //!< A page table mapping every GPU page to its CPU address or 0 if it isn't mapped, it's kept in sync with chunks
+
+            /**
+             * @brief Maps or unmaps GPU pages in the page table
+             * @param address The address of the first page
+             * @param size The size of the pages in bytes
+             * @param cpuAddress The CPU address corresponding to the GPU address, the pages are unmapped if this is 0
+             */
+            void MapPages(u64 address, u64 size, u64 cpuAddress);
+
+            /**
+             * @brief Splits a chunk into two at the supplied address
+             * @return An iterator to the chunk starting at the supplied address
+             */
+            std::map<u64, ChunkDescriptor>::iterator SplitChunk(std::map<u64, ChunkDescriptor>::iterator chunk, u64 address);
+
+            /**
+             * @brief Transfers a region of the GPU virtual address space to or from a buffer, every CPU-contiguous range of the region is a single transfer
+             */
+            void Transfer(u8 *buffer, u64 address, u64 size, bool write) const;
 
             /**
              * @brief Finds a chunk of the specified type in the GPU address space that is larger than the given size
@@ -52,13 +81,33 @@ namespace skyline {
             /**
              * @brief Inserts a chunk into the chunk list, resizing and splitting as necessary
              * @param newChunk The chunk to insert
+             * @param invalidate If the generation should be incremented, this is false when the caller has already done so for a batch of chunks
              * @return The base virtual GPU address of the inserted chunk
              */
-            u64 InsertChunk(const ChunkDescriptor &newChunk);
+            u64 InsertChunk(const ChunkDescriptor &newChunk, bool invalidate = true);
 
           public:
             MemoryManager(const DeviceState &state);
 
+            /**
+             * @return The current generation of the mappings, any host pointer obtained from GetHostPointer is only valid while this remains unchanged
+             */
+            u64 GetGeneration() const {
+                return generation.load(std::memory_order_acquire);
+            }
+
+            /**
+             * @return The CPU address corresponding to the supplied GPU address or 0 if it isn't mapped
+             */
+            inline u64 Translate(u64 address) const {
+                auto directoryIndex{address >> (PageTableBits + PageBits)};
+                if (directoryIndex >= pageDirectory.size() || !pageDirectory[directoryIndex])
+                    return 0;
+
+                auto page{(*pageDirectory[directoryIndex])[(address >> PageBits) & ((1 << PageTableBits) - 1)]};
+                return page ? page + (address & ((1 << PageBits) - 1)) : 0;
+            }
+
             /**
              * @brief Reserves a region of the GPU address space so it will not be chosen automatically when mapping
              * @param size The size of the region to reserve
@@ -91,12 +140,41 @@ namespace skyline {
              */
             u64 MapFixed(u64 address, u64 cpuAddress, u64 size);
 
+            /**
+             * @brief Maps or reserves a batch of fixed regions as a single update of the address space, the regions are applied in order
+             * @param regions The regions to insert, Mapped regions are mapped to their CPU address while any other regions are only reserved
+             * @return If all regions were applied, none of them are applied if any region isn't page-aligned
+             */
+            bool MapFixed(span<const ChunkDescriptor> regions);
+
             /**
              * @brief Unmaps the chunk that starts at 'offset' from the GPU address space
              * @return Whether the operation succeeded
              */
             bool Unmap(u64 address);
 
+            /**
+             * @return A host pointer to a region of the GPU virtual address space if it lies within a single mapped chunk and is contiguous in host memory, otherwise nullptr
+             * @note The pointer is only valid for as long as the region remains mapped
+             */
+            u8 *GetHostPointer(u64 address, u64 size) const;
+
+            /**
+             * @return A span directly into a region of the GPU virtual address space, this is empty if the region can't be accessed directly in which case it has to be read instead
+             * @note The span is only valid for as long as the region remains mapped
+             */
+            template<typename T>
+            span<T> GetHostSpan(u64 address, size_t count) const {
+                auto pointer{GetHostPointer(address, count * sizeof(T))};
+                return pointer ? span<T>(reinterpret_cast<T *>(pointer), count) : span<T>();
+            }
+
+            /**
+             * @brief Runs a function on a host pointer to a region of the GPU virtual address space, regions which can't be accessed directly are staged through a temporary buffer
+             * @param write If the function writes to the region, a staged region is written back to the GPU virtual address space afterwards
+             */
+            void Access(u64 address, u64 size, bool write, const std::function<void(u8 *)> &function) const;
+
             void Read(u8 *destination, u64 address, u64 size) const;
 
             /**
@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <bit>
+#include <gpu.h>
+#include "pipeline_cache.h"
+
+namespace skyline::gpu {
+    PipelineCache::PipelineCache(const DeviceState &state, GPU &gpu) : state(state), gpu(gpu), vkPipelineCache(gpu.vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo{})) {}
+
+    PipelineCache::~PipelineCache() {
+        if (loadThread.joinable())
+            loadThread.join();
+    }
+
+    void PipelineCache::LoadThread() {
+        pthread_setname_np(pthread_self(), "Sky-Cache");
+
+        try {
+            LoadPipelines();
+        } catch (const std::exception &e) {
+            // The cache is only an optimization, so failing to read from it shouldn't prevent pipelines from being created
+            state.logger->Warn("Failed to read from the pipeline cache: {}", e.what());
+        }
+
+        LoadShaders();
+    }
+
+    void PipelineCache::LoadPipelines() {
+        if (!cache->FileExists(PipelineCacheName))
+            return;
+
+        auto file{cache->OpenFile(PipelineCacheName)};
+        if (file->size < sizeof(PipelineCacheHeader))
+            return;
+
+        auto header{file->Read<PipelineCacheHeader>()};
+        if (header.magic != PipelineCacheMagic || header.size < sizeof(VulkanCacheHeader) || file->size != sizeof(PipelineCacheHeader) + header.size)
+            return;
+
+        std::vector<u8> data(header.size);
+        file->Read(data, sizeof(PipelineCacheHeader));
+
+        // Some drivers don't validate the data that they're supplied with, so data from a different device or driver is discarded prior to being passed to them
+        auto vulkanHeader{reinterpret_cast<VulkanCacheHeader *>(data.data())};
+        auto properties{gpu.vkPhysicalDevice.getProperties()};
+        if (vulkanHeader->version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vulkanHeader->vendorId != properties.vendorID || vulkanHeader->deviceId != properties.deviceID || std::memcmp(vulkanHeader->uuid.data(), properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            state.logger->Info("Discarding the pipeline cache as it was created by a different device or driver");
+            return;
+        }
+
+        auto loadedCache{gpu.vkDevice->createPipelineCacheUnique(vk::PipelineCacheCreateInfo{{}, data.size(), data.data()})};
+
+        std::unique_lock lock(pipelineMutex);
+        gpu.vkDevice->mergePipelineCaches(*vkPipelineCache, *loadedCache);
+        state.logger->Debug("Loaded {} bytes of pipeline cache data", data.size());
+    }
+
+    void PipelineCache::LoadShaders() {
+        std::lock_guard guard(shaderMutex);
+
+        try {
+            size_t offset{};
+            if (cache->FileExists(ShaderCacheName)) {
+                auto file{cache->OpenFile(ShaderCacheName, {true, true, false})};
+                if (file->size >= sizeof(ShaderCacheHeader)) {
+                    auto header{file->Read<ShaderCacheHeader>()};
+                    if (header.magic == ShaderCacheMagic && header.version == ShaderCacheVersion) {
+                        offset = sizeof(ShaderCacheHeader);
+                        while (offset + sizeof(ShaderEntry) <= file->size) {
+                            auto entry{file->Read<ShaderEntry>(offset)};
+                            size_t size{entry.size * sizeof(u32)};
+                            if (offset + sizeof(ShaderEntry) + size > file->size)
+                                break;
+
+                            std::vector<u32> spirv(entry.size);
+                            file->Read(span(reinterpret_cast<u8 *>(spirv.data()), size), offset + sizeof(ShaderEntry));
+                            shaders[entry.key] = std::make_shared<const std::vector<u32>>(std::move(spirv));
+                            offset += sizeof(ShaderEntry) + size;
+                        }
+
+                        // A truncated entry from an interrupted write is discarded, so it isn't mistaken for part of the entry written after it
+                        if (offset != file->size)
+                            file->Resize(offset);
+                        shaderFile = std::move(file);
+                    }
+                }
+            }
+
+            if (!shaderFile) {
+                ShaderCacheHeader header{
+                    .magic = ShaderCacheMagic,
+                    .version = ShaderCacheVersion,
+                };
+
+                cache->CreateFile(ShaderCacheName, 0);
+                shaderFile = cache->OpenFile(ShaderCacheName, {false, true, false});
+                shaderFile->Write(span(reinterpret_cast<u8 *>(&header), sizeof(ShaderCacheHeader)));
+                offset = sizeof(ShaderCacheHeader);
+            }
+
+            shaderFileSize = offset;
+            state.logger->Debug("Loaded {} shaders from the shader cache", shaders.size());
+        } catch (const std::exception &e) {
+            state.logger->Warn("Failed to read from the shader cache: {}", e.what());
+            shaderFile = nullptr;
+        }
+
+        shadersLoading = false;
+        shaderCondition.notify_all();
+    }
+
+    void PipelineCache::Load(const std::string &path) {
+        try {
+            cache = std::make_shared<vfs::OsFileSystem>(path);
+        } catch (const std::exception &e) {
+            state.logger->Warn("Failed to open the pipeline cache: {}", e.what());
+            return;
+        }
+
+        {
+            std::lock_guard guard(shaderMutex);
+            shadersLoading = true;
+        }
+        loadThread = std::thread(&PipelineCache::LoadThread, this);
+    }
+
+    void PipelineCache::Save() {
+        if (loadThread.joinable())
+            loadThread.join();
+        if (!cache)
+            return;
+
+        try {
+            std::vector<u8> data;
+            {
+                std::unique_lock lock(pipelineMutex);
+                data = gpu.vkDevice->getPipelineCacheData(*vkPipelineCache);
+            }
+
+            PipelineCacheHeader header{
+                .magic = PipelineCacheMagic,
+                .size = data.size(),
+            };
+
+            cache->CreateFile(PipelineCacheName, 0); // The file is truncated first so the previous header doesn't remain valid if the write is interrupted
+            auto file{cache->OpenFile(PipelineCacheName, {false, true, false})};
+            file->Write(data, sizeof(PipelineCacheHeader));
+            file->Write(span(reinterpret_cast<u8 *>(&header), sizeof(PipelineCacheHeader))); // The header is written last so an interrupted write never results in a valid cache file
+        } catch (const std::exception &e) {
+            state.logger->Warn("Failed to write to the pipeline cache: {}", e.what());
+        }
+    }
+
+    vk::UniquePipeline PipelineCache::CreateComputePipeline(const vk::ComputePipelineCreateInfo &createInfo) {
+        std::shared_lock lock(pipelineMutex);
+        return std::move(gpu.vkDevice->createComputePipelineUnique(*vkPipelineCache, createInfo).value);
+    }
+
+    vk::UniquePipeline PipelineCache::CreateGraphicsPipeline(const vk::GraphicsPipelineCreateInfo &createInfo) {
+        std::shared_lock lock(pipelineMutex);
+        return std::move(gpu.vkDevice->createGraphicsPipelineUnique(*vkPipelineCache, createInfo).value);
+    }
+
+    u64 PipelineCache::GetShaderKey(span<u8> code, span<u8> translationState) {
+        constexpr u64 Prime{0x9E3779B97F4A7C15};
+        u64 codeHash{util::Hash(std::string_view(reinterpret_cast<const char *>(code.data()), code.size()))};
+        u64 stateHash{util::Hash(std::string_view(reinterpret_cast<const char *>(translationState.data()), translationState.size()))};
+        return std::rotl(codeHash * Prime, 31) ^ stateHash;
+    }
+
+    std::shared_ptr<const std::vector<u32>> PipelineCache::LookupShader(u64 key) {
+        std::unique_lock lock(shaderMutex);
+        shaderCondition.wait(lock, [this] { return !shadersLoading; });
+
+        auto shader{shaders.find(key)};
+        return shader != shaders.end() ? shader->second : nullptr;
+    }
+
+    std::shared_ptr<const std::vector<u32>> PipelineCache::StoreShader(u64 key, std::vector<u32> spirv) {
+        std::unique_lock lock(shaderMutex);
+        shaderCondition.wait(lock, [this] { return !shadersLoading; });
+
+        auto &shader{shaders[key]};
+        if (shader)
+            return shader;
+        shader = std::make_shared<const std::vector<u32>>(std::move(spirv));
+
+        if (shaderFile) {
+            try {
+                ShaderEntry entry{
+                    .key = key,
+                    .size = static_cast<u32>(shader->size()),
+                };
+
+                size_t size{shader->size() * sizeof(u32)};
+                shaderFile->Write(span(reinterpret_cast<u8 *>(const_cast<u32 *>(shader->data())), size), shaderFileSize + sizeof(ShaderEntry));
+                shaderFile->Write(span(reinterpret_cast<u8 *>(&entry), sizeof(ShaderEntry)), shaderFileSize);
+                shaderFileSize += sizeof(ShaderEntry) + size;
+            } catch (const std::exception &e) {
+                state.logger->Warn("Failed to write to the shader cache: {}", e.what());
+                shaderFile = nullptr;
+            }
+        }
+
+        return shader;
+    }
+}
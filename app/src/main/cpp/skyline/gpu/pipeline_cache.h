@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <thread>
+#include <shared_mutex>
+#include <condition_variable>
+#include <vulkan/vulkan.hpp>
+#include <vfs/os_filesystem.h>
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief A persistent cache of host pipelines and translated guest shaders, this is preloaded from disk at boot so pipelines which were seen on a previous run don't stutter
+     * @note The VkPipelineCache exists from construction so pipelines can be created while the on-disk data is still being loaded, the loaded data is merged into it afterwards
+     */
+    class PipelineCache {
+      private:
+        const DeviceState &state;
+        GPU &gpu;
+        std::shared_ptr<vfs::OsFileSystem> cache; //!< The directory that the cache files are stored in, this is nullptr prior to Load() or if it couldn't be created
+        std::thread loadThread; //!< The thread that loads the on-disk caches, this is joined prior to saving
+        std::shared_mutex pipelineMutex; //!< Synchronizes merging into and reading vkPipelineCache with pipelines being created from it, the latter is internally synchronized by the driver
+        vk::UniquePipelineCache vkPipelineCache;
+
+        std::mutex shaderMutex; //!< Synchronizes access to shaders, shaderFile, shaderFileSize and shadersLoading
+        std::condition_variable shaderCondition; //!< Signalled once the shader cache has been loaded from disk
+        bool shadersLoading{}; //!< If the on-disk shader cache is being loaded, shaders aren't looked up until it's done as they might be in it
+        std::unordered_map<u64, std::shared_ptr<const std::vector<u32>>> shaders; //!< A map from the key of a guest shader to the SPIR-V it was translated into
+        std::shared_ptr<vfs::Backing> shaderFile; //!< The on-disk shader cache, new shaders are appended to it as they're stored
+        size_t shaderFileSize{}; //!< The offset in shaderFile that the next shader is appended at
+
+        /**
+         * @brief The header of VkPipelineCache data as defined by the Vulkan specification
+         */
+        struct VulkanCacheHeader {
+            u32 size; //!< The size of the header in bytes
+            u32 version; //!< The version of the header, this is VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            u32 vendorId;
+            u32 deviceId;
+            std::array<u8, VK_UUID_SIZE> uuid; //!< The pipeline cache UUID of the driver which created the data
+        };
+
+        /**
+         * @brief The header of the on-disk pipeline cache, the VkPipelineCache data follows it
+         * @note The header is written after the data so an interrupted write never results in a valid cache file
+         */
+        struct PipelineCacheHeader {
+            u32 magic; //!< The magic of the cache, this is PipelineCacheMagic
+            u32 _pad_;
+            u64 size; //!< The size of the VkPipelineCache data in bytes
+        };
+
+        /**
+         * @brief The header of the on-disk shader cache, entries of a ShaderEntry followed by the SPIR-V of the shader follow it
+         */
+        struct ShaderCacheHeader {
+            u32 magic; //!< The magic of the cache, this is ShaderCacheMagic
+            u32 version; //!< The version of the cache, this is ShaderCacheVersion
+        };
+
+        struct ShaderEntry {
+            u64 key; //!< The key of the guest shader from GetShaderKey()
+            u32 size; //!< The size of the SPIR-V in words
+            u32 _pad_;
+        };
+
+        static constexpr u32 PipelineCacheMagic{util::MakeMagic<u32>("SPLC")};
+        static constexpr u32 ShaderCacheMagic{util::MakeMagic<u32>("SSHC")};
+        static constexpr u32 ShaderCacheVersion{1}; //!< The version of the shader cache, this must be incremented whenever the shader translation changes so stale shaders are discarded
+        static constexpr const char *PipelineCacheName{"pipeline_cache.bin"};
+        static constexpr const char *ShaderCacheName{"shader_cache.bin"};
+
+        /**
+         * @brief The entry point of loadThread, this loads both of the on-disk caches
+         */
+        void LoadThread();
+
+        /**
+         * @brief Loads the on-disk VkPipelineCache data and merges it into vkPipelineCache, the data is discarded if it's from a different device or driver
+         */
+        void LoadPipelines();
+
+        /**
+         * @brief Loads all translated shaders from the on-disk shader cache and opens it for appending new shaders
+         */
+        void LoadShaders();
+
+      public:
+        PipelineCache(const DeviceState &state, GPU &gpu);
+
+        ~PipelineCache();
+
+        /**
+         * @brief Starts loading the on-disk caches in the supplied directory on a background thread
+         * @note This must not be called more than once
+         */
+        void Load(const std::string &path);
+
+        /**
+         * @brief Writes the contents of vkPipelineCache to disk, translated shaders don't need to be saved as they're written as they're stored
+         */
+        void Save();
+
+        /**
+         * @return A compute pipeline created with the cache
+         */
+        vk::UniquePipeline CreateComputePipeline(const vk::ComputePipelineCreateInfo &createInfo);
+
+        /**
+         * @return A graphics pipeline created with the cache
+         */
+        vk::UniquePipeline CreateGraphicsPipeline(const vk::GraphicsPipelineCreateInfo &createInfo);
+
+        /**
+         * @param code The guest shader code
+         * @param translationState Any state that affects the translation of the shader, such as the relevant Maxwell3D registers
+         * @return A key which uniquely identifies the translation of a guest shader, this is stable across runs
+         */
+        static u64 GetShaderKey(span<u8> code, span<u8> translationState);
+
+        /**
+         * @return The SPIR-V of the guest shader with the supplied key or nullptr if it hasn't been translated before
+         * @note This waits for the on-disk shader cache to be loaded if it's still being loaded
+         */
+        std::shared_ptr<const std::vector<u32>> LookupShader(u64 key);
+
+        /**
+         * @brief Stores the SPIR-V that a guest shader was translated into, this is written to the on-disk shader cache immediately
+         * @return The stored SPIR-V, this is the previously stored SPIR-V if another thread stored the same shader first
+         */
+        std::shared_ptr<const std::vector<u32>> StoreShader(u64 key, std::vector<u32> spirv);
+    };
+}
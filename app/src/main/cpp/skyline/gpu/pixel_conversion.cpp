@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <arm_neon.h>
+#include "pixel_conversion.h"
+
+namespace skyline::gpu::texture {
+    PixelConversion GetPixelConversion(Format format) {
+        if (format == format::BGRA8888Unorm)
+            return PixelConversion::Bgra8;
+        else if (format == format::RGBA16Float)
+            return PixelConversion::Rgba16Float;
+        else if (format == format::RGB10A2Unorm)
+            return PixelConversion::Rgb10a2;
+        return PixelConversion::None;
+    }
+
+    Format GetPresentableFormat(Format format) {
+        return GetPixelConversion(format) == PixelConversion::None ? format : format::RGBA8888Unorm;
+    }
+
+    /**
+     * @return A single RGB10A2Unorm pixel converted into RGBA8888Unorm
+     */
+    static constexpr u32 ConvertRgb10a2(u32 pixel) {
+        return ((pixel >> 2) & 0xFF) | (((pixel >> 12) & 0xFF) << 8) | (((pixel >> 22) & 0xFF) << 16) | (((pixel >> 30) * 0x55) << 24); // The 2-bit alpha is expanded by repeating it
+    }
+
+    /**
+     * @return Four RGBA16Float channels converted into RGBA8888Unorm channels
+     */
+    static FORCE_INLINE uint32x4_t ConvertHalfChannels(float16x4_t channels) {
+        auto values{vminq_f32(vmaxq_f32(vcvt_f32_f16(channels), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f))};
+        return vcvtnq_u32_f32(vmulq_n_f32(values, 255.0f));
+    }
+
+    void ConvertPixels(PixelConversion conversion, const u8 *input, u8 *output, size_t pixels) {
+        size_t pixel{};
+        switch (conversion) {
+            case PixelConversion::None:
+                throw exception("Cannot convert pixels without a conversion as their size isn't known");
+
+            case PixelConversion::Bgra8:
+                // The channels of 16 pixels are deinterleaved into separate registers, so swapping two channels is only a matter of storing them in the other order
+                for (; pixel + 16 <= pixels; pixel += 16) {
+                    auto channels{vld4q_u8(input + pixel * 4)};
+                    std::swap(channels.val[0], channels.val[2]);
+                    vst4q_u8(output + pixel * 4, channels);
+                }
+                for (; pixel < pixels; pixel++) {
+                    std::array<u8, 4> channels;
+                    std::memcpy(channels.data(), input + pixel * 4, sizeof(channels));
+                    std::swap(channels[0], channels[2]);
+                    std::memcpy(output + pixel * 4, channels.data(), sizeof(channels));
+                }
+                break;
+
+            case PixelConversion::Rgba16Float:
+                // Every iteration converts 4 pixels, their 16 channels are narrowed from 32-bit integers into bytes in two steps
+                for (; pixel + 4 <= pixels; pixel += 4) {
+                    auto first{vreinterpretq_f16_u16(vld1q_u16(reinterpret_cast<const u16 *>(input + pixel * 8)))};
+                    auto second{vreinterpretq_f16_u16(vld1q_u16(reinterpret_cast<const u16 *>(input + pixel * 8 + 16)))};
+                    auto low{vcombine_u16(vmovn_u32(ConvertHalfChannels(vget_low_f16(first))), vmovn_u32(ConvertHalfChannels(vget_high_f16(first))))};
+                    auto high{vcombine_u16(vmovn_u32(ConvertHalfChannels(vget_low_f16(second))), vmovn_u32(ConvertHalfChannels(vget_high_f16(second))))};
+                    vst1q_u8(output + pixel * 4, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+                }
+                for (; pixel < pixels; pixel++) {
+                    auto channels{ConvertHalfChannels(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const u16 *>(input + pixel * 8))))};
+                    u32 result{vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(vmovn_u32(channels), vdup_n_u16(0)))), 0)};
+                    std::memcpy(output + pixel * 4, &result, sizeof(result));
+                }
+                break;
+
+            case PixelConversion::Rgb10a2: {
+                auto mask{vdupq_n_u32(0xFF)};
+                for (; pixel + 4 <= pixels; pixel += 4) {
+                    auto values{vld1q_u32(reinterpret_cast<const u32 *>(input + pixel * 4))};
+                    auto red{vandq_u32(vshrq_n_u32(values, 2), mask)};
+                    auto green{vshlq_n_u32(vandq_u32(vshrq_n_u32(values, 12), mask), 8)};
+                    auto blue{vshlq_n_u32(vandq_u32(vshrq_n_u32(values, 22), mask), 16)};
+                    auto alpha{vshlq_n_u32(vmulq_n_u32(vshrq_n_u32(values, 30), 0x55), 24)};
+                    vst1q_u32(reinterpret_cast<u32 *>(output + pixel * 4), vorrq_u32(vorrq_u32(red, green), vorrq_u32(blue, alpha)));
+                }
+                for (; pixel < pixels; pixel++) {
+                    u32 value;
+                    std::memcpy(&value, input + pixel * 4, sizeof(value));
+                    value = ConvertRgb10a2(value);
+                    std::memcpy(output + pixel * 4, &value, sizeof(value));
+                }
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "format.h"
+
+namespace skyline::gpu::texture {
+    /**
+     * @brief The conversions of pixels into a format which Android surfaces support, the values match the conversion modes of shaders/block_linear.comp
+     */
+    enum class PixelConversion : u32 {
+        None = 0, //!< The format is supported directly and the pixels are copied unmodified
+        Bgra8 = 1, //!< BGRA8888Unorm into RGBA8888Unorm by swapping the red and blue channels
+        Rgba16Float = 2, //!< RGBA16Float into RGBA8888Unorm by clamping every channel to [0, 1], this halves the size of every pixel
+        Rgb10a2 = 3, //!< RGB10A2Unorm into RGBA8888Unorm by truncating every channel to 8 bits
+    };
+
+    /**
+     * @return The conversion that's required to present a surface of the supplied format
+     */
+    PixelConversion GetPixelConversion(Format format);
+
+    /**
+     * @return The format which a surface of the supplied format is presented in, this is the format itself if no conversion is required
+     */
+    Format GetPresentableFormat(Format format);
+
+    /**
+     * @brief Converts tightly packed pixels with NEON
+     * @param conversion The conversion to apply, this can't be PixelConversion::None
+     * @param pixels The amount of pixels to convert
+     * @note The output may overlap the input as long as it doesn't start after it, as no conversion increases the size of a pixel
+     */
+    void ConvertPixels(PixelConversion conversion, const u8 *input, u8 *output, size_t pixels);
+}
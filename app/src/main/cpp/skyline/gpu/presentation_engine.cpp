@@ -0,0 +1,535 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <android/choreographer.h>
+#include <android/looper.h>
+#include <gpu.h>
+#include <kernel/types/KProcess.h>
+#include "presentation_engine.h"
+
+namespace skyline::gpu {
+    PresentationEngine::PresentationEngine(const DeviceState &state, GPU &gpu) : state(state), gpu(gpu), displayTiming(gpu.vkDisplayTiming), deswizzlePipeline(gpu, FrameCount), compositePipeline(gpu, MaxLayerCount) {
+        auto &device{*gpu.vkDevice};
+
+        commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eResetCommandBuffer, gpu.vkQueueFamilyIndex});
+        auto commandBuffers{device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{*commandPool, vk::CommandBufferLevel::ePrimary, FrameCount + 1})};
+        importCommandBuffer = std::move(commandBuffers[FrameCount]);
+        importFence = device.createFenceUnique(vk::FenceCreateInfo{});
+        for (size_t index{}; index < FrameCount; index++) {
+            auto &frame{frames[index]};
+            frame.commandBuffer = std::move(commandBuffers[index]);
+            frame.fence = device.createFenceUnique(vk::FenceCreateInfo{vk::FenceCreateFlagBits::eSignaled});
+            frame.acquireSemaphore = device.createSemaphoreUnique(vk::SemaphoreCreateInfo{});
+            frame.presentSemaphore = device.createSemaphoreUnique(vk::SemaphoreCreateInfo{});
+            frame.deswizzleDescriptorSet = deswizzlePipeline.AllocateDescriptorSet();
+        }
+
+        vk::BufferCreateInfo bufferInfo{};
+        bufferInfo.size = StagingSize;
+        bufferInfo.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eStorageBuffer;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        stagingBuffer = device.createBufferUnique(bufferInfo);
+
+        auto requirements{device.getBufferMemoryRequirements(*stagingBuffer)};
+        auto memoryProperties{gpu.vkPhysicalDevice.getMemoryProperties()};
+        constexpr vk::MemoryPropertyFlags StagingMemoryFlags{vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent};
+
+        std::optional<u32> memoryType;
+        for (u32 index{}; index < memoryProperties.memoryTypeCount; index++) {
+            if ((requirements.memoryTypeBits & (1U << index)) && (memoryProperties.memoryTypes[index].propertyFlags & StagingMemoryFlags) == StagingMemoryFlags) {
+                memoryType = index;
+                break;
+            }
+        }
+        if (!memoryType)
+            throw exception("Cannot find a host-visible and host-coherent memory type for the staging ring");
+
+        stagingMemory = device.allocateMemoryUnique(vk::MemoryAllocateInfo{requirements.size, *memoryType});
+        device.bindBufferMemory(*stagingBuffer, *stagingMemory, 0);
+        stagingMapping = static_cast<u8 *>(device.mapMemory(*stagingMemory, 0, StagingSize));
+
+        choreographerThread = std::thread(&PresentationEngine::ChoreographerThread, this);
+    }
+
+    PresentationEngine::~PresentationEngine() {
+        choreographerStop = true;
+        while (!choreographerLooper)
+            std::this_thread::yield(); // The looper has to be prepared by the thread prior to it being woken up
+        ALooper_wake(choreographerLooper);
+        choreographerThread.join();
+
+        {
+            std::lock_guard guard(gpu.queueMutex); // Waiting on the device requires access to its queues to be synchronized
+            gpu.vkDevice->waitIdle();
+        }
+        gpu.vkDevice->unmapMemory(*stagingMemory);
+
+        // The swapchain and surface have to be destroyed prior to the window they were created from being released, views of the swapchain images have to be destroyed prior to the swapchain
+        framebuffers.clear();
+        swapchainViews.clear();
+        swapchain.reset();
+        surface.reset();
+        if (window)
+            ANativeWindow_release(window);
+    }
+
+    void PresentationEngine::UpdateSurface(ANativeWindow *newWindow) {
+        {
+            std::lock_guard guard(gpu.queueMutex);
+            gpu.vkDevice->waitIdle();
+        }
+
+        framebuffers.clear();
+        swapchainViews.clear();
+        swapchainImages.clear();
+        swapchain.reset();
+        surface.reset();
+        swapchainExtent = {};
+        scaleExtent = {};
+        if (window)
+            ANativeWindow_release(window);
+        window = newWindow;
+
+        vk::AndroidSurfaceCreateInfoKHR createInfo{};
+        createInfo.window = window;
+        surface = gpu.vkInstance->createAndroidSurfaceKHRUnique(createInfo);
+
+        if (!gpu.vkPhysicalDevice.getSurfaceSupportKHR(gpu.vkQueueFamilyIndex, *surface))
+            throw exception("The queue family 0x{:X} cannot present to the surface", gpu.vkQueueFamilyIndex);
+    }
+
+    void PresentationEngine::RecreateSwapchain(texture::Dimensions guestExtent, vk::Format format) {
+        auto &device{*gpu.vkDevice};
+        {
+            std::lock_guard guard(gpu.queueMutex);
+            device.waitIdle(); // The images of the current swapchain might still be used by in-flight frames
+        }
+        framebuffers.clear();
+        swapchainViews.clear();
+
+        auto extent{gpu.ScaleDimensions(guestExtent)};
+
+        auto capabilities{gpu.vkPhysicalDevice.getSurfaceCapabilitiesKHR(*surface)};
+        if (!(capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst))
+            throw exception("The surface doesn't support its images being written to by transfers");
+        if (extent.width < capabilities.minImageExtent.width || extent.height < capabilities.minImageExtent.height || extent.width > capabilities.maxImageExtent.width || extent.height > capabilities.maxImageExtent.height)
+            throw exception("The surface doesn't support an extent of {}x{}", extent.width, extent.height);
+
+        auto surfaceFormats{gpu.vkPhysicalDevice.getSurfaceFormatsKHR(*surface)};
+        auto surfaceFormat{std::find_if(surfaceFormats.begin(), surfaceFormats.end(), [format](const vk::SurfaceFormatKHR &surfaceFormat) { return surfaceFormat.format == format; })};
+        if (surfaceFormat == surfaceFormats.end())
+            throw exception("The surface doesn't support the format: {}", vk::to_string(format));
+
+        // Frames are paced by their desired presentation time when display timing is supported, so FIFO is used to never drop any of them
+        // Otherwise, mailbox is preferred as it doesn't block presentation on the display while still never tearing
+        auto presentModes{gpu.vkPhysicalDevice.getSurfacePresentModesKHR(*surface)};
+        auto presentMode{vk::PresentModeKHR::eFifo};
+        if (!displayTiming && std::find(presentModes.begin(), presentModes.end(), vk::PresentModeKHR::eMailbox) != presentModes.end())
+            presentMode = vk::PresentModeKHR::eMailbox;
+
+        vk::SwapchainCreateInfoKHR createInfo{};
+        createInfo.surface = *surface;
+        createInfo.minImageCount = capabilities.maxImageCount ? std::clamp(3U, capabilities.minImageCount, capabilities.maxImageCount) : std::max(3U, capabilities.minImageCount);
+        createInfo.imageFormat = format;
+        createInfo.imageColorSpace = surfaceFormat->colorSpace;
+        createInfo.imageExtent = vk::Extent2D{extent.width, extent.height};
+        createInfo.imageArrayLayers = 1;
+        createInfo.imageUsage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eColorAttachment;
+        createInfo.imageSharingMode = vk::SharingMode::eExclusive;
+        createInfo.preTransform = (capabilities.supportedTransforms & vk::SurfaceTransformFlagBitsKHR::eIdentity) ? vk::SurfaceTransformFlagBitsKHR::eIdentity : capabilities.currentTransform;
+        createInfo.compositeAlpha = (capabilities.supportedCompositeAlpha & vk::CompositeAlphaFlagBitsKHR::eOpaque) ? vk::CompositeAlphaFlagBitsKHR::eOpaque : vk::CompositeAlphaFlagBitsKHR::eInherit;
+        createInfo.presentMode = presentMode;
+        createInfo.clipped = true;
+        createInfo.oldSwapchain = *swapchain;
+
+        swapchain = device.createSwapchainKHRUnique(createInfo);
+        swapchainImages = device.getSwapchainImagesKHR(*swapchain);
+        swapchainExtent = extent;
+        swapchainFormat = format;
+        scaleExtent = guestExtent;
+
+        compositePipeline.SetFormat(format);
+        for (auto image : swapchainImages) {
+            swapchainViews.push_back(device.createImageViewUnique(vk::ImageViewCreateInfo{{}, image, vk::ImageViewType::e2D, format, {}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}}));
+            framebuffers.push_back(device.createFramebufferUnique(vk::FramebufferCreateInfo{{}, compositePipeline.GetRenderPass(), 1, &*swapchainViews.back(), extent.width, extent.height, 1}));
+        }
+
+        if (displayTiming)
+            refreshDuration = device.getRefreshCycleDurationGOOGLE(*swapchain, gpu.vkDispatch).refreshDuration;
+    }
+
+    PresentationEngine::LayerImage &PresentationEngine::GetLayerImage(u64 layerId, texture::Dimensions extent, vk::Format format) {
+        auto &layerImage{layerImages[layerId]};
+        if (layerImage.image && layerImage.extent == extent && layerImage.format == format)
+            return layerImage;
+
+        auto &device{*gpu.vkDevice};
+        if (layerImage.image) {
+            {
+                std::lock_guard guard(gpu.queueMutex);
+                device.waitIdle(); // The previous image might still be sampled by in-flight frames
+            }
+            layerImage.descriptorSet.reset();
+            layerImage.view.reset();
+            layerImage.image.reset();
+            layerImage.memory.reset();
+        }
+
+        auto formatFeatures{gpu.vkPhysicalDevice.getFormatProperties(format).optimalTilingFeatures};
+        if (!(formatFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+            throw exception("Cannot composite frames with the format: {}", vk::to_string(format));
+
+        vk::ImageCreateInfo imageInfo{};
+        imageInfo.imageType = vk::ImageType::e2D;
+        imageInfo.format = format;
+        imageInfo.extent = vk::Extent3D{extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling = vk::ImageTiling::eOptimal;
+        imageInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+        imageInfo.sharingMode = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+        layerImage.image = device.createImageUnique(imageInfo);
+
+        auto requirements{device.getImageMemoryRequirements(*layerImage.image)};
+        auto memoryProperties{gpu.vkPhysicalDevice.getMemoryProperties()};
+        std::optional<u32> memoryType;
+        for (u32 index{}; index < memoryProperties.memoryTypeCount; index++) {
+            if ((requirements.memoryTypeBits & (1U << index)) && (memoryProperties.memoryTypes[index].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+                memoryType = index;
+                break;
+            }
+        }
+        if (!memoryType)
+            throw exception("Cannot find a device-local memory type for the image of a layer");
+
+        layerImage.memory = device.allocateMemoryUnique(vk::MemoryAllocateInfo{requirements.size, *memoryType});
+        device.bindImageMemory(*layerImage.image, *layerImage.memory, 0);
+
+        layerImage.view = device.createImageViewUnique(vk::ImageViewCreateInfo{{}, *layerImage.image, vk::ImageViewType::e2D, format, {}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}});
+        layerImage.descriptorSet = compositePipeline.AllocateDescriptorSet(*layerImage.view, static_cast<bool>(formatFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear));
+        layerImage.extent = extent;
+        layerImage.format = format;
+        layerImage.valid = false;
+        return layerImage;
+    }
+
+    std::vector<u64> PresentationEngine::GetLayerStack() {
+        std::vector<std::pair<i64, u64>> visibleLayers;
+        {
+            std::lock_guard guard(layerMutex);
+            for (const auto &[layerId, properties] : layers)
+                if (properties.visible)
+                    visibleLayers.emplace_back(properties.z, layerId);
+        }
+
+        // Layer IDs are increasing, so sorting by the ID after the Z order puts layers which were created later above others with the same Z
+        std::sort(visibleLayers.begin(), visibleLayers.end());
+
+        std::vector<u64> stack;
+        stack.reserve(visibleLayers.size());
+        for (const auto &layer : visibleLayers)
+            stack.push_back(layer.second);
+        return stack;
+    }
+
+    bool PresentationEngine::IsBaseLayer(u64 layerId, const std::vector<u64> &stack) {
+        auto base{std::find_if(stack.begin(), stack.end(), [&](u64 id) {
+            if (id == layerId)
+                return true;
+            auto layerImage{layerImages.find(id)};
+            return layerImage != layerImages.end() && layerImage->second.valid;
+        })};
+        return base != stack.end() && *base == layerId;
+    }
+
+    size_t PresentationEngine::AllocateStaging(size_t size) {
+        size = util::AlignUp(size, StagingAlignment);
+        if (size > StagingSize)
+            throw exception("A frame of 0x{:X} bytes doesn't fit into the staging ring", size);
+
+        auto offset{stagingOffset};
+        if (offset + size > StagingSize)
+            offset = 0; // The ring wraps around rather than splitting the allocation
+
+        for (auto &frame : frames) {
+            if (frame.stagingSize && offset < frame.stagingOffset + frame.stagingSize && frame.stagingOffset < offset + size) {
+                static_cast<void>(gpu.vkDevice->waitForFences(*frame.fence, true, std::numeric_limits<u64>::max()));
+                frame.stagingSize = 0;
+            }
+        }
+
+        stagingOffset = offset + size;
+        return offset;
+    }
+
+    void PresentationEngine::UpdatePresentationTiming() {
+        for (const auto &timing : gpu.vkDevice->getPastPresentationTimingGOOGLE(*swapchain, gpu.vkDispatch)) {
+            if (timing.actualPresentTime > lastPresentTime) {
+                lastPresentTime = timing.actualPresentTime;
+                lastPresentId = timing.presentID;
+            }
+        }
+    }
+
+    void PresentationEngine::SetLayer(u64 layerId, LayerProperties properties) {
+        std::lock_guard guard(layerMutex);
+        layers[layerId] = properties;
+    }
+
+    void PresentationEngine::RemoveLayer(u64 layerId) {
+        std::lock_guard guard(layerMutex);
+        if (layers.erase(layerId))
+            removedLayers.push_back(layerId);
+    }
+
+    bool PresentationEngine::IsBaseLayer(u64 layerId) {
+        return IsBaseLayer(layerId, GetLayerStack());
+    }
+
+    bool PresentationEngine::Present(u64 layerId, const std::shared_ptr<PresentationTexture> &texture) {
+        auto &device{*gpu.vkDevice};
+
+        std::vector<u64> removed;
+        {
+            std::lock_guard guard(layerMutex);
+            removed.swap(removedLayers);
+        }
+        if (!removed.empty()) {
+            {
+                std::lock_guard guard(gpu.queueMutex);
+                device.waitIdle(); // The images of removed layers might still be sampled by in-flight frames
+            }
+            for (auto id : removed)
+                layerImages.erase(id);
+        }
+
+        auto stack{GetLayerStack()};
+        if (std::find(stack.begin(), stack.end(), layerId) == stack.end()) {
+            // Frames of hidden layers are discarded, so the image of the layer is out of date once it's visible again
+            auto layerImage{layerImages.find(layerId)};
+            if (layerImage != layerImages.end())
+                layerImage->second.valid = false;
+            return false;
+        }
+        auto present{IsBaseLayer(layerId, stack)};
+
+        // Formats which Android surfaces don't support are converted into one that they do while the frame is deswizzled or copied
+        auto presentableFormat{texture->GetPresentableFormat()};
+        auto conversion{texture::GetPixelConversion(texture->format)};
+        if (present && (!swapchain || texture->dimensions != scaleExtent || presentableFormat.vkFormat != swapchainFormat))
+            RecreateSwapchain(texture->dimensions, presentableFormat.vkFormat);
+
+        // A lone visible layer which isn't scaled is copied onto the swapchain image directly as compositing it would be a redundant pass, its image is out of date after this
+        auto direct{present && stack.size() == 1 && swapchainExtent == texture->dimensions};
+        LayerImage *layerImage{};
+        if (!direct) {
+            layerImage = &GetLayerImage(layerId, texture->dimensions, presentableFormat.vkFormat);
+        } else if (auto existing{layerImages.find(layerId)}; existing != layerImages.end()) {
+            existing->second.valid = false;
+        }
+
+        auto &frame{frames[frameIndex]};
+        frameIndex = (frameIndex + 1) % FrameCount;
+        static_cast<void>(device.waitForFences(*frame.fence, true, std::numeric_limits<u64>::max()));
+        frame.stagingSize = 0;
+
+        auto hostStride{texture->GetHostStride()};
+        auto hostSize{texture->GetHostSize()};
+        auto deswizzle{texture->guest->tileMode == texture::TileMode::Block};
+        vk::DeviceSize guestSize{}, hostOffset{};
+        std::optional<HostBuffer> guestBuffer;
+        if (deswizzle) {
+            guestSize = util::AlignUp(texture->GetGuestSize(), StagingAlignment);
+            auto guestPointer{state.process->GetPointer<u8>(texture->guest->address)};
+            if (util::IsAligned(reinterpret_cast<u64>(guestPointer), StagingAlignment))
+                guestBuffer = HostBuffer::Import(gpu, guestPointer, guestSize, vk::BufferUsageFlagBits::eStorageBuffer);
+
+            if (guestBuffer) {
+                // Block-linear frames are deswizzled directly from guest memory when it can be imported, so they aren't copied by the CPU at all
+                frame.stagingOffset = AllocateStaging(hostSize);
+                frame.stagingSize = hostSize;
+                hostOffset = frame.stagingOffset;
+
+                auto &commandBuffer{*importCommandBuffer};
+                commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+                deswizzlePipeline.Record(commandBuffer, frame.deswizzleDescriptorSet, *texture, *guestBuffer->buffer, guestBuffer->offset, guestSize, *stagingBuffer, hostOffset, hostSize, conversion);
+                commandBuffer.end();
+
+                vk::SubmitInfo submitInfo{};
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                device.resetFences(*importFence);
+                std::lock_guard guard(gpu.queueMutex);
+                gpu.vkQueue.submit(submitInfo, *importFence);
+            } else {
+                // Otherwise, they're uploaded with a single linear copy and deswizzled on the host GPU, so the CPU doesn't compete with guest threads for the conversion
+                frame.stagingOffset = AllocateStaging(guestSize + hostSize);
+                frame.stagingSize = guestSize + hostSize;
+                hostOffset = frame.stagingOffset + guestSize;
+                std::memcpy(stagingMapping + frame.stagingOffset, guestPointer, texture->GetGuestSize());
+            }
+        } else {
+            // Other frames are converted straight into the staging ring, so they're never copied through an intermediate host buffer
+            frame.stagingOffset = AllocateStaging(hostSize);
+            frame.stagingSize = hostSize;
+            hostOffset = frame.stagingOffset;
+            texture->SynchronizeHost(stagingMapping + hostOffset, true);
+        }
+
+        // A swapchain image is only acquired for frames which are presented, frames which are only retained don't wait on the display at all
+        u32 imageIndex{};
+        vk::Image image{};
+        if (present) {
+            while (true) {
+                try {
+                    imageIndex = device.acquireNextImageKHR(*swapchain, std::numeric_limits<u64>::max(), *frame.acquireSemaphore, {}).value;
+                    break;
+                } catch (const vk::OutOfDateKHRError &) {
+                    RecreateSwapchain(scaleExtent, swapchainFormat);
+                }
+            }
+            image = swapchainImages.at(imageIndex);
+        }
+
+        auto &commandBuffer{*frame.commandBuffer};
+        commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+        if (deswizzle) {
+            if (!guestBuffer)
+                deswizzlePipeline.Record(commandBuffer, frame.deswizzleDescriptorSet, *texture, *stagingBuffer, frame.stagingOffset, guestSize, *stagingBuffer, hostOffset, hostSize, conversion);
+
+            // The barrier also covers deswizzling from imported guest memory as it applies to all prior submissions to the queue
+            vk::MemoryBarrier deswizzleBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead};
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, deswizzleBarrier, {}, {});
+        }
+
+        // The image of a layer is overwritten entirely, so the barrier on it only has to wait on it being sampled by prior compositions
+        auto copyImage{direct ? image : *layerImage->image};
+        vk::ImageMemoryBarrier barrier{};
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.oldLayout = vk::ImageLayout::eUndefined;
+        barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copyImage;
+        barrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        commandBuffer.pipelineBarrier(direct ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+        vk::BufferImageCopy region{};
+        region.bufferOffset = hostOffset;
+        region.bufferRowLength = static_cast<u32>((hostStride / texture->format.bpb) * texture->format.blockWidth); // This is in pixels, so it's unaffected by any conversion changing the size of pixels
+        region.imageSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+        region.imageExtent = vk::Extent3D{texture->dimensions.width, texture->dimensions.height, 1};
+        commandBuffer.copyBufferToImage(*stagingBuffer, copyImage, vk::ImageLayout::eTransferDstOptimal, region);
+
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        if (direct) {
+            barrier.dstAccessMask = {};
+            barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+        } else {
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
+            layerImage->valid = true;
+
+            if (present) {
+                // Layers below this one have no frame yet, so they're skipped rather than drawn with undefined contents
+                std::vector<vk::DescriptorSet> descriptorSets;
+                for (auto id : stack) {
+                    auto stackImage{layerImages.find(id)};
+                    if (stackImage != layerImages.end() && stackImage->second.valid)
+                        descriptorSets.push_back(*stackImage->second.descriptorSet);
+                }
+                compositePipeline.Record(commandBuffer, *framebuffers.at(imageIndex), vk::Extent2D{swapchainExtent.width, swapchainExtent.height}, descriptorSets);
+            }
+        }
+
+        commandBuffer.end();
+
+        vk::PipelineStageFlags waitStage{direct ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eColorAttachmentOutput};
+        vk::SubmitInfo submitInfo{};
+        if (present) {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &*frame.acquireSemaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &*frame.presentSemaphore;
+        }
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        device.resetFences(*frame.fence);
+        {
+            std::lock_guard guard(gpu.queueMutex);
+            gpu.vkQueue.submit(submitInfo, *frame.fence);
+        }
+
+        if (present) {
+            vk::PresentInfoKHR presentInfo{};
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = &*frame.presentSemaphore;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = &*swapchain;
+            presentInfo.pImageIndices = &imageIndex;
+
+            presentId++;
+            vk::PresentTimeGOOGLE presentTime{};
+            vk::PresentTimesInfoGOOGLE presentTimes{};
+            if (displayTiming) {
+                UpdatePresentationTiming();
+
+                // Every frame is paced to swapInterval refresh cycles, this is extrapolated from the latest frame that the display reported the presentation time of
+                presentTime.presentID = presentId;
+                if (lastPresentTime)
+                    presentTime.desiredPresentTime = lastPresentTime + (static_cast<u64>(presentId - lastPresentId) * refreshDuration * swapInterval);
+
+                presentTimes.swapchainCount = 1;
+                presentTimes.pTimes = &presentTime;
+                presentInfo.pNext = &presentTimes;
+            }
+
+            try {
+                std::lock_guard guard(gpu.queueMutex);
+                static_cast<void>(gpu.vkQueue.presentKHR(presentInfo));
+            } catch (const vk::OutOfDateKHRError &) {
+                scaleExtent = {}; // The swapchain is recreated prior to presenting the next frame
+            }
+        }
+
+        // The guest texture is released back to the guest after this returns, so the device must be done reading from its memory by then
+        if (guestBuffer)
+            static_cast<void>(device.waitForFences(*importFence, true, std::numeric_limits<u64>::max()));
+
+        return present;
+    }
+
+    void PresentationEngine::SetSwapInterval(u32 interval) {
+        swapInterval = std::max(interval, 1U);
+    }
+
+    void PresentationEngine::ChoreographerThread() {
+        pthread_setname_np(pthread_self(), "Sky-Choreo");
+
+        choreographerLooper = ALooper_prepare(0);
+        AChoreographer_postFrameCallback(AChoreographer_getInstance(), &ChoreographerCallback, this);
+        while (!choreographerStop)
+            ALooper_pollOnce(-1, nullptr, nullptr, nullptr); // This is woken up either by callbacks or by ALooper_wake when the thread is being stopped
+    }
+
+    void PresentationEngine::ChoreographerCallback(long frameTimeNanos, void *data) {
+        auto engine{reinterpret_cast<PresentationEngine *>(data)};
+
+        // The guest is expected to wait for swapInterval refreshes between every frame, so vsync is only signalled on every swapInterval-th refresh
+        if (++engine->vsyncRefreshes >= engine->swapInterval) {
+            engine->vsyncRefreshes = 0;
+            engine->gpu.vsyncEvent->Signal();
+        }
+
+        if (!engine->choreographerStop)
+            AChoreographer_postFrameCallback(AChoreographer_getInstance(), &ChoreographerCallback, engine);
+    }
+}
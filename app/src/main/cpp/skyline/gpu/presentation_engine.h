@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <android/native_window.h>
+#include <android/looper.h>
+#include "texture.h"
+#include "deswizzle_pipeline.h"
+#include "composite_pipeline.h"
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief The PresentationEngine presents guest frames on the Android surface through a Vulkan swapchain, it's also responsible for pacing frames and signalling the vsync event
+     * @note The vsync event is signalled from an AChoreographer frame callback on a dedicated thread, so it's aligned with the actual display refreshes
+     * @note Frames are uploaded through a persistently mapped staging ring, block-linear frames are uploaded unmodified and deswizzled on the host GPU while others are converted into it directly
+     * @note Block-linear frames are deswizzled straight from guest memory when it can be imported into a HostBuffer, which avoids staging them entirely
+     * @note Frames are copied into a host image of their layer and all visible layers are composited onto the swapchain image at the host resolution by ascending Z order, a lone visible layer which isn't scaled is copied onto the swapchain image directly instead
+     * @note Only frames of the lowest visible layer are presented, frames of the layers above it are composited with its next frame so the display isn't paced by every layer
+     * @note Frames in formats which Android surfaces don't support are converted into RGBA8888Unorm while being deswizzled or copied, so they don't take another pass
+     */
+    class PresentationEngine {
+      private:
+        const DeviceState &state;
+        GPU &gpu;
+        ANativeWindow *window{}; //!< The ANativeWindow that the surface was created from
+        vk::UniqueSurfaceKHR surface;
+        vk::UniqueSwapchainKHR swapchain;
+        std::vector<vk::Image> swapchainImages;
+        texture::Dimensions swapchainExtent{}; //!< The extent of the swapchain images, this is the guest extent scaled by GPU::resolutionScale
+        vk::Format swapchainFormat{};
+        std::vector<vk::UniqueImageView> swapchainViews;
+        std::vector<vk::UniqueFramebuffer> framebuffers; //!< A framebuffer of the composition render pass for every swapchain image
+        texture::Dimensions scaleExtent{}; //!< The guest extent of frames of the lowest visible layer, this only differs from swapchainExtent when frames are scaled
+        bool displayTiming{}; //!< If VK_GOOGLE_display_timing is supported and enabled on the device
+        u32 presentId{}; //!< The ID of the last frame that was presented, this is used to match frames with their presentation timings
+        u64 lastPresentTime{}; //!< The time at which the latest frame with a known presentation timing was presented, on CLOCK_MONOTONIC
+        u32 lastPresentId{}; //!< The ID of the frame that was presented at lastPresentTime
+        u64 refreshDuration{}; //!< The duration of a single refresh cycle of the display in nanoseconds
+        std::atomic<u32> swapInterval{1}; //!< The amount of display refreshes that every guest frame is shown for
+        std::thread choreographerThread; //!< The thread that AChoreographer frame callbacks are run on
+        std::atomic<ALooper *> choreographerLooper{}; //!< The looper of choreographerThread, this is set once the thread has prepared it
+        std::atomic<bool> choreographerStop{}; //!< If choreographerThread should stop posting callbacks and exit
+        u32 vsyncRefreshes{}; //!< The amount of refreshes since the vsync event was last signalled, this is only accessed by choreographerThread
+
+        static constexpr size_t FrameCount{3}; //!< The maximum amount of frames that can be in flight at once
+        static constexpr size_t StagingSize{0x2000000}; //!< The size of the staging ring in bytes, this must be large enough for multiple frames at the maximum resolution
+        static constexpr size_t StagingAlignment{0x100}; //!< The alignment of every allocation from the staging ring, this satisfies the texel and buffer offset requirements of all formats
+
+        /**
+         * @brief The resources of a single frame which can't be reused until the device is done with the frame
+         */
+        struct Frame {
+            vk::UniqueCommandBuffer commandBuffer;
+            vk::UniqueFence fence; //!< Signalled once the device is done with the frame
+            vk::UniqueSemaphore acquireSemaphore; //!< Signalled once the swapchain image is available to be written to
+            vk::UniqueSemaphore presentSemaphore; //!< Signalled once the swapchain image has been written to and can be presented
+            vk::DescriptorSet deswizzleDescriptorSet; //!< The descriptor set used for deswizzling the frame, this is freed alongside deswizzlePipeline
+            size_t stagingOffset{}; //!< The offset of the frame's region in the staging ring
+            size_t stagingSize{}; //!< The size of the frame's region in the staging ring, this is 0 if the frame never used it
+        };
+
+        /**
+         * @brief A host copy of the latest frame of a layer, this is retained so the layer can be composited again when only other layers have queued frames
+         */
+        struct LayerImage {
+            texture::Dimensions extent{};
+            vk::Format format{};
+            vk::UniqueImage image;
+            vk::UniqueDeviceMemory memory;
+            vk::UniqueImageView view;
+            vk::UniqueDescriptorSet descriptorSet; //!< The descriptor set the layer is composited with, this is freed back to compositePipeline
+            bool valid{}; //!< If the image contains the latest frame of the layer, this is cleared when a frame of the layer isn't copied into it
+        };
+
+        DeswizzlePipeline deswizzlePipeline;
+        CompositePipeline compositePipeline;
+        std::unordered_map<u64, LayerImage> layerImages; //!< The images of all layers keyed by their ID, this is only accessed by the presentation thread
+        vk::UniqueCommandPool commandPool;
+        vk::UniqueCommandBuffer importCommandBuffer; //!< A command buffer for deswizzling frames from imported guest memory, this is submitted separately so it doesn't wait on the swapchain
+        vk::UniqueFence importFence; //!< Signalled once the device is done reading imported guest memory, this is waited on before the guest texture is released
+        std::array<Frame, FrameCount> frames;
+        size_t frameIndex{}; //!< The index of the next frame in frames
+        vk::UniqueBuffer stagingBuffer;
+        vk::UniqueDeviceMemory stagingMemory;
+        u8 *stagingMapping{}; //!< A persistent host mapping of stagingMemory
+        size_t stagingOffset{}; //!< The offset in the staging ring that the next allocation starts at
+
+      public:
+        static constexpr u32 MaxLayerCount{8}; //!< The maximum amount of layers that can be on the display at once
+
+        /**
+         * @brief The properties of a layer which are set by the guest, they determine if and in which order the layer is composited
+         */
+        struct LayerProperties {
+            i64 z{}; //!< The Z order of the layer, layers with a higher Z are composited over ones with a lower Z and the creation order of layers breaks ties
+            bool visible{true};
+        };
+
+      private:
+        std::mutex layerMutex; //!< Synchronizes access to layers and removedLayers
+        std::map<u64, LayerProperties> layers; //!< The properties of all layers on the display keyed by their ID, layer IDs increase in the order that layers are created
+        std::vector<u64> removedLayers; //!< The IDs of all layers which were removed since the last frame, their images are released by the presentation thread
+
+        /**
+         * @brief Recreates the swapchain for frames with the supplied dimensions and format, the previous swapchain is retired into the new one
+         * @param extent The guest extent of frames, the swapchain is at this extent scaled by GPU::resolutionScale
+         */
+        void RecreateSwapchain(texture::Dimensions extent, vk::Format format);
+
+        /**
+         * @return The image of a layer, it's recreated if frames of the layer have changed their extent or format
+         * @note The contents of the image are undefined after it's recreated
+         */
+        LayerImage &GetLayerImage(u64 layerId, texture::Dimensions extent, vk::Format format);
+
+        /**
+         * @return The IDs of all visible layers ordered from the lowest to the highest one
+         */
+        std::vector<u64> GetLayerStack();
+
+        /**
+         * @return If the layer is the lowest layer in the stack which has a frame, the layer is taken to have one as a frame of it is being presented
+         */
+        bool IsBaseLayer(u64 layerId, const std::vector<u64> &stack);
+
+        /**
+         * @brief Allocates a region of the staging ring, this waits on any in-flight frames which are still using the region
+         * @return The offset of the region in the staging ring
+         */
+        size_t AllocateStaging(size_t size);
+
+        /**
+         * @brief Updates lastPresentTime with any presentation timings that the display reported since the last call
+         */
+        void UpdatePresentationTiming();
+
+        /**
+         * @brief The entry point of choreographerThread, it runs the looper that AChoreographer callbacks are dispatched on
+         */
+        void ChoreographerThread();
+
+        /**
+         * @brief The AChoreographer frame callback, it's called on every refresh of the display and signals the vsync event
+         */
+        static void ChoreographerCallback(long frameTimeNanos, void *data);
+
+      public:
+        PresentationEngine(const DeviceState &state, GPU &gpu);
+
+        ~PresentationEngine();
+
+        /**
+         * @brief Replaces the surface which is presented to, this should be called when the Android Surface is changed
+         * @param newWindow The window to present to, the engine takes ownership of the caller's reference to it
+         */
+        void UpdateSurface(ANativeWindow *newWindow);
+
+        /**
+         * @brief Adds a layer to the display or updates the properties of an existing one
+         */
+        void SetLayer(u64 layerId, LayerProperties properties);
+
+        /**
+         * @brief Removes a layer from the display, any frames of it which are still queued are discarded
+         */
+        void RemoveLayer(u64 layerId);
+
+        /**
+         * @return If frames of the layer are presented rather than only being retained for compositing the frames of a lower layer
+         * @note This must only be called from the presentation thread
+         */
+        bool IsBaseLayer(u64 layerId);
+
+        /**
+         * @brief Converts a frame of a layer into the staging ring and either queues a composition of all visible layers for presentation on the next suitable refresh or retains it for the next composition
+         * @return If the frame was presented, frames of hidden layers are discarded and frames of layers above the lowest visible one are only retained
+         * @note The guest texture isn't accessed after this returns, so it can be released back to the guest immediately
+         */
+        bool Present(u64 layerId, const std::shared_ptr<PresentationTexture> &texture);
+
+        /**
+         * @brief Sets the amount of display refreshes every guest frame should be shown for, this affects both frame pacing and the rate of the vsync event
+         * @param interval The swap interval supplied by the guest, an interval of 0 is treated as 1
+         */
+        void SetSwapInterval(u32 interval);
+
+        /**
+         * @return The duration that every guest frame is shown for in nanoseconds, this assumes a 60Hz display if its refresh duration isn't known
+         */
+        u64 GetFrameDuration() {
+            constexpr u64 DefaultRefreshDuration{16666667}; // The refresh duration of a 60Hz display
+            return (refreshDuration ? refreshDuration : DefaultRefreshDuration) * swapInterval.load(std::memory_order_relaxed);
+        }
+    };
+}
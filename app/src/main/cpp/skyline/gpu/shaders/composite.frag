@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#version 450
+
+// Samples the latest frame of a layer, it's stretched across the framebuffer and blending with the layers below it is done by the pipeline
+layout(set = 0, binding = 0) uniform sampler2D layer;
+
+layout(location = 0) in vec2 coordinates;
+layout(location = 0) out vec4 color;
+
+void main() {
+    color = texture(layer, coordinates);
+}
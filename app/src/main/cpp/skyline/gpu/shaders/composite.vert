@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#version 450
+
+// Draws a single triangle which covers the entire framebuffer, the texture coordinates span [0, 1] across the part of it which is visible
+layout(location = 0) out vec2 coordinates;
+
+void main() {
+    coordinates = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(coordinates * 2.0 - 1.0, 0.0, 1.0);
+}
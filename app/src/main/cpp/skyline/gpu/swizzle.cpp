@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <thread_pool.h>
+#include "swizzle.h"
+
+namespace skyline::gpu::texture {
+    /**
+     * @return The amount of multiples of the divisor required to cover the value, this doesn't require the divisor to be a power of 2 as the widths of ASTC blocks aren't
+     */
+    static constexpr u32 DivideCeil(u32 value, u32 divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+
+    BlockLinearSwizzle::BlockLinearSwizzle(u32 width, u32 height, u32 depth, u32 blockHeight, u32 blockDepth) : stride(util::AlignUp(width, GobWidth)), lines(height), robHeight(GobHeight * blockHeight) {
+        auto blockSize{GobSize * blockHeight * blockDepth}; // The size of a single block in bytes
+        auto robWidthBlocks{stride / GobWidth}; // The width of a ROB in blocks, a block is a single GOB wide
+        auto robSize{static_cast<size_t>(robWidthBlocks) * blockSize}; // The size of a ROB of a single Z-axis block in bytes
+        auto sliceSize{robSize * DivideCeil(lines, robHeight)}; // The size of a slice of blocks in bytes, this spans blockDepth slices of the level
+        size = sliceSize * DivideCeil(depth, blockDepth);
+
+        sectorOffsets.resize(stride / SectorWidth);
+        for (u32 sector{}; sector < sectorOffsets.size(); sector++)
+            sectorOffsets[sector] = ((sector / GobSectorOffsets.size()) * blockSize) + GobSectorOffsets[sector % GobSectorOffsets.size()];
+
+        lineOffsets.resize(lines);
+        for (u32 line{}; line < lines; line++)
+            lineOffsets[line] = static_cast<u32>(((line / robHeight) * robSize) + (((line % robHeight) / GobHeight) * GobSize) + GobLineOffsets[line % GobHeight]);
+
+        // The Z-axis GOBs of a block follow all of its Y-axis GOBs
+        sliceOffsets.resize(depth);
+        for (u32 slice{}; slice < depth; slice++)
+            sliceOffsets[slice] = ((slice / blockDepth) * sliceSize) + ((slice % blockDepth) * blockHeight * GobSize);
+    }
+
+    template<bool ToBlockLinear>
+    void BlockLinearSwizzle::Copy(u8 *blockLinear, u8 *linear, u32 slice, u32 firstLine, u32 lineCount) const {
+        blockLinear += sliceOffsets[slice];
+        linear += ((static_cast<size_t>(slice) * lines) + firstLine) * stride;
+
+        for (u32 line{firstLine}; line < firstLine + lineCount; line++) {
+            auto blockLinearLine{blockLinear + lineOffsets[line]};
+            for (auto sectorOffset : sectorOffsets) {
+                if constexpr (ToBlockLinear)
+                    std::memcpy(blockLinearLine + sectorOffset, linear, SectorWidth);
+                else
+                    std::memcpy(linear, blockLinearLine + sectorOffset, SectorWidth);
+                linear += SectorWidth;
+            }
+        }
+    }
+
+    template void BlockLinearSwizzle::Copy<true>(u8 *, u8 *, u32, u32, u32) const;
+    template void BlockLinearSwizzle::Copy<false>(u8 *, u8 *, u32, u32, u32) const;
+
+    BlockLinearSurface::BlockLinearSurface(Format format, Dimensions dimensions, TileConfig tileConfig, u32 layerCount, u32 levelCount) : layerCount(std::max(layerCount, 1U)) {
+        auto width{tileConfig.surfaceWidth ? tileConfig.surfaceWidth : dimensions.width};
+        auto height{dimensions.height};
+        auto depth{std::max(dimensions.depth, 1U)};
+        u32 blockHeight{std::max<u32>(tileConfig.blockHeight, 1)}, blockDepth{std::max<u32>(tileConfig.blockDepth, 1)};
+        size_t blockSize{static_cast<size_t>(GobSize) * blockHeight * blockDepth}; // The size of a block of the first level, layers are aligned to it
+
+        size_t offset{}, linearOffset{};
+        levelCount = std::max(levelCount, 1U);
+        levels.reserve(levelCount);
+        for (u32 level{}; level < levelCount; level++) {
+            auto levelWidth{std::max(width >> level, 1U)}, levelHeight{std::max(height >> level, 1U)}, levelDepth{std::max(depth >> level, 1U)};
+            auto lines{DivideCeil(levelHeight, format.blockHeight)};
+
+            // The blocks of a level are shrunk until they're no larger than twice the level along each axis
+            while (blockHeight > 1 && DivideCeil(lines, GobHeight) <= blockHeight / 2)
+                blockHeight /= 2;
+            while (blockDepth > 1 && levelDepth <= blockDepth / 2)
+                blockDepth /= 2;
+
+            levelOffsets.push_back(offset);
+            linearLevelOffsets.push_back(linearOffset);
+            const auto &swizzle{levels.emplace_back(DivideCeil(levelWidth, format.blockWidth) * format.bpb, lines, levelDepth, blockHeight, blockDepth)};
+            offset += swizzle.GetSize();
+            linearOffset += swizzle.GetLinearSize();
+
+            // Every ROB of every slice is a separate unit of work, this allows even single-slice surfaces to be split up
+            for (u32 layer{}; layer < this->layerCount; layer++)
+                for (u32 slice{}; slice < levelDepth; slice++)
+                    for (u32 line{}; line < lines; line += swizzle.GetRobHeight())
+                        units.push_back(CopyUnit{level, layer, slice, line, std::min(swizzle.GetRobHeight(), lines - line)});
+        }
+
+        layerStride = this->layerCount > 1 ? util::AlignUp(offset, blockSize) : offset;
+        linearLayerSize = linearOffset;
+    }
+
+    template<bool ToBlockLinear>
+    void BlockLinearSurface::Copy(u8 *blockLinear, u8 *linear, ThreadPool *threadPool) const {
+        auto copyUnit{[&](size_t index) {
+            const auto &unit{units[index]};
+            levels[unit.level].Copy<ToBlockLinear>(blockLinear + (unit.layer * layerStride) + levelOffsets[unit.level], linear + (unit.layer * linearLayerSize) + linearLevelOffsets[unit.level], unit.slice, unit.firstLine, unit.lineCount);
+        }};
+
+        if (threadPool)
+            threadPool->ParallelFor(units.size(), copyUnit);
+        else
+            for (size_t index{}; index < units.size(); index++)
+                copyUnit(index);
+    }
+
+    template void BlockLinearSurface::Copy<true>(u8 *, u8 *, ThreadPool *) const;
+    template void BlockLinearSurface::Copy<false>(u8 *, u8 *, ThreadPool *) const;
+}
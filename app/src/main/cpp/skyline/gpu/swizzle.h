@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "texture.h"
+
+namespace skyline {
+    class ThreadPool;
+
+    namespace gpu::texture {
+        constexpr u32 GobWidth{64}; //!< The width of a GOB in bytes
+        constexpr u32 GobHeight{8}; //!< The height of a GOB in lines
+        constexpr u32 GobSize{GobWidth * GobHeight}; //!< The size of a GOB in bytes
+        constexpr u32 SectorWidth{16}; //!< The width of a sector in bytes, this is the largest run of bytes which is contiguous in both block-linear and linear memory
+
+        /**
+         * @brief The offset of every line of a GOB from the start of the GOB, every pair of lines is interleaved at a sector granularity
+         */
+        constexpr std::array<u16, GobHeight> GobLineOffsets{[] {
+            std::array<u16, GobHeight> offsets{};
+            for (u32 line{}; line < GobHeight; line++)
+                offsets[line] = static_cast<u16>(((line >> 1) * 64) + ((line & 1) * SectorWidth));
+            return offsets;
+        }()};
+
+        /**
+         * @brief The offset of every sector of a line of a GOB from the start of the line, every 32 bytes are a separate 256-byte half of the GOB
+         */
+        constexpr std::array<u16, GobWidth / SectorWidth> GobSectorOffsets{[] {
+            std::array<u16, GobWidth / SectorWidth> offsets{};
+            for (u32 sector{}; sector < offsets.size(); sector++)
+                offsets[sector] = static_cast<u16>(((sector >> 1) * 256) + ((sector & 1) * 32));
+            return offsets;
+        }()};
+
+        /**
+         * @brief A precomputed mapping between a single mip level of a block-linear surface and its linear copy, the address of any sector is the sum of three table lookups
+         * @note Blocks are a single GOB wide but can be several GOBs high and deep, the GOBs of a block are ordered along the Y-axis and then the Z-axis
+         */
+        class BlockLinearSwizzle {
+          private:
+            u32 stride; //!< The width of a line in bytes, this is aligned to a GOB so lines are always made up of whole sectors
+            u32 lines; //!< The height of a slice in lines
+            u32 robHeight; //!< The height of a ROB (Row Of Blocks) in lines
+            size_t size; //!< The size of the level in block-linear memory, this includes the padding of partial blocks
+            std::vector<u32> sectorOffsets; //!< The offset of every sector of a line from the start of the line in block-linear memory
+            std::vector<u32> lineOffsets; //!< The offset of every line of a slice from the start of the slice in block-linear memory
+            std::vector<size_t> sliceOffsets; //!< The offset of every slice from the start of the level in block-linear memory
+
+          public:
+            /**
+             * @param width The width of the level in bytes
+             * @param height The height of the level in lines
+             * @param depth The depth of the level in slices
+             * @param blockHeight The height of the blocks of the level in GOBs
+             * @param blockDepth The depth of the blocks of the level in GOBs
+             */
+            BlockLinearSwizzle(u32 width, u32 height, u32 depth, u32 blockHeight, u32 blockDepth);
+
+            size_t GetSize() const {
+                return size;
+            }
+
+            /**
+             * @return The distance between two lines of the linear copy in bytes
+             */
+            u32 GetStride() const {
+                return stride;
+            }
+
+            /**
+             * @return The size of the linear copy of the level in bytes, its slices are tightly packed
+             */
+            size_t GetLinearSize() const {
+                return static_cast<size_t>(stride) * lines * sliceOffsets.size();
+            }
+
+            u32 GetRobHeight() const {
+                return robHeight;
+            }
+
+            u32 GetLines() const {
+                return lines;
+            }
+
+            u32 GetDepth() const {
+                return static_cast<u32>(sliceOffsets.size());
+            }
+
+            /**
+             * @brief Copies a range of lines of a single slice between block-linear memory and the linear copy
+             * @tparam ToBlockLinear If the linear copy is swizzled into block-linear memory rather than the other way around
+             * @param blockLinear The start of the level in block-linear memory
+             * @param linear The start of the linear copy of the level
+             */
+            template<bool ToBlockLinear>
+            void Copy(u8 *blockLinear, u8 *linear, u32 slice, u32 firstLine, u32 lineCount) const;
+        };
+
+        /**
+         * @brief The layout of an entire block-linear surface with all of its array layers and mip levels, its linear copy has the levels of every layer after one another
+         * @note Every level uses the largest blocks which aren't more than twice its size, as the guest driver shrinks the blocks of small levels
+         */
+        class BlockLinearSurface {
+          private:
+            /**
+             * @brief A part of the surface which is copied as a whole, these are independent of each other so they can be copied in parallel
+             */
+            struct CopyUnit {
+                u32 level;
+                u32 layer;
+                u32 slice;
+                u32 firstLine;
+                u32 lineCount;
+            };
+
+            std::vector<BlockLinearSwizzle> levels;
+            std::vector<size_t> levelOffsets; //!< The offset of every level from the start of a layer in block-linear memory
+            std::vector<size_t> linearLevelOffsets; //!< The offset of every level from the start of a layer in the linear copy
+            size_t layerStride; //!< The distance between two layers in block-linear memory, layers of arrays are aligned to the blocks of the first level
+            size_t linearLayerSize; //!< The size of a layer in the linear copy
+            u32 layerCount;
+            std::vector<CopyUnit> units; //!< The surface split up into ROBs of every slice
+
+          public:
+            /**
+             * @param dimensions The dimensions of the first level in pixels, the depth is the amount of slices of 3D surfaces
+             * @param tileConfig The block size of the first level, its surface width is used rather than the width of the dimensions if it's set as it includes any padding
+             */
+            BlockLinearSurface(Format format, Dimensions dimensions, TileConfig tileConfig, u32 layerCount = 1, u32 levelCount = 1);
+
+            /**
+             * @return The size of the surface in block-linear memory
+             */
+            size_t GetSize() const {
+                return layerStride * layerCount;
+            }
+
+            /**
+             * @return The size of the linear copy of the surface
+             */
+            size_t GetLinearSize() const {
+                return linearLayerSize * layerCount;
+            }
+
+            const BlockLinearSwizzle &GetLevel(u32 level) const {
+                return levels.at(level);
+            }
+
+            /**
+             * @brief Copies the entire surface between block-linear memory and its linear copy
+             * @param threadPool The thread pool to split the copy across, it's done on the calling thread if this is nullptr
+             */
+            template<bool ToBlockLinear>
+            void Copy(u8 *blockLinear, u8 *linear, ThreadPool *threadPool = nullptr) const;
+        };
+    }
+}
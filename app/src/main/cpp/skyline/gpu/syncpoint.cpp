@@ -1,61 +1,109 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include "syncpoint.h"
 
 namespace skyline::gpu {
     u64 Syncpoint::RegisterWaiter(u32 threshold, const std::function<void()> &callback) {
+        std::unique_lock lock(waiterLock);
+        // The value is checked while holding the lock as Complete only processes waiters after raising the value, so the waiter can't be missed
         if (value >= threshold) {
+            lock.unlock();
             callback();
             return 0;
         }
 
-        std::lock_guard guard(waiterLock);
-        waiterMap.insert({nextWaiterId, Waiter{threshold, callback}});
-
-        return nextWaiterId++;
+        auto id{nextWaiterId++};
+        waiterIds.emplace(id, waiterMap.emplace(threshold, Waiter{id, callback}));
+        return id;
     }
 
     void Syncpoint::DeregisterWaiter(u64 id) {
         std::lock_guard guard(waiterLock);
-        waiterMap.erase(id);
+        auto waiter{waiterIds.find(id)};
+        if (waiter != waiterIds.end()) {
+            waiterMap.erase(waiter->second);
+            waiterIds.erase(waiter);
+        }
     }
 
-    u32 Syncpoint::Increment() {
-        value++;
+    void Syncpoint::CreateSemaphore(vk::Device pDevice, const vk::DispatchLoaderDynamic &pDispatch) {
+        device = pDevice;
+        dispatch = &pDispatch;
 
-        std::lock_guard guard(waiterLock);
-        std::erase_if(waiterMap, [this](const auto &entry) {
-            if (value >= entry.second.threshold) {
-                entry.second.callback();
-                return true;
-            } else {
-                return false;
+        vk::SemaphoreTypeCreateInfoKHR typeInfo{vk::SemaphoreTypeKHR::eTimeline, queuedValue};
+        semaphore = device.createSemaphoreUnique(vk::SemaphoreCreateInfo{{}, &typeInfo});
+    }
+
+    u32 Syncpoint::Complete(u64 queued) {
+        auto target{static_cast<u32>(queued)};
+        auto current{value.load()};
+        while (current < target && !value.compare_exchange_weak(current, target));
+        if (current >= target)
+            return current; // Another thread has already reached the target, so it has woken all waiters it satisfies
+
+        if (futexWaiters)
+            syscall(__NR_futex, reinterpret_cast<u32 *>(&value), FUTEX_WAKE, INT32_MAX);
+
+        std::vector<std::function<void()>> callbacks;
+        {
+            std::lock_guard guard(waiterLock);
+            auto end{waiterMap.upper_bound(target)};
+            for (auto waiter{waiterMap.begin()}; waiter != end; waiter++) {
+                callbacks.push_back(std::move(waiter->second.callback));
+                waiterIds.erase(waiter->second.id);
             }
-        });
+            waiterMap.erase(waiterMap.begin(), end);
+        }
 
-        return value;
+        for (const auto &callback : callbacks)
+            callback();
+
+        return target;
     }
 
     bool Syncpoint::Wait(u32 threshold, std::chrono::steady_clock::duration timeout) {
-        std::mutex mtx;
-        std::condition_variable cv;
-        bool flag{};
+        static_assert(sizeof(std::atomic<u32>) == sizeof(u32));
 
         if (timeout == timeout.max())
             timeout = std::chrono::seconds(1);
+        auto deadline{std::chrono::steady_clock::now() + timeout};
 
-        if (!RegisterWaiter(threshold, [&cv, &mtx, &flag] {
-            std::unique_lock lock(mtx);
-            flag = true;
-            lock.unlock();
-            cv.notify_all();
-        })) {
+        // The device signals the semaphore as soon as the increment is done, so it's waited on directly rather than waiting on the completion of the frame to be observed
+        auto queued{queuedValue.load()};
+        if (semaphore && value.load() < threshold && threshold <= static_cast<u32>(queued)) {
+            u64 target{queued - (static_cast<u32>(queued) - threshold)};
+            auto semaphoreHandle{*semaphore};
+            auto result{device.waitSemaphoresKHR(vk::SemaphoreWaitInfoKHR{{}, 1, &semaphoreHandle, &target}, static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count()), *dispatch)};
+            if (result != vk::Result::eSuccess)
+                return false;
+            Complete(target);
             return true;
         }
 
-        std::unique_lock lock(mtx);
-        return cv.wait_for(lock, timeout, [&flag] { return flag; });
-    }
-};
+        // The waiter count is incremented prior to checking the value, so Complete either sees it and wakes us or we see the incremented value
+        futexWaiters++;
+        bool reached{};
+        while (true) {
+            auto current{value.load()};
+            if (current >= threshold) {
+                reached = true;
+                break;
+            }
+
+            auto now{std::chrono::steady_clock::now()};
+            if (now >= deadline)
+                break;
 
+            auto remaining{std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count()};
+            timespec relativeTimeout{.tv_sec = static_cast<time_t>(remaining / constant::NsInSecond), .tv_nsec = static_cast<long>(remaining % constant::NsInSecond)};
+            syscall(__NR_futex, reinterpret_cast<u32 *>(&value), FUTEX_WAIT, current, &relativeTimeout);
+        }
+        futexWaiters--;
+
+        return reached;
+    }
+}
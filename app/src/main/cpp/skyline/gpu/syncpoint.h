@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <vulkan/vulkan.hpp>
 #include <common.h>
 
 namespace skyline {
@@ -13,20 +14,31 @@ namespace skyline {
     namespace gpu {
         /**
          * @brief The Syncpoint class represents a single syncpoint in the GPU which is used for GPU -> CPU synchronisation
+         * @note If the device supports timeline semaphores, every syncpoint is backed by one which the device signals with the value of an increment as soon as the work prior to it is done, so waits on it don't depend on the completion of frames being observed
          */
         class Syncpoint {
           private:
             struct Waiter {
-                u32 threshold;                  //!< The syncpoint value to wait on to be reached
+                u64 id;                         //!< The persistent identifier of the waiter
                 std::function<void()> callback; //!< The callback to do after the wait has ended
             };
 
+            using WaiterMap = std::multimap<u32, Waiter>; //!< Waiters ordered by the syncpoint value they wait on, so an increment only has to visit the waiters it satisfies
+
             Mutex waiterLock; //!< Synchronizes insertions and deletions of waiters
-            std::map<u64, Waiter> waiterMap;
+            WaiterMap waiterMap;
+            std::unordered_map<u64, WaiterMap::iterator> waiterIds; //!< A mapping from the identifier of a waiter to its entry in waiterMap
             u64 nextWaiterId{1};
 
+            std::atomic<u32> futexWaiters{}; //!< The amount of threads sleeping on a futex on value in Wait, Complete only wakes the futex if this isn't 0
+
+            vk::Device device{};
+            const vk::DispatchLoaderDynamic *dispatch{};
+            vk::UniqueSemaphore semaphore; //!< The timeline semaphore which backs the syncpoint, this is only created if the device supports timeline semaphores
+            std::atomic<u64> queuedValue{}; //!< The value of the syncpoint after all increments that have been queued, this is the value its semaphore is signalled with by the last of them
+
           public:
-            std::atomic<u32> value{};
+            std::atomic<u32> value{}; //!< The value of the syncpoint, this doubles as the futex which Wait sleeps on
 
             /**
              * @brief Registers a new waiter with a callback that will be called when the syncpoint reaches the target threshold
@@ -41,14 +53,37 @@ namespace skyline {
             void DeregisterWaiter(u64 id);
 
             /**
-             * @brief Increments the syncpoint by 1
+             * @brief Creates the timeline semaphore which backs the syncpoint, this must be done prior to it being used by any other thread
+             */
+            void CreateSemaphore(vk::Device device, const vk::DispatchLoaderDynamic &dispatch);
+
+            /**
+             * @return The semaphore which backs the syncpoint or a null handle if there's none
+             */
+            vk::Semaphore GetSemaphore() {
+                return *semaphore;
+            }
+
+            /**
+             * @brief Queues an increment of the syncpoint by 1, the device has to signal the semaphore with the returned value and Complete has to be called with it once it has
+             * @note This must only be called by the thread which submits work to the device, so increments are queued in the order they're submitted in
+             */
+            u64 Queue() {
+                return ++queuedValue;
+            }
+
+            /**
+             * @brief Raises the value of the syncpoint to that of a queued increment if it's lower, the callbacks of any waiters that this satisfies are called
              * @return The new value of the syncpoint
+             * @note The callbacks are called after they've been removed, without waiterLock being held
              */
-            u32 Increment();
+            u32 Complete(u64 queued);
 
             /**
              * @brief Waits for the syncpoint to reach given threshold
              * @return false if the timeout was reached, otherwise true
+             * @note This sleeps on a futex on the value directly rather than registering a waiter, so it doesn't allocate
+             * @note If the increment which reaches the threshold has been queued already, the semaphore is waited on instead so the wait ends as soon as the device is done with it
              */
             bool Wait(u32 threshold, std::chrono::steady_clock::duration timeout);
         };
@@ -2,9 +2,16 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <android/native_window.h>
+#include <arm_neon.h>
 #include <kernel/types/KProcess.h>
+#include <gpu.h>
+#include <statistics.h>
+#include <thread_pool.h>
+#include <trace.h>
 #include <unistd.h>
-#include "texture.h"
+#include "pixel_conversion.h"
+#include "bcn_decoder.h"
+#include "swizzle.h"
 
 namespace skyline::gpu {
     GuestTexture::GuestTexture(const DeviceState &state, u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tiling, texture::TileConfig layout) : state(state), address(address), dimensions(dimensions), format(format), tileMode(tiling), tileConfig(layout) {}
@@ -17,86 +24,249 @@ namespace skyline::gpu {
         return sharedHost;
     }
 
-    std::shared_ptr<PresentationTexture> GuestTexture::InitializePresentationTexture() {
+    std::shared_ptr<PresentationTexture> GuestTexture::InitializePresentationTexture(std::vector<u8> backing) {
         if (!host.expired())
             throw exception("Trying to create multiple PresentationTexture objects from a single GuestTexture");
-        auto presentation{std::make_shared<PresentationTexture>(state, shared_from_this(), dimensions, format)};
+        auto presentation{std::make_shared<PresentationTexture>(state, shared_from_this(), dimensions, format, std::move(backing))};
         host = std::static_pointer_cast<Texture>(presentation);
         return presentation;
     }
 
-    Texture::Texture(const DeviceState &state, std::shared_ptr<GuestTexture> guest, texture::Dimensions dimensions, texture::Format format, texture::Swizzle swizzle) : state(state), guest(guest), dimensions(dimensions), format(format), swizzle(swizzle) {
+    Texture::Texture(const DeviceState &state, std::shared_ptr<GuestTexture> guest, texture::Dimensions dimensions, texture::Format format, texture::Swizzle swizzle, std::vector<u8> backing) : state(state), backing(std::move(backing)), guest(guest), dimensions(dimensions), format(format), swizzle(swizzle) {
         SynchronizeHost();
     }
 
-    void Texture::SynchronizeHost() {
-        auto texture{state.process->GetPointer<u8>(guest->address)};
-        auto size{format.GetSize(dimensions)};
-        backing.resize(size);
-        auto output{reinterpret_cast<u8 *>(backing.data())};
+    Texture::~Texture() {
+        state.statistics->textureHostBytes.fetch_sub(backing.capacity(), std::memory_order_relaxed);
+    }
 
-        if (guest->tileMode == texture::TileMode::Block) {
-            // Reference on Block-linear tiling: https://gist.github.com/PixelyIon/d9c35050af0ef5690566ca9f0965bc32
-            constexpr u8 sectorWidth{16}; // The width of a sector in bytes
-            constexpr u8 sectorHeight{2}; // The height of a sector in lines
-            constexpr u8 gobWidth{64}; // The width of a GOB in bytes
-            constexpr u8 gobHeight{8}; // The height of a GOB in lines
-
-            auto blockHeight{guest->tileConfig.blockHeight}; // The height of the blocks in GOBs
-            auto robHeight{gobHeight * blockHeight}; // The height of a single ROB (Row of Blocks) in lines
-            auto surfaceHeight{dimensions.height / format.blockHeight}; // The height of the surface in lines
-            auto surfaceHeightRobs{util::AlignUp(surfaceHeight, robHeight) / robHeight}; // The height of the surface in ROBs (Row Of Blocks)
-            auto robWidthBytes{util::AlignUp((guest->tileConfig.surfaceWidth / format.blockWidth) * format.bpb, gobWidth)}; // The width of a ROB in bytes
-            auto robWidthBlocks{robWidthBytes / gobWidth}; // The width of a ROB in blocks (and GOBs because block width == 1 on the Tegra X1)
+    /**
+     * @brief Copies a single block-linear GOB between block-linear and linear memory
+     * @tparam ToBlockLinear If the linear GOB is swizzled into block-linear memory rather than the block-linear GOB being deswizzled into linear memory
+     * @param offsets The offset of every 64-byte part of the GOB in linear memory, each part is a 2x2 square of sectors
+     * @param stride The distance between lines in linear memory
+     */
+    template<bool ToBlockLinear>
+    static FORCE_INLINE void CopyGob(u8 *linear, u8 *blockLinear, const std::array<u32, 8> &offsets, u32 stride) {
+        for (auto offset : offsets) {
+            auto line{linear + offset};
+            if constexpr (ToBlockLinear) {
+                uint8x16x4_t sectors{vld1q_u8(line), vld1q_u8(line + stride), vld1q_u8(line + 16), vld1q_u8(line + stride + 16)};
+                vst1q_u8_x4(blockLinear, sectors);
+            } else {
+                auto sectors{vld1q_u8_x4(blockLinear)}; // The sectors are in the order: (X: 0, Y: 0), (X: 0, Y: 1), (X: 16, Y: 0), (X: 16, Y: 1)
+                vst1q_u8(line, sectors.val[0]);
+                vst1q_u8(line + 16, sectors.val[2]);
+                vst1q_u8(line + stride, sectors.val[1]);
+                vst1q_u8(line + stride + 16, sectors.val[3]);
+            }
+            blockLinear += 64;
+        }
+    }
+
+    namespace texture {
+        size_t GetBlockLinearSize(u32 surfaceWidth, u32 surfaceHeight, u32 blockHeight) {
+            auto robHeight{GobHeight * blockHeight};
+            return static_cast<size_t>(util::AlignUp(surfaceWidth, GobWidth)) * util::AlignUp(surfaceHeight, robHeight);
+        }
+
+        template<bool ToBlockLinear>
+        void CopyBlockLinearRegion(u8 *blockLinear, u32 surfaceWidth, u32 blockHeight, u32 originX, u32 originY, u8 *pitch, u32 pitchStride, u32 width, u32 height) {
+            auto robWidthBytes{util::AlignUp(surfaceWidth, GobWidth)}; // The width of a ROB in bytes
+            auto robHeight{GobHeight * blockHeight}; // The height of a single ROB in lines
             auto robBytes{robWidthBytes * robHeight}; // The size of a ROB in bytes
-            auto gobYOffset{robWidthBytes * gobHeight}; // The offset of the next Y-axis GOB from the current one in linear space
-
-            auto inputSector{texture}; // The address of the input sector
-            auto outputRob{output}; // The address of the output block
-
-            for (u32 rob{}, y{}, paddingY{}; rob < surfaceHeightRobs; rob++) { // Every Surface contains `surfaceHeightRobs` ROBs
-                auto outputBlock{outputRob}; // We iterate through a block independently of the ROB
-                for (u32 block{}; block < robWidthBlocks; block++) { // Every ROB contains `surfaceWidthBlocks` Blocks
-                    auto outputGob{outputBlock}; // We iterate through a GOB independently of the block
-                    for (u32 gobY{}; gobY < blockHeight; gobY++) { // Every Block contains `blockHeight` Y-axis GOBs
-                        for (u32 index{}; index < sectorWidth * sectorHeight; index++) { // Every Y-axis GOB contains `sectorWidth * sectorHeight` sectors
-                            u32 xT{((index << 3) & 0b10000) | ((index << 1) & 0b100000)}; // Morton-Swizzle on the X-axis
-                            u32 yT{((index >> 1) & 0b110) | (index & 0b1)}; // Morton-Swizzle on the Y-axis
-                            std::memcpy(outputGob + (yT * robWidthBytes) + xT, inputSector, sectorWidth);
-                            inputSector += sectorWidth; // `sectorWidth` bytes are of sequential image data
-                        }
-                        outputGob += gobYOffset; // Increment the output GOB to the next Y-axis GOB
-                    }
-                    inputSector += paddingY; // Increment the input sector to the next sector
-                    outputBlock += gobWidth; // Increment the output block to the next block (As Block Width = 1 GOB Width)
+            auto blockBytes{GobSize * blockHeight}; // The size of a single block in bytes
+
+            if (util::IsAligned(originX, GobWidth) && util::IsAligned(originY, GobHeight) && util::IsAligned(width, GobWidth) && util::IsAligned(height, GobHeight)) {
+                // Regions made up of whole GOBs are copied with the NEON GOB swizzler
+                std::array<u32, GobSize / GobWidth> gobOffsets;
+                for (u32 part{}; part < gobOffsets.size(); part++)
+                    gobOffsets[part] = (((part & 0b11) << 1) * pitchStride) + ((part & 0b100) << 3);
+
+                for (u32 y{}; y < height; y += GobHeight) {
+                    auto line{originY + y};
+                    auto blockLinearRow{blockLinear + ((line / robHeight) * robBytes) + (((line % robHeight) / GobHeight) * GobSize)};
+                    for (u32 x{}; x < width; x += GobWidth)
+                        CopyGob<ToBlockLinear>(pitch + (y * pitchStride) + x, blockLinearRow + (((originX + x) / GobWidth) * blockBytes), gobOffsets, pitchStride);
                 }
-                outputRob += robBytes; // Increment the output block to the next ROB
+                return;
+            }
 
-                y += robHeight; // Increment the Y position to the next ROB
-                blockHeight = static_cast<u8>(std::min(static_cast<u32>(blockHeight), (surfaceHeight - y) / gobHeight)); // Calculate the amount of Y GOBs which aren't padding
-                paddingY = (guest->tileConfig.blockHeight - blockHeight) * (sectorWidth * sectorWidth * sectorHeight); // Calculate the amount of padding between contiguous sectors
+            // Any other region is copied in runs of contiguous bytes, which are at most a 16-byte sector
+            for (u32 y{}; y < height; y++) {
+                auto line{originY + y};
+                auto blockLinearLine{blockLinear + ((line / robHeight) * robBytes) + (((line % robHeight) / GobHeight) * GobSize) + (((line % GobHeight) >> 1) * 64) + ((line & 1) * SectorWidth)};
+                auto pitchLine{pitch + (y * pitchStride)};
+                for (u32 x{}; x < width;) {
+                    auto column{originX + x};
+                    auto run{std::min(SectorWidth - (column % SectorWidth), width - x)};
+                    auto blockLinearSector{blockLinearLine + ((column / GobWidth) * blockBytes) + (((column % GobWidth) / 32) * 256) + (((column % 32) / SectorWidth) * 32) + (column % SectorWidth)};
+                    if constexpr (ToBlockLinear)
+                        std::memcpy(blockLinearSector, pitchLine + x, run);
+                    else
+                        std::memcpy(pitchLine + x, blockLinearSector, run);
+                    x += run;
+                }
             }
-        } else if (guest->tileMode == texture::TileMode::Pitch) {
-            auto sizeLine{guest->format.GetSize(dimensions.width, 1)}; // The size of a single line of pixel data
-            auto sizeStride{guest->format.GetSize(guest->tileConfig.pitch, 1)}; // The size of a single stride of pixel data
+        }
 
-            auto inputLine{texture}; // The address of the input line
-            auto outputLine{output}; // The address of the output line
+        template void CopyBlockLinearRegion<true>(u8 *, u32, u32, u32, u32, u8 *, u32, u32, u32);
+        template void CopyBlockLinearRegion<false>(u8 *, u32, u32, u32, u32, u8 *, u32, u32, u32);
+    }
 
-            for (u32 line{}; line < dimensions.height; line++) {
-                std::memcpy(outputLine, inputLine, sizeLine);
-                inputLine += sizeStride;
-                outputLine += sizeLine;
-            }
-        } else if (guest->tileMode == texture::TileMode::Linear) {
-            std::memcpy(output, texture, size);
+    texture::BlockLinearSurface &Texture::GetBlockLinearSurface() {
+        if (!blockLinearSurface)
+            blockLinearSurface = std::make_unique<texture::BlockLinearSurface>(format, dimensions, guest->tileConfig, guest->layerCount, guest->levelCount);
+        return *blockLinearSurface;
+    }
+
+    size_t Texture::GetGuestSize() {
+        switch (guest->tileMode) {
+            case texture::TileMode::Block:
+                return GetBlockLinearSurface().GetSize();
+            case texture::TileMode::Pitch:
+                return dimensions.height ? (guest->format.GetSize(guest->tileConfig.pitch, 1) * (dimensions.height - 1)) + guest->format.GetSize(dimensions.width, 1) : 0;
+            case texture::TileMode::Linear:
+                return format.GetSize(dimensions);
         }
     }
 
-    PresentationTexture::PresentationTexture(const DeviceState &state, const std::shared_ptr<GuestTexture> &guest, const texture::Dimensions &dimensions, const texture::Format &format, const std::function<void()> &releaseCallback) : releaseCallback(releaseCallback), Texture(state, guest, dimensions, format, {}) {}
+    constexpr size_t ParallelConversionThreshold{0x100000}; //!< The size of a surface in bytes from which its conversion is split across the thread pool
+
+    bool Texture::IsDecoded() {
+        return !state.gpu->vkTextureCompressionBc && texture::IsBcnDecodable(format);
+    }
+
+    size_t Texture::GetEncodedStride() {
+        switch (guest->tileMode) {
+            case texture::TileMode::Block:
+                return GetBlockLinearSurface().GetLevel(0).GetStride();
+            case texture::TileMode::Pitch:
+                return guest->format.GetSize(guest->tileConfig.pitch, 1);
+            case texture::TileMode::Linear:
+                return format.GetSize(dimensions.width, 1);
+        }
+    }
+
+    size_t Texture::GetEncodedSize() {
+        if (guest->tileMode == texture::TileMode::Block)
+            return GetBlockLinearSurface().GetLinearSize();
+        return GetEncodedStride() * (dimensions.height / format.blockHeight);
+    }
+
+    size_t Texture::GetHostStride() {
+        return IsDecoded() ? format::RGBA8888Unorm.GetSize(dimensions.width, 1) : GetEncodedStride();
+    }
+
+    size_t Texture::GetHostSize() {
+        return IsDecoded() ? GetHostStride() * dimensions.height : GetEncodedSize();
+    }
+
+    void Texture::Decode(u8 *hostTexture) {
+        TRACE_SCOPE("Texture::Decode");
+
+        // Blocks can't be decoded in place as every decoded block is larger than the encoded one, so the guest texture is synchronized into a scratch buffer first
+        decodeScratch.resize(GetEncodedSize());
+        Synchronize<false>(decodeScratch.data());
+        texture::DecodeBcn(format, decodeScratch.data(), GetEncodedStride(), hostTexture, GetHostStride(), dimensions.width, dimensions.height);
+    }
+
+    template<bool ToGuest>
+    void Texture::Synchronize(u8 *hostTexture, bool convert) {
+        auto guestTexture{state.process->GetPointer<u8>(guest->address)};
+
+        if (guest->tileMode == texture::TileMode::Block) {
+            // Reference on Block-linear tiling: https://gist.github.com/PixelyIon/d9c35050af0ef5690566ca9f0965bc32
+            auto &surface{GetBlockLinearSurface()};
+
+            // Every ROB of every slice is independent of the others, so large surfaces have them split across the thread pool
+            surface.Copy<ToGuest>(guestTexture, hostTexture, surface.GetLinearSize() >= ParallelConversionThreshold ? state.threadPool.get() : nullptr);
+
+            // Block-linear frames are normally converted while being deswizzled on the host GPU, this is only the fallback so the linear copy is converted in place
+            if constexpr (!ToGuest)
+                if (convert)
+                    texture::ConvertPixels(texture::GetPixelConversion(format), hostTexture, hostTexture, surface.GetLinearSize() / format.bpb);
+        } else {
+            // Pitch-linear textures keep the guest's pitch on the host, so they're contiguous with the guest texture much like linear textures and are copied in bulk
+            auto copySize{GetGuestSize()};
+            constexpr size_t partSize{0x40000}; // The size of every part a large copy is split into when copying it across the thread pool
+
+            auto conversion{convert ? texture::GetPixelConversion(format) : texture::PixelConversion::None};
+            auto copyPart{[&](size_t part) {
+                auto offset{part * partSize};
+                auto size{std::min(partSize, copySize - offset)};
+                if constexpr (ToGuest) {
+                    std::memcpy(guestTexture + offset, hostTexture + offset, size);
+                } else if (conversion != texture::PixelConversion::None) {
+                    // Pixels are converted as they're copied, the parts are a multiple of every pixel size so they map onto whole pixels of the converted texture
+                    auto presentableBpb{texture::GetPresentableFormat(format).bpb};
+                    texture::ConvertPixels(conversion, guestTexture + offset, hostTexture + (offset / format.bpb) * presentableBpb, size / format.bpb);
+                } else {
+                    std::memcpy(hostTexture + offset, guestTexture + offset, size);
+                }
+            }};
+
+            auto partCount{util::AlignUp(copySize, partSize) / partSize};
+            if (copySize >= ParallelConversionThreshold)
+                state.threadPool->ParallelFor(partCount, copyPart);
+            else
+                for (size_t part{}; part < partCount; part++)
+                    copyPart(part);
+        }
+    }
+
+    void Texture::SynchronizeHost() {
+        TRACE_SCOPE("Texture::SynchronizeHost");
+
+        // The guest can modify the texture at any point, as there's no way to track writes from the guest process its contents are compared by hash instead
+        auto hash{util::HashMemory(state.process->GetPointer<u8>(guest->address), GetGuestSize())};
+        if (synchronized && hash == guestHash)
+            return;
+
+        auto capacity{backing.capacity()};
+        backing.resize(GetHostSize());
+        state.statistics->textureHostBytes.fetch_add(backing.capacity() - capacity, std::memory_order_relaxed);
+        if (IsDecoded())
+            Decode(backing.data());
+        else
+            Synchronize<false>(backing.data());
+        state.statistics->textureUploadBytes.fetch_add(backing.size(), std::memory_order_relaxed);
+        guestHash = hash;
+        synchronized = true;
+    }
+
+    void Texture::SynchronizeHost(u8 *destination, bool convert) {
+        TRACE_SCOPE("Texture::SynchronizeHost");
+        if (IsDecoded())
+            Decode(destination);
+        else
+            Synchronize<false>(destination, convert && texture::GetPixelConversion(format) != texture::PixelConversion::None);
+        state.statistics->textureUploadBytes.fetch_add(GetHostSize(), std::memory_order_relaxed);
+    }
+
+    void Texture::SynchronizeGuest() {
+        if (IsDecoded())
+            throw exception("Cannot synchronize a BCn guest texture with its decoded host texture as it can't be encoded again");
+        if (backing.size() != GetHostSize())
+            throw exception("Cannot synchronize a guest texture with a host texture that was never synchronized from it");
+
+        Synchronize<true>(backing.data());
+        guestHash = util::HashMemory(state.process->GetPointer<u8>(guest->address), GetGuestSize());
+        synchronized = true;
+    }
+
+    void Texture::InvalidateHost() {
+        synchronized = false;
+    }
+
+    PresentationTexture::PresentationTexture(const DeviceState &state, const std::shared_ptr<GuestTexture> &guest, const texture::Dimensions &dimensions, const texture::Format &format, std::vector<u8> backing) : Texture(state, guest, dimensions, format, {}, std::move(backing)) {}
+
+    texture::Format PresentationTexture::GetPresentableFormat() {
+        return texture::GetPresentableFormat(format);
+    }
 
     i32 PresentationTexture::GetAndroidFormat() {
-        switch (format.vkFormat) {
+        switch (GetPresentableFormat().vkFormat) {
             case vk::Format::eR8G8B8A8Unorm:
                 return WINDOW_FORMAT_RGBA_8888;
             case vk::Format::eR5G6B5UnormPack16:
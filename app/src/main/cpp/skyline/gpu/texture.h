@@ -111,10 +111,37 @@ namespace skyline {
                 SwizzleChannel blue{SwizzleChannel::Blue}; //!< Swizzle for the blue channel
                 SwizzleChannel alpha{SwizzleChannel::Alpha}; //!< Swizzle for the alpha channel
             };
+
+            /**
+             * @return The size of a block-linear surface in bytes, this includes the padding of the final ROB
+             * @param surfaceWidth The width of the surface in bytes
+             * @param surfaceHeight The height of the surface in lines
+             * @param blockHeight The height of the blocks in GOBs
+             */
+            size_t GetBlockLinearSize(u32 surfaceWidth, u32 surfaceHeight, u32 blockHeight);
+
+            /**
+             * @brief Copies a region between a block-linear surface and pitch-linear memory, regions which consist of whole GOBs are copied with NEON
+             * @tparam ToBlockLinear If the pitch-linear region is swizzled into the block-linear surface rather than the other way around
+             * @param blockLinear The base of the block-linear surface
+             * @param surfaceWidth The width of the block-linear surface in bytes
+             * @param blockHeight The height of the blocks of the surface in GOBs
+             * @param originX The X-axis offset of the region in the block-linear surface in bytes
+             * @param originY The Y-axis offset of the region in the block-linear surface in lines
+             * @param pitch The first line of the region in pitch-linear memory
+             * @param pitchStride The distance between two lines in pitch-linear memory
+             * @param width The width of the region in bytes
+             * @param height The height of the region in lines
+             */
+            template<bool ToBlockLinear>
+            void CopyBlockLinearRegion(u8 *blockLinear, u32 surfaceWidth, u32 blockHeight, u32 originX, u32 originY, u8 *pitch, u32 pitchStride, u32 width, u32 height);
+
+            class BlockLinearSurface;
         }
 
         class Texture;
         class PresentationTexture;
+        class TextureCache;
 
         /**
          * @brief A texture present in guest memory, it can be used to create a corresponding Texture object for usage on the host
@@ -130,6 +157,8 @@ namespace skyline {
             texture::Format format;
             texture::TileMode tileMode;
             texture::TileConfig tileConfig;
+            u32 layerCount{1}; //!< The amount of array layers in the texture, these are only laid out separately for block-linear textures
+            u32 levelCount{1}; //!< The amount of mip levels in every layer of the texture, these are only laid out separately for block-linear textures
 
             GuestTexture(const DeviceState &state, u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tileMode = texture::TileMode::Linear, texture::TileConfig tileConfig = {});
 
@@ -148,9 +177,13 @@ namespace skyline {
             std::shared_ptr<Texture> InitializeTexture(std::optional<texture::Format> format = std::nullopt, std::optional<texture::Dimensions> dimensions = std::nullopt, texture::Swizzle swizzle = {});
 
           protected:
-            std::shared_ptr<PresentationTexture> InitializePresentationTexture();
+            /**
+             * @param backing The storage of a retired texture which is reused for the host copy, so it's only reallocated if it's too small
+             */
+            std::shared_ptr<PresentationTexture> InitializePresentationTexture(std::vector<u8> backing = {});
 
             friend service::hosbinder::GraphicBufferProducer;
+            friend TextureCache;
         };
 
         /**
@@ -160,6 +193,47 @@ namespace skyline {
           private:
             const DeviceState &state;
 
+            /**
+             * @brief Copies the texture between the guest and the host, converting it from or to the tiling mode of the guest texture
+             * @tparam ToGuest If the host texture is copied into the guest texture rather than the other way around
+             * @param hostTexture The linear host copy of the texture, its lines are laid out as described by GetHostStride()
+             * @param convert If the pixels are converted into the format from texture::GetPresentableFormat() while being copied to the host, the stride of the host copy is scaled by the ratio of the pixel sizes
+             */
+            template<bool ToGuest>
+            void Synchronize(u8 *hostTexture, bool convert = false);
+
+            std::atomic<bool> synchronized{}; //!< If the host texture has been synchronized with the guest texture, this is cleared when the guest texture is known to have been modified
+            u64 guestHash{}; //!< A hash of the guest texture's memory from when the textures were last synchronized, it's used to detect if the guest has modified the texture since
+            std::unique_ptr<texture::BlockLinearSurface> blockLinearSurface; //!< The layout of the guest texture if it's block-linear, this is created on first use as building its tables isn't free
+
+            /**
+             * @return The layout of the block-linear guest texture, this is only valid if the guest texture is block-linear
+             */
+            texture::BlockLinearSurface &GetBlockLinearSurface();
+
+            std::vector<u8> decodeScratch; //!< The linear copy of a BCn guest texture which is decoded into the host texture, this is retained to avoid reallocating it
+
+            /**
+             * @return If the host texture is the BCn guest texture decoded into RGBA8888Unorm, this is the case when the device lacks the textureCompressionBC feature
+             */
+            bool IsDecoded();
+
+            /**
+             * @return The distance between two lines of the linear copy of the guest texture in its own format
+             */
+            size_t GetEncodedStride();
+
+            /**
+             * @return The size of the linear copy of the guest texture in its own format, this includes the padding of every line
+             */
+            size_t GetEncodedSize();
+
+            /**
+             * @brief Copies the BCn guest texture into decodeScratch and decodes it from there into the host texture
+             * @param hostTexture A buffer of at least GetHostSize() bytes
+             */
+            void Decode(u8 *hostTexture);
+
           public:
             std::vector<u8> backing; //!< The object that holds a host copy of the guest texture (Will be replaced with a vk::Image)
             std::shared_ptr<GuestTexture> guest; //!< The guest texture from which this was created, it is required for syncing
@@ -168,7 +242,12 @@ namespace skyline {
             texture::Swizzle swizzle;
 
           public:
-            Texture(const DeviceState &state, std::shared_ptr<GuestTexture> guest, texture::Dimensions dimensions, texture::Format format, texture::Swizzle swizzle);
+            /**
+             * @param backing The storage of a retired texture which is reused for the host copy, so it's only reallocated if it's too small
+             */
+            Texture(const DeviceState &state, std::shared_ptr<GuestTexture> guest, texture::Dimensions dimensions, texture::Format format, texture::Swizzle swizzle, std::vector<u8> backing = {});
+
+            ~Texture();
 
           public:
             /**
@@ -195,13 +274,45 @@ namespace skyline {
 
             /**
              * @brief Synchronizes the host texture with the guest after it has been modified
+             * @note The guest texture is only converted if its contents have changed since the textures were last synchronized
              */
             void SynchronizeHost();
 
+            /**
+             * @brief Converts the guest texture directly into an external buffer rather than the backing, this avoids an intermediate copy for buffers which are only consumed once
+             * @param destination A buffer of at least GetHostSize() bytes
+             * @param convert If the pixels should be converted into the format from texture::GetPresentableFormat(), this is done in the same pass as the copy
+             * @note This always converts the entire texture and doesn't affect the state of the backing
+             */
+            void SynchronizeHost(u8 *destination, bool convert = false);
+
+            /**
+             * @return The distance between two lines of the host texture in bytes
+             * @note Pitch-linear textures retain the pitch of the guest texture, so consumers of the host texture have to respect the stride rather than assuming lines are packed
+             * @note Decoded BCn textures are tightly packed RGBA8888Unorm pixels regardless of the tiling mode of the guest texture
+             */
+            size_t GetHostStride();
+
+            /**
+             * @return The size of the host texture in bytes, this includes the padding of every line
+             */
+            size_t GetHostSize();
+
+            /**
+             * @return The size of the guest texture's memory in its tiling mode, this includes any padding
+             */
+            size_t GetGuestSize();
+
             /**
              * @brief Synchronizes the guest texture with the host texture after it has been modified
              */
             void SynchronizeGuest();
+
+            /**
+             * @brief Marks the host texture as outdated, it'll be converted again on the next SynchronizeHost regardless of the hash of the guest texture
+             * @note This is used when the guest texture has been written to by the GPU as opposed to the CPU
+             */
+            void InvalidateHost();
         };
 
         /**
@@ -209,12 +320,18 @@ namespace skyline {
          */
         class PresentationTexture : public Texture {
           public:
+            std::function<void()> acquireCallback; //!< The callback after this texture has been taken off the presentation queue to be displayed
             std::function<void()> releaseCallback; //!< The release callback after this texture has been displayed
 
-            PresentationTexture(const DeviceState &state, const std::shared_ptr<GuestTexture> &guest, const texture::Dimensions &dimensions, const texture::Format &format, const std::function<void()> &releaseCallback = {});
+            PresentationTexture(const DeviceState &state, const std::shared_ptr<GuestTexture> &guest, const texture::Dimensions &dimensions, const texture::Format &format, std::vector<u8> backing = {});
+
+            /**
+             * @return The format the texture is presented in, formats which Android surfaces don't support are converted into RGBA8888Unorm
+             */
+            texture::Format GetPresentableFormat();
 
             /**
-             * @return The corresponding Android surface format for the current texture format
+             * @return The corresponding Android surface format for the format the texture is presented in
              */
             i32 GetAndroidFormat();
         };
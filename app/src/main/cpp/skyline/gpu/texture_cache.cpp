@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "texture_cache.h"
+
+namespace skyline::gpu {
+    TextureCache::Key::Key(u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tileMode, texture::TileConfig tileConfig) : address(address), width(dimensions.width), height(dimensions.height), format(format.vkFormat), tileMode(tileMode), pitch(tileMode == texture::TileMode::Pitch ? tileConfig.pitch : 0), surfaceWidth(tileMode == texture::TileMode::Block ? tileConfig.surfaceWidth : u16{}), blockHeight(tileMode == texture::TileMode::Block ? tileConfig.blockHeight : u8{}), blockDepth(tileMode == texture::TileMode::Block ? tileConfig.blockDepth : u8{}) {}
+
+    size_t TextureCache::KeyHash::operator()(const Key &key) const {
+        constexpr u64 Prime{0x9E3779B97F4A7C15};
+        u64 hash{key.address};
+        for (u64 value : {(static_cast<u64>(key.width) << 32) | key.height, (static_cast<u64>(key.format) << 32) | static_cast<u64>(key.tileMode), (static_cast<u64>(key.pitch) << 32) | (static_cast<u64>(key.surfaceWidth) << 16) | (static_cast<u64>(key.blockHeight) << 8) | key.blockDepth})
+            hash = std::rotl((hash ^ value) * Prime, 31);
+        return hash;
+    }
+
+    TextureCache::TextureCache(const DeviceState &state) : state(state) {}
+
+    std::shared_ptr<PresentationTexture> TextureCache::GetPresentationTexture(u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tileMode, texture::TileConfig tileConfig, std::shared_ptr<PresentationTexture> previous) {
+        Key key{address, dimensions, format, tileMode, tileConfig};
+
+        std::lock_guard lock(mutex);
+        auto &entry{presentationTextures[key]};
+        if (auto texture{entry.lock()})
+            return texture;
+
+        // Entries of textures which are no longer referenced are only pruned when a new texture is created as that's when the map grows
+        for (auto it{presentationTextures.begin()}; it != presentationTextures.end();) {
+            if (it->second.expired() && &it->second != &entry)
+                it = presentationTextures.erase(it);
+            else
+                it++;
+        }
+
+        // The storage of the previous texture is only taken if this is the last reference to it, the cache's weak references are only locked under the mutex so no reference can be taken concurrently
+        std::vector<u8> backing;
+        if (previous && previous.use_count() == 1)
+            backing = std::move(previous->backing);
+        previous.reset();
+
+        auto texture{std::make_shared<GuestTexture>(state, address, dimensions, format, tileMode, tileConfig)->InitializePresentationTexture(std::move(backing))};
+        entry = texture;
+        return texture;
+    }
+
+    void TextureCache::Invalidate(u64 address, u64 size) {
+        std::lock_guard lock(mutex);
+        for (const auto &entry : presentationTextures) {
+            auto texture{entry.second.lock()};
+            if (texture && texture->guest->address < address + size && address < texture->guest->address + texture->GetGuestSize())
+                texture->InvalidateHost();
+        }
+    }
+
+    void TextureCache::InvalidateGpu(u64 address, u64 size) {
+        auto &memoryManager{state.gpu->memoryManager};
+
+        // The region is only contiguous within a GPU page in the CPU address space, so contiguous runs of pages are coalesced into a single invalidation
+        u64 runAddress{}, runSize{};
+        for (u64 offset{}; offset < size;) {
+            u64 pageSize{std::min(constant::GpuPageSize - ((address + offset) & (constant::GpuPageSize - 1)), size - offset)};
+            u64 cpuAddress{memoryManager.Translate(address + offset)};
+            if (runSize && cpuAddress && runAddress + runSize == cpuAddress) {
+                runSize += pageSize;
+            } else {
+                if (runSize)
+                    Invalidate(runAddress, runSize);
+                runAddress = cpuAddress;
+                runSize = cpuAddress ? pageSize : 0; // Unmapped pages can't be backing any textures
+            }
+            offset += pageSize;
+        }
+
+        if (runSize)
+            Invalidate(runAddress, runSize);
+    }
+}
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "texture.h"
+
+namespace skyline::gpu {
+    /**
+     * @brief The TextureCache class reuses host textures for guest textures with identical parameters, so surfaces which are set up again don't have to be recreated and converted from scratch
+     * @note Textures aren't kept alive by the cache, an entry is only reused while the texture is still referenced elsewhere
+     */
+    class TextureCache {
+      private:
+        /**
+         * @brief The parameters of a guest texture which have to be identical for a host texture to be reused
+         */
+        struct Key {
+            u64 address;
+            u32 width;
+            u32 height;
+            vk::Format format;
+            texture::TileMode tileMode;
+            u32 pitch; //!< The pitch of the texture, this is 0 unless it's pitch-linear
+            u16 surfaceWidth; //!< The width of the surface in samples, this is 0 unless it's block-linear
+            u8 blockHeight; //!< The height of the blocks in GOBs, this is 0 unless it's block-linear
+            u8 blockDepth; //!< The depth of the blocks in GOBs, this is 0 unless it's block-linear
+
+            Key(u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tileMode, texture::TileConfig tileConfig);
+
+            bool operator==(const Key &) const = default;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const;
+        };
+
+        const DeviceState &state;
+        std::mutex mutex; //!< Synchronizes access to presentationTextures
+        std::unordered_map<Key, std::weak_ptr<PresentationTexture>, KeyHash> presentationTextures;
+
+      public:
+        TextureCache(const DeviceState &state);
+
+        /**
+         * @return A presentation texture for a guest texture with the supplied parameters, an existing one is returned if there's one with identical parameters
+         * @param previous The texture that the new one replaces, its host copy's storage is reused for a newly created texture if nothing else references it
+         */
+        std::shared_ptr<PresentationTexture> GetPresentationTexture(u64 address, texture::Dimensions dimensions, texture::Format format, texture::TileMode tileMode, texture::TileConfig tileConfig, std::shared_ptr<PresentationTexture> previous = nullptr);
+
+        /**
+         * @brief Invalidates the host copies of all textures which overlap a region of guest memory, this must be called after the region has been written to by the GPU
+         * @param address The CPU address of the region
+         * @param size The size of the region in bytes
+         */
+        void Invalidate(u64 address, u64 size);
+
+        /**
+         * @brief Invalidates the host copies of all textures which overlap a region of the GPU virtual address space, this must be called after the region has been written to by the GPU
+         * @param address The GPU address of the region
+         * @param size The size of the region in bytes
+         */
+        void InvalidateGpu(u64 address, u64 size);
+    };
+}
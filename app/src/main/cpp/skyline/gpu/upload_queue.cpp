@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "upload_queue.h"
+
+namespace skyline::gpu {
+    UploadQueue::UploadQueue(GPU &gpu) : gpu(gpu) {
+        if (!gpu.vkTransferQueueFamilyIndex)
+            throw exception("Cannot create an upload queue without a dedicated transfer queue");
+
+        auto &device{*gpu.vkDevice};
+        commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient, *gpu.vkTransferQueueFamilyIndex});
+        auto commandBuffers{device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{*commandPool, vk::CommandBufferLevel::ePrimary, BatchCount})};
+        for (size_t index{}; index < BatchCount; index++) {
+            batches[index].commandBuffer = std::move(commandBuffers[index]);
+            batches[index].fence = device.createFenceUnique(vk::FenceCreateInfo{});
+        }
+
+        vk::BufferCreateInfo bufferInfo{};
+        bufferInfo.size = StagingSize;
+        bufferInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        stagingBuffer = device.createBufferUnique(bufferInfo);
+
+        auto requirements{device.getBufferMemoryRequirements(*stagingBuffer)};
+        auto memoryProperties{gpu.vkPhysicalDevice.getMemoryProperties()};
+        constexpr vk::MemoryPropertyFlags StagingMemoryFlags{vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent};
+
+        std::optional<u32> memoryType;
+        for (u32 index{}; index < memoryProperties.memoryTypeCount; index++) {
+            if ((requirements.memoryTypeBits & (1U << index)) && (memoryProperties.memoryTypes[index].propertyFlags & StagingMemoryFlags) == StagingMemoryFlags) {
+                memoryType = index;
+                break;
+            }
+        }
+        if (!memoryType)
+            throw exception("Cannot find a host-visible and host-coherent memory type for the upload staging ring");
+
+        stagingMemory = device.allocateMemoryUnique(vk::MemoryAllocateInfo{requirements.size, *memoryType});
+        device.bindBufferMemory(*stagingBuffer, *stagingMemory, 0);
+        stagingMapping = static_cast<u8 *>(device.mapMemory(*stagingMemory, 0, StagingSize));
+    }
+
+    UploadQueue::~UploadQueue() {
+        if (recording)
+            SubmitBatch();
+        for (auto &batch : batches)
+            WaitBatch(batch);
+        gpu.vkDevice->unmapMemory(*stagingMemory);
+    }
+
+    void UploadQueue::WaitBatch(Batch &batch) {
+        if (batch.inFlight) {
+            static_cast<void>(gpu.vkDevice->waitForFences(*batch.fence, true, std::numeric_limits<u64>::max()));
+            batch.inFlight = false;
+        }
+        batch.stagingSize = 0;
+    }
+
+    void UploadQueue::Begin() {
+        if (recording)
+            return;
+
+        auto &batch{batches[batchIndex]};
+        WaitBatch(batch);
+        batch.stagingOffset = stagingOffset;
+        batch.commandBuffer->begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        recording = true;
+    }
+
+    void UploadQueue::SubmitBatch() {
+        auto &batch{batches[batchIndex]};
+        batch.commandBuffer->end();
+        recording = false;
+
+        auto semaphore{gpu.vkDevice->createSemaphoreUnique(vk::SemaphoreCreateInfo{})};
+        vk::SubmitInfo submitInfo{};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &*batch.commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &*semaphore;
+
+        gpu.vkDevice->resetFences(*batch.fence);
+        {
+            std::lock_guard guard(gpu.queueMutex);
+            gpu.vkTransferQueue.submit(submitInfo, *batch.fence);
+        }
+        batch.inFlight = true;
+        semaphores.push_back(std::move(semaphore));
+
+        batchIndex = (batchIndex + 1) % BatchCount;
+    }
+
+    UploadQueue::Allocation UploadQueue::Allocate(vk::DeviceSize size) {
+        size = util::AlignUp(size, StagingAlignment);
+        if (size > StagingSize)
+            throw exception("An upload of 0x{:X} bytes doesn't fit into the staging ring", size);
+
+        auto offset{stagingOffset};
+        if (offset + size > StagingSize) {
+            // The region of a batch has to be contiguous, so the current batch is submitted rather than wrapping around within it
+            if (recording)
+                SubmitBatch();
+            offset = 0;
+        }
+        stagingOffset = offset;
+        Begin();
+
+        for (size_t index{}; index < BatchCount; index++) {
+            auto &batch{batches[index]};
+            if (index != batchIndex && batch.stagingSize && offset < batch.stagingOffset + batch.stagingSize && batch.stagingOffset < offset + size)
+                WaitBatch(batch);
+        }
+
+        auto &batch{batches[batchIndex]};
+        stagingOffset = offset + size;
+        batch.stagingSize = stagingOffset - batch.stagingOffset;
+        return Allocation{offset, stagingMapping + offset};
+    }
+
+    void UploadQueue::CopyToBuffer(const Allocation &allocation, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size) {
+        batches[batchIndex].commandBuffer->copyBuffer(*stagingBuffer, buffer, vk::BufferCopy{allocation.offset, offset, size});
+    }
+
+    std::vector<vk::UniqueSemaphore> UploadQueue::TakeSemaphores() {
+        if (recording)
+            SubmitBatch();
+        return std::move(semaphores);
+    }
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <common.h>
+
+namespace skyline::gpu {
+    class GPU;
+
+    /**
+     * @brief The UploadQueue records uploads from a persistent staging ring onto the dedicated transfer queue, so they run on the device's copy engines alongside rendering rather than in between it
+     * @note Every submitted batch signals its own semaphore, the submission that depends on the uploads takes ownership of these and waits on them so work which doesn't depend on them never waits
+     * @note This must only be used by a single thread, which is the GPFIFO thread
+     */
+    class UploadQueue {
+      private:
+        static constexpr size_t BatchCount{4}; //!< The maximum amount of batches that can be in flight at once
+        static constexpr vk::DeviceSize StagingSize{0x2000000}; //!< The size of the staging ring in bytes
+        static constexpr vk::DeviceSize StagingAlignment{0x100}; //!< The alignment of every allocation from the staging ring, this satisfies the optimal copy offset alignment of all devices
+
+        /**
+         * @brief The resources of a single submission of uploads which can't be reused until the device is done with it
+         */
+        struct Batch {
+            vk::UniqueCommandBuffer commandBuffer;
+            vk::UniqueFence fence; //!< Signalled once the device is done with the batch
+            vk::DeviceSize stagingOffset{}; //!< The offset of the batch's region in the staging ring
+            vk::DeviceSize stagingSize{}; //!< The size of the batch's region in the staging ring, this is 0 if the batch isn't using it
+            bool inFlight{}; //!< If the batch has been submitted and its fence hasn't been waited on since
+        };
+
+        GPU &gpu;
+        vk::UniqueCommandPool commandPool;
+        std::array<Batch, BatchCount> batches;
+        size_t batchIndex{}; //!< The index of the batch in batches which is recorded into
+        bool recording{}; //!< If the current batch has been begun and not submitted yet
+        vk::UniqueBuffer stagingBuffer;
+        vk::UniqueDeviceMemory stagingMemory;
+        u8 *stagingMapping{}; //!< A persistent host mapping of stagingMemory
+        vk::DeviceSize stagingOffset{}; //!< The offset in the staging ring that the next allocation starts at
+        std::vector<vk::UniqueSemaphore> semaphores; //!< The semaphores of all batches submitted since they were last taken
+
+        /**
+         * @brief Waits for the device to be done with a batch, its region of the staging ring is free after this
+         */
+        void WaitBatch(Batch &batch);
+
+        /**
+         * @brief Begins recording into the current batch if it isn't being recorded into already
+         */
+        void Begin();
+
+        /**
+         * @brief Submits the current batch, its semaphore is added to the ones returned by TakeSemaphores()
+         */
+        void SubmitBatch();
+
+      public:
+        /**
+         * @brief A region of the staging ring which is valid until the batch it was allocated in is submitted
+         */
+        struct Allocation {
+            vk::DeviceSize offset;
+            u8 *pointer; //!< A host mapping of the region, it's host-coherent so writes don't need to be flushed
+        };
+
+        UploadQueue(GPU &gpu);
+
+        /**
+         * @note The device is waited on prior to any resource being destroyed
+         */
+        ~UploadQueue();
+
+        /**
+         * @brief Allocates a region of the staging ring, this waits on any in-flight batches which are still using the region
+         * @note The current batch is submitted if the ring wraps around, so this must be called before recording the upload that uses it
+         */
+        Allocation Allocate(vk::DeviceSize size);
+
+        /**
+         * @brief Records a copy from the staging ring into a buffer, it's only visible to work which waits on the semaphores from TakeSemaphores()
+         * @note The buffer must be shared concurrently between the transfer queue family and the family which reads it
+         */
+        void CopyToBuffer(const Allocation &allocation, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size);
+
+        /**
+         * @brief Submits all recorded uploads and transfers ownership of the semaphores of every batch submitted since this was last called to the caller
+         * @return The semaphores, these must all be waited on by a single submission and can be destroyed once the device is done with it
+         */
+        std::vector<vk::UniqueSemaphore> TakeSemaphores();
+    };
+}
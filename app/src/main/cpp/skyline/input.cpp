@@ -1,8 +1,49 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include "os.h"
+#include "benchmark.h"
+#include "statistics.h"
+#include "allocation.h"
 #include "input.h"
 
 namespace skyline::input {
-    Input::Input(const DeviceState &state) : state(state), kHid(std::make_shared<kernel::type::KSharedMemory>(state, NULL, sizeof(HidSharedMemory), memory::Permission(true, false, false))), hid(reinterpret_cast<HidSharedMemory *>(kHid->kernel.address)), npad(state, hid), touch(state, hid) {}
+    Input::Input(const DeviceState &state) : state(state), kHid(std::make_shared<kernel::type::KSharedMemory>(state, NULL, sizeof(HidSharedMemory), memory::Permission(true, false, false))), hid(reinterpret_cast<HidSharedMemory *>(kHid->kernel.address)), npad(state, hid), touch(state, hid) {
+        if (state.benchmark && !state.benchmark->inputPath.empty())
+            recording.emplace(state.benchmark->inputPath, InputRecording::Mode::Replay);
+        else if (state.settings->GetBool("record_input", false))
+            recording.emplace(state.os->appFilesPath + "input_recording.bin", InputRecording::Mode::Record);
+
+        samplingThread = std::thread(&Input::SamplingThread, this);
+    }
+
+    Input::~Input() {
+        {
+            std::lock_guard guard(samplingMutex);
+            running = false;
+        }
+        samplingCondition.notify_one();
+        samplingThread.join();
+    }
+
+    void Input::SamplingThread() {
+        pthread_setname_np(pthread_self(), "Sky-Input");
+        allocation::Scope allocationScope(allocation::Tag::Input);
+
+        auto deadline{std::chrono::steady_clock::now()};
+        std::unique_lock lock(samplingMutex);
+        while (running) {
+            // Every input shares the timestamp of the tick, so the guest sees all of them as being sampled at the same time
+            auto timestamp{util::GetTimeTicks()};
+            if (recording)
+                recording->Update(state.statistics->queuedFrames.load(std::memory_order_relaxed), npad, touch);
+            npad.UpdateSharedMemory(timestamp);
+            touch.UpdateSharedMemory(timestamp);
+
+            // The deadline is reset rather than caught up with if the thread was delayed by over a period, so the guest doesn't get a burst of entries
+            auto now{std::chrono::steady_clock::now()};
+            deadline = std::max(deadline + SamplingPeriod, now - SamplingPeriod);
+            samplingCondition.wait_until(lock, deadline, [this]() { return !running; });
+        }
+    }
 }
@@ -8,6 +8,7 @@
 #include "input/shared_mem.h"
 #include "input/npad.h"
 #include "input/touch.h"
+#include "input/recording.h"
 
 namespace skyline::input {
     /**
@@ -17,6 +18,18 @@ namespace skyline::input {
       private:
         const DeviceState &state;
 
+        static constexpr std::chrono::milliseconds SamplingPeriod{5}; //!< The period at which the host state is sampled into shared memory, this matches the rate HOS samples NPads at
+        std::mutex samplingMutex;
+        std::condition_variable samplingCondition; //!< Signalled when the sampling thread should exit
+        bool running{true};
+        std::optional<InputRecording> recording; //!< The recording that input is written to or replayed from, if any
+        std::thread samplingThread; //!< The thread which writes the staged host state into shared memory every SamplingPeriod, it's started last as it accesses all other members
+
+        /**
+         * @brief The loop of the sampling thread, it writes a single entry for every controller and the touch-screen every SamplingPeriod until Input is destroyed
+         */
+        void SamplingThread();
+
       public:
         std::shared_ptr<kernel::type::KSharedMemory> kHid; //!< The kernel shared memory object for HID Shared Memory
         HidSharedMemory *hid; //!< A pointer to HID Shared Memory on the host
@@ -25,5 +38,14 @@ namespace skyline::input {
         TouchManager touch;
 
         Input(const DeviceState &state);
+
+        /**
+         * @return If input is being replayed from a recording, host input must be ignored while this is the case
+         */
+        bool IsReplaying() {
+            return recording && recording->IsReplaying();
+        }
+
+        ~Input();
     };
 }
@@ -5,7 +5,7 @@
 #include "npad.h"
 
 namespace skyline::input {
-    NpadManager::NpadManager(const DeviceState &state, input::HidSharedMemory *hid) : state(state), npads
+    NpadManager::NpadManager(const DeviceState &state, input::HidSharedMemory *hid) : state(state), vibration(state.jvm), npads
         {NpadDevice{*this, hid->npad[0], NpadId::Player1}, {*this, hid->npad[1], NpadId::Player2},
          {*this, hid->npad[2], NpadId::Player3}, {*this, hid->npad[3], NpadId::Player4},
          {*this, hid->npad[4], NpadId::Player5}, {*this, hid->npad[5], NpadId::Player6},
@@ -104,4 +104,11 @@ namespace skyline::input {
         for (auto &controller : controllers)
             controller.device = nullptr;
     }
+
+    void NpadManager::UpdateSharedMemory(u64 timestamp) {
+        std::lock_guard guard(mutex);
+
+        for (auto &npad : npads)
+            npad.UpdateSharedMemory(timestamp);
+    }
 }
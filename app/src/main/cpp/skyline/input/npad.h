@@ -4,6 +4,7 @@
 #pragma once
 
 #include "npad_device.h"
+#include "vibration.h"
 
 namespace skyline::input {
     /**
@@ -43,6 +44,7 @@ namespace skyline::input {
 
       public:
         std::recursive_mutex mutex; //!< This mutex must be locked before any modifications to class members
+        VibrationQueue vibration; //!< The queue all NPads play their vibrations through
         std::array<NpadDevice, constant::NpadCount> npads;
         std::array<GuestController, constant::ControllerCount> controllers;
         std::vector<NpadId> supportedIds; //!< The NPadId(s) that are supported by the application
@@ -83,5 +85,11 @@ namespace skyline::input {
          * @brief Disables any activate mappings from guest controllers -> players till Activate has been called
          */
         void Deactivate();
+
+        /**
+         * @brief Writes an entry with the latest staged state of every connected NPad into shared memory
+         * @param timestamp The timestamp of the sampling tick in ticks
+         */
+        void UpdateSharedMemory(u64 timestamp);
     };
 }
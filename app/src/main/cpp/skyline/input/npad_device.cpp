@@ -1,7 +1,6 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include <jvm.h>
 #include "npad_device.h"
 #include "npad.h"
 
@@ -28,6 +27,11 @@ namespace skyline::input {
         section = {};
         controllerInfo = nullptr;
 
+        // The state of the previous controller shouldn't carry over into the entries of a new one
+        stagedButtons.store(0, std::memory_order_relaxed);
+        for (auto &axis : stagedAxes)
+            axis.store(0, std::memory_order_relaxed);
+
         connectionState = {.connected = true};
 
         switch (newType) {
@@ -142,9 +146,8 @@ namespace skyline::input {
         type = newType;
         controllerInfo = &GetControllerInfo();
 
-        GetNextEntry(*controllerInfo);
-        GetNextEntry(section.defaultController);
-        globalTimestamp++;
+        // An initial entry is written right away, so the guest never sees a connected controller without any entries before the next sampling tick
+        UpdateSharedMemory(util::GetTimeTicks());
 
         updateEvent->Signal();
     }
@@ -182,173 +185,133 @@ namespace skyline::input {
         }
     }
 
-    NpadControllerState &NpadDevice::GetNextEntry(NpadControllerInfo &info) {
-        auto &lastEntry{info.state.at(info.header.currentEntry)};
-
-        info.header.timestamp = util::GetTimeTicks();
-        info.header.entryCount = std::min(static_cast<u8>(info.header.entryCount + 1), constant::HidEntryCount);
-        info.header.currentEntry = (info.header.currentEntry != constant::HidEntryCount - 1) ? info.header.currentEntry + 1 : 0;
+    /**
+     * @return The mask of buttons with a single Joy-Con's buttons rotated to match it being held horizontally
+     */
+    static NpadButton OrientButtons(NpadButton mask) {
+        NpadButton orientedMask{};
+
+        if (mask.dpadUp)
+            orientedMask.dpadLeft = true;
+        if (mask.dpadDown)
+            orientedMask.dpadRight = true;
+        if (mask.dpadLeft)
+            orientedMask.dpadDown = true;
+        if (mask.dpadRight)
+            orientedMask.dpadUp = true;
+
+        if (mask.leftSl || mask.rightSl)
+            orientedMask.l = true;
+        if (mask.leftSr || mask.rightSr)
+            orientedMask.r = true;
+
+        orientedMask.a = mask.a;
+        orientedMask.b = mask.b;
+        orientedMask.x = mask.x;
+        orientedMask.y = mask.y;
+        orientedMask.leftStick = mask.leftStick;
+        orientedMask.rightStick = mask.rightStick;
+        orientedMask.plus = mask.plus;
+        orientedMask.minus = mask.minus;
+        orientedMask.leftSl = mask.leftSl;
+        orientedMask.leftSr = mask.leftSr;
+        orientedMask.rightSl = mask.rightSl;
+        orientedMask.rightSr = mask.rightSr;
+
+        return orientedMask;
+    }
 
-        auto &entry{info.state.at(info.header.currentEntry)};
+    NpadControllerState &NpadDevice::StageNextEntry(NpadControllerInfo &info) {
+        auto &lastEntry{info.state.at(info.header.currentEntry)};
+        auto &entry{info.state.at((info.header.currentEntry != constant::HidEntryCount - 1) ? info.header.currentEntry + 1 : 0)};
 
         entry.globalTimestamp = globalTimestamp;
         entry.localTimestamp = lastEntry.localTimestamp + 1;
-        entry.buttons = lastEntry.buttons;
-        entry.leftX = lastEntry.leftX;
-        entry.leftY = lastEntry.leftY;
-        entry.rightX = lastEntry.rightX;
-        entry.rightY = lastEntry.rightY;
         entry.status.raw = connectionState.raw;
 
         return entry;
     }
 
-    void NpadDevice::SetButtonState(NpadButton mask, bool pressed) {
-        if (!connectionState.connected)
-            return;
-
-        auto &entry{GetNextEntry(*controllerInfo)};
+    void NpadDevice::PublishEntry(NpadControllerInfo &info, u64 timestamp) {
+        info.header.timestamp = timestamp;
+        info.header.entryCount = std::min(static_cast<u8>(info.header.entryCount + 1), constant::HidEntryCount);
+        __atomic_store_n(&info.header.currentEntry, (info.header.currentEntry != constant::HidEntryCount - 1) ? info.header.currentEntry + 1 : 0, __ATOMIC_RELEASE);
+    }
 
-        if (pressed)
-            entry.buttons.raw |= mask.raw;
-        else
-            entry.buttons.raw &= ~mask.raw;
+    /**
+     * @brief Sets the stick direction buttons of an entry based on its stick values
+     */
+    static void SetStickButtons(NpadControllerState &entry) {
+        constexpr i16 threshold{std::numeric_limits<i16>::max() / 2}; // A 50% deadzone for the stick buttons
 
-        if (manager.orientation == NpadJoyOrientation::Horizontal && (type == NpadControllerType::JoyconLeft || type == NpadControllerType::JoyconRight)) {
-            NpadButton orientedMask{};
-
-            if (mask.dpadUp)
-                orientedMask.dpadLeft = true;
-            if (mask.dpadDown)
-                orientedMask.dpadRight = true;
-            if (mask.dpadLeft)
-                orientedMask.dpadDown = true;
-            if (mask.dpadRight)
-                orientedMask.dpadUp = true;
-
-            if (mask.leftSl || mask.rightSl)
-                orientedMask.l = true;
-            if (mask.leftSr || mask.rightSr)
-                orientedMask.r = true;
-
-            orientedMask.a = mask.a;
-            orientedMask.b = mask.b;
-            orientedMask.x = mask.x;
-            orientedMask.y = mask.y;
-            orientedMask.leftStick = mask.leftStick;
-            orientedMask.rightStick = mask.rightStick;
-            orientedMask.plus = mask.plus;
-            orientedMask.minus = mask.minus;
-            orientedMask.leftSl = mask.leftSl;
-            orientedMask.leftSr = mask.leftSr;
-            orientedMask.rightSl = mask.rightSl;
-            orientedMask.rightSr = mask.rightSr;
-
-            mask = orientedMask;
-        }
+        entry.buttons.leftStickLeft = entry.leftX <= -threshold;
+        entry.buttons.leftStickRight = entry.leftX >= threshold;
+        entry.buttons.leftStickUp = entry.leftY >= threshold;
+        entry.buttons.leftStickDown = entry.leftY <= -threshold;
+        entry.buttons.rightStickLeft = entry.rightX <= -threshold;
+        entry.buttons.rightStickRight = entry.rightX >= threshold;
+        entry.buttons.rightStickUp = entry.rightY >= threshold;
+        entry.buttons.rightStickDown = entry.rightY <= -threshold;
+    }
 
-        auto &defaultEntry{GetNextEntry(section.defaultController)};
-        if (pressed)
-            defaultEntry.buttons.raw |= mask.raw;
-        else
-            defaultEntry.buttons.raw &= ~mask.raw;
+    void NpadDevice::SetState(NpadButton buttons, i32 leftX, i32 leftY, i32 rightX, i32 rightY) {
+        stagedButtons.store(buttons.raw, std::memory_order_relaxed);
+        stagedAxes[static_cast<size_t>(NpadAxisId::LX)].store(leftX, std::memory_order_relaxed);
+        stagedAxes[static_cast<size_t>(NpadAxisId::LY)].store(leftY, std::memory_order_relaxed);
+        stagedAxes[static_cast<size_t>(NpadAxisId::RX)].store(rightX, std::memory_order_relaxed);
+        stagedAxes[static_cast<size_t>(NpadAxisId::RY)].store(rightY, std::memory_order_relaxed);
+    }
 
-        globalTimestamp++;
+    NpadDevice::StagedState NpadDevice::GetStagedState() {
+        StagedState staged{.buttons = stagedButtons.load(std::memory_order_relaxed)};
+        for (size_t axis{}; axis < staged.axes.size(); axis++)
+            staged.axes[axis] = stagedAxes[axis].load(std::memory_order_relaxed);
+        return staged;
     }
 
-    void NpadDevice::SetAxisValue(NpadAxisId axis, i32 value) {
+    void NpadDevice::UpdateSharedMemory(u64 timestamp) {
         if (!connectionState.connected)
             return;
 
-        auto &controllerEntry{GetNextEntry(*controllerInfo)};
-        auto &defaultEntry{GetNextEntry(section.defaultController)};
+        NpadButton buttons{.raw = stagedButtons.load(std::memory_order_relaxed)};
+        auto leftX{stagedAxes[static_cast<size_t>(NpadAxisId::LX)].load(std::memory_order_relaxed)};
+        auto leftY{stagedAxes[static_cast<size_t>(NpadAxisId::LY)].load(std::memory_order_relaxed)};
+        auto rightX{stagedAxes[static_cast<size_t>(NpadAxisId::RX)].load(std::memory_order_relaxed)};
+        auto rightY{stagedAxes[static_cast<size_t>(NpadAxisId::RY)].load(std::memory_order_relaxed)};
 
-        constexpr i16 threshold{std::numeric_limits<i16>::max() / 2}; // A 50% deadzone for the stick buttons
+        auto &controllerEntry{StageNextEntry(*controllerInfo)};
+        auto &defaultEntry{StageNextEntry(section.defaultController)};
 
-        if (manager.orientation == NpadJoyOrientation::Vertical || (type != NpadControllerType::JoyconLeft && type != NpadControllerType::JoyconRight)) {
-            switch (axis) {
-                case NpadAxisId::LX:
-                    controllerEntry.leftX = value;
-                    defaultEntry.leftX = value;
-
-                    controllerEntry.buttons.leftStickLeft = controllerEntry.leftX <= -threshold;
-                    defaultEntry.buttons.leftStickLeft = controllerEntry.buttons.leftStickLeft;
-
-                    controllerEntry.buttons.leftStickRight = controllerEntry.leftX >= threshold;
-                    defaultEntry.buttons.leftStickRight = controllerEntry.buttons.leftStickRight;
-                    break;
-                case NpadAxisId::LY:
-                    controllerEntry.leftY = value;
-                    defaultEntry.leftY = value;
-
-                    defaultEntry.buttons.leftStickUp = controllerEntry.buttons.leftStickUp;
-                    controllerEntry.buttons.leftStickUp = controllerEntry.leftY >= threshold;
-
-                    controllerEntry.buttons.leftStickDown = controllerEntry.leftY <= -threshold;
-                    defaultEntry.buttons.leftStickDown = controllerEntry.buttons.leftStickDown;
-                    break;
-                case NpadAxisId::RX:
-                    controllerEntry.rightX = value;
-                    defaultEntry.rightX = value;
-
-                    controllerEntry.buttons.rightStickLeft = controllerEntry.rightX <= -threshold;
-                    defaultEntry.buttons.rightStickLeft = controllerEntry.buttons.rightStickLeft;
-
-                    controllerEntry.buttons.rightStickRight = controllerEntry.rightX >= threshold;
-                    defaultEntry.buttons.rightStickRight = controllerEntry.buttons.rightStickRight;
-                    break;
-                case NpadAxisId::RY:
-                    controllerEntry.rightY = value;
-                    defaultEntry.rightY = value;
-
-                    controllerEntry.buttons.rightStickUp = controllerEntry.rightY >= threshold;
-                    defaultEntry.buttons.rightStickUp = controllerEntry.buttons.rightStickUp;
-
-                    controllerEntry.buttons.rightStickDown = controllerEntry.rightY <= -threshold;
-                    defaultEntry.buttons.rightStickDown = controllerEntry.buttons.rightStickDown;
-                    break;
-            }
+        defaultEntry.leftX = leftX;
+        defaultEntry.leftY = leftY;
+        defaultEntry.rightX = rightX;
+        defaultEntry.rightY = rightY;
+
+        if (manager.orientation == NpadJoyOrientation::Horizontal && (type == NpadControllerType::JoyconLeft || type == NpadControllerType::JoyconRight)) {
+            controllerEntry.buttons = buttons;
+            controllerEntry.leftX = -leftY;
+            controllerEntry.leftY = leftX;
+            controllerEntry.rightX = -rightY;
+            controllerEntry.rightY = rightX;
+
+            defaultEntry.buttons = OrientButtons(buttons);
         } else {
-            switch (axis) {
-                case NpadAxisId::LX:
-                    controllerEntry.leftY = value;
-                    controllerEntry.buttons.leftStickUp = controllerEntry.leftY >= threshold;
-                    controllerEntry.buttons.leftStickDown = controllerEntry.leftY <= -threshold;
-
-                    defaultEntry.leftX = value;
-                    defaultEntry.buttons.leftStickLeft = defaultEntry.leftX <= -threshold;
-                    defaultEntry.buttons.leftStickRight = defaultEntry.leftX >= threshold;
-                    break;
-                case NpadAxisId::LY:
-                    controllerEntry.leftX = -value;
-                    controllerEntry.buttons.leftStickLeft = controllerEntry.leftX <= -threshold;
-                    controllerEntry.buttons.leftStickRight = controllerEntry.leftX >= threshold;
-
-                    defaultEntry.leftY = value;
-                    defaultEntry.buttons.leftStickUp = defaultEntry.leftY >= threshold;
-                    defaultEntry.buttons.leftStickDown = defaultEntry.leftY <= -threshold;
-                    break;
-                case NpadAxisId::RX:
-                    controllerEntry.rightY = value;
-                    controllerEntry.buttons.rightStickUp = controllerEntry.rightY >= threshold;
-                    controllerEntry.buttons.rightStickDown = controllerEntry.rightY <= -threshold;
-
-                    defaultEntry.rightX = value;
-                    defaultEntry.buttons.rightStickLeft = defaultEntry.rightX <= -threshold;
-                    defaultEntry.buttons.rightStickRight = defaultEntry.rightX >= threshold;
-                    break;
-                case NpadAxisId::RY:
-                    controllerEntry.rightX = -value;
-                    controllerEntry.buttons.rightStickLeft = controllerEntry.rightX <= -threshold;
-                    controllerEntry.buttons.rightStickRight = controllerEntry.rightX >= threshold;
-
-                    defaultEntry.rightY = value;
-                    defaultEntry.buttons.rightStickUp = defaultEntry.rightY >= threshold;
-                    defaultEntry.buttons.rightStickDown = defaultEntry.rightY <= -threshold;
-                    break;
-            }
+            controllerEntry.buttons = buttons;
+            controllerEntry.leftX = leftX;
+            controllerEntry.leftY = leftY;
+            controllerEntry.rightX = rightX;
+            controllerEntry.rightY = rightY;
+
+            defaultEntry.buttons = buttons;
         }
 
+        SetStickButtons(controllerEntry);
+        SetStickButtons(defaultEntry);
+
+        // The entries are only made visible to the guest by advancing the headers after they have been completely written, so it never observes a partial snapshot
+        PublishEntry(*controllerInfo, timestamp);
+        PublishEntry(section.defaultController, timestamp);
+
         globalTimestamp++;
     }
 
@@ -362,7 +325,7 @@ namespace skyline::input {
     };
 
     template<size_t Size>
-    void VibrateDevice(const std::shared_ptr<JvmManager> &jvm, i8 index, std::array<VibrationInfo, Size> vibrations) {
+    void VibrateDevice(VibrationQueue &queue, i8 index, std::array<VibrationInfo, Size> vibrations) {
         jlong totalTime{};
         std::sort(vibrations.begin(), vibrations.end(), [](const VibrationInfo &a, const VibrationInfo &b) {
             return a.period < b.period;
@@ -374,13 +337,14 @@ namespace skyline::input {
 
         // If this vibration is essentially null then we don't play rather clear any running vibrations
         if (totalAmplitude == 0 || vibrations[3].period == 0) {
-            jvm->ClearVibrationDevice(index);
+            queue.Queue(index, VibrationPattern{});
             return;
         }
 
-        // We output an approximation of the combined + linearized vibration data into these arrays, larger arrays would allow for more accurate reproduction of data
-        std::array<jlong, 50> timings;
-        std::array<jint, 50> amplitudes;
+        // We output an approximation of the combined + linearized vibration data into the pattern
+        VibrationPattern pattern;
+        auto &timings{pattern.timings};
+        auto &amplitudes{pattern.amplitudes};
 
         // We are essentially unrolling the bands into a linear sequence, due to the data not being always linearizable there will be inaccuracies at the ends unless there's a pattern that's repeatable which will happen when all band's frequencies are factors of each other
         u8 i{};
@@ -412,15 +376,16 @@ namespace skyline::input {
             amplitudes[i] = std::min(totalAmplitude, constant::AmplitudeMax);
         }
 
-        jvm->VibrateDevice(index, span(timings.begin(), timings.begin() + i), span(amplitudes.begin(), amplitudes.begin() + i));
+        pattern.size = i;
+        queue.Queue(index, pattern);
     }
 
-    void VibrateDevice(const std::shared_ptr<JvmManager> &jvm, i8 index, const NpadVibrationValue &value) {
+    void VibrateDevice(VibrationQueue &queue, i8 index, const NpadVibrationValue &value) {
         std::array<VibrationInfo, 2> vibrations{
             VibrationInfo{value.frequencyLow, value.amplitudeLow * (constant::AmplitudeMax / 2)},
             {value.frequencyHigh, value.amplitudeHigh * (constant::AmplitudeMax / 2)},
         };
-        VibrateDevice(jvm, index, vibrations);
+        VibrateDevice(queue, index, vibrations);
     }
 
     void NpadDevice::Vibrate(bool isRight, const NpadVibrationValue &value) {
@@ -432,7 +397,7 @@ namespace skyline::input {
         if (vibrationRight)
             Vibrate(vibrationLeft, *vibrationRight);
         else
-            VibrateDevice(manager.state.jvm, index, value);
+            VibrateDevice(manager.vibration, index, value);
     }
 
     void NpadDevice::Vibrate(const NpadVibrationValue &left, const NpadVibrationValue &right) {
@@ -443,10 +408,10 @@ namespace skyline::input {
                 {right.frequencyLow, right.amplitudeLow * (constant::AmplitudeMax / 4)},
                 {right.frequencyHigh, right.amplitudeHigh * (constant::AmplitudeMax / 4)},
             };
-            VibrateDevice<4>(manager.state.jvm, index, vibrations);
+            VibrateDevice<4>(manager.vibration, index, vibrations);
         } else {
-            VibrateDevice(manager.state.jvm, index, left);
-            VibrateDevice(manager.state.jvm, partnerIndex, right);
+            VibrateDevice(manager.vibration, index, left);
+            VibrateDevice(manager.vibration, partnerIndex, right);
         }
     }
 }
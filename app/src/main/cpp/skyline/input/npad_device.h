@@ -119,13 +119,22 @@ namespace skyline::input {
         NpadSection &section; //!< The section in HID shared memory for this controller
         NpadControllerInfo *controllerInfo; //!< The NpadControllerInfo for this controller's type
         u64 globalTimestamp{}; //!< An incrementing timestamp that's common across all sections
+        std::atomic<u64> stagedButtons{}; //!< The raw NpadButton mask of the latest host state, it's written into shared memory on the next sampling tick
+        std::array<std::atomic<i32>, 4> stagedAxes{}; //!< The values of the latest host state for every NpadAxisId
 
         /**
-         * @brief Updates the headers and creates a new entry in HID Shared Memory
+         * @brief Fills in the entry after the current one in HID Shared Memory without making it visible to the guest
          * @param info The controller info of the NPad that needs to be updated
-         * @return The next entry that has been created with values from the last entry
+         * @return The next entry, only the timestamps and status are filled in as the caller is expected to write all values
+         * @note PublishEntry must be called after the entry has been written
          */
-        NpadControllerState &GetNextEntry(NpadControllerInfo &info);
+        NpadControllerState &StageNextEntry(NpadControllerInfo &info);
+
+        /**
+         * @brief Updates the headers to point to the entry which was written after StageNextEntry
+         * @param timestamp The timestamp of the entry in ticks
+         */
+        void PublishEntry(NpadControllerInfo &info, u64 timestamp);
 
         /**
          * @return The NpadControllerInfo for this controller based on it's type
@@ -133,6 +142,16 @@ namespace skyline::input {
         NpadControllerInfo &GetControllerInfo();
 
       public:
+        /**
+         * @brief The host state of the controller which is staged for the next sampling tick
+         */
+        struct StagedState {
+            u64 buttons; //!< The raw NpadButton mask
+            std::array<i32, 4> axes; //!< The values of every NpadAxisId
+
+            bool operator==(const StagedState &) const = default;
+        };
+
         NpadId id;
         i8 index{constant::NullIndex}; //!< The index of the device assigned to this player
         i8 partnerIndex{constant::NullIndex}; //!< The index of a partner device, if present
@@ -163,18 +182,27 @@ namespace skyline::input {
         void Disconnect();
 
         /**
-         * @brief Changes the state of buttons to the specified state
-         * @param mask A bit-field mask of all the buttons to change
-         * @param pressed If the buttons were pressed or released
+         * @brief Sets the entire state of the controller at once
+         * @param buttons A bit-field mask of all the buttons which are pressed, the stick direction buttons are derived from the axes
+         * @param leftX The value of the left stick's X axis
+         * @param leftY The value of the left stick's Y axis
+         * @param rightX The value of the right stick's X axis
+         * @param rightY The value of the right stick's Y axis
+         * @note This only stages the state, it's written into shared memory on the next sampling tick
+         */
+        void SetState(NpadButton buttons, i32 leftX, i32 leftY, i32 rightX, i32 rightY);
+
+        /**
+         * @return The latest host state which has been staged, this is used to record input
          */
-        void SetButtonState(NpadButton mask, bool pressed);
+        StagedState GetStagedState();
 
         /**
-         * @brief Sets the value of an axis to the specified value
-         * @param axis The axis to set the value of
-         * @param value The value to set
+         * @brief Writes a single entry with the latest staged state into shared memory, if the controller is connected
+         * @param timestamp The timestamp of the sampling tick in ticks
+         * @note The mutex of the NpadManager must be locked when calling this
          */
-        void SetAxisValue(NpadAxisId axis, i32 value);
+        void UpdateSharedMemory(u64 timestamp);
 
         void Vibrate(bool isRight, const NpadVibrationValue &value);
 
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <bitset>
+#include "recording.h"
+
+namespace skyline::input {
+    InputRecording::InputRecording(const std::string &path, Mode mode) : mode(mode) {
+        if (mode == Mode::Record) {
+            file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw exception("Cannot open the input recording for writing: {}", path);
+
+            std::array<u32, 2> header{Magic, Version};
+            file.write(reinterpret_cast<const char *>(header.data()), sizeof(header));
+        } else {
+            file.open(path, std::ios::in | std::ios::binary);
+            if (!file)
+                throw exception("Cannot open the input recording for reading: {}", path);
+
+            std::array<u32, 2> header{};
+            file.read(reinterpret_cast<char *>(header.data()), sizeof(header));
+            if (!file || header[0] != Magic)
+                throw exception("The input recording is invalid: {}", path);
+            if (header[1] != Version)
+                throw exception("The input recording has an unsupported version: {} (Expected {})", header[1], Version);
+
+            ReadHeader();
+        }
+    }
+
+    void InputRecording::WriteRecord(u64 frame, u8 target, u8 count, const void *payload, size_t size) {
+        RecordHeader header{.frame = frame, .target = target, .count = count};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(payload), static_cast<std::streamsize>(size));
+    }
+
+    void InputRecording::ReadHeader() {
+        RecordHeader header;
+        if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) && header.target <= TouchTarget && header.count <= constant::MaxTouchPoints)
+            pending = header;
+        else
+            pending.reset(); // Any truncated or corrupt record ends the replay, the last replayed state stays staged
+    }
+
+    void InputRecording::Update(u64 frame, NpadManager &npad, TouchManager &touch) {
+        if (mode == Mode::Record) {
+            for (u8 index{}; index < constant::NpadCount; index++) {
+                auto staged{npad.npads[index].GetStagedState()};
+                if (staged != npadStates[index]) {
+                    npadStates[index] = staged;
+                    WriteRecord(frame, index, 0, &staged, sizeof(staged));
+                }
+            }
+
+            std::array<TouchScreenPoint, constant::MaxTouchPoints> points;
+            auto count{touch.GetStagedState(points)};
+            if (count != touchCount || !std::equal(points.begin(), points.begin() + count, touchPoints.begin())) {
+                touchPoints = points;
+                touchCount = count;
+                WriteRecord(frame, TouchTarget, static_cast<u8>(count), points.data(), count * sizeof(TouchScreenPoint));
+            }
+            return;
+        }
+
+        // Replaying stops at the first record for a target which was already changed during this tick, so every change is sampled at least once
+        std::bitset<TouchTarget + 1> changed;
+        while (pending && pending->frame <= frame && !changed.test(pending->target)) {
+            auto target{pending->target};
+            changed.set(target);
+
+            if (target == TouchTarget) {
+                touchCount = pending->count;
+                file.read(reinterpret_cast<char *>(touchPoints.data()), static_cast<std::streamsize>(touchCount * sizeof(TouchScreenPoint)));
+                touch.SetState(span(touchPoints.data(), touchCount));
+            } else {
+                auto &staged{npadStates[target]};
+                file.read(reinterpret_cast<char *>(&staged), sizeof(staged));
+                npad.npads[target].SetState(NpadButton{.raw = staged.buttons}, staged.axes[static_cast<size_t>(NpadAxisId::LX)], staged.axes[static_cast<size_t>(NpadAxisId::LY)], staged.axes[static_cast<size_t>(NpadAxisId::RX)], staged.axes[static_cast<size_t>(NpadAxisId::RY)]);
+            }
+
+            ReadHeader();
+        }
+    }
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <fstream>
+#include "npad.h"
+#include "touch.h"
+
+namespace skyline::input {
+    /**
+     * @brief A recording of the host input staged for HID shared memory, it's timed against the amount of frames the guest has queued rather than wall-clock time so replaying it reproduces the same scene regardless of how fast it runs
+     * @note Only changes of the staged state are recorded, at most a single change of every NPad and the touch-screen is replayed per sampling tick so presses which were released within a frame are still seen by the guest
+     * @note All functions must only be called from the sampling thread
+     */
+    class InputRecording {
+      public:
+        enum class Mode {
+            Record, //!< The staged state is written to the file on every change
+            Replay, //!< The staged state is read from the file and host input is ignored
+        };
+
+      private:
+        static constexpr u32 Magic{util::MakeMagic<u32>("SKIR")}; //!< The magic at the start of a recording
+        static constexpr u32 Version{1}; //!< The version of the format, recordings of any other version are rejected
+
+        /**
+         * @brief The header which precedes the payload of every record, it's followed by an NpadDevice::StagedState for NPads or count TouchScreenPoint for the touch-screen
+         */
+        struct RecordHeader {
+            u64 frame; //!< The amount of frames that were queued by the guest prior to the change
+            u8 target; //!< The index of the NPad in NpadManager::npads or TouchTarget for the touch-screen
+            u8 count; //!< The amount of touch points in the record, this is 0 for NPads
+            u8 _pad_[6];
+        };
+        static_assert(sizeof(RecordHeader) == 0x10);
+
+        static constexpr u8 TouchTarget{constant::NpadCount}; //!< The target of records for the touch-screen
+
+        Mode mode;
+        std::fstream file;
+        std::array<NpadDevice::StagedState, constant::NpadCount> npadStates{}; //!< The last recorded or replayed state of every NPad
+        std::array<TouchScreenPoint, constant::MaxTouchPoints> touchPoints{}; //!< The last recorded or replayed touch points
+        size_t touchCount{}; //!< The amount of points in touchPoints which are valid
+        std::optional<RecordHeader> pending; //!< The header of the next record to be replayed, its payload is read once it's due
+
+        void WriteRecord(u64 frame, u8 target, u8 count, const void *payload, size_t size);
+
+        /**
+         * @brief Reads the header of the next record into pending, it's cleared at the end of the recording
+         */
+        void ReadHeader();
+
+      public:
+        /**
+         * @param path The path of the file that's recorded to or replayed from
+         */
+        InputRecording(const std::string &path, Mode mode);
+
+        bool IsReplaying() {
+            return mode == Mode::Replay;
+        }
+
+        /**
+         * @brief Records any changes of the staged state or replays the records which are due, this must be called prior to the staged state being written into shared memory
+         * @param frame The amount of frames that have been queued by the guest so far
+         */
+        void Update(u64 frame, NpadManager &npad, TouchManager &touch);
+    };
+}
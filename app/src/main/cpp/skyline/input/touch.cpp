@@ -10,21 +10,40 @@ namespace skyline::input {
 
     void TouchManager::Activate() {
         activated = true;
-        SetState({});
     }
 
     void TouchManager::SetState(const span<TouchScreenPoint> &points) {
+        std::lock_guard guard(stagingMutex);
+        stagedCount = std::min(points.size(), constant::MaxTouchPoints);
+        std::copy_n(points.begin(), stagedCount, stagedPoints.begin());
+    }
+
+    size_t TouchManager::GetStagedState(std::array<TouchScreenPoint, constant::MaxTouchPoints> &points) {
+        std::lock_guard guard(stagingMutex);
+        std::copy_n(stagedPoints.begin(), stagedCount, points.begin());
+        return stagedCount;
+    }
+
+    void TouchManager::UpdateSharedMemory(u64 timestamp) {
         if (!activated)
             return;
 
+        std::array<TouchScreenPoint, constant::MaxTouchPoints> points;
+        size_t count;
+        {
+            std::lock_guard guard(stagingMutex);
+            count = stagedCount;
+            std::copy_n(stagedPoints.begin(), count, points.begin());
+        }
+
         const auto& lastEntry{section.entries[section.header.currentEntry]};
         auto entryIndex{(section.header.currentEntry != constant::HidEntryCount - 1) ? section.header.currentEntry + 1 : 0};
         auto& entry{section.entries[entryIndex]};
         entry.globalTimestamp = lastEntry.globalTimestamp + 1;
         entry.localTimestamp = lastEntry.localTimestamp + 1;
-        entry.touchCount = points.size();
+        entry.touchCount = count;
 
-        for (size_t i{}; i < points.size(); i++) {
+        for (size_t i{}; i < count; i++) {
             const auto& host{points[i]};
             auto& guest{entry.data[i]};
             guest.index = i;
@@ -35,8 +54,8 @@ namespace skyline::input {
             guest.angle = host.angle;
         }
 
-        section.header.timestamp = util::GetTimeTicks();
+        section.header.timestamp = timestamp;
         section.header.entryCount = std::min(static_cast<u8>(section.header.entryCount + 1), constant::HidEntryCount);
-        section.header.currentEntry = entryIndex;
+        __atomic_store_n(&section.header.currentEntry, entryIndex, __ATOMIC_RELEASE);
     }
 }
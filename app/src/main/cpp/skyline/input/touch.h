@@ -5,6 +5,10 @@
 
 #include "shared_mem.h"
 
+namespace skyline::constant {
+    constexpr size_t MaxTouchPoints{16}; //!< The maximum amount of points in a single TouchScreenState
+}
+
 namespace skyline::input {
     /*
      * @brief A description of a point being touched on the screen
@@ -17,6 +21,8 @@ namespace skyline::input {
         jint minor;
         jint major;
         jint angle;
+
+        bool operator==(const TouchScreenPoint &) const = default;
     };
 
     /**
@@ -25,8 +31,11 @@ namespace skyline::input {
     class TouchManager {
       private:
         const DeviceState &state;
-        bool activated{};
+        std::atomic<bool> activated{}; //!< If the touch-screen section is written to, this is set by HID services while the sampling thread reads it
         TouchScreenSection &section;
+        std::mutex stagingMutex; //!< Synchronizes access to the staged points, it's only held for copying them in or out
+        std::array<TouchScreenPoint, constant::MaxTouchPoints> stagedPoints{}; //!< The latest points from the host, they're written into shared memory on the next sampling tick
+        size_t stagedCount{}; //!< The amount of points in stagedPoints which are valid
 
       public:
         /**
@@ -36,6 +45,23 @@ namespace skyline::input {
 
         void Activate();
 
+        /**
+         * @brief Stages the points which are currently being touched on the host, they're written into shared memory on the next sampling tick
+         * @note Any points beyond the amount the guest supports are dropped
+         */
         void SetState(const span<TouchScreenPoint> &points);
+
+        /**
+         * @brief Copies the points which are currently staged, this is used to record input
+         * @return The amount of points that were copied
+         */
+        size_t GetStagedState(std::array<TouchScreenPoint, constant::MaxTouchPoints> &points);
+
+        /**
+         * @brief Writes an entry with the latest staged points into shared memory
+         * @param timestamp The timestamp of the sampling tick in ticks
+         * @note This must only be called by a single thread at a time
+         */
+        void UpdateSharedMemory(u64 timestamp);
     };
 }
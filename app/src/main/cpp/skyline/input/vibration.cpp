@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "vibration.h"
+
+namespace skyline::input {
+    VibrationQueue::VibrationQueue(std::shared_ptr<JvmManager> jvm) : jvm(std::move(jvm)) {
+        thread = std::thread(&VibrationQueue::Run, this);
+    }
+
+    VibrationQueue::~VibrationQueue() {
+        {
+            std::lock_guard guard(mutex);
+            running = false;
+        }
+        condition.notify_one();
+        thread.join();
+    }
+
+    void VibrationQueue::Queue(i8 index, const VibrationPattern &pattern) {
+        if (index < 0 || index >= constant::ControllerCount)
+            return;
+
+        std::lock_guard guard(mutex);
+        devices[static_cast<size_t>(index)].pending = pattern;
+        queued = true;
+        condition.notify_one();
+    }
+
+    void VibrationQueue::Run() {
+        pthread_setname_np(pthread_self(), "Sky-Vibration");
+        jvm->AttachThread();
+
+        std::unique_lock lock(mutex);
+        while (running) {
+            queued = false;
+            auto now{std::chrono::steady_clock::now()};
+            std::optional<std::chrono::steady_clock::time_point> deadline;
+
+            for (size_t index{}; index < devices.size(); index++) {
+                auto &device{devices[index]};
+                if (!device.pending)
+                    continue;
+
+                // Games tend to resend the same values every frame, restarting the vibrator for those would only cause it to stutter
+                if (device.pending == device.current) {
+                    device.pending.reset();
+                    continue;
+                }
+
+                auto playTime{device.lastPlayed + MinimumPeriod};
+                if (playTime > now) {
+                    deadline = deadline ? std::min(*deadline, playTime) : playTime;
+                    continue;
+                }
+
+                auto pattern{*std::exchange(device.pending, std::nullopt)};
+                device.current = pattern;
+                device.lastPlayed = now;
+
+                // The JNI call is made without holding the mutex, so the guest is never blocked on it
+                lock.unlock();
+                if (pattern.size)
+                    jvm->VibrateDevice(static_cast<jint>(index), span(pattern.timings.data(), pattern.size), span(pattern.amplitudes.data(), pattern.size));
+                else
+                    jvm->ClearVibrationDevice(static_cast<jint>(index));
+                lock.lock();
+            }
+
+            // Devices which are rate-limited are only revisited once the earliest of them can be played again, unless another pattern is queued in the meantime
+            if (deadline)
+                condition.wait_until(lock, *deadline, [this]() { return !running || queued; });
+            else
+                condition.wait(lock, [this]() { return !running || queued; });
+        }
+
+        lock.unlock();
+        jvm->DetachThread();
+    }
+}
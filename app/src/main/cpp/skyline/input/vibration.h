@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <jvm.h>
+#include "sections/common.h"
+
+namespace skyline::input {
+    /**
+     * @brief A linearized vibration pattern for an Android vibrator, an empty pattern clears any running vibration
+     */
+    struct VibrationPattern {
+        static constexpr size_t MaxSize{50}; //!< The maximum amount of steps in a pattern, larger patterns would allow for more accurate reproduction of vibrations
+
+        std::array<jlong, MaxSize> timings;
+        std::array<jint, MaxSize> amplitudes;
+        size_t size{};
+
+        bool operator==(const VibrationPattern &other) const {
+            return size == other.size && std::equal(timings.begin(), timings.begin() + size, other.timings.begin()) && std::equal(amplitudes.begin(), amplitudes.begin() + size, other.amplitudes.begin());
+        }
+    };
+
+    /**
+     * @brief Hands vibration patterns off to a dedicated thread which plays them on the host, so the guest doesn't wait on JNI calls
+     * @note Only the latest pattern for a device is played, patterns queued while a device is rate-limited replace each other and repeated patterns are dropped
+     */
+    class VibrationQueue {
+      private:
+        static constexpr std::chrono::milliseconds MinimumPeriod{20}; //!< The minimum time between two patterns on the same device, Android vibrators can't render changes faster than this and every call restarts the vibrator
+
+        struct Device {
+            std::optional<VibrationPattern> pending; //!< The latest pattern which hasn't been played yet
+            std::optional<VibrationPattern> current; //!< The pattern which was played last
+            std::chrono::steady_clock::time_point lastPlayed; //!< The time at which current was played
+        };
+
+        std::shared_ptr<JvmManager> jvm; //!< This is held so the thread can use it until it's done, even if DeviceState is destroyed first
+        std::mutex mutex; //!< Synchronizes access to devices and running
+        std::condition_variable condition; //!< Signalled when a pattern is queued or the thread should exit
+        std::array<Device, constant::ControllerCount> devices;
+        bool queued{}; //!< If a pattern was queued since the thread last went over the devices
+        bool running{true};
+        std::thread thread; //!< The thread which plays patterns, it's attached to the JVM for its entire lifetime
+
+        /**
+         * @brief The loop of the vibration thread, it plays pending patterns as soon as their devices aren't rate-limited until the queue is destroyed
+         */
+        void Run();
+
+      public:
+        VibrationQueue(std::shared_ptr<JvmManager> jvm);
+
+        ~VibrationQueue();
+
+        /**
+         * @brief Queues a pattern to be played on the device with the supplied index, this replaces any pattern that hasn't been played yet
+         */
+        void Queue(i8 index, const VibrationPattern &pattern);
+    };
+}
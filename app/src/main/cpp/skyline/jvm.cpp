@@ -31,12 +31,20 @@ namespace skyline {
         return env;
     }
 
+    jfieldID JvmManager::GetFieldId(const char *key, const char *signature) {
+        std::lock_guard guard(fieldIdMutex);
+        auto &id{fieldIds[key]};
+        if (!id)
+            id = env->GetFieldID(instanceClass, key, signature);
+        return id;
+    }
+
     jobject JvmManager::GetField(const char *key, const char *signature) {
-        return env->GetObjectField(instance, env->GetFieldID(instanceClass, key, signature));
+        return env->GetObjectField(instance, GetFieldId(key, signature));
     }
 
     bool JvmManager::CheckNull(const char *key, const char *signature) {
-        return env->IsSameObject(env->GetObjectField(instance, env->GetFieldID(instanceClass, key, signature)), nullptr);
+        return env->IsSameObject(env->GetObjectField(instance, GetFieldId(key, signature)), nullptr);
     }
 
     bool JvmManager::CheckNull(jobject &object) {
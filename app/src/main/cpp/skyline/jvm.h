@@ -49,21 +49,21 @@ namespace skyline {
         inline objectType GetField(const char *key) {
             JNIEnv *env{GetEnv()};
             if constexpr(std::is_same<objectType, jboolean>())
-                return env->GetBooleanField(instance, env->GetFieldID(instanceClass, key, "Z"));
+                return env->GetBooleanField(instance, GetFieldId(key, "Z"));
             else if constexpr(std::is_same<objectType, jbyte>())
-                return env->GetByteField(instance, env->GetFieldID(instanceClass, key, "B"));
+                return env->GetByteField(instance, GetFieldId(key, "B"));
             else if constexpr(std::is_same<objectType, jchar>())
-                return env->GetCharField(instance, env->GetFieldID(instanceClass, key, "C"));
+                return env->GetCharField(instance, GetFieldId(key, "C"));
             else if constexpr(std::is_same<objectType, jshort>())
-                return env->GetShortField(instance, env->GetFieldID(instanceClass, key, "S"));
+                return env->GetShortField(instance, GetFieldId(key, "S"));
             else if constexpr(std::is_same<objectType, jint>())
-                return env->GetIntField(instance, env->GetFieldID(instanceClass, key, "I"));
+                return env->GetIntField(instance, GetFieldId(key, "I"));
             else if constexpr(std::is_same<objectType, jlong>())
-                return env->GetLongField(instance, env->GetFieldID(instanceClass, key, "J"));
+                return env->GetLongField(instance, GetFieldId(key, "J"));
             else if constexpr(std::is_same<objectType, jfloat>())
-                return env->GetFloatField(instance, env->GetFieldID(instanceClass, key, "F"));
+                return env->GetFloatField(instance, GetFieldId(key, "F"));
             else if constexpr(std::is_same<objectType, jdouble>())
-                return env->GetDoubleField(instance, env->GetFieldID(instanceClass, key, "D"));
+                return env->GetDoubleField(instance, GetFieldId(key, "D"));
         }
 
         /**
@@ -105,8 +105,16 @@ namespace skyline {
         void ClearVibrationDevice(jint index);
 
       private:
+        std::mutex fieldIdMutex; //!< Synchronizes access to fieldIds
+        std::unordered_map<std::string_view, jfieldID> fieldIds; //!< The IDs of all fields of the activity which have been accessed so far, keyed by their name
         jmethodID initializeControllersId;
         jmethodID vibrateDeviceId;
         jmethodID clearVibrationDeviceId;
+
+        /**
+         * @return The ID of the field of the activity with the supplied name, it's only looked up on the first access to a field
+         * @note The name must be a string literal or otherwise outlive the JvmManager as it's used as a key
+         */
+        jfieldID GetFieldId(const char *key, const char *signature);
     };
 }
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include "affinity.h"
+
+namespace skyline::kernel {
+    AffinityManager::WorkerPlacement AffinityManager::GetWorkerPlacement(Settings &settings, Logger &logger) {
+        auto placement{settings.GetStringInt("worker_placement", static_cast<int>(WorkerPlacement::Efficiency))};
+        if (placement < static_cast<int>(WorkerPlacement::Any) || placement > static_cast<int>(WorkerPlacement::Efficiency)) {
+            logger.Warn("Invalid worker placement: {}, workers will be placed on the efficiency cores", placement);
+            return WorkerPlacement::Efficiency;
+        }
+        return static_cast<WorkerPlacement>(placement);
+    }
+
+    AffinityManager::AffinityManager(const std::shared_ptr<Settings> &settings, const std::shared_ptr<Logger> &logger) : logger(logger), enabled(settings->GetBool("thread_affinity", true)), workerPlacement(GetWorkerPlacement(*settings, *logger)) {
+        struct Core {
+            u16 id; //!< The index of the core on the host
+            u64 frequency; //!< The maximum frequency of the core in kHz
+        };
+        std::vector<Core> cores;
+
+        auto coreCount{sysconf(_SC_NPROCESSORS_CONF)};
+        if (coreCount <= 0) {
+            logger->Warn("Couldn't determine the amount of host cores, threads won't be pinned to cores");
+            enabled = false;
+            return;
+        }
+
+        for (u16 id{}; id < coreCount && id < CPU_SETSIZE; id++) {
+            std::ifstream file(fmt::format("/sys/devices/system/cpu/cpu{}/cpufreq/cpuinfo_max_freq", id));
+            u64 frequency{};
+            file >> frequency; // If the frequency can't be read then all cores are treated as being equivalent
+            cores.push_back({id, frequency});
+        }
+
+        std::stable_sort(cores.begin(), cores.end(), [](const Core &a, const Core &b) { return a.frequency > b.frequency; });
+
+        // The cores that aren't in the lowest frequency cluster are the performance cores, if there's only one cluster then all cores are considered to be performance cores
+        auto lowestFrequency{cores.back().frequency};
+        auto performanceEnd{std::find_if(cores.begin(), cores.end(), [lowestFrequency](const Core &core) { return core.frequency == lowestFrequency; })};
+        if (performanceEnd == cores.begin())
+            performanceEnd = cores.end();
+
+        std::vector<Core> performanceCores(cores.begin(), performanceEnd);
+        std::vector<Core> efficiencyCores(performanceEnd, cores.end());
+        if (enabled)
+            logger->Debug("Host CPU has {} performance core(s) and {} efficiency core(s)", performanceCores.size(), efficiencyCores.size());
+
+        if (efficiencyCores.empty())
+            efficiencyCores = performanceCores;
+
+        for (const auto &core : efficiencyCores)
+            CPU_SET(core.id, &workerCores);
+
+        // The GPU loop gets the slowest of the performance cores to itself if there's more than a single one
+        if (performanceCores.size() > 1) {
+            CPU_SET(performanceCores.back().id, &gpuCores);
+            performanceCores.pop_back();
+        } else {
+            CPU_SET(performanceCores.front().id, &gpuCores);
+        }
+
+        // The application cores are spread over the performance cores in order of their performance while the system core shares the efficiency cores with the audio callback
+        for (u8 core{}; core < constant::GuestCoreCount - 1; core++)
+            CPU_SET(performanceCores[core % performanceCores.size()].id, &guestCores[core]);
+        for (const auto &core : efficiencyCores) {
+            CPU_SET(core.id, &guestCores.back());
+            CPU_SET(core.id, &audioCores);
+        }
+    }
+
+    void AffinityManager::ApplySettings(const std::shared_ptr<Settings> &settings) {
+        enabled = settings->GetBool("thread_affinity", true) && CPU_COUNT(&gpuCores); // The cores are only set up if the host CPU topology could be determined
+    }
+
+    void AffinityManager::SetAffinity(pid_t tid, const cpu_set_t &set) {
+        if (sched_setaffinity(tid, sizeof(cpu_set_t), &set) == -1)
+            logger->Warn("Couldn't set the affinity of TID {}: {}", tid, strerror(errno));
+    }
+
+    void AffinityManager::SetGuestAffinity(pid_t tid, u64 affinityMask) {
+        if (!enabled)
+            return;
+
+        cpu_set_t set{};
+        for (u8 core{}; core < constant::GuestCoreCount; core++)
+            if (affinityMask & (1ULL << core))
+                CPU_OR(&set, &set, &guestCores[core]);
+
+        if (CPU_COUNT(&set))
+            SetAffinity(tid, set);
+    }
+
+    void AffinityManager::SetHostAffinity(HostThread thread) {
+        if (thread == HostThread::Worker) {
+            if (workerPlacement == WorkerPlacement::Efficiency && CPU_COUNT(&workerCores))
+                SetAffinity(gettid(), workerCores);
+            return;
+        }
+
+        if (!enabled)
+            return;
+
+        SetAffinity(gettid(), thread == HostThread::Gpu ? gpuCores : audioCores);
+    }
+
+    size_t AffinityManager::GetWorkerCount() {
+        if (workerPlacement == WorkerPlacement::Efficiency && CPU_COUNT(&workerCores))
+            return static_cast<size_t>(CPU_COUNT(&workerCores));
+        return std::max(std::thread::hardware_concurrency(), 2U) - 1;
+    }
+}
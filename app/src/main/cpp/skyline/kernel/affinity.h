@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <array>
+#include <sched.h>
+#include <common.h>
+
+namespace skyline::kernel {
+    /**
+     * @brief The AffinityManager class is responsible for placing guest and host threads onto the cores of the host CPU
+     * @details Most Android devices have a heterogeneous (big.LITTLE) CPU, the guest cores are mapped onto the highest performing host cores while the GPU loop and the audio callback are kept on cores of their own so they don't contend with guest threads
+     */
+    class AffinityManager {
+      private:
+        std::shared_ptr<Logger> logger;
+        /**
+         * @brief The host cores which the workers of the ThreadPool can be placed on, this is controlled by the "worker_placement" setting
+         */
+        enum class WorkerPlacement {
+            Any = 0, //!< The workers can run on any core and there's a worker for every core
+            Efficiency = 1, //!< The workers are placed on the efficiency cores so they don't contend with guest threads
+        };
+
+        std::atomic<bool> enabled; //!< If threads should be pinned to cores at all, this is controlled by the "thread_affinity" setting
+        WorkerPlacement workerPlacement;
+        std::array<cpu_set_t, constant::GuestCoreCount> guestCores{}; //!< The set of host cores that each guest core is mapped onto
+        cpu_set_t gpuCores{}; //!< The set of host cores the GPU loop runs on
+        cpu_set_t audioCores{}; //!< The set of host cores the audio callback runs on
+        cpu_set_t workerCores{}; //!< The set of host cores the workers of the ThreadPool run on with WorkerPlacement::Efficiency
+
+        /**
+         * @return The "worker_placement" setting, this falls back to WorkerPlacement::Efficiency if it isn't a valid placement
+         */
+        static WorkerPlacement GetWorkerPlacement(Settings &settings, Logger &logger);
+
+        /**
+         * @brief Sets the affinity of a host thread and logs a warning on failure as affinity is a hint and not a requirement
+         */
+        void SetAffinity(pid_t tid, const cpu_set_t &set);
+
+      public:
+        /**
+         * @brief The host threads which have a dedicated placement
+         */
+        enum class HostThread {
+            Gpu, //!< The thread running the GPU loop
+            Audio, //!< The thread running the audio callback
+            Worker, //!< A worker thread of the ThreadPool, its placement is independent of the "thread_affinity" setting
+        };
+
+        /**
+         * @note The host CPU topology is inferred from the maximum frequency of each core in sysfs
+         * @note This doesn't take a DeviceState as it's constructed prior to it, the audio callback may use it as soon as DeviceState constructs Audio
+         */
+        AffinityManager(const std::shared_ptr<Settings> &settings, const std::shared_ptr<Logger> &logger);
+
+        /**
+         * @brief Reads the "thread_affinity" setting again, this only affects threads which are placed after it
+         * @note The "worker_placement" setting isn't read again as the workers of the ThreadPool are already running by the time a profile can be applied
+         */
+        void ApplySettings(const std::shared_ptr<Settings> &settings);
+
+        /**
+         * @brief Places a guest thread onto the host cores corresponding to its guest core mask
+         * @param tid The TID of the guest thread
+         * @param affinityMask A mask of the guest cores the thread is allowed to run on
+         */
+        void SetGuestAffinity(pid_t tid, u64 affinityMask);
+
+        /**
+         * @brief Places the calling thread onto the host cores which are dedicated to it
+         */
+        void SetHostAffinity(HostThread thread);
+
+        /**
+         * @return The amount of workers the ThreadPool should have, this is one less than the amount of cores unless they're restricted to the efficiency cores as the thread calling into the pool works alongside them
+         */
+        size_t GetWorkerCount();
+    };
+}
@@ -1,11 +1,28 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <os.h>
 #include "ipc.h"
 #include "types/KProcess.h"
 
 namespace skyline::kernel::ipc {
-    IpcRequest::IpcRequest(bool isDomain, const DeviceState &state) : isDomain(isDomain) {
+    span<u8> IpcRequest::MapBuffer(u64 address, size_t size, bool input, bool output) {
+        // Buffers almost always lie in a single host mapping, services read and write them in place without any copies
+        if (state.os->memory.IsHostContiguous(address, size))
+            return span(state.process->GetPointer<u8>(address), size);
+
+        if (state.os->memory.IsSharedAddressSpace())
+            return span(reinterpret_cast<u8 *>(address), size);
+
+        // Otherwise the buffer is staged, only input buffers are read from the guest here and only output buffers are written back after the request
+        auto &staged{stagedBuffers.emplace_back(StagedBuffer{address, std::vector<u8>(size), output})};
+        if (input)
+            state.process->ReadMemory(staged.contents.data(), address, size);
+        state.logger->DebugCompact("Staging IPC buffer AD: 0x{:X} SZ: 0x{:X}", address, size);
+        return staged.contents;
+    }
+
+    IpcRequest::IpcRequest(bool isDomain, const DeviceState &state) : state(state), isDomain(isDomain) {
         u8 *tls{state.process->GetPointer<u8>(state.thread->tls)};
         u8 *pointer{tls};
 
@@ -29,27 +46,33 @@ namespace skyline::kernel::ipc {
 
         for (u8 index{}; header->xNo > index; index++) {
             auto bufX{reinterpret_cast<BufferDescriptorX *>(pointer)};
+            auto &buffer{xBuf.emplace_back()};
             if (bufX->Address()) {
-                inputBuf.emplace_back(state.process->GetPointer<u8>(bufX->Address()), u16(bufX->size));
-                state.logger->Debug("Buf X #{} AD: 0x{:X} SZ: 0x{:X} CTR: {}", index, u64(bufX->Address()), u16(bufX->size), u16(bufX->Counter()));
+                buffer = MapBuffer(bufX->Address(), u16(bufX->size), true, false);
+                inputBuf.push_back(buffer);
+                state.logger->DebugCompact("Buf X #{} AD: 0x{:X} SZ: 0x{:X} CTR: {}", index, u64(bufX->Address()), u16(bufX->size), u16(bufX->Counter()));
             }
             pointer += sizeof(BufferDescriptorX);
         }
 
         for (u8 index{}; header->aNo > index; index++) {
             auto bufA{reinterpret_cast<BufferDescriptorABW *>(pointer)};
+            auto &buffer{aBuf.emplace_back()};
             if (bufA->Address()) {
-                inputBuf.emplace_back(state.process->GetPointer<u8>(bufA->Address()), bufA->Size());
-                state.logger->Debug("Buf A #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufA->Address()), u64(bufA->Size()));
+                buffer = MapBuffer(bufA->Address(), bufA->Size(), true, false);
+                inputBuf.push_back(buffer);
+                state.logger->DebugCompact("Buf A #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufA->Address()), u64(bufA->Size()));
             }
             pointer += sizeof(BufferDescriptorABW);
         }
 
         for (u8 index{}; header->bNo > index; index++) {
             auto bufB{reinterpret_cast<BufferDescriptorABW *>(pointer)};
+            auto &buffer{bBuf.emplace_back()};
             if (bufB->Address()) {
-                outputBuf.emplace_back(state.process->GetPointer<u8>(bufB->Address()), bufB->Size());
-                state.logger->Debug("Buf B #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufB->Address()), u64(bufB->Size()));
+                buffer = MapBuffer(bufB->Address(), bufB->Size(), true, true);
+                outputBuf.push_back(buffer);
+                state.logger->DebugCompact("Buf B #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufB->Address()), u64(bufB->Size()));
             }
             pointer += sizeof(BufferDescriptorABW);
         }
@@ -57,9 +80,10 @@ namespace skyline::kernel::ipc {
         for (u8 index{}; header->wNo > index; index++) {
             auto bufW{reinterpret_cast<BufferDescriptorABW *>(pointer)};
             if (bufW->Address()) {
-                outputBuf.emplace_back(state.process->GetPointer<u8>(bufW->Address()), bufW->Size());
-                outputBuf.emplace_back(state.process->GetPointer<u8>(bufW->Address()), bufW->Size());
-                state.logger->Debug("Buf W #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufW->Address()), u16(bufW->Size()));
+                auto buffer{MapBuffer(bufW->Address(), bufW->Size(), true, true)};
+                outputBuf.push_back(buffer);
+                outputBuf.push_back(buffer);
+                state.logger->DebugCompact("Buf W #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufW->Address()), u16(bufW->Size()));
             }
             pointer += sizeof(BufferDescriptorABW);
         }
@@ -95,37 +119,53 @@ namespace skyline::kernel::ipc {
         payloadOffset = cmdArg;
 
         if (payload->magic != util::MakeMagic<u32>("SFCI") && (header->type != CommandType::Control && header->type != CommandType::ControlWithContext)) // SFCI is the magic in received IPC messages
-            state.logger->Debug("Unexpected Magic in PayloadHeader: 0x{:X}", u32(payload->magic));
+            state.logger->DebugCompact("Unexpected Magic in PayloadHeader: 0x{:X}", u32(payload->magic));
 
         pointer += constant::IpcPaddingSum - padding + cBufferLengthSize;
 
         if (header->cFlag == BufferCFlag::SingleDescriptor) {
             auto bufC{reinterpret_cast<BufferDescriptorC *>(pointer)};
+            auto &buffer{cBuf.emplace_back()};
             if (bufC->address) {
-                outputBuf.emplace_back(state.process->GetPointer<u8>(bufC->address), u16(bufC->size));
-                state.logger->Debug("Buf C: AD: 0x{:X} SZ: 0x{:X}", u64(bufC->address), u16(bufC->size));
+                buffer = MapBuffer(bufC->address, u16(bufC->size), false, true);
+                outputBuf.push_back(buffer);
+                state.logger->DebugCompact("Buf C: AD: 0x{:X} SZ: 0x{:X}", u64(bufC->address), u16(bufC->size));
             }
         } else if (header->cFlag > BufferCFlag::SingleDescriptor) {
             for (u8 index{}; (static_cast<u8>(header->cFlag) - 2) > index; index++) { // (cFlag - 2) C descriptors are present
                 auto bufC{reinterpret_cast<BufferDescriptorC *>(pointer)};
+                auto &buffer{cBuf.emplace_back()};
                 if (bufC->address) {
-                    outputBuf.emplace_back(state.process->GetPointer<u8>(bufC->address), u16(bufC->size));
-                    state.logger->Debug("Buf C #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufC->address), u16(bufC->size));
+                    buffer = MapBuffer(bufC->address, u16(bufC->size), false, true);
+                    outputBuf.push_back(buffer);
+                    state.logger->DebugCompact("Buf C #{} AD: 0x{:X} SZ: 0x{:X}", index, u64(bufC->address), u16(bufC->size));
                 }
                 pointer += sizeof(BufferDescriptorC);
             }
         }
 
         if (header->type == CommandType::Request || header->type == CommandType::RequestWithContext) {
-            state.logger->Debug("Header: Input No: {}, Output No: {}, Raw Size: {}", inputBuf.size(), outputBuf.size(), u64(cmdArgSz));
+            state.logger->DebugCompact("Header: Input No: {}, Output No: {}, Raw Size: {}", inputBuf.size(), outputBuf.size(), u64(cmdArgSz));
             if (header->handleDesc)
-                state.logger->Debug("Handle Descriptor: Send PID: {}, Copy Count: {}, Move Count: {}", bool(handleDesc->sendPid), u32(handleDesc->copyCount), u32(handleDesc->moveCount));
+                state.logger->DebugCompact("Handle Descriptor: Send PID: {}, Copy Count: {}, Move Count: {}", bool(handleDesc->sendPid), u32(handleDesc->copyCount), u32(handleDesc->moveCount));
             if (isDomain)
-                state.logger->Debug("Domain Header: Command: {}, Input Object Count: {}, Object ID: 0x{:X}", domain->command, domain->inputCount, domain->objectId);
-            state.logger->Debug("Command ID: 0x{:X}", u32(payload->value));
+                state.logger->DebugCompact("Domain Header: Command: {}, Input Object Count: {}, Object ID: 0x{:X}", static_cast<u8>(domain->command), domain->inputCount, domain->objectId);
+            state.logger->DebugCompact("Command ID: 0x{:X}", u32(payload->value));
         }
     }
 
+    void IpcRequest::WriteBackBuffers() {
+        if (stagedBuffers.empty())
+            return;
+
+        std::vector<KProcess::MemoryTransfer> transfers;
+        for (auto &staged : stagedBuffers)
+            if (staged.output)
+                transfers.push_back({staged.contents.data(), staged.address, staged.contents.size()});
+        state.process->WriteMemoryBatch(transfers);
+        stagedBuffers.clear();
+    }
+
     IpcResponse::IpcResponse(const DeviceState &state) : state(state) {}
 
     void IpcResponse::WriteResponse(bool isDomain) {
@@ -135,7 +175,7 @@ namespace skyline::kernel::ipc {
         memset(tls, 0, constant::TlsIpcSize);
 
         auto header{reinterpret_cast<CommandHeader *>(pointer)};
-        header->rawSize = static_cast<u32>((sizeof(PayloadHeader) + payload.size() + (domainObjects.size() * sizeof(KHandle)) + constant::IpcPaddingSum + (isDomain ? sizeof(DomainHeaderRequest) : 0)) / sizeof(u32)); // Size is in 32-bit units because Nintendo
+        header->rawSize = static_cast<u32>((sizeof(PayloadHeader) + payloadSize + (domainObjects.size() * sizeof(KHandle)) + constant::IpcPaddingSum + (isDomain ? sizeof(DomainHeaderRequest) : 0)) / sizeof(u32)); // Size is in 32-bit units because Nintendo
         header->handleDesc = (!copyHandles.empty() || !moveHandles.empty());
         pointer += sizeof(CommandHeader);
 
@@ -172,9 +212,8 @@ namespace skyline::kernel::ipc {
         payloadHeader->value = errorCode;
         pointer += sizeof(PayloadHeader);
 
-        if (!payload.empty())
-            std::memcpy(pointer, payload.data(), payload.size());
-        pointer += payload.size();
+        std::memcpy(pointer, payload.data(), payloadSize);
+        pointer += payloadSize;
 
         if (isDomain) {
             for (auto &domainObject : domainObjects) {
@@ -183,6 +222,6 @@ namespace skyline::kernel::ipc {
             }
         }
 
-        state.logger->Debug("Output: Raw Size: {}, Command ID: 0x{:X}, Copy Handles: {}, Move Handles: {}", u32(header->rawSize), u32(payloadHeader->value), copyHandles.size(), moveHandles.size());
+        state.logger->DebugCompact("Output: Raw Size: {}, Command ID: 0x{:X}, Copy Handles: {}, Move Handles: {}", u32(header->rawSize), u32(payloadHeader->value), copyHandles.size(), moveHandles.size());
     }
 }
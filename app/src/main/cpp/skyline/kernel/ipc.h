@@ -9,6 +9,11 @@ namespace skyline {
     namespace constant {
         constexpr u8 IpcPaddingSum{0x10}; // The sum of the padding surrounding the data payload
         constexpr u16 TlsIpcSize{0x100}; // The size of the IPC command buffer in a TLS slot
+        constexpr u8 IpcMaxHandles{0xF}; // The maximum amount of copy or move handles in an IPC message, the count is a 4-bit field
+        constexpr u8 IpcMaxInputBuffers{0xF * 2}; // The maximum amount of input buffers in an IPC request, up to 15 X and A buffers each
+        constexpr u8 IpcMaxOutputBuffers{0xF * 3 + 0xD}; // The maximum amount of output buffers in an IPC request, up to 15 B buffers, 15 W buffers which are added twice and 13 C buffers
+        constexpr u8 IpcMaxDescriptors{0xF}; // The maximum amount of buffer descriptors of a single type in an IPC request
+        constexpr u8 IpcMaxDomainObjects{TlsIpcSize / sizeof(KHandle)}; // The maximum amount of domain objects in an IPC message, they all need to fit into the IPC command buffer
     }
 
     namespace kernel::ipc {
@@ -202,7 +207,25 @@ namespace skyline {
          */
         class IpcRequest {
           private:
+            /**
+             * @brief A buffer which couldn't be mapped directly and is staged in host memory instead
+             */
+            struct StagedBuffer {
+                u64 address; //!< The address of the buffer in the guest
+                std::vector<u8> contents; //!< The host copy of the buffer that services access
+                bool output; //!< If the buffer is written by services and needs to be written back to the guest
+            };
+
+            const DeviceState &state;
             u8 *payloadOffset; //!< The offset of the data read from the payload
+            std::vector<StagedBuffer> stagedBuffers; //!< Any buffers that had to be staged, this is empty unless a buffer isn't host-contiguous and the guest runs in a separate address space
+
+            /**
+             * @brief Maps a buffer from guest memory so services can directly access it, this is a span over guest memory with no copies unless it can't be accessed directly
+             * @param input If the contents of the buffer are read by services, B and W buffers are treated as inputs as well so a staged copy retains any bytes that aren't written
+             * @param output If the buffer is written to by services, staged output buffers are written back by WriteBackBuffers
+             */
+            span<u8> MapBuffer(u64 address, size_t size, bool input, bool output);
 
           public:
             CommandHeader *header{};
@@ -212,14 +235,43 @@ namespace skyline {
             PayloadHeader *payload{};
             u8 *cmdArg{}; //!< A pointer to the data payload
             u64 cmdArgSz{}; //!< The size of the data payload
-            std::vector<KHandle> copyHandles; //!< The handles that should be copied from the server to the client process (The difference is just to match application expectations, there is no real difference b/w copying and moving handles)
-            std::vector<KHandle> moveHandles; //!< The handles that should be moved from the server to the client process rather than copied
-            std::vector<KHandle> domainObjects;
-            std::vector<span<u8>> inputBuf;
-            std::vector<span<u8>> outputBuf;
+            StaticVector<KHandle, constant::IpcMaxHandles> copyHandles; //!< The handles that should be copied from the server to the client process (The difference is just to match application expectations, there is no real difference b/w copying and moving handles)
+            StaticVector<KHandle, constant::IpcMaxHandles> moveHandles; //!< The handles that should be moved from the server to the client process rather than copied
+            StaticVector<KHandle, constant::IpcMaxDomainObjects> domainObjects;
+            StaticVector<span<u8>, constant::IpcMaxInputBuffers> inputBuf;
+            StaticVector<span<u8>, constant::IpcMaxOutputBuffers> outputBuf;
+            StaticVector<span<u8>, constant::IpcMaxDescriptors> xBuf; //!< The buffers of all X descriptors in order, unlike inputBuf a null descriptor is retained as an empty span so the positions of optional buffers are known
+            StaticVector<span<u8>, constant::IpcMaxDescriptors> aBuf; //!< The buffers of all A descriptors in order, a null descriptor is an empty span
+            StaticVector<span<u8>, constant::IpcMaxDescriptors> bBuf; //!< The buffers of all B descriptors in order, a null descriptor is an empty span
+            StaticVector<span<u8>, constant::IpcMaxDescriptors> cBuf; //!< The buffers of all C descriptors in order, a null descriptor is an empty span
 
             IpcRequest(bool isDomain, const DeviceState &state);
 
+            /**
+             * @return The input buffer at the supplied index amongst auto-select buffers, these are passed as either an A or an X descriptor with the other one being null
+             * @note This is empty if the guest supplied a null buffer, it's only valid for commands where all A and X descriptors are auto-select
+             */
+            span<u8> GetAutoSelectInput(size_t index) {
+                if (index < aBuf.size() && !aBuf[index].empty())
+                    return aBuf[index];
+                return (index < xBuf.size()) ? xBuf[index] : span<u8>{};
+            }
+
+            /**
+             * @return The output buffer at the supplied index amongst auto-select buffers, these are passed as either a B or a C descriptor with the other one being null
+             * @note This is empty if the guest supplied a null buffer, it's only valid for commands where all B and C descriptors are auto-select
+             */
+            span<u8> GetAutoSelectOutput(size_t index) {
+                if (index < bBuf.size() && !bBuf[index].empty())
+                    return bBuf[index];
+                return (index < cBuf.size()) ? cBuf[index] : span<u8>{};
+            }
+
+            /**
+             * @brief Writes the contents of all staged output buffers back to guest memory, this must be done after the request has been handled
+             */
+            void WriteBackBuffers();
+
             /**
              * @brief Returns a reference to an item from the top of the payload
              */
@@ -256,13 +308,25 @@ namespace skyline {
         class IpcResponse {
           private:
             const DeviceState &state;
-            std::vector<u8> payload; //!< The contents to be pushed to the data payload
+            std::array<u8, constant::TlsIpcSize> payload; //!< The contents to be pushed to the data payload, this can't exceed the size of the IPC command buffer it's written into
+            size_t payloadSize{}; //!< The amount of bytes that have been pushed to the payload
+
+            /**
+             * @return A pointer to the payload with space for the supplied amount of bytes reserved at the end of it
+             */
+            inline u8 *ReservePayload(size_t size) {
+                if (payloadSize + size > payload.size())
+                    throw exception("IPC response payload exceeds the size of the IPC command buffer: 0x{:X}", payloadSize + size);
+                auto pointer{payload.data() + payloadSize};
+                payloadSize += size;
+                return pointer;
+            }
 
           public:
             Result errorCode{}; //!< The error code to respond with, it is 0 (Success) by default
-            std::vector<KHandle> copyHandles;
-            std::vector<KHandle> moveHandles;
-            std::vector<KHandle> domainObjects;
+            StaticVector<KHandle, constant::IpcMaxHandles> copyHandles;
+            StaticVector<KHandle, constant::IpcMaxHandles> moveHandles;
+            StaticVector<KHandle, constant::IpcMaxDomainObjects> domainObjects;
 
             IpcResponse(const DeviceState &state);
 
@@ -273,9 +337,7 @@ namespace skyline {
              */
             template<typename ValueType>
             inline void Push(const ValueType &value) {
-                auto size{payload.size()};
-                payload.resize(size + sizeof(ValueType));
-                std::memcpy(payload.data() + size, reinterpret_cast<const u8 *>(&value), sizeof(ValueType));
+                std::memcpy(ReservePayload(sizeof(ValueType)), reinterpret_cast<const u8 *>(&value), sizeof(ValueType));
             }
 
             /**
@@ -283,9 +345,21 @@ namespace skyline {
              * @param string The string to write to the payload
              */
             inline void Push(std::string_view string) {
-                auto size{payload.size()};
-                payload.resize(size + string.size());
-                std::memcpy(payload.data() + size, string.data(), string.size());
+                std::memcpy(ReservePayload(string.size()), string.data(), string.size());
+            }
+
+            /**
+             * @brief Writes raw bytes to the payload
+             */
+            inline void PushBytes(span<const u8> bytes) {
+                std::memcpy(ReservePayload(bytes.size()), bytes.data(), bytes.size());
+            }
+
+            /**
+             * @return The contents that have been pushed to the payload so far
+             */
+            span<const u8> GetPayload() const {
+                return span(payload.data(), payloadSize);
             }
 
             /**
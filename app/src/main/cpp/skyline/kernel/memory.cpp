@@ -1,6 +1,11 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <asm/unistd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <nce.h>
+#include <statistics.h>
 #include "memory.h"
 #include "types/KProcess.h"
 
@@ -36,6 +41,39 @@ namespace skyline::kernel {
         return nullptr;
     }
 
+    void MemoryManager::MapPages(u64 address, u64 size, u64 host) {
+        for (u64 page{address}, end{address + size}; page < end; page += (1 << PageBits)) {
+            auto directoryIndex{page >> (PageTableBits + PageBits)};
+            if (directoryIndex >= pageDirectory.size())
+                break;
+
+            auto &table{pageDirectory[directoryIndex]};
+            if (!table) {
+                if (!host) {
+                    page = ((directoryIndex + 1) << (PageTableBits + PageBits)) - (1 << PageBits); // There's nothing to unmap in a table that was never allocated
+                    continue;
+                }
+                table = std::make_unique<PageTable>();
+                table->fill(nullptr);
+            }
+
+            (*table)[(page >> PageBits) & ((1 << PageTableBits) - 1)] = host ? reinterpret_cast<u8 *>(host + (page - address)) : nullptr;
+        }
+    }
+
+    bool MemoryManager::IsHostContiguous(u64 address, u64 size) {
+        auto host{GetHostAddress(address)};
+        if (!host)
+            return false;
+
+        // Every page after the first one needs to directly follow the previous page in host memory
+        for (u64 page{util::AlignDown(address, PAGE_SIZE) + PAGE_SIZE}; page < address + size; page += PAGE_SIZE)
+            if (GetHostAddress(page) != host + (page - address))
+                return false;
+
+        return true;
+    }
+
     void MemoryManager::InsertChunk(const ChunkDescriptor &chunk) {
         auto upperChunk{std::upper_bound(chunks.begin(), chunks.end(), chunk.address, [](const u64 address, const ChunkDescriptor &chunk) -> bool {
             return address < chunk.address;
@@ -49,41 +87,65 @@ namespace skyline::kernel {
         }
 
         chunks.insert(upperChunk, chunk);
+        state.statistics->UpdateMemoryUsage(chunk.state.type, static_cast<i64>(chunk.size));
+        if (chunk.host)
+            MapPages(chunk.address, chunk.size, chunk.host);
     }
 
     void MemoryManager::DeleteChunk(u64 address) {
         for (auto chunk{chunks.begin()}, end{chunks.end()}; chunk != end;) {
-            if (chunk->address <= address && (chunk->address + chunk->size) > address)
+            if (chunk->address <= address && (chunk->address + chunk->size) > address) {
+                MapPages(chunk->address, chunk->size, 0);
+                state.statistics->UpdateMemoryUsage(chunk->state.type, -static_cast<i64>(chunk->size));
                 chunk = chunks.erase(chunk);
-            else
+            } else
                 chunk++;
         }
     }
 
     void MemoryManager::ResizeChunk(ChunkDescriptor *chunk, size_t size) {
+        // The host mapping of the chunk might have moved along with the resize, so the previous range is unmapped entirely prior to mapping the new range
+        MapPages(chunk->address, chunk->size, 0);
+        state.statistics->UpdateMemoryUsage(chunk->state.type, static_cast<i64>(size) - static_cast<i64>(chunk->size));
+        ResizeBlocks(chunk, size);
+        if (chunk->host)
+            MapPages(chunk->address, chunk->size, chunk->host);
+    }
+
+    /**
+     * @return If two blocks have identical permissions and attributes, so adjacent ones can be coalesced into a single block
+     */
+    static bool IsBlockEquivalent(const BlockDescriptor &lhs, const BlockDescriptor &rhs) {
+        return lhs.permission == rhs.permission && lhs.attributes.value == rhs.attributes.value;
+    }
+
+    void MemoryManager::ResizeBlocks(ChunkDescriptor *chunk, size_t size) {
         if (chunk->blockList.size() == 1) {
             chunk->blockList.begin()->size = size;
         } else if (size > chunk->size) {
             auto begin{chunk->blockList.begin()};
             auto end{std::prev(chunk->blockList.end())};
 
-            BlockDescriptor block{
-                .address = (end->address + end->size),
-                .size = (chunk->address + size) - (end->address + end->size),
-                .permission = begin->permission,
-                .attributes = begin->attributes,
-            };
-
-            chunk->blockList.push_back(block);
+            if (IsBlockEquivalent(*end, *begin)) {
+                end->size = (chunk->address + size) - end->address;
+            } else {
+                BlockDescriptor block{
+                    .address = (end->address + end->size),
+                    .size = (chunk->address + size) - (end->address + end->size),
+                    .permission = begin->permission,
+                    .attributes = begin->attributes,
+                };
+
+                chunk->blockList.push_back(block);
+            }
         } else if (size < chunk->size) {
             auto endAddress{chunk->address + size};
 
-            for (auto block{chunk->blockList.begin()}, end{chunk->blockList.end()}; block != end;) {
-                if (block->address > endAddress)
-                    block = chunk->blockList.erase(block);
-                else
-                    block++;
-            }
+            // All blocks starting at or past the new end are sorted at the end of the list, so they can be erased at once, the first block is always kept so a chunk shrunk to 0 bytes still has a block
+            auto firstErased{std::lower_bound(std::next(chunk->blockList.begin()), chunk->blockList.end(), endAddress, [](const BlockDescriptor &block, const u64 address) -> bool {
+                return block.address < address;
+            })};
+            chunk->blockList.erase(firstErased, chunk->blockList.end());
 
             auto end{std::prev(chunk->blockList.end())};
             end->size = endAddress - end->address;
@@ -93,29 +155,73 @@ namespace skyline::kernel {
     }
 
     void MemoryManager::InsertBlock(ChunkDescriptor *chunk, BlockDescriptor block) {
-        if (chunk->address + chunk->size < block.address + block.size)
-            throw exception("InsertBlock: Inserting block past chunk end is not allowed");
-
-        for (auto iter{chunk->blockList.begin()}; iter != chunk->blockList.end(); iter++) {
-            if (iter->address <= block.address) {
-                if ((iter->address + iter->size) > block.address) {
-                    if (iter->address == block.address && iter->size == block.size) {
-                        iter->attributes = block.attributes;
-                        iter->permission = block.permission;
-                    } else {
-                        auto endBlock{*iter};
-                        endBlock.address = (block.address + block.size);
-                        endBlock.size = (iter->address + iter->size) - endBlock.address;
-
-                        iter->size = block.address - iter->address;
-                        chunk->blockList.insert(std::next(iter), {block, endBlock});
-                    }
-                    return;
-                }
+        if (block.address < chunk->address || chunk->address + chunk->size < block.address + block.size)
+            throw exception("InsertBlock: Inserting block outside of chunk is not allowed");
+        if (!block.size)
+            return;
+
+        auto &blocks{chunk->blockList};
+        auto blockEnd{block.address + block.size};
+
+        // The range of blocks which overlap the inserted block, these are found with a binary search as the list is sorted
+        auto first{std::upper_bound(blocks.begin(), blocks.end(), block.address, [](const u64 address, const BlockDescriptor &block) -> bool {
+            return address < block.address;
+        })};
+        if (first == blocks.begin())
+            throw exception("InsertBlock: Block offset not present within current block list");
+        first--;
+
+        auto last{std::lower_bound(first, blocks.end(), blockEnd, [](const BlockDescriptor &block, const u64 address) -> bool {
+            return block.address < address;
+        })};
+
+        // The parts of the first and last overlapping blocks outside the inserted block are retained unless they can be coalesced with it
+        std::array<BlockDescriptor, 3> replacement;
+        size_t replacementCount{};
+
+        auto lastOverlapping{std::prev(last)};
+        auto lastEnd{lastOverlapping->address + lastOverlapping->size};
+
+        if (first->address < block.address) {
+            if (IsBlockEquivalent(*first, block)) {
+                block.size += block.address - first->address;
+                block.address = first->address;
+            } else {
+                replacement[replacementCount] = *first;
+                replacement[replacementCount++].size = block.address - first->address;
+            }
+        } else if (first != blocks.begin() && IsBlockEquivalent(*std::prev(first), block)) {
+            first--;
+            block.size += block.address - first->address;
+            block.address = first->address;
+        }
+
+        std::optional<BlockDescriptor> tail;
+        if (lastEnd > blockEnd) {
+            if (IsBlockEquivalent(*lastOverlapping, block)) {
+                block.size = lastEnd - block.address;
+            } else {
+                tail = *lastOverlapping;
+                tail->address = blockEnd;
+                tail->size = lastEnd - blockEnd;
             }
+        } else if (last != blocks.end() && IsBlockEquivalent(*last, block)) {
+            block.size = (last->address + last->size) - block.address;
+            last++;
         }
 
-        throw exception("InsertBlock: Block offset not present within current block list");
+        replacement[replacementCount++] = block;
+        if (tail)
+            replacement[replacementCount++] = *tail;
+
+        // The replaced blocks are overwritten in place, so the list is only shifted by the difference in the amount of blocks
+        auto replacedCount{static_cast<size_t>(std::distance(first, last))};
+        auto overwriteCount{std::min(replacedCount, replacementCount)};
+        auto next{std::copy_n(replacement.begin(), overwriteCount, first)};
+        if (replacementCount > replacedCount)
+            blocks.insert(next, replacement.begin() + overwriteCount, replacement.begin() + replacementCount);
+        else
+            blocks.erase(next, last);
     }
 
     void MemoryManager::InitializeRegions(u64 address, u64 size, memory::AddressSpaceType type) {
@@ -158,6 +264,8 @@ namespace skyline::kernel {
                 stack.size = 0x80000000;
                 tlsIo.address = stack.address + stack.size;
                 tlsIo.size = 0x1000000000;
+                if (sharedAddressSpace && tlsIo.address + tlsIo.size > sharedAddressSpaceEnd)
+                    throw exception("39-bit regions exceed the shared address space carve-out: 0x{:X} > 0x{:X}", tlsIo.address + tlsIo.size, sharedAddressSpaceEnd);
                 break;
             }
         }
@@ -166,7 +274,99 @@ namespace skyline::kernel {
             .address + heap.size, heap.size, stack.address, stack.address + stack.size, stack.size, tlsIo.address, tlsIo.address + tlsIo.size, tlsIo.size);
     }
 
-    MemoryManager::MemoryManager(const DeviceState &state) : state(state) {}
+    MemoryManager::MemoryManager(const DeviceState &state) : state(state), hugePages(state.settings->GetBool("huge_pages", false)) {}
+
+    bool MemoryManager::ReserveSharedAddressSpace() {
+        // Our stack is placed near the end of the host address space, so the highest bit of its address yields the VA width of the host
+        auto hostBits{64 - __builtin_clzll(reinterpret_cast<u64>(__builtin_frame_address(0)))};
+        auto end{(hostBits > 39) ? SharedAddressSpaceLimit : (1UL << (hostBits - 1))};
+        if (end < SharedAddressSpaceMinimum) {
+            state.logger->Info("Cannot reserve the guest address space carve-out: The host address space is {}-bit", hostBits);
+            return false;
+        }
+
+        auto size{end - constant::BaseAddress};
+        auto reservation{mmap(reinterpret_cast<void *>(constant::BaseAddress), size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0)};
+        if (reservation == MAP_FAILED) {
+            state.logger->Warn("Cannot reserve the guest address space carve-out: {}", strerror(errno));
+            return false;
+        }
+
+        // Kernels prior to 4.17 don't support MAP_FIXED_NOREPLACE and treat the address as a hint, the reservation is useless if it wasn't placed exactly
+        if (reinterpret_cast<u64>(reservation) != constant::BaseAddress) {
+            munmap(reservation, size);
+            state.logger->Warn("Cannot reserve the guest address space carve-out: Part of it is occupied");
+            return false;
+        }
+
+        sharedAddressSpaceEnd = end;
+        sharedAddressSpace = true;
+        return true;
+    }
+
+    u8 *MemoryManager::MapHostMemory(int fd, size_t size, u64 address, int flags) {
+        bool huge{hugePages && size >= HugePageSize};
+
+        void *host;
+        if (huge && !address) {
+            // A region that's a huge page larger than the mapping is reserved so the mapping can be placed at a huge page aligned address inside it, the excess is unmapped after
+            auto reservation{reinterpret_cast<u8 *>(mmap(nullptr, size + HugePageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))};
+            if (reservation == MAP_FAILED)
+                throw exception("An occurred while reserving memory for a huge page mapping: {}", strerror(errno));
+
+            auto aligned{reinterpret_cast<u8 *>(util::AlignUp(reinterpret_cast<u64>(reservation), HugePageSize))};
+            host = mmap(aligned, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED | MAP_FIXED | flags, fd, 0);
+            if (host == MAP_FAILED) {
+                munmap(reservation, size + HugePageSize);
+                throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+            }
+
+            if (aligned != reservation)
+                munmap(reservation, aligned - reservation);
+            munmap(aligned + size, HugePageSize - (aligned - reservation));
+        } else {
+            host = mmap(reinterpret_cast<void *>(address), size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED | flags, fd, 0);
+            if (host == MAP_FAILED)
+                throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+        }
+
+        // This is only a hint as THP for shared memory depends on the host kernel's configuration, the memory is backed by regular pages if it's unsupported
+        if (huge)
+            madvise(host, size, MADV_HUGEPAGE);
+
+        return reinterpret_cast<u8 *>(host);
+    }
+
+    int MemoryManager::CreateMemoryFile(const char *name, size_t size) {
+        // memfd_create isn't exposed by Bionic below API 30, so it's called directly
+        auto fd{static_cast<int>(syscall(__NR_memfd_create, name, 0))};
+        if (fd < 0)
+            throw exception("An error occurred while creating a memory file: {}", strerror(errno));
+
+        if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+            close(fd);
+            throw exception("An error occurred while sizing a memory file to 0x{:X} bytes: {}", size, strerror(errno));
+        }
+
+        return fd;
+    }
+
+    void MemoryManager::ResizeMemoryFile(int fd, size_t size) {
+        if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+            throw exception("An error occurred while resizing a memory file to 0x{:X} bytes: {}", size, strerror(errno));
+    }
+
+    void MemoryManager::AdviseGuestMemory(u64 address, size_t size, std::vector<SyscallDescriptor> &syscalls) {
+        if (hugePages && size >= HugePageSize)
+            syscalls.push_back(SyscallDescriptor{.number = __NR_madvise, .arguments = {address, size, MADV_HUGEPAGE}});
+    }
+
+    void MemoryManager::ReleaseHostMemory(u64 host, size_t size) {
+        // MADV_REMOVE only works on shared mappings, anything else only has the pages of this mapping dropped
+        if (madvise(reinterpret_cast<void *>(host), size, MADV_REMOVE) < 0 && madvise(reinterpret_cast<void *>(host), size, MADV_DONTNEED) < 0)
+            throw exception("An error occurred while releasing 0x{:X} bytes of host memory at 0x{:X}: {}", size, host, strerror(errno));
+        state.statistics->releasedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
 
     std::optional<DescriptorPack> MemoryManager::Get(u64 address, bool requireMapped) {
         auto chunk{GetChunk(address)};
@@ -248,8 +248,70 @@ namespace skyline {
          */
         class MemoryManager {
           private:
+            static constexpr u8 PageBits{12}; //!< The amount of bits in an address which are an offset into a page
+            static constexpr u8 PageTableBits{13}; //!< The amount of bits in an address which index into a second-level page table
+            static constexpr u8 PageDirectoryBits{39 - PageTableBits - PageBits}; //!< The amount of bits in an address which index into the first-level page directory, this covers the largest (39-bit) address space
+            using PageTable = std::array<u8 *, 1 << PageTableBits>; //!< A second-level page table mapping guest pages to the host address of each page
+
+            static constexpr u64 HugePageSize{0x200000}; //!< The size of a huge page on ARMv8 with a 4 KiB granule
+
             const DeviceState &state;
+            const bool hugePages; //!< If memory objects which span huge pages should be backed by them on the host and in the guest
             std::vector<ChunkDescriptor> chunks;
+            std::array<std::unique_ptr<PageTable>, 1 << PageDirectoryBits> pageDirectory{}; //!< A software page table mapping every guest page to its host address or nullptr if it has no host mapping, it's kept in sync with chunks
+
+            static constexpr u64 SharedAddressSpaceLimit{1UL << 39}; //!< The largest end of the carve-out reserved for the guest when it shares our address space, this covers the largest (39-bit) address space
+            static constexpr u64 SharedAddressSpaceMinimum{1UL << 38}; //!< The smallest end of the carve-out, the 39-bit regions span 0x2200000000 bytes past the code region so this leaves ample room for the code of any executable
+            u64 sharedAddressSpaceEnd{}; //!< The end of the carve-out reserved for the guest, it's sized from the VA width of the host as our own mappings occupy the top of it
+            bool sharedAddressSpace{}; //!< If the guest runs in our address space inside the carve-out rather than in a separate one
+
+            /**
+             * @brief Maps or unmaps guest pages in the software page table
+             * @param address The address of the first page
+             * @param size The size of the pages in bytes
+             * @param host The host address corresponding to the guest address, the pages are unmapped if this is 0
+             */
+            void MapPages(u64 address, u64 size, u64 host);
+
+            /**
+             * @brief Maps a shared memory file into the host address space, mappings that can contain a huge page are aligned to one and advised to be backed by them if huge pages are enabled
+             * @param fd The file descriptor of the shared memory
+             * @param size The size of the mapping
+             * @param address The address to map the memory at, if this is 0 then a huge page aligned address is chosen when applicable
+             * @param flags The flags passed to mmap in addition to MAP_SHARED
+             * @return The host address of the mapping
+             */
+            u8 *MapHostMemory(int fd, size_t size, u64 address = 0, int flags = 0);
+
+            /**
+             * @brief Creates a memory file to back a memory object, unlike ashmem regions it can be resized while retaining its contents
+             * @param name The name of the file, this is only used for debugging
+             * @param size The initial size of the file
+             * @return The file descriptor of the memory file
+             */
+            static int CreateMemoryFile(const char *name, size_t size);
+
+            /**
+             * @brief Resizes a memory file in place, the contents up to the smaller of the sizes are retained so mappings of it can be extended without copying them
+             * @note Any mappings of the file must be shrunk prior to shrinking it as accessing them past the end of the file raises SIGBUS
+             */
+            static void ResizeMemoryFile(int fd, size_t size);
+
+            /**
+             * @brief Advises a mapping in the guest to be backed by huge pages if they're enabled and it can contain one
+             * @param address The address of the mapping in the guest
+             * @param size The size of the mapping
+             * @param syscalls The batch of guest syscalls the advice is appended to, it should be the last syscall in it as a failure is harmless but cancels any syscalls after it
+             */
+            void AdviseGuestMemory(u64 address, size_t size, std::vector<SyscallDescriptor> &syscalls);
+
+            /**
+             * @brief Releases the pages backing a range of host memory back to the host, they read as zero if they're accessed again
+             * @param host The page-aligned host address of the range
+             * @param size The size of the range in bytes
+             * @note This punches a hole into the memory file backing the range, so the pages are released across all mappings of it including the guest's
+             */
+            void ReleaseHostMemory(u64 host, size_t size);
 
             /**
              * @param address The address to find a chunk at
@@ -276,14 +338,22 @@ namespace skyline {
             void DeleteChunk(u64 address);
 
             /**
-             * @brief Resize the specified chunk to the specified size
+             * @brief Resize the specified chunk in the memory map to the specified size
+             * @param chunk The chunk to resize, its host address is also reflected in the page table
+             * @param size The new size of the chunk
+             */
+            void ResizeChunk(ChunkDescriptor *chunk, size_t size);
+
+            /**
+             * @brief Resize the blocks of a chunk to the specified size without affecting the memory map
              * @param chunk The chunk to resize
              * @param size The new size of the chunk
              */
-            static void ResizeChunk(ChunkDescriptor *chunk, size_t size);
+            static void ResizeBlocks(ChunkDescriptor *chunk, size_t size);
 
             /**
-             * @brief Insert a block into a chunk
+             * @brief Insert a block into a chunk, overwriting any range of blocks it overlaps
+             * @note The block is coalesced with any adjacent blocks with identical permissions and attributes, this keeps block lists compact when guests repeatedly change small ranges
              * @param chunk The chunk to insert the block into
              * @param block The block to insert into the chunk
              */
@@ -297,6 +367,14 @@ namespace skyline {
              */
             void InitializeRegions(u64 address, u64 size, memory::AddressSpaceType type);
 
+            /**
+             * @brief Reserves the carve-out of our address space which the guest would be mapped into, so nothing else is placed inside it
+             * @return If the entire carve-out could be reserved, the guest has to run in a separate address space otherwise
+             * @note The carve-out spans the entire 39-bit address space on hosts with a wider VA, on a 39-bit host it's limited to the lower half as our own mappings are placed top-down from the end of it
+             * @note This has to be done prior to any guest memory being mapped
+             */
+            bool ReserveSharedAddressSpace();
+
           public:
             friend class type::KPrivateMemory;
             friend class type::KSharedMemory;
@@ -327,6 +405,40 @@ namespace skyline {
              */
             std::optional<DescriptorPack> Get(u64 address, bool requireMapped = true);
 
+            /**
+             * @param address The address on the guest
+             * @return The corresponding host address or 0 if the address isn't mapped on the host
+             */
+            inline u64 GetHostAddress(u64 address) {
+                auto directoryIndex{address >> (PageTableBits + PageBits)};
+                if (directoryIndex >= pageDirectory.size() || !pageDirectory[directoryIndex])
+                    return 0;
+
+                auto page{(*pageDirectory[directoryIndex])[(address >> PageBits) & ((1 << PageTableBits) - 1)]};
+                return page ? reinterpret_cast<u64>(page) + (address & ((1 << PageBits) - 1)) : 0;
+            }
+
+            /**
+             * @param address The address of the range on the guest
+             * @param size The size of the range in bytes
+             * @return If the entire range is mapped on the host and is contiguous in host memory
+             */
+            bool IsHostContiguous(u64 address, u64 size);
+
+            /**
+             * @return If the guest runs in our address space, guest addresses can be accessed directly and mappings are changed with local syscalls rather than ones done by the guest
+             */
+            bool IsSharedAddressSpace() const {
+                return sharedAddressSpace;
+            }
+
+            /**
+             * @return If the range is entirely inside the carve-out of the shared address space
+             */
+            bool InSharedAddressSpace(u64 address, u64 size) const {
+                return address >= constant::BaseAddress && address + size <= sharedAddressSpaceEnd && address + size >= address;
+            }
+
             /**
              * @brief The total amount of space in bytes occupied by all memory mappings
              * @return The cumulative size of all memory mappings in bytes
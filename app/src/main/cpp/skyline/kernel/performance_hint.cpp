@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include "performance_hint.h"
+
+namespace skyline::kernel {
+    PerformanceHintManager::PerformanceHintManager(const std::shared_ptr<Settings> &settings, const std::shared_ptr<Logger> &logger) : logger(logger) {
+        if (!settings->GetBool("performance_hints", true))
+            return;
+
+        auto libandroid{dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL)};
+        if (!libandroid)
+            return;
+
+        auto getManager{reinterpret_cast<void *(*)()>(dlsym(libandroid, "APerformanceHint_getManager"))};
+        createSession = reinterpret_cast<CreateSessionFunction>(dlsym(libandroid, "APerformanceHint_createSession"));
+        updateTargetWorkDuration = reinterpret_cast<UpdateTargetWorkDurationFunction>(dlsym(libandroid, "APerformanceHint_updateTargetWorkDuration"));
+        reportActualWorkDuration = reinterpret_cast<ReportActualWorkDurationFunction>(dlsym(libandroid, "APerformanceHint_reportActualWorkDuration"));
+        closeSession = reinterpret_cast<CloseSessionFunction>(dlsym(libandroid, "APerformanceHint_closeSession"));
+
+        if (!getManager || !createSession || !updateTargetWorkDuration || !reportActualWorkDuration || !closeSession) {
+            logger->Info("Performance hints aren't supported on this device");
+            return;
+        }
+
+        manager = getManager();
+        if (!manager)
+            logger->Info("Performance hints aren't supported on this device");
+    }
+
+    PerformanceHintManager::~PerformanceHintManager() {
+        if (session)
+            closeSession(session);
+    }
+
+    void PerformanceHintManager::RecreateSession() {
+        if (session) {
+            closeSession(session);
+            session = nullptr;
+        }
+
+        std::vector<i32> threadIds;
+        for (auto tid : threads)
+            if (tid)
+                threadIds.push_back(tid);
+
+        session = createSession(manager, threadIds.data(), threadIds.size(), GetSessionTarget());
+        if (!session)
+            logger->Warn("Couldn't create a performance hint session for {} thread(s)", threadIds.size());
+    }
+
+    void PerformanceHintManager::SetThread(HintThread thread, pid_t tid) {
+        if (!manager)
+            return;
+
+        if (tid && access(fmt::format("/proc/self/task/{}", tid).c_str(), F_OK)) {
+            logger->Warn("Thread {} isn't a part of this process, it can't be added to the performance hint session", tid);
+            return;
+        }
+
+        std::lock_guard guard(mutex);
+        auto &entry{threads[static_cast<size_t>(thread)]};
+        if (entry == tid)
+            return;
+
+        entry = tid;
+        RecreateSession();
+    }
+
+    void PerformanceHintManager::SetTargetDuration(u64 duration) {
+        if (!manager)
+            return;
+
+        std::lock_guard guard(mutex);
+        if (targetDuration == static_cast<i64>(duration))
+            return;
+
+        targetDuration = static_cast<i64>(duration);
+        if (session)
+            updateTargetWorkDuration(session, GetSessionTarget());
+    }
+
+    void PerformanceHintManager::SetBoost(bool boost) {
+        if (!manager)
+            return;
+
+        std::lock_guard guard(mutex);
+        if (this->boost == boost)
+            return;
+
+        this->boost = boost;
+        if (session)
+            updateTargetWorkDuration(session, GetSessionTarget());
+    }
+
+    void PerformanceHintManager::ReportFrame() {
+        if (!manager)
+            return;
+
+        auto duration{pendingWork.exchange(0, std::memory_order_relaxed)};
+        std::lock_guard guard(mutex);
+        if (session && duration)
+            reportActualWorkDuration(session, static_cast<i64>(duration));
+    }
+}
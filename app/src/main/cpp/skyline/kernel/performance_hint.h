@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <array>
+#include <common.h>
+
+namespace skyline::kernel {
+    /**
+     * @brief The PerformanceHintManager class is responsible for reporting the frame pacing of the guest to the Android performance hint API (ADPF), so the OS governor only raises clocks when frames would otherwise miss their deadline
+     * @note APerformanceHintManager was added in API 33, it's loaded from libandroid at runtime so this silently does nothing on older versions
+     */
+    class PerformanceHintManager {
+      public:
+        /**
+         * @brief The threads which are part of the work of every guest frame
+         */
+        enum class HintThread {
+            Gpfifo, //!< The thread running the GPFIFO scheduler
+            Gpu, //!< The thread running the GPU loop
+            Audio, //!< The thread running the audio callback
+        };
+
+      private:
+        using CreateSessionFunction = void *(*)(void *manager, const i32 *threadIds, size_t size, i64 initialTargetWorkDurationNanos);
+        using UpdateTargetWorkDurationFunction = int (*)(void *session, i64 targetDurationNanos);
+        using ReportActualWorkDurationFunction = int (*)(void *session, i64 actualDurationNanos);
+        using CloseSessionFunction = void (*)(void *session);
+
+        static constexpr i64 DefaultTargetDuration{16666667}; //!< The target duration of a frame prior to the guest's swap interval being known (60 FPS)
+        static constexpr i64 BoostTargetDivisor{2}; //!< The divisor of the target duration while the guest requests a CPU boost, boost mode raises the CPU clock by ~1.75x on the Switch
+
+        std::shared_ptr<Logger> logger;
+        void *manager{}; //!< The APerformanceHintManager of the process, this is nullptr if performance hints are unsupported or disabled
+        CreateSessionFunction createSession{};
+        UpdateTargetWorkDurationFunction updateTargetWorkDuration{};
+        ReportActualWorkDurationFunction reportActualWorkDuration{};
+        CloseSessionFunction closeSession{};
+
+        Mutex mutex; //!< Synchronizes access to the session and all of its parameters
+        void *session{}; //!< The APerformanceHintSession for all threads in threads, it's recreated whenever they change
+        std::array<pid_t, 3> threads{}; //!< The TIDs of every HintThread, the ones which are 0 aren't known yet
+        std::atomic<u64> pendingWork{}; //!< The duration of the work done on the current frame in nanoseconds, it's reported and reset by ReportFrame
+        i64 targetDuration{DefaultTargetDuration}; //!< The duration of a guest frame in nanoseconds
+        bool boost{}; //!< If the guest's current performance configuration is a CPU boost mode
+
+        /**
+         * @return The target work duration that is reported to the session
+         */
+        i64 GetSessionTarget() {
+            return boost ? (targetDuration / BoostTargetDivisor) : targetDuration;
+        }
+
+        /**
+         * @brief Closes the current session and creates one for all known threads, this must be called with the mutex held
+         */
+        void RecreateSession();
+
+      public:
+        /**
+         * @note This doesn't take a DeviceState as it's constructed prior to it
+         */
+        PerformanceHintManager(const std::shared_ptr<Settings> &settings, const std::shared_ptr<Logger> &logger);
+
+        ~PerformanceHintManager();
+
+        /**
+         * @brief Sets the TID of a thread which is a part of the frame's work, the session is recreated if it changed
+         * @note Sessions can only contain threads of this process, so a TID of any other process (such as a guest thread) is ignored
+         */
+        void SetThread(HintThread thread, pid_t tid);
+
+        /**
+         * @brief Sets the duration that every guest frame should take, this is the duration of the display refreshes the guest waits for between frames
+         */
+        void SetTargetDuration(u64 duration);
+
+        /**
+         * @brief Sets if the guest has requested a CPU boost through apm, the target duration is shortened while it's set
+         */
+        void SetBoost(bool boost);
+
+        /**
+         * @brief Adds to the duration of the work done on the current frame, this excludes any time waiting for work or for the display
+         */
+        void AddWork(u64 duration) {
+            if (manager)
+                pendingWork.fetch_add(duration, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Reports the work which was added since the last frame as the actual duration of the frame that was just shown
+         */
+        void ReportFrame();
+    };
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "types/KThread.h"
+#include "scheduler.h"
+
+namespace skyline::kernel {
+    Scheduler::Scheduler(AffinityManager &affinity) : affinity(affinity) {}
+
+    void Scheduler::Insert(CoreQueue &core, type::KThread *thread) {
+        auto position{std::upper_bound(core.threads.begin(), core.threads.end(), thread->priority, [](i8 priority, const type::KThread *other) {
+            return priority < other->priority;
+        })};
+        core.threads.insert(position, thread);
+    }
+
+    bool Scheduler::Erase(CoreQueue &core, type::KThread *thread) {
+        auto it{std::find(core.threads.begin(), core.threads.end(), thread)};
+        if (it == core.threads.end())
+            return false;
+        core.threads.erase(it);
+        return true;
+    }
+
+    void Scheduler::InsertThread(type::KThread *thread) {
+        auto &core{cores.at(thread->currentCore)};
+        std::lock_guard guard(core.lock);
+        if (std::find(core.threads.begin(), core.threads.end(), thread) == core.threads.end())
+            Insert(core, thread);
+    }
+
+    void Scheduler::RemoveThread(type::KThread *thread) {
+        auto &core{cores.at(thread->currentCore)};
+        std::lock_guard guard(core.lock);
+        Erase(core, thread);
+    }
+
+    void Scheduler::UpdatePriority(type::KThread *thread) {
+        auto &core{cores.at(thread->currentCore)};
+        std::lock_guard guard(core.lock);
+        if (Erase(core, thread))
+            Insert(core, thread);
+    }
+
+    void Scheduler::UpdateAffinity(type::KThread *thread) {
+        if (thread->affinityMask & (1ULL << thread->currentCore))
+            affinity.SetGuestAffinity(thread->tid, 1ULL << thread->currentCore);
+        else
+            MigrateThread(thread, static_cast<u8>(thread->idealCore));
+    }
+
+    void Scheduler::MigrateThread(type::KThread *thread, u8 core) {
+        if (core != thread->currentCore) {
+            auto &source{cores.at(thread->currentCore)};
+            auto &destination{cores.at(core)};
+            std::scoped_lock lock(source.lock, destination.lock); // This avoids deadlocks with concurrent migrations in the opposite direction
+
+            if (Erase(source, thread))
+                Insert(destination, thread);
+            thread->currentCore = core;
+        }
+
+        affinity.SetGuestAffinity(thread->tid, 1ULL << core);
+    }
+
+    void Scheduler::Yield(type::KThread *thread) {
+        {
+            auto &core{cores.at(thread->currentCore)};
+            std::lock_guard guard(core.lock);
+
+            auto it{std::find(core.threads.begin(), core.threads.end(), thread)};
+            if (it == core.threads.end())
+                return;
+
+            // The thread is moved behind all other threads of the same priority, if there are none then there's nothing to yield to
+            auto end{std::find_if(it, core.threads.end(), [thread](const type::KThread *other) { return other->priority != thread->priority; })};
+            if (std::next(it) == end)
+                return;
+            std::rotate(it, std::next(it), end);
+        }
+
+        sched_yield();
+    }
+
+    void Scheduler::YieldMigrate(type::KThread *thread) {
+        u8 target{thread->currentCore};
+        size_t targetLoad{SIZE_MAX};
+
+        for (u8 index{}; index < constant::GuestCoreCount; index++) {
+            if (!(thread->affinityMask & (1ULL << index)))
+                continue;
+
+            auto &core{cores[index]};
+            size_t load;
+            {
+                std::lock_guard guard(core.lock);
+                load = static_cast<size_t>(std::count_if(core.threads.begin(), core.threads.end(), [thread](const type::KThread *other) { return other != thread; })); // The thread itself doesn't count towards the load of its current core
+            }
+
+            if (load < targetLoad || (load == targetLoad && index == thread->currentCore)) {
+                target = index;
+                targetLoad = load;
+            }
+        }
+
+        if (target != thread->currentCore)
+            MigrateThread(thread, target);
+
+        sched_yield();
+    }
+
+    void Scheduler::YieldToAny() {
+        sched_yield();
+    }
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <array>
+#include <common.h>
+#include "affinity.h"
+
+namespace skyline::kernel {
+    namespace type {
+        class KThread;
+    }
+
+    /**
+     * @brief The Scheduler class models the 4 cores of the Switch by keeping track of the guest core each thread runs on, threads on the same guest core contend with each other for its host cores
+     * @details Guest threads execute natively so the host scheduler performs the actual scheduling, this only restricts each thread to the host cores of its guest core and implements the yield semantics of svcSleepThread on top of sched_yield
+     * @url https://switchbrew.org/wiki/SVC#SleepThread
+     */
+    class Scheduler {
+      private:
+        /**
+         * @brief The threads that are scheduled on a single guest core
+         */
+        struct CoreQueue {
+            Mutex lock; //!< Synchronizes all operations on the queue
+            std::vector<type::KThread *> threads; //!< The threads on this core sorted by priority, threads with the same priority are in round-robin order
+        };
+
+        AffinityManager &affinity;
+        std::array<CoreQueue, constant::GuestCoreCount> cores;
+
+        /**
+         * @brief Inserts a thread into a queue behind all threads with the same or a higher priority
+         * @note The lock of the queue must be held while calling this
+         */
+        static void Insert(CoreQueue &core, type::KThread *thread);
+
+        /**
+         * @brief Removes a thread from a queue if it's present in it
+         * @return If the thread was present in the queue
+         * @note The lock of the queue must be held while calling this
+         */
+        static bool Erase(CoreQueue &core, type::KThread *thread);
+
+      public:
+        Scheduler(AffinityManager &affinity);
+
+        /**
+         * @brief Adds a thread to the queue of the core it's currently on, this is done when it starts running
+         */
+        void InsertThread(type::KThread *thread);
+
+        /**
+         * @brief Removes a thread from the queue of the core it's currently on, this is done when it exits
+         */
+        void RemoveThread(type::KThread *thread);
+
+        /**
+         * @brief Repositions a thread in its queue after its priority was changed
+         */
+        void UpdatePriority(type::KThread *thread);
+
+        /**
+         * @brief Applies a change to the ideal core or affinity mask of a thread, it's migrated to its ideal core if its current core isn't in the mask anymore
+         */
+        void UpdateAffinity(type::KThread *thread);
+
+        /**
+         * @brief Moves a thread onto another guest core and restricts it to the host cores of that core
+         */
+        void MigrateThread(type::KThread *thread, u8 core);
+
+        /**
+         * @brief Yields the current thread to any other thread with the same priority on its core, this returns immediately if there are none
+         */
+        void Yield(type::KThread *thread);
+
+        /**
+         * @brief Yields the current thread and migrates it to the least loaded guest core in its affinity mask
+         */
+        void YieldMigrate(type::KThread *thread);
+
+        /**
+         * @brief Yields the current thread to any other thread regardless of its priority
+         */
+        void YieldToAny();
+    };
+}
@@ -66,10 +66,25 @@ namespace skyline::kernel::svc {
             return;
         }
 
-        block->attributes.isUncached = value.isUncached;
-        MemoryManager::InsertBlock(chunk, *block);
+        if (address + size < address || address + size > chunk->address + chunk->size) {
+            state.ctx->registers.w0 = result::InvalidAddress;
+            state.logger->Warn("svcSetMemoryAttribute: Range exceeds the chunk: 0x{:X} - 0x{:X} (Chunk: 0x{:X} - 0x{:X})", address, address + size, chunk->address, chunk->address + chunk->size);
+            return;
+        }
+
+        // Only the attributes of the specified range are changed, any blocks it spans retain their permissions
+        for (u64 blockAddress{address}; blockAddress < address + size;) {
+            auto attributedBlock{*state.os->memory.GetBlock(blockAddress, chunk)};
+            auto blockEnd{std::min(attributedBlock.address + attributedBlock.size, address + size)};
+            attributedBlock.address = blockAddress;
+            attributedBlock.size = blockEnd - blockAddress;
+            attributedBlock.attributes.isUncached = value.isUncached;
+            MemoryManager::InsertBlock(chunk, attributedBlock);
+
+            blockAddress = blockEnd;
+        }
 
-        state.logger->Debug("svcSetMemoryAttribute: Set caching to {} at 0x{:X} for 0x{:X} bytes", !block->attributes.isUncached, address, size);
+        state.logger->Debug("svcSetMemoryAttribute: Set caching to {} at 0x{:X} for 0x{:X} bytes", !value.isUncached, address, size);
         state.ctx->registers.w0 = Result{};
     }
 
@@ -117,6 +132,10 @@ namespace skyline::kernel::svc {
             throw exception("svcMapMemory: Cannot find memory object in handle table for address 0x{:X}", source);
         object->item->UpdatePermission(source, size, {false, false, false});
 
+        // The source is inaccessible till it's unmapped, when the contents of the destination are copied back into it, so its pages are released in the meantime rather than being held twice
+        if (state.os->memory.IsHostContiguous(source, size))
+            state.os->memory.ReleaseHostMemory(state.os->memory.GetHostAddress(source), size);
+
         state.logger->Debug("svcMapMemory: Mapped range 0x{:X} - 0x{:X} to 0x{:X} - 0x{:X} (Size: 0x{:X} bytes)", source, source + size, destination, destination + size, size);
         state.ctx->registers.w0 = Result{};
     }
@@ -165,9 +184,10 @@ namespace skyline::kernel::svc {
 
         destObject->item->UpdatePermission(destination, size, sourceDesc->block.permission);
 
-        state.process->CopyMemory(destination, source, size);
+        // The alias in the stack region holds the only copy of the contents as the pages of the original were released when it was mapped
+        state.process->CopyMemory(source, destination, size);
 
-        auto sourceObject{state.process->GetMemoryObject(destination)};
+        auto sourceObject{state.process->GetMemoryObject(source)};
         if (!sourceObject)
             throw exception("svcUnmapMemory: Cannot find source memory object in handle table for address 0x{:X}", source);
 
@@ -222,6 +242,7 @@ namespace skyline::kernel::svc {
         auto entryArgument{state.ctx->registers.x2};
         auto stackTop{state.ctx->registers.x3};
         auto priority{static_cast<i8>(state.ctx->registers.w4)};
+        auto idealCore{static_cast<i8>(state.ctx->registers.w5)};
 
         if (!state.thread->switchPriority.Valid(priority)) {
             state.ctx->registers.w0 = result::InvalidAddress;
@@ -229,8 +250,18 @@ namespace skyline::kernel::svc {
             return;
         }
 
-        auto thread{state.process->CreateThread(entryAddress, entryArgument, stackTop, priority)};
-        state.logger->Debug("svcCreateThread: Created thread with handle 0x{:X} (Entry Point: 0x{:X}, Argument: 0x{:X}, Stack Pointer: 0x{:X}, Priority: {}, TID: {})", thread->handle, entryAddress, entryArgument, stackTop, priority, thread->tid);
+        constexpr i8 IdealCoreUseProcessValue{-2}; // The thread should use the ideal core of the process
+        if (idealCore == IdealCoreUseProcessValue)
+            idealCore = state.process->threads.at(state.process->pid)->idealCore;
+
+        if (idealCore < 0 || idealCore >= constant::GuestCoreCount) {
+            state.ctx->registers.w0 = result::InvalidCoreId;
+            state.logger->Warn("svcCreateThread: 'idealCore' invalid: {}", idealCore);
+            return;
+        }
+
+        auto thread{state.process->CreateThread(entryAddress, entryArgument, stackTop, priority, idealCore)};
+        state.logger->Debug("svcCreateThread: Created thread with handle 0x{:X} (Entry Point: 0x{:X}, Argument: 0x{:X}, Stack Pointer: 0x{:X}, Priority: {}, Ideal Core: {}, TID: {})", thread->handle, entryAddress, entryArgument, stackTop, priority, idealCore, thread->tid);
 
         state.ctx->registers.w1 = thread->handle;
         state.ctx->registers.w0 = Result{};
@@ -257,11 +288,22 @@ namespace skyline::kernel::svc {
     void SleepThread(DeviceState &state) {
         auto in{state.ctx->registers.x0};
 
-        switch (in) {
-            case 0:
-            case 1:
-            case 2:
-                state.logger->Debug("svcSleepThread: Yielding thread: {}", in);
+        constexpr i64 YieldWithoutCoreMigration{0}; // Yields to threads with the same priority on the same core
+        constexpr i64 YieldWithCoreMigration{-1}; // Yields and allows the thread to be migrated to another core
+        constexpr i64 YieldToAnyThread{-2}; // Yields to any other thread regardless of priority
+
+        switch (static_cast<i64>(in)) {
+            case YieldWithoutCoreMigration:
+                state.logger->Debug("svcSleepThread: Yielding thread without core migration");
+                state.os->scheduler.Yield(state.thread.get());
+                break;
+            case YieldWithCoreMigration:
+                state.logger->Debug("svcSleepThread: Yielding thread with core migration");
+                state.os->scheduler.YieldMigrate(state.thread.get());
+                break;
+            case YieldToAnyThread:
+                state.logger->Debug("svcSleepThread: Yielding thread to any thread");
+                state.os->scheduler.YieldToAny();
                 break;
             default:
                 state.logger->Debug("svcSleepThread: Thread sleeping for {} ns", in);
@@ -276,7 +318,7 @@ namespace skyline::kernel::svc {
     void GetThreadPriority(DeviceState &state) {
         auto handle{state.ctx->registers.w1};
         try {
-            auto priority{state.process->GetHandle<type::KThread>(handle)->priority};
+            auto priority{state.process->GetHandle<type::KThread>(handle)->basePriority};
             state.logger->Debug("svcGetThreadPriority: Writing thread priority {}", priority);
 
             state.ctx->registers.w1 = priority;
@@ -301,6 +343,66 @@ namespace skyline::kernel::svc {
         }
     }
 
+    void GetThreadCoreMask(DeviceState &state) {
+        constexpr KHandle threadSelf{0xFFFF8000}; // The handle used by threads to refer to themselves
+        auto handle{state.ctx->registers.w2};
+
+        try {
+            auto thread{handle == threadSelf ? state.thread : state.process->GetHandle<type::KThread>(handle)};
+            state.logger->Debug("svcGetThreadCoreMask: Writing thread ideal core {} and affinity mask 0x{:X}", thread->idealCore, thread->affinityMask);
+
+            state.ctx->registers.w1 = static_cast<u32>(thread->idealCore);
+            state.ctx->registers.x2 = thread->affinityMask;
+            state.ctx->registers.w0 = Result{};
+        } catch (const std::exception &) {
+            state.logger->Warn("svcGetThreadCoreMask: 'handle' invalid: 0x{:X}", handle);
+            state.ctx->registers.w0 = result::InvalidHandle;
+        }
+    }
+
+    void SetThreadCoreMask(DeviceState &state) {
+        constexpr KHandle threadSelf{0xFFFF8000}; // The handle used by threads to refer to themselves
+        constexpr i32 IdealCoreDontCare{-1}; // The thread doesn't care about its ideal core
+        constexpr i32 IdealCoreUseProcessValue{-2}; // The thread should use the ideal core of the process
+        constexpr i32 IdealCoreNoUpdate{-3}; // The ideal core of the thread should be left as is
+
+        auto handle{state.ctx->registers.w0};
+        auto idealCore{static_cast<i32>(state.ctx->registers.w1)};
+        auto affinityMask{state.ctx->registers.x2};
+
+        try {
+            auto thread{handle == threadSelf ? state.thread : state.process->GetHandle<type::KThread>(handle)};
+
+            if (idealCore == IdealCoreUseProcessValue) {
+                idealCore = state.process->threads.at(state.process->pid)->idealCore;
+                affinityMask = 1ULL << idealCore;
+            } else if (idealCore == IdealCoreNoUpdate) {
+                idealCore = thread->idealCore;
+            } else if (idealCore == IdealCoreDontCare) {
+                idealCore = thread->idealCore; // We don't migrate threads between guest cores so the ideal core is left as is
+            }
+
+            if (affinityMask == 0 || (affinityMask & ~((1ULL << constant::GuestCoreCount) - 1))) {
+                state.ctx->registers.w0 = result::InvalidCoreId;
+                state.logger->Warn("svcSetThreadCoreMask: 'affinityMask' invalid: 0x{:X}", affinityMask);
+                return;
+            }
+
+            if (idealCore < 0 || idealCore >= constant::GuestCoreCount || !(affinityMask & (1ULL << idealCore))) {
+                state.ctx->registers.w0 = result::InvalidCombination;
+                state.logger->Warn("svcSetThreadCoreMask: 'idealCore' invalid with 'affinityMask' 0x{:X}: {}", affinityMask, idealCore);
+                return;
+            }
+
+            state.logger->Debug("svcSetThreadCoreMask: Setting thread ideal core to {} and affinity mask to 0x{:X}", idealCore, affinityMask);
+            thread->UpdateAffinity(static_cast<i8>(idealCore), affinityMask);
+            state.ctx->registers.w0 = Result{};
+        } catch (const std::exception &) {
+            state.logger->Warn("svcSetThreadCoreMask: 'handle' invalid: 0x{:X}", handle);
+            state.ctx->registers.w0 = result::InvalidHandle;
+        }
+    }
+
     void ClearEvent(DeviceState &state) {
         auto object{state.process->GetHandle<type::KEvent>(state.ctx->registers.w0)};
         object->signalled = false;
@@ -388,7 +490,7 @@ namespace skyline::kernel::svc {
     void ResetSignal(DeviceState &state) {
         auto handle{state.ctx->registers.w0};
         try {
-            auto &object{state.process->handles.at(handle)};
+            auto object{state.process->GetHandle<type::KObject>(handle)};
             switch (object->objectType) {
                 case type::KType::KEvent:
                     std::static_pointer_cast<type::KEvent>(object)->ResetSignal();
@@ -407,7 +509,7 @@ namespace skyline::kernel::svc {
 
             state.logger->Debug("svcResetSignal: Resetting signal: 0x{:X}", handle);
             state.ctx->registers.w0 = Result{};
-        } catch (const std::out_of_range &) {
+        } catch (const std::exception &) {
             state.logger->Warn("svcResetSignal: 'handle' invalid: 0x{:X}", handle);
             state.ctx->registers.w0 = result::InvalidHandle;
             return;
@@ -432,7 +534,15 @@ namespace skyline::kernel::svc {
         for (const auto &handle : waitHandles) {
             handleStr += fmt::format("* 0x{:X}\n", handle);
 
-            auto object{state.process->handles.at(handle)};
+            std::shared_ptr<type::KObject> object;
+            try {
+                object = state.process->GetHandle<type::KObject>(handle);
+            } catch (const std::exception &) {
+                state.logger->Warn("svcWaitSynchronization: 'handle' invalid: 0x{:X}", handle);
+                state.ctx->registers.w0 = result::InvalidHandle;
+                return;
+            }
+
             switch (object->objectType) {
                 case type::KType::KProcess:
                 case type::KType::KThread:
@@ -452,36 +562,49 @@ namespace skyline::kernel::svc {
         auto timeout{state.ctx->registers.x3};
         state.logger->Debug("svcWaitSynchronization: Waiting on handles:\n{}Timeout: 0x{:X} ns", handleStr, timeout);
 
+        // The thread registers itself as a waiter on all objects and sleeps till any of them is signalled, the wait is cancelled or the timeout elapses
+        auto thread{state.thread.get()};
+        for (const auto &object : objectTable)
+            object->AddWaiter(thread);
+
         auto start{util::GetTimeNs()};
         while (true) {
-            if (state.thread->cancelSync) {
-                state.thread->cancelSync = false;
+            auto sequence{thread->syncSequence.load(std::memory_order_acquire)};
+
+            if (thread->cancelSync) {
+                thread->cancelSync = false;
                 state.ctx->registers.w0 = result::Cancelled;
                 break;
             }
 
-            uint index{};
-            for (const auto &object : objectTable) {
-                if (object->signalled) {
-                    state.logger->Debug("svcWaitSynchronization: Signalled handle: 0x{:X}", waitHandles.at(index));
-                    state.ctx->registers.w0 = Result{};
-                    state.ctx->registers.w1 = index;
-                    return;
-                }
-                index++;
+            auto signalled{std::find_if(objectTable.begin(), objectTable.end(), [](const auto &object) { return object->signalled.load(); })};
+            if (signalled != objectTable.end()) {
+                auto index{static_cast<u32>(std::distance(objectTable.begin(), signalled))};
+                state.logger->Debug("svcWaitSynchronization: Signalled handle: 0x{:X}", waitHandles.at(index));
+                state.ctx->registers.w0 = Result{};
+                state.ctx->registers.w1 = index;
+                break;
             }
 
-            if ((util::GetTimeNs() - start) >= timeout) {
+            auto elapsed{util::GetTimeNs() - start};
+            if (elapsed >= timeout) {
                 state.logger->Debug("svcWaitSynchronization: Wait has timed out");
                 state.ctx->registers.w0 = result::TimedOut;
-                return;
+                break;
             }
+
+            thread->WaitSynchronization(sequence, timeout - elapsed);
         }
+
+        for (const auto &object : objectTable)
+            object->RemoveWaiter(thread);
     }
 
     void CancelSynchronization(DeviceState &state) {
         try {
-            state.process->GetHandle<type::KThread>(state.ctx->registers.w0)->cancelSync = true;
+            auto thread{state.process->GetHandle<type::KThread>(state.ctx->registers.w0)};
+            thread->cancelSync = true;
+            thread->WakeSynchronization();
         } catch (const std::exception &) {
             state.logger->Warn("svcCancelSynchronization: 'handle' invalid: 0x{:X}", state.ctx->registers.w0);
             state.ctx->registers.w0 = result::InvalidHandle;
@@ -721,4 +844,50 @@ namespace skyline::kernel::svc {
         state.ctx->registers.x1 = out;
         state.ctx->registers.w0 = Result{};
     }
+
+    void WaitForAddress(DeviceState &state) {
+        auto address{state.ctx->registers.x0};
+        if (!util::WordAligned(address)) {
+            state.logger->Warn("svcWaitForAddress: 'address' not word aligned: 0x{:X}", address);
+            state.ctx->registers.w0 = result::InvalidAddress;
+            return;
+        }
+
+        using ArbitrationType = type::KProcess::ArbitrationType;
+        auto arbitrationType{static_cast<ArbitrationType>(state.ctx->registers.w1)};
+        if (arbitrationType != ArbitrationType::WaitIfLessThan && arbitrationType != ArbitrationType::DecrementAndWaitIfLessThan && arbitrationType != ArbitrationType::WaitIfEqual) {
+            state.logger->Warn("svcWaitForAddress: 'arbitrationType' invalid: {}", static_cast<u32>(arbitrationType));
+            state.ctx->registers.w0 = result::InvalidEnumValue;
+            return;
+        }
+
+        auto value{static_cast<i32>(state.ctx->registers.w2)};
+        auto timeout{static_cast<i64>(state.ctx->registers.x3)};
+        state.logger->Debug("svcWaitForAddress: Waiting on 0x{:X} for type {} with value {}, Timeout: {} ns", address, static_cast<u32>(arbitrationType), value, timeout);
+
+        state.ctx->registers.w0 = state.process->WaitForAddress(address, arbitrationType, value, timeout);
+    }
+
+    void SignalToAddress(DeviceState &state) {
+        auto address{state.ctx->registers.x0};
+        if (!util::WordAligned(address)) {
+            state.logger->Warn("svcSignalToAddress: 'address' not word aligned: 0x{:X}", address);
+            state.ctx->registers.w0 = result::InvalidAddress;
+            return;
+        }
+
+        using SignalType = type::KProcess::SignalType;
+        auto signalType{static_cast<SignalType>(state.ctx->registers.w1)};
+        if (signalType != SignalType::Signal && signalType != SignalType::SignalAndIncrementIfEqual && signalType != SignalType::SignalAndModifyByWaitingCountIfEqual) {
+            state.logger->Warn("svcSignalToAddress: 'signalType' invalid: {}", static_cast<u32>(signalType));
+            state.ctx->registers.w0 = result::InvalidEnumValue;
+            return;
+        }
+
+        auto value{static_cast<i32>(state.ctx->registers.w2)};
+        auto count{static_cast<i32>(state.ctx->registers.w3)};
+        state.logger->Debug("svcSignalToAddress: Signalling 0x{:X} for type {} with value {}, Count: {}", address, static_cast<u32>(signalType), value, count);
+
+        state.ctx->registers.w0 = state.process->SignalToAddress(address, signalType, value, count);
+    }
 }
@@ -111,6 +111,18 @@ namespace skyline {
          */
         void SetThreadPriority(DeviceState &state);
 
+        /**
+         * @brief Get the ideal core and affinity mask of provided thread handle
+         * @url https://switchbrew.org/wiki/SVC#GetThreadCoreMask
+         */
+        void GetThreadCoreMask(DeviceState &state);
+
+        /**
+         * @brief Set the ideal core and affinity mask of provided thread handle
+         * @url https://switchbrew.org/wiki/SVC#SetThreadCoreMask
+         */
+        void SetThreadCoreMask(DeviceState &state);
+
         /**
          * @brief Clears a KEvent of it's signal
          * @url https://switchbrew.org/wiki/SVC#ClearEvent
@@ -213,6 +225,18 @@ namespace skyline {
          */
         void GetInfo(DeviceState &state);
 
+        /**
+         * @brief Waits on an address based on the value at it
+         * @url https://switchbrew.org/wiki/SVC#WaitForAddress
+         */
+        void WaitForAddress(DeviceState &state);
+
+        /**
+         * @brief Signals threads waiting on an address and optionally modifies the value at it
+         * @url https://switchbrew.org/wiki/SVC#SignalToAddress
+         */
+        void SignalToAddress(DeviceState &state);
+
         /**
          * @brief The SVC Table maps all SVCs to their corresponding functions
          */
@@ -231,8 +255,8 @@ namespace skyline {
             SleepThread, // 0x0B
             GetThreadPriority, // 0x0C
             SetThreadPriority, // 0x0D
-            nullptr, // 0x0E
-            nullptr, // 0x0F
+            GetThreadCoreMask, // 0x0E
+            SetThreadCoreMask, // 0x0F
             nullptr, // 0x10
             nullptr, // 0x11
             ClearEvent, // 0x12
@@ -269,8 +293,8 @@ namespace skyline {
             nullptr, // 0x31
             nullptr, // 0x32
             nullptr, // 0x33
-            nullptr, // 0x34
-            nullptr, // 0x35
+            WaitForAddress, // 0x34
+            SignalToAddress, // 0x35
             nullptr, // 0x36
             nullptr, // 0x37
             nullptr, // 0x38
@@ -29,4 +29,77 @@ namespace skyline::kernel::type {
 
         KObject(const DeviceState &state, KType objectType) : state(state), objectType(objectType) {}
     };
+
+    /**
+     * @brief A stateless allocator which recycles the storage of objects of a single type through a free list of slabs, so frequently created kernel objects don't go through the general-purpose allocator
+     * @note This is used with std::allocate_shared which rebinds it to its control block, so the reference counts of an object share its slot in the slab
+     */
+    template<typename Type>
+    class SlabAllocator {
+      private:
+        static constexpr size_t SlabSlots{0x40}; //!< The amount of slots that are allocated together when the free list is empty
+
+        union Slot {
+            Slot *next; //!< The next free slot, this is only valid while the slot is free
+            alignas(Type) u8 storage[sizeof(Type)];
+        };
+
+        /**
+         * @brief The free list of all slabs of the type, slabs are never released as they're reused by every following object of the type
+         */
+        struct Pool {
+            Mutex lock;
+            Slot *free{};
+        };
+
+        static inline Pool pool{};
+
+      public:
+        using value_type = Type;
+
+        SlabAllocator() = default;
+
+        template<typename Other>
+        SlabAllocator(const SlabAllocator<Other> &) {}
+
+        Type *allocate(size_t count) {
+            if (count != 1)
+                return static_cast<Type *>(::operator new(count * sizeof(Type), std::align_val_t{alignof(Type)}));
+
+            std::lock_guard guard(pool.lock);
+            if (!pool.free) {
+                auto slab{new Slot[SlabSlots]};
+                for (size_t slot{}; slot < SlabSlots - 1; slot++)
+                    slab[slot].next = &slab[slot + 1];
+                slab[SlabSlots - 1].next = nullptr;
+                pool.free = slab;
+            }
+
+            auto slot{pool.free};
+            pool.free = slot->next;
+            return reinterpret_cast<Type *>(slot->storage);
+        }
+
+        void deallocate(Type *pointer, size_t count) {
+            if (count != 1) {
+                ::operator delete(pointer, std::align_val_t{alignof(Type)});
+                return;
+            }
+
+            auto slot{reinterpret_cast<Slot *>(pointer)};
+            std::lock_guard guard(pool.lock);
+            slot->next = pool.free;
+            pool.free = slot;
+        }
+
+        template<typename Other>
+        bool operator==(const SlabAllocator<Other> &) const {
+            return true;
+        }
+
+        template<typename Other>
+        bool operator!=(const SlabAllocator<Other> &) const {
+            return false;
+        }
+    };
 }
@@ -1,49 +1,53 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include <android/sharedmem.h>
 #include <asm/unistd.h>
 #include <unistd.h>
 #include <os.h>
 #include <nce.h>
+#include <statistics.h>
 #include "KPrivateMemory.h"
 #include "KProcess.h"
 
 namespace skyline::kernel::type {
-    KPrivateMemory::KPrivateMemory(const DeviceState &state, u64 address, size_t size, memory::Permission permission, memory::MemoryState memState) : size(size), KMemory(state, KType::KPrivateMemory) {
+    KPrivateMemory::KPrivateMemory(const DeviceState &state, u64 address, size_t size, memory::Permission permission, memory::MemoryState memState, size_t capacity) : size(size), capacity(std::max(size, capacity)), KMemory(state, KType::KPrivateMemory) {
         if (address && !util::PageAligned(address))
             throw exception("KPrivateMemory was created with non-page-aligned address: 0x{:X}", address);
 
-        fd = ASharedMemory_create("KPrivateMemory", size);
-        if (fd < 0)
-            throw exception("An error occurred while creating shared memory: {}", fd);
+        fd = MemoryManager::CreateMemoryFile("KPrivateMemory", this->capacity);
 
-        auto host{mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED, fd, 0)};
-        if (host == MAP_FAILED)
-            throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+        auto host{state.os->memory.MapHostMemory(fd, this->capacity)};
+        state.statistics->TrackHostMapping(reinterpret_cast<u64>(host), this->capacity, memState.type);
 
-        Registers fregs{
-            .x0 = address,
-            .x1 = size,
-            .x2 = static_cast<u64>(permission.Get()),
-            .x3 = static_cast<u64>(MAP_SHARED | ((address) ? MAP_FIXED : 0)),
-            .x4 = static_cast<u64>(fd),
-            .x8 = __NR_mmap,
-        };
+        // A fixed mapping is mapped, reserved and advised in a single batch, otherwise the address chosen by the guest's mmap has to be known first
+        std::vector<SyscallDescriptor> syscalls{{.number = __NR_mmap, .arguments = {address, this->capacity, static_cast<u64>(permission.Get()), static_cast<u64>(MAP_SHARED | ((address) ? MAP_FIXED : 0)), static_cast<u64>(fd)}}};
+        if (!address) {
+            state.nce->ExecuteSyscalls(syscalls);
+            if (syscalls.front().result < 0)
+                throw exception("An error occurred while mapping private memory in child process");
+            address = static_cast<u64>(syscalls.front().result);
+            syscalls.clear();
+        }
+        this->address = address;
 
-        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-        if (fregs.x0 < 0)
-            throw exception("An error occurred while mapping private memory in child process");
+        size_t reservation{syscalls.size()};
+        if (this->capacity > size)
+            syscalls.push_back({.number = __NR_mprotect, .arguments = {this->address + size, this->capacity - size, PROT_NONE}});
+        state.os->memory.AdviseGuestMemory(this->address, this->capacity, syscalls);
 
-        this->address = fregs.x0;
+        state.nce->ExecuteSyscalls(syscalls);
+        if (reservation && syscalls.front().result < 0)
+            throw exception("An error occurred while mapping private memory in child process");
+        if (this->capacity > size && syscalls[reservation].result < 0)
+            throw exception("An error occurred while reserving private memory in child process");
 
         BlockDescriptor block{
-            .address = fregs.x0,
+            .address = this->address,
             .size = size,
             .permission = permission,
         };
         ChunkDescriptor chunk{
-            .address = fregs.x0,
+            .address = this->address,
             .size = size,
             .host = reinterpret_cast<u64>(host),
             .state = memState,
@@ -53,65 +57,75 @@ namespace skyline::kernel::type {
     }
 
     void KPrivateMemory::Resize(size_t nSize) {
-        if (close(fd) < 0)
-            throw exception("An error occurred while trying to close shared memory FD: {}", strerror(errno));
+        if (nSize <= capacity) {
+            // The memory is resized in place by only changing the accessibility of the reserved region, this avoids remapping or copying any memory
+            auto chunk{state.os->memory.GetChunk(address)};
+            if (nSize > size) {
+                state.os->memory.ResizeChunk(chunk, nSize);
 
-        fd = ASharedMemory_create("KPrivateMemory", nSize);
-        if (fd < 0)
-            throw exception("An error occurred while creating shared memory: {}", fd);
+                Registers fregs{
+                    .x0 = address + size,
+                    .x1 = nSize - size,
+                    .x2 = static_cast<u64>(chunk->blockList.back().permission.Get()),
+                    .x8 = __NR_mprotect,
+                };
 
-        Registers fregs{
-            .x0 = address,
-            .x1 = size,
-            .x8 = __NR_munmap
-        };
+                state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
+                if (fregs.x0 < 0)
+                    throw exception("An error occurred while growing private memory in child process");
+            } else if (nSize < size) {
+                Registers fregs{
+                    .x0 = address + nSize,
+                    .x1 = size - nSize,
+                    .x2 = PROT_NONE,
+                    .x8 = __NR_mprotect,
+                };
 
-        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-        if (fregs.x0 < 0)
-            throw exception("An error occurred while unmapping private memory in child process");
+                state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
+                if (fregs.x0 < 0)
+                    throw exception("An error occurred while shrinking private memory in child process");
 
-        fregs = {
-            .x0 = address,
-            .x1 = nSize,
-            .x2 = static_cast<u64>(PROT_READ | PROT_WRITE | PROT_EXEC),
-            .x3 = static_cast<u64>(MAP_SHARED | MAP_FIXED),
-            .x4 = static_cast<u64>(fd),
-            .x8 = __NR_mmap,
-        };
+                // The pages are released so that they're zeroed if the memory grows into them again
+                state.os->memory.ReleaseHostMemory(chunk->host + nSize, size - nSize);
+                state.os->memory.ResizeChunk(chunk, nSize);
+            }
 
-        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-        if (fregs.x0 < 0)
-            throw exception("An error occurred while remapping private memory in child process");
+            size = nSize;
+            return;
+        }
 
-        auto chunk{state.os->memory.GetChunk(address)};
-        state.process->WriteMemory(reinterpret_cast<void *>(chunk->host), address, std::min(nSize, size), true);
+        // The memory file is grown in place, so the existing contents are retained and only the mappings need to be extended rather than copied
+        MemoryManager::ResizeMemoryFile(fd, nSize);
 
-        for (const auto &block : chunk->blockList) {
-            if ((block.address - chunk->address) < size) {
-                fregs = {
-                    .x0 = block.address,
-                    .x1 = std::min(block.size, (chunk->address + nSize) - block.address),
-                    .x2 = static_cast<u64>(block.permission.Get()),
-                    .x8 = __NR_mprotect,
-                };
+        // The guest mapping is extended and the permissions of all blocks are restored in a single batch
+        std::vector<SyscallDescriptor> syscalls{{.number = __NR_mmap, .arguments = {address, nSize, static_cast<u64>(PROT_READ | PROT_WRITE | PROT_EXEC), static_cast<u64>(MAP_SHARED | MAP_FIXED), static_cast<u64>(fd)}}};
 
-                state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-                if (fregs.x0 < 0)
-                    throw exception("An error occurred while updating private memory's permissions in child process");
-            } else {
+        auto chunk{state.os->memory.GetChunk(address)};
+        for (const auto &block : chunk->blockList) {
+            if ((block.address - chunk->address) < size)
+                syscalls.push_back({.number = __NR_mprotect, .arguments = {block.address, std::min(block.size, (chunk->address + nSize) - block.address), static_cast<u64>(block.permission.Get())}});
+            else
                 break;
-            }
         }
+        auto permissionCount{syscalls.size() - 1};
+        state.os->memory.AdviseGuestMemory(address, nSize, syscalls);
 
-        munmap(reinterpret_cast<void *>(chunk->host), size);
+        state.nce->ExecuteSyscalls(syscalls);
+        if (syscalls.front().result < 0)
+            throw exception("An error occurred while remapping private memory in child process");
+        if (std::any_of(syscalls.begin() + 1, syscalls.begin() + 1 + permissionCount, [](const SyscallDescriptor &syscall) { return syscall.result < 0; }))
+            throw exception("An error occurred while updating private memory's permissions in child process");
 
-        auto host{mmap(reinterpret_cast<void *>(chunk->host), nSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED, fd, 0)};
-        if (host == MAP_FAILED)
-            throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+        munmap(reinterpret_cast<void *>(chunk->host), capacity);
+        state.statistics->UntrackHostMapping(chunk->host);
+
+        auto host{state.os->memory.MapHostMemory(fd, nSize, chunk->host)};
+        state.statistics->TrackHostMapping(reinterpret_cast<u64>(host), nSize, chunk->state.type);
 
         chunk->host = reinterpret_cast<u64>(host);
-        MemoryManager::ResizeChunk(chunk, nSize);
+        state.os->memory.ResizeChunk(chunk, nSize);
         size = nSize;
+        capacity = nSize;
     }
 
     void KPrivateMemory::UpdatePermission(u64 address, u64 size, memory::Permission permission) {
@@ -129,8 +143,12 @@ namespace skyline::kernel::type {
         auto chunk{state.os->memory.GetChunk(address)};
 
         // If a static code region has been mapped as writable it needs to be changed to mutable
-        if (chunk->state.value == memory::states::CodeStatic.value && permission.w)
+        if (chunk->state.value == memory::states::CodeStatic.value && permission.w) {
+            state.statistics->UpdateMemoryUsage(memory::MemoryType::CodeStatic, -static_cast<i64>(chunk->size));
+            state.statistics->UpdateMemoryUsage(memory::MemoryType::CodeMutable, static_cast<i64>(chunk->size));
+            state.statistics->TrackHostMapping(chunk->host, capacity, memory::MemoryType::CodeMutable);
             chunk->state = memory::states::CodeMutable;
+        }
 
         BlockDescriptor block{
             .address = address,
@@ -145,7 +163,7 @@ namespace skyline::kernel::type {
             if (state.process) {
                 Registers fregs{
                     .x0 = address,
-                    .x1 = size,
+                    .x1 = capacity,
                     .x8 = __NR_munmap,
                 };
                 state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
@@ -155,8 +173,10 @@ namespace skyline::kernel::type {
 
         auto chunk{state.os->memory.GetChunk(address)};
         if (chunk) {
-            munmap(reinterpret_cast<void *>(chunk->host), chunk->size);
+            munmap(reinterpret_cast<void *>(chunk->host), capacity);
+            state.statistics->UntrackHostMapping(chunk->host);
             state.os->memory.DeleteChunk(address);
         }
+        close(fd);
     }
 };
@@ -12,6 +12,7 @@ namespace skyline::kernel::type {
     class KPrivateMemory : public KMemory {
       private:
         int fd; //!< A file descriptor to the underlying shared memory
+        size_t capacity{}; //!< The size of the address space reserved for the memory on the host and in the guest, it can grow up to this size in place
 
       public:
         u64 address{}; //!< The address of the allocated memory
@@ -22,8 +23,9 @@ namespace skyline::kernel::type {
          * @param size The size of the allocation
          * @param permission The permissions for the allocated memory
          * @param memState The MemoryState of the chunk of memory
+         * @param capacity The size of the address space to reserve for the memory to grow into in place, anything past the size is inaccessible till it's resized
          */
-        KPrivateMemory(const DeviceState &state, u64 address, size_t size, memory::Permission permission, memory::MemoryState memState);
+        KPrivateMemory(const DeviceState &state, u64 address, size_t size, memory::Permission permission, memory::MemoryState memState, size_t capacity = 0);
 
         /**
          * @brief Remap a chunk of memory as to change the size occupied by it
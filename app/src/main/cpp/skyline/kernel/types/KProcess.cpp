@@ -2,23 +2,33 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <fcntl.h>
+#include <climits>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <linux/futex.h>
 #include <asm/unistd.h>
 #include <nce/guest.h>
 #include <nce.h>
 #include <os.h>
+#include <kernel/results.h>
 #include "KProcess.h"
 
 namespace skyline::kernel::type {
     KProcess::TlsPage::TlsPage(u64 address) : address(address) {}
 
     u64 KProcess::TlsPage::ReserveSlot() {
-        if (Full())
-            throw exception("Trying to get TLS slot from full page");
+        for (u8 index{}; index < constant::TlsSlots; index++) {
+            if (!slot[index]) {
+                slot[index] = true;
+                return Get(index);
+            }
+        }
 
-        slot[index] = true;
-        return Get(index++); // ++ on right will cause increment after evaluation of expression
+        throw exception("Trying to get TLS slot from full page");
+    }
+
+    void KProcess::TlsPage::FreeSlot(u64 slotAddress) {
+        slot[(slotAddress - address) / constant::TlsSlotSize] = false;
     }
 
     u64 KProcess::TlsPage::Get(u8 slotNo) {
@@ -29,14 +39,10 @@ namespace skyline::kernel::type {
     }
 
     bool KProcess::TlsPage::Full() {
-        return slot[constant::TlsSlots - 1];
+        return std::all_of(std::begin(slot), std::end(slot), [](bool reserved) { return reserved; });
     }
 
-    u64 KProcess::GetTlsSlot() {
-        for (auto &tlsPage: tlsPages)
-            if (!tlsPage->Full())
-                return tlsPage->ReserveSlot();
-
+    std::shared_ptr<KProcess::TlsPage> &KProcess::AllocateTlsPage() {
         u64 address;
         if (tlsPages.empty()) {
             auto region{state.os->memory.tlsIo};
@@ -49,22 +55,59 @@ namespace skyline::kernel::type {
         tlsPages.push_back(std::make_shared<TlsPage>(tlsMem->address));
 
         auto &tlsPage{tlsPages.back()};
-        if (tlsPages.empty())
+        if (tlsPages.size() == 1)
             tlsPage->ReserveSlot(); // User-mode exception handling
 
-        return tlsPage->ReserveSlot();
+        return tlsPage;
+    }
+
+    u64 KProcess::GetTlsSlot() {
+        for (auto &tlsPage: tlsPages)
+            if (!tlsPage->Full())
+                return tlsPage->ReserveSlot();
+
+        return AllocateTlsPage()->ReserveSlot();
+    }
+
+    void KProcess::FreeTlsSlot(u64 address) {
+        for (auto &tlsPage : tlsPages) {
+            if (tlsPage->address == util::AlignDown(address, PAGE_SIZE)) {
+                tlsPage->FreeSlot(address);
+                return;
+            }
+        }
+    }
+
+    std::shared_ptr<type::KSharedMemory> KProcess::AllocateThreadContext() {
+        constexpr size_t size{util::AlignUp(sizeof(ThreadContext), PAGE_SIZE)};
+        auto ctxMemory{std::make_shared<type::KSharedMemory>(state, 0, size, memory::Permission{true, true, false}, memory::states::Reserved)};
+        ctxMemory->Map(0, size, memory::Permission{true, true, false});
+        return ctxMemory;
     }
 
     void KProcess::InitializeMemory() {
         constexpr size_t DefHeapSize{0x200000}; // The default amount of heap
-        heap = NewHandle<KPrivateMemory>(state.os->memory.heap.address, DefHeapSize, memory::Permission{true, true, false}, memory::states::Heap).item;
+        heap = NewHandle<KPrivateMemory>(state.os->memory.heap.address, DefHeapSize, memory::Permission{true, true, false}, memory::states::Heap, state.os->memory.heap.size).item; // The entire heap region is reserved so svcSetHeapSize can resize the heap in place
+
+        std::lock_guard guard(threadLock);
         threads[pid]->tls = GetTlsSlot();
+
+        // Enough TLS pages and thread contexts for the first threads are allocated now so creating them doesn't require mapping any memory into the guest
+        size_t freeSlots{};
+        for (auto &tlsPage : tlsPages)
+            freeSlots += static_cast<size_t>(std::count(std::begin(tlsPage->slot), std::end(tlsPage->slot), false));
+        for (; freeSlots < constant::ThreadPoolSize; freeSlots += constant::TlsSlots)
+            AllocateTlsPage();
+
+        while (ctxPool.size() < constant::ThreadPoolSize)
+            ctxPool.push_back(AllocateThreadContext());
     }
 
-    KProcess::KProcess(const DeviceState &state, pid_t pid, u64 entryPoint, std::shared_ptr<type::KSharedMemory> &stack, std::shared_ptr<type::KSharedMemory> &tlsMemory) : pid(pid), stack(stack), KSyncObject(state, KType::KProcess) {
+    KProcess::KProcess(const DeviceState &state, pid_t pid, std::shared_ptr<type::KSharedMemory> &stack, std::shared_ptr<type::KSharedMemory> &tlsMemory) : pid(pid), stack(stack), KSyncObject(state, KType::KProcess) {
         constexpr u8 DefaultPriority{44}; // The default priority of a process
+        constexpr i8 DefaultCore{0}; // The default ideal core of a process
 
-        auto thread{NewHandle<KThread>(pid, entryPoint, 0x0, stack->guest.address + stack->guest.size, 0, DefaultPriority, this, tlsMemory).item};
+        auto thread{NewHandle<KThread>(pid, 0, 0x0, stack->guest.address + stack->guest.size, 0, DefaultPriority, DefaultCore, this, tlsMemory).item};
         threads[pid] = thread;
         state.nce->WaitThreadInit(thread);
 
@@ -78,37 +121,126 @@ namespace skyline::kernel::type {
         status = Status::Exiting;
     }
 
-    std::shared_ptr<KThread> KProcess::CreateThread(u64 entryPoint, u64 entryArg, u64 stackTop, i8 priority) {
-        auto size{(sizeof(ThreadContext) + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1)};
-        auto tlsMem{std::make_shared<type::KSharedMemory>(state, 0, size, memory::Permission{true, true, false}, memory::states::Reserved)};
+    std::shared_ptr<KThread> KProcess::CreateThread(u64 entryPoint, u64 entryArg, u64 stackTop, i8 priority, i8 idealCore) {
+        std::unique_lock lock(threadLock);
+
+        std::shared_ptr<type::KSharedMemory> tlsMem;
+        if (!ctxPool.empty()) {
+            tlsMem = std::move(ctxPool.back());
+            ctxPool.pop_back();
+            std::memset(reinterpret_cast<void *>(tlsMem->kernel.address), 0, sizeof(ThreadContext)); // A recycled context still holds the state of the thread which previously used it
+        } else {
+            tlsMem = AllocateThreadContext();
+        }
+        auto tls{GetTlsSlot()};
 
         Registers fregs{
-            .x0 = CLONE_THREAD | CLONE_SIGHAND | CLONE_PTRACE | CLONE_FS | CLONE_VM | CLONE_FILES | CLONE_IO,
+            .x0 = CLONE_THREAD | CLONE_SIGHAND | CLONE_PTRACE | CLONE_FS | CLONE_VM | CLONE_FILES | CLONE_IO | CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID,
             .x1 = stackTop,
-            .x3 = tlsMem->Map(0, size, memory::Permission{true, true, false}),
+            .x3 = tlsMem->guest.address,
+            .x4 = tlsMem->guest.address + offsetof(ThreadContext, exitTid),
             .x8 = __NR_clone,
             .x5 = reinterpret_cast<u64>(&guest::GuestEntry),
-            .x6 = entryPoint,
         };
 
         state.nce->ExecuteFunction(ThreadCall::Clone, fregs);
-        if (static_cast<int>(fregs.x0) < 0)
+        if (static_cast<int>(fregs.x0) < 0) {
+            ctxPool.push_back(std::move(tlsMem));
+            FreeTlsSlot(tls);
             throw exception("Cannot create thread: Address: 0x{:X}, Stack Top: 0x{:X}", entryPoint, stackTop);
+        }
+        lock.unlock();
 
         auto pid{static_cast<pid_t>(fregs.x0)};
-        auto process{NewHandle<KThread>(pid, entryPoint, entryArg, stackTop, GetTlsSlot(), priority, this, tlsMem).item};
+        auto process{NewHandle<KThread>(pid, entryPoint, entryArg, stackTop, tls, priority, idealCore, this, tlsMem).item};
         threads[pid] = process;
 
         return process;
     }
 
+    void KProcess::RecycleThread(const std::shared_ptr<KThread> &thread) {
+        std::lock_guard guard(threadLock);
+        FreeTlsSlot(thread->tls);
+        ctxPool.push_back(std::move(thread->ctxMemory));
+    }
+
     u64 KProcess::GetHostAddress(u64 address) {
-        auto chunk{state.os->memory.GetChunk(address)};
-        return (chunk && chunk->host) ? chunk->host + (address - chunk->address) : 0;
+        return state.os->memory.GetHostAddress(address);
+    }
+
+    /**
+     * @brief Performs a batch of transfers between guest memory and host buffers, this is the implementation of KProcess::ReadMemoryBatch and KProcess::WriteMemoryBatch
+     * @param write If the transfers are written to the guest rather than read from it
+     */
+    static void TransferMemoryBatch(KProcess &process, span<const KProcess::MemoryTransfer> transfers, bool forceGuest, bool write) {
+        std::vector<iovec> local;
+        std::vector<iovec> remote;
+        local.reserve(std::min<size_t>(transfers.size(), IOV_MAX));
+        remote.reserve(local.capacity());
+        ssize_t batchSize{};
+
+        auto flush{[&]() {
+            auto transferred{write ? process_vm_writev(process.pid, local.data(), local.size(), remote.data(), remote.size(), 0) : process_vm_readv(process.pid, local.data(), local.size(), remote.data(), remote.size(), 0)};
+            if (transferred != batchSize) {
+                // process_vm_readv/writev stop at the first range they fail on, every range from that point onwards is transferred individually through the memory file
+                size_t index{};
+                for (; transferred > 0 && index < local.size() && static_cast<size_t>(transferred) >= local[index].iov_len; index++)
+                    transferred -= local[index].iov_len;
+
+                for (; index < local.size(); index++) {
+                    if (write)
+                        pwrite64(process.memFd, local[index].iov_base, local[index].iov_len, reinterpret_cast<u64>(remote[index].iov_base));
+                    else
+                        pread64(process.memFd, local[index].iov_base, local[index].iov_len, reinterpret_cast<u64>(remote[index].iov_base));
+                }
+            }
+
+            local.clear();
+            remote.clear();
+            batchSize = 0;
+        }};
+
+        for (const auto &transfer : transfers) {
+            if (!forceGuest && process.state.os->memory.IsHostContiguous(transfer.guest, transfer.size)) {
+                auto host{process.GetHostAddress(transfer.guest)};
+                if (host) {
+                    if (write)
+                        std::memcpy(reinterpret_cast<void *>(host), transfer.host, transfer.size);
+                    else
+                        std::memcpy(transfer.host, reinterpret_cast<void *>(host), transfer.size);
+                    continue;
+                }
+            }
+
+            // Guest addresses are directly accessible when the guest shares our address space, this is the case for ranges which aren't host-mapped or are forced through the guest
+            if (process.state.os->memory.IsSharedAddressSpace()) {
+                if (write)
+                    std::memcpy(reinterpret_cast<void *>(transfer.guest), transfer.host, transfer.size);
+                else
+                    std::memcpy(transfer.host, reinterpret_cast<void *>(transfer.guest), transfer.size);
+                continue;
+            }
+
+            local.push_back(iovec{
+                .iov_base = transfer.host,
+                .iov_len = transfer.size,
+            });
+            remote.push_back(iovec{
+                .iov_base = reinterpret_cast<void *>(transfer.guest),
+                .iov_len = transfer.size,
+            });
+            batchSize += transfer.size;
+
+            if (local.size() == IOV_MAX)
+                flush();
+        }
+
+        if (!local.empty())
+            flush();
     }
 
     void KProcess::ReadMemory(void *destination, u64 offset, size_t size, bool forceGuest) {
-        if (!forceGuest) {
+        if (!forceGuest && state.os->memory.IsHostContiguous(offset, size)) {
             auto source{GetHostAddress(offset)};
 
             if (source) {
@@ -117,6 +249,11 @@ namespace skyline::kernel::type {
             }
         }
 
+        if (state.os->memory.IsSharedAddressSpace()) {
+            std::memcpy(destination, reinterpret_cast<void *>(offset), size);
+            return;
+        }
+
         struct iovec local{
             .iov_base = destination,
             .iov_len = size,
@@ -132,7 +269,7 @@ namespace skyline::kernel::type {
     }
 
     void KProcess::WriteMemory(const void *source, u64 offset, size_t size, bool forceGuest) {
-        if (!forceGuest) {
+        if (!forceGuest && state.os->memory.IsHostContiguous(offset, size)) {
             auto destination{GetHostAddress(offset)};
 
             if (destination) {
@@ -141,6 +278,11 @@ namespace skyline::kernel::type {
             }
         }
 
+        if (state.os->memory.IsSharedAddressSpace()) {
+            std::memcpy(reinterpret_cast<void *>(offset), source, size);
+            return;
+        }
+
         struct iovec local{
             .iov_base = const_cast<void *>(source),
             .iov_len = size,
@@ -155,12 +297,28 @@ namespace skyline::kernel::type {
             pwrite64(memFd, source, size, offset);
     }
 
+    void KProcess::ReadMemoryBatch(span<const MemoryTransfer> transfers, bool forceGuest) {
+        TransferMemoryBatch(*this, transfers, forceGuest, false);
+    }
+
+    void KProcess::WriteMemoryBatch(span<const MemoryTransfer> transfers, bool forceGuest) {
+        TransferMemoryBatch(*this, transfers, forceGuest, true);
+    }
+
     void KProcess::CopyMemory(u64 source, u64 destination, size_t size) {
         auto sourceHost{GetHostAddress(source)};
         auto destinationHost{GetHostAddress(destination)};
+        bool sourceContiguous{sourceHost && state.os->memory.IsHostContiguous(source, size)};
+        bool destinationContiguous{destinationHost && state.os->memory.IsHostContiguous(destination, size)};
 
-        if (sourceHost && destinationHost) {
+        if (sourceContiguous && destinationContiguous) {
             std::memcpy(reinterpret_cast<void *>(destinationHost), reinterpret_cast<const void *>(sourceHost), size);
+        } else if (state.os->memory.IsSharedAddressSpace()) {
+            std::memmove(reinterpret_cast<void *>(destination), reinterpret_cast<const void *>(source), size);
+        } else if (destinationContiguous) {
+            ReadMemory(reinterpret_cast<void *>(destinationHost), source, size);
+        } else if (sourceContiguous) {
+            WriteMemory(reinterpret_cast<const void *>(sourceHost), destination, size);
         } else {
             if (size <= PAGE_SIZE) {
                 std::vector<u8> buffer(size);
@@ -179,21 +337,72 @@ namespace skyline::kernel::type {
         }
     }
 
-    std::optional<KProcess::HandleOut<KMemory>> KProcess::GetMemoryObject(u64 address) {
-        for (KHandle index{}; index < handles.size(); index++) {
-            auto& object{handles[index]};
-            switch (object->objectType) {
-                case type::KType::KPrivateMemory:
-                case type::KType::KSharedMemory:
-                case type::KType::KTransferMemory: {
-                    auto mem{std::static_pointer_cast<type::KMemory>(object)};
-                    if (mem->IsInside(address))
-                        return std::make_optional<KProcess::HandleOut<KMemory>>({mem, constant::BaseHandleIndex + index});
-                }
+    KHandle KProcess::AllocateHandle() {
+        std::lock_guard guard(handleLock);
 
-                default:
-                    break;
-            }
+        u16 index;
+        if (!freeHandles.empty()) {
+            index = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            if (handles.size() >= constant::HandleSlotCount)
+                throw exception("Cannot allocate any more handles: {} slots are in use", handles.size());
+            index = static_cast<u16>(handles.size());
+            handles.emplace_back();
+        }
+
+        return (static_cast<KHandle>(handles[index].generation) << constant::HandleGenerationShift) | (constant::BaseHandleIndex + index);
+    }
+
+    void KProcess::SetHandle(KHandle handle, const std::shared_ptr<KObject> &object) {
+        std::lock_guard guard(handleLock);
+        GetHandleSlot(handle).object = object;
+
+        switch (object->objectType) {
+            case type::KType::KPrivateMemory:
+            case type::KType::KSharedMemory:
+            case type::KType::KTransferMemory:
+                memoryHandles.push_back(handle);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    KProcess::HandleSlot &KProcess::GetHandleSlot(KHandle handle) {
+        auto index{static_cast<u16>(handle - constant::BaseHandleIndex)}; // Handles below constant::BaseHandleIndex wrap around to an index past the end of the table
+        if (index >= handles.size())
+            throw exception("GetHandle was called with an invalid handle: 0x{:X}", handle);
+
+        auto &slot{handles[index]};
+        if ((handle >> constant::HandleGenerationShift) != slot.generation)
+            throw exception("GetHandle was called with a stale handle: 0x{:X}", handle);
+
+        return slot;
+    }
+
+    void KProcess::CloseHandle(KHandle handle) {
+        std::shared_ptr<KObject> object; // The object is destroyed after handleLock is released as the destructor might access the handle table
+        {
+            std::lock_guard guard(handleLock);
+            auto &slot{GetHandleSlot(handle)};
+            object = std::move(slot.object);
+            slot.generation = (slot.generation + 1) & constant::HandleGenerationMask;
+            freeHandles.push_back(static_cast<u16>(handle - constant::BaseHandleIndex));
+
+            auto memoryHandle{std::find(memoryHandles.begin(), memoryHandles.end(), handle)};
+            if (memoryHandle != memoryHandles.end())
+                memoryHandles.erase(memoryHandle);
+        }
+    }
+
+    std::optional<KProcess::HandleOut<KMemory>> KProcess::GetMemoryObject(u64 address) {
+        std::lock_guard guard(handleLock);
+        for (auto handle : memoryHandles) {
+            auto mem{std::static_pointer_cast<type::KMemory>(GetHandleSlot(handle).object)};
+            if (mem->IsInside(address))
+                return std::make_optional<KProcess::HandleOut<KMemory>>({mem, handle});
         }
         return std::nullopt;
     }
@@ -202,9 +411,8 @@ namespace skyline::kernel::type {
         std::unique_lock lock(mutexLock);
 
         auto mtx{GetPointer<u32>(address)};
-        auto &mtxWaiters{mutexes[address]};
 
-        if (mtxWaiters.empty()) {
+        if (!mutexes.Find(address)) {
             u32 mtxExpected{};
             if (__atomic_compare_exchange_n(mtx, &mtxExpected, (constant::MtxOwnerMask & state.thread->handle), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
                 return true;
@@ -213,27 +421,13 @@ namespace skyline::kernel::type {
         if (__atomic_load_n(mtx, __ATOMIC_SEQ_CST) != (owner | ~constant::MtxOwnerMask))
             return false;
 
-        std::shared_ptr<WaitStatus> status;
-        for (auto it{mtxWaiters.begin()};; it++) {
-            if (it != mtxWaiters.end() && (*it)->priority >= state.thread->priority)
-                continue;
-
-            status = std::make_shared<WaitStatus>(state.thread->priority, state.thread->handle);
-            mtxWaiters.insert(it, status);
-            break;
-        }
+        auto status{&state.thread->waitStatus};
+        status->Reset(state.thread->priority, state.thread->handle);
+        InsertMutexWaiter(address, status, owner);
 
+        // The thread that unlocks the mutex removes us from the waiters and transfers ownership to us prior to waking us up
         lock.unlock();
-        while (!status->flag);
-        lock.lock();
-        status->flag = false;
-
-        for (auto it{mtxWaiters.begin()}; it != mtxWaiters.end(); it++) {
-            if ((*it)->handle == state.thread->handle) {
-                mtxWaiters.erase(it);
-                break;
-            }
-        }
+        status->Wait();
 
         return true;
     }
@@ -242,10 +436,10 @@ namespace skyline::kernel::type {
         std::unique_lock lock(mutexLock);
 
         auto mtx{GetPointer<u32>(address)};
-        auto &mtxWaiters{mutexes[address]};
+        auto mtxWaiters{mutexes.Find(address)};
         u32 mtxDesired{};
-        if (!mtxWaiters.empty())
-            mtxDesired = (*mtxWaiters.begin())->handle | ((mtxWaiters.size() > 1) ? ~constant::MtxOwnerMask : 0);
+        if (mtxWaiters)
+            mtxDesired = mtxWaiters->Front()->handle | ((mtxWaiters->Size() > 1) ? ~constant::MtxOwnerMask : 0);
 
         u32 mtxExpected{(constant::MtxOwnerMask & state.thread->handle) | ~constant::MtxOwnerMask};
         if (!__atomic_compare_exchange_n(mtx, &mtxExpected, mtxDesired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
@@ -255,121 +449,239 @@ namespace skyline::kernel::type {
                 return false;
         }
 
+        auto &inheritedMutexes{state.thread->inheritedMutexes};
+        auto inherited{std::find(inheritedMutexes.begin(), inheritedMutexes.end(), address)};
+        bool wasInherited{inherited != inheritedMutexes.end()};
+        if (wasInherited)
+            inheritedMutexes.erase(inherited);
+
         if (mtxDesired) {
-            auto status{(*mtxWaiters.begin())};
-            status->flag = true;
-            lock.unlock();
-            while (status->flag);
-            lock.lock();
+            auto next{mtxWaiters->PopFront()};
+
+            // The new owner inherits the priority of the waiters that remain on the mutex, it already owns the mutex so it's woken up even if that fails
+            try {
+                if (!mtxWaiters->Empty()) {
+                    next->thread->inheritedMutexes.push_back(address);
+                    UpdateInheritedPriority(next->thread);
+                } else {
+                    mutexes.Release(address);
+                }
+            } catch (...) {
+                next->Signal();
+                throw;
+            }
+
+            next->Signal();
         }
 
+        // Any priority inherited through the mutex is dropped now that it's no longer owned
+        if (wasInherited)
+            UpdateInheritedPriority(state.thread.get());
+
         return true;
     }
 
-    bool KProcess::ConditionalVariableWait(u64 conditionalAddress, u64 mutexAddress, u64 timeout) {
-        std::unique_lock lock(conditionalLock);
-        auto &condWaiters{conditionals[conditionalAddress]};
+    void KProcess::InheritMutexPriority(u64 address, KHandle owner) {
+        std::shared_ptr<KThread> thread;
+        try {
+            thread = GetHandle<KThread>(owner);
+        } catch (const std::exception &) {
+            return; // The owner is supplied by the guest, if it isn't a valid thread then there's nothing to boost
+        }
 
-        std::shared_ptr<WaitStatus> status;
-        for (auto it{condWaiters.begin()};; it++) {
-            if (it != condWaiters.end() && (*it)->priority >= state.thread->priority)
-                continue;
+        auto &inheritedMutexes{thread->inheritedMutexes};
+        if (std::find(inheritedMutexes.begin(), inheritedMutexes.end(), address) == inheritedMutexes.end())
+            inheritedMutexes.push_back(address);
+        UpdateInheritedPriority(thread.get());
+    }
 
-            status = std::make_shared<WaitStatus>(state.thread->priority, state.thread->handle, mutexAddress);
-            condWaiters.insert(it, status);
-            break;
+    void KProcess::InsertMutexWaiter(u64 address, WaitStatus *status, KHandle owner) {
+        auto &waiters{mutexes.Get(address)};
+        waiters.Insert(status);
+        try {
+            InheritMutexPriority(address, owner);
+        } catch (...) {
+            // The waiter would otherwise stay linked after the SVC fails, the list would then point to its status even once the thread is destroyed
+            waiters.Remove(status);
+            mutexes.Release(address);
+            throw;
         }
+    }
 
-        lock.unlock();
+    void KProcess::UpdateInheritedPriority(KThread *thread) {
+        i8 priority{std::numeric_limits<i8>::max()};
+        for (auto address : thread->inheritedMutexes) {
+            auto waiters{mutexes.Find(address)};
+            if (waiters)
+                priority = std::min(priority, static_cast<i8>(waiters->Front()->priority));
+        }
 
-        bool timedOut{};
-        auto start{util::GetTimeNs()};
-        while (!status->flag)
-            if ((util::GetTimeNs() - start) >= timeout)
-                timedOut = true;
+        thread->InheritPriority(priority);
+    }
 
-        lock.lock();
+    /**
+     * @return The absolute time on CLOCK_MONOTONIC after the supplied amount of nanoseconds from now
+     */
+    static timespec GetDeadline(u64 timeout) {
+        timespec deadline{};
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += static_cast<time_t>(timeout / constant::NsInSecond);
+        deadline.tv_nsec += static_cast<long>(timeout % constant::NsInSecond);
+        if (deadline.tv_nsec >= static_cast<long>(constant::NsInSecond)) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= static_cast<long>(constant::NsInSecond);
+        }
+        return deadline;
+    }
 
-        if (!status->flag)
-            timedOut = false;
-        else
-            status->flag = false;
+    bool KProcess::ConditionalVariableWait(u64 conditionalAddress, u64 mutexAddress, u64 timeout) {
+        std::unique_lock lock(mutexLock);
 
-        for (auto it{condWaiters.begin()}; it != condWaiters.end(); it++) {
-            if ((*it)->handle == state.thread->handle) {
-                condWaiters.erase(it);
-                break;
-            }
-        }
+        auto status{&state.thread->waitStatus};
+        status->Reset(state.thread->priority, state.thread->handle, mutexAddress);
+        auto &condWaiters{conditionals.Get(conditionalAddress)};
+        condWaiters.Insert(status);
 
         lock.unlock();
 
-        return !timedOut;
+        // A timeout that doesn't fit into a signed 64-bit integer (such as -1) means the wait is indefinite
+        timespec deadline{};
+        bool timed{timeout <= static_cast<u64>(INT64_MAX)};
+        if (timed)
+            deadline = GetDeadline(timeout);
+
+        if (status->Wait(timed ? &deadline : nullptr))
+            return true;
+
+        // If we're still waiting on the conditional variable then the timeout is valid, otherwise a signaller has already taken us off it and we'll be handed the mutex
+        // The list stays valid even if a signaller released it, pooled nodes are never freed and are only reused for other conditional variables
+        lock.lock();
+        if (condWaiters.Contains(status)) {
+            condWaiters.Remove(status);
+            conditionals.Release(conditionalAddress);
+            return false;
+        }
+        lock.unlock();
+
+        status->Wait();
+        return true;
     }
 
     void KProcess::ConditionalVariableSignal(u64 address, u64 amount) {
-        std::unique_lock condLock(conditionalLock);
+        std::lock_guard lock(mutexLock);
+        auto condWaiters{conditionals.Find(address)};
+        if (!condWaiters)
+            return;
 
-        auto &condWaiters{conditionals[address]};
-        u64 count{};
+        for (u64 count{}; !condWaiters->Empty() && count < amount; count++) {
+            auto status{condWaiters->PopFront()};
 
-        auto iter{condWaiters.begin()};
-        while (iter != condWaiters.end() && count < amount) {
-            auto &thread{*iter};
-            auto mtx{GetPointer<u32>(thread->mutexAddress)};
+            // The waiter needs to reacquire its mutex before it returns, so it either directly becomes the owner of the mutex or it's queued as a waiter on it and is woken by MutexUnlock
+            auto mtx{GetPointer<u32>(status->mutexAddress)};
             u32 mtxValue{__atomic_load_n(mtx, __ATOMIC_SEQ_CST)};
+            while (!__atomic_compare_exchange_n(mtx, &mtxValue, mtxValue ? (mtxValue | ~constant::MtxOwnerMask) : (constant::MtxOwnerMask & status->handle), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
 
-            while (true) {
-                u32 mtxDesired{};
+            if (mtxValue) {
+                InsertMutexWaiter(status->mutexAddress, status, mtxValue & constant::MtxOwnerMask);
+            } else
+                status->Signal();
+        }
 
-                if (!mtxValue)
-                    mtxDesired = (constant::MtxOwnerMask & thread->handle);
-                else if ((mtxValue & constant::MtxOwnerMask) == state.thread->handle)
-                    mtxDesired = mtxValue | (constant::MtxOwnerMask & thread->handle);
-                else if (mtxValue & ~constant::MtxOwnerMask)
-                    mtxDesired = mtxValue | ~constant::MtxOwnerMask;
-                else
-                    break;
+        conditionals.Release(address);
+    }
 
-                if (__atomic_compare_exchange_n(mtx, &mtxValue, mtxDesired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
-                    break;
-            }
-            if (mtxValue && ((mtxValue & constant::MtxOwnerMask) != state.thread->handle)) {
-                std::unique_lock mtxLock(mutexLock);
-
-                auto &mtxWaiters{mutexes[thread->mutexAddress]};
-                std::shared_ptr<WaitStatus> status;
-
-                for (auto it{mtxWaiters.begin()};; it++) {
-                    if (it != mtxWaiters.end() && (*it)->priority >= thread->priority)
-                        continue;
-                    status = std::make_shared<WaitStatus>(thread->priority, thread->handle);
-                    mtxWaiters.insert(it, status);
-                    break;
-                }
+    Result KProcess::WaitForAddress(u64 address, ArbitrationType type, i32 value, i64 timeout) {
+        auto &bucket{GetArbiterBucket(address)};
+        std::unique_lock lock(bucket.lock);
+
+        // The guest modifies the value with its own atomics, so it's only ever accessed atomically but the check and the queueing are atomic with respect to signallers due to the bucket lock
+        auto word{GetPointer<i32>(address)};
+        i32 current{__atomic_load_n(word, __ATOMIC_SEQ_CST)};
+        switch (type) {
+            case ArbitrationType::WaitIfLessThan:
+                if (current >= value)
+                    return result::InvalidState;
+                break;
+            case ArbitrationType::DecrementAndWaitIfLessThan:
+                do {
+                    if (current >= value)
+                        return result::InvalidState;
+                } while (!__atomic_compare_exchange_n(word, &current, current - 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+                break;
+            case ArbitrationType::WaitIfEqual:
+                if (current != value)
+                    return result::InvalidState;
+                break;
+        }
 
-                mtxLock.unlock();
-                while (!status->flag);
-                mtxLock.lock();
-                status->flag = false;
+        if (!timeout)
+            return result::TimedOut;
 
-                for (auto it{mtxWaiters.begin()}; it != mtxWaiters.end(); it++) {
-                    if ((*it)->handle == thread->handle) {
-                        mtxWaiters.erase(it);
-                        break;
-                    }
-                }
+        auto status{&state.thread->waitStatus};
+        status->Reset(state.thread->priority, state.thread->handle, 0, address);
+        bucket.waiters.Insert(status);
+
+        lock.unlock();
+
+        timespec deadline{};
+        if (timeout > 0)
+            deadline = GetDeadline(static_cast<u64>(timeout));
+
+        if (status->Wait(timeout > 0 ? &deadline : nullptr))
+            return {};
 
-                mtxLock.unlock();
+        // A signaller removes the waiter from the bucket prior to signalling it while holding the lock, so the wait only timed out if we're still in the bucket
+        lock.lock();
+        if (bucket.waiters.Contains(status)) {
+            bucket.waiters.Remove(status);
+            return result::TimedOut;
+        }
+
+        return {};
+    }
+
+    Result KProcess::SignalToAddress(u64 address, SignalType type, i32 value, i32 count) {
+        auto &bucket{GetArbiterBucket(address)};
+        std::lock_guard lock(bucket.lock);
+
+        auto word{GetPointer<i32>(address)};
+        if (type != SignalType::Signal) {
+            i32 desired;
+            if (type == SignalType::SignalAndIncrementIfEqual) {
+                desired = value + 1;
+            } else {
+                // The value is modified based on the amount of waiters, this is used by the guest to track if a semaphore has waiters without having to check for them
+                size_t waiterCount{};
+                for (auto waiter{bucket.waiters.Front()}; waiter; waiter = waiter->next)
+                    if (waiter->address == address)
+                        waiterCount++;
+                if (!waiterCount)
+                    desired = value + 1;
+                else if (count <= 0)
+                    desired = value - 2;
+                else if (waiterCount <= static_cast<size_t>(count))
+                    desired = value - 1;
+                else
+                    desired = value;
             }
 
-            thread->flag = true;
-            iter++;
-            count++;
+            i32 expected{value};
+            if (!__atomic_compare_exchange_n(word, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+                return result::InvalidState;
+        }
 
-            condLock.unlock();
-            while (thread->flag);
-            condLock.lock();
+        i32 signalled{};
+        for (auto waiter{bucket.waiters.Front()}; waiter && (count <= 0 || signalled < count);) {
+            if (waiter->address == address) {
+                auto next{bucket.waiters.Remove(waiter)};
+                waiter->Signal();
+                waiter = next;
+                signalled++;
+            } else {
+                waiter = waiter->next;
+            }
         }
+
+        return {};
     }
 }
@@ -3,7 +3,6 @@
 
 #pragma once
 
-#include <list>
 #include "KThread.h"
 #include "KPrivateMemory.h"
 #include "KTransferMemory.h"
@@ -14,7 +13,11 @@ namespace skyline {
     namespace constant {
         constexpr u16 TlsSlotSize{0x200}; //!< The size of a single TLS slot
         constexpr u8 TlsSlots{PAGE_SIZE / TlsSlotSize}; //!< The amount of TLS slots in a single page
+        constexpr u8 ThreadPoolSize{8}; //!< The amount of thread contexts and TLS slots which are allocated ahead of time during process initialization
         constexpr KHandle BaseHandleIndex{0xD000}; //!< The index of the base handle
+        constexpr KHandle HandleSlotCount{0x10000 - BaseHandleIndex}; //!< The maximum amount of handle slots, the slot index occupies the lower 16 bits of a handle
+        constexpr u8 HandleGenerationShift{16}; //!< The bit offset of the slot generation inside a handle
+        constexpr u16 HandleGenerationMask{0x3FFF}; //!< The mask of the slot generation, bit 30 is reserved as the mutex waiter bit and bit 31 would collide with pseudo-handles
         constexpr u32 MtxOwnerMask{0xBFFFFFFF}; //!< The mask of values which contain the owner of a mutex
     }
 
@@ -24,7 +27,58 @@ namespace skyline {
          */
         class KProcess : public KSyncObject {
           private:
-            KHandle handleIndex{constant::BaseHandleIndex}; //!< The index of the handle that will be allocated next
+            /**
+             * @brief A single slot in the handle table
+             */
+            struct HandleSlot {
+                std::shared_ptr<KObject> object; //!< The object in this slot, this is nullptr if the slot is free or reserved
+                u16 generation{}; //!< The generation of the slot, it is incremented on every close so stale handles to a reused slot are rejected
+            };
+
+            std::vector<HandleSlot> handles; //!< The slots of the handle table, a handle is the index of its slot offset by constant::BaseHandleIndex combined with the slot's generation
+            std::vector<u16> freeHandles; //!< The indices of slots that have been closed and can be reused
+            std::vector<KHandle> memoryHandles; //!< The handles of all memory objects in the handle table, this allows GetMemoryObject to skip over all other objects
+            Mutex handleLock; //!< Synchronizes all accesses to the handle table
+
+            /**
+             * @brief Reserves a slot in the handle table, a free slot is reused if one is available
+             * @return The handle corresponding to the reserved slot
+             */
+            KHandle AllocateHandle();
+
+            /**
+             * @brief Stores an object into a slot reserved by AllocateHandle
+             */
+            void SetHandle(KHandle handle, const std::shared_ptr<KObject> &object);
+
+            /**
+             * @return The slot corresponding to the handle, an exception is thrown if it's invalid
+             * @note handleLock must be held while calling this
+             */
+            HandleSlot &GetHandleSlot(KHandle handle);
+
+            /**
+             * @return The KType corresponding to a kernel object class
+             */
+            template<typename objectClass>
+            static constexpr KType GetObjectType() {
+                if constexpr(std::is_same<objectClass, KThread>())
+                    return KType::KThread;
+                else if constexpr(std::is_same<objectClass, KProcess>())
+                    return KType::KProcess;
+                else if constexpr(std::is_same<objectClass, KSharedMemory>())
+                    return KType::KSharedMemory;
+                else if constexpr(std::is_same<objectClass, KTransferMemory>())
+                    return KType::KTransferMemory;
+                else if constexpr(std::is_same<objectClass, KPrivateMemory>())
+                    return KType::KPrivateMemory;
+                else if constexpr(std::is_same<objectClass, KSession>())
+                    return KType::KSession;
+                else if constexpr(std::is_same<objectClass, KEvent>())
+                    return KType::KEvent;
+                else
+                    static_assert(!std::is_same<objectClass, objectClass>(), "KProcess::GetObjectType couldn't determine object type");
+            }
 
             /**
             * @brief The status of a single TLS page (A page is 4096 bytes on ARMv8)
@@ -34,7 +88,6 @@ namespace skyline {
             */
             struct TlsPage {
                 u64 address; //!< The address of the page allocated for TLS
-                u8 index{}; //!< The slots are assigned sequentially, this holds the index of the last TLS slot reserved
                 bool slot[constant::TlsSlots]{}; //!< An array of booleans denoting which TLS slots are reserved
 
                 /**
@@ -43,11 +96,17 @@ namespace skyline {
                 TlsPage(u64 address);
 
                 /**
-                * @brief Reserves a single 0x200 byte TLS slot
+                * @brief Reserves a single 0x200 byte TLS slot, the lowest free slot is picked
                 * @return The address of the reserved slot
                 */
                 u64 ReserveSlot();
 
+                /**
+                * @brief Frees a TLS slot so it can be reserved again
+                * @param slotAddress The address of the slot, it must be inside this page
+                */
+                void FreeSlot(u64 slotAddress);
+
                 /**
                 * @brief Returns the address of a particular slot
                 * @param slotNo The number of the slot to be returned
@@ -62,13 +121,31 @@ namespace skyline {
                 bool Full();
             };
 
+            /**
+             * @brief Maps a new TLS page into the guest after the last one
+             * @return The newly allocated TLS page
+             */
+            std::shared_ptr<TlsPage> &AllocateTlsPage();
+
             /**
              * @return The address of a free TLS slot
+             * @note threadLock must be held while calling this
              */
             u64 GetTlsSlot();
 
             /**
-             * @brief Initializes heap and the initial TLS page
+             * @brief Frees a TLS slot reserved by GetTlsSlot
+             * @note threadLock must be held while calling this
+             */
+            void FreeTlsSlot(u64 address);
+
+            /**
+             * @return A new ThreadContext which is mapped into the guest
+             */
+            std::shared_ptr<type::KSharedMemory> AllocateThreadContext();
+
+            /**
+             * @brief Initializes heap and the initial TLS page, it also pre-allocates constant::ThreadPoolSize TLS slots and thread contexts
              */
             void InitializeMemory();
 
@@ -91,40 +168,62 @@ namespace skyline {
                 Exiting, //!< The process is exiting
             } status = Status::Created;
 
-            /**
-             * @brief Metadata on a thread waiting for mutexes or conditional variables
-             */
-            struct WaitStatus {
-                std::atomic_bool flag{false}; //!< The underlying atomic flag of the thread
-                u8 priority; //!< The priority of the thread
-                KHandle handle; //!< The handle of the thread
-                u64 mutexAddress{}; //!< The address of the mutex
-
-                WaitStatus(u8 priority, KHandle handle) : priority(priority), handle(handle) {}
-
-                WaitStatus(u8 priority, KHandle handle, u64 mutexAddress) : priority(priority), handle(handle), mutexAddress(mutexAddress) {}
-            };
-
             pid_t pid; //!< The PID of the process or TGID of the threads
             int memFd; //!< The file descriptor to the memory of the process
-            std::vector<std::shared_ptr<KObject>> handles; //!< A vector of KObject which corresponds to the handle
             std::unordered_map<pid_t, std::shared_ptr<KThread>> threads; //!< A mapping from a PID to it's corresponding KThread object
-            std::unordered_map<u64, std::vector<std::shared_ptr<WaitStatus>>> mutexes; //!< A map from a mutex's address to a vector of Mutex objects for threads waiting on it
-            std::unordered_map<u64, std::list<std::shared_ptr<WaitStatus>>> conditionals; //!< A map from a conditional variable's address to a vector of threads waiting on it
+            WaitListMap mutexes; //!< A map from a mutex's address to the threads waiting on it, sorted by priority and removed by the thread that hands over ownership
+            WaitListMap conditionals; //!< A map from a conditional variable's address to the threads waiting on it, sorted by priority and removed by the thread that signals them
             std::vector<std::shared_ptr<TlsPage>> tlsPages; //!< A vector of all allocated TLS pages
             std::shared_ptr<type::KSharedMemory> stack; //!< The shared memory used to hold the stack of the main thread
             std::shared_ptr<KPrivateMemory> heap; //!< The kernel memory object backing the allocated heap
-            Mutex mutexLock; //!< Synchronizes all concurrent guest mutex operations
-            Mutex conditionalLock; //!< Synchronizes all concurrent guest conditional variable operations
+            Mutex mutexLock; //!< Synchronizes all concurrent guest mutex and conditional variable operations, they share a lock as a signalled waiter moves from a conditional variable to a mutex
+
+            /**
+             * @brief A bucket of the address arbiter's wait queue, waiters on all addresses that hash to the bucket are kept in it so that arbitrating on unrelated addresses rarely contends
+             */
+            struct ArbiterBucket {
+                Mutex lock; //!< Synchronizes all arbitration on addresses in the bucket, the value at an address is only checked or modified while this is held
+                WaitList waiters; //!< Every waiting thread with the address it waits on, sorted by priority and removed by the thread that signals them
+            };
+
+            static constexpr size_t ArbiterBucketCount{0x40}; //!< The amount of buckets in the address arbiter's wait queue
+            std::array<ArbiterBucket, ArbiterBucketCount> arbiterBuckets;
+
+            /**
+             * @return The bucket of the address arbiter's wait queue which waiters on the address are in
+             */
+            ArbiterBucket &GetArbiterBucket(u64 address) {
+                return arbiterBuckets[((address >> 2) ^ (address >> 12)) % ArbiterBucketCount];
+            }
+
+            /**
+             * @brief Registers a mutex with waiters with its owner, so the owner inherits the priority of the highest priority waiter on it
+             * @note mutexLock must be locked when calling this
+             */
+            void InheritMutexPriority(u64 address, KHandle owner);
+
+            /**
+             * @brief Queues a waiter on a mutex and makes its owner inherit the priority of the waiters, the waiter is unlinked again if this throws
+             * @note mutexLock must be locked when calling this
+             */
+            void InsertMutexWaiter(u64 address, WaitStatus *status, KHandle owner);
+
+            /**
+             * @brief Recomputes the priority a thread inherits from the waiters on all mutexes it owns and applies it
+             * @note mutexLock must be locked when calling this
+             */
+            void UpdateInheritedPriority(KThread *thread);
+            Mutex threadLock; //!< Synchronizes the allocation and recycling of TLS slots and thread contexts
+            std::vector<std::shared_ptr<type::KSharedMemory>> ctxPool; //!< Thread contexts which are mapped into the guest and can be used by new threads without any guest mappings
+            std::shared_ptr<type::KSharedMemory> doorbellMemory; //!< The memory backing the doorbell of the NCE's kernel worker pool, it's owned by the process as it's mapped into the guest
 
             /**
             * @brief Creates a KThread object for the main thread and opens the process's memory file
             * @param pid The PID of the main thread
-            * @param entryPoint The address to start execution at
             * @param stack The KSharedMemory object for Stack memory allocated by the guest process
             * @param tlsMemory The KSharedMemory object for TLS memory allocated by the guest process
             */
-            KProcess(const DeviceState &state, pid_t pid, u64 entryPoint, std::shared_ptr<type::KSharedMemory> &stack, std::shared_ptr<type::KSharedMemory> &tlsMemory);
+            KProcess(const DeviceState &state, pid_t pid, std::shared_ptr<type::KSharedMemory> &stack, std::shared_ptr<type::KSharedMemory> &tlsMemory);
 
             /**
              * Close the file descriptor to the process's memory
@@ -137,9 +236,16 @@ namespace skyline {
             * @param entryArg An argument to the function
             * @param stackTop The top of the stack
             * @param priority The priority of the thread
+            * @param idealCore The guest core the thread prefers to run on
             * @return An instance of KThread class for the corresponding thread
             */
-            std::shared_ptr<KThread> CreateThread(u64 entryPoint, u64 entryArg, u64 stackTop, i8 priority);
+            std::shared_ptr<KThread> CreateThread(u64 entryPoint, u64 entryArg, u64 stackTop, i8 priority, i8 idealCore);
+
+            /**
+            * @brief Returns the TLS slot and thread context of a thread that exited so they can be reused by new threads
+            * @param thread The thread, its guest thread must have exited already
+            */
+            void RecycleThread(const std::shared_ptr<KThread> &thread);
 
             /**
             * @brief Returns the host address for a specific address in guest memory
@@ -254,6 +360,29 @@ namespace skyline {
             */
             void WriteMemory(const void *source, u64 offset, size_t size, bool forceGuest = false);
 
+            /**
+             * @brief A single transfer between guest memory and a host buffer for batched memory accesses
+             */
+            struct MemoryTransfer {
+                void *host; //!< The host buffer that is read into or written from
+                u64 guest; //!< The address of the memory in the guest
+                size_t size; //!< The amount of bytes to transfer
+            };
+
+            /**
+            * @brief Read several ranges of the guest's memory, ranges which aren't host-mapped are all read with a single process_vm_readv call
+            * @param transfers The ranges to read and the host buffers to read them into
+            * @param forceGuest Forces the read to be performed in guest address space
+            */
+            void ReadMemoryBatch(span<const MemoryTransfer> transfers, bool forceGuest = false);
+
+            /**
+            * @brief Write to several ranges of the guest's memory, ranges which aren't host-mapped are all written with a single process_vm_writev call
+            * @param transfers The ranges to write and the host buffers to write them from
+            * @param forceGuest Forces the write to be performed in guest address space
+            */
+            void WriteMemoryBatch(span<const MemoryTransfer> transfers, bool forceGuest = false);
+
             /**
             * @brief Copy one chunk to another in the guest's memory
             * @param source The address of where the data to read is present
@@ -270,13 +399,19 @@ namespace skyline {
             */
             template<typename objectClass, typename ...objectArgs>
             HandleOut<objectClass> NewHandle(objectArgs... args) {
+                auto handle{AllocateHandle()};
                 std::shared_ptr<objectClass> item;
-                if constexpr (std::is_same<objectClass, KThread>())
-                    item = std::make_shared<objectClass>(state, handleIndex, args...);
-                else
-                    item = std::make_shared<objectClass>(state, args...);
-                handles.push_back(std::static_pointer_cast<KObject>(item));
-                return {item, handleIndex++};
+                try {
+                    if constexpr (std::is_same<objectClass, KThread>())
+                        item = std::allocate_shared<objectClass>(SlabAllocator<objectClass>{}, state, handle, args...);
+                    else
+                        item = std::allocate_shared<objectClass>(SlabAllocator<objectClass>{}, state, args...);
+                } catch (...) {
+                    CloseHandle(handle);
+                    throw;
+                }
+                SetHandle(handle, std::static_pointer_cast<KObject>(item));
+                return {item, handle};
             }
 
             /**
@@ -286,45 +421,35 @@ namespace skyline {
             */
             template<typename objectClass>
             KHandle InsertItem(std::shared_ptr<objectClass> &item) {
-                handles.push_back(std::static_pointer_cast<KObject>(item));
-                return handleIndex++;
+                auto handle{AllocateHandle()};
+                SetHandle(handle, std::static_pointer_cast<KObject>(item));
+                return handle;
             }
 
             /**
             * @brief Returns the underlying kernel object for a handle
-            * @tparam objectClass The class of the kernel object present in the handle
+            * @tparam objectClass The class of the kernel object present in the handle, KObject can be used to retrieve an object of any type
             * @param handle The handle of the object
             * @return A shared pointer to the object
             */
             template<typename objectClass>
             std::shared_ptr<objectClass> GetHandle(KHandle handle) {
-                KType objectType;
-                if constexpr(std::is_same<objectClass, KThread>())
-                    objectType = KType::KThread;
-                else if constexpr(std::is_same<objectClass, KProcess>())
-                    objectType = KType::KProcess;
-                else if constexpr(std::is_same<objectClass, KSharedMemory>())
-                    objectType = KType::KSharedMemory;
-                else if constexpr(std::is_same<objectClass, KTransferMemory>())
-                    objectType = KType::KTransferMemory;
-                else if constexpr(std::is_same<objectClass, KPrivateMemory>())
-                    objectType = KType::KPrivateMemory;
-                else if constexpr(std::is_same<objectClass, KSession>())
-                    objectType = KType::KSession;
-                else if constexpr(std::is_same<objectClass, KEvent>())
-                    objectType = KType::KEvent;
-                else
-                    throw exception("KProcess::GetHandle couldn't determine object type");
-                try {
-                    auto& item{handles.at(handle - constant::BaseHandleIndex)};
-                    if (item != nullptr && item->objectType == objectType)
-                        return std::static_pointer_cast<objectClass>(item);
-                    else if (item == nullptr)
-                        throw exception("GetHandle was called with a deleted handle: 0x{:X}", handle);
-                    else
+                std::shared_ptr<KObject> item;
+                {
+                    std::lock_guard guard(handleLock);
+                    item = GetHandleSlot(handle).object;
+                }
+
+                if (item == nullptr)
+                    throw exception("GetHandle was called with a deleted handle: 0x{:X}", handle);
+
+                if constexpr (std::is_same<objectClass, KObject>()) {
+                    return item;
+                } else {
+                    constexpr KType objectType{GetObjectType<objectClass>()};
+                    if (item->objectType != objectType)
                         throw exception("Tried to get kernel object (0x{:X}) with different type: {} when object is {}", handle, objectType, item->objectType);
-                } catch (std::out_of_range) {
-                    throw exception("GetHandle was called with an invalid handle: 0x{:X}", handle);
+                    return std::static_pointer_cast<objectClass>(item);
                 }
             }
 
@@ -336,11 +461,9 @@ namespace skyline {
             std::optional<HandleOut<KMemory>> GetMemoryObject(u64 address);
 
             /**
-             * @brief Closes a handle in the handle table
+             * @brief Closes a handle in the handle table, its slot is freed for reuse by later handles
              */
-            inline void CloseHandle(KHandle handle) {
-                handles.at(handle - constant::BaseHandleIndex) = nullptr;
-            }
+            void CloseHandle(KHandle handle);
 
             /**
             * @brief Locks the Mutex at the specified address
@@ -360,8 +483,8 @@ namespace skyline {
             /**
             * @param conditionalAddress The address of the conditional variable
             * @param mutexAddress The address of the mutex
-            * @param timeout The amount of time to wait for the conditional variable
-            * @return If the conditional variable was successfully waited for or timed out
+            * @param timeout The amount of time to wait for the conditional variable in nanoseconds
+            * @return If the conditional variable was signalled and the mutex was reacquired, the mutex isn't held if this returns false due to a timeout
             */
             bool ConditionalVariableWait(u64 conditionalAddress, u64 mutexAddress, u64 timeout);
 
@@ -372,6 +495,40 @@ namespace skyline {
             */
             void ConditionalVariableSignal(u64 address, u64 amount);
 
+            /**
+             * @url https://switchbrew.org/wiki/SVC#ArbitrationType
+             */
+            enum class ArbitrationType : u32 {
+                WaitIfLessThan = 0,
+                DecrementAndWaitIfLessThan = 1,
+                WaitIfEqual = 2,
+            };
+
+            /**
+             * @brief Waits on an address till it's signalled if the value at it passes the arbitration check
+             * @param value The value that the value at the address is compared against
+             * @param timeout The amount of time to wait in nanoseconds, a timeout of 0 only checks the value and a negative timeout waits indefinitely
+             * @return InvalidState if the arbitration check failed, TimedOut if the wait timed out or success if the thread was signalled
+             */
+            Result WaitForAddress(u64 address, ArbitrationType type, i32 value, i64 timeout);
+
+            /**
+             * @url https://switchbrew.org/wiki/SVC#SignalType
+             */
+            enum class SignalType : u32 {
+                Signal = 0,
+                SignalAndIncrementIfEqual = 1,
+                SignalAndModifyByWaitingCountIfEqual = 2,
+            };
+
+            /**
+             * @brief Signals threads waiting on an address, the value at the address may be modified atomically with the signal depending on the type
+             * @param value The value which the value at the address has to match for the modifying signal types
+             * @param count The amount of waiters to signal, all of them are signalled if this isn't positive
+             * @return InvalidState if the value didn't match for the modifying signal types, success otherwise
+             */
+            Result SignalToAddress(u64 address, SignalType type, i32 value, i32 count);
+
             /**
              * @brief Resets the object to an unsignalled state
              */
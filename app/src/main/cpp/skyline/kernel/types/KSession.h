@@ -16,8 +16,8 @@ namespace skyline::kernel::type {
     class KSession : public KSyncObject {
       public:
         std::shared_ptr<service::BaseService> serviceObject;
-        std::vector<std::shared_ptr<service::BaseService>> domains; //!< A vector of services that correspond to virtual handles
-        KHandle handleIndex{}; //!< The currently allocated handle index
+        std::vector<std::shared_ptr<service::BaseService>> domains; //!< The services in the domain indexed by their virtual handle, closed slots are empty
+        std::vector<KHandle> freeDomainHandles; //!< The virtual handles of closed slots in domains which are reused before the table is grown
         bool isOpen{true}; //!< If the session is open or not
         bool isDomain{}; //!< If this is a domain session or not
 
@@ -26,6 +26,42 @@ namespace skyline::kernel::type {
          */
         KSession(const DeviceState &state, std::shared_ptr<service::BaseService> &serviceObject) : serviceObject(serviceObject), KSyncObject(state, KType::KSession) {}
 
+        /**
+         * @brief Adds a service to the domain in a free slot
+         * @return The virtual handle of the service in the domain
+         */
+        KHandle AddDomainObject(std::shared_ptr<service::BaseService> service) {
+            if (!freeDomainHandles.empty()) {
+                auto handle{freeDomainHandles.back()};
+                freeDomainHandles.pop_back();
+                domains[handle] = std::move(service);
+                return handle;
+            }
+
+            domains.push_back(std::move(service));
+            return static_cast<KHandle>(domains.size() - 1);
+        }
+
+        /**
+         * @return The service with the supplied virtual handle in the domain, it's a copy so a request can't outlive the service if the handle is closed while the request is handled
+         */
+        std::shared_ptr<service::BaseService> GetDomainObject(KHandle handle) {
+            if (handle >= domains.size() || !domains[handle])
+                throw exception("Invalid object ID was used with domain request: 0x{:X}", handle);
+            return domains[handle];
+        }
+
+        /**
+         * @brief Closes the virtual handle of a service in the domain, its slot is reused by later services
+         * @return The service which was closed
+         */
+        std::shared_ptr<service::BaseService> CloseDomainObject(KHandle handle) {
+            if (handle >= domains.size() || !domains[handle])
+                throw exception("Invalid object ID was used with domain request: 0x{:X}", handle);
+            freeDomainHandles.push_back(handle);
+            return std::move(domains[handle]);
+        }
+
         /**
          * @brief Converts this session into a domain session
          * @url https://switchbrew.org/wiki/IPC_Marshalling#Domains
@@ -33,8 +69,7 @@ namespace skyline::kernel::type {
          */
         KHandle ConvertDomain() {
             isDomain = true;
-            domains.push_back(serviceObject);
-            return handleIndex++;
+            return AddDomainObject(serviceObject);
         }
     };
 }
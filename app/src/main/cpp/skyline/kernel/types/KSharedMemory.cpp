@@ -1,11 +1,11 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include <android/sharedmem.h>
 #include <unistd.h>
 #include <asm/unistd.h>
 #include <os.h>
 #include <nce.h>
+#include <statistics.h>
 #include "KSharedMemory.h"
 #include "KProcess.h"
 
@@ -14,13 +14,10 @@ namespace skyline::kernel::type {
         if (address && !util::PageAligned(address))
             throw exception("KSharedMemory was created with non-page-aligned address: 0x{:X}", address);
 
-        fd = ASharedMemory_create("KSharedMemory", size);
-        if (fd < 0)
-            throw exception("An error occurred while creating shared memory: {}", fd);
+        fd = MemoryManager::CreateMemoryFile("KSharedMemory", size);
 
-        address = reinterpret_cast<u64>(mmap(reinterpret_cast<void *>(address), size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED | ((address) ? MAP_FIXED : 0) | mmapFlags, fd, 0));
-        if (address == reinterpret_cast<u64>(MAP_FAILED))
-            throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+        address = reinterpret_cast<u64>(state.os->memory.MapHostMemory(fd, size, address, ((address) ? MAP_FIXED : 0) | mmapFlags));
+        state.statistics->TrackHostMapping(address, size, memState.type);
 
         kernel = {.address = address, .size = size, .permission = permission};
 
@@ -49,28 +46,31 @@ namespace skyline::kernel::type {
         if (address && !util::PageAligned(address))
             throw exception("KSharedMemory was mapped to a non-page-aligned address: 0x{:X}", address);
 
-        Registers fregs{
-            .x0 = address,
-            .x1 = size,
-            .x2 = static_cast<u64>(permission.Get()),
-            .x3 = static_cast<u64>(MAP_SHARED | ((address) ? MAP_FIXED : 0)),
-            .x4 = static_cast<u64>(fd),
-            .x8 = __NR_mmap,
-        };
+        // A fixed mapping can be advised in the same batch, otherwise the address chosen by the guest's mmap has to be known first
+        std::vector<SyscallDescriptor> syscalls{{.number = __NR_mmap, .arguments = {address, size, static_cast<u64>(permission.Get()), static_cast<u64>(MAP_SHARED | ((address) ? MAP_FIXED : 0)), static_cast<u64>(fd)}}};
+        if (address)
+            state.os->memory.AdviseGuestMemory(address, size, syscalls);
 
-        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-        if (fregs.x0 < 0)
+        state.nce->ExecuteSyscalls(syscalls);
+        if (syscalls.front().result < 0)
             throw exception("An error occurred while mapping shared memory in guest");
 
-        guest = {.address = fregs.x0, .size = size, .permission = permission};
+        auto mapping{static_cast<u64>(syscalls.front().result)};
+        if (!address) {
+            syscalls.clear();
+            state.os->memory.AdviseGuestMemory(mapping, size, syscalls);
+            state.nce->ExecuteSyscalls(syscalls);
+        }
+
+        guest = {.address = mapping, .size = size, .permission = permission};
 
         BlockDescriptor block{
-            .address = fregs.x0,
+            .address = mapping,
             .size = size,
             .permission = permission,
         };
         ChunkDescriptor chunk{
-            .address = fregs.x0,
+            .address = mapping,
             .host = kernel.address,
             .size = size,
             .state = initialState,
@@ -78,90 +78,66 @@ namespace skyline::kernel::type {
         };
         state.os->memory.InsertChunk(chunk);
 
-        return fregs.x0;
+        return mapping;
     }
 
     void KSharedMemory::Resize(size_t size) {
+        // The memory file is resized in place, so the existing contents are retained and only the mappings need to be changed rather than copied
         if (guest.Valid() && kernel.Valid()) {
-            if (close(fd) < 0)
-                throw exception("An error occurred while trying to close shared memory FD: {}", strerror(errno));
-
-            fd = ASharedMemory_create("KSharedMemory", size);
-            if (fd < 0)
-                throw exception("An error occurred while creating shared memory: {}", fd);
+            if (size > guest.size)
+                MemoryManager::ResizeMemoryFile(fd, size);
 
-            Registers fregs{
-                .x0 = guest.address,
-                .x1 = guest.size,
-                .x8 = __NR_munmap
+            // The guest mapping is replaced and the permissions of all blocks are restored in a single batch
+            std::vector<SyscallDescriptor> syscalls{
+                {.number = __NR_munmap, .arguments = {guest.address, guest.size}},
+                {.number = __NR_mmap, .arguments = {guest.address, size, static_cast<u64>(PROT_READ | PROT_WRITE | PROT_EXEC), static_cast<u64>(MAP_SHARED | MAP_FIXED), static_cast<u64>(fd)}},
             };
 
-            state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-            if (fregs.x0 < 0)
-                throw exception("An error occurred while unmapping private memory in child process");
-
-            fregs = {
-                .x0 = guest.address,
-                .x1 = size,
-                .x2 = static_cast<u64>(PROT_READ | PROT_WRITE | PROT_EXEC),
-                .x3 = static_cast<u64>(MAP_SHARED | MAP_FIXED),
-                .x4 = static_cast<u64>(fd),
-                .x8 = __NR_mmap,
-            };
-
-            state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-            if (fregs.x0 < 0)
-                throw exception("An error occurred while remapping private memory in child process");
-
-            state.process->WriteMemory(reinterpret_cast<void *>(kernel.address), guest.address, std::min(guest.size, size), true);
-
             auto chunk{state.os->memory.GetChunk(guest.address)};
             for (const auto &block : chunk->blockList) {
-                if ((block.address - chunk->address) < guest.size) {
-                    fregs = {
-                        .x0 = block.address,
-                        .x1 = std::min(block.size, (chunk->address + size) - block.address),
-                        .x2 = static_cast<u64>(block.permission.Get()),
-                        .x8 = __NR_mprotect,
-                    };
-
-                    state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-                    if (fregs.x0 < 0)
-                        throw exception("An error occurred while updating private memory's permissions in child process");
-                } else {
+                if ((block.address - chunk->address) < guest.size)
+                    syscalls.push_back({.number = __NR_mprotect, .arguments = {block.address, std::min(block.size, (chunk->address + size) - block.address), static_cast<u64>(block.permission.Get())}});
+                else
                     break;
-                }
             }
+            auto permissionCount{syscalls.size() - 2};
+            state.os->memory.AdviseGuestMemory(guest.address, size, syscalls);
 
-            munmap(reinterpret_cast<void *>(kernel.address), kernel.size);
+            state.nce->ExecuteSyscalls(syscalls);
+            if (syscalls[0].result < 0)
+                throw exception("An error occurred while unmapping private memory in child process");
+            if (syscalls[1].result < 0)
+                throw exception("An error occurred while remapping private memory in child process");
+            if (std::any_of(syscalls.begin() + 2, syscalls.begin() + 2 + permissionCount, [](const SyscallDescriptor &syscall) { return syscall.result < 0; }))
+                throw exception("An error occurred while updating private memory's permissions in child process");
 
-            auto host{mmap(reinterpret_cast<void *>(chunk->host), size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED, fd, 0)};
-            if (host == MAP_FAILED)
-                throw exception("An occurred while mapping shared memory: {}", strerror(errno));
+            munmap(reinterpret_cast<void *>(kernel.address), kernel.size);
+            if (size < guest.size) {
+                MemoryManager::ResizeMemoryFile(fd, size); // Truncating the file releases the pages past its end
+                state.statistics->releasedBytes.fetch_add(guest.size - size, std::memory_order_relaxed);
+            }
 
+            state.statistics->UntrackHostMapping(kernel.address);
+            kernel.address = reinterpret_cast<u64>(state.os->memory.MapHostMemory(fd, size, chunk->host));
+            state.statistics->TrackHostMapping(kernel.address, size, initialState.type);
+            kernel.size = size;
             guest.size = size;
-            MemoryManager::ResizeChunk(chunk, size);
+            chunk->host = kernel.address;
+            state.os->memory.ResizeChunk(chunk, size);
         } else if (kernel.Valid()) {
-            if (close(fd) < 0)
-                throw exception("An error occurred while trying to close shared memory FD: {}", strerror(errno));
-
-            fd = ASharedMemory_create("KSharedMemory", size);
-            if (fd < 0)
-                throw exception("An error occurred while creating shared memory: {}", fd);
-
-            std::vector<u8> data(std::min(size, kernel.size));
-            std::memcpy(data.data(), reinterpret_cast<const void *>(kernel.address), std::min(size, kernel.size));
-
             munmap(reinterpret_cast<void *>(kernel.address), kernel.size);
+            MemoryManager::ResizeMemoryFile(fd, size);
+            if (size < kernel.size)
+                state.statistics->releasedBytes.fetch_add(kernel.size - size, std::memory_order_relaxed);
 
             auto address{mmap(reinterpret_cast<void *>(kernel.address), size, kernel.permission.Get(), MAP_SHARED, fd, 0)};
             if (address == MAP_FAILED)
                 throw exception("An occurred while mapping shared memory: {}", strerror(errno));
 
-            std::memcpy(address, data.data(), std::min(size, kernel.size));
-
+            state.statistics->UntrackHostMapping(kernel.address);
             kernel.address = reinterpret_cast<u64>(address);
             kernel.size = size;
+            state.statistics->TrackHostMapping(kernel.address, size, initialState.type);
         } else {
             throw exception("Cannot resize KSharedMemory that's only on guest");
         }
@@ -208,8 +184,10 @@ namespace skyline::kernel::type {
             }
         } catch (const std::exception &) {
         }
-        if (kernel.Valid())
+        if (kernel.Valid()) {
             munmap(reinterpret_cast<void *>(kernel.address), kernel.size);
+            state.statistics->UntrackHostMapping(kernel.address);
+        }
         state.os->memory.DeleteChunk(guest.address);
         close(fd);
     }
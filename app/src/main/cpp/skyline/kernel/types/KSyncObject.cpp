@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "KSyncObject.h"
+#include "KThread.h"
+
+namespace skyline::kernel::type {
+    void KSyncObject::Signal() {
+        signalled = true;
+
+        std::lock_guard guard(waiterLock);
+        for (auto &waiter : waiters)
+            waiter->WakeSynchronization();
+    }
+
+    void KSyncObject::AddWaiter(KThread *thread) {
+        std::lock_guard guard(waiterLock);
+        waiters.push_back(thread);
+    }
+
+    void KSyncObject::RemoveWaiter(KThread *thread) {
+        std::lock_guard guard(waiterLock);
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), thread), waiters.end());
+    }
+}
@@ -6,21 +6,36 @@
 #include "KObject.h"
 
 namespace skyline::kernel::type {
+    class KThread;
+
     /**
      * @brief KSyncObject holds the state of a waitable object
      */
     class KSyncObject : public KObject {
+      private:
+        Mutex waiterLock; //!< Synchronizes access to the waiters
+        std::vector<KThread *> waiters; //!< The threads which are currently waiting on this object to be signalled
+
       public:
         std::atomic<bool> signalled{false}; //!< If the current object is signalled (Used as object stays signalled till the signal is consumed)
 
         KSyncObject(const DeviceState &state, skyline::kernel::type::KType type) : KObject(state, type) {};
 
         /**
-         * @brief A function for calling when a particular KSyncObject is signalled
+         * @brief A function for calling when a particular KSyncObject is signalled, this wakes up all threads waiting on it
+         */
+        virtual void Signal();
+
+        /**
+         * @brief Registers a thread to be woken up when this object is signalled
+         * @note The thread must be removed with RemoveWaiter prior to it being destroyed
+         */
+        void AddWaiter(KThread *thread);
+
+        /**
+         * @brief Removes a thread which was registered with AddWaiter
          */
-        virtual void Signal() {
-            signalled = true;
-        }
+        void RemoveWaiter(KThread *thread);
 
         virtual ~KSyncObject() = default;
     };
@@ -2,14 +2,96 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <sys/resource.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <nce.h>
+#include <os.h>
 #include "KThread.h"
 #include "KProcess.h"
 
 namespace skyline::kernel::type {
-    KThread::KThread(const DeviceState &state, KHandle handle, pid_t selfTid, u64 entryPoint, u64 entryArg, u64 stackTop, u64 tls, i8 priority, KProcess *parent, const std::shared_ptr<type::KSharedMemory> &tlsMemory) : handle(handle), tid(selfTid), entryPoint(entryPoint), entryArg(entryArg), stackTop(stackTop), tls(tls), priority(priority), parent(parent), ctxMemory(tlsMemory), KSyncObject(state,
+    void WaitStatus::Reset(u8 priority, KHandle handle, u64 mutexAddress, u64 address) {
+        flag.store(false, std::memory_order_relaxed);
+        this->priority = priority;
+        this->handle = handle;
+        this->mutexAddress = mutexAddress;
+        this->address = address;
+    }
+
+    bool WaitStatus::Wait(const timespec *deadline) {
+        while (!flag.load(std::memory_order_acquire))
+            if (syscall(__NR_futex, &flag, FUTEX_WAIT_BITSET_PRIVATE, false, deadline, nullptr, FUTEX_BITSET_MATCH_ANY) == -1 && errno == ETIMEDOUT)
+                return flag.load(std::memory_order_acquire);
+
+        return true;
+    }
+
+    void WaitStatus::Signal() {
+        flag.store(true, std::memory_order_release);
+        syscall(__NR_futex, &flag, FUTEX_WAKE_PRIVATE, 1);
+    }
+
+    void WaitList::Insert(WaitStatus *status) {
+        auto it{head};
+        while (it && it->priority >= status->priority)
+            it = it->next;
+
+        status->next = it;
+        status->prev = it ? it->prev : tail;
+        if (status->prev)
+            status->prev->next = status;
+        else
+            head = status;
+        if (it)
+            it->prev = status;
+        else
+            tail = status;
+
+        status->list = this;
+        count++;
+    }
+
+    WaitStatus *WaitList::Remove(WaitStatus *status) {
+        auto next{status->next};
+        if (status->prev)
+            status->prev->next = next;
+        else
+            head = next;
+        if (next)
+            next->prev = status->prev;
+        else
+            tail = status->prev;
+
+        status->prev = status->next = nullptr;
+        status->list = nullptr;
+        count--;
+        return next;
+    }
+
+    WaitList &WaitListMap::Get(u64 address) {
+        if (auto list{Find(address)})
+            return *list;
+
+        if (pool.empty())
+            return map[address];
+
+        auto node{std::move(pool.back())};
+        pool.pop_back();
+        node.key() = address;
+        return map.insert(std::move(node)).position->second;
+    }
+
+    void WaitListMap::Release(u64 address) {
+        auto it{map.find(address)};
+        if (it != map.end() && it->second.Empty())
+            pool.push_back(map.extract(it));
+    }
+
+    KThread::KThread(const DeviceState &state, KHandle handle, pid_t selfTid, u64 entryPoint, u64 entryArg, u64 stackTop, u64 tls, i8 priority, i8 idealCore, KProcess *parent, const std::shared_ptr<type::KSharedMemory> &tlsMemory) : handle(handle), tid(selfTid), entryPoint(entryPoint), entryArg(entryArg), stackTop(stackTop), tls(tls), priority(priority), basePriority(priority), idealCore(idealCore), affinityMask(1ULL << idealCore), currentCore(static_cast<u8>(idealCore)), parent(parent), ctxMemory(tlsMemory), KSyncObject(state,
         KType::KThread) {
+        waitStatus.thread = this;
         UpdatePriority(priority);
+        UpdateAffinity(idealCore, affinityMask);
     }
 
     KThread::~KThread() {
@@ -21,6 +103,7 @@ namespace skyline::kernel::type {
             if (tid == parent->pid)
                 parent->status = KProcess::Status::Started;
             status = Status::Running;
+            state.os->scheduler.InsertThread(this);
 
             state.nce->StartThread(entryArg, handle, parent->threads.at(tid));
         }
@@ -30,16 +113,60 @@ namespace skyline::kernel::type {
         if (status != Status::Dead) {
             status = Status::Dead;
             Signal();
+            state.os->scheduler.RemoveThread(this);
 
             tgkill(parent->pid, tid, SIGTERM);
         }
     }
 
     void KThread::UpdatePriority(i8 priority) {
-        this->priority = priority;
-        auto priorityValue{androidPriority.Rescale(switchPriority, priority)};
+        std::lock_guard guard(priorityMutex);
+        basePriority = priority;
+        this->priority = std::min(basePriority, inheritedPriority);
+        auto priorityValue{androidPriority.Rescale(switchPriority, this->priority)};
+
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), priorityValue) == -1)
+            throw exception("Couldn't set process priority to {} for PID: {}", priorityValue, tid);
+
+        state.os->scheduler.UpdatePriority(this);
+    }
+
+    void KThread::InheritPriority(i8 priority) {
+        std::lock_guard guard(priorityMutex);
+        inheritedPriority = priority;
+
+        // The host priority is only changed when the effective priority does, as most contended mutexes are between threads of the same priority
+        auto effectivePriority{std::min(basePriority, inheritedPriority)};
+        if (effectivePriority == this->priority)
+            return;
 
+        this->priority = effectivePriority;
+        auto priorityValue{androidPriority.Rescale(switchPriority, effectivePriority)};
         if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), priorityValue) == -1)
             throw exception("Couldn't set process priority to {} for PID: {}", priorityValue, tid);
+
+        state.os->scheduler.UpdatePriority(this);
+    }
+
+    void KThread::WakeSynchronization() {
+        syncSequence.fetch_add(1, std::memory_order_release);
+        syscall(__NR_futex, &syncSequence, FUTEX_WAKE_PRIVATE, INT32_MAX);
+    }
+
+    void KThread::WaitSynchronization(u32 sequence, u64 timeout) {
+        constexpr u64 MaxTimeout{INT64_MAX / constant::NsInSecond}; // The maximum duration in seconds which can be represented by timespec
+        timespec spec{
+            .tv_sec = static_cast<time_t>(std::min(timeout / constant::NsInSecond, MaxTimeout)),
+            .tv_nsec = static_cast<long>(timeout % constant::NsInSecond),
+        };
+
+        syscall(__NR_futex, &syncSequence, FUTEX_WAIT_PRIVATE, sequence, &spec);
+    }
+
+    void KThread::UpdateAffinity(i8 idealCore, u64 affinityMask) {
+        this->idealCore = idealCore;
+        this->affinityMask = affinityMask;
+
+        state.os->scheduler.UpdateAffinity(this);
     }
 }
@@ -7,13 +7,127 @@
 #include "KSharedMemory.h"
 
 namespace skyline::kernel::type {
+    class WaitList;
+    class KThread;
+
+    /**
+     * @brief Metadata on a thread waiting for mutexes, conditional variables or arbitration, it's embedded in the waiting thread and linked into the wait list directly so waiting never allocates
+     */
+    struct WaitStatus {
+        std::atomic<u32> flag{false}; //!< The underlying atomic flag of the thread, it's used as a futex to sleep on
+        u8 priority{}; //!< The priority of the thread
+        KHandle handle{}; //!< The handle of the thread
+        u64 mutexAddress{}; //!< The address of the mutex
+        u64 address{}; //!< The address that is being arbitrated on
+        WaitStatus *prev{}; //!< The previous waiter in the wait list
+        WaitStatus *next{}; //!< The next waiter in the wait list
+        WaitList *list{}; //!< The wait list the waiter is currently in, it's only accessed while the lock of the list is held
+        KThread *thread{}; //!< The thread this status is embedded in, this is constant for the lifetime of the thread
+
+        /**
+         * @brief Prepares the status for a new wait, this must only be done by the owning thread while it isn't in any wait list
+         */
+        void Reset(u8 priority, KHandle handle, u64 mutexAddress = 0, u64 address = 0);
+
+        /**
+         * @brief Sleeps till the flag has been set by Signal or the deadline has passed
+         * @param deadline The absolute time on CLOCK_MONOTONIC to stop waiting at, the wait is indefinite if this is nullptr
+         * @return If the flag was set
+         */
+        bool Wait(const timespec *deadline = nullptr);
+
+        /**
+         * @brief Sets the flag and wakes up the thread sleeping in Wait
+         */
+        void Signal();
+    };
+
+    /**
+     * @brief An intrusive doubly-linked list of waiters sorted by priority, it's externally synchronized by the lock of its owner
+     */
+    class WaitList {
+      private:
+        WaitStatus *head{};
+        WaitStatus *tail{};
+        size_t count{};
+
+      public:
+        WaitStatus *Front() const {
+            return head;
+        }
+
+        bool Empty() const {
+            return !head;
+        }
+
+        size_t Size() const {
+            return count;
+        }
+
+        /**
+         * @return If the waiter is in this list
+         */
+        bool Contains(const WaitStatus *status) const {
+            return status->list == this;
+        }
+
+        /**
+         * @brief Inserts a waiter after all waiters with an equal or higher priority value
+         */
+        void Insert(WaitStatus *status);
+
+        /**
+         * @brief Removes a waiter from this list
+         * @return The waiter after the removed one
+         */
+        WaitStatus *Remove(WaitStatus *status);
+
+        /**
+         * @brief Removes the first waiter from this list
+         */
+        WaitStatus *PopFront() {
+            auto status{head};
+            Remove(status);
+            return status;
+        }
+    };
+
+    /**
+     * @brief A map from an address to the waiters on it, lists are removed once they're empty and their nodes are pooled so that waiting on a new address doesn't allocate
+     * @note It's externally synchronized by the lock of its owner, like WaitList
+     */
+    class WaitListMap {
+      private:
+        using Map = std::unordered_map<u64, WaitList>;
+        Map map;
+        std::vector<Map::node_type> pool; //!< The nodes of lists which were emptied, they're reused for the next address that's waited on
+
+      public:
+        /**
+         * @return The wait list for the address or nullptr if nothing waits on it
+         */
+        WaitList *Find(u64 address) {
+            auto it{map.find(address)};
+            return it != map.end() ? &it->second : nullptr;
+        }
+
+        /**
+         * @return The wait list for the address, it's created from a pooled node if nothing waits on it
+         */
+        WaitList &Get(u64 address);
+
+        /**
+         * @brief Returns the node of the list for the address to the pool if it's empty
+         */
+        void Release(u64 address);
+    };
+
     /**
      * @brief KThread class is responsible for holding the state of a thread
      */
     class KThread : public KSyncObject {
       private:
         KProcess *parent; //!< The parent process of this thread
-        u64 entryPoint; //!< The address to start execution at
         u64 entryArg; //!< An argument to pass to the process on entry
 
         /**
@@ -48,12 +162,23 @@ namespace skyline::kernel::type {
             Dead,    //!< The thread is dead and not running
         } status = Status::Created;
         std::atomic<bool> cancelSync{false}; //!< This is to flag to a thread to cancel a synchronization call it currently is in
+        std::atomic<u32> syncSequence{}; //!< This is incremented whenever a thread waiting on synchronization should re-evaluate its wait, it's used as a futex to sleep on
         std::shared_ptr<type::KSharedMemory> ctxMemory; //!< The KSharedMemory of the shared memory allocated by the guest process TLS
         KHandle handle; // The handle of the object in the handle table
         pid_t tid; //!< The Linux Thread ID of the current thread
+        u64 entryPoint; //!< The address to start execution at, it's written into the context of the thread when it's started, so the main thread's is set by the OS once the executable has been loaded
         u64 stackTop; //!< The top of the stack (Where it starts growing downwards from)
         u64 tls; //!< The address of TLS (Thread Local Storage) slot assigned to the current thread
-        i8 priority; //!< The priority of a thread in Nintendo format
+        i8 priority; //!< The effective priority of a thread in Nintendo format, this is boosted above basePriority while a thread with a higher priority waits on a mutex it owns
+        i8 basePriority; //!< The priority of a thread in Nintendo format as set by the guest
+        i8 inheritedPriority{std::numeric_limits<i8>::max()}; //!< The highest priority of any thread waiting on a mutex this thread owns, this is synchronized by KProcess::mutexLock
+        std::vector<u64> inheritedMutexes; //!< The addresses of all mutexes with waiters that this thread owns, this is synchronized by KProcess::mutexLock
+        std::mutex priorityMutex; //!< Synchronizes changes to the priority from the guest and from priority inheritance
+        i8 idealCore; //!< The guest core this thread prefers to run on
+        u64 affinityMask; //!< A mask of the guest cores this thread is allowed to run on
+        u8 currentCore; //!< The guest core this thread is currently scheduled on, it's always in affinityMask
+
+        WaitStatus waitStatus; //!< The status of the thread while it waits on a mutex, conditional variable or address, a thread can only wait on one of them at a time
 
         Priority androidPriority{19, -8}; //!< The range of priorities for Android
         Priority switchPriority{0, 63}; //!< The range of priorities for the Nintendo Switch
@@ -66,10 +191,11 @@ namespace skyline::kernel::type {
          * @param stackTop The top of the stack
          * @param tls The address of the TLS slot assigned
          * @param priority The priority of the thread in Nintendo format
+         * @param idealCore The guest core this thread prefers to run on
          * @param parent The parent process of this thread
          * @param tlsMemory The KSharedMemory object for TLS memory allocated by the guest process
          */
-        KThread(const DeviceState &state, KHandle handle, pid_t selfTid, u64 entryPoint, u64 entryArg, u64 stackTop, u64 tls, i8 priority, KProcess *parent, const std::shared_ptr<type::KSharedMemory> &tlsMemory);
+        KThread(const DeviceState &state, KHandle handle, pid_t selfTid, u64 entryPoint, u64 entryArg, u64 stackTop, u64 tls, i8 priority, i8 idealCore, KProcess *parent, const std::shared_ptr<type::KSharedMemory> &tlsMemory);
 
         /**
          * @brief Kills the thread and deallocates the memory allocated for stack.
@@ -90,7 +216,34 @@ namespace skyline::kernel::type {
          * @brief Update the priority level for the process.
          * @details Set the priority of the current thread to `priority` using setpriority [https://linux.die.net/man/3/setpriority]. We rescale the priority from Nintendo scale to that of Android.
          * @param priority The priority of the thread in Nintendo format
+         * @note The thread keeps running at any higher priority it inherited till the mutexes it inherited it through are unlocked
          */
         void UpdatePriority(i8 priority);
+
+        /**
+         * @brief Boosts the effective priority of the thread to the supplied priority or restores it to its base priority if the supplied one is lower
+         * @param priority The highest priority of any thread waiting on a mutex this thread owns, this must be synchronized by KProcess::mutexLock
+         */
+        void InheritPriority(i8 priority);
+
+        /**
+         * @brief Wakes up this thread if it's sleeping in WaitSynchronization, so that it re-checks its objects and cancellation
+         */
+        void WakeSynchronization();
+
+        /**
+         * @brief Sleeps till WakeSynchronization is called after syncSequence was read as the supplied value or the timeout elapses
+         * @param sequence The value of syncSequence read prior to checking the condition being waited on
+         * @param timeout The maximum duration to sleep for in nanoseconds
+         */
+        void WaitSynchronization(u32 sequence, u64 timeout);
+
+        /**
+         * @brief Update the core affinity of the thread
+         * @details The thread is migrated to its ideal core by the Scheduler if its current core isn't in the mask, the host cores of its guest core are then applied with sched_setaffinity [https://linux.die.net/man/2/sched_setaffinity]
+         * @param idealCore The guest core this thread prefers to run on
+         * @param affinityMask A mask of the guest cores this thread is allowed to run on, it must contain the ideal core
+         */
+        void UpdateAffinity(i8 idealCore, u64 affinityMask);
     };
 }
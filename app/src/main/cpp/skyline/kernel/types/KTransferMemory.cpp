@@ -2,8 +2,10 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <asm/unistd.h>
+#include <unistd.h>
 #include <nce.h>
 #include <os.h>
+#include <statistics.h>
 #include "KProcess.h"
 #include "KTransferMemory.h"
 
@@ -12,45 +14,87 @@ namespace skyline::kernel::type {
         if (address && !util::PageAligned(address))
             throw exception("KTransferMemory was created with non-page-aligned address: 0x{:X}", address);
 
+        fd = MemoryManager::CreateMemoryFile("KTransferMemory", size);
+        this->address = Map(host, address, size, permission);
+
         BlockDescriptor block{
+            .address = this->address,
             .size = size,
             .permission = permission,
         };
         ChunkDescriptor chunk{
+            .address = this->address,
             .size = size,
             .state = memState,
             .blockList = {block},
         };
 
         if (host) {
-            address = reinterpret_cast<u64>(mmap(reinterpret_cast<void *>(address), size, permission.Get(), MAP_ANONYMOUS | MAP_PRIVATE | ((address) ? MAP_FIXED : 0), -1, 0));
-            if (reinterpret_cast<void *>(address) == MAP_FAILED)
-                throw exception("An error occurred while mapping transfer memory in host");
-
-            this->address = address;
-            chunk.address = address;
-            chunk.blockList.front().address = address;
             hostChunk = chunk;
+            state.statistics->TrackHostMapping(this->address, size, memState.type);
         } else {
-            Registers fregs{
-                .x0 = address,
-                .x1 = size,
-                .x2 = static_cast<u64 >(permission.Get()),
-                .x3 = static_cast<u64>(MAP_ANONYMOUS | MAP_PRIVATE | ((address) ? MAP_FIXED : 0)),
-                .x4 = static_cast<u64>(-1),
-                .x8 = __NR_mmap,
-            };
+            state.os->memory.InsertChunk(chunk);
+        }
+    }
 
-            state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-            if (fregs.x0 < 0)
-                throw exception("An error occurred while mapping shared region in child process");
+    u64 KTransferMemory::Map(bool mHost, u64 nAddress, size_t nSize, memory::Permission permission) {
+        if (mHost) {
+            auto mapping{mmap(reinterpret_cast<void *>(nAddress), nSize, permission.Get(), MAP_SHARED | ((nAddress) ? MAP_FIXED : 0), fd, 0)};
+            if (mapping == MAP_FAILED)
+                throw exception("An error occurred while mapping transfer memory in host: {}", strerror(errno));
+            return reinterpret_cast<u64>(mapping);
+        }
 
-            this->address = fregs.x0;
-            chunk.address = fregs.x0;
-            chunk.blockList.front().address = fregs.x0;
+        Registers fregs{
+            .x0 = nAddress,
+            .x1 = nSize,
+            .x2 = static_cast<u64>(permission.Get()),
+            .x3 = static_cast<u64>(MAP_SHARED | ((nAddress) ? MAP_FIXED : 0)),
+            .x4 = static_cast<u64>(fd),
+            .x8 = __NR_mmap,
+        };
 
-            state.os->memory.InsertChunk(chunk);
+        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
+        if (fregs.x0 < 0)
+            throw exception("An error occurred while mapping transfer memory in child process");
+        return fregs.x0;
+    }
+
+    void KTransferMemory::Protect(bool mHost, u64 nAddress, size_t nSize, memory::Permission permission) {
+        if (mHost) {
+            if (mprotect(reinterpret_cast<void *>(nAddress), nSize, permission.Get()) < 0)
+                throw exception("An error occurred while updating transfer memory's permissions in host: {}", strerror(errno));
+            return;
+        }
+
+        Registers fregs{
+            .x0 = nAddress,
+            .x1 = nSize,
+            .x2 = static_cast<u64>(permission.Get()),
+            .x8 = __NR_mprotect,
+        };
+
+        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
+        if (fregs.x0 < 0)
+            throw exception("An error occurred while updating transfer memory's permissions in guest");
+    }
+
+    void KTransferMemory::Unmap(bool mHost, u64 nAddress, size_t nSize) {
+        if (mHost) {
+            if (munmap(reinterpret_cast<void *>(nAddress), nSize) < 0)
+                throw exception("An error occurred while unmapping transfer memory in host: {}", strerror(errno));
+            return;
         }
+
+        Registers fregs{
+            .x0 = nAddress,
+            .x1 = nSize,
+            .x8 = __NR_munmap,
+        };
+
+        state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
+        if (fregs.x0 < 0)
+            throw exception("An error occurred while unmapping transfer memory in child process");
     }
 
     u64 KTransferMemory::Transfer(bool mHost, u64 nAddress, u64 nSize) {
@@ -59,89 +103,45 @@ namespace skyline::kernel::type {
 
         nSize = nSize ? nSize : size;
 
+        // Both sides map the same memory file, so transferring the memory only maps it on the new side and unmaps it from the old one without copying any of its contents
+        if (nSize > size)
+            MemoryManager::ResizeMemoryFile(fd, nSize);
+
         auto chunk{host ? hostChunk : *state.os->memory.GetChunk(address)};
-        chunk.address = nAddress;
-        chunk.size = nSize;
-        MemoryManager::ResizeChunk(&chunk, nSize);
+        nAddress = Map(mHost, nAddress, nSize, chunk.blockList.front().permission);
 
-        for (auto &block : chunk.blockList) {
+        for (auto &block : chunk.blockList)
             block.address = nAddress + (block.address - address);
+        chunk.address = nAddress;
+        MemoryManager::ResizeBlocks(&chunk, nSize);
 
-            if ((mHost && !host) || (!mHost && !host)) {
-                Registers fregs{
-                    .x0 = block.address,
-                    .x1 = block.size,
-                    .x2 = (block.permission.w) ? static_cast<u64>(block.permission.Get()) : (PROT_READ | PROT_WRITE),
-                    .x3 = static_cast<u64>(MAP_ANONYMOUS | MAP_PRIVATE | ((nAddress) ? MAP_FIXED : 0)),
-                    .x4 = static_cast<u64>(-1),
-                    .x8 = __NR_mmap,
-                };
+        for (auto block{std::next(chunk.blockList.begin())}, end{chunk.blockList.end()}; block != end; block++)
+            Protect(mHost, block->address, block->size, block->permission);
 
-                state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-                if (fregs.x0 < 0)
-                    throw exception("An error occurred while mapping transfer memory in child process");
-
-                nAddress = fregs.x0;
-            } else if ((!mHost && host) || (mHost && host)) {
-                nAddress = reinterpret_cast<u64>(mmap(reinterpret_cast<void *>(block.address), block.size, block.permission.Get(), MAP_ANONYMOUS | MAP_PRIVATE | ((nAddress) ? MAP_FIXED : 0), -1, 0));
-                if (reinterpret_cast<void *>(nAddress) == MAP_FAILED)
-                    throw exception("An error occurred while mapping transfer memory in host");
-            }
-
-            if (block.permission.r) {
-                if (mHost && !host)
-                    state.process->ReadMemory(reinterpret_cast<void *>(nAddress), address, block.size);
-                else if (!mHost && host)
-                    state.process->WriteMemory(reinterpret_cast<void *>(address), nAddress, block.size);
-                else if (!mHost && !host)
-                    state.process->CopyMemory(address, nAddress, block.size);
-                else if (mHost && host)
-                    std::memcpy(reinterpret_cast<void *>(nAddress), reinterpret_cast<void *>(address), block.size);
-            }
-            if (!block.permission.w) {
-                if (mHost) {
-                    if (mprotect(reinterpret_cast<void *>(block.address), block.size, block.permission.Get()) == reinterpret_cast<u64>(MAP_FAILED))
-                        throw exception("An error occurred while remapping transfer memory: {}", strerror(errno));
-                } else {
-                    Registers fregs{
-                        .x0 = block.address,
-                        .x1 = block.size,
-                        .x2 = static_cast<u64>(block.permission.Get()),
-                        .x8 = __NR_mprotect,
-                    };
-
-                    state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-                    if (fregs.x0 < 0)
-                        throw exception("An error occurred while updating transfer memory's permissions in guest");
-                }
-            }
+        if (mHost != host || address >= nAddress + nSize || address + size <= nAddress) {
+            Unmap(host, address, size);
+        } else {
+            // The new mapping has replaced the overlapping part of the old one, so only the rest of the old one is unmapped
+            if (address < nAddress)
+                Unmap(host, address, nAddress - address);
+            if (address + size > nAddress + nSize)
+                Unmap(host, nAddress + nSize, (address + size) - (nAddress + nSize));
         }
 
-        if (mHost && !host) {
-            state.os->memory.DeleteChunk(address);
-            hostChunk = chunk;
-        } else if (!mHost && host) {
-            state.os->memory.InsertChunk(chunk);
-        } else if (mHost && host) {
-            hostChunk = chunk;
-        } else if (!mHost && !host) {
+        if (host) {
+            state.statistics->UntrackHostMapping(address);
+        } else {
             state.os->memory.DeleteChunk(address);
-            state.os->memory.InsertChunk(chunk);
         }
 
-        if ((mHost && !host) || (!mHost && !host)) {
-            Registers fregs{
-                .x0 = address,
-                .x1 = size,
-                .x8 = __NR_munmap,
-            };
+        if (nSize < size)
+            MemoryManager::ResizeMemoryFile(fd, nSize);
 
-            state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-            if (fregs.x0 < 0)
-                throw exception("An error occurred while unmapping transfer memory in child process");
-        } else if ((!mHost && host) || (mHost && host)) {
-            if (reinterpret_cast<void *>(munmap(reinterpret_cast<void *>(address), size)) == MAP_FAILED)
-                throw exception("An error occurred while unmapping transfer memory in host: {}");
+        if (mHost) {
+            hostChunk = chunk;
+            state.statistics->TrackHostMapping(nAddress, nSize, chunk.state.type);
+        } else {
+            state.os->memory.InsertChunk(chunk);
         }
 
         host = mHost;
@@ -150,10 +150,25 @@ namespace skyline::kernel::type {
         return address;
     }
 
+    span<u8> KTransferMemory::GetHostSpan() {
+        if (host)
+            return span(reinterpret_cast<u8 *>(address), size);
+
+        auto pointer{state.process->GetPointer<u8>(address)};
+        if (!pointer)
+            throw exception("Transfer memory at 0x{:X} isn't accessible from the host", address);
+        return span(pointer, size);
+    }
+
     void KTransferMemory::Resize(size_t nSize) {
+        if (nSize > size)
+            MemoryManager::ResizeMemoryFile(fd, nSize);
+
         if (host) {
             if (mremap(reinterpret_cast<void *>(address), size, nSize, 0) == MAP_FAILED)
                 throw exception("An error occurred while remapping transfer memory in host: {}", strerror(errno));
+            MemoryManager::ResizeBlocks(&hostChunk, nSize);
+            state.statistics->TrackHostMapping(address, nSize, hostChunk.state.type);
         } else {
             Registers fregs{
                 .x0 = address,
@@ -166,11 +181,13 @@ namespace skyline::kernel::type {
             if (fregs.x0 < 0)
                 throw exception("An error occurred while remapping transfer memory in guest");
 
-            size = nSize;
-
             auto chunk{state.os->memory.GetChunk(address)};
-            MemoryManager::ResizeChunk(chunk, size);
+            state.os->memory.ResizeChunk(chunk, nSize);
         }
+
+        if (nSize < size)
+            MemoryManager::ResizeMemoryFile(fd, nSize);
+        size = nSize;
     }
 
     void KTransferMemory::UpdatePermission(u64 address, u64 size, memory::Permission permission) {
@@ -180,31 +197,17 @@ namespace skyline::kernel::type {
             .permission = permission,
         };
 
-        if (host) {
-            if (mprotect(reinterpret_cast<void *>(address), size, permission.Get()) == reinterpret_cast<u64>(MAP_FAILED))
-                throw exception("An occurred while remapping transfer memory: {}", strerror(errno));
-
+        Protect(host, address, size, permission);
+        if (host)
             MemoryManager::InsertBlock(&hostChunk, block);
-        } else {
-            Registers fregs{
-                .x0 = address,
-                .x1 = size,
-                .x2 = static_cast<u64>(permission.Get()),
-                .x8 = __NR_mprotect,
-            };
-
-            state.nce->ExecuteFunction(ThreadCall::Syscall, fregs);
-            if (fregs.x0 < 0)
-                throw exception("An error occurred while updating transfer memory's permissions in guest");
-
-            auto chunk{state.os->memory.GetChunk(address)};
-            MemoryManager::InsertBlock(chunk, block);
-        }
+        else
+            MemoryManager::InsertBlock(state.os->memory.GetChunk(address), block);
     }
 
     KTransferMemory::~KTransferMemory() {
         if (host) {
             munmap(reinterpret_cast<void *>(address), size);
+            state.statistics->UntrackHostMapping(address);
         } else if (state.process) {
             try {
                 Registers fregs{
@@ -219,5 +222,6 @@ namespace skyline::kernel::type {
             } catch (const std::exception &) {
             }
         }
+        close(fd);
     }
 };
@@ -11,7 +11,26 @@ namespace skyline::kernel::type {
      */
     class KTransferMemory : public KMemory {
       private:
+        int fd; //!< A file descriptor to the memory file backing the memory, it's mapped by whichever side currently owns the memory
         ChunkDescriptor hostChunk{};
+
+        /**
+         * @brief Maps the memory file on the host or in the guest
+         * @param address The address to map it at, if this is 0 then an arbitrary address is picked
+         * @return The address the memory file was mapped at
+         */
+        u64 Map(bool host, u64 address, size_t size, memory::Permission permission);
+
+        /**
+         * @brief Changes the permissions of a range of the mapping on the host or in the guest
+         */
+        void Protect(bool host, u64 address, size_t size, memory::Permission permission);
+
+        /**
+         * @brief Unmaps a range of the mapping on the host or in the guest
+         */
+        void Unmap(bool host, u64 address, size_t size);
+
       public:
         bool host; //!< If the memory is mapped on the host or the guest
         u64 address; //!< The current address of the allocated memory for the kernel
@@ -36,6 +55,11 @@ namespace skyline::kernel::type {
          */
         u64 Transfer(bool host, u64 address, u64 size = 0);
 
+        /**
+         * @return A span of the memory through which the host can access it directly, regardless of the side it's currently mapped on
+         */
+        span<u8> GetHostSpan();
+
         /**
          * @brief Remap a chunk of memory as to change the size occupied by it
          * @param size The new size of the memory
@@ -11,11 +11,12 @@ namespace skyline::loader {
      */
     struct Executable {
         /**
-         * @brief The contents and offset of an executable segment
+         * @brief The placement and contents of an executable segment
          */
         struct Segment {
-            std::vector<u8> contents; //!< The raw contents of the segment
             size_t offset; //!< The offset from the base address to load the segment at
+            size_t size; //!< The page-aligned size of the segment in memory
+            span<u8> contents{}; //!< The contents of the segment in the host mapping of guest memory, this is only valid after the executable has been mapped
         };
 
         Segment text; //!< The .text segment container
@@ -23,5 +24,7 @@ namespace skyline::loader {
         Segment data; //!< The .data segment container
 
         size_t bssSize; //!< The size of the .bss segment
+        size_t islandSize{}; //!< The size of the address space reserved for a branch island in front of the executable, this is only set when the .patch section after it would be out of reach of the start of the .text segment
+        u64 base{}; //!< The address the executable is mapped at, this is only valid after the executable has been mapped
     };
 }
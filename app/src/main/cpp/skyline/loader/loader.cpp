@@ -1,19 +1,111 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <mbedtls/sha256.h>
 #include <nce.h>
+#include <nce/guest.h>
 #include <os.h>
 #include <kernel/types/KProcess.h>
 #include <kernel/memory.h>
+#include <statistics.h>
+#include <vfs/os_filesystem.h>
 #include "loader.h"
 
 namespace skyline::loader {
-    Loader::ExecutableLoadInfo Loader::LoadExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable, size_t offset) {
-        u64 base{constant::BaseAddress + offset};
+    std::vector<u32> Loader::PatchExecutable(const DeviceState &state, span<u8> code, u64 baseAddress, i64 patchOffset) {
+        BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::Patching);
+        constexpr u32 PatchCacheMagic{util::MakeMagic<u32>("PTCH")};
+        constexpr u32 PatchCacheVersion{3}; // This must be incremented whenever the output of NCE::PatchCode changes without a change in the guest code
 
-        u64 textSize{executable.text.contents.size()};
-        u64 roSize{executable.ro.contents.size()};
-        u64 dataSize{executable.data.contents.size() + executable.bssSize};
+        struct PatchCacheHeader {
+            u32 magic; //!< The magic of the cache file ("PTCH")
+            u32 version; //!< The version of the cache file
+            u64 textSize; //!< The size of the patched region of the .text segment in bytes
+            u64 patchSize; //!< The size of the .patch section in bytes
+        };
+
+        u64 frequency;
+        asm("MRS %0, CNTFRQ_EL0" : "=r"(frequency));
+
+        // The key covers everything that determines the output of PatchCode: the unpatched code, where it's placed, the host clock frequency, if SVC history is enabled and the guest code that is copied into the patch
+        std::array<u8, 0x20> key{};
+        {
+            mbedtls_sha256_context context;
+            mbedtls_sha256_init(&context);
+            mbedtls_sha256_starts_ret(&context, 0);
+
+            std::array<u64, 5> parameters{baseAddress, static_cast<u64>(patchOffset), frequency, state.nce->svcHistory, PatchCacheVersion};
+            mbedtls_sha256_update_ret(&context, reinterpret_cast<u8 *>(parameters.data()), parameters.size() * sizeof(u64));
+            mbedtls_sha256_update_ret(&context, reinterpret_cast<u8 *>(&guest::SvcHandler), guest::SvcHandlerSize);
+            mbedtls_sha256_update_ret(&context, code.data(), code.size());
+
+            mbedtls_sha256_finish_ret(&context, key.data());
+            mbedtls_sha256_free(&context);
+        }
+
+        std::string path;
+        for (auto byte : key)
+            path += fmt::format("{:02X}", byte);
+
+        std::shared_ptr<vfs::OsFileSystem> cache;
+        try {
+            cache = std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/cache/patch/");
+
+            if (cache->FileExists(path)) {
+                auto file{cache->OpenFile(path)};
+                auto header{file->Read<PatchCacheHeader>()};
+                if (header.magic == PatchCacheMagic && header.version == PatchCacheVersion && header.textSize == code.size() && file->size == sizeof(PatchCacheHeader) + header.textSize + header.patchSize) {
+                    // The patch is read before the patched code as a failed read of it mustn't leave the code partially overwritten
+                    std::vector<u32> patch(header.patchSize / sizeof(u32));
+                    auto patchSpan{span(reinterpret_cast<u8 *>(patch.data()), header.patchSize)};
+                    if (file->Read(patchSpan, sizeof(PatchCacheHeader) + header.textSize) != header.patchSize)
+                        throw exception("Patch cache file is truncated");
+
+                    file->Read(code, sizeof(PatchCacheHeader));
+                    state.logger->Debug("Loaded patched code from the patch cache: {}", path);
+                    return patch;
+                }
+            }
+        } catch (const std::exception &e) {
+            // The cache is only an optimization, so failing to read from it shouldn't prevent the executable from being loaded
+            state.logger->Warn("Failed to read from the patch cache: {}", e.what());
+        }
+
+        auto patch{state.nce->PatchCode(code, baseAddress, patchOffset)};
+
+        if (cache) {
+            try {
+                PatchCacheHeader header{
+                    .magic = PatchCacheMagic,
+                    .version = PatchCacheVersion,
+                    .textSize = code.size(),
+                    .patchSize = patch.size() * sizeof(u32),
+                };
+
+                cache->CreateFile(path, sizeof(PatchCacheHeader) + header.textSize + header.patchSize);
+                auto file{cache->OpenFile(path, {false, true, false})};
+                file->Write(code, sizeof(PatchCacheHeader));
+                file->Write(span(reinterpret_cast<u8 *>(patch.data()), header.patchSize), sizeof(PatchCacheHeader) + header.textSize);
+                file->Write(span(reinterpret_cast<u8 *>(&header), sizeof(PatchCacheHeader))); // The header is written last so an interrupted write never results in a valid cache file
+            } catch (const std::exception &e) {
+                state.logger->Warn("Failed to write to the patch cache: {}", e.what());
+            }
+        }
+
+        return patch;
+    }
+
+    void Loader::MapExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable, size_t offset) {
+        BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::Mapping);
+        u64 textSize{executable.text.size};
+        u64 roSize{executable.ro.size};
+        u64 dataSize{executable.data.size + executable.bssSize};
+
+        // The start of the .text segment can't reach the end of a .patch section after the executable, so address space is reserved in front of it for a branch island
+        if (executable.data.offset + dataSize + MaxPatchSize > MaxBranchDistance)
+            executable.islandSize = BranchIslandSize;
+
+        u64 base{constant::BaseAddress + offset + executable.islandSize};
 
         if (!util::PageAligned(textSize) || !util::PageAligned(roSize) || !util::PageAligned(dataSize))
             throw exception("LoadProcessData: Sections are not aligned with page size: 0x{:X}, 0x{:X}, 0x{:X}", textSize, roSize, dataSize);
@@ -21,13 +113,6 @@ namespace skyline::loader {
         if (!util::PageAligned(executable.text.offset) || !util::PageAligned(executable.ro.offset) || !util::PageAligned(executable.data.offset))
             throw exception("LoadProcessData: Section offsets are not aligned with page size: 0x{:X}, 0x{:X}, 0x{:X}", executable.text.offset, executable.ro.offset, executable.data.offset);
 
-        // The data section will always be the last section in memory, so put the patch section after it
-        u64 patchOffset{executable.data.offset + dataSize};
-        std::vector<u32> patch = state.nce->PatchCode(executable.text.contents, base, patchOffset);
-
-        u64 patchSize{patch.size() * sizeof(u32)};
-        u64 padding{util::AlignUp(patchSize, PAGE_SIZE) - patchSize};
-
         process->NewHandle<kernel::type::KPrivateMemory>(base + executable.text.offset, textSize, memory::Permission{true, false, true}, memory::states::CodeStatic); // R-X
         state.logger->Debug("Successfully mapped section .text @ 0x{0:X}, Size = 0x{1:X}", base + executable.text.offset, textSize);
 
@@ -37,14 +122,49 @@ namespace skyline::loader {
         process->NewHandle<kernel::type::KPrivateMemory>(base + executable.data.offset, dataSize, memory::Permission{true, true, false}, memory::states::CodeMutable); // RW-
         state.logger->Debug("Successfully mapped section .data @ 0x{0:X}, Size = 0x{1:X}", base + executable.data.offset, dataSize);
 
-        process->NewHandle<kernel::type::KPrivateMemory>(base + patchOffset, patchSize + padding, memory::Permission{true, true, true}, memory::states::CodeMutable); // RWX
-        state.logger->Debug("Successfully mapped section .patch @ 0x{0:X}, Size = 0x{1:X}", base + patchOffset, patchSize + padding);
+        // Every segment is backed by its own host mapping regardless of the guest permissions, so the contents can be written into it directly
+        for (auto segment : {&executable.text, &executable.ro, &executable.data})
+            segment->contents = span(process->GetPointer<u8>(base + segment->offset), segment->size);
+
+        executable.base = base;
+    }
+
+    Loader::ExecutableLoadInfo Loader::FinalizeExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable) {
+        // The data section will always be the last section in memory, so put the patch section after it
+        u64 patchOffset{executable.data.offset + executable.data.size + executable.bssSize};
+        auto text{executable.text.contents};
+
+        if (executable.islandSize) {
+            // The trampolines of all code within reach of the branch island are placed in it, this also keeps them close to the code that branches to them
+            auto islandReach{std::min<size_t>(text.size(), MaxBranchDistance - executable.islandSize)};
+            auto island{PatchExecutable(state, text.first(islandReach), executable.base, -static_cast<i64>(executable.islandSize))};
+
+            u64 islandSize{island.size() * sizeof(u32)};
+            if (islandSize > executable.islandSize)
+                throw exception("Branch island is larger than the space reserved for it: 0x{:X} (Maximum: 0x{:X})", islandSize, executable.islandSize);
+
+            u64 islandAddress{executable.base - executable.islandSize};
+            process->NewHandle<kernel::type::KPrivateMemory>(islandAddress, util::AlignUp(islandSize, PAGE_SIZE), memory::Permission{true, true, true}, memory::states::CodeMutable); // RWX
+            state.logger->Debug("Successfully mapped branch island @ 0x{0:X}, Size = 0x{1:X}", islandAddress, util::AlignUp(islandSize, PAGE_SIZE));
+
+            process->WriteMemory(island.data(), islandAddress, islandSize);
+            text = text.subspan(islandReach);
+        }
+
+        u64 textOffset{executable.text.size - text.size()}; // The offset of the code patched into the .patch section from the base address
+        auto patch{PatchExecutable(state, text, executable.base + textOffset, static_cast<i64>(patchOffset - textOffset))};
+
+        u64 patchSize{patch.size() * sizeof(u32)};
+        u64 padding{util::AlignUp(patchSize, PAGE_SIZE) - patchSize};
+
+        if (!text.empty() && (patchOffset + patchSize) - textOffset > MaxBranchDistance)
+            throw exception("Executable is too large for its .patch section to be in reach of its code: 0x{:X}", patchOffset + patchSize);
+
+        process->NewHandle<kernel::type::KPrivateMemory>(executable.base + patchOffset, patchSize + padding, memory::Permission{true, true, true}, memory::states::CodeMutable); // RWX
+        state.logger->Debug("Successfully mapped section .patch @ 0x{0:X}, Size = 0x{1:X}", executable.base + patchOffset, patchSize + padding);
 
-        process->WriteMemory(executable.text.contents.data(), base + executable.text.offset, textSize);
-        process->WriteMemory(executable.ro.contents.data(), base + executable.ro.offset, roSize);
-        process->WriteMemory(executable.data.contents.data(), base + executable.data.offset, dataSize - executable.bssSize);
-        process->WriteMemory(patch.data(), base + patchOffset, patchSize);
+        process->WriteMemory(patch.data(), executable.base + patchOffset, patchSize);
 
-        return {base, patchOffset + patchSize + padding};
+        return {executable.base - executable.islandSize, executable.islandSize + patchOffset + patchSize + padding, executable.base};
     }
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <vfs/nacp.h>
 #include "executable.h"
 
@@ -17,6 +18,8 @@ namespace skyline::loader {
         NCA, //!< The NCA format: https://switchbrew.org/wiki/NCA
         XCI, //!< The XCI format: https://switchbrew.org/wiki/XCI
         NSP, //!< The NSP format from "nspwn" exploit: https://switchbrew.org/wiki/Switch_System_Flaws
+        NSZ, //!< An NSP with zstd-compressed NCZs in place of NCAs: https://github.com/nicoboss/nsz
+        XCZ, //!< An XCI with zstd-compressed NCZs in place of NCAs: https://github.com/nicoboss/nsz
     };
 
     /**
@@ -51,22 +54,45 @@ namespace skyline::loader {
          * @brief Information about the placement of an executable in memory
          */
         struct ExecutableLoadInfo {
-            size_t base; //!< The base of the loaded executable
-            size_t size; //!< The total size of the loaded executable
+            size_t base; //!< The base of the loaded executable, this is the start of its branch island if it has one
+            size_t size; //!< The total size of the loaded executable including its branch island and .patch section
+            u64 entry; //!< The address of the start of the .text segment, this is where execution of the executable starts
         };
 
+        static constexpr u64 MaxBranchDistance{0x8000000}; //!< The maximum distance a B or BL instruction can branch in either direction (128 MiB), every instruction needs to be within it of its trampoline
+        static constexpr u64 BranchIslandSize{0x1000000}; //!< The amount of address space reserved in front of the .text segment of executables too large for their trampolines to all be after them
+        static constexpr u64 MaxPatchSize{BranchIslandSize}; //!< The size that the .patch section of an executable is assumed to be at most when deciding if it needs a branch island, the actual size is only known once the code has been loaded
+
         /**
-         * @brief Loads an executable into memory
-         * @param process The process to load the executable into
-         * @param executable The executable itself
+         * @brief Patches a region of the .text segment of a mapped executable in-place or loads the result of patching it from the on-disk cache
+         * @param code The region of the .text segment to patch
+         * @param baseAddress The address at which the region is mapped
+         * @param patchOffset The offset of the patch from the start of the region
+         * @return The contents of the patch
+         */
+        static std::vector<u32> PatchExecutable(const DeviceState &state, span<u8> code, u64 baseAddress, i64 patchOffset);
+
+        /**
+         * @brief Maps the segments of an executable into memory, their contents then need to be written into the host mappings before the executable is finalized
+         * @param process The process to map the executable into
+         * @param executable The executable itself, its base and the contents of its segments are set to where it's mapped
          * @param offset The offset from the base address that the executable should be placed at
+         */
+        static void MapExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable, size_t offset = 0);
+
+        /**
+         * @brief Patches the code of a mapped executable with populated segments and maps its .patch section after it
+         * @note The trampolines of the start of the .text segment are placed into a branch island in front of it if the .patch section would be out of their reach
+         * @param process The process the executable is mapped into
+         * @param executable The executable itself
          * @return An ExecutableLoadInfo struct containing the load base and size
          */
-        static ExecutableLoadInfo LoadExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable, size_t offset = 0);
+        static ExecutableLoadInfo FinalizeExecutable(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, Executable &executable);
 
       public:
         std::shared_ptr<vfs::NACP> nacp; //!< The NACP of the current application
         std::shared_ptr<vfs::Backing> romFs; //!< The RomFS of the current application
+        u64 titleId{}; //!< The title ID of the current application, this is 0 for formats which don't contain one
 
         virtual ~Loader() = default;
 
@@ -77,10 +103,20 @@ namespace skyline::loader {
             return std::vector<u8>();
         }
 
+        /**
+         * @brief Verifies the data of the ROM against the hashes it contains, this reads the entire ROM so it should be done on a background thread
+         * @param cancel If set, the verification is stopped as soon as possible
+         * @return If the ROM is intact, this is also true for ROMs without any hashes and if the verification was cancelled
+         */
+        virtual bool VerifyIntegrity(const std::atomic_bool &cancel) {
+            return true;
+        }
+
         /**
          * @brief Loads in the data of the main process
          * @param process The process to load in the data
+         * @return The address that the main thread of the process starts execution at
          */
-        virtual void LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) = 0;
+        virtual u64 LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) = 0;
     };
 }
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include "metadata_cache.h"
+
+namespace skyline::loader {
+    /**
+     * @brief A 64-bit FNV-1a hash, it's used rather than any other hash as it has to be stable across versions since it's persisted
+     */
+    static u64 HashFnv(span<u8> data, u64 hash = 0xCBF29CE484222325) {
+        for (auto byte : data)
+            hash = (hash ^ byte) * 0x100000001B3;
+        return hash;
+    }
+
+    MetadataCache::MetadataCache(int fd, const std::string &appFilesPath) {
+        struct stat fileStat{};
+        if (fstat(fd, &fileStat) < 0)
+            return;
+
+        std::array<u8, HeaderHashSize> header{};
+        auto headerSize{pread64(fd, header.data(), header.size(), 0)};
+        if (headerSize < 0)
+            return;
+
+        identity.magic = EntryMagic;
+        identity.version = EntryVersion;
+        identity.size = static_cast<u64>(fileStat.st_size);
+        identity.modificationTime = (static_cast<i64>(fileStat.st_mtim.tv_sec) * 1000000000) + fileStat.st_mtim.tv_nsec;
+        identity.headerHash = HashFnv(span(header).first(static_cast<size_t>(headerSize)));
+
+        try {
+            cache = std::make_shared<vfs::OsFileSystem>(appFilesPath + "/cache/metadata/");
+            path = fmt::format("{:016X}", HashFnv(span(reinterpret_cast<u8 *>(&identity), offsetof(EntryHeader, nameSize))));
+        } catch (const std::exception &) {
+            cache = nullptr;
+        }
+    }
+
+    std::optional<RomMetadata> MetadataCache::Load() {
+        if (path.empty())
+            return std::nullopt;
+
+        try {
+            if (!cache->FileExists(path))
+                return std::nullopt;
+
+            auto file{cache->OpenFile(path)};
+            auto header{file->Read<EntryHeader>()};
+            if (std::memcmp(&header, &identity, offsetof(EntryHeader, nameSize)) != 0 || file->size != sizeof(EntryHeader) + header.nameSize + header.publisherSize + header.iconSize)
+                return std::nullopt;
+
+            RomMetadata metadata{.hasNacp = header.hasNacp != 0};
+            size_t offset{sizeof(EntryHeader)};
+
+            metadata.applicationName.resize(header.nameSize);
+            file->Read(span(reinterpret_cast<u8 *>(metadata.applicationName.data()), header.nameSize), offset);
+            offset += header.nameSize;
+
+            metadata.applicationPublisher.resize(header.publisherSize);
+            file->Read(span(reinterpret_cast<u8 *>(metadata.applicationPublisher.data()), header.publisherSize), offset);
+            offset += header.publisherSize;
+
+            metadata.icon.resize(header.iconSize);
+            file->Read(metadata.icon, offset);
+
+            return metadata;
+        } catch (const std::exception &) {
+            return std::nullopt;
+        }
+    }
+
+    void MetadataCache::Save(const RomMetadata &metadata) {
+        if (path.empty())
+            return;
+
+        try {
+            auto header{identity};
+            header.nameSize = static_cast<u32>(metadata.applicationName.size());
+            header.publisherSize = static_cast<u32>(metadata.applicationPublisher.size());
+            header.iconSize = static_cast<u32>(metadata.icon.size());
+            header.hasNacp = metadata.hasNacp;
+
+            cache->CreateFile(path, sizeof(EntryHeader) + header.nameSize + header.publisherSize + header.iconSize);
+            auto file{cache->OpenFile(path, {false, true, false})};
+
+            size_t offset{sizeof(EntryHeader)};
+            file->Write(span(reinterpret_cast<u8 *>(const_cast<char *>(metadata.applicationName.data())), header.nameSize), offset);
+            offset += header.nameSize;
+            file->Write(span(reinterpret_cast<u8 *>(const_cast<char *>(metadata.applicationPublisher.data())), header.publisherSize), offset);
+            offset += header.publisherSize;
+            file->Write(span(const_cast<u8 *>(metadata.icon.data()), header.iconSize), offset);
+            file->Write(span(reinterpret_cast<u8 *>(&header), sizeof(EntryHeader))); // The header is written last so an interrupted write never results in a valid entry
+        } catch (const std::exception &) {
+            // The metadata will just be parsed again on the next scan
+        }
+    }
+}
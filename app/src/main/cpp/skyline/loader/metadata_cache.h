@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <vfs/os_filesystem.h>
+
+namespace skyline::loader {
+    /**
+     * @brief The metadata of a ROM which is displayed in the game list
+     */
+    struct RomMetadata {
+        bool hasNacp{}; //!< If the ROM has a NACP, none of the other fields are set if it doesn't
+        std::string applicationName;
+        std::string applicationPublisher;
+        std::vector<u8> icon; //!< The raw JPEG data of the icon
+    };
+
+    /**
+     * @brief An on-disk cache of the metadata of ROMs, so the game list doesn't need to construct a loader for every ROM on every scan
+     * @details Entries are keyed by the size and modification time of the file alongside a hash of its first few KB, a ROM that was replaced by a different one will always miss
+     */
+    class MetadataCache {
+      private:
+        /**
+         * @brief The header of an entry, it's followed by the name, the publisher and the icon
+         */
+        struct EntryHeader {
+            u32 magic; //!< The magic of the entry ("RMDC")
+            u32 version; //!< The version of the entry
+            u64 size; //!< The size of the ROM file
+            i64 modificationTime; //!< The modification time of the ROM file in nanoseconds
+            u64 headerHash; //!< A hash of the first HeaderHashSize bytes of the ROM file
+            u32 nameSize;
+            u32 publisherSize;
+            u32 iconSize;
+            u32 hasNacp;
+        };
+        static_assert(sizeof(EntryHeader) == 0x30);
+
+        static constexpr u32 EntryMagic{util::MakeMagic<u32>("RMDC")};
+        static constexpr u32 EntryVersion{1};
+        static constexpr size_t HeaderHashSize{0x1000}; //!< The amount of bytes at the start of a ROM file that are hashed, this covers the headers of every ROM format
+
+        std::shared_ptr<vfs::OsFileSystem> cache; //!< The directory containing all entries
+        EntryHeader identity{}; //!< The header of the entry for the ROM, only the fields identifying the ROM file are set
+        std::string path; //!< The path of the entry for the ROM in the cache, this is empty if the ROM file couldn't be identified
+
+      public:
+        /**
+         * @param fd The FD of the ROM file, its position in the file isn't modified
+         */
+        MetadataCache(int fd, const std::string &appFilesPath);
+
+        /**
+         * @return The metadata of the ROM if it's in the cache
+         */
+        std::optional<RomMetadata> Load();
+
+        /**
+         * @brief Writes the metadata of the ROM to the cache, any failures are ignored as the metadata can always be parsed again
+         */
+        void Save(const RomMetadata &metadata);
+    };
+}
@@ -8,40 +8,51 @@
 #include "nca.h"
 
 namespace skyline::loader {
-    NcaLoader::NcaLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore) : nca(backing, keyStore) {
-        if (nca.exeFs == nullptr)
+    NcaLoader::NcaLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool, bool verifyIntegrity) : nca(backing, keyStore, nullptr, threadPool, verifyIntegrity) {
+        if (!nca.GetExeFs())
             throw exception("Only NCAs with an ExeFS can be loaded directly");
+        titleId = nca.programId;
     }
 
-    void NcaLoader::LoadExeFs(const std::shared_ptr<vfs::FileSystem> &exeFs, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
+    u64 NcaLoader::LoadExeFs(const std::shared_ptr<vfs::FileSystem> &exeFs, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
         if (exeFs == nullptr)
             throw exception("Cannot load a null ExeFS");
 
-        auto nsoFile{exeFs->OpenFile("rtld")};
-        if (nsoFile == nullptr)
+        auto rtld{exeFs->OpenFile("rtld")};
+        if (rtld == nullptr)
             throw exception("Cannot load an ExeFS that doesn't contain rtld");
 
-        auto loadInfo{NsoLoader::LoadNso(nsoFile, process, state)};
-        u64 offset{loadInfo.size};
-        u64 base{loadInfo.base};
-
-        state.logger->Info("Loaded nso 'rtld' at 0x{:X}", base);
-
+        std::vector<std::string_view> names{"rtld"};
+        std::vector<std::shared_ptr<vfs::Backing>> nsoFiles{rtld};
         for (const auto &nso : {"main", "subsdk0", "subsdk1", "subsdk2", "subsdk3", "subsdk4", "subsdk5", "subsdk6", "subsdk7", "sdk"}) {
-            nsoFile = exeFs->OpenFile(nso);
+            auto nsoFile{exeFs->OpenFile(nso)};
 
             if (nsoFile == nullptr)
                 continue;
 
-            loadInfo = NsoLoader::LoadNso(nsoFile, process, state, offset);
-            state.logger->Info("Loaded nso '{}' at 0x{:X}", nso, base + offset);
-            offset += loadInfo.size;
+            names.emplace_back(nso);
+            nsoFiles.push_back(std::move(nsoFile));
+        }
+
+        auto loadInfos{NsoLoader::LoadNsos(nsoFiles, process, state)};
+        for (size_t index{}; index < loadInfos.size(); index++) {
+            state.logger->Info("Loaded nso '{}' at 0x{:X}", names[index], loadInfos[index].base);
+            if (state.nce->profiler)
+                state.nce->profiler->AddModule(names[index], loadInfos[index].base, loadInfos[index].size);
         }
 
+        u64 base{loadInfos.front().base};
+        u64 offset{(loadInfos.back().base + loadInfos.back().size) - base};
+
         state.os->memory.InitializeRegions(base, offset, memory::AddressSpaceType::AddressSpace39Bit);
+        return loadInfos.front().entry; // rtld is always loaded first and is responsible for starting all other executables
+    }
+
+    bool NcaLoader::VerifyIntegrity(const std::atomic_bool &cancel) {
+        return nca.VerifyIntegrity(cancel);
     }
 
-    void NcaLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
-        LoadExeFs(nca.exeFs, process, state);
+    u64 NcaLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
+        return LoadExeFs(nca.GetExeFs(), process, state);
     }
 }
@@ -16,15 +16,21 @@ namespace skyline::loader {
         vfs::NCA nca; //!< The backing NCA of the loader
 
       public:
-        NcaLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore);
+        /**
+         * @param threadPool The pool that blocks are verified on, this may be nullptr
+         * @param verifyIntegrity If the NCA should be verified against its hashes as it's read
+         */
+        NcaLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool = nullptr, bool verifyIntegrity = false);
 
         /**
          * @brief Loads an ExeFS into memory
          * @param exefs A filesystem object containing the ExeFS filesystem to load into memory
          * @param process The process to load the ExeFS into
          */
-        static void LoadExeFs(const std::shared_ptr<vfs::FileSystem> &exefs, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+        static u64 LoadExeFs(const std::shared_ptr<vfs::FileSystem> &exefs, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+
+        bool VerifyIntegrity(const std::atomic_bool &cancel);
 
-        void LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+        u64 LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
     };
 }
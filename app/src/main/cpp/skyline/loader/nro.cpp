@@ -38,28 +38,23 @@ namespace skyline::loader {
         return buffer;
     }
 
-    std::vector<u8> NroLoader::GetSegment(const NroSegmentHeader &segment) {
-        std::vector<u8> buffer(segment.size);
-
-        backing->Read(buffer, segment.offset);
-        return buffer;
-    }
-
-    void NroLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
-        Executable nroExecutable{};
-
-        nroExecutable.text.contents = GetSegment(header.text);
-        nroExecutable.text.offset = 0;
-
-        nroExecutable.ro.contents = GetSegment(header.ro);
-        nroExecutable.ro.offset = header.text.size;
-
-        nroExecutable.data.contents = GetSegment(header.data);
-        nroExecutable.data.offset = header.text.size + header.ro.size;
-
-        nroExecutable.bssSize = header.bssSize;
-
-        auto loadInfo{LoadExecutable(process, state, nroExecutable)};
+    u64 NroLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
+        Executable nroExecutable{
+            .text = {.offset = 0, .size = header.text.size},
+            .ro = {.offset = header.text.size, .size = header.ro.size},
+            .data = {.offset = header.text.size + header.ro.size, .size = header.data.size},
+            .bssSize = header.bssSize,
+        };
+
+        MapExecutable(process, state, nroExecutable);
+        backing->Read(nroExecutable.text.contents, header.text.offset);
+        backing->Read(nroExecutable.ro.contents, header.ro.offset);
+        backing->Read(nroExecutable.data.contents, header.data.offset);
+
+        auto loadInfo{FinalizeExecutable(process, state, nroExecutable)};
+        if (state.nce->profiler)
+            state.nce->profiler->AddModule("main", loadInfo.base, loadInfo.size);
         state.os->memory.InitializeRegions(loadInfo.base, loadInfo.size, memory::AddressSpaceType::AddressSpace39Bit);
+        return loadInfo.entry;
     }
 }
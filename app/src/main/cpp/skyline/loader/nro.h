@@ -60,18 +60,11 @@ namespace skyline::loader {
 
         std::shared_ptr<vfs::Backing> backing;
 
-        /**
-         * @brief Reads the data of the specified segment
-         * @param segment The header of the segment to read
-         * @return A buffer containing the data of the requested segment
-         */
-        std::vector<u8> GetSegment(const NroSegmentHeader &segment);
-
       public:
         NroLoader(const std::shared_ptr<vfs::Backing> &backing);
 
         std::vector<u8> GetIcon();
 
-        void LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+        u64 LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
     };
 }
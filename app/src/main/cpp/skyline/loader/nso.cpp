@@ -4,6 +4,8 @@
 #include <lz4.h>
 #include <nce.h>
 #include <os.h>
+#include <thread_pool.h>
+#include <statistics.h>
 #include <kernel/memory.h>
 #include "nso.h"
 
@@ -15,49 +17,78 @@ namespace skyline::loader {
             throw exception("Invalid NSO magic! 0x{0:X}", magic);
     }
 
-    std::vector<u8> NsoLoader::GetSegment(const std::shared_ptr<vfs::Backing> &backing, const NsoSegmentHeader &segment, u32 compressedSize) {
-        std::vector<u8> outputBuffer(segment.decompressedSize);
-
+    void NsoLoader::GetSegment(const std::shared_ptr<vfs::Backing> &backing, const NsoSegmentHeader &segment, u32 compressedSize, span<u8> output) {
         if (compressedSize) {
-            std::vector<u8> compressedBuffer(compressedSize);
-            backing->Read(compressedBuffer, segment.fileOffset);
-
-            LZ4_decompress_safe(reinterpret_cast<char *>(compressedBuffer.data()), reinterpret_cast<char *>(outputBuffer.data()), compressedSize, segment.decompressedSize);
+            // The compressed data is decompressed directly from the backing when it can be mapped, it only needs to be read into a buffer otherwise
+            std::vector<u8> compressedBuffer;
+            auto compressedData{backing->Map(segment.fileOffset, compressedSize)};
+            if (compressedData.empty()) {
+                compressedBuffer.resize(compressedSize);
+                backing->Read(compressedBuffer, segment.fileOffset);
+                compressedData = compressedBuffer;
+            }
+
+            auto decompressedSize{LZ4_decompress_safe(reinterpret_cast<char *>(compressedData.data()), reinterpret_cast<char *>(output.data()), compressedSize, segment.decompressedSize)};
+            if (decompressedSize != segment.decompressedSize)
+                throw exception("Failed to decompress NSO segment at 0x{:X}: {} (Expected: 0x{:X})", segment.fileOffset, decompressedSize, segment.decompressedSize);
         } else {
-            backing->Read(outputBuffer, segment.fileOffset);
+            backing->Read(output.first(segment.decompressedSize), segment.fileOffset);
         }
-
-        return outputBuffer;
     }
 
     Loader::ExecutableLoadInfo NsoLoader::LoadNso(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, size_t offset) {
-        auto header{backing->Read<NsoHeader>()};
-
-        if (header.magic != util::MakeMagic<u32>("NSO0"))
-            throw exception("Invalid NSO magic! 0x{0:X}", header.magic);
-
-        Executable nsoExecutable{};
-
-        nsoExecutable.text.contents = GetSegment(backing, header.text, header.flags.textCompressed ? header.textCompressedSize : 0);
-        nsoExecutable.text.contents.resize(util::AlignUp(nsoExecutable.text.contents.size(), PAGE_SIZE));
-        nsoExecutable.text.offset = header.text.memoryOffset;
-
-        nsoExecutable.ro.contents = GetSegment(backing, header.ro, header.flags.textCompressed ? header.textCompressedSize : 0);
-        nsoExecutable.ro.contents.resize(util::AlignUp(nsoExecutable.ro.contents.size(), PAGE_SIZE));
-        nsoExecutable.ro.offset = header.ro.memoryOffset;
-
-        nsoExecutable.data.contents = GetSegment(backing, header.data, header.flags.textCompressed ? header.textCompressedSize : 0);
-        nsoExecutable.data.contents.resize(util::AlignUp(nsoExecutable.data.contents.size(), PAGE_SIZE));
-        nsoExecutable.data.offset = header.data.memoryOffset;
+        return LoadNsos(span(&backing, 1), process, state, offset).front();
+    }
 
-        nsoExecutable.bssSize = util::AlignUp(header.bssSize, PAGE_SIZE);
+    std::vector<Loader::ExecutableLoadInfo> NsoLoader::LoadNsos(span<const std::shared_ptr<vfs::Backing>> backings, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, size_t offset) {
+        std::vector<ExecutableLoadInfo> loadInfos;
+        loadInfos.reserve(backings.size());
+
+        for (const auto &backing : backings) {
+            auto header{backing->Read<NsoHeader>()};
+
+            if (header.magic != util::MakeMagic<u32>("NSO0"))
+                throw exception("Invalid NSO magic! 0x{0:X}", header.magic);
+
+            Executable executable{
+                .text = {.offset = header.text.memoryOffset, .size = util::AlignUp(header.text.decompressedSize, PAGE_SIZE)},
+                .ro = {.offset = header.ro.memoryOffset, .size = util::AlignUp(header.ro.decompressedSize, PAGE_SIZE)},
+                .data = {.offset = header.data.memoryOffset, .size = util::AlignUp(header.data.decompressedSize, PAGE_SIZE)},
+                .bssSize = util::AlignUp(header.bssSize, PAGE_SIZE),
+            };
+
+            // The segments are decompressed directly into guest memory, so an NSO can only be mapped once the size of the .patch section of the one before it is known
+            MapExecutable(process, state, executable, offset);
+
+            std::array<std::tuple<const NsoSegmentHeader &, u32, span<u8>>, 3> segments{{
+                {header.text, header.flags.textCompressed ? header.textCompressedSize : 0, executable.text.contents},
+                {header.ro, header.flags.roCompressed ? header.roCompressedSize : 0, executable.ro.contents},
+                {header.data, header.flags.dataCompressed ? header.dataCompressedSize : 0, executable.data.contents},
+            }};
+
+            // Decompression is entirely independent between segments, patching the code happens afterwards
+            {
+                BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::Decompression);
+                state.threadPool->ParallelFor(segments.size(), [&](size_t index) {
+                    auto &[segmentHeader, compressedSize, contents]{segments[index]};
+                    GetSegment(backing, segmentHeader, compressedSize, contents);
+                });
+            }
+
+            auto loadInfo{FinalizeExecutable(process, state, executable)};
+            offset += loadInfo.size;
+            loadInfos.push_back(loadInfo);
+        }
 
-        return LoadExecutable(process, state, nsoExecutable, offset);
+        return loadInfos;
     }
 
-    void NsoLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
+    u64 NsoLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
         auto loadInfo{LoadNso(backing, process, state)};
+        if (state.nce->profiler)
+            state.nce->profiler->AddModule("main", loadInfo.base, loadInfo.size);
 
         state.os->memory.InitializeRegions(loadInfo.base, loadInfo.size, memory::AddressSpaceType::AddressSpace39Bit);
+        return loadInfo.entry;
     }
 }
@@ -67,9 +67,9 @@ namespace skyline::loader {
          * @brief Reads the specified segment from the backing and decompresses it if needed
          * @param segment The header of the segment to read
          * @param compressedSize The compressed size of the segment, 0 if the segment is not compressed
-         * @return A buffer containing the data of the requested segment
+         * @param output The buffer to write the data of the segment into, this must be the decompressed size of the segment
          */
-        static std::vector<u8> GetSegment(const std::shared_ptr<vfs::Backing> &backing, const NsoSegmentHeader &segment, u32 compressedSize);
+        static void GetSegment(const std::shared_ptr<vfs::Backing> &backing, const NsoSegmentHeader &segment, u32 compressedSize, span<u8> output);
 
       public:
         NsoLoader(const std::shared_ptr<vfs::Backing> &backing);
@@ -83,6 +83,15 @@ namespace skyline::loader {
          */
         static ExecutableLoadInfo LoadNso(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, size_t offset = 0);
 
-        void LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+        /**
+         * @brief Loads multiple NSOs into memory back to back, the segments of every NSO are decompressed in parallel directly into guest memory
+         * @param backings The backings of the NSOs in the order they should be placed in memory
+         * @param process The process to load the NSOs into
+         * @param offset The offset from the base address to place the first NSO at
+         * @return An ExecutableLoadInfo struct for every NSO containing its load base and size
+         */
+        static std::vector<ExecutableLoadInfo> LoadNsos(span<const std::shared_ptr<vfs::Backing>> backings, const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state, size_t offset = 0);
+
+        u64 LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
     };
 }
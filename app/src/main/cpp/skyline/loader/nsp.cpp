@@ -1,23 +1,29 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <vfs/ncz_backing.h>
 #include "nca.h"
 #include "nsp.h"
 
 namespace skyline::loader {
-    NspLoader::NspLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore) : nsp(std::make_shared<vfs::PartitionFileSystem>(backing)) {
+    NspLoader::NspLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool, bool verifyIntegrity) : nsp(std::make_shared<vfs::PartitionFileSystem>(backing)) {
         auto root{nsp->OpenDirectory("", {false, true})};
 
         for (const auto &entry : root->Read()) {
-            if (entry.name.substr(entry.name.find_last_of(".") + 1) != "nca")
+            auto extension{entry.name.substr(entry.name.find_last_of(".") + 1)};
+            if (extension != "nca" && extension != "ncz")
                 continue;
 
             try {
-                auto nca{vfs::NCA(nsp->OpenFile(entry.name), keyStore)};
+                std::shared_ptr<vfs::Backing> ncaBacking{nsp->OpenFile(entry.name)};
+                if (extension == "ncz")
+                    ncaBacking = std::make_shared<vfs::NczBacking>(ncaBacking, threadPool);
+                auto nca{vfs::NCA(ncaBacking, keyStore, nullptr, threadPool, verifyIntegrity)};
 
-                if (nca.contentType == vfs::NcaContentType::Program && nca.romFs != nullptr && nca.exeFs != nullptr)
+                // Only the headers of the NCAs are read here, their sections are decrypted when they're first accessed
+                if (nca.contentType == vfs::NcaContentType::Program && nca.HasRomFs())
                     programNca = std::move(nca);
-                else if (nca.contentType == vfs::NcaContentType::Control && nca.romFs != nullptr)
+                else if (nca.contentType == vfs::NcaContentType::Control && nca.HasRomFs())
                     controlNca = std::move(nca);
             } catch (const loader_exception &e) {
                 throw loader_exception(e.error);
@@ -29,13 +35,22 @@ namespace skyline::loader {
         if (!programNca || !controlNca)
             throw exception("Incomplete NSP file");
 
-        romFs = programNca->romFs;
-        controlRomFs = std::make_shared<vfs::RomFileSystem>(controlNca->romFs);
+        // Only the PFS0 header of the ExeFS is read for this, its files are decrypted when they're loaded
+        if (!programNca->GetExeFs())
+            throw exception("The program NCA of the NSP doesn't have an ExeFS");
+
+        romFs = programNca->GetRomFs();
+        titleId = programNca->programId;
+        controlRomFs = std::make_shared<vfs::RomFileSystem>(controlNca->GetRomFs());
         nacp = std::make_shared<vfs::NACP>(controlRomFs->OpenFile("control.nacp"));
     }
 
-    void NspLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
-        NcaLoader::LoadExeFs(programNca->exeFs, process, state);
+    bool NspLoader::VerifyIntegrity(const std::atomic_bool &cancel) {
+        return programNca->VerifyIntegrity(cancel) && controlNca->VerifyIntegrity(cancel);
+    }
+
+    u64 NspLoader::LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state) {
+        return NcaLoader::LoadExeFs(programNca->GetExeFs(), process, state);
     }
 
     std::vector<u8> NspLoader::GetIcon() {
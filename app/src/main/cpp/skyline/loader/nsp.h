@@ -12,6 +12,7 @@
 namespace skyline::loader {
     /**
      * @brief The NspLoader class consolidates all the data in an NSP providing a simple way to load an application and access its metadata
+     * @note NSZs are NSPs with NCZs in place of NCAs, these are loaded by the same loader
      * @url https://switchbrew.org/wiki/NCA_Format#PFS0
      */
     class NspLoader : public Loader {
@@ -22,10 +23,16 @@ namespace skyline::loader {
         std::optional<vfs::NCA> controlNca; //!< The main control NCA within the NSP
 
       public:
-        NspLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore);
+        /**
+         * @param threadPool The pool that compressed NCZs are decompressed and blocks are verified on, this may be nullptr when only metadata is read
+         * @param verifyIntegrity If the NCAs should be verified against their hashes as they're read
+         */
+        NspLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool = nullptr, bool verifyIntegrity = false);
 
         std::vector<u8> GetIcon();
 
-        void LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
+        bool VerifyIntegrity(const std::atomic_bool &cancel);
+
+        u64 LoadProcessData(const std::shared_ptr<kernel::type::KProcess> process, const DeviceState &state);
     };
 }
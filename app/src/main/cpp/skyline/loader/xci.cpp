@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <vfs/region_backing.h>
+#include "xci.h"
+
+namespace skyline::loader {
+    /**
+     * @brief The header of a gamecard image, this is preceded by its RSA-2048 signature
+     */
+    struct XciHeader {
+        u32 magic; //!< "HEAD"
+        u32 secureAreaStart; //!< The start of the secure area in units of 0x200 bytes
+        u32 backupAreaStart;
+        u8 titleKeyIndex;
+        u8 gameCardSize;
+        u8 headerVersion;
+        u8 flags;
+        u64 packageId;
+        u64 validDataEnd;
+        std::array<u8, 0x10> iv; //!< The IV of the encrypted gamecard info
+        u64 rootPartitionOffset; //!< The offset of the root HFS0 partition from the start of the image
+        u64 rootPartitionHeaderSize;
+        std::array<u8, 0x20> rootPartitionHeaderHash;
+        std::array<u8, 0x20> initialDataHash;
+        u32 selSec;
+        u32 selT1Key;
+        u32 selKey;
+        u32 limitAreaPage;
+        std::array<u8, 0x70> encryptedGameCardInfo;
+    };
+    static_assert(sizeof(XciHeader) == 0x100);
+
+    std::shared_ptr<vfs::Backing> XciLoader::OpenSecurePartition(const std::shared_ptr<vfs::Backing> &backing) {
+        constexpr size_t HeaderOffset{0x100}; // The offset of the header after the signature
+        constexpr size_t KeyAreaSize{0x1000}; // The size of the key area which some dumps have in front of the image
+
+        size_t imageOffset{};
+        auto header{backing->Read<XciHeader>(HeaderOffset)};
+        if (header.magic != util::MakeMagic<u32>("HEAD")) {
+            imageOffset = KeyAreaSize;
+            header = backing->Read<XciHeader>(imageOffset + HeaderOffset);
+            if (header.magic != util::MakeMagic<u32>("HEAD"))
+                throw exception("Invalid XCI magic: 0x{:X}", header.magic);
+        }
+
+        size_t rootOffset{imageOffset + header.rootPartitionOffset};
+        if (rootOffset >= backing->size)
+            throw exception("XCI root partition is outside the image: 0x{:X}/0x{:X}", rootOffset, backing->size);
+
+        // The root partition only contains the other partitions, the secure partition is a file in it that's parsed as a partition itself
+        vfs::PartitionFileSystem root(std::make_shared<vfs::RegionBacking>(backing, rootOffset, backing->size - rootOffset));
+        auto secure{root.OpenFile("secure")};
+        if (!secure)
+            throw exception("XCI doesn't contain a secure partition");
+        return secure;
+    }
+
+    XciLoader::XciLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool, bool verifyIntegrity) : NspLoader(OpenSecurePartition(backing), keyStore, threadPool, verifyIntegrity) {}
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include "nsp.h"
+
+namespace skyline::loader {
+    /**
+     * @brief The XciLoader class loads a gamecard image from the NCAs in its secure partition, these are read in place from the image
+     * @note XCZs are XCIs with NCZs in place of NCAs, these are loaded by the same loader
+     * @url https://switchbrew.org/wiki/XCI
+     */
+    class XciLoader : public NspLoader {
+      private:
+        /**
+         * @return The backing of the secure HFS0 partition of the supplied gamecard image
+         */
+        static std::shared_ptr<vfs::Backing> OpenSecurePartition(const std::shared_ptr<vfs::Backing> &backing);
+
+      public:
+        /**
+         * @param threadPool The pool that compressed NCZs are decompressed and blocks are verified on, this may be nullptr when only metadata is read
+         * @param verifyIntegrity If the NCAs should be verified against their hashes as they're read
+         */
+        XciLoader(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<ThreadPool> &threadPool = nullptr, bool verifyIntegrity = false);
+    };
+}
@@ -2,64 +2,173 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <sched.h>
+#include <csignal>
+#include <ctime>
+#include <optional>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <asm/unistd.h>
 #include "os.h"
 #include "gpu.h"
 #include "jvm.h"
+#include "statistics.h"
+#include "allocation.h"
 #include "kernel/types/KProcess.h"
 #include "kernel/svc.h"
 #include "nce/guest.h"
 #include "nce/instructions.h"
+#include "trace.h"
+#include "control_block.h"
 #include "nce.h"
 
-extern bool Halt;
+extern std::atomic<bool> Halt;
 extern jobject Surface;
+extern std::mutex SurfaceMutex;
+extern std::condition_variable SurfaceCondition;
 extern skyline::GroupMutex JniMtx;
+extern skyline::ControlBlock Control;
 
 namespace skyline {
+    /**
+     * @brief Blocks the calling thread while there's no surface to present to, this is the case while the app is in the background
+     * @note The thread is woken up as soon as the surface is restored, it returns after a timeout regardless so Halt is checked as it isn't always signalled
+     */
+    static void WaitForSurface() {
+        constexpr std::chrono::milliseconds PauseTimeout{1000}; // The maximum duration to block for prior to returning, this bounds how long exiting takes while paused
+        std::unique_lock lock(SurfaceMutex);
+        SurfaceCondition.wait_for(lock, PauseTimeout, [] { return Surface || Halt; });
+    }
+
+    /**
+     * @brief Spins and then sleeps on the state of the supplied context till it satisfies the predicate
+     * @param timeout The maximum duration to sleep for before returning regardless of the predicate
+     * @return The state which satisfied the predicate or std::nullopt if the timeout elapsed prior to that
+     * @note The state is loaded with acquire semantics, so any writes to the context by the guest prior to changing it are visible after this returns
+     */
+    template<typename Predicate>
+    std::optional<ThreadState> WaitState(ThreadContext *ctx, Predicate predicate, const timespec *timeout = nullptr) {
+        for (u32 spins{}; true; spins++) {
+            auto threadState{ctx->state.load(std::memory_order_acquire)};
+            if (predicate(threadState))
+                return threadState;
+
+            if (spins < constant::StateSpinCount) {
+                asm volatile("yield");
+            } else {
+                FutexWait(ctx->state, threadState, timeout);
+                if (timeout) {
+                    threadState = ctx->state.load(std::memory_order_acquire);
+                    if (predicate(threadState))
+                        return threadState;
+                    return std::nullopt;
+                }
+            }
+        }
+    }
+
+    bool NCE::ServiceThread(ThreadState threadState, SvcStatistics &statistics) {
+        if (__predict_false(threadState == ThreadState::GuestCrash)) {
+            state.logger->Warn("Thread with PID {} has crashed due to signal: {}", state.thread->tid, strsignal(state.ctx->signal));
+            ThreadTrace();
+
+            SetState(state.ctx, ThreadState::WaitRun);
+            return false;
+        }
+
+        // SVCs don't touch any JNI state, so they're run without JniMtx which only needs to be held exclusively while the surface or halt state is changed
+        auto svc{state.ctx->svc};
+
+        try {
+            if (kernel::svc::SvcTable[svc]) {
+                state.logger->DebugCompact("SVC called 0x{:X}", svc);
+                TRACE_SCOPE("SVC");
+                if (__predict_false(!firstSvcMarked.load(std::memory_order_relaxed)) && !firstSvcMarked.exchange(true, std::memory_order_relaxed))
+                    state.statistics->boot.Mark(BootPhase::FirstSvc);
+
+                std::optional<allocation::Scope> allocationScope;
+                if (__predict_false(allocation::IsEnabled()))
+                    allocationScope.emplace(allocation::Tag::Svc);
+
+                if (svcProfiling) {
+                    auto start{util::GetTimeNs()};
+                    (*kernel::svc::SvcTable[svc])(state);
+                    statistics.Record(svc, util::GetTimeNs() - start);
+                } else {
+                    (*kernel::svc::SvcTable[svc])(state);
+                }
+            } else {
+                throw exception("Unimplemented SVC 0x{:X}", svc);
+            }
+        } catch (const std::exception &e) {
+            throw exception("{} (SVC: 0x{:X})", e.what(), svc);
+        }
+
+        SetState(state.ctx, ThreadState::WaitRun);
+
+        return state.thread->status != kernel::type::KThread::Status::Dead; // The thread has exited (svcExitThread) and its guest thread is being terminated
+    }
+
+    void NCE::ExitThread(pid_t thread) {
+        if (!Halt) {
+            if (thread == state.process->pid) {
+                JniMtx.lock(GroupMutex::Group::Group2);
+
+                state.os->KillThread(thread);
+                Halt = true;
+
+                JniMtx.unlock();
+            } else {
+                state.os->KillThread(thread);
+            }
+        }
+
+        if (!Halt && thread != state.process->pid) {
+            // The kernel clears exitTid and wakes any waiters on it once the guest thread has exited (CLONE_CHILD_CLEARTID), only then can its TLS and context be reused
+            constexpr timespec ExitTimeout{.tv_nsec = 100000000}; // The maximum duration to sleep on exitTid for prior to checking Halt (100ms)
+            u32 exitTid;
+            while ((exitTid = __atomic_load_n(&state.ctx->exitTid, __ATOMIC_ACQUIRE)) && !Halt)
+                syscall(__NR_futex, &state.ctx->exitTid, FUTEX_WAIT, exitTid, &ExitTimeout);
+
+            if (!exitTid)
+                state.process->RecycleThread(state.thread);
+        }
+    }
+
     void NCE::KernelThread(pid_t thread) {
         state.jvm->AttachThread();
         try {
             state.thread = state.process->threads.at(thread);
             state.ctx = reinterpret_cast<ThreadContext *>(state.thread->ctxMemory->kernel.address);
 
-            while (true) {
-                asm("yield");
+            auto statistics{std::make_shared<SvcStatistics>()};
+            {
+                std::lock_guard guard(statisticsMutex);
+                svcStatistics.push_back(statistics);
+            }
 
+            constexpr timespec WaitTimeout{.tv_nsec = 100000000}; // The maximum duration to sleep on the context for prior to checking Halt and Surface (100ms)
+            u32 profileIndex{__atomic_load_n(&state.ctx->profileSampleIndex, __ATOMIC_ACQUIRE)}; // Contexts are reused by new threads, so any samples of a prior thread are skipped
+
+            while (true) {
                 if (__predict_false(Halt))
                     break;
-                if (__predict_false(!Surface))
-                    continue;
 
-                if (state.ctx->state == ThreadState::WaitKernel) {
-                    std::lock_guard jniGd(JniMtx);
-
-                    if (__predict_false(Halt))
-                        break;
-                    if (__predict_false(!Surface))
-                        continue;
-
-                    auto svc{state.ctx->svc};
-
-                    try {
-                        if (kernel::svc::SvcTable[svc]) {
-                            state.logger->Debug("SVC called 0x{:X}", svc);
-                            (*kernel::svc::SvcTable[svc])(state);
-                        } else {
-                            throw exception("Unimplemented SVC 0x{:X}", svc);
-                        }
-                    } catch (const std::exception &e) {
-                        throw exception("{} (SVC: 0x{:X})", e.what(), svc);
-                    }
+                // The ring buffer holds more samples than are taken during a single timeout, so collecting them on every wakeup doesn't drop any
+                if (profiler)
+                    profiler->Collect(state.ctx, profileIndex);
+
+                if (__predict_false(!Surface && !state.benchmark)) {
+                    // Guest threads park themselves at their next SVC as they wait for it to be serviced
+                    WaitForSurface();
+                    continue;
+                }
 
-                    state.ctx->state = ThreadState::WaitRun;
-                } else if (__predict_false(state.ctx->state == ThreadState::GuestCrash)) {
-                    state.logger->Warn("Thread with PID {} has crashed due to signal: {}", thread, strsignal(state.ctx->svc));
-                    ThreadTrace();
+                auto threadState{WaitState(state.ctx, [](ThreadState threadState) { return threadState == ThreadState::WaitKernel || threadState == ThreadState::GuestCrash; }, &WaitTimeout)};
+                if (!threadState)
+                    continue;
 
-                    state.ctx->state = ThreadState::WaitRun;
+                if (!ServiceThread(*threadState, *statistics))
                     break;
-                }
             }
         } catch (const std::exception &e) {
             state.logger->Error(e.what());
@@ -67,32 +176,195 @@ namespace skyline {
             state.logger->Error("An unknown exception has occurred");
         }
 
-        if (!Halt) {
-            if (thread == state.process->pid) {
-                JniMtx.lock(GroupMutex::Group::Group2);
+        ExitThread(thread);
+        state.jvm->DetachThread();
+    }
 
-                state.os->KillThread(thread);
-                Halt = true;
+    void NCE::KernelWorker() {
+        pthread_setname_np(pthread_self(), "Sky-Kernel");
+        state.jvm->AttachThread();
 
-                JniMtx.unlock();
-            } else {
-                state.os->KillThread(thread);
+        auto statistics{std::make_shared<SvcStatistics>()};
+        {
+            std::lock_guard guard(statisticsMutex);
+            svcStatistics.push_back(statistics);
+        }
+
+        constexpr timespec WaitTimeout{.tv_nsec = 100000000}; // The maximum duration to sleep on the doorbell for prior to checking Halt and Surface (100ms)
+        size_t cursor{};
+        while (!Halt && !kernelWorkersStopped.load(std::memory_order_relaxed)) {
+            if (__predict_false(!Surface && !state.benchmark)) {
+                WaitForSurface();
+                continue;
+            }
+
+            // The doorbell is loaded prior to looking for work, so a thread which rings it after the slots were checked prevents the worker from sleeping
+            auto ring{doorbell->load(std::memory_order_acquire)};
+            if (ServiceKernelSlot(cursor, *statistics))
+                continue;
+
+            if (syscall(__NR_futex, doorbell, FUTEX_WAIT, ring, &WaitTimeout) == -1 && errno == ETIMEDOUT && profiler) {
+                // Samples are only collected while the pool is idle, the ring buffers hold more samples than are taken during a single timeout
+                auto count{kernelSlotCount.load(std::memory_order_acquire)};
+                for (size_t index{}; index < count; index++) {
+                    auto &slot{kernelSlots[index]};
+                    auto ctx{slot.ctx.load(std::memory_order_acquire)};
+                    if (ctx && !slot.claimed.exchange(true, std::memory_order_acquire)) {
+                        if (slot.ctx.load(std::memory_order_relaxed) == ctx)
+                            profiler->Collect(ctx, slot.profileIndex);
+                        slot.claimed.store(false, std::memory_order_release);
+                    }
+                }
             }
         }
 
         state.jvm->DetachThread();
     }
 
-    NCE::NCE(DeviceState &state) : state(state) {}
+    bool NCE::ServiceKernelSlot(size_t &cursor, SvcStatistics &statistics) {
+        auto isPending{[](ThreadState threadState) { return threadState == ThreadState::WaitKernel || threadState == ThreadState::GuestCrash; }};
+
+        auto count{kernelSlotCount.load(std::memory_order_acquire)};
+        for (size_t offset{}; offset < count; offset++) {
+            auto index{(cursor + offset) % count};
+            auto &slot{kernelSlots[index]};
+            auto ctx{slot.ctx.load(std::memory_order_acquire)};
+            if (!ctx || !isPending(ctx->state.load(std::memory_order_acquire)) || slot.claimed.exchange(true, std::memory_order_acquire))
+                continue;
+
+            // The slot might have been serviced and released or reassigned between checking it and claiming it
+            auto threadState{ctx->state.load(std::memory_order_acquire)};
+            if (slot.ctx.load(std::memory_order_relaxed) != ctx || !isPending(threadState)) {
+                slot.claimed.store(false, std::memory_order_release);
+                continue;
+            }
+            cursor = index + 1;
+
+            if (idleWorkers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                SpawnKernelWorker();
+
+            state.thread = slot.thread;
+            state.ctx = ctx;
+            bool alive{};
+            try {
+                alive = ServiceThread(threadState, statistics);
+            } catch (const std::exception &e) {
+                state.logger->Error(e.what());
+            } catch (...) {
+                state.logger->Error("An unknown exception has occurred");
+            }
+
+            if (!alive) {
+                slot.ctx.store(nullptr, std::memory_order_relaxed);
+                ExitThread(state.thread->tid);
+
+                std::lock_guard guard(kernelSlotMutex);
+                slot.thread = nullptr;
+            }
+
+            state.thread = nullptr;
+            state.ctx = nullptr;
+            idleWorkers.fetch_add(1, std::memory_order_release);
+            slot.claimed.store(false, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+    void NCE::SpawnKernelWorker() {
+        std::lock_guard guard(kernelWorkerMutex);
+        if (kernelWorkersStopped.load(std::memory_order_relaxed) || kernelWorkers.size() >= KernelSlotCount)
+            return;
+
+        idleWorkers.fetch_add(1, std::memory_order_relaxed);
+        kernelWorkers.emplace_back(&NCE::KernelWorker, this);
+    }
+
+    void NCE::StopKernelWorkers(bool wake) {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard guard(kernelWorkerMutex);
+            kernelWorkersStopped.store(true, std::memory_order_relaxed);
+            workers.swap(kernelWorkers);
+        }
+        if (workers.empty())
+            return;
+
+        // The workers are joined without holding the lock as a worker which is still servicing an SVC might try to spawn another one
+        if (wake && doorbell) {
+            doorbell->fetch_add(1, std::memory_order_release);
+            syscall(__NR_futex, doorbell, FUTEX_WAKE, INT32_MAX);
+        }
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    bool NCE::AddKernelSlot(const std::shared_ptr<kernel::type::KThread> &thread, ThreadContext *ctx) {
+        std::call_once(kernelPoolFlag, [this] {
+            auto &memory{state.process->doorbellMemory};
+            memory = std::make_shared<kernel::type::KSharedMemory>(state, 0, PAGE_SIZE, kernel::memory::Permission{true, true, false}, kernel::memory::states::Reserved);
+            memory->Map(0, PAGE_SIZE, kernel::memory::Permission{true, true, false});
+            doorbell = reinterpret_cast<std::atomic<u32> *>(memory->kernel.address);
+            guestDoorbell = memory->guest.address;
+
+            auto workerCount{std::max(std::thread::hardware_concurrency(), 2U)};
+            state.logger->Info("Servicing SVCs with a pool of {} kernel workers", workerCount);
+            for (u32 worker{}; worker < workerCount; worker++)
+                SpawnKernelWorker();
+        });
+
+        std::lock_guard guard(kernelSlotMutex);
+        auto count{kernelSlotCount.load(std::memory_order_relaxed)};
+        auto slot{std::find_if(kernelSlots.begin(), kernelSlots.begin() + count, [](const KernelSlot &slot) { return !slot.thread; })};
+        if (slot == kernelSlots.begin() + count) {
+            if (count == KernelSlotCount)
+                return false;
+            kernelSlotCount.store(count + 1, std::memory_order_release);
+        }
+
+        slot->thread = thread;
+        slot->profileIndex = __atomic_load_n(&ctx->profileSampleIndex, __ATOMIC_ACQUIRE);
+        ctx->svcDoorbell = reinterpret_cast<std::atomic<u32> *>(guestDoorbell);
+        slot->ctx.store(ctx, std::memory_order_release);
+        return true;
+    }
+
+    void NCE::Pause() {
+        // Guest threads which don't call SVCs would keep running without a surface, so the entire guest process is stopped till it's restored
+        state.logger->Info("Pausing emulation as the surface has been lost");
+        kill(state.process->pid, SIGSTOP);
+        Control.runState = RunState::Paused;
+
+        while (!Surface && !Halt)
+            WaitForSurface();
+
+        Control.runState = RunState::Running;
+
+        // The guest is resumed even when halting as tearing down the process requires running functions on guest threads
+        kill(state.process->pid, SIGCONT);
+        state.logger->Info("Resuming emulation");
+    }
+
+    NCE::NCE(DeviceState &state) : state(state), kernelPool(state.settings->GetBool("svc_worker_pool", false)), svcHistory(state.settings->GetBool("svc_history", false)), svcProfiling(state.settings->GetBool("perf_stats", false)), profiler(state.settings->GetBool("guest_profiler", false) ? std::make_unique<GuestProfiler>() : nullptr) {}
 
     NCE::~NCE() {
         for (auto &thread : threadMap)
             thread.second->join();
+
+        StopKernelWorkers(false);
     }
 
     void NCE::Execute() {
+        state.os->affinity.SetHostAffinity(kernel::AffinityManager::HostThread::Gpu);
+        state.os->performanceHint.SetThread(kernel::PerformanceHintManager::HintThread::Gpu, gettid());
+        allocation::Scope allocationScope(allocation::Tag::Presentation);
+
         try {
             while (true) {
+                if (__predict_false(!Surface && !Halt && !state.benchmark))
+                    Pause();
+
                 std::lock_guard guard(JniMtx);
                 if (Halt)
                     break;
@@ -109,34 +381,62 @@ namespace skyline {
             Halt = true;
             JniMtx.unlock();
         }
+
+        StopKernelWorkers(true); // The workers are joined while the process is still alive, as the doorbell they sleep on is unmapped along with it
     }
 
     /**
-     * This function will not work if optimizations are enabled as ThreadContext isn't volatile
-     * and due to that is not read on every iteration of the while loop.
-     * However, making ThreadContext or parts of it volatile slows down the applications as a whole.
-     * So, we opted to use the hacky solution and disable optimizations for this single function.
+     * @note The registers are synchronized with the guest through the acquire/release ordering on ThreadContext::state
      */
-    void ExecuteFunctionCtx(ThreadCall call, Registers &funcRegs, ThreadContext *ctx) __attribute__ ((optnone)) {
+    void ExecuteFunctionCtx(ThreadCall call, Registers &funcRegs, ThreadContext *ctx) {
         ctx->threadCall = call;
         Registers registers{ctx->registers};
 
-        while (ctx->state != ThreadState::WaitInit && ctx->state != ThreadState::WaitKernel);
+        auto isWaiting{[](ThreadState threadState) { return threadState == ThreadState::WaitInit || threadState == ThreadState::WaitKernel; }};
+        WaitState(ctx, isWaiting);
 
         ctx->registers = funcRegs;
-        ctx->state = ThreadState::WaitFunc;
+        SetState(ctx, ThreadState::WaitFunc);
 
-        while (ctx->state != ThreadState::WaitInit && ctx->state != ThreadState::WaitKernel);
+        WaitState(ctx, isWaiting);
 
         funcRegs = ctx->registers;
         ctx->registers = registers;
     }
 
+    /**
+     * @brief Executes a function on the calling thread rather than a guest thread, this is equivalent when the guest shares our address space as long as the function doesn't have to create a guest thread
+     * @note Unmapping guest memory replaces it with a reservation instead, so the carve-out of the guest stays reserved
+     */
+    static void ExecuteFunctionLocal(ThreadCall call, Registers &funcRegs, const kernel::MemoryManager &memory) {
+        if (call == ThreadCall::Syscall) {
+            if (funcRegs.x8 == __NR_munmap && memory.InSharedAddressSpace(funcRegs.x0, funcRegs.x1)) {
+                auto result{mmap(reinterpret_cast<void *>(funcRegs.x0), funcRegs.x1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0)};
+                funcRegs.x0 = (result == MAP_FAILED) ? static_cast<u64>(-errno) : 0;
+                return;
+            }
+
+            // The raw return value of the syscall is expected, so errors are returned as the negated errno
+            auto result{syscall(static_cast<long>(funcRegs.x8), funcRegs.x0, funcRegs.x1, funcRegs.x2, funcRegs.x3, funcRegs.x4, funcRegs.x5)};
+            funcRegs.x0 = (result == -1) ? static_cast<u64>(-errno) : static_cast<u64>(result);
+        } else if (call == ThreadCall::Memcopy) {
+            std::memmove(reinterpret_cast<void *>(funcRegs.x1), reinterpret_cast<const void *>(funcRegs.x0), funcRegs.x2);
+        } else {
+            throw exception("Cannot execute function locally: {}", static_cast<u8>(call));
+        }
+    }
+
     void NCE::ExecuteFunction(ThreadCall call, Registers &funcRegs, std::shared_ptr<kernel::type::KThread> &thread) {
+        if (call != ThreadCall::Clone && state.os->memory.IsSharedAddressSpace())
+            return ExecuteFunctionLocal(call, funcRegs, state.os->memory);
+
         ExecuteFunctionCtx(call, funcRegs, reinterpret_cast<ThreadContext *>(thread->ctxMemory->kernel.address));
     }
 
     void NCE::ExecuteFunction(ThreadCall call, Registers &funcRegs) {
+        if (call != ThreadCall::Clone && state.os->memory.IsSharedAddressSpace())
+            return ExecuteFunctionLocal(call, funcRegs, state.os->memory);
+
         if (state.process->status == kernel::type::KProcess::Status::Exiting)
             throw exception("Executing function on Exiting process");
 
@@ -144,25 +444,84 @@ namespace skyline {
         ExecuteFunctionCtx(call, funcRegs, reinterpret_cast<ThreadContext *>(thread->ctxMemory->kernel.address));
     }
 
-    void NCE::WaitThreadInit(std::shared_ptr<kernel::type::KThread> &thread) __attribute__ ((optnone)) {
+    void NCE::ExecuteSyscalls(span<SyscallDescriptor> syscalls) {
+        bool failed{};
+        if (state.os->memory.IsSharedAddressSpace()) {
+            for (auto &syscall : syscalls) {
+                if (failed) {
+                    syscall.result = -ECANCELED;
+                    continue;
+                }
+
+                Registers fregs{
+                    .x0 = syscall.arguments[0],
+                    .x1 = syscall.arguments[1],
+                    .x2 = syscall.arguments[2],
+                    .x3 = syscall.arguments[3],
+                    .x4 = syscall.arguments[4],
+                    .x5 = syscall.arguments[5],
+                    .x8 = syscall.number,
+                };
+                ExecuteFunctionLocal(ThreadCall::Syscall, fregs, state.os->memory);
+                syscall.result = static_cast<i64>(fregs.x0);
+                failed = fregs.x0 > static_cast<u64>(-4096);
+            }
+            return;
+        }
+
+        if (state.process->status == kernel::type::KProcess::Status::Exiting)
+            throw exception("Executing function on Exiting process");
+
+        auto thread{state.thread ? state.thread : state.process->threads.at(state.process->pid)};
         auto ctx{reinterpret_cast<ThreadContext *>(thread->ctxMemory->kernel.address)};
-        while (ctx->state == ThreadState::NotReady);
+
+        // The syscalls are split into batches which fit into the context, a failure in any batch cancels all syscalls after it
+        for (size_t offset{}; offset < syscalls.size(); offset += constant::SyscallBatchSize) {
+            auto batch{syscalls.subspan(offset, std::min<size_t>(constant::SyscallBatchSize, syscalls.size() - offset))};
+            if (failed) {
+                for (auto &syscall : batch)
+                    syscall.result = -ECANCELED;
+                continue;
+            }
+
+            std::copy(batch.begin(), batch.end(), ctx->syscalls);
+            Registers fregs{.x0 = batch.size()};
+            ExecuteFunctionCtx(ThreadCall::SyscallBatch, fregs, ctx);
+            std::copy(ctx->syscalls, ctx->syscalls + batch.size(), batch.begin());
+
+            failed = static_cast<u64>(batch.back().result) > static_cast<u64>(-4096);
+        }
+    }
+
+    void NCE::WaitThreadInit(std::shared_ptr<kernel::type::KThread> &thread) {
+        auto ctx{reinterpret_cast<ThreadContext *>(thread->ctxMemory->kernel.address)};
+        WaitState(ctx, [](ThreadState threadState) { return threadState != ThreadState::NotReady; });
     }
 
     void NCE::StartThread(u64 entryArg, u32 handle, std::shared_ptr<kernel::type::KThread> &thread) {
         auto ctx{reinterpret_cast<ThreadContext *>(thread->ctxMemory->kernel.address)};
-        while (ctx->state != ThreadState::WaitInit);
+        WaitState(ctx, [](ThreadState threadState) { return threadState == ThreadState::WaitInit; });
 
         ctx->tpidrroEl0 = thread->tls;
+        ctx->pc = thread->entryPoint;
         ctx->registers.x0 = entryArg;
         ctx->registers.x1 = handle;
-        ctx->state = ThreadState::WaitRun;
+        ctx->tid = static_cast<u64>(thread->tid);
+        ctx->profileInterval = profiler ? GuestProfiler::SampleInterval : 0;
+
+        bool pooled{kernelPool && AddKernelSlot(thread, ctx)};
+        SetState(ctx, ThreadState::WaitRun);
+        if (pooled)
+            return;
 
         state.logger->Debug("Starting kernel thread for guest thread: {}", thread->tid);
         threadMap[thread->tid] = std::make_shared<std::thread>(&NCE::KernelThread, this, thread->tid);
     }
 
     void NCE::ThreadTrace(u16 numHist, ThreadContext *ctx) {
+        if (!state.logger->IsEnabled(Logger::LogLevel::Debug))
+            return; // The trace is only written out as Debug logs, so building it would be wasted work
+
         std::string raw;
         std::string trace;
         std::string regStr;
@@ -201,6 +560,16 @@ namespace skyline {
             regStr += fmt::format("\n{}{}: 0x{:<16X} {}{}: 0x{:X}", xStr, index, ctx->registers.regs[index], xStr, index + 1, ctx->registers.regs[index + 1]);
         }
 
+        std::string svcStr;
+        if (svcHistory) {
+            // The entries are printed from the oldest to the newest, empty entries are from prior to the ring buffer wrapping around for the first time
+            for (u32 index{}; index < constant::SvcHistorySize; index++) {
+                auto entry{ctx->svcHistory[(ctx->svcHistoryIndex + index) & (constant::SvcHistorySize - 1)]};
+                if (entry)
+                    svcStr += fmt::format("\n0x{:X} : SVC 0x{:02X}", entry & ((1ULL << 48) - 1), entry >> 48);
+            }
+        }
+
         if (numHist) {
             state.logger->Debug("Process Trace:{}", trace);
             state.logger->Debug("Raw Instructions: 0x{}", raw);
@@ -208,61 +577,194 @@ namespace skyline {
         } else {
             state.logger->Debug("CPU Context:{}", regStr);
         }
+
+        if (!svcStr.empty())
+            state.logger->Debug("SVC History:{}", svcStr);
+    }
+
+    std::vector<u64> NCE::GetSvcProfile() {
+        constexpr size_t EntrySize{2 + SvcStatistics::BucketCount}; // The amount of values for a single SVC in the profile
+        std::vector<u64> profile(SvcStatistics::SvcCount * EntrySize);
+
+        std::lock_guard guard(statisticsMutex);
+        for (const auto &statistics : svcStatistics) {
+            auto value{profile.begin()};
+            for (const auto &entry : statistics->entries) {
+                *(value++) += entry.count.load(std::memory_order_relaxed);
+                *(value++) += entry.time.load(std::memory_order_relaxed);
+                for (const auto &bucket : entry.buckets)
+                    *(value++) += bucket.load(std::memory_order_relaxed);
+            }
+        }
+
+        return profile;
+    }
+
+    /**
+     * @brief Generates code which reads CNTVCT_EL0 and rescales it from the host frequency to the guest frequency into a register
+     * @details The ratio between the frequencies is encoded as a 64-bit fixed-point multiplier M and a shift S (guestFrequency / hostFrequency = M * 2^(S - 64)) when patching, so the rescaling is a 128-bit multiply without any division
+     * @param destReg The register to write the rescaled counter into, all other registers are preserved
+     * @return The instructions to insert into the patch
+     */
+    std::vector<u32> RescaleCounter(regs::X destReg, u64 hostFrequency, u64 guestFrequency) {
+        constexpr u32 CntvctEl0{0x5F02}; // ID of CNTVCT_EL0 in MRS
+
+        u8 shift{};
+        while (guestFrequency >= (hostFrequency << shift))
+            shift++;
+        auto multiplier{static_cast<u64>((static_cast<u128>(guestFrequency) << (64 - shift)) / hostFrequency)};
+
+        // The scratch registers are any 2 registers other than the destination register, they're spilled to the stack as a pair
+        auto scratch{destReg == regs::X0 ? regs::X1 : regs::X0};
+        auto product{(destReg == regs::X2 || scratch == regs::X2) ? regs::X3 : regs::X2};
+
+        std::vector<u32> instructions;
+        instructions.push_back(0xA9BF03E0 | (product << 10) | scratch); // STP XSCRATCH, XPRODUCT, [SP, #-16]!
+        instructions.push_back(instr::Mrs(CntvctEl0, destReg).raw);
+
+        for (auto instruction : instr::MoveRegister<u64>(scratch, multiplier))
+            instructions.push_back(instruction);
+
+        if (shift) {
+            // The result is the 128-bit product shifted right by (64 - S), which is extracted from the upper and lower halves of the product
+            instructions.push_back(instr::Mul(product, destReg, scratch).raw);
+            instructions.push_back(instr::Umulh(destReg, destReg, scratch).raw);
+            instructions.push_back(instr::Extr(destReg, destReg, product, static_cast<u8>(64 - shift)).raw);
+        } else {
+            // The result is the upper half of the 128-bit product as the guest frequency is lower than the host frequency
+            instructions.push_back(instr::Umulh(destReg, destReg, scratch).raw);
+        }
+
+        instructions.push_back(0xA8C103E0 | (product << 10) | scratch); // LDP XSCRATCH, XPRODUCT, [SP], #16
+        return instructions;
     }
 
-    std::vector<u32> NCE::PatchCode(std::vector<u8> &code, u64 baseAddress, i64 offset) {
+    /**
+     * @brief Stores the context of an SVC into ThreadContext::registers, this expects LR to have been saved on the stack
+     * @note Only X0-X18 are stored as SvcHandler is a regular function which preserves the callee-saved X19-X29 itself, the kernel reads the arguments of the SVC from the stored registers and no SVC uses more than X0-X7
+     */
+    constexpr std::array<u32, 11> SaveSvcContext{[] {
+        std::array<u32, 11> instructions{0xD53BD05E}; // MRS LR, TPIDR_EL0
+        for (u32 reg{}; reg < 18; reg += 2)
+            instructions[1 + (reg / 2)] = 0xA9000000 | ((2 + reg) << 15) | ((reg + 1) << 10) | (30 << 5) | reg; // STP Xn, Xn+1, [LR, #(16 + n * 8)]
+        instructions[10] = 0xF9000000 | ((2 + 18) << 10) | (30 << 5) | 18; // STR X18, [LR, #160]
+        return instructions;
+    }()};
+
+    /**
+     * @brief Loads the context of an SVC from ThreadContext::registers after it was handled, this includes the results written by the kernel
+     */
+    constexpr std::array<u32, 11> LoadSvcContext{[] {
+        std::array<u32, 11> instructions{0xD53BD05E}; // MRS LR, TPIDR_EL0
+        for (u32 reg{}; reg < 18; reg += 2)
+            instructions[1 + (reg / 2)] = 0xA9400000 | ((2 + reg) << 15) | ((reg + 1) << 10) | (30 << 5) | reg; // LDP Xn, Xn+1, [LR, #(16 + n * 8)]
+        instructions[10] = 0xF9400000 | ((2 + 18) << 10) | (30 << 5) | 18; // LDR X18, [LR, #160]
+        return instructions;
+    }()};
+
+    NCE::PatchFragment NCE::PatchChunk(u32 *code, u32 *start, u32 *end, u64 baseAddress, i64 offset, i64 patchOffset, u64 frequency, bool svcHistory) {
         constexpr u32 TpidrEl0{0x5E82};      // ID of TPIDR_EL0 in MRS
         constexpr u32 TpidrroEl0{0x5E83};    // ID of TPIDRRO_EL0 in MRS
         constexpr u32 CntfrqEl0{0x5F00};     // ID of CNTFRQ_EL0 in MRS
         constexpr u32 CntpctEl0{0x5F01};     // ID of CNTPCT_EL0 in MRS
         constexpr u32 CntvctEl0{0x5F02};     // ID of CNTVCT_EL0 in MRS
         constexpr u32 TegraX1Freq{19200000}; // The clock frequency of the Tegra X1 (19.2 MHz)
+        constexpr u16 SvcGetSystemTick{0x1E}; // ID of svcGetSystemTick
+        constexpr u16 SvcGetThreadId{0x25};   // ID of svcGetThreadId
 
-        u32 *start{reinterpret_cast<u32 *>(code.data())};
-        u32 *end{start + (code.size() / sizeof(u32))};
-        i64 patchOffset{offset};
+        PatchFragment fragment;
+        auto &patch{fragment.patch};
 
-        std::vector<u32> patch((guest::SaveCtxSize + guest::LoadCtxSize + guest::SvcHandlerSize) / sizeof(u32));
+        for (u32 *address{start}; address < end; address++) {
+            auto instrSvc{reinterpret_cast<instr::Svc *>(address)};
+            auto instrMrs{reinterpret_cast<instr::Mrs *>(address)};
+            auto instrMsr{reinterpret_cast<instr::Msr *>(address)};
 
-        std::memcpy(patch.data(), reinterpret_cast<void *>(&guest::SaveCtx), guest::SaveCtxSize);
-        offset += guest::SaveCtxSize;
+            if (instrSvc->Verify() && instrSvc->value == SvcGetSystemTick) {
+                // If this is svcGetSystemTick then we write the Tegra X1 scaled counter into X0 directly as it doesn't require the kernel at all
+                instr::B bJunc(offset);
+                *address = bJunc.raw;
+                fragment.junctions.push_back(address);
 
-        std::memcpy(reinterpret_cast<u8 *>(patch.data()) + guest::SaveCtxSize, reinterpret_cast<void *>(&guest::LoadCtx), guest::LoadCtxSize);
-        offset += guest::LoadCtxSize;
+                if (frequency != TegraX1Freq) {
+                    auto rescale{RescaleCounter(regs::X0, frequency, TegraX1Freq)};
+                    offset += sizeof(u32) * rescale.size();
 
-        std::memcpy(reinterpret_cast<u8 *>(patch.data()) + guest::SaveCtxSize + guest::LoadCtxSize, reinterpret_cast<void *>(&guest::SvcHandler), guest::SvcHandlerSize);
-        offset += guest::SvcHandlerSize;
+                    patch.insert(patch.end(), rescale.begin(), rescale.end());
+                } else {
+                    auto mrsX0{instr::Mrs(CntvctEl0, regs::X0)};
+                    offset += sizeof(mrsX0);
 
-        static u64 frequency{};
-        if (!frequency)
-            asm("MRS %0, CNTFRQ_EL0" : "=r"(frequency));
+                    patch.push_back(mrsX0.raw);
+                }
 
-        for (u32 *address{start}; address < end; address++) {
-            auto instrSvc{reinterpret_cast<instr::Svc *>(address)};
-            auto instrMrs{reinterpret_cast<instr::Mrs *>(address)};
-            auto instrMsr{reinterpret_cast<instr::Msr *>(address)};
+                instr::B bret(-offset + sizeof(u32));
+                offset += sizeof(bret);
 
-            if (instrSvc->Verify()) {
-                // If this is an SVC we need to branch to saveCtx then to the SVC Handler after putting the PC + SVC into X0 and W1 and finally loadCtx before returning to where we were before
+                patch.push_back(bret.raw);
+                fragment.relocations.push_back(patch.size() - 1);
+            } else if (instrSvc->Verify()) {
+                // If this is an SVC we need to save the context inline then branch to the SVC Handler after putting the PC + SVC into X0 and W1 and finally load the context inline before returning to where we were before
                 instr::B bJunc(offset);
+                *address = bJunc.raw;
+                fragment.junctions.push_back(address);
+
+                if (instrSvc->value == SvcGetThreadId) {
+                    // If this is svcGetThreadId on the current thread then we load the TID from ThreadContext and return without entering the kernel, any other handle falls through to the regular SVC path
+                    // The handle is compared without setting flags as the guest's NZCV has to be preserved across the SVC, W0 is free as it's only an output of the SVC and it's already the result code (0) when the handle matches
+                    constexpr u32 addW0{0x11402020}; // ADD W0, W1, #0x8, LSL #12 (W0 = W1 + 0x8000, this is zero when W1 == 0xFFFF8000)
+                    offset += sizeof(addW0);
+
+                    instr::Cbnz cbnzSvc(regs::W0, 4 * sizeof(u32));
+                    offset += sizeof(cbnzSvc);
+
+                    constexpr u32 mrsX1{0xD53BD041}; // MRS X1, TPIDR_EL0
+                    offset += sizeof(mrsX1);
+
+                    constexpr u32 ldrTid{0xF9409021}; // LDR X1, [X1, #288] (ThreadContext::tid)
+                    offset += sizeof(ldrTid);
+
+                    instr::B bret(-offset + sizeof(u32));
+                    offset += sizeof(bret);
+
+                    patch.push_back(addW0);
+                    patch.push_back(cbnzSvc.raw);
+                    patch.push_back(mrsX1);
+                    patch.push_back(ldrTid);
+                    patch.push_back(bret.raw);
+                    fragment.relocations.push_back(patch.size() - 1);
+                }
 
                 constexpr u32 strLr{0xF81F0FFE}; // STR LR, [SP, #-16]!
                 offset += sizeof(strLr);
 
-                instr::BL bSvCtx(patchOffset - offset);
-                offset += sizeof(bSvCtx);
+                offset += sizeof(u32) * SaveSvcContext.size();
 
-                auto movPc{instr::MoveRegister<u64>(regs::X0, baseAddress + (address - start))};
+                auto movPc{instr::MoveRegister<u64>(regs::X0, baseAddress + (address - code))};
                 offset += sizeof(u32) * movPc.size();
 
                 instr::Movz movCmd(regs::W1, static_cast<u16>(instrSvc->value));
                 offset += sizeof(movCmd);
 
-                instr::BL bSvcHandler((patchOffset + guest::SaveCtxSize + guest::LoadCtxSize) - offset);
+                // If SVC history is enabled then the PC and SVC ID are recorded into the ring buffer in ThreadContext, the registers used are restored along with the context
+                constexpr std::array<u32, 8> recordSvc{
+                    0xD53BD042, // MRS X2, TPIDR_EL0
+                    0xB9412843, // LDR W3, [X2, #296] (ThreadContext::svcHistoryIndex)
+                    0x11000464, // ADD W4, W3, #1
+                    0x12001084, // AND W4, W4, #0x1F (constant::SvcHistorySize - 1)
+                    0xB9012844, // STR W4, [X2, #296] (ThreadContext::svcHistoryIndex)
+                    0x9104C045, // ADD X5, X2, #304 (ThreadContext::svcHistory)
+                    0xAA01C006, // ORR X6, X0, X1, LSL #48
+                    0xF82358A6, // STR X6, [X5, W3, UXTW #3]
+                };
+                static_assert(constant::SvcHistorySize == 32);
+                if (svcHistory)
+                    offset += sizeof(u32) * recordSvc.size();
+
+                instr::BL bSvcHandler(patchOffset - offset);
                 offset += sizeof(bSvcHandler);
 
-                instr::BL bLdCtx((patchOffset + guest::SaveCtxSize) - offset);
-                offset += sizeof(bLdCtx);
+                offset += sizeof(u32) * LoadSvcContext.size();
 
                 constexpr u32 ldrLr{0xF84107FE}; // LDR LR, [SP], #16
                 offset += sizeof(ldrLr);
@@ -270,16 +772,19 @@ namespace skyline {
                 instr::B bret(-offset + sizeof(u32));
                 offset += sizeof(bret);
 
-                *address = bJunc.raw;
                 patch.push_back(strLr);
-                patch.push_back(bSvCtx.raw);
+                patch.insert(patch.end(), SaveSvcContext.begin(), SaveSvcContext.end());
                 for (auto &instr : movPc)
                     patch.push_back(instr);
                 patch.push_back(movCmd.raw);
+                if (svcHistory)
+                    patch.insert(patch.end(), recordSvc.begin(), recordSvc.end());
                 patch.push_back(bSvcHandler.raw);
-                patch.push_back(bLdCtx.raw);
+                fragment.relocations.push_back(patch.size() - 1);
+                patch.insert(patch.end(), LoadSvcContext.begin(), LoadSvcContext.end());
                 patch.push_back(ldrLr);
                 patch.push_back(bret.raw);
+                fragment.relocations.push_back(patch.size() - 1);
             } else if (instrMrs->Verify()) {
                 if (instrMrs->srcReg == TpidrroEl0 || instrMrs->srcReg == TpidrEl0) {
                     // If this moves TPIDR(RO)_EL0 into a register then we retrieve the value of our virtual TPIDR(RO)_EL0 from TLS and write it to the register
@@ -316,6 +821,7 @@ namespace skyline {
                     offset += sizeof(bret);
 
                     *address = bJunc.raw;
+                    fragment.junctions.push_back(address);
                     if (strX0)
                         patch.push_back(strX0);
                     patch.push_back(mrsX0);
@@ -325,30 +831,24 @@ namespace skyline {
                     if (ldrX0)
                         patch.push_back(ldrX0);
                     patch.push_back(bret.raw);
+                    fragment.relocations.push_back(patch.size() - 1);
                 } else if (frequency != TegraX1Freq) {
                     // These deal with changing the timer registers, we only do this if the clock frequency doesn't match the X1's clock frequency
                     if (instrMrs->srcReg == CntpctEl0) {
-                        // If this moves CNTPCT_EL0 into a register then call RescaleClock to rescale the device's clock to the X1's clock frequency and write result to register
+                        // If this moves CNTPCT_EL0 into a register then rescale the device's clock to the X1's clock frequency and write the result to the register
                         instr::B bJunc(offset);
-                        offset += guest::RescaleClockSize;
-
-                        instr::Ldr ldr(0xF94003E0); // LDR XOUT, [SP]
-                        ldr.destReg = instrMrs->destReg;
-                        offset += sizeof(ldr);
 
-                        constexpr u32 addSp{0x910083FF}; // ADD SP, SP, #32
-                        offset += sizeof(addSp);
+                        auto rescale{RescaleCounter(static_cast<regs::X>(instrMrs->destReg), frequency, TegraX1Freq)};
+                        offset += sizeof(u32) * rescale.size();
 
                         instr::B bret(-offset + sizeof(u32));
                         offset += sizeof(bret);
 
                         *address = bJunc.raw;
-                        auto size{patch.size()};
-                        patch.resize(size + (guest::RescaleClockSize / sizeof(u32)));
-                        std::memcpy(patch.data() + size, reinterpret_cast<void *>(&guest::RescaleClock), guest::RescaleClockSize);
-                        patch.push_back(ldr.raw);
-                        patch.push_back(addSp);
+                        fragment.junctions.push_back(address);
+                        patch.insert(patch.end(), rescale.begin(), rescale.end());
                         patch.push_back(bret.raw);
+                        fragment.relocations.push_back(patch.size() - 1);
                     } else if (instrMrs->srcReg == CntfrqEl0) {
                         // If this moves CNTFRQ_EL0 into a register then move the Tegra X1's clock frequency into the register (Rather than the host clock frequency)
                         instr::B bJunc(offset);
@@ -360,9 +860,11 @@ namespace skyline {
                         offset += sizeof(bret);
 
                         *address = bJunc.raw;
+                        fragment.junctions.push_back(address);
                         for (auto &instr : movFreq)
                             patch.push_back(instr);
                         patch.push_back(bret.raw);
+                        fragment.relocations.push_back(patch.size() - 1);
                     }
                 } else {
                     // If the host clock frequency is the same as the Tegra X1's clock frequency
@@ -399,18 +901,85 @@ namespace skyline {
                     offset += sizeof(bret);
 
                     *address = bJunc.raw;
+                    fragment.junctions.push_back(address);
                     patch.push_back(pushXn);
                     patch.push_back(loadRealTls);
                     patch.push_back(moveParam.raw);
                     patch.push_back(storeEmuTls);
                     patch.push_back(popXn);
                     patch.push_back(bret.raw);
+                    fragment.relocations.push_back(patch.size() - 1);
                 }
             }
 
             offset -= sizeof(u32);
             patchOffset -= sizeof(u32);
         }
+        return fragment;
+    }
+
+    std::vector<u32> NCE::PatchCode(span<u8> code, u64 baseAddress, i64 offset) {
+        constexpr size_t MinChunkSize{0x100000}; // The minimum size of code scanned by a single thread
+
+        u32 *start{reinterpret_cast<u32 *>(code.data())};
+        u32 *end{start + (code.size() / sizeof(u32))};
+        i64 patchOffset{offset};
+
+        std::vector<u32> patch(guest::SvcHandlerSize / sizeof(u32));
+
+        std::memcpy(patch.data(), reinterpret_cast<void *>(&guest::SvcHandler), guest::SvcHandlerSize);
+        offset += guest::SvcHandlerSize;
+
+        static u64 frequency{};
+        if (!frequency)
+            asm("MRS %0, CNTFRQ_EL0" : "=r"(frequency));
+
+        // The code is split into chunks which are scanned in parallel, every chunk produces a fragment as if it directly follows the prologue above
+        size_t chunkCount{std::clamp<size_t>(code.size() / MinChunkSize, 1, std::max(std::thread::hardware_concurrency(), 1U))};
+        size_t chunkInstructions{util::AlignUp(static_cast<size_t>(end - start), chunkCount) / chunkCount};
+
+        std::vector<PatchFragment> fragments(chunkCount);
+        std::vector<std::thread> workers;
+        workers.reserve(chunkCount - 1);
+
+        for (size_t chunk{}; chunk < chunkCount; chunk++) {
+            auto chunkStart{start + std::min(chunk * chunkInstructions, static_cast<size_t>(end - start))};
+            auto chunkEnd{std::min(chunkStart + chunkInstructions, end)};
+            auto chunkOffset{static_cast<i64>((chunkStart - start) * sizeof(u32))};
+
+            auto scan{[&, chunk, chunkStart, chunkEnd, chunkOffset] {
+                fragments[chunk] = PatchChunk(start, chunkStart, chunkEnd, baseAddress, offset - chunkOffset, patchOffset - chunkOffset, frequency, svcHistory);
+            }};
+
+            if (chunk == chunkCount - 1)
+                scan(); // The last chunk is scanned on this thread rather than spawning another one
+            else
+                workers.emplace_back(scan);
+        }
+
+        for (auto &worker : workers)
+            worker.join();
+
+        // Every fragment is shifted from where it was generated by the size of all preceding fragments, so any branches into or out of it need to be adjusted by that amount
+        size_t patchSize{patch.size()};
+        for (const auto &fragment : fragments)
+            patchSize += fragment.patch.size();
+        patch.reserve(patchSize);
+
+        i32 shift{};
+        for (auto &fragment : fragments) {
+            if (shift) {
+                for (auto junction : fragment.junctions)
+                    reinterpret_cast<instr::B *>(junction)->offset += shift;
+
+                for (auto relocation : fragment.relocations)
+                    reinterpret_cast<instr::B *>(&fragment.patch[relocation])->offset -= shift; // B and BL share their offset encoding
+            }
+
+            patch.insert(patch.end(), fragment.patch.begin(), fragment.patch.end());
+            shift += static_cast<i32>(fragment.patch.size());
+        }
+
         return patch;
     }
 }
@@ -5,15 +5,77 @@
 
 #include "common.h"
 #include <sys/wait.h>
+#include "nce/profiler.h"
 
 namespace skyline {
     /**
      * @brief The NCE (Native Code Execution) class is responsible for managing the state of catching instructions and directly controlling processes/threads
      */
     class NCE {
+      public:
+        /**
+         * @brief Statistics about the SVCs called by a single guest thread, these are only written to by the kernel thread managing it
+         */
+        struct SvcStatistics {
+            static constexpr size_t SvcCount{0x80}; //!< The amount of SVCs in the SVC table
+            static constexpr size_t BucketCount{32}; //!< The amount of latency buckets, bucket N counts calls which took [2^N, 2^(N + 1)) ns with the last bucket counting all longer calls
+
+            struct Entry {
+                std::atomic<u64> count; //!< The amount of times the SVC has been called
+                std::atomic<u64> time; //!< The total amount of time spent in the SVC in nanoseconds
+                std::array<std::atomic<u64>, BucketCount> buckets; //!< A log2 histogram of the latency of the SVC
+            };
+
+            std::array<Entry, SvcCount> entries{};
+
+            /**
+             * @brief Records a single call to an SVC
+             * @param duration The duration of the call in nanoseconds
+             * @note As there's only a single writer, this avoids atomic RMW operations while still allowing concurrent reads
+             */
+            inline void Record(u16 svc, u64 duration) {
+                if (svc >= SvcCount)
+                    return;
+
+                auto &entry{entries[svc]};
+                entry.count.store(entry.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                entry.time.store(entry.time.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+
+                auto &bucket{entry.buckets[std::min<size_t>(63 - __builtin_clzll(duration | 1), BucketCount - 1)]};
+                bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        };
+
       private:
         DeviceState &state;
         std::unordered_map<pid_t, std::shared_ptr<std::thread>> threadMap; //!< This maps all of the host threads to their corresponding kernel thread
+        Mutex statisticsMutex; //!< Synchronizes access to svcStatistics
+        std::vector<std::shared_ptr<SvcStatistics>> svcStatistics; //!< The SVC statistics of every kernel thread, these are retained after the thread exits to keep the totals intact
+        std::atomic<bool> firstSvcMarked{}; //!< If BootPhase::FirstSvc has been marked, this avoids touching the boot timeline on every SVC
+
+        /**
+         * @brief A guest thread which has its SVCs serviced by the kernel worker pool
+         */
+        struct KernelSlot {
+            std::shared_ptr<kernel::type::KThread> thread; //!< The guest thread, this is only written to with kernelSlotMutex held and only read by the worker which has claimed the slot
+            std::atomic<ThreadContext *> ctx{}; //!< The context of the guest thread, this is nullptr if the slot is unused
+            std::atomic<bool> claimed{}; //!< If a worker is servicing the thread, only the worker which claimed the slot may access the thread
+            u32 profileIndex{}; //!< The amount of profiler samples of the thread that have been collected
+        };
+
+        static constexpr size_t KernelSlotCount{0x400}; //!< The maximum amount of guest threads serviced by the pool, any further threads get a dedicated kernel thread
+
+        const bool kernelPool; //!< If SVCs are serviced by a shared pool of kernel workers rather than a kernel thread per guest thread, this is controlled by the "svc_worker_pool" setting
+        std::once_flag kernelPoolFlag; //!< Initializes the pool when the first guest thread is started, the doorbell can only be mapped once the process exists
+        std::atomic<u32> *doorbell{}; //!< A futex which is incremented by guest threads whenever they require servicing, workers sleep on it while there's nothing to service, it's backed by KProcess::doorbellMemory
+        u64 guestDoorbell{}; //!< The address of the doorbell in the guest
+        std::array<KernelSlot, KernelSlotCount> kernelSlots{};
+        std::atomic<size_t> kernelSlotCount{}; //!< The amount of slots which have ever been used, workers only scan these
+        Mutex kernelSlotMutex; //!< Synchronizes assigning threads to slots and freeing them
+        std::vector<std::thread> kernelWorkers; //!< All workers of the pool, workers are never retired so the pool settles at the peak amount of SVCs which block concurrently, it never exceeds KernelSlotCount as every worker services a single slot at a time
+        Mutex kernelWorkerMutex; //!< Synchronizes access to kernelWorkers and kernelWorkersStopped
+        std::atomic<bool> kernelWorkersStopped{}; //!< If the pool has been stopped, workers exit once they notice this and no further workers are spawned
+        std::atomic<u32> idleWorkers{}; //!< The amount of workers which aren't servicing an SVC, a worker is added whenever this drops to 0 as the busy workers might be blocked indefinitely
 
         /**
          * @brief The event loop of a kernel thread managing a guest thread
@@ -21,7 +83,79 @@ namespace skyline {
          */
         void KernelThread(pid_t thread);
 
+        /**
+         * @brief Services the state which the guest thread of the calling kernel thread or worker is in, this is only used for ThreadState::WaitKernel and ThreadState::GuestCrash
+         * @return If the guest thread is still alive, ExitThread must be called for it otherwise
+         */
+        bool ServiceThread(ThreadState threadState, SvcStatistics &statistics);
+
+        /**
+         * @brief Terminates the guest thread of the calling kernel thread or worker and recycles its context, the application is halted if it's the main thread
+         */
+        void ExitThread(pid_t thread);
+
+        /**
+         * @brief The event loop of a worker of the kernel worker pool, it services the SVCs of any guest thread in a slot
+         */
+        void KernelWorker();
+
+        /**
+         * @brief Claims and services a single guest thread which requires servicing
+         * @param cursor The slot to start looking from, it's advanced past the serviced slot so consecutive calls don't favour the first slots
+         * @return If a guest thread was serviced
+         */
+        bool ServiceKernelSlot(size_t &cursor, SvcStatistics &statistics);
+
+        /**
+         * @brief Adds a worker to the pool, this does nothing if the pool has been stopped or every slot already has a worker
+         */
+        void SpawnKernelWorker();
+
+        /**
+         * @brief Stops all workers of the pool and joins them, this does nothing if the pool has already been stopped
+         * @param wake If workers sleeping on the doorbell should be woken up, this must be false once the process has been destroyed as the doorbell is unmapped along with it
+         */
+        void StopKernelWorkers(bool wake);
+
+        /**
+         * @brief Assigns a guest thread to a free slot so its SVCs are serviced by the pool
+         * @return If a slot was free
+         */
+        bool AddKernelSlot(const std::shared_ptr<kernel::type::KThread> &thread, ThreadContext *ctx);
+
+        /**
+         * @brief Stops the guest process and blocks the calling thread until the surface is restored or the emulation is halted, so no CPU time is spent while the app is in the background
+         * @note Kernel threads block by themselves while there's no surface, so guest threads waiting on an SVC stay parked
+         */
+        void Pause();
+
+        /**
+         * @brief A fragment of the patch section which corresponds to a contiguous chunk of code
+         */
+        struct PatchFragment {
+            std::vector<u32> patch; //!< The patch instructions for all patched instructions in the chunk
+            std::vector<size_t> relocations; //!< The indices of branches in the fragment which branch out of it
+            std::vector<u32 *> junctions; //!< The instructions in the code which were replaced with a branch into the fragment
+        };
+
+        /**
+         * @brief Patches a chunk of code as if its fragment was directly after the common prologue of the patch section
+         * @param code The start of the entire code block
+         * @param start The first instruction in the chunk
+         * @param end The instruction after the last one in the chunk
+         * @param baseAddress The address at which the code is mapped
+         * @param offset The offset from the first instruction in the chunk to the end of the prologue
+         * @param patchOffset The offset from the first instruction in the chunk to the start of the prologue
+         * @param frequency The frequency of the host clock
+         * @param svcHistory If SVCs should be recorded into ThreadContext::svcHistory
+         */
+        static PatchFragment PatchChunk(u32 *code, u32 *start, u32 *end, u64 baseAddress, i64 offset, i64 patchOffset, u64 frequency, bool svcHistory);
+
       public:
+        const bool svcHistory; //!< If the SVC trampolines record into ThreadContext::svcHistory, this is controlled by the "svc_history" setting
+        const bool svcProfiling; //!< If the duration of every SVC is recorded into its SvcStatistics, this is controlled by the "perf_stats" setting as the performance statistics are its only consumer
+        std::unique_ptr<GuestProfiler> profiler; //!< The sampling profiler of guest code, it only exists if the "guest_profiler" setting is enabled
+
         NCE(DeviceState &state);
 
         /**
@@ -49,6 +183,13 @@ namespace skyline {
          */
         void ExecuteFunction(ThreadCall call, Registers &funcRegs);
 
+        /**
+         * @brief Executes several syscalls on the child process in order with a single handoff for every ThreadCall::SyscallBatch worth of them
+         * @param syscalls The syscalls to execute, their results are written back into them
+         * @note The syscalls after the first one that fails aren't executed and have their result set to -ECANCELED
+         */
+        void ExecuteSyscalls(span<SyscallDescriptor> syscalls);
+
         /**
          * @brief Waits till a thread is ready to execute commands
          * @param thread The KThread to wait for initialization
@@ -65,18 +206,25 @@ namespace skyline {
         void StartThread(u64 entryArg, u32 handle, std::shared_ptr<kernel::type::KThread> &thread);
 
         /**
-         * @brief Prints out a trace and the CPU context
+         * @brief Prints out a trace, the CPU context and the SVC history if it is enabled
          * @param numHist The amount of previous instructions to print (Can be 0)
          * @param ctx The ThreadContext of the thread to log
          */
         void ThreadTrace(u16 numHist = 10, ThreadContext *ctx = nullptr);
 
+        /**
+         * @brief Sums up the SVC statistics of all kernel threads
+         * @return The statistics of every SVC in order, each of them being the call count, the total time in nanoseconds and all latency buckets (See SvcStatistics)
+         * @note SVCs are only recorded while svcProfiling is enabled, the profile is all zeroes otherwise
+         */
+        std::vector<u64> GetSvcProfile();
+
         /**
          * @brief Patches specific parts of the code
-         * @param code A vector with the code to be patched
+         * @param code The code to be patched in-place
          * @param baseAddress The address at which the code is mapped
          * @param offset The offset of the code block from the base address
          */
-        std::vector<u32> PatchCode(std::vector<u8> &code, u64 baseAddress, i64 offset);
+        std::vector<u32> PatchCode(span<u8> code, u64 baseAddress, i64 offset);
     };
 }
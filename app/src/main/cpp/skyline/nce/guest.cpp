@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <cerrno>
 #include <csignal>
 #include <cstdlib>
 #include <initializer_list> // This is used implicitly
 #include <asm/siginfo.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <asm/unistd.h>
 #include "guest_common.h"
 
@@ -105,36 +107,28 @@ namespace skyline::guest {
         ctx->pc = pc;
         ctx->svc = svc;
 
-        if (svc == 0x1E) { // svcGetSystemTick
-            asm("STP X1, X2, [SP, #-16]!\n\t"
-                "STR Q0, [SP, #-16]!\n\t"
-                "STR Q1, [SP, #-16]!\n\t"
-                "STR Q2, [SP, #-16]!\n\t"
-                "MRS X1, CNTFRQ_EL0\n\t"
-                "MRS X2, CNTVCT_EL0\n\t"
-                "UCVTF D0, X0\n\t"
-                "MOV X1, 87411174408192\n\t"
-                "MOVK X1, 0x4172, LSL 48\n\t"
-                "FMOV D2, X1\n\t"
-                "UCVTF D1, X1\n\t"
-                "FDIV D0, D0, D2\n\t"
-                "FMUL D0, D0, D1\n\t"
-                "FCVTZU %0, D0\n\t"
-                "LDR Q2, [SP], #16\n\t"
-                "LDR Q1, [SP], #16\n\t"
-                "LDR Q0, [SP], #16\n\t"
-                "LDP X1, X2, [SP], #16"::"r"(ctx->registers.x0));
-            return;
-        }
-
+        auto doorbell{ctx->svcDoorbell};
         while (true) {
-            ctx->state = ThreadState::WaitKernel;
+            if (doorbell) {
+                // Only the SVC itself is announced to the worker pool, the worker servicing it waits on the context for any functions it runs here to return
+                ctx->state.store(ThreadState::WaitKernel, std::memory_order_release);
+                RingDoorbell(doorbell);
+                doorbell = nullptr;
+            } else {
+                SetState(ctx, ThreadState::WaitKernel);
+            }
 
-            while (ctx->state == ThreadState::WaitKernel);
+            ThreadState state;
+            for (u32 spins{}; (state = ctx->state.load(std::memory_order_acquire)) == ThreadState::WaitKernel; spins++) {
+                if (spins < constant::StateSpinCount)
+                    asm volatile("YIELD");
+                else
+                    FutexWait(ctx->state, state);
+            }
 
-            if (ctx->state == ThreadState::WaitRun) {
+            if (state == ThreadState::WaitRun) {
                 break;
-            } else if (ctx->state == ThreadState::WaitFunc) {
+            } else if (state == ThreadState::WaitFunc) {
                 if (ctx->threadCall == ThreadCall::Syscall) {
                     SaveCtxStack();
                     LoadCtxTls();
@@ -155,6 +149,29 @@ namespace skyline::guest {
 
                     while (src < end)
                         *(src++) = *(dest++);
+                } else if (ctx->threadCall == ThreadCall::SyscallBatch) {
+                    // The syscalls are run inline as their arguments are in the context rather than in the registers, the batch stops at the first failure as later syscalls usually depend on earlier ones
+                    u64 count{ctx->registers.x0};
+                    bool failed{};
+                    for (u64 index{}; index < count; index++) {
+                        auto &call{ctx->syscalls[index]};
+                        if (failed) {
+                            call.result = -ECANCELED;
+                            continue;
+                        }
+
+                        register u64 x0 asm("x0") = call.arguments[0];
+                        register u64 x1 asm("x1") = call.arguments[1];
+                        register u64 x2 asm("x2") = call.arguments[2];
+                        register u64 x3 asm("x3") = call.arguments[3];
+                        register u64 x4 asm("x4") = call.arguments[4];
+                        register u64 x5 asm("x5") = call.arguments[5];
+                        register u64 x8 asm("x8") = call.number;
+                        asm volatile("SVC #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5), "r"(x8) : "memory");
+
+                        call.result = static_cast<i64>(x0);
+                        failed = static_cast<u64>(call.result) > static_cast<u64>(-4096); // Only the topmost page of values are errors as the result of mmap can be a negative address
+                    }
                 } else if (ctx->threadCall == ThreadCall::Clone) {
                     SaveCtxStack();
                     LoadCtxTls();
@@ -205,7 +222,7 @@ namespace skyline::guest {
             }
         }
 
-        ctx->state = ThreadState::Running;
+        ctx->state.store(ThreadState::Running, std::memory_order_relaxed);
     }
 
     [[noreturn]] void Exit(int) {
@@ -224,29 +241,49 @@ namespace skyline::guest {
             ctx->registers.regs[index] = ucontext->uc_mcontext.regs[index];
 
         ctx->pc = ucontext->uc_mcontext.pc;
-        ctx->signal = static_cast<u32>(signal);
+        ctx->signal = static_cast<u8>(signal);
         ctx->faultAddress = ucontext->uc_mcontext.fault_address;
         ctx->sp = ucontext->uc_mcontext.sp;
 
-        while (true) {
-            ctx->state = ThreadState::GuestCrash;
+        SetState(ctx, ThreadState::GuestCrash);
+        if (ctx->svcDoorbell)
+            RingDoorbell(ctx->svcDoorbell);
 
-            if (ctx->state == ThreadState::WaitRun)
-                Exit(0);
-        }
+        ThreadState state;
+        while ((state = ctx->state.load(std::memory_order_acquire)) != ThreadState::WaitRun)
+            FutexWait(ctx->state, state);
+
+        Exit(0);
+    }
+
+    /**
+     * @brief Records the PC and LR of the interrupted guest code into the profile samples of the thread, this is run on every expiry of the profiling timer
+     */
+    void ProfileHandler(int, siginfo_t *, ucontext_t *ucontext) {
+        volatile ThreadContext *ctx;
+        asm("MRS %0, TPIDR_EL0":"=r"(ctx));
+
+        auto index{ctx->profileSampleIndex};
+        auto &sample{ctx->profileSamples[index & (constant::ProfileSampleCount - 1)]};
+        sample.pc = ucontext->uc_mcontext.pc;
+        sample.lr = ucontext->uc_mcontext.regs[30];
+        __atomic_store_n(&ctx->profileSampleIndex, index + 1, __ATOMIC_RELEASE);
     }
 
-    void GuestEntry(u64 address) {
+    void GuestEntry() {
         volatile ThreadContext *ctx;
         asm("MRS %0, TPIDR_EL0":"=r"(ctx));
 
         while (true) {
-            ctx->state = ThreadState::WaitInit;
-            while (ctx->state == ThreadState::WaitInit);
+            SetState(ctx, ThreadState::WaitInit);
 
-            if (ctx->state == ThreadState::WaitRun) {
+            ThreadState state;
+            while ((state = ctx->state.load(std::memory_order_acquire)) == ThreadState::WaitInit)
+                FutexWait(ctx->state, state);
+
+            if (state == ThreadState::WaitRun) {
                 break;
-            } else if (ctx->state == ThreadState::WaitFunc) {
+            } else if (state == ThreadState::WaitFunc) {
                 if (ctx->threadCall == ThreadCall::Syscall) {
                     SaveCtxStack();
                     LoadCtxTls();
@@ -285,7 +322,26 @@ namespace skyline::guest {
 
         sigaction(SIGTERM, &sigact, nullptr);
 
-        ctx->state = ThreadState::Running;
+        if (ctx->profileInterval) {
+            // The handler can interrupt syscalls of the guest or of thread calls, so they're restarted rather than failing with EINTR
+            sigact = {
+                .sa_sigaction = reinterpret_cast<void (*)(int, struct siginfo *, void *)>(reinterpret_cast<void *>(ProfileHandler)),
+                .sa_flags = SA_SIGINFO | SA_RESTART,
+            };
+
+            sigaction(SIGPROF, &sigact, nullptr);
+
+            // The timer counts the CPU time of the entire process and signals whichever thread is running when it expires, so it's only armed once by the main thread
+            if (gettid() == getpid()) {
+                itimerval timer{
+                    .it_interval = {.tv_usec = static_cast<long>(ctx->profileInterval)},
+                    .it_value = {.tv_usec = static_cast<long>(ctx->profileInterval)},
+                };
+                setitimer(ITIMER_PROF, &timer, nullptr);
+            }
+        }
+
+        ctx->state.store(ThreadState::Running, std::memory_order_relaxed);
 
         asm("MOV LR, %0\n\t"
             "MOV X0, %1\n\t"
@@ -352,7 +408,7 @@ namespace skyline::guest {
             "DUP V29.16B, WZR\n\t"
             "DUP V30.16B, WZR\n\t"
             "DUP V31.16B, WZR\n\t"
-            "RET"::"r"(address), "r"(ctx->registers.x0), "r"(ctx->registers.x1) : "x0", "x1", "lr");
+            "RET"::"r"(ctx->pc), "r"(ctx->registers.x0), "r"(ctx->registers.x1) : "x0", "x1", "lr");
 
         __builtin_unreachable();
     }
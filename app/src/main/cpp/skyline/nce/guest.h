@@ -7,35 +7,16 @@
 
 namespace skyline {
     namespace guest {
-        constexpr size_t SaveCtxSize{20 * sizeof(u32)}; //!< The size of the SaveCtx function in 32-bit ARMv8 instructions
-        constexpr size_t LoadCtxSize{20 * sizeof(u32)}; //!< The size of the LoadCtx function in 32-bit ARMv8 instructions
-        constexpr size_t RescaleClockSize{16 * sizeof(u32)}; //!< The size of the RescaleClock function in 32-bit ARMv8 instructions
         #ifdef NDEBUG
-        constexpr size_t SvcHandlerSize{225 * sizeof(u32)}; //!< The size of the SvcHandler (Release) function in 32-bit ARMv8 instructions
+        constexpr size_t SvcHandlerSize{260 * sizeof(u32)}; //!< The size of the SvcHandler (Release) function in 32-bit ARMv8 instructions
         #else
-        constexpr size_t SvcHandlerSize{400 * sizeof(u32)}; //!< The size of the SvcHandler (Debug) function in 32-bit ARMv8 instructions
+        constexpr size_t SvcHandlerSize{480 * sizeof(u32)}; //!< The size of the SvcHandler (Debug) function in 32-bit ARMv8 instructions
         #endif
 
         /**
-         * @brief The entry point for all guest threads
-         * @param address The address of the actual thread entry point
+         * @brief The entry point for all guest threads, they start executing at the PC in their context once NCE::StartThread has set it
          */
-        void GuestEntry(u64 address);
-
-        /**
-         * @brief Saves the context from CPU registers into TLS
-         */
-        extern "C" void SaveCtx(void);
-
-        /**
-         * @brief Loads the context from TLS into CPU registers
-         */
-        extern "C" void LoadCtx(void);
-
-        /**
-         * @brief Rescales the clock to Tegra X1 levels and puts the output on stack
-         */
-        extern "C" __noreturn void RescaleClock(void);
+        void GuestEntry();
 
         /**
          * @brief Handles all SVC calls
@@ -3,7 +3,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <asm/unistd.h>
 
 #define FORCE_INLINE __attribute__((always_inline)) inline // NOLINT(cppcoreguidelines-macro-usage)
 
@@ -19,6 +24,13 @@ namespace skyline {
     using i16 = __int16_t; //!< Signed 16-bit integer
     using i8 = __int8_t; //!< Signed 8-bit integer
 
+    namespace constant {
+        constexpr u32 StateSpinCount{512}; //!< The amount of iterations to spin on a state change of ThreadContext for prior to sleeping on its futex
+        constexpr u32 SvcHistorySize{32}; //!< The amount of SVCs recorded in ThreadContext::svcHistory, this must be a power of two as the index is wrapped with a mask
+        constexpr u32 SyscallBatchSize{16}; //!< The maximum amount of syscalls in ThreadContext::syscalls which are run in a single ThreadCall::SyscallBatch
+        constexpr u32 ProfileSampleCount{128}; //!< The amount of samples in ThreadContext::profileSamples, this must be a power of two as the index is wrapped with a mask
+    }
+
     /**
      * @brief The state of all the general purpose registers in the guest
      * @note Read about ARMv8 registers here: https://developer.arm.com/docs/100878/latest/registers
@@ -122,7 +134,10 @@ namespace skyline {
         };
     };
 
-    enum class ThreadState : u8 {
+    /**
+     * @note This is 32-bit as ThreadContext::state is directly used as a futex
+     */
+    enum class ThreadState : u32 {
         NotReady = 0, //!< The thread hasn't yet entered the entry handler
         Running = 1, //!< The thread is currently executing code
         WaitKernel = 2, //!< The thread is currently waiting on the kernel
@@ -139,21 +154,101 @@ namespace skyline {
         Syscall = 1, //!< A linux syscall needs to be called from the guest
         Memcopy = 2, //!< To copy memory from one location to another
         Clone = 3, //!< Use the clone syscall to create a new thread
+        SyscallBatch = 4, //!< Several linux syscalls need to be called from the guest, they're described by ThreadContext::syscalls and their amount is in X0
+    };
+
+    /**
+     * @brief A linux syscall which is run by the guest as a part of ThreadCall::SyscallBatch
+     */
+    struct SyscallDescriptor {
+        u64 number; //!< The number of the syscall
+        u64 arguments[6]; //!< The arguments of the syscall, any unused ones are ignored
+        i64 result; //!< The raw result of the syscall, this is the negated errno on failure and -ECANCELED if it wasn't run due to a prior syscall in the batch failing
+    };
+
+    /**
+     * @brief A sample of the guest's execution taken by the guest profiler
+     */
+    struct ProfileSample {
+        u64 pc; //!< The program counter at the time of the sample
+        u64 lr; //!< The link register at the time of the sample, this is the caller of the sampled function if it hasn't made a call itself yet
     };
 
     /**
      * @brief The context of a thread during kernel calls, it is stored in TLS on each guest thread
      */
     struct ThreadContext {
-        ThreadState state; //!< The state of the guest
+        std::atomic<ThreadState> state; //!< The state of the guest, it is used as a futex to sleep on till it changes
         ThreadCall threadCall; //!< The function to run in the guest process
+        u8 signal; //!< The signal caught by the guest process
         u16 svc; //!< The SVC ID of the current kernel call
-        u32 signal; //!< The signal caught by the guest process
         u64 pc; //!< The program counter register on the guest
         Registers registers; //!< The general purpose registers on the guest
         u64 tpidrroEl0; //!< The value for TPIDRRO_EL0 for the current thread
         u64 tpidrEl0; //!< The value for TPIDR_EL0 for the current thread
         u64 faultAddress; //!< The address a fault has occurred at during guest crash
         u64 sp; //!< The current location of the stack pointer set during guest crash
+        u64 tid; //!< The TID of the guest thread, this is used to service svcGetThreadId on the current thread without entering the kernel
+        u32 svcHistoryIndex; //!< The index in svcHistory that the next SVC will be recorded at
+        u32 _pad0_;
+        u64 svcHistory[constant::SvcHistorySize]; //!< A ring buffer of the most recent SVCs, each entry has the SVC ID in the upper 16 bits and the PC which called it in the lower 48 bits, it is only written to if SVC history is enabled
+        u32 exitTid; //!< The TID of the guest thread, this is set and cleared by the host kernel on thread creation and exit (CLONE_CHILD_SETTID/CLONE_CHILD_CLEARTID) so it can be waited on for the thread to exit
+        u32 _pad1_;
+        SyscallDescriptor syscalls[constant::SyscallBatchSize]; //!< The syscalls of a ThreadCall::SyscallBatch, they're run in order till one of them fails
+        u32 profileInterval; //!< The interval between profiler samples of the process's CPU time in microseconds, profiling is disabled if this is 0
+        u32 profileSampleIndex; //!< The amount of samples that have been written into profileSamples, it's only incremented by the guest thread after the sample has been written
+        ProfileSample profileSamples[constant::ProfileSampleCount]; //!< A ring buffer of the most recent samples of the thread, it's drained by its kernel thread
+        volatile std::atomic<u32> *svcDoorbell; //!< The guest address of the doorbell of the kernel worker pool, SVCs and crashes are announced on it as no host thread waits on this context, this is nullptr if the thread has a dedicated kernel thread
     };
+    static_assert(sizeof(std::atomic<ThreadState>) == sizeof(u32) && std::atomic<ThreadState>::is_always_lock_free);
+    static_assert(offsetof(ThreadContext, registers) == 16 && offsetof(ThreadContext, tpidrroEl0) == 256 && offsetof(ThreadContext, tid) == 288 && offsetof(ThreadContext, svcHistoryIndex) == 296 && offsetof(ThreadContext, svcHistory) == 304); // These offsets are hardcoded into the guest code and patches
+
+    /**
+     * @brief Sleeps on the state of a ThreadContext till it is woken up or the state no longer matches the supplied value
+     * @param timeout The maximum duration to sleep for, it'll sleep indefinitely if this is nullptr
+     * @note This uses a raw syscall as it is used by the guest which cannot call any libc functions
+     * @note The futex cannot be private as ThreadContext is shared between the host and guest process
+     */
+    FORCE_INLINE void FutexWait(volatile std::atomic<ThreadState> &state, ThreadState value, const timespec *timeout = nullptr) {
+        register volatile std::atomic<ThreadState> *x0 asm("x0") = &state;
+        register u64 x1 asm("x1") = FUTEX_WAIT;
+        register u64 x2 asm("x2") = static_cast<u32>(value);
+        register const timespec *x3 asm("x3") = timeout;
+        register u64 x8 asm("x8") = __NR_futex;
+        asm volatile("SVC #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x3), "r"(x8) : "memory");
+    }
+
+    /**
+     * @brief Wakes up all threads sleeping on the state of a ThreadContext
+     * @note This uses a raw syscall as it is used by the guest which cannot call any libc functions
+     */
+    FORCE_INLINE void FutexWake(volatile std::atomic<ThreadState> &state) {
+        register volatile std::atomic<ThreadState> *x0 asm("x0") = &state;
+        register u64 x1 asm("x1") = FUTEX_WAKE;
+        register u64 x2 asm("x2") = INT32_MAX;
+        register u64 x8 asm("x8") = __NR_futex;
+        asm volatile("SVC #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x8) : "memory");
+    }
+
+    /**
+     * @brief Publishes a new state for a ThreadContext with release semantics and wakes up anyone waiting on it
+     */
+    FORCE_INLINE void SetState(volatile ThreadContext *ctx, ThreadState state) {
+        ctx->state.store(state, std::memory_order_release);
+        FutexWake(ctx->state);
+    }
+
+    /**
+     * @brief Increments the doorbell of the kernel worker pool and wakes up a single worker sleeping on it
+     * @note The futex cannot be private as the doorbell is shared between the host and guest process
+     */
+    FORCE_INLINE void RingDoorbell(volatile std::atomic<u32> *doorbell) {
+        doorbell->fetch_add(1, std::memory_order_release);
+
+        register volatile std::atomic<u32> *x0 asm("x0") = doorbell;
+        register u64 x1 asm("x1") = FUTEX_WAKE;
+        register u64 x2 asm("x2") = 1;
+        register u64 x8 asm("x8") = __NR_futex;
+        asm volatile("SVC #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x8) : "memory");
+    }
 }
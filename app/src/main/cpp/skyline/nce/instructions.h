@@ -174,6 +174,44 @@ namespace skyline {
         };
         static_assert(sizeof(BL) == sizeof(u32));
 
+        /**
+         * @brief A compare and branch if nonzero, unlike a compare followed by a conditional branch this doesn't modify the NZCV flags
+         * @url https://developer.arm.com/docs/ddi0596/latest/base-instructions-alphabetic-order/cbnz-compare-and-branch-on-nonzero
+         */
+        struct Cbnz {
+          public:
+            /**
+             * @param testReg The Wn register which is compared against zero
+             * @param offset The relative offset to branch to (Should be 32-bit aligned)
+             */
+            constexpr Cbnz(regs::W testReg, i64 offset) {
+                this->testReg = static_cast<u8>(testReg);
+                this->offset = static_cast<i32>(offset / sizeof(u32));
+                sig = 0x35;
+            }
+
+            /**
+             * @return The offset encoded within the instruction in bytes
+             */
+            constexpr i32 Offset() {
+                return offset * sizeof(u32);
+            }
+
+            constexpr bool Verify() {
+                return (sig == 0x35);
+            }
+
+            union {
+                struct __attribute__((packed)) {
+                    u8 testReg : 5;  //!< 5-bit register which is tested
+                    i32 offset : 19; //!< 19-bit branch offset
+                    u8 sig     : 8;  //!< 8-bit signature (0x35)
+                };
+                u32 raw{};
+            };
+        };
+        static_assert(sizeof(Cbnz) == sizeof(u32));
+
         /**
          * @url https://developer.arm.com/docs/ddi0596/e/base-instructions-alphabetic-order/movz-move-wide-with-zero
          */
@@ -359,6 +397,119 @@ namespace skyline {
         };
         static_assert(sizeof(Mov) == sizeof(u32));
 
+        /**
+         * @url https://developer.arm.com/docs/ddi0596/e/base-instructions-alphabetic-order/umulh-unsigned-multiply-high
+         */
+        struct Umulh {
+          public:
+            /**
+             * @brief Creates a UMULH instruction which stores the upper 64 bits of the 128-bit product of two registers
+             * @param destReg The destination Xn register to store the result in
+             * @param srcReg The first Xn register to multiply
+             * @param mulReg The second Xn register to multiply
+             */
+            constexpr Umulh(regs::X destReg, regs::X srcReg, regs::X mulReg) {
+                this->destReg = static_cast<u8>(destReg);
+                this->srcReg = static_cast<u8>(srcReg);
+                sig0 = 0x1F;
+                o0 = 0;
+                this->mulReg = static_cast<u8>(mulReg);
+                sig1 = 0x4DE;
+            }
+
+            constexpr bool Verify() {
+                return (sig0 == 0x1F) && (o0 == 0) && (sig1 == 0x4DE);
+            }
+
+            union {
+                struct __attribute__((packed)) {
+                    u8 destReg : 5;  //!< 5-bit destination register
+                    u8 srcReg  : 5;  //!< 5-bit first source register
+                    u8 sig0    : 5;  //!< 5-bit signature (0x1F)
+                    u8 o0      : 1;  //!< 1-bit signature (0x0)
+                    u8 mulReg  : 5;  //!< 5-bit second source register
+                    u16 sig1   : 11; //!< 11-bit signature (0x4DE)
+                };
+                u32 raw{};
+            };
+        };
+        static_assert(sizeof(Umulh) == sizeof(u32));
+
+        /**
+         * @url https://developer.arm.com/docs/ddi0596/e/base-instructions-alphabetic-order/mul-multiply-an-alias-of-madd
+         */
+        struct Mul {
+          public:
+            /**
+             * @brief Creates a MUL instruction which stores the lower 64 bits of the product of two registers
+             * @param destReg The destination Xn register to store the result in
+             * @param srcReg The first Xn register to multiply
+             * @param mulReg The second Xn register to multiply
+             */
+            constexpr Mul(regs::X destReg, regs::X srcReg, regs::X mulReg) {
+                this->destReg = static_cast<u8>(destReg);
+                this->srcReg = static_cast<u8>(srcReg);
+                sig0 = 0x1F;
+                o0 = 0;
+                this->mulReg = static_cast<u8>(mulReg);
+                sig1 = 0x4D8;
+            }
+
+            constexpr bool Verify() {
+                return (sig0 == 0x1F) && (o0 == 0) && (sig1 == 0x4D8);
+            }
+
+            union {
+                struct __attribute__((packed)) {
+                    u8 destReg : 5;  //!< 5-bit destination register
+                    u8 srcReg  : 5;  //!< 5-bit first source register
+                    u8 sig0    : 5;  //!< 5-bit addend register (XZR)
+                    u8 o0      : 1;  //!< 1-bit signature (0x0)
+                    u8 mulReg  : 5;  //!< 5-bit second source register
+                    u16 sig1   : 11; //!< 11-bit signature (0x4D8)
+                };
+                u32 raw{};
+            };
+        };
+        static_assert(sizeof(Mul) == sizeof(u32));
+
+        /**
+         * @url https://developer.arm.com/docs/ddi0596/e/base-instructions-alphabetic-order/extr-extract-register
+         */
+        struct Extr {
+          public:
+            /**
+             * @brief Creates an EXTR instruction which extracts 64 bits from the concatenation of two registers
+             * @param destReg The destination Xn register to store the result in
+             * @param highReg The Xn register which forms the upper half of the concatenation
+             * @param lowReg The Xn register which forms the lower half of the concatenation
+             * @param lsb The bit of the concatenation to start extracting from
+             */
+            constexpr Extr(regs::X destReg, regs::X highReg, regs::X lowReg, u8 lsb) {
+                this->destReg = static_cast<u8>(destReg);
+                this->highReg = static_cast<u8>(highReg);
+                this->lsb = lsb;
+                this->lowReg = static_cast<u8>(lowReg);
+                sig = 0x49E;
+            }
+
+            constexpr bool Verify() {
+                return (sig == 0x49E);
+            }
+
+            union {
+                struct __attribute__((packed)) {
+                    u8 destReg : 5;  //!< 5-bit destination register
+                    u8 highReg : 5;  //!< 5-bit upper source register
+                    u8 lsb     : 6;  //!< 6-bit least significant bit to extract from
+                    u8 lowReg  : 5;  //!< 5-bit lower source register
+                    u16 sig    : 11; //!< 11-bit signature (0x49E)
+                };
+                u32 raw{};
+            };
+        };
+        static_assert(sizeof(Extr) == sizeof(u32));
+
         /**
          * @url https://developer.arm.com/docs/ddi0596/e/base-instructions-alphabetic-order/ldr-immediate-load-register-immediate
          */
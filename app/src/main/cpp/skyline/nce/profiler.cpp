@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "profiler.h"
+
+namespace skyline {
+    void GuestProfiler::AddModule(std::string_view name, u64 base, u64 size) {
+        std::lock_guard guard(mutex);
+        auto it{std::upper_bound(modules.begin(), modules.end(), base, [](u64 base, const Module &module) { return base < module.base; })};
+        modules.insert(it, Module{std::string(name), base, size});
+    }
+
+    void GuestProfiler::Collect(ThreadContext *ctx, u32 &index) {
+        u32 end{__atomic_load_n(&ctx->profileSampleIndex, __ATOMIC_ACQUIRE)};
+        if (end == index)
+            return;
+
+        if (end - index > constant::ProfileSampleCount)
+            index = end - constant::ProfileSampleCount;
+
+        std::lock_guard guard(mutex);
+        for (; index != end; index++) {
+            const auto &sample{ctx->profileSamples[index & (constant::ProfileSampleCount - 1)]};
+            samples[{sample.lr, sample.pc}]++;
+        }
+    }
+
+    std::string GuestProfiler::Symbolize(u64 address) {
+        auto it{std::upper_bound(modules.begin(), modules.end(), address, [](u64 address, const Module &module) { return address < module.base; })};
+        if (it != modules.begin() && address - std::prev(it)->base < std::prev(it)->size)
+            return fmt::format("{}+0x{:X}", std::prev(it)->name, address - std::prev(it)->base);
+        return fmt::format("0x{:X}", address);
+    }
+
+    std::string GuestProfiler::GetFoldedStacks() {
+        std::lock_guard guard(mutex);
+
+        // Samples are aggregated by their symbolized stack, so the output is also sorted by module
+        std::map<std::string, u64> stacks;
+        for (const auto &[addresses, count] : samples)
+            stacks[fmt::format("{};{}", Symbolize(addresses.first), Symbolize(addresses.second))] += count;
+
+        std::string folded;
+        for (const auto &[stack, count] : stacks)
+            folded += fmt::format("{} {}\n", stack, count);
+        return folded;
+    }
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <common.h>
+
+namespace skyline {
+    /**
+     * @brief A sampling profiler of guest code, guest threads record their PC and LR on expiry of a timer of the process's CPU time and the samples are collected by their kernel threads
+     * @note The samples are symbolized as offsets into the executables loaded into the process, so they can be matched up with a disassembly of them
+     */
+    class GuestProfiler {
+      private:
+        /**
+         * @brief An executable loaded into the process which samples are attributed to
+         */
+        struct Module {
+            std::string name;
+            u64 base;
+            u64 size;
+        };
+
+        Mutex mutex; //!< Synchronizes access to all members
+        std::vector<Module> modules; //!< The loaded executables, sorted by their base address
+        std::map<std::pair<u64, u64>, u64> samples; //!< The amount of samples of every pair of LR and PC
+
+        /**
+         * @return The name of the module containing the address and the offset into it or the raw address if it isn't in a module, this must be called with the mutex held
+         */
+        std::string Symbolize(u64 address);
+
+      public:
+        static constexpr u32 SampleInterval{1000}; //!< The interval between samples of the CPU time of the process in microseconds (1ms)
+
+        /**
+         * @brief Registers an executable loaded into the process, samples within it are attributed to it
+         */
+        void AddModule(std::string_view name, u64 base, u64 size);
+
+        /**
+         * @brief Collects all samples which have been recorded by a guest thread since the last call
+         * @param index The sample index of the thread which has been read up to, it's updated to the latest index
+         * @note Samples which have been overwritten in the ring buffer prior to being collected are dropped
+         */
+        void Collect(ThreadContext *ctx, u32 &index);
+
+        /**
+         * @return All collected samples in the folded stack format ("caller;callee count" lines) which can be directly used to create a flamegraph
+         * @note The LR is the caller of the sampled function for leaf functions but it can be stale in non-leaf functions, it's only a single frame of context
+         */
+        std::string GetFoldedStacks();
+    };
+}
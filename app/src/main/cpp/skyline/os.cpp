@@ -2,6 +2,7 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include "nce.h"
+#include "gpu.h"
 #include "nce/guest.h"
 #include "kernel/memory.h"
 #include "kernel/types/KProcess.h"
@@ -10,36 +11,115 @@
 #include "loader/nso.h"
 #include "loader/nca.h"
 #include "loader/nsp.h"
+#include "loader/xci.h"
+#include "statistics.h"
+#include "allocation.h"
+#include "benchmark.h"
 #include "os.h"
 
 namespace skyline::kernel {
-    OS::OS(std::shared_ptr<JvmManager> &jvmManager, std::shared_ptr<Logger> &logger, std::shared_ptr<Settings> &settings, const std::string &appFilesPath) : state(this, process, jvmManager, settings, logger), memory(state), serviceManager(state), appFilesPath(appFilesPath) {}
+    OS::OS(std::shared_ptr<JvmManager> &jvmManager, std::shared_ptr<Logger> &logger, std::shared_ptr<Settings> &settings, const std::string &appFilesPath, std::shared_ptr<Benchmark> benchmark) : affinity(settings, logger), performanceHint(settings, logger), scheduler(affinity), state(this, process, jvmManager, settings, logger, std::move(benchmark)), memory(state), serviceManager(state), appFilesPath(appFilesPath) {}
 
     void OS::Execute(int romFd, loader::RomFormat romType) {
-        auto romFile{std::make_shared<vfs::OsBacking>(romFd)};
-        auto keyStore{std::make_shared<crypto::KeyStore>(appFilesPath)};
-
-        if (romType == loader::RomFormat::NRO) {
-            state.loader = std::make_shared<loader::NroLoader>(romFile);
-        } else if (romType == loader::RomFormat::NSO) {
-            state.loader = std::make_shared<loader::NsoLoader>(romFile);
-        } else if (romType == loader::RomFormat::NCA) {
-            state.loader = std::make_shared<loader::NcaLoader>(romFile, keyStore);
-        } else if (romType == loader::RomFormat::NSP) {
-            state.loader = std::make_shared<loader::NspLoader>(romFile, keyStore);
-        } else {
-            throw exception("Unsupported ROM extension.");
+        auto romFile{std::make_shared<vfs::OsBacking>(romFd, false, vfs::Backing::Mode{true, false, false}, true)};
+        std::shared_ptr<crypto::KeyStore> keyStore;
+        {
+            BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::KeyStore);
+            keyStore = std::make_shared<crypto::KeyStore>(appFilesPath);
+        }
+        bool verifyIntegrity{state.settings->GetBool("verify_integrity", false)};
+        state.gpu->pipelineCache.Load(appFilesPath + "/cache/pipeline/"); // This is loaded in the background while the ROM is being loaded
+
+        {
+            BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::Loader);
+            allocation::Scope allocationScope(allocation::Tag::Loader);
+            if (romType == loader::RomFormat::NRO) {
+                state.loader = std::make_shared<loader::NroLoader>(romFile);
+            } else if (romType == loader::RomFormat::NSO) {
+                state.loader = std::make_shared<loader::NsoLoader>(romFile);
+            } else if (romType == loader::RomFormat::NCA) {
+                state.loader = std::make_shared<loader::NcaLoader>(romFile, keyStore, state.threadPool, verifyIntegrity);
+            } else if (romType == loader::RomFormat::NSP || romType == loader::RomFormat::NSZ) {
+                state.loader = std::make_shared<loader::NspLoader>(romFile, keyStore, state.threadPool, verifyIntegrity);
+            } else if (romType == loader::RomFormat::XCI || romType == loader::RomFormat::XCZ) {
+                state.loader = std::make_shared<loader::XciLoader>(romFile, keyStore, state.threadPool, verifyIntegrity);
+            } else {
+                throw exception("Unsupported ROM extension.");
+            }
         }
 
-        process = CreateProcess(constant::BaseAddress, 0, constant::DefStackSize);
-        state.loader->LoadProcessData(process, state);
-        process->InitializeMemory();
+        ApplyProfile();
+
+        process = CreateProcess(constant::DefStackSize);
+        {
+            allocation::Scope allocationScope(allocation::Tag::Loader);
+            process->threads.at(process->pid)->entryPoint = state.loader->LoadProcessData(process, state); // The first executable can be preceded by a branch island, so its .text segment doesn't necessarily start at the base address
+        }
+        {
+            BootTimeline::ScopedTimer timer(state.statistics->boot, BootPhase::ProcessMemory);
+            process->InitializeMemory();
+        }
         process->threads.at(process->pid)->Start(); // The kernel itself is responsible for starting the main thread
 
+        // Blocks are verified as the guest reads them, the rest of the ROM is verified alongside the guest rather than delaying its start
+        std::atomic_bool cancelVerification{};
+        std::thread verificationThread;
+        if (verifyIntegrity) {
+            verificationThread = std::thread([this, &cancelVerification] {
+                pthread_setname_np(pthread_self(), "Sky-Verify");
+                try {
+                    if (state.loader->VerifyIntegrity(cancelVerification))
+                        state.logger->Info("ROM integrity verification finished");
+                    else
+                        state.logger->Warn("ROM integrity verification failed, the ROM may be corrupted");
+                } catch (const std::exception &e) {
+                    state.logger->Warn("ROM integrity verification failed: {}", e.what());
+                }
+            });
+        }
+
         state.nce->Execute();
+
+        cancelVerification = true;
+        if (verificationThread.joinable())
+            verificationThread.join();
+
+        state.gpu->pipelineCache.Save();
+
+        if (serviceManager.profiling) {
+            std::ofstream serviceProfile(appFilesPath + "service_profile.csv");
+            serviceProfile << serviceManager.GetServiceProfile();
+        }
+
+        if (state.nce->profiler) {
+            std::ofstream guestProfile(appFilesPath + "guest_profile.folded");
+            guestProfile << state.nce->profiler->GetFoldedStacks();
+        }
+
+        if (state.benchmark)
+            state.benchmark->WriteReport(*state.statistics);
     }
 
-    std::shared_ptr<type::KProcess> OS::CreateProcess(u64 entry, u64 argument, size_t stackSize) {
+    void OS::ApplyProfile() {
+        auto titleId{state.loader->titleId};
+        if (!titleId || !state.settings->ApplyProfile(fmt::format("{}profiles/{:016X}.xml", appFilesPath, titleId)))
+            return;
+
+        // The components which read these settings were constructed prior to the title being known, so they're reconfigured from the overlaid settings
+        state.logger->configLevel = static_cast<Logger::LogLevel>(std::stoi(state.settings->GetString("log_level")));
+        affinity.ApplySettings(state.settings);
+        state.gpu->ApplySettings();
+        state.audio->ApplySettings();
+
+        state.logger->Info("Applied the performance profile of {:016X}", titleId);
+    }
+
+    std::shared_ptr<type::KProcess> OS::CreateProcess(size_t stackSize) {
+        // The guest can only share our address space if its carve-out is reserved prior to any guest memory being mapped, it falls back to a separate address space otherwise
+        int cloneFlags{CLONE_FILES | CLONE_FS | CLONE_SETTLS | SIGCHLD};
+        if (state.settings->GetBool("shared_address_space", false) && memory.ReserveSharedAddressSpace())
+            cloneFlags |= CLONE_VM;
+
         auto stack{std::make_shared<type::KSharedMemory>(state, memory.stack.address, stackSize, memory::Permission{true, true, false}, memory::states::Stack, MAP_NORESERVE | MAP_STACK, true)};
         stack->guest = stack->kernel;
 
@@ -49,12 +129,12 @@ namespace skyline::kernel {
         auto tlsMem{std::make_shared<type::KSharedMemory>(state, 0, (sizeof(ThreadContext) + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1), memory::Permission{true, true, false}, memory::states::Reserved)};
         tlsMem->guest = tlsMem->kernel;
 
-        auto pid{clone(reinterpret_cast<int (*)(void *)>(&guest::GuestEntry), reinterpret_cast<void *>(stack->guest.address + stackSize), CLONE_FILES | CLONE_FS | CLONE_SETTLS | SIGCHLD, reinterpret_cast<void *>(entry), nullptr, reinterpret_cast<void *>(tlsMem->guest.address))};
+        auto pid{clone(reinterpret_cast<int (*)(void *)>(&guest::GuestEntry), reinterpret_cast<void *>(stack->guest.address + stackSize), cloneFlags, nullptr, nullptr, reinterpret_cast<void *>(tlsMem->guest.address))};
         if (pid == -1)
             throw exception("Call to clone() has failed: {}", strerror(errno));
 
-        state.logger->Debug("Successfully created process with PID: {}", pid);
-        return std::make_shared<kernel::type::KProcess>(state, pid, argument, stack, tlsMem);
+        state.logger->Debug("Successfully created process with PID: {} ({} address space)", pid, memory.IsSharedAddressSpace() ? "Shared" : "Separate");
+        return std::make_shared<kernel::type::KProcess>(state, pid, stack, tlsMem);
     }
 
     void OS::KillThread(pid_t pid) {
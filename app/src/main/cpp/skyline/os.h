@@ -4,6 +4,9 @@
 #pragma once
 
 #include "kernel/memory.h"
+#include "kernel/affinity.h"
+#include "kernel/performance_hint.h"
+#include "kernel/scheduler.h"
 #include "loader/loader.h"
 #include "services/serviceman.h"
 
@@ -13,6 +16,9 @@ namespace skyline::kernel {
      */
     class OS {
       public:
+        AffinityManager affinity;
+        PerformanceHintManager performanceHint;
+        Scheduler scheduler;
         DeviceState state;
         std::shared_ptr<type::KProcess> process;
         service::ServiceManager serviceManager;
@@ -22,9 +28,9 @@ namespace skyline::kernel {
         /**
          * @param logger An instance of the Logger class
          * @param settings An instance of the Settings class
-         * @param window The ANativeWindow object to draw the screen to
+         * @param benchmark The headless benchmark to run the application as, this is nullptr to run it normally
          */
-        OS(std::shared_ptr<JvmManager> &jvmManager, std::shared_ptr<Logger> &logger, std::shared_ptr<Settings> &settings, const std::string &appFilesPath);
+        OS(std::shared_ptr<JvmManager> &jvmManager, std::shared_ptr<Logger> &logger, std::shared_ptr<Settings> &settings, const std::string &appFilesPath, std::shared_ptr<Benchmark> benchmark = nullptr);
 
         /**
          * @brief Execute a particular ROM file. This launches the main process and calls the NCE class to handle execution.
@@ -33,14 +39,19 @@ namespace skyline::kernel {
          */
         void Execute(int romFd, loader::RomFormat romType);
 
+        /**
+         * @brief Applies the performance profile of the loaded title from "profiles/<Title ID>.xml" in the app's files directory, if there's one
+         * @note The profile selects the thread placement, frame limit, resolution scale, frame skip, audio latency and log level, this must be called prior to the guest being started
+         */
+        void ApplyProfile();
+
         /**
          * @brief Creates a new process
-         * @param entry The entry point for the new process
-         * @param argument The argument for the initial function
          * @param stackSize The size of the main stack
          * @return An instance of the KProcess of the created process
+         * @note The entry point of the main thread has to be set prior to starting it, as it's only known once the executable has been loaded into the process
          */
-        std::shared_ptr<type::KProcess> CreateProcess(u64 entry, u64 argument, size_t stackSize);
+        std::shared_ptr<type::KProcess> CreateProcess(size_t stackSize);
 
         /**
          * @brief Kill a particular thread
@@ -30,7 +30,7 @@ namespace skyline::service::account {
 
         SERVICE_DECL(
             SFUNC(0x0, IProfile, Get),
-            SFUNC(0x1, IProfile, GetBase)
+            SFUNC_PURE(0x1, IProfile, GetBase)
         )
     };
 }
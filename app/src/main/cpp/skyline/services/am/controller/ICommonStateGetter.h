@@ -93,10 +93,10 @@ namespace skyline::service::am {
         SERVICE_DECL(
             SFUNC(0x0, ICommonStateGetter, GetEventHandle),
             SFUNC(0x1, ICommonStateGetter, ReceiveMessage),
-            SFUNC(0x5, ICommonStateGetter, GetOperationMode),
-            SFUNC(0x6, ICommonStateGetter, GetPerformanceMode),
+            SFUNC_PURE(0x5, ICommonStateGetter, GetOperationMode),
+            SFUNC_PURE(0x6, ICommonStateGetter, GetPerformanceMode),
             SFUNC(0x9, ICommonStateGetter, GetCurrentFocusState),
-            SFUNC(0x3C, ICommonStateGetter, GetDefaultDisplayResolution)
+            SFUNC_PURE(0x3C, ICommonStateGetter, GetDefaultDisplayResolution)
         )
     };
 }
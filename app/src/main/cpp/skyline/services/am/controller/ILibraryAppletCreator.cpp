@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <kernel/types/KProcess.h>
 #include <services/am/storage/IStorage.h>
 #include <services/am/applet/ILibraryAppletAccessor.h>
 #include "ILibraryAppletCreator.h"
@@ -22,4 +23,16 @@ namespace skyline::service::am {
         manager.RegisterService(std::make_shared<IStorage>(state, manager, size), session, response);
         return {};
     }
+
+    Result ILibraryAppletCreator::CreateTransferMemoryStorage(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto writable{request.Pop<u64>() & 1}; // This is a bool padded to 8 bytes
+        auto size{request.Pop<i64>()};
+
+        if (size < 0)
+            throw exception("Cannot create an IStorage with a negative size");
+
+        auto transferMemory{state.process->GetHandle<type::KTransferMemory>(request.copyHandles.at(0))};
+        manager.RegisterService(std::make_shared<IStorage>(state, manager, transferMemory, static_cast<size_t>(size), writable), session, response);
+        return {};
+    }
 }
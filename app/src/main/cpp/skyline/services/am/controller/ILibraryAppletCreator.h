@@ -25,9 +25,16 @@ namespace skyline::service::am {
          */
         Result CreateStorage(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
+        /**
+         * @brief Creates an IStorage backed by transfer memory, its contents are accessed in-place rather than being copied
+         * @url https://switchbrew.org/wiki/Applet_Manager_services#CreateTransferMemoryStorage
+         */
+        Result CreateTransferMemoryStorage(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
         SERVICE_DECL(
             SFUNC(0x0, ILibraryAppletCreator, CreateLibraryApplet),
-            SFUNC(0xA, ILibraryAppletCreator, CreateStorage)
+            SFUNC(0xA, ILibraryAppletCreator, CreateStorage),
+            SFUNC(0xB, ILibraryAppletCreator, CreateTransferMemoryStorage)
         )
     };
 }
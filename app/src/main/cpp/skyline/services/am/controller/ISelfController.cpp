@@ -2,7 +2,7 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <kernel/types/KProcess.h>
-#include <services/hosbinder/GraphicBufferProducer.h>
+#include <services/hosbinder/display.h>
 #include "ISelfController.h"
 
 namespace skyline::service::am {
@@ -49,12 +49,7 @@ namespace skyline::service::am {
     Result ISelfController::CreateManagedDisplayLayer(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         state.logger->Debug("Creating Managed Layer on Default Display");
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus != hosbinder::LayerStatus::Uninitialized)
-            throw exception("The application is creating more than one layer");
-        producer->layerStatus = hosbinder::LayerStatus::Managed;
-
-        response.Push<u64>(0);
+        response.Push<u64>(hosbinder::display.lock()->CreateLayer());
         return {};
     }
 
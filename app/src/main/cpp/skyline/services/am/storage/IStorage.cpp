@@ -5,7 +5,21 @@
 #include "IStorage.h"
 
 namespace skyline::service::am {
-    IStorage::IStorage(const DeviceState &state, ServiceManager &manager, size_t size) : content(size), BaseService(state, manager) {}
+    IStorage::IStorage(const DeviceState &state, ServiceManager &manager, size_t size) : buffer(size), size(size), BaseService(state, manager) {}
+
+    IStorage::IStorage(const DeviceState &state, ServiceManager &manager, std::shared_ptr<kernel::type::KTransferMemory> pTransferMemory, size_t size, bool writable) : transferMemory(std::move(pTransferMemory)), size(size), writable(writable), BaseService(state, manager) {
+        GetContent(); // The size is validated against the transfer memory upfront so creating the storage fails rather than its first access
+    }
+
+    span<u8> IStorage::GetContent() {
+        if (!transferMemory)
+            return buffer;
+
+        auto memory{transferMemory->GetHostSpan()};
+        if (size > memory.size())
+            throw exception("Cannot access an IStorage of 0x{:X} bytes from transfer memory of 0x{:X} bytes", size, memory.size());
+        return memory.subspan(0, size);
+    }
 
     Result IStorage::Open(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         manager.RegisterService(std::make_shared<IStorageAccessor>(state, manager, shared_from_this()), session, response);
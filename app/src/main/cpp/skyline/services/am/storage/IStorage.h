@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <kernel/types/KTransferMemory.h>
 #include <services/serviceman.h>
 
 namespace skyline::service::am {
@@ -13,12 +14,26 @@ namespace skyline::service::am {
     class IStorage : public BaseService, public std::enable_shared_from_this<IStorage> {
       private:
         size_t offset{}; //!< The current offset within the content for pushing data
+        std::vector<u8> buffer; //!< The container for this IStorage's contents if it isn't backed by transfer memory
+        std::shared_ptr<kernel::type::KTransferMemory> transferMemory; //!< The transfer memory backing this IStorage, if any
+        size_t size; //!< The size of the contents of this IStorage in bytes
 
       public:
-        std::vector<u8> content; //!< The container for this IStorage's contents
+        bool writable{true}; //!< If the contents can be written to by an IStorageAccessor
 
         IStorage(const DeviceState &state, ServiceManager &manager, size_t size);
 
+        /**
+         * @brief Creates an IStorage which accesses the memory of the guest directly rather than holding a copy of it
+         */
+        IStorage(const DeviceState &state, ServiceManager &manager, std::shared_ptr<kernel::type::KTransferMemory> transferMemory, size_t size, bool writable);
+
+        /**
+         * @return The contents of this IStorage, these are accessed in-place for storages backed by transfer memory
+         * @note The span is resolved on every call as the host mapping of transfer memory changes when it's transferred or resized, it must not be retained
+         */
+        span<u8> GetContent();
+
         /**
          * @brief Returns an IStorageAccessor that can read and write data to an IStorage
          */
@@ -29,6 +44,7 @@ namespace skyline::service::am {
          */
         template<typename ValueType>
         inline void Push(const ValueType &value) {
+            auto content{GetContent()};
             if (offset + sizeof(ValueType) > content.size())
                 throw exception("The supplied value cannot fit into the IStorage");
 
@@ -8,32 +8,37 @@ namespace skyline::service::am {
     IStorageAccessor::IStorageAccessor(const DeviceState &state, ServiceManager &manager, std::shared_ptr<IStorage> parent) : parent(parent), BaseService(state, manager) {}
 
     Result IStorageAccessor::GetSize(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        response.Push<i64>(parent->content.size());
+        response.Push<i64>(parent->GetContent().size());
         return {};
     }
 
     Result IStorageAccessor::Write(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto offset{request.Pop<i64>()};
-        auto size{std::min(static_cast<i64>(request.inputBuf.at(0).size()), static_cast<i64>(parent->content.size()) - offset)};
-
-        if (offset > parent->content.size())
+        auto content{parent->GetContent()};
+        if (offset < 0 || offset > content.size())
             return result::OutOfBounds;
 
+        if (!parent->writable)
+            throw exception("Cannot write to a read-only IStorage");
+
+        auto input{request.inputBuf.at(0)};
+        auto size{std::min(input.size(), content.size() - static_cast<size_t>(offset))};
         if (size)
-            request.outputBuf.at(0).copy_from(span(parent->content.data() + offset, size));
+            content.subspan(static_cast<size_t>(offset), size).copy_from(input, size);
 
         return {};
     }
 
     Result IStorageAccessor::Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto offset{request.Pop<i64>()};
-        auto size{std::min(static_cast<i64>(request.inputBuf.at(0).size()), static_cast<i64>(parent->content.size()) - offset)};
-
-        if (offset > parent->content.size())
+        auto content{parent->GetContent()};
+        if (offset < 0 || offset > content.size())
             return result::OutOfBounds;
 
-        if (size > 0)
-            request.outputBuf.at(0).copy_from(span(parent->content.data() + offset, size));
+        auto output{request.outputBuf.at(0)};
+        auto size{std::min(output.size(), content.size() - static_cast<size_t>(offset))};
+        if (size)
+            output.copy_from(content.subspan(static_cast<size_t>(offset), size), size);
 
         return {};
     }
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <os.h>
 #include "ISession.h"
 
 namespace skyline::service::apm {
@@ -10,7 +11,12 @@ namespace skyline::service::apm {
         auto mode{request.Pop<u32>()};
         auto config{request.Pop<u32>()};
         performanceConfig.at(mode) = config;
+        InvalidateResponses();
         state.logger->Info("Performance configuration set to 0x{:X} ({})", config, mode ? "Docked" : "Handheld");
+
+        // Only the configuration of the mode we're emulating affects the clocks, a boost of the other mode would only apply once the mode changes
+        if (mode == static_cast<u32>(state.settings->GetBool("operation_mode")))
+            state.os->performanceHint.SetBoost(IsBoostConfiguration(config));
         return {};
     }
 
@@ -13,11 +13,18 @@ namespace skyline::service::apm {
       private:
         std::array<u32, 2> performanceConfig{0x00010000, 0x00020001}; //!< The performance config for both handheld(0) and docked(1) mode
 
+        /**
+         * @return If the performance configuration is one of the boost modes (0x92220007 - 0x9222000C), these raise the CPU clock to 1785MHz while reducing the GPU clock and are mostly used during loading
+         */
+        static constexpr bool IsBoostConfiguration(u32 config) {
+            return config >= 0x92220007 && config <= 0x9222000C;
+        }
+
       public:
         ISession(const DeviceState &state, ServiceManager &manager);
 
         /**
-         * @brief Sets PerformanceConfig to the given arguments, it doesn't affect anything else
+         * @brief Sets PerformanceConfig to the given arguments, boost modes of the current operation mode are forwarded as performance hints
          * @url https://switchbrew.org/wiki/PPC_services#SetPerformanceConfiguration
          */
         Result SetPerformanceConfiguration(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
@@ -30,7 +37,7 @@ namespace skyline::service::apm {
 
         SERVICE_DECL(
             SFUNC(0x0, ISession, SetPerformanceConfiguration),
-            SFUNC(0x1, ISession, GetPerformanceConfiguration)
+            SFUNC_PURE(0x1, ISession, GetPerformanceConfiguration)
         )
     };
 }
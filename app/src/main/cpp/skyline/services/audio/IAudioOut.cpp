@@ -14,7 +14,7 @@ namespace skyline::service::audio {
     }
 
     Result IAudioOut::GetAudioOutState(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        response.Push(static_cast<u32>(track->playbackState));
+        response.Push(static_cast<u32>(track->playbackState.load()));
         return {};
     }
 
@@ -43,8 +43,11 @@ namespace skyline::service::audio {
         state.logger->Debug("Appending buffer with address: 0x{:X}, size: 0x{:X}", data.sampleBufferPtr, data.sampleSize);
 
         if (sampleRate != constant::SampleRate) {
-            auto resampledBuffer{resampler.ResampleBuffer(span(state.process->GetPointer<i16>(data.sampleBufferPtr), data.sampleSize / sizeof(i16)), static_cast<double>(sampleRate) / constant::SampleRate, channelCount)};
-            track->AppendBuffer(tag, resampledBuffer);
+            auto samples{span(state.process->GetPointer<i16>(data.sampleBufferPtr), data.sampleSize / sizeof(i16))};
+            auto ratio{static_cast<double>(sampleRate) / constant::SampleRate};
+            resampleBuffer.resize(std::max(resampleBuffer.size(), skyline::audio::Resampler::GetMaxOutputSize(samples.size(), ratio, channelCount)));
+            auto resampledSize{resampler.ResampleBuffer(samples, ratio, channelCount, resampleBuffer)};
+            track->AppendBuffer(tag, span(resampleBuffer.data(), resampledSize));
         } else {
             track->AppendBuffer(tag, span(state.process->GetPointer<i16>(data.sampleBufferPtr), data.sampleSize / sizeof(i16)));
         }
@@ -60,15 +63,14 @@ namespace skyline::service::audio {
     }
 
     Result IAudioOut::GetReleasedAudioOutBuffer(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        auto maxCount{static_cast<u32>(request.outputBuf.at(0).size() >> 3)};
-        std::vector<u64> releasedBuffers{track->GetReleasedBuffers(maxCount)};
-        auto count{static_cast<u32>(releasedBuffers.size())};
+        auto &output{request.outputBuf.at(0)};
+        auto releasedBuffers{output.first(util::AlignDown(output.size(), sizeof(u64))).cast<u64>()};
+        auto count{track->GetReleasedBuffers(releasedBuffers)};
 
         // Fill rest of output buffer with zeros
-        releasedBuffers.resize(maxCount, 0);
-        request.outputBuf.at(0).copy_from(releasedBuffers);
+        std::fill(releasedBuffers.begin() + count, releasedBuffers.end(), 0);
 
-        response.Push<u32>(count);
+        response.Push<u32>(static_cast<u32>(count));
         return {};
     }
 
@@ -1,29 +1,108 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <arm_neon.h>
 #include <kernel/types/KProcess.h>
+#include <thread_pool.h>
+#include <trace.h>
+#include <statistics.h>
+#include <allocation.h>
 #include "IAudioRenderer.h"
 
 namespace skyline::service::audio::IAudioRenderer {
+    /**
+     * @brief Accumulates PCM samples scaled by a volume into the mix bus
+     */
+    static void MixSamples(float *mix, const i16 *samples, size_t count, float volume) {
+        size_t index{};
+        for (; index + 8 <= count; index += 8) {
+            auto input{vld1q_s16(samples + index)};
+            auto low{vcvtq_f32_s32(vmovl_s16(vget_low_s16(input)))};
+            auto high{vcvtq_f32_s32(vmovl_high_s16(input))};
+            vst1q_f32(mix + index, vmlaq_n_f32(vld1q_f32(mix + index), low, volume));
+            vst1q_f32(mix + index + 4, vmlaq_n_f32(vld1q_f32(mix + index + 4), high, volume));
+        }
+
+        for (; index < count; index++)
+            mix[index] += samples[index] * volume;
+    }
+
+    /**
+     * @brief Accumulates a single channel of interleaved stereo PCM samples scaled by a volume into a mix buffer
+     */
+    static void MixChannel(float *mix, const i16 *samples, size_t frameCount, size_t channel, float volume) {
+        size_t frame{};
+        for (; frame + 8 <= frameCount; frame += 8) {
+            auto input{vld2q_s16(samples + (frame * constant::ChannelCount)).val[channel]};
+            auto low{vcvtq_f32_s32(vmovl_s16(vget_low_s16(input)))};
+            auto high{vcvtq_f32_s32(vmovl_high_s16(input))};
+            vst1q_f32(mix + frame, vmlaq_n_f32(vld1q_f32(mix + frame), low, volume));
+            vst1q_f32(mix + frame + 4, vmlaq_n_f32(vld1q_f32(mix + frame + 4), high, volume));
+        }
+
+        for (; frame < frameCount; frame++)
+            mix[frame] += samples[(frame * constant::ChannelCount) + channel] * volume;
+    }
+
+    /**
+     * @brief Accumulates a mix buffer scaled by a volume into another one
+     */
+    static void MixBuffer(float *destination, const float *source, float volume) {
+        static_assert(constant::MixBufferSize % 4 == 0);
+        for (size_t index{}; index < constant::MixBufferSize; index += 4)
+            vst1q_f32(destination + index, vmlaq_n_f32(vld1q_f32(destination + index), vld1q_f32(source + index), volume));
+    }
+
     IAudioRenderer::IAudioRenderer(const DeviceState &state, ServiceManager &manager, AudioRendererParameters &parameters)
         : systemEvent(std::make_shared<type::KEvent>(state)), parameters(parameters), BaseService(state, manager) {
         track = state.audio->OpenTrack(constant::ChannelCount, constant::SampleRate, []() {});
         track->Start();
 
         memoryPools.resize(parameters.effectCount + parameters.voiceCount * 4);
-        effects.resize(parameters.effectCount);
-        voices.resize(parameters.voiceCount, Voice(state));
+        effects.resize(parameters.effectCount, Effect(state));
+        mixes.reserve(parameters.subMixCount + 1);
+        voices.resize(parameters.voiceCount, Voice(state, waveBufferCache));
 
         // Fill track with empty samples that we will triple buffer
         track->AppendBuffer(0);
         track->AppendBuffer(1);
         track->AppendBuffer(2);
+
+        renderThread = std::thread(&IAudioRenderer::RenderThread, this);
     }
 
     IAudioRenderer::~IAudioRenderer() {
+        {
+            std::lock_guard guard(mutex);
+            running = false;
+        }
+        renderCondition.notify_one();
+        renderThread.join();
+
         state.audio->CloseTrack(track);
     }
 
+    void IAudioRenderer::RenderThread() {
+        pthread_setname_np(pthread_self(), "Sky-Audren");
+        allocation::Scope allocationScope(allocation::Tag::Audio);
+
+        auto deadline{std::chrono::steady_clock::now()};
+        std::unique_lock lock(mutex);
+        while (running) {
+            try {
+                UpdateAudio();
+            } catch (const std::exception &e) {
+                state.logger->Error("Failed to render audio: {}", e.what());
+            }
+            systemEvent->Signal();
+
+            // The deadline is reset rather than caught up with if the thread was delayed by over a period, so the guest isn't signalled in a burst
+            auto now{std::chrono::steady_clock::now()};
+            deadline = std::max(deadline + RenderPeriod, now - RenderPeriod);
+            renderCondition.wait_until(lock, deadline, [this]() { return !running; });
+        }
+    }
+
     Result IAudioRenderer::GetSampleRate(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         response.Push<u32>(parameters.sampleRate);
         return {};
@@ -40,11 +119,14 @@ namespace skyline::service::audio::IAudioRenderer {
     }
 
     Result IAudioRenderer::GetState(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        std::lock_guard guard(mutex);
         response.Push(static_cast<u32>(playbackState));
         return {};
     }
 
     Result IAudioRenderer::RequestUpdate(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        TRACE_SCOPE("IAudioRenderer::RequestUpdate");
+        std::lock_guard guard(mutex);
         auto input{request.inputBuf.at(0).data()};
 
         auto inputHeader{*reinterpret_cast<UpdateDataHeader *>(input)};
@@ -57,6 +139,8 @@ namespace skyline::service::audio::IAudioRenderer {
         for (size_t i{}; i < memoryPools.size(); i++)
             memoryPools[i].ProcessInput(memoryPoolsIn[i]);
 
+        span voiceChannelResourcesIn(reinterpret_cast<VoiceChannelResourceIn *>(input), inputHeader.voiceResourceSize / sizeof(VoiceChannelResourceIn));
+        voiceChannelResources.assign(voiceChannelResourcesIn.begin(), voiceChannelResourcesIn.end());
         input += inputHeader.voiceResourceSize;
 
         span voicesIn(reinterpret_cast<VoiceIn*>(input), parameters.voiceCount);
@@ -67,9 +151,25 @@ namespace skyline::service::audio::IAudioRenderer {
         span effectsIn(reinterpret_cast<EffectIn*>(input), parameters.effectCount);
         for (u32 i{}; i < effectsIn.size(); i++)
             effects[i].ProcessInput(effectsIn[i]);
+        input += inputHeader.effectSize;
+
+        // The splitter section isn't accounted for by the header and is only present if it starts with its magic, it's skipped as voices aren't routed through splitters
+        if (parameters.splitterCount && reinterpret_cast<SplitterInHeader *>(input)->magic == util::MakeMagic<u32>("SNDH")) {
+            auto splitterHeader{*reinterpret_cast<SplitterInHeader *>(input)};
+            input += sizeof(SplitterInHeader);
+            for (u32 i{}; i < splitterHeader.infoCount; i++)
+                input += sizeof(SplitterInfoIn) + reinterpret_cast<SplitterInfoIn *>(input)->destinationCount * sizeof(u32);
+            input += splitterHeader.destinationCount * sizeof(SplitterDestinationIn);
+        }
 
-        UpdateAudio();
-        systemEvent->Signal();
+        span mixesIn(reinterpret_cast<MixIn *>(input), std::min<size_t>(inputHeader.mixSize / sizeof(MixIn), parameters.subMixCount + 1));
+        input += inputHeader.mixSize;
+        mixes.assign(mixesIn.begin(), mixesIn.end());
+
+        span sinksIn(reinterpret_cast<SinkIn *>(input), std::min<size_t>(inputHeader.sinkSize / sizeof(SinkIn), parameters.sinkCount));
+        sinks.assign(sinksIn.begin(), sinksIn.end());
+
+        UpdateMixes();
 
         UpdateDataHeader outputHeader{
             .revision = constant::RevMagic,
@@ -117,56 +217,210 @@ namespace skyline::service::audio::IAudioRenderer {
         return {};
     }
 
+    void IAudioRenderer::UpdateMixes() {
+        // Mix buffers are allocated to mixes in the order they're supplied in, the final mix is always the first one
+        mixBufferOffsets.resize(mixes.size());
+        u32 bufferCount{};
+        for (size_t index{}; index < mixes.size(); index++) {
+            mixBufferOffsets[index] = bufferCount;
+            if (mixes[index].isInUse)
+                bufferCount += std::min<u32>(mixes[index].bufferCount, constant::MaxMixBuffers);
+        }
+        mixBuffers.resize(bufferCount * constant::MixBufferSize);
+
+        // Submixes are mixed into their destination after all of their own sources, so they're ordered by their distance from the final mix with the furthest ones first
+        std::vector<u32> depths(mixes.size());
+        subMixOrder.clear();
+        for (size_t index{}; index < mixes.size(); index++) {
+            if (!mixes[index].isInUse || mixes[index].mixId == constant::FinalMixId)
+                continue;
+
+            auto mix{&mixes[index]};
+            while (mix && mix->mixId != constant::FinalMixId && depths[index] <= mixes.size()) {
+                mix = FindMix(mix->destinationMixId);
+                depths[index]++;
+            }
+
+            if (mix && depths[index] <= mixes.size())
+                subMixOrder.push_back(index); // Submixes which don't lead into the final mix or are in a cycle can't be heard
+        }
+        std::stable_sort(subMixOrder.begin(), subMixOrder.end(), [&](size_t a, size_t b) { return depths[a] > depths[b]; });
+    }
+
+    MixIn *IAudioRenderer::FindMix(u32 mixId) {
+        for (auto &mix : mixes)
+            if (mix.isInUse && mix.mixId == mixId)
+                return &mix;
+        return nullptr;
+    }
+
+    float *IAudioRenderer::GetMixBuffer(const MixIn &mix, size_t index) {
+        return mixBuffers.data() + (mixBufferOffsets[static_cast<size_t>(&mix - mixes.data())] + index) * constant::MixBufferSize;
+    }
+
     void IAudioRenderer::UpdateAudio() {
-        auto released{track->GetReleasedBuffers(2)};
+        std::array<u64, 3> released;
+        auto count{track->GetReleasedBuffers(released)};
 
-        for (auto &tag : released) {
+        for (size_t index{}; index < count; index++) {
             MixFinalBuffer();
-            track->AppendBuffer(tag, sampleBuffer);
+            track->AppendBuffer(released[index], sampleBuffer);
         }
     }
 
     void IAudioRenderer::MixFinalBuffer() {
-        u32 writtenSamples{};
+        playableVoices.clear();
+        for (auto &voice : voices)
+            if (voice.Playable())
+                playableVoices.push_back(&voice);
+        CullVoices();
+        renderedVoices.resize(playableVoices.size());
+
+        auto startTime{util::GetTimeNs()};
+
+        // Decoding and resampling dominate the cost of rendering voices, every voice only touches its own state so they're rendered concurrently
+        state.threadPool->ParallelFor(playableVoices.size(), [&](size_t index) {
+            renderedVoices[index] = playableVoices[index]->Render();
+        });
+
+        auto finalMix{FindMix(constant::FinalMixId)};
+        if (finalMix && finalMix->bufferCount) {
+            std::fill(mixBuffers.begin(), mixBuffers.end(), 0.0f);
+            for (size_t index{}; index < playableVoices.size(); index++)
+                MixVoice(*playableVoices[index], renderedVoices[index], *finalMix);
+
+            for (auto index : subMixOrder) {
+                auto &subMix{mixes[index]};
+                auto destination{FindMix(subMix.destinationMixId)};
+                for (size_t source{}; source < std::min<u32>(subMix.bufferCount, constant::MaxMixBuffers); source++)
+                    for (size_t target{}; target < std::min<u32>(destination->bufferCount, constant::MaxMixBuffers); target++)
+                        if (auto volume{subMix.volume * subMix.mixVolumes[source][target]}; volume != 0.0f)
+                            MixBuffer(GetMixBuffer(*destination, target), GetMixBuffer(subMix, source), volume);
+            }
 
-        for (auto &voice : voices) {
-            if (!voice.Playable())
-                continue;
+            RenderSink(*finalMix);
+        } else {
+            // Without a final mix there's nothing to route voices with, so they're mixed directly into the output
+            mixBuffer.fill(0);
+            for (size_t index{}; index < playableVoices.size(); index++)
+                MixSamples(mixBuffer.data(), renderedVoices[index].data(), renderedVoices[index].size(), playableVoices[index]->volume);
+        }
 
-            u32 bufferOffset{};
-            u32 pendingSamples{constant::MixBufferSize};
+        if (!playableVoices.empty()) {
+            constexpr double CostSmoothing{0.1}; //!< The weight of the latest measurement in the moving average, this keeps a single slow mix buffer from culling voices
+            auto cost{static_cast<double>(util::GetTimeNs() - startTime) / static_cast<double>(playableVoices.size())};
+            voiceCost = voiceCost ? (voiceCost + (cost - voiceCost) * CostSmoothing) : cost;
+        }
 
-            while (pendingSamples > 0) {
-                u32 voiceBufferOffset{};
-                u32 voiceBufferSize{};
-                auto &voiceSamples{voice.GetBufferData(pendingSamples, voiceBufferOffset, voiceBufferSize)};
+        // Effects are applied to the mix bus in their processing order before it's saturated, so they retain the headroom of floats
+        activeEffects.clear();
+        for (auto &effect : effects)
+            if (effect.Active())
+                activeEffects.push_back(&effect);
+        std::stable_sort(activeEffects.begin(), activeEffects.end(), [](const Effect *a, const Effect *b) { return a->ProcessingOrder() < b->ProcessingOrder(); });
+        for (auto effect : activeEffects)
+            effect->Apply(mixBuffer);
+
+        // The mix bus is saturated into the sample buffer at once, the conversion to integers saturates on overflow
+        static_assert((constant::MixBufferSize * constant::ChannelCount) % 8 == 0);
+        for (size_t index{}; index < sampleBuffer.size(); index += 8) {
+            auto low{vqmovn_s32(vcvtq_s32_f32(vld1q_f32(mixBuffer.data() + index)))};
+            auto high{vqmovn_s32(vcvtq_s32_f32(vld1q_f32(mixBuffer.data() + index + 4)))};
+            vst1q_s16(sampleBuffer.data() + index, vcombine_s16(low, high));
+        }
+    }
+
+    void IAudioRenderer::CullVoices() {
+        size_t voiceLimit{voiceCost ? std::max<size_t>(static_cast<size_t>(DspBudget / voiceCost), 1) : playableVoices.size()};
+        if (playableVoices.size() <= voiceLimit)
+            return;
+
+        // The voices which are the least important or the quietest are culled first, culled voices are paused for this mix buffer as they would be if the DSP dropped them
+        std::stable_sort(playableVoices.begin(), playableVoices.end(), [](const Voice *a, const Voice *b) {
+            return (a->priority != b->priority) ? (a->priority < b->priority) : (a->volume > b->volume);
+        });
+        for (auto it{playableVoices.begin() + static_cast<ssize_t>(voiceLimit)}; it != playableVoices.end(); it++)
+            (*it)->output.voiceDropsCount++;
+
+        auto culledCount{playableVoices.size() - voiceLimit};
+        state.statistics->culledVoices.fetch_add(culledCount, std::memory_order_relaxed);
+        trace::SetCounter("Audio Culled Voices", static_cast<i64>(culledCount));
+        playableVoices.resize(voiceLimit);
+    }
 
-                if (voiceBufferSize == 0)
-                    break;
+    void IAudioRenderer::MixVoice(const Voice &voice, span<const i16> samples, const MixIn &finalMix) {
+        size_t frameCount{samples.size() / constant::ChannelCount};
+        auto mix{FindMix(voice.mixId)};
+        if (!mix) {
+            // Voices which are routed through splitters rather than directly into a mix are mixed into the front channels of the final mix
+            for (size_t channel{}; channel < std::min<size_t>(constant::ChannelCount, finalMix.bufferCount); channel++)
+                MixChannel(GetMixBuffer(finalMix, channel), samples.data(), frameCount, channel, voice.volume);
+            return;
+        }
 
-                pendingSamples -= voiceBufferSize / constant::ChannelCount;
+        for (size_t channel{}; channel < std::min<size_t>(voice.GetChannelCount(), constant::ChannelCount); channel++) {
+            auto resourceId{voice.channelResourceIds[channel]};
+            if (resourceId >= voiceChannelResources.size() || !voiceChannelResources[resourceId].isUsed)
+                continue;
 
-                for (auto index{voiceBufferOffset}; index < voiceBufferOffset + voiceBufferSize; index++) {
-                    if (writtenSamples == bufferOffset) {
-                        sampleBuffer[bufferOffset] = skyline::audio::Saturate<i16, i32>(voiceSamples[index] * voice.volume);
+            auto &resource{voiceChannelResources[resourceId]};
+            for (size_t buffer{}; buffer < std::min<u32>(mix->bufferCount, constant::MaxMixBuffers); buffer++)
+                if (auto volume{voice.volume * resource.mixVolumes[buffer]}; volume != 0.0f)
+                    MixChannel(GetMixBuffer(*mix, buffer), samples.data(), frameCount, channel, volume);
+        }
+    }
 
-                        writtenSamples++;
-                    } else {
-                        sampleBuffer[bufferOffset] = skyline::audio::Saturate<i16, i32>(sampleBuffer[bufferOffset] + (voiceSamples[index] * voice.volume));
-                    }
+    void IAudioRenderer::RenderSink(const MixIn &finalMix) {
+        auto finalBufferCount{std::min<u32>(finalMix.bufferCount, constant::MaxMixBuffers)};
+        const SinkIn *sink{};
+        for (const auto &candidate : sinks) {
+            if (candidate.isInUse && candidate.type == SinkType::Device) {
+                sink = &candidate;
+                break;
+            }
+        }
 
-                    bufferOffset++;
-                }
+        // Every channel of the sink reads from a buffer of the final mix, channels that don't refer to a valid buffer are silent
+        std::array<const float *, constant::SurroundChannelCount> channels{};
+        size_t channelCount{sink ? std::min<size_t>(sink->inputCount, constant::SurroundChannelCount) : constant::ChannelCount};
+        for (size_t channel{}; channel < channelCount; channel++) {
+            auto input{sink ? static_cast<i32>(sink->inputs[channel]) : static_cast<i32>(channel)};
+            channels[channel] = (input >= 0 && static_cast<u32>(input) < finalBufferCount) ? GetMixBuffer(finalMix, static_cast<size_t>(input)) : silence.data();
+        }
+        for (size_t channel{channelCount}; channel < channels.size(); channel++)
+            channels[channel] = silence.data();
+        if (channelCount == 1)
+            channels[1] = channels[0];
+
+        auto volume{finalMix.volume};
+        if (channelCount == constant::SurroundChannelCount) {
+            auto coefficients{sink->downmixEnabled ? sink->downmixCoefficients : skyline::audio::DefaultDownmixCoefficients};
+            for (size_t frame{}; frame < constant::MixBufferSize; frame += 4) {
+                auto center{vmlaq_n_f32(vmulq_n_f32(vld1q_f32(channels[2] + frame), coefficients.center), vld1q_f32(channels[3] + frame), coefficients.lowFrequency)};
+                float32x4x2_t output{
+                    vmlaq_n_f32(vmlaq_n_f32(center, vld1q_f32(channels[0] + frame), coefficients.front), vld1q_f32(channels[4] + frame), coefficients.back),
+                    vmlaq_n_f32(vmlaq_n_f32(center, vld1q_f32(channels[1] + frame), coefficients.front), vld1q_f32(channels[5] + frame), coefficients.back),
+                };
+                output.val[0] = vmulq_n_f32(output.val[0], volume);
+                output.val[1] = vmulq_n_f32(output.val[1], volume);
+                vst2q_f32(mixBuffer.data() + (frame * constant::ChannelCount), output);
+            }
+        } else {
+            for (size_t frame{}; frame < constant::MixBufferSize; frame += 4) {
+                float32x4x2_t output{vmulq_n_f32(vld1q_f32(channels[0] + frame), volume), vmulq_n_f32(vld1q_f32(channels[1] + frame), volume)};
+                vst2q_f32(mixBuffer.data() + (frame * constant::ChannelCount), output);
             }
         }
     }
 
     Result IAudioRenderer::Start(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        std::lock_guard guard(mutex);
         playbackState = skyline::audio::AudioOutState::Started;
         return {};
     }
 
     Result IAudioRenderer::Stop(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        std::lock_guard guard(mutex);
         playbackState = skyline::audio::AudioOutState::Stopped;
         return {};
     }
@@ -3,11 +3,13 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <services/serviceman.h>
 #include <audio.h>
 #include "memory_pool.h"
 #include "effect.h"
 #include "voice.h"
+#include "mix.h"
 #include "revision_info.h"
 
 namespace skyline {
@@ -68,13 +70,68 @@ namespace skyline {
             std::shared_ptr<type::KEvent> systemEvent; //!< The KEvent that is signalled when the DSP has processed all the commands
             std::vector<MemoryPool> memoryPools;
             std::vector<Effect> effects;
+            std::vector<Effect *> activeEffects; //!< The effects which are applied to the current mix buffer in their processing order, this is only a member so its allocation is reused
+            WaveBufferCache waveBufferCache; //!< The cache of processed wave buffers shared by all voices
             std::vector<Voice> voices;
+            std::vector<Voice *> playableVoices; //!< The voices which are mixed into the current mix buffer, this is only a member so its allocation is reused
+            std::vector<span<const i16>> renderedVoices; //!< The rendered samples of every voice in playableVoices
+            static constexpr u64 DspBudget{constant::MixBufferSize * constant::NsInSecond / constant::SampleRate / 2}; //!< The time in nanoseconds that rendering and mixing voices may take per mix buffer, this is half of its duration so the renderer keeps up with playback
+            double voiceCost{}; //!< A moving average of the time in nanoseconds that rendering and mixing a single voice takes
+            std::vector<VoiceChannelResourceIn> voiceChannelResources; //!< The mix volumes of every voice channel
+            std::vector<MixIn> mixes; //!< The final mix followed by all submixes
+            std::vector<u32> mixBufferOffsets; //!< The index of the first mix buffer of every mix in mixBuffers
+            std::vector<size_t> subMixOrder; //!< The indices of all audible submixes in the order they're mixed into their destinations
+            std::vector<float> mixBuffers; //!< The planar mix buffers of all mixes, every buffer is MixBufferSize samples large
+            std::vector<SinkIn> sinks;
+            std::array<float, constant::MixBufferSize> silence{}; //!< A mix buffer of silence for sink channels without a valid input
+            std::array<float, constant::MixBufferSize * constant::ChannelCount> mixBuffer{}; //!< The interleaved stereo output of the device sink, effects are applied to it and it's only saturated after that
             std::array<i16, constant::MixBufferSize * constant::ChannelCount> sampleBuffer{}; //!< The final output data that is appended to the stream
             skyline::audio::AudioOutState playbackState{skyline::audio::AudioOutState::Stopped};
 
+            static constexpr std::chrono::milliseconds RenderPeriod{5}; //!< The period that the DSP renders at, the system event is signalled after every one of them
+            std::mutex mutex; //!< Synchronizes all renderer state between RequestUpdate and the render thread
+            std::condition_variable renderCondition; //!< Signalled when the render thread should exit
+            bool running{true};
+            std::thread renderThread; //!< The thread which renders audio every RenderPeriod regardless of when the guest calls RequestUpdate, it's started last as it accesses all other members
+
+            /**
+             * @brief The loop of the render thread, it refills released track buffers and signals the system event every RenderPeriod until the renderer is destroyed
+             */
+            void RenderThread();
+
+            /**
+             * @brief Updates the mix buffer allocation and the order submixes are mixed in after the mixes were updated by the guest
+             */
+            void UpdateMixes();
+
+            /**
+             * @return The mix with the supplied ID if it's in use
+             */
+            MixIn *FindMix(u32 mixId);
+
+            /**
+             * @return A pointer to the samples of a buffer of the supplied mix
+             */
+            float *GetMixBuffer(const MixIn &mix, size_t index);
+
+            /**
+             * @brief Culls the least important playable voices if rendering all of them is estimated to exceed DspBudget
+             */
+            void CullVoices();
+
+            /**
+             * @brief Mixes every channel of a rendered voice into the buffers of its destination mix with the volumes of its channel resources
+             */
+            void MixVoice(const Voice &voice, span<const i16> samples, const MixIn &finalMix);
+
+            /**
+             * @brief Writes the final mix into the interleaved stereo mix bus through the device sink, 5.1 surround sound is downmixed to stereo
+             */
+            void RenderSink(const MixIn &finalMix);
+
             /**
              * @brief Obtains new sample data from voices and mixes it together into the sample buffer
-             * @return The amount of samples present in the buffer
+             * @note Voices are rendered concurrently on the thread pool but they're mixed in order, so the output is deterministic
              */
             void MixFinalBuffer();
 
@@ -90,7 +147,7 @@ namespace skyline {
             IAudioRenderer(const DeviceState &state, ServiceManager &manager, AudioRendererParameters &parameters);
 
             /**
-             * @brief Closes the audio track
+             * @brief Stops the render thread and closes the audio track
              */
             ~IAudioRenderer();
 
@@ -119,7 +176,7 @@ namespace skyline {
             Result GetState(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
             /**
-             * @brief Updates the audio renderer state and appends new data to playback buffers
+             * @brief Exchanges the parameters of the audio renderer with the guest, the audio itself is rendered by the render thread
              */
             Result RequestUpdate(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
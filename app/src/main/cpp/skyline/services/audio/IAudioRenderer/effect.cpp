@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <cmath>
+#include <arm_neon.h>
+#include <kernel/types/KProcess.h>
+#include "effect.h"
+
+namespace skyline::service::audio::IAudioRenderer {
+    constexpr size_t FramesPerMillisecond{constant::SampleRate / 1000};
+    constexpr u32 MaxDelayTime{5000}; //!< The maximum length of a delay line in milliseconds, this bounds the allocation for guest-supplied parameters
+    constexpr float MaxPreDelay{0.3f}; //!< The maximum delay of the early reflections in seconds
+    constexpr float MaxLateDelay{0.1f}; //!< The maximum delay of the late reverberation relative to the early reflections in seconds
+    constexpr float MaxLineScale{2.0f}; //!< The maximum factor the length of the reverb delay lines can be scaled by
+    constexpr std::array<u32, 4> EarlyTapFrames{240, 461, 709, 1019}; //!< The offsets of the early reflection taps at the default spacing
+    constexpr std::array<float, 4> EarlyTapGains{0.8f, 0.7f, 0.6f, 0.5f};
+    constexpr std::array<u32, 4> LineFrames{1427, 1781, 1973, 2099}; //!< The lengths of the delay lines at the default scale, these are coprime
+    constexpr size_t AllPassFrames{241}; //!< The length of the diffusion all-pass filter
+    constexpr std::array<float, 5> ReverbEarlyScales{0.5f, 1.0f, 1.5f, 2.0f, 0.0f}; //!< The spacing of the early reflection taps for each early mode, the last mode has no early reflections
+    constexpr std::array<float, 5> ReverbLineScales{0.6f, 1.0f, 0.8f, 1.5f, MaxLineScale}; //!< The scale of the delay lines for each late mode
+    constexpr size_t PreDelayFrames{static_cast<size_t>((MaxPreDelay + MaxLateDelay) * constant::SampleRate) + EarlyTapFrames.back() * 2 + 2};
+
+    /**
+     * @return The value of a Q14 fixed-point number
+     */
+    static constexpr float FromQ14(i32 value) {
+        return static_cast<float>(value) / (1 << 14);
+    }
+
+    /**
+     * @return The linear gain corresponding to a gain in millibels
+     */
+    static float FromMillibels(float value) {
+        return std::pow(10.0f, value / 2000.0f);
+    }
+
+    /**
+     * @return A mask selecting the channels of a stereo frame that an effect with the supplied channel count is applied to
+     */
+    static uint32x2_t ChannelMask(size_t channelCount) {
+        return vcreate_u32(channelCount >= 2 ? ~0ULL : (channelCount == 1 ? 0xFFFFFFFFULL : 0ULL));
+    }
+
+    Effect::Effect(const DeviceState &state) : state(state) {}
+
+    void Effect::ProcessInput(const EffectIn &input) {
+        bool reset{input.isNew || input.type != parameters.type};
+        bool changed{reset || std::memcmp(input.raw.data(), parameters.raw.data(), parameters.raw.size()) != 0};
+        parameters = input;
+
+        if (input.isNew)
+            output.state = EffectState::New;
+        else if (input.type != EffectType::Invalid)
+            output.state = input.enabled ? EffectState::Enabled : EffectState::Disabled;
+
+        if (changed && input.type != EffectType::Invalid)
+            Configure(reset);
+    }
+
+    void Effect::Configure(bool reset) {
+        switch (parameters.type) {
+            case EffectType::Delay: {
+                auto &input{parameters.delay};
+                if (reset || !delayState)
+                    delayState.emplace();
+                auto &delay{*delayState};
+
+                size_t frames{std::clamp<u32>(input.delayTimeMax, 1, MaxDelayTime) * FramesPerMillisecond + 1};
+                if (delay.line.size() != frames * constant::ChannelCount) {
+                    delay.line.assign(frames * constant::ChannelCount, 0.0f);
+                    delay.position = 0;
+                }
+
+                delay.delayFrames = std::clamp<size_t>(input.delayTime * FramesPerMillisecond, 1, frames - 1);
+                delay.inGain = FromQ14(input.inGain);
+                delay.feedbackGain = FromQ14(input.feedbackGain);
+                delay.wetGain = FromQ14(input.wetGain);
+                delay.dryGain = FromQ14(input.dryGain);
+                delay.channelSpread = std::clamp(FromQ14(input.channelSpread), 0.0f, 1.0f);
+                delay.lowPassAmount = std::clamp(FromQ14(input.lowPassAmount), 0.0f, 0.99f);
+                break;
+            }
+
+            case EffectType::Reverb: {
+                auto &input{parameters.reverb};
+                auto earlyScale{ReverbEarlyScales[std::min<size_t>(input.earlyMode, ReverbEarlyScales.size() - 1)]};
+                ConfigureReverb(reset, FromQ14(input.preDelay) / 1000.0f, 0.0f, earlyScale, ReverbLineScales[std::min<size_t>(input.lateMode, ReverbLineScales.size() - 1)], FromQ14(input.decayTime));
+
+                auto &reverb{*reverbState};
+                reverb.inputGain = FromQ14(input.baseGain);
+                reverb.earlyGain = earlyScale ? FromQ14(input.earlyGain) : 0.0f;
+                reverb.lateGain = FromQ14(input.lateGain);
+                reverb.wetGain = FromQ14(input.wetGain);
+                reverb.dryGain = FromQ14(input.dryGain);
+                reverb.damping = std::clamp(FromQ14(input.highFrequencyDecayRatio), 0.1f, 1.0f);
+                reverb.diffusion = 0.2f + 0.5f * std::clamp(FromQ14(input.colouration), 0.0f, 1.0f);
+                break;
+            }
+
+            case EffectType::I3dl2Reverb: {
+                auto &input{parameters.i3dl2Reverb};
+                auto density{std::clamp(input.lateReverbDensity, 0.0f, 100.0f) / 100.0f};
+                ConfigureReverb(reset, input.reflectionsDelay, input.lateReverbDelay, 1.0f, 0.5f + density * (MaxLineScale - 0.5f), input.lateReverbDecayTime);
+
+                auto &reverb{*reverbState};
+                reverb.inputGain = FromMillibels(input.roomGain);
+                reverb.earlyGain = FromMillibels(input.reflectionsGain);
+                reverb.lateGain = FromMillibels(input.reverbGain);
+                reverb.wetGain = 1.0f;
+                reverb.dryGain = input.dryGain;
+                reverb.damping = std::clamp(std::clamp(input.lateReverbHfDecayRatio, 0.1f, 1.0f) * FromMillibels(input.roomHfGain), 0.05f, 1.0f);
+                reverb.diffusion = 0.6f * std::clamp(input.lateReverbDiffusion, 0.0f, 100.0f) / 100.0f;
+                break;
+            }
+
+            case EffectType::BiquadFilter: {
+                auto &input{parameters.biquadFilter};
+                if (reset || !biquadState)
+                    biquadState.emplace();
+                auto &filter{*biquadState};
+
+                for (size_t index{}; index < filter.b.size(); index++)
+                    filter.b[index] = FromQ14(input.b[index]);
+                for (size_t index{}; index < filter.a.size(); index++)
+                    filter.a[index] = FromQ14(input.a[index]);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    void Effect::ConfigureReverb(bool reset, float preDelay, float lateDelay, float earlyScale, float lineScale, float decayTime) {
+        if (reset || !reverbState)
+            reverbState.emplace();
+        auto &reverb{*reverbState};
+
+        // The buffers are always allocated for the maximum delays, so changing the parameters never reallocates them
+        if (reverb.preDelay.empty()) {
+            reverb.preDelay.resize(PreDelayFrames);
+            for (size_t index{}; index < ReverbState::LineCount; index++)
+                reverb.lines[index].resize(static_cast<size_t>(LineFrames[index] * MaxLineScale) + 1);
+            reverb.allPass.resize(AllPassFrames * constant::ChannelCount);
+        }
+
+        auto preDelayFrames{static_cast<u32>(std::clamp(preDelay, 0.0f, MaxPreDelay) * constant::SampleRate)};
+        for (size_t index{}; index < ReverbState::LineCount; index++) {
+            reverb.earlyTaps[index] = preDelayFrames + static_cast<u32>(EarlyTapFrames[index] * earlyScale) + 1;
+            reverb.earlyTapGains[index] = EarlyTapGains[index];
+        }
+        reverb.lateTap = reverb.earlyTaps.back() + static_cast<u32>(std::clamp(lateDelay, 0.0f, MaxLateDelay) * constant::SampleRate);
+
+        for (size_t index{}; index < ReverbState::LineCount; index++) {
+            auto length{std::clamp<size_t>(static_cast<size_t>(LineFrames[index] * lineScale), 1, reverb.lines[index].size() - 1)};
+            reverb.lineLengths[index] = length;
+            reverb.lineGains[index] = (decayTime > 0.0f) ? std::pow(10.0f, -3.0f * static_cast<float>(length) / (decayTime * constant::SampleRate)) : 0.0f;
+        }
+    }
+
+    void Effect::ApplyAux(span<float> mix, size_t channelCount) {
+        auto &input{parameters.aux};
+        if (!input.countMax || !input.sendBufferInfoAddress || !input.sendBufferAddress || !input.returnBufferInfoAddress || !input.returnBufferAddress)
+            return;
+
+        size_t count{std::min<size_t>(mix.size() / constant::ChannelCount, input.countMax)};
+        channelCount = std::min<size_t>(channelCount, constant::ChannelCount);
+        for (auto &buffer : auxBuffers)
+            buffer.resize(count);
+
+        // The mix bus is deinterleaved and converted to the 32-bit samples of the aux buffers 4 frames at a time
+        size_t frame{};
+        for (; frame + 4 <= count; frame += 4) {
+            auto frames{vld2q_f32(mix.data() + frame * constant::ChannelCount)};
+            vst1q_s32(auxBuffers[0].data() + frame, vcvtq_s32_f32(frames.val[0]));
+            vst1q_s32(auxBuffers[1].data() + frame, vcvtq_s32_f32(frames.val[1]));
+        }
+        for (; frame < count; frame++)
+            for (size_t channel{}; channel < constant::ChannelCount; channel++)
+                auxBuffers[channel][frame] = static_cast<i32>(mix[frame * constant::ChannelCount + channel]);
+
+        // Every channel has its own ring buffer, a transfer is split in two if it wraps around the end of it
+        std::vector<type::KProcess::MemoryTransfer> transfers;
+        auto addTransfers{[&](u64 address, u32 offset) {
+            for (size_t channel{}; channel < channelCount; channel++) {
+                auto base{address + channel * input.countMax * sizeof(i32)};
+                size_t first{std::min<size_t>(count, input.countMax - offset)};
+                transfers.push_back({auxBuffers[channel].data(), base + offset * sizeof(i32), first * sizeof(i32)});
+                if (first < count)
+                    transfers.push_back({auxBuffers[channel].data() + first, base, (count - first) * sizeof(i32)});
+            }
+        }};
+
+        auto sendInfo{state.process->GetObject<AuxBufferInfo>(input.sendBufferInfoAddress)};
+        u32 writeOffset{sendInfo.writeOffset % input.countMax};
+        addTransfers(input.sendBufferAddress, writeOffset);
+        state.process->WriteMemoryBatch(transfers);
+        state.process->WriteMemory(static_cast<u32>((writeOffset + count) % input.countMax), input.sendBufferInfoAddress + offsetof(AuxBufferInfo, writeOffset));
+
+        transfers.clear();
+        auto returnInfo{state.process->GetObject<AuxBufferInfo>(input.returnBufferInfoAddress)};
+        u32 readOffset{returnInfo.readOffset % input.countMax};
+        addTransfers(input.returnBufferAddress, readOffset);
+        state.process->ReadMemoryBatch(transfers);
+        state.process->WriteMemory(static_cast<u32>((readOffset + count) % input.countMax), input.returnBufferInfoAddress + offsetof(AuxBufferInfo, readOffset));
+
+        // The returned samples replace the channels of the mix bus that were sent
+        frame = 0;
+        for (; frame + 4 <= count; frame += 4) {
+            auto frames{vld2q_f32(mix.data() + frame * constant::ChannelCount)};
+            for (size_t channel{}; channel < channelCount; channel++)
+                frames.val[channel] = vcvtq_f32_s32(vld1q_s32(auxBuffers[channel].data() + frame));
+            vst2q_f32(mix.data() + frame * constant::ChannelCount, frames);
+        }
+        for (; frame < count; frame++)
+            for (size_t channel{}; channel < channelCount; channel++)
+                mix[frame * constant::ChannelCount + channel] = static_cast<float>(auxBuffers[channel][frame]);
+    }
+
+    void Effect::ApplyDelay(span<float> mix, size_t channelCount) {
+        auto &delay{*delayState};
+        auto mask{ChannelMask(channelCount)};
+        size_t frames{delay.line.size() / constant::ChannelCount};
+        auto lowPass{vld1_f32(delay.lowPass.data())};
+
+        // Both channels of a frame are processed together, the feedback is low-pass filtered and spread into the opposite channel by swapping the lanes
+        for (size_t frame{}; frame < mix.size(); frame += constant::ChannelCount) {
+            auto input{vld1_f32(mix.data() + frame)};
+            auto delayed{vld1_f32(delay.line.data() + ((delay.position + frames - delay.delayFrames) % frames) * constant::ChannelCount)};
+
+            auto spread{vmla_n_f32(vmul_n_f32(delayed, 1.0f - delay.channelSpread), vrev64_f32(delayed), delay.channelSpread)};
+            lowPass = vmla_n_f32(vmul_n_f32(spread, delay.feedbackGain * (1.0f - delay.lowPassAmount)), lowPass, delay.lowPassAmount);
+            vst1_f32(delay.line.data() + delay.position * constant::ChannelCount, vmla_n_f32(lowPass, input, delay.inGain));
+            delay.position = (delay.position + 1) % frames;
+
+            auto result{vmla_n_f32(vmul_n_f32(input, delay.dryGain), delayed, delay.wetGain)};
+            vst1_f32(mix.data() + frame, vbsl_f32(mask, result, input));
+        }
+
+        vst1_f32(delay.lowPass.data(), lowPass);
+    }
+
+    void Effect::ApplyReverb(span<float> mix, size_t channelCount) {
+        auto &reverb{*reverbState};
+        auto mask{ChannelMask(channelCount)};
+        auto earlyTapGains{vld1q_f32(reverb.earlyTapGains.data())};
+        auto lineGains{vld1q_f32(reverb.lineGains.data())};
+        auto lowPass{vld1q_f32(reverb.lowPass.data())};
+        auto damping{vdupq_n_f32(reverb.damping)};
+        float32x4_t pairSigns{1.0f, -1.0f, 1.0f, -1.0f};
+        float32x4_t halfSigns{1.0f, 1.0f, -1.0f, -1.0f};
+
+        size_t preDelaySize{reverb.preDelay.size()};
+        auto tap{[&](size_t offset) {
+            return reverb.preDelay[(reverb.preDelayPosition + preDelaySize - offset) % preDelaySize];
+        }};
+
+        for (size_t frame{}; frame < mix.size(); frame += constant::ChannelCount) {
+            auto input{vld1_f32(mix.data() + frame)};
+            reverb.preDelay[reverb.preDelayPosition] = vaddv_f32(input) * 0.5f * reverb.inputGain;
+
+            // The early reflection taps alternate between channels, so the sum of both halves of the vector is the stereo output
+            float32x4_t early{tap(reverb.earlyTaps[0]), tap(reverb.earlyTaps[1]), tap(reverb.earlyTaps[2]), tap(reverb.earlyTaps[3])};
+            early = vmulq_f32(early, earlyTapGains);
+            auto earlyOutput{vadd_f32(vget_low_f32(early), vget_high_f32(early))};
+            auto lateInput{tap(reverb.lateTap)};
+            reverb.preDelayPosition = (reverb.preDelayPosition + 1) % preDelaySize;
+
+            std::array<float, ReverbState::LineCount> lanes;
+            for (size_t index{}; index < ReverbState::LineCount; index++) {
+                auto &line{reverb.lines[index]};
+                lanes[index] = line[(reverb.linePositions[index] + line.size() - reverb.lineLengths[index]) % line.size()];
+            }
+            auto late{vld1q_f32(lanes.data())};
+
+            // The delay lines are damped and fed back through an orthonormal 4x4 Hadamard matrix, which is done with two butterfly stages
+            lowPass = vmlaq_f32(lowPass, vsubq_f32(late, lowPass), damping);
+            auto feedback{vmulq_f32(lowPass, lineGains)};
+            auto pairs{vmlaq_f32(vrev64q_f32(feedback), feedback, pairSigns)};
+            auto mixed{vmulq_n_f32(vmlaq_f32(vextq_f32(pairs, pairs, 2), pairs, halfSigns), 0.5f)};
+            vst1q_f32(lanes.data(), vaddq_f32(mixed, vdupq_n_f32(lateInput)));
+            for (size_t index{}; index < ReverbState::LineCount; index++) {
+                auto &line{reverb.lines[index]};
+                line[reverb.linePositions[index]] = lanes[index];
+                reverb.linePositions[index] = (reverb.linePositions[index] + 1) % line.size();
+            }
+
+            auto lateOutput{vadd_f32(vget_low_f32(late), vget_high_f32(late))};
+            auto wet{vmla_n_f32(vmul_n_f32(earlyOutput, reverb.earlyGain), lateOutput, reverb.lateGain)};
+
+            auto allPassData{reverb.allPass.data() + reverb.allPassPosition * constant::ChannelCount};
+            auto diffused{vmls_n_f32(vld1_f32(allPassData), wet, reverb.diffusion)};
+            vst1_f32(allPassData, vmla_n_f32(wet, diffused, reverb.diffusion));
+            reverb.allPassPosition = (reverb.allPassPosition + 1) % AllPassFrames;
+
+            auto result{vmla_n_f32(vmul_n_f32(input, reverb.dryGain), diffused, reverb.wetGain)};
+            vst1_f32(mix.data() + frame, vbsl_f32(mask, result, input));
+        }
+
+        vst1q_f32(reverb.lowPass.data(), lowPass);
+    }
+
+    void Effect::ApplyBiquadFilter(span<float> mix, size_t channelCount) {
+        auto &filter{*biquadState};
+        auto mask{ChannelMask(channelCount)};
+        auto s0{vld1_f32(filter.s0.data())};
+        auto s1{vld1_f32(filter.s1.data())};
+
+        for (size_t frame{}; frame < mix.size(); frame += constant::ChannelCount) {
+            auto input{vld1_f32(mix.data() + frame)};
+            auto result{vmla_n_f32(s0, input, filter.b[0])};
+            s0 = vmls_n_f32(vmla_n_f32(s1, input, filter.b[1]), result, filter.a[0]);
+            s1 = vmls_n_f32(vmul_n_f32(input, filter.b[2]), result, filter.a[1]);
+            vst1_f32(mix.data() + frame, vbsl_f32(mask, result, input));
+        }
+
+        vst1_f32(filter.s0.data(), s0);
+        vst1_f32(filter.s1.data(), s1);
+    }
+
+    void Effect::Apply(span<float> mix) {
+        switch (parameters.type) {
+            case EffectType::Aux:
+                ApplyAux(mix, parameters.aux.mixBufferCount);
+                break;
+
+            case EffectType::Delay:
+                if (delayState)
+                    ApplyDelay(mix, parameters.delay.channelCount);
+                break;
+
+            case EffectType::Reverb:
+                if (reverbState)
+                    ApplyReverb(mix, parameters.reverb.channelCount);
+                break;
+
+            case EffectType::I3dl2Reverb:
+                if (reverbState)
+                    ApplyReverb(mix, parameters.i3dl2Reverb.channelCount);
+                break;
+
+            case EffectType::BiquadFilter:
+                if (biquadState)
+                    ApplyBiquadFilter(mix, static_cast<size_t>(std::max<i8>(parameters.biquadFilter.channelCount, 0)));
+                break;
+
+            default:
+                break;
+        }
+    }
+}
@@ -3,21 +3,146 @@
 
 #pragma once
 
-#include <common.h>
+#include <audio.h>
 
 namespace skyline::service::audio::IAudioRenderer {
     enum class EffectState : u8 {
         None = 0, //!< The effect isn't being used
         New = 1,
+        Enabled = 2,
+        Disabled = 3,
+    };
+
+    enum class EffectType : u8 {
+        Invalid = 0,
+        BufferMixer = 1,
+        Aux = 2,
+        Delay = 3,
+        Reverb = 4,
+        I3dl2Reverb = 5,
+        BiquadFilter = 6,
+    };
+
+    /**
+     * @note Fields that are specified as Q14 are signed fixed-point numbers with 14 fractional bits
+     */
+    struct AuxParameters {
+        std::array<i8, 0x18> inputs; //!< The mix buffers that are sent to the guest
+        std::array<i8, 0x18> outputs; //!< The mix buffers that the returned samples are written to
+        u32 mixBufferCount; //!< The amount of mix buffers that are sent and returned
+        u32 sampleRate;
+        u32 countMax; //!< The size of the send and return buffers of every mix buffer in samples
+        u32 mixBufferCountMax;
+        u64 sendBufferInfoAddress; //!< The address of the AuxBufferInfo of the send buffer
+        u64 sendBufferAddress; //!< The address of the ring buffer that samples are sent to the guest with
+        u64 returnBufferInfoAddress; //!< The address of the AuxBufferInfo of the return buffer
+        u64 returnBufferAddress; //!< The address of the ring buffer that samples are returned from the guest with
+        u32 mixBufferSampleSize;
+        u32 sampleCount;
+        u32 mixBufferSampleCount;
+    };
+    static_assert(sizeof(AuxParameters) == 0x70);
+
+    /**
+     * @brief The header of an aux ring buffer, the renderer advances the write offset of the send buffer and the read offset of the return buffer
+     */
+    struct AuxBufferInfo {
+        u32 readOffset;
+        u32 writeOffset;
+    };
+
+    struct DelayParameters {
+        std::array<i8, 6> inputs;
+        std::array<i8, 6> outputs;
+        u16 channelCountMax;
+        u16 channelCount;
+        u32 delayTimeMax; //!< The maximum delay in milliseconds, this determines the size of the delay line
+        u32 delayTime; //!< The delay in milliseconds
+        i32 sampleRate; //!< Q14
+        i32 inGain; //!< Q14
+        i32 feedbackGain; //!< Q14
+        i32 wetGain; //!< Q14
+        i32 dryGain; //!< Q14
+        i32 channelSpread; //!< Q14, the fraction of the feedback that is fed into the opposite channel
+        i32 lowPassAmount; //!< Q14, the amount that the feedback is low-pass filtered by
+        u8 parameterState;
+    };
+
+    struct ReverbParameters {
+        std::array<i8, 6> inputs;
+        std::array<i8, 6> outputs;
+        u16 channelCountMax;
+        u16 channelCount;
+        u32 sampleRate;
+        u32 earlyMode; //!< The preset of the early reflection taps
+        i32 earlyGain; //!< Q14
+        i32 preDelay; //!< Q14, the delay before the early reflections in milliseconds
+        u32 lateMode; //!< The preset of the late reverberation delay lines
+        i32 lateGain; //!< Q14
+        i32 decayTime; //!< Q14, the time in seconds till the late reverberation decays by 60dB
+        i32 highFrequencyDecayRatio; //!< Q14, the ratio of the high frequency decay time to the decay time
+        i32 colouration; //!< Q14, the amount of diffusion applied to the reverberation
+        i32 baseGain; //!< Q14, the gain of the input into the reverberation
+        i32 wetGain; //!< Q14
+        i32 dryGain; //!< Q14
+        u8 parameterState;
+    };
+
+    /**
+     * @note All gains other than the dry gain are in millibels
+     */
+    struct I3dl2ReverbParameters {
+        std::array<i8, 6> inputs;
+        std::array<i8, 6> outputs;
+        u16 channelCountMax;
+        u16 channelCount;
+        u32 _pad0_;
+        u32 sampleRate;
+        float roomHfGain;
+        float referenceHfFrequency;
+        float lateReverbDecayTime; //!< The time in seconds till the late reverberation decays by 60dB
+        float lateReverbHfDecayRatio;
+        float roomGain;
+        float reflectionsGain;
+        float reverbGain;
+        float lateReverbDiffusion; //!< The diffusion of the late reverberation in percent
+        float reflectionsDelay; //!< The delay before the early reflections in seconds
+        float lateReverbDelay; //!< The delay of the late reverberation relative to the early reflections in seconds
+        float lateReverbDensity; //!< The modal density of the late reverberation in percent
+        float dryGain;
+        u8 parameterState;
+    };
+
+    struct BiquadFilterParameters {
+        std::array<i8, 6> inputs;
+        std::array<i8, 6> outputs;
+        std::array<i16, 3> b; //!< Q14, the numerator coefficients
+        std::array<i16, 2> a; //!< Q14, the denominator coefficients excluding a0 which is always 1
+        i8 channelCount;
+        u8 parameterState;
     };
 
     /**
      * @brief Input containing information on what effects to use on an audio stream
      */
     struct EffectIn {
-        u8 _unk0_;
+        EffectType type;
         u8 isNew; //!< Whether the effect was used in the previous samples
-        u8 _unk1_[0xBE];
+        u8 enabled;
+        u8 _pad0_;
+        u32 mixId;
+        u64 workBufferAddress;
+        u64 workBufferSize;
+        u32 processingOrder; //!< The order the effect is applied in relative to other effects, this is -1 for unused effects
+        u32 _pad1_;
+        union {
+            AuxParameters aux;
+            DelayParameters delay;
+            ReverbParameters reverb;
+            I3dl2ReverbParameters i3dl2Reverb;
+            BiquadFilterParameters biquadFilter;
+            std::array<u8, 0xA0> raw;
+        };
     };
     static_assert(sizeof(EffectIn) == 0xC0);
 
@@ -31,15 +156,107 @@ namespace skyline::service::audio::IAudioRenderer {
     static_assert(sizeof(EffectOut) == 0x10);
 
     /**
-     * @brief The Effect class stores the state of audio post processing effects
+     * @brief The Effect class stores the state of audio post processing effects and applies them to the mix bus
+     * @note Effects are applied to the interleaved stereo mix bus as a whole as the renderer doesn't route individual mix buffers, the channel count of an effect selects the channels it is applied to
      */
     class Effect {
+      private:
+        /**
+         * @brief The state of a delay line with a stereo ring buffer
+         */
+        struct DelayState {
+            std::vector<float> line; //!< The interleaved stereo ring buffer of the delay line
+            size_t position{}; //!< The index of the frame that is written next
+            size_t delayFrames{}; //!< The length of the delay in frames
+            float inGain, feedbackGain, wetGain, dryGain, channelSpread, lowPassAmount;
+            std::array<float, 2> lowPass{}; //!< The state of the low-pass filter on the feedback
+        };
+
+        /**
+         * @brief The state of a reverb made up of tapped early reflections and a feedback delay network for late reverberation, this is shared by the reverb and I3DL2 reverb effects
+         */
+        struct ReverbState {
+            static constexpr size_t LineCount{4}; //!< The amount of delay lines in the feedback delay network, they're processed in a single vector
+
+            std::vector<float> preDelay; //!< The mono ring buffer that the early reflections and the input of the late reverberation are tapped from
+            size_t preDelayPosition{};
+            std::array<u32, LineCount> earlyTaps{}; //!< The offsets of the early reflection taps in the pre-delay line, these alternate between the left and the right channel
+            std::array<float, LineCount> earlyTapGains{};
+            u32 lateTap{}; //!< The offset of the input of the late reverberation in the pre-delay line
+            std::array<std::vector<float>, LineCount> lines; //!< The ring buffers of the delay lines in the feedback delay network
+            std::array<size_t, LineCount> linePositions{};
+            std::array<size_t, LineCount> lineLengths{}; //!< The lengths of the delay lines in frames, these are coprime to avoid the resonances lining up
+            std::array<float, LineCount> lineGains{}; //!< The gain of every delay line per pass so all of them decay at the same rate
+            std::array<float, LineCount> lowPass{}; //!< The state of the low-pass filters damping the delay lines
+            float damping{1.0f}; //!< The coefficient of the damping low-pass filters, 1 doesn't attenuate high frequencies at all
+            std::vector<float> allPass; //!< The interleaved stereo ring buffer of the diffusion all-pass filter
+            size_t allPassPosition{};
+            float diffusion{};
+            float inputGain, earlyGain, lateGain, wetGain, dryGain;
+        };
+
+        /**
+         * @brief The state of a transposed direct form II biquad filter per channel
+         */
+        struct BiquadState {
+            std::array<float, 3> b{};
+            std::array<float, 2> a{};
+            std::array<float, 2> s0{}, s1{};
+        };
+
+        const DeviceState &state;
+        EffectIn parameters{}; //!< The parameters of the effect from the last update
+        std::optional<DelayState> delayState;
+        std::optional<ReverbState> reverbState;
+        std::optional<BiquadState> biquadState;
+        std::array<std::vector<i32>, constant::ChannelCount> auxBuffers; //!< The samples of every channel that are sent to or returned from the guest by an aux effect
+
+        /**
+         * @brief Sets up the DSP state of the effect from the current parameters, buffers are only reallocated when their size changes
+         * @param reset If the state should be reset entirely rather than only updating the parameters
+         */
+        void Configure(bool reset);
+
+        /**
+         * @brief Configures the reverb state for the supplied parameters, this is the part of Configure shared by both reverb types
+         * @param preDelay The delay of the early reflections in seconds
+         * @param lateDelay The delay of the late reverberation relative to the early reflections in seconds
+         * @param earlyScale The factor the spacing of the early reflection taps is scaled by
+         * @param lineScale The factor the length of the delay lines is scaled by
+         * @param decayTime The time in seconds till the late reverberation decays by 60dB
+         */
+        void ConfigureReverb(bool reset, float preDelay, float lateDelay, float earlyScale, float lineScale, float decayTime);
+
+        void ApplyAux(span<float> mix, size_t channelCount);
+
+        void ApplyDelay(span<float> mix, size_t channelCount);
+
+        void ApplyReverb(span<float> mix, size_t channelCount);
+
+        void ApplyBiquadFilter(span<float> mix, size_t channelCount);
+
       public:
         EffectOut output{};
 
-        inline void ProcessInput(const EffectIn &input) {
-            if (input.isNew)
-                output.state = EffectState::New;
+        Effect(const DeviceState &state);
+
+        void ProcessInput(const EffectIn &input);
+
+        /**
+         * @return If the effect needs to be applied to the mix bus
+         */
+        inline bool Active() const {
+            return parameters.type != EffectType::Invalid && parameters.enabled && parameters.processingOrder != std::numeric_limits<u32>::max();
+        }
+
+        inline u32 ProcessingOrder() const {
+            return parameters.processingOrder;
         }
+
+        /**
+         * @brief Applies the effect to the mix bus in place
+         * @param mix The interleaved stereo mix bus, this isn't saturated yet and is in the range of 16-bit PCM
+         */
+        void Apply(span<float> mix);
     };
 }
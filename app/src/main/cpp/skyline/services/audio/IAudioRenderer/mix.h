@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <audio/downmix.h>
+
+namespace skyline {
+    namespace constant {
+        constexpr u8 MaxMixBuffers{24}; //!< The maximum amount of mix buffers in a single mix
+        constexpr u32 FinalMixId{0}; //!< The ID of the final mix which is output by the sinks
+        constexpr u32 UnusedMixId{std::numeric_limits<u32>::max()}; //!< The mix ID of voices and submixes which aren't routed to a mix
+    }
+
+    namespace service::audio::IAudioRenderer {
+        /**
+         * @brief The volumes that a single channel of a voice is mixed into every buffer of its destination mix with
+         */
+        struct VoiceChannelResourceIn {
+            u32 id;
+            std::array<float, constant::MaxMixBuffers> mixVolumes;
+            u8 isUsed;
+            u8 _pad0_[11];
+        };
+        static_assert(sizeof(VoiceChannelResourceIn) == 0x70);
+
+        /**
+         * @brief A mix which voices and other mixes are accumulated into, every mix other than the final mix is a submix that's routed into another mix
+         */
+        struct MixIn {
+            float volume; //!< The volume applied to all buffers of the mix when it's routed into its destination
+            u32 sampleRate;
+            u32 bufferCount; //!< The amount of mix buffers in this mix
+            u8 isInUse;
+            u8 _pad0_[3];
+            u32 mixId;
+            u32 effectCount;
+            u32 nodeId;
+            u32 _pad1_[2];
+            std::array<std::array<float, constant::MaxMixBuffers>, constant::MaxMixBuffers> mixVolumes; //!< The volume every buffer of this mix is routed into every buffer of the destination mix with
+            u32 destinationMixId;
+            u32 destinationSplitterId;
+            u32 _pad2_;
+        };
+        static_assert(sizeof(MixIn) == 0x930);
+
+        /**
+         * @brief The header of the splitter section which precedes the mixes, this is only present if splitters are used
+         */
+        struct SplitterInHeader {
+            u32 magic; //!< "SNDH"
+            u32 infoCount;
+            u32 destinationCount;
+            u32 _pad0_[5];
+        };
+        static_assert(sizeof(SplitterInHeader) == 0x20);
+
+        /**
+         * @note This is followed by destinationCount destination IDs
+         */
+        struct SplitterInfoIn {
+            u32 magic; //!< "SNDI"
+            u32 id;
+            u32 sampleRate;
+            u32 destinationCount;
+        };
+        static_assert(sizeof(SplitterInfoIn) == 0x10);
+
+        struct SplitterDestinationIn {
+            u32 magic; //!< "SNDD"
+            u32 id;
+            std::array<float, constant::MaxMixBuffers> mixVolumes;
+            u32 mixId;
+            u8 isInUse;
+            u8 _pad0_[3];
+        };
+        static_assert(sizeof(SplitterDestinationIn) == 0x70);
+
+        enum class SinkType : u8 {
+            Invalid = 0,
+            Device = 1,
+            CircularBuffer = 2,
+        };
+
+        struct SinkIn {
+            SinkType type;
+            u8 isInUse;
+            u8 _pad0_[2];
+            u32 nodeId;
+            u64 _pad1_[3];
+            std::array<char, 0x100> name; //!< The name of the device for device sinks
+            u32 inputCount; //!< The amount of channels the sink outputs, 6 channels are 5.1 surround sound
+            std::array<i8, constant::SurroundChannelCount> inputs; //!< The index of the final mix buffer for every channel of the sink
+            u8 _pad2_;
+            u8 downmixEnabled; //!< If downmixCoefficients should be used rather than the defaults
+            skyline::audio::DownmixCoefficients downmixCoefficients;
+            u32 _pad3_;
+        };
+        static_assert(sizeof(SinkIn) == 0x140);
+    }
+}
@@ -1,16 +1,34 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <arm_neon.h>
 #include <kernel/types/KProcess.h>
+#include <os.h>
 #include "voice.h"
 
 namespace skyline::service::audio::IAudioRenderer {
+    /**
+     * @brief Interleaves mono samples into stereo frames by duplicating every sample into both channels
+     */
+    static void UpmixMonoToStereo(const i16 *input, size_t count, i16 *output) {
+        size_t index{};
+        for (; index + 8 <= count; index += 8) {
+            auto samples{vld1q_s16(input + index)};
+            auto frames{vzipq_s16(samples, samples)};
+            vst1q_s16(output + (index * 2), frames.val[0]);
+            vst1q_s16(output + (index * 2) + 8, frames.val[1]);
+        }
+
+        for (; index < count; index++)
+            output[index * 2] = output[(index * 2) + 1] = input[index];
+    }
+
     void Voice::SetWaveBufferIndex(u8 index) {
         bufferIndex = index & 3;
         bufferReload = true;
     }
 
-    Voice::Voice(const DeviceState &state) : state(state) {}
+    Voice::Voice(const DeviceState &state, WaveBufferCache &cache) : state(state), cache(cache) {}
 
     void Voice::ProcessInput(const VoiceIn &input) {
         // Voice no longer in use, reset it
@@ -35,6 +53,7 @@ namespace skyline::service::audio::IAudioRenderer {
 
             format = input.format;
             sampleRate = input.sampleRate;
+            resampler = {};
 
             if (input.channelCount > (input.format == skyline::audio::AudioFormat::ADPCM ? 1 : 2))
                 throw exception("Unsupported voice channel count: {}", input.channelCount);
@@ -46,6 +65,9 @@ namespace skyline::service::audio::IAudioRenderer {
                 state.process->ReadMemory(adpcmCoefficients.data(), input.adpcmCoeffsPosition, input.adpcmCoeffsSize);
 
                 adpcmDecoder = skyline::audio::AdpcmDecoder(adpcmCoefficients);
+                coefficientHash = util::HashMemory(reinterpret_cast<u8 *>(adpcmCoefficients.data()), adpcmCoefficients.size() * sizeof(std::array<i16, 2>));
+            } else {
+                coefficientHash = 0;
             }
 
             SetWaveBufferIndex(static_cast<u8>(input.baseWaveBufferIndex));
@@ -53,49 +75,104 @@ namespace skyline::service::audio::IAudioRenderer {
 
         waveBuffers = input.waveBuffers;
         volume = input.volume;
+        priority = input.priority;
+        mixId = input.destination;
+        std::copy_n(input.voiceChannelResourceIds.begin(), channelResourceIds.size(), channelResourceIds.begin());
         playbackState = input.playbackState;
     }
 
     void Voice::UpdateBuffers() {
         const auto &currentBuffer{waveBuffers.at(bufferIndex)};
 
+        processedSamples = nullptr;
+        currentSamples = {};
         if (currentBuffer.size == 0)
             return;
 
+        auto guestData{state.os->memory.IsHostContiguous(currentBuffer.address, currentBuffer.size) ? state.process->GetPointer<u8>(currentBuffer.address) : nullptr};
+        if (guestData && format == skyline::audio::AudioFormat::Int16 && sampleRate == constant::SampleRate && channelCount == constant::ChannelCount) {
+            // Wave buffers which are already in the output format are mixed directly from guest memory
+            currentSamples = span(reinterpret_cast<const i16 *>(guestData), currentBuffer.size / sizeof(i16));
+            return;
+        }
+
+        WaveBufferCache::Key key{
+            .address = currentBuffer.address,
+            .size = currentBuffer.size,
+            .coefficientHash = coefficientHash,
+            .sampleRate = sampleRate,
+            .channelCount = channelCount,
+            .format = format,
+        };
+        u64 contentHash{};
+        if (guestData) {
+            contentHash = util::HashMemory(guestData, currentBuffer.size);
+            processedSamples = cache.Lookup(key, contentHash);
+            if (processedSamples) {
+                currentSamples = *processedSamples;
+                return; // The decoder and resampler state isn't advanced by a cached buffer, this can only cause a seam of a few samples into the next uncached buffer
+            }
+        }
+
+        // Mono is expanded to stereo by whichever stage writes the final samples, so every sample is only written once
+        static_assert(constant::ChannelCount == 2);
+        bool resample{sampleRate != constant::SampleRate};
+        bool upmix{channelCount == 1};
+
+        span<i16> input; // The samples which are resampled or upmixed into the final samples, this is unused when the decoder writes the final samples
         switch (format) {
-            case skyline::audio::AudioFormat::Int16:
-                samples.resize(currentBuffer.size / sizeof(i16));
-                state.process->ReadMemory(samples.data(), currentBuffer.address, currentBuffer.size);
+            case skyline::audio::AudioFormat::Int16: {
+                size_t count{currentBuffer.size / sizeof(i16)};
+                if (guestData) {
+                    input = span(reinterpret_cast<i16 *>(guestData), count);
+                } else {
+                    decodedSamples.resize(count);
+                    state.process->ReadMemory(decodedSamples.data(), currentBuffer.address, currentBuffer.size);
+                    input = decodedSamples;
+                }
                 break;
+            }
             case skyline::audio::AudioFormat::ADPCM: {
-                samples = adpcmDecoder->Decode(span(state.process->GetPointer<u8>(currentBuffer.address), currentBuffer.size));
+                auto adpcmData{span(state.process->GetPointer<u8>(currentBuffer.address), currentBuffer.size)};
+                auto count{skyline::audio::AdpcmDecoder::GetMaxOutputSize(adpcmData.size())};
+                if (resample) {
+                    decodedSamples.resize(count);
+                    decodedSamples.resize(adpcmDecoder->Decode(adpcmData, decodedSamples));
+                    input = decodedSamples;
+                } else {
+                    samples.resize(count * constant::ChannelCount);
+                    samples.resize(adpcmDecoder->Decode(adpcmData, samples, constant::ChannelCount));
+                }
                 break;
             }
             default:
                 throw exception("Unsupported PCM format used by Voice: {}", format);
         }
 
-        if (sampleRate != constant::SampleRate)
-            samples = resampler.ResampleBuffer(samples, static_cast<double>(sampleRate) / constant::SampleRate, channelCount);
-
-        if (channelCount == 1 && constant::ChannelCount != channelCount) {
-            auto originalSize{samples.size()};
-            samples.resize((originalSize / channelCount) * constant::ChannelCount);
-
-            for (auto monoIndex{originalSize - 1}, targetIndex{samples.size()}; monoIndex > 0; monoIndex--) {
-                auto sample{samples[monoIndex]};
-                for (u8 i{}; i < constant::ChannelCount; i++)
-                    samples[--targetIndex] = sample;
+        if (resample) {
+            auto ratio{static_cast<double>(sampleRate) / constant::SampleRate};
+            samples.resize(skyline::audio::Resampler::GetMaxOutputSize(input.size(), ratio, channelCount) * (upmix ? constant::ChannelCount : 1));
+            samples.resize(resampler.ResampleBuffer(input, ratio, channelCount, samples, upmix));
+        } else if (format == skyline::audio::AudioFormat::Int16) {
+            if (upmix) {
+                samples.resize(input.size() * constant::ChannelCount);
+                UpmixMonoToStereo(input.data(), input.size(), samples.data());
+            } else {
+                samples.assign(input.begin(), input.end());
             }
         }
+
+        // The samples are copied so their allocation can be reused for the next wave buffer, buffers which aren't contiguous in host memory can't be hashed so they aren't cached
+        processedSamples = guestData ? cache.Insert(key, contentHash, samples) : std::make_shared<const std::vector<i16>>(samples);
+        currentSamples = *processedSamples;
     }
 
-    std::vector<i16> &Voice::GetBufferData(u32 maxSamples, u32 &outOffset, u32 &outSize) {
+    span<const i16> Voice::GetBufferData(u32 maxSamples, u32 &outOffset, u32 &outSize) {
         auto &currentBuffer{waveBuffers.at(bufferIndex)};
 
         if (!acquired || playbackState != skyline::audio::AudioOutState::Started) {
             outSize = 0;
-            return samples;
+            return {};
         }
 
         if (bufferReload) {
@@ -103,13 +180,18 @@ namespace skyline::service::audio::IAudioRenderer {
             UpdateBuffers();
         }
 
+        if (currentSamples.empty()) {
+            outSize = 0;
+            return {};
+        }
+
         outOffset = sampleOffset;
-        outSize = std::min(maxSamples * constant::ChannelCount, static_cast<u32>(samples.size() - sampleOffset));
+        outSize = std::min(maxSamples * constant::ChannelCount, static_cast<u32>(currentSamples.size() - sampleOffset));
 
         output.playedSamplesCount += outSize / constant::ChannelCount;
         sampleOffset += outSize;
 
-        if (sampleOffset == samples.size()) {
+        if (sampleOffset == currentSamples.size()) {
             sampleOffset = 0;
 
             if (currentBuffer.lastBuffer)
@@ -121,6 +203,40 @@ namespace skyline::service::audio::IAudioRenderer {
             output.playedWaveBuffersCount++;
         }
 
-        return samples;
+        return currentSamples;
+    }
+
+    span<const i16> Voice::Render() {
+        u32 renderedSize{};
+        u32 pendingSamples{constant::MixBufferSize};
+        span<const i16> firstRegion; // The first region is only copied into renderedSamples if another region follows it
+
+        while (pendingSamples > 0) {
+            u32 bufferOffset{};
+            u32 bufferSize{};
+            auto bufferSamples{GetBufferData(pendingSamples, bufferOffset, bufferSize)};
+
+            if (bufferSize == 0)
+                break;
+
+            pendingSamples -= bufferSize / constant::ChannelCount;
+
+            span<const i16> region(bufferSamples.data() + bufferOffset, bufferSize);
+            if (renderedSize == 0) {
+                firstRegion = region;
+            } else {
+                if (!firstRegion.empty()) {
+                    std::memcpy(renderedSamples.data(), firstRegion.data(), firstRegion.size_bytes());
+                    firstRegion = {};
+                }
+                std::memcpy(renderedSamples.data() + renderedSize, region.data(), region.size_bytes());
+            }
+            renderedSize += bufferSize;
+        }
+
+        // The samples are mixed directly from the wave buffer when a single one covers the entire mix buffer, this avoids any copies for voices which mix from guest memory
+        if (!firstRegion.empty())
+            return firstRegion;
+        return span<const i16>(renderedSamples.data(), renderedSize);
     }
 }
@@ -6,6 +6,8 @@
 #include <audio/resampler.h>
 #include <audio/adpcm_decoder.h>
 #include <audio.h>
+#include "wave_buffer_cache.h"
+#include "mix.h"
 
 namespace skyline::service::audio::IAudioRenderer {
     struct BiquadFilter {
@@ -53,8 +55,8 @@ namespace skyline::service::audio::IAudioRenderer {
         u32 _unk1_;
         u64 adpcmCoeffsPosition;
         u64 adpcmCoeffsSize;
-        u32 destination;
-        u32 _pad0_;
+        u32 destination; //!< The ID of the mix the voice is routed into
+        u32 splitterId;
         std::array<WaveBuffer, 4> waveBuffers;
         std::array<u32, 6> voiceChannelResourceIds;
         u32 _pad1_[6];
@@ -75,8 +77,13 @@ namespace skyline::service::audio::IAudioRenderer {
     class Voice {
       private:
         const DeviceState &state;
+        WaveBufferCache &cache; //!< The cache of processed wave buffers shared by all voices of the renderer
         std::array<WaveBuffer, 4> waveBuffers;
-        std::vector<i16> samples; //!< A vector containing processed sample data
+        std::shared_ptr<const std::vector<i16>> processedSamples; //!< The processed samples of the current wave buffer, these might be shared with the cache and other voices
+        span<const i16> currentSamples; //!< The samples of the current wave buffer, these are in guest memory if the wave buffer didn't need to be processed or in processedSamples otherwise
+        std::vector<i16> samples; //!< A vector which wave buffers are processed into the output format in prior to being inserted into the cache
+        std::vector<i16> decodedSamples; //!< A vector which wave buffers are decoded or read into when they can't be processed into samples directly
+        std::array<i16, constant::MixBufferSize * constant::ChannelCount> renderedSamples{}; //!< The samples which were rendered by the last call to Render(), this is only used when they span multiple regions
         skyline::audio::Resampler resampler; //!< The resampler object used for changing the sample rate of a wave buffer's stream
         std::optional<skyline::audio::AdpcmDecoder> adpcmDecoder;
 
@@ -86,11 +93,12 @@ namespace skyline::service::audio::IAudioRenderer {
         u32 sampleOffset{}; //!< The offset in the sample data of the current wave buffer
         u32 sampleRate{};
         u8 channelCount{};
+        u64 coefficientHash{}; //!< A hash of the ADPCM coefficients, wave buffers decoded with different coefficients are cached separately
         skyline::audio::AudioOutState playbackState{skyline::audio::AudioOutState::Stopped};
         skyline::audio::AudioFormat format{skyline::audio::AudioFormat::Invalid};
 
         /**
-         * @brief Updates the sample buffer with data from the current wave buffer and processes it
+         * @brief Updates the processed samples with data from the current wave buffer, this is looked up in the cache prior to being processed
          */
         void UpdateBuffers();
 
@@ -103,8 +111,11 @@ namespace skyline::service::audio::IAudioRenderer {
       public:
         VoiceOut output{};
         float volume{};
+        u32 priority{}; //!< The priority of the voice when voices are culled, lower values are more important
+        u32 mixId{constant::UnusedMixId}; //!< The ID of the mix the voice is routed into
+        std::array<u32, constant::ChannelCount> channelResourceIds{}; //!< The voice channel resources holding the mix volumes of every channel of the voice
 
-        Voice(const DeviceState &state);
+        Voice(const DeviceState &state, WaveBufferCache &cache);
 
         /**
          * @brief Reads the input voice data from the guest and sets internal data based off it
@@ -115,9 +126,23 @@ namespace skyline::service::audio::IAudioRenderer {
         /**
          * @brief Obtains the voices audio sample data, updating it if required
          * @param maxSamples The maximum amount of samples the output buffer should contain
-         * @return A vector of I16 PCM sample data
+         * @return A span of I16 PCM sample data, this is only valid until the next call
          */
-        std::vector<i16> &GetBufferData(u32 maxSamples, u32 &outOffset, u32 &outSize);
+        span<const i16> GetBufferData(u32 maxSamples, u32 &outOffset, u32 &outSize);
+
+        /**
+         * @brief Renders the voice's samples for the next mix buffer, this decodes and resamples wave buffers as required
+         * @return A span of the rendered samples, this is shorter than the mix buffer if the voice ran out of samples and might point directly into guest memory
+         * @note This only accesses the state of this voice, so multiple voices can be rendered concurrently
+         */
+        span<const i16> Render();
+
+        /**
+         * @return The amount of channels in the voice, mono voices are rendered as stereo with identical channels
+         */
+        inline u8 GetChannelCount() const {
+            return channelCount;
+        }
 
         /**
          * @return If the voice is currently playable
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "wave_buffer_cache.h"
+
+namespace skyline::service::audio::IAudioRenderer {
+    size_t WaveBufferCache::KeyHash::operator()(const Key &key) const {
+        constexpr u64 Prime{0x9E3779B97F4A7C15};
+        u64 hash{key.address};
+        for (u64 value : {key.size, key.coefficientHash, (static_cast<u64>(key.sampleRate) << 16) | (static_cast<u64>(key.channelCount) << 8) | static_cast<u64>(key.format)})
+            hash = std::rotl((hash ^ value) * Prime, 31);
+        return hash;
+    }
+
+    std::shared_ptr<const std::vector<i16>> WaveBufferCache::Lookup(const Key &key, u64 contentHash) {
+        std::lock_guard guard(mutex);
+
+        auto entry{entryMap.find(key)};
+        if (entry == entryMap.end())
+            return nullptr;
+
+        auto iterator{entry->second};
+        if (iterator->contentHash != contentHash) {
+            // The guest has written different data to the wave buffer, the stale entry is dropped so it's reprocessed
+            size -= iterator->samples->size() * sizeof(i16);
+            entries.erase(iterator);
+            entryMap.erase(entry);
+            return nullptr;
+        }
+
+        entries.splice(entries.begin(), entries, iterator);
+        return iterator->samples;
+    }
+
+    std::shared_ptr<const std::vector<i16>> WaveBufferCache::Insert(const Key &key, u64 contentHash, std::vector<i16> samples) {
+        auto processed{std::make_shared<const std::vector<i16>>(std::move(samples))};
+        size_t processedSize{processed->size() * sizeof(i16)};
+        if (processedSize > MaxSize)
+            return processed;
+
+        std::lock_guard guard(mutex);
+
+        auto entry{entryMap.find(key)};
+        if (entry != entryMap.end()) {
+            size -= entry->second->samples->size() * sizeof(i16);
+            entries.erase(entry->second);
+            entryMap.erase(entry);
+        }
+
+        while (size + processedSize > MaxSize) {
+            auto &leastRecent{entries.back()};
+            size -= leastRecent.samples->size() * sizeof(i16);
+            entryMap.erase(leastRecent.key);
+            entries.pop_back();
+        }
+
+        entries.push_front(Entry{key, contentHash, processed});
+        entryMap.emplace(key, entries.begin());
+        size += processedSize;
+
+        return processed;
+    }
+}
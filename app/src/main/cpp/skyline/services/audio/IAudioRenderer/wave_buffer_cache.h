@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <list>
+#include <audio/common.h>
+
+namespace skyline::service::audio::IAudioRenderer {
+    /**
+     * @brief A bounded LRU cache of wave buffers which have been decoded, resampled and upmixed into the output format, this makes replaying looping or repeated sounds nearly free
+     * @note Entries are validated against a hash of the guest data, so a wave buffer which is rewritten by the guest in-place is processed again
+     */
+    class WaveBufferCache {
+      public:
+        /**
+         * @brief The parameters that determine the processed samples of a wave buffer
+         */
+        struct Key {
+            u64 address;
+            u64 size;
+            u64 coefficientHash; //!< A hash of the ADPCM coefficients of the voice, this is 0 for other formats
+            u32 sampleRate;
+            u8 channelCount;
+            skyline::audio::AudioFormat format;
+
+            bool operator==(const Key &) const = default;
+        };
+
+      private:
+        struct KeyHash {
+            size_t operator()(const Key &key) const;
+        };
+
+        struct Entry {
+            Key key;
+            u64 contentHash; //!< The hash of the guest data at the time it was processed
+            std::shared_ptr<const std::vector<i16>> samples;
+        };
+
+        static constexpr size_t MaxSize{16 * 1024 * 1024}; //!< The maximum total size of the processed samples in the cache in bytes, this is around a minute and a half of output
+
+        std::mutex mutex; //!< Synchronizes all access to the cache as voices are rendered concurrently
+        std::list<Entry> entries; //!< All entries in the cache ordered from the most to the least recently used
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entryMap;
+        size_t size{}; //!< The total size of the processed samples in the cache in bytes
+
+      public:
+        /**
+         * @return The processed samples of a wave buffer or nullptr if they aren't in the cache or the guest data has changed since they were processed
+         */
+        std::shared_ptr<const std::vector<i16>> Lookup(const Key &key, u64 contentHash);
+
+        /**
+         * @brief Inserts the processed samples of a wave buffer, evicting the least recently used entries to stay within MaxSize
+         * @return The inserted samples, these are returned even if they're too large to be cached
+         */
+        std::shared_ptr<const std::vector<i16>> Insert(const Key &key, u64 contentHash, std::vector<i16> samples);
+    };
+}
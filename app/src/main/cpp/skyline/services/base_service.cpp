@@ -2,7 +2,7 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <cxxabi.h>
-#include "base_service.h"
+#include "serviceman.h"
 
 namespace skyline::service {
     const std::string &BaseService::GetName() {
@@ -18,19 +18,56 @@ namespace skyline::service {
         return name;
     }
 
+    void BaseService::InvalidateResponses() {
+        std::lock_guard guard(responseCacheMutex);
+        responseCache.clear();
+    }
+
     Result service::BaseService::HandleRequest(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        std::pair<std::function<Result(type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &)>, std::string_view> function;
-        try {
-            function = GetServiceFunction(request.payload->value);
-            state.logger->Debug("Service: {} @ {}", function.second, GetName());
-        } catch (const std::out_of_range &) {
-            state.logger->Warn("Cannot find function in service '{0}': 0x{1:X} ({1})", GetName(), static_cast<u32>(request.payload->value));
+        auto functions{GetServiceFunctions()};
+        auto id{static_cast<u32>(request.payload->value)};
+        auto function{std::lower_bound(functions.begin(), functions.end(), id, [](const ServiceFunctionDescriptor &descriptor, u32 id) {
+            return descriptor.id < id;
+        })};
+        if (function == functions.end() || function->id != id) {
+            state.logger->Warn("Cannot find function in service '{0}': 0x{1:X} ({1})", GetName(), id);
             return {};
         }
+
+        state.logger->Debug("Service: {} @ {}", function->name, GetName());
         try {
-            return function.first(session, request, response);
+            auto start{util::GetTimeNs()};
+
+            // Pure commands are frequently polled, their responses are replayed rather than dispatching the request again when the input payload is identical
+            span<u8> input{request.cmdArg, request.cmdArgSz};
+            bool cacheable{function->pure && request.inputBuf.empty() && request.outputBuf.empty()};
+            if (cacheable) {
+                std::lock_guard guard(responseCacheMutex);
+                for (const auto &cached : responseCache) {
+                    if (cached.id == id && std::equal(cached.input.begin(), cached.input.end(), input.begin(), input.end())) {
+                        response.PushBytes(cached.payload);
+                        if (manager.profiling)
+                            manager.GetThreadStatistics().Record(*this, *function, util::GetTimeNs() - start);
+                        return cached.result;
+                    }
+                }
+            }
+
+            auto result{(this->*function->function)(session, request, response)};
+
+            if (cacheable && response.copyHandles.empty() && response.moveHandles.empty() && response.domainObjects.empty()) {
+                std::lock_guard guard(responseCacheMutex);
+                if (responseCache.size() < MaxCachedResponses) {
+                    auto payload{response.GetPayload()};
+                    responseCache.push_back(CachedResponse{id, std::vector<u8>(input.begin(), input.end()), result, std::vector<u8>(payload.begin(), payload.end())});
+                }
+            }
+
+            if (manager.profiling)
+                manager.GetThreadStatistics().Record(*this, *function, util::GetTimeNs() - start);
+            return result;
         } catch (const std::exception &e) {
-            throw exception("{} (Service: {} @ {})", e.what(), function.second, GetName());
+            throw exception("{} (Service: {} @ {})", e.what(), function->name, GetName());
         }
     }
 }
@@ -5,14 +5,13 @@
 
 #include <kernel/ipc.h>
 
-#define SFUNC(id, Class, Function) std::pair<u32, std::pair<std::function<Result(Class*, type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &)>, std::string_view>>{id, {&Class::Function, #Function}}
-#define SFUNC_BASE(id, Class, BaseClass, Function) std::pair<u32, std::pair<std::function<Result(Class*, type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &)>, std::string_view>>{id, {&CallBaseFunction<Class, BaseClass, decltype(&BaseClass::Function), &BaseClass::Function>, #Function}}
-#define SERVICE_DECL_AUTO(name, value) decltype(value) name = value
-#define SERVICE_DECL(...)                                                                                                                         \
-SERVICE_DECL_AUTO(functions, frz::make_unordered_map({__VA_ARGS__}));                                                                             \
-std::pair<std::function<Result(type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &)>, std::string_view> GetServiceFunction(u32 id) {          \
-    auto& function{functions.at(id)};                                                                                                            \
-    return std::make_pair(std::bind(function.first, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), function.second); \
+#define SFUNC(id, Class, Function) ServiceFunctionDescriptor{id, static_cast<ServiceFunction>(&Class::Function), #Function}
+#define SFUNC_BASE(id, Class, BaseClass, Function) ServiceFunctionDescriptor{id, static_cast<ServiceFunction>(&BaseClass::Function), #Function}
+#define SFUNC_PURE(id, Class, Function) ServiceFunctionDescriptor{id, static_cast<ServiceFunction>(&Class::Function), #Function, true}
+#define SERVICE_DECL(...)                                                                                         \
+static constexpr auto ServiceFunctions{SortServiceFunctions(std::array{__VA_ARGS__})};                            \
+span<const ServiceFunctionDescriptor> GetServiceFunctions() override {                                            \
+    return ServiceFunctions;                                                                                      \
 }
 #define SRVREG(class, ...) std::make_shared<class>(state, manager, ##__VA_ARGS__)
 
@@ -25,6 +24,34 @@ namespace skyline::service {
     using ServiceName = u64; //!< Service names are a maximum of 8 bytes so we use a u64 to store them
 
     class ServiceManager;
+    class BaseService;
+
+    using ServiceFunction = Result (BaseService::*)(type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &); //!< A pointer to a command handler of a service, handlers of derived classes are cast to this
+
+    /**
+     * @brief A single entry in the dispatch table of a service
+     */
+    struct ServiceFunctionDescriptor {
+        u32 id; //!< The command ID of the function
+        ServiceFunction function; //!< The handler for the command
+        std::string_view name; //!< The name of the handler, this is only used for logging
+        bool pure{}; //!< If the response of the command only depends on its input payload and the state of the service, its responses are replayed till the service calls InvalidateResponses
+    };
+
+    /**
+     * @brief Sorts the dispatch table of a service by command ID at compile time so it can be binary searched
+     */
+    template<size_t Size>
+    constexpr std::array<ServiceFunctionDescriptor, Size> SortServiceFunctions(std::array<ServiceFunctionDescriptor, Size> functions) {
+        for (size_t i{1}; i < Size; i++) {
+            for (size_t j{i}; j > 0 && functions[j - 1].id > functions[j].id; j--) {
+                auto function{functions[j]};
+                functions[j] = functions[j - 1];
+                functions[j - 1] = function;
+            }
+        }
+        return functions;
+    }
 
     /**
      * @brief The base class for the HOS service interfaces hosted by sysmodules
@@ -33,36 +60,55 @@ namespace skyline::service {
       private:
         std::string name; //!< The name of the service, it is only assigned after GetName is called and shouldn't be used directly
 
+        /**
+         * @brief The response to a pure command for a specific input payload
+         */
+        struct CachedResponse {
+            u32 id; //!< The command ID of the function
+            std::vector<u8> input; //!< The input payload of the request
+            Result result;
+            std::vector<u8> payload; //!< The output payload of the response
+        };
+
+        static constexpr size_t MaxCachedResponses{0x10}; //!< The maximum amount of responses cached per service, pure commands are rarely called with more distinct inputs than this
+
+        std::mutex responseCacheMutex; //!< Synchronizes access to the response cache as sessions of a service can be used from multiple threads
+        std::vector<CachedResponse> responseCache; //!< The cached responses to all pure commands of the service
+
       protected:
         const DeviceState &state;
         ServiceManager &manager;
 
-        template<typename Class, typename BaseClass, typename BaseFunctionType, BaseFunctionType BaseFunction>
-        static constexpr Result CallBaseFunction(Class* clazz, type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-            return (static_cast<BaseClass*>(clazz)->*BaseFunction)(session, request, response);
-        }
-
       public:
         BaseService(const DeviceState &state, ServiceManager &manager) : state(state), manager(manager) {}
 
+        /**
+         * @brief Drops all cached responses of pure commands, this must be called whenever state which pure commands respond with changes
+         */
+        void InvalidateResponses();
+
         /**
          * @note To be able to extract the name of the underlying class and ensure correct destruction order
          */
         virtual ~BaseService() = default;
 
-        virtual std::pair<std::function<Result(type::KSession &, ipc::IpcRequest &, ipc::IpcResponse &)>, std::string_view> GetServiceFunction(u32 id) {
-            throw std::out_of_range("GetServiceFunction not implemented");
+        /**
+         * @return The dispatch table of the service sorted by command ID, this is generated by SERVICE_DECL
+         */
+        virtual span<const ServiceFunctionDescriptor> GetServiceFunctions() {
+            return {};
         }
 
         /**
          * @return The name of the class
          * @note The lifetime of the returned string is tied to that of the class
+         * @note ServiceManager resolves this when a service is registered, so it's only demangled once and never concurrently from multiple kernel threads
          */
         const std::string &GetName();
 
         /**
          * @brief Handles an IPC Request to a service
          */
-        Result HandleRequest(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);;
+        Result HandleRequest(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
     };
 }
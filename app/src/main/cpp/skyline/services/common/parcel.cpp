@@ -4,39 +4,35 @@
 #include "parcel.h"
 
 namespace skyline::service {
-    Parcel::Parcel(span<u8> buffer, const DeviceState &state, bool hasToken) : state(state) {
+    Parcel::Parcel(span<u8> buffer, const DeviceState &state, bool hasToken) : state(state), buffer(buffer) {
         header = buffer.as<ParcelHeader>();
 
-        if (buffer.size() < (sizeof(ParcelHeader) + header.dataSize + header.objectsSize))
+        if (buffer.size() < (static_cast<size_t>(header.dataOffset) + header.dataSize) || buffer.size() < (static_cast<size_t>(header.objectsOffset) + header.objectsSize))
             throw exception("The size of the parcel according to the header exceeds the specified size");
 
         constexpr u8 tokenLength{0x50}; // The length of the token on BufferQueue parcels
+        size_t tokenSize{hasToken ? tokenLength : 0U};
+        if (header.dataSize < tokenSize)
+            throw exception("The parcel is too small to contain a token");
 
-        data.resize(header.dataSize - (hasToken ? tokenLength : 0));
-        std::memcpy(data.data(), buffer.data() + header.dataOffset + (hasToken ? tokenLength : 0), header.dataSize - (hasToken ? tokenLength : 0));
-
-        objects.resize(header.objectsSize);
-        std::memcpy(objects.data(), buffer.data() + header.objectsOffset, header.objectsSize);
+        data = buffer.subspan(header.dataOffset + tokenSize, header.dataSize - tokenSize);
+        objects = buffer.subspan(header.objectsOffset, header.objectsSize);
     }
 
-    Parcel::Parcel(const DeviceState &state) : state(state) {}
+    Parcel::Parcel(const DeviceState &state, span<u8> buffer) : state(state), buffer(buffer) {
+        if (buffer.size() < sizeof(ParcelHeader))
+            throw exception("The buffer is too small to contain a parcel");
+        data = buffer.subspan(sizeof(ParcelHeader));
+    }
 
-    u64 Parcel::WriteParcel(span<u8> buffer) {
-        header.dataSize = static_cast<u32>(data.size());
+    u64 Parcel::WriteParcel() {
+        header.dataSize = static_cast<u32>(dataOffset);
         header.dataOffset = sizeof(ParcelHeader);
 
-        header.objectsSize = static_cast<u32>(objects.size());
-        header.objectsOffset = sizeof(ParcelHeader) + data.size();
-
-        auto totalSize{sizeof(ParcelHeader) + header.dataSize + header.objectsSize};
-
-        if (buffer.size() < totalSize)
-            throw exception("The size of the parcel exceeds maxSize");
+        header.objectsSize = static_cast<u32>(objectsOffset);
+        header.objectsOffset = static_cast<u32>(sizeof(ParcelHeader) + dataOffset);
 
         buffer.as<ParcelHeader>() = header;
-        std::memcpy(buffer.data() + header.dataOffset, data.data(), data.size());
-        std::memcpy(buffer.data() + header.objectsOffset, objects.data(), objects.size());
-
-        return totalSize;
+        return sizeof(ParcelHeader) + header.dataSize + header.objectsSize;
     }
 }
@@ -21,29 +21,35 @@ namespace skyline::service {
         static_assert(sizeof(ParcelHeader) == 0x10);
 
         const DeviceState &state;
+        span<u8> buffer; //!< The IPC buffer which contains the parcel, it's read from or written to directly without any intermediate copies
+        bool hasObjects{}; //!< If any objects have been written to the parcel, no data can be written after them as they directly follow it
 
       public:
-        std::vector<u8> data;
-        std::vector<u8> objects;
-        size_t dataOffset{}; //!< The offset of the data read from the parcel
+        span<u8> data; //!< The data of the parcel, when writing this covers all of the buffer after the header
+        span<u8> objects; //!< The objects of the parcel, when writing this covers all of the buffer after the written data
+        size_t dataOffset{}; //!< The offset of the data read from or written to the parcel
+        size_t objectsOffset{}; //!< The offset of the objects written to the parcel
 
         /**
-         * @brief This constructor fills in the Parcel object with data from a IPC buffer
+         * @brief This constructor maps the Parcel object onto an IPC buffer which contains a parcel to read from
          * @param buffer The buffer that contains the parcel
          * @param hasToken If the parcel starts with a token, it is skipped if this flag is true
          */
         Parcel(span<u8> buffer, const DeviceState &state, bool hasToken = false);
 
         /**
-         * @brief This constructor is used to create an empty parcel then write to a process
+         * @brief This constructor creates an empty parcel which is written directly into an IPC buffer
+         * @param buffer The buffer to write the parcel to, it is only valid after WriteParcel has been called
          */
-        Parcel(const DeviceState &state);
+        Parcel(const DeviceState &state, span<u8> buffer);
 
         /**
          * @return A reference to an item from the top of data
          */
         template<typename ValueType>
         inline ValueType &Pop() {
+            if (dataOffset + sizeof(ValueType) > data.size())
+                throw exception("Reading past the end of the parcel (0x{:X}/0x{:X})", dataOffset + sizeof(ValueType), data.size());
             ValueType &value{*reinterpret_cast<ValueType *>(data.data() + dataOffset)};
             dataOffset += sizeof(ValueType);
             return value;
@@ -54,12 +60,12 @@ namespace skyline::service {
          */
         template<typename ValueType>
         void Push(const ValueType &value) {
-            data.reserve(data.size() + sizeof(ValueType));
-            auto item{reinterpret_cast<const u8 *>(&value)};
-            for (size_t index{}; sizeof(ValueType) > index; index++) {
-                data.push_back(*item);
-                item++;
-            }
+            if (hasObjects)
+                throw exception("Writing data to a parcel after objects");
+            if (dataOffset + sizeof(ValueType) > data.size())
+                throw exception("The size of the parcel exceeds the size of the buffer (0x{:X}/0x{:X})", dataOffset + sizeof(ValueType), data.size());
+            std::memcpy(data.data() + dataOffset, &value, sizeof(ValueType));
+            dataOffset += sizeof(ValueType);
         }
 
         /**
@@ -67,19 +73,20 @@ namespace skyline::service {
          */
         template<typename ObjectType>
         void PushObject(const ObjectType &object) {
-            objects.reserve(objects.size() + sizeof(ObjectType));
-            auto item{reinterpret_cast<const u8 *>(&object)};
-            for (size_t index{}; sizeof(ObjectType) > index; index++) {
-                objects.push_back(*object);
-                item++;
+            if (!hasObjects) {
+                objects = data.subspan(dataOffset);
+                hasObjects = true;
             }
+            if (objectsOffset + sizeof(ObjectType) > objects.size())
+                throw exception("The size of the parcel exceeds the size of the buffer (0x{:X}/0x{:X})", objectsOffset + sizeof(ObjectType), objects.size());
+            std::memcpy(objects.data() + objectsOffset, &object, sizeof(ObjectType));
+            objectsOffset += sizeof(ObjectType);
         }
 
         /**
-         * @brief Writes the Parcel object out
-         * @param buffer The buffer to write the Parcel object to
+         * @brief Writes the header of the Parcel object into the buffer, the data and objects have already been written to it
          * @return The total size of the message
          */
-        u64 WriteParcel(span<u8> buffer);
+        u64 WriteParcel();
     };
 }
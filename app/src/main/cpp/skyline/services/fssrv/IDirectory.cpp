@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "IDirectory.h"
+
+namespace skyline::service::fssrv {
+    IDirectory::IDirectory(const std::shared_ptr<vfs::Directory> &backing, const DeviceState &state, ServiceManager &manager) : BaseService(state, manager) {
+        auto contents{backing->Read()};
+        entries.resize(contents.size());
+
+        for (size_t index{}; index < contents.size(); index++) {
+            auto &entry{entries[index]};
+            const auto &content{contents[index]};
+
+            entry = {};
+            std::memcpy(entry.name.data(), content.name.data(), std::min(content.name.size(), entry.name.size() - 1));
+            entry.type = static_cast<u8>(content.type);
+            entry.size = content.size;
+        }
+    }
+
+    Result IDirectory::Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto &buffer{request.outputBuf.at(0)};
+
+        // All entries that fit are copied out in a single block as the snapshot is already in the guest's format
+        size_t count{std::min(buffer.size() / sizeof(DirectoryEntry), entries.size() - readIndex)};
+        if (count)
+            std::memcpy(buffer.data(), entries.data() + readIndex, count * sizeof(DirectoryEntry));
+        readIndex += count;
+
+        response.Push<u64>(count);
+        return {};
+    }
+
+    Result IDirectory::GetEntryCount(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        response.Push<u64>(entries.size());
+        return {};
+    }
+}
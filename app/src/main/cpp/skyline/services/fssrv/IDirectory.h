@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <services/serviceman.h>
+#include <vfs/directory.h>
+
+namespace skyline::service::fssrv {
+    /**
+     * @brief IDirectory is an interface for enumerating the contents of a directory
+     * @note The contents are read into a snapshot when the directory is opened, so reads only copy entries out of it
+     * @url https://switchbrew.org/wiki/Filesystem_services#IDirectory
+     */
+    class IDirectory : public BaseService {
+      private:
+        /**
+         * @url https://switchbrew.org/wiki/Filesystem_services#DirectoryEntry
+         */
+        struct DirectoryEntry {
+            std::array<char, 0x301> name; //!< The null-terminated name of the entry
+            u8 attributes;
+            u8 _pad0_[2];
+            u8 type; //!< The vfs::Directory::EntryType of the entry
+            u8 _pad1_[3];
+            u64 size; //!< The size of the file in bytes, this is 0 for directories
+        };
+        static_assert(sizeof(DirectoryEntry) == 0x310);
+
+        std::vector<DirectoryEntry> entries; //!< The entries of the directory in the format that is returned to the guest
+        size_t readIndex{}; //!< The index of the next entry that'll be returned by Read
+
+      public:
+        IDirectory(const std::shared_ptr<vfs::Directory> &backing, const DeviceState &state, ServiceManager &manager);
+
+        /**
+         * @brief Reads as many of the remaining entries as fit into the output buffer
+         * @url https://switchbrew.org/wiki/Filesystem_services#Read_2
+         */
+        Result Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Returns the total amount of entries in the directory
+         * @url https://switchbrew.org/wiki/Filesystem_services#GetEntryCount
+         */
+        Result GetEntryCount(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        SERVICE_DECL(
+            SFUNC(0x0, IDirectory, Read),
+            SFUNC(0x1, IDirectory, GetEntryCount)
+        )
+    };
+}
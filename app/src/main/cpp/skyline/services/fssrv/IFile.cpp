@@ -5,7 +5,7 @@
 #include "IFile.h"
 
 namespace skyline::service::fssrv {
-    IFile::IFile(std::shared_ptr<vfs::Backing> &backing, const DeviceState &state, ServiceManager &manager) : backing(backing), BaseService(state, manager) {}
+    IFile::IFile(std::shared_ptr<vfs::Backing> &backing, std::shared_ptr<ReadAheadThread> readAheadThread, const DeviceState &state, ServiceManager &manager) : backing(backing), readAhead(std::move(readAheadThread)), BaseService(state, manager) {}
 
     Result IFile::Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto readOption{request.Pop<u32>()};
@@ -23,7 +23,9 @@ namespace skyline::service::fssrv {
             return result::InvalidSize;
         }
 
-        response.Push<u32>(static_cast<u32>(backing->Read(request.outputBuf.at(0), offset)));
+        auto read{backing->Read(request.outputBuf.at(0), offset)};
+        readAhead.Read(backing, offset, read);
+        response.Push<u32>(static_cast<u32>(read));
         return {};
     }
 
@@ -57,6 +59,7 @@ namespace skyline::service::fssrv {
     }
 
     Result IFile::Flush(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        backing->Flush();
         return {};
     }
 
@@ -5,6 +5,7 @@
 
 #include <services/serviceman.h>
 #include <vfs/backing.h>
+#include "read_ahead.h"
 
 namespace skyline::service::fssrv {
     /**
@@ -14,9 +15,10 @@ namespace skyline::service::fssrv {
     class IFile : public BaseService {
       private:
         std::shared_ptr<vfs::Backing> backing;
+        ReadAheadTracker readAhead;
 
       public:
-        IFile(std::shared_ptr<vfs::Backing> &backing, const DeviceState &state, ServiceManager &manager);
+        IFile(std::shared_ptr<vfs::Backing> &backing, std::shared_ptr<ReadAheadThread> readAheadThread, const DeviceState &state, ServiceManager &manager);
 
         /**
          * @brief Reads a buffer from a region of an IFile
@@ -29,7 +31,7 @@ namespace skyline::service::fssrv {
         Result Write(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
         /**
-         * @brief Flushes any written data to the IFile on the Switch, however the emulator processes any FS event immediately so this does nothing
+         * @brief Flushes any written data to the IFile, writes may be buffered by the backing till this is called or the IFile is closed
          */
         Result Flush(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
@@ -3,10 +3,11 @@
 
 #include "results.h"
 #include "IFile.h"
+#include "IDirectory.h"
 #include "IFileSystem.h"
 
 namespace skyline::service::fssrv {
-    IFileSystem::IFileSystem(std::shared_ptr<vfs::FileSystem> backing, const DeviceState &state, ServiceManager &manager) : backing(backing), BaseService(state, manager) {}
+    IFileSystem::IFileSystem(std::shared_ptr<vfs::FileSystem> backing, std::shared_ptr<ReadAheadThread> readAheadThread, const DeviceState &state, ServiceManager &manager) : backing(backing), readAheadThread(std::move(readAheadThread)), BaseService(state, manager) {}
 
     Result IFileSystem::CreateFile(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         std::string path{request.inputBuf.at(0).as<char>()};
@@ -41,12 +42,25 @@ namespace skyline::service::fssrv {
         if (file == nullptr)
             return result::UnexpectedFailure;
         else
-            manager.RegisterService(std::make_shared<IFile>(file, state, manager), session, response);
+            manager.RegisterService(std::make_shared<IFile>(file, readAheadThread, state, manager), session, response);
 
         return {};
     }
 
+    Result IFileSystem::OpenDirectory(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        std::string path{request.inputBuf.at(0).as<char>()};
+        auto listMode{request.Pop<vfs::Directory::ListMode>()};
+
+        auto directory{backing->OpenDirectory(path, listMode)};
+        if (directory == nullptr)
+            return result::PathDoesNotExist;
+
+        manager.RegisterService(std::make_shared<IDirectory>(directory, state, manager), session, response);
+        return {};
+    }
+
     Result IFileSystem::Commit(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        backing->Commit();
         return {};
     }
 }
@@ -5,6 +5,7 @@
 
 #include <vfs/filesystem.h>
 #include <services/serviceman.h>
+#include "read_ahead.h"
 
 namespace skyline::service::fssrv {
     /**
@@ -14,9 +15,10 @@ namespace skyline::service::fssrv {
     class IFileSystem : public BaseService {
       private:
         std::shared_ptr<vfs::FileSystem> backing;
+        std::shared_ptr<ReadAheadThread> readAheadThread;
 
       public:
-        IFileSystem(std::shared_ptr<vfs::FileSystem> backing, const DeviceState &state, ServiceManager &manager);
+        IFileSystem(std::shared_ptr<vfs::FileSystem> backing, std::shared_ptr<ReadAheadThread> readAheadThread, const DeviceState &state, ServiceManager &manager);
 
         /**
          * @brief Creates a file at the specified path in the filesystem
@@ -35,6 +37,12 @@ namespace skyline::service::fssrv {
          */
         Result OpenFile(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
+        /**
+         * @brief Returns an IDirectory handle for the requested path
+         * @url https://switchbrew.org/wiki/Filesystem_services#OpenDirectory
+         */
+        Result OpenDirectory(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
         /**
          * @brief Commits all changes to the filesystem
          * @url https://switchbrew.org/wiki/Filesystem_services#Commit
@@ -45,6 +53,7 @@ namespace skyline::service::fssrv {
             SFUNC(0x0, IFileSystem, CreateFile),
             SFUNC(0x7, IFileSystem, GetEntryType),
             SFUNC(0x8, IFileSystem, OpenFile),
+            SFUNC(0x9, IFileSystem, OpenDirectory),
             SFUNC(0xA, IFileSystem, Commit)
         )
     };
@@ -9,7 +9,7 @@
 #include "IFileSystemProxy.h"
 
 namespace skyline::service::fssrv {
-    IFileSystemProxy::IFileSystemProxy(const DeviceState &state, ServiceManager &manager) : BaseService(state, manager) {}
+    IFileSystemProxy::IFileSystemProxy(const DeviceState &state, ServiceManager &manager) : readAheadThread(std::make_shared<ReadAheadThread>()), BaseService(state, manager) {}
 
     Result IFileSystemProxy::SetCurrentProcess(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         process = request.Pop<pid_t>();
@@ -17,7 +17,7 @@ namespace skyline::service::fssrv {
     }
 
     Result IFileSystemProxy::OpenSdCardFileSystem(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        manager.RegisterService(std::make_shared<IFileSystem>(std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/switch/sdmc/"), state, manager), session, response);
+        manager.RegisterService(std::make_shared<IFileSystem>(std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/switch/sdmc/"), readAheadThread, state, manager), session, response);
         return {};
     }
 
@@ -57,7 +57,7 @@ namespace skyline::service::fssrv {
             };
         }()};
 
-        manager.RegisterService(std::make_shared<IFileSystem>(std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/switch" + saveDataPath), state, manager), session, response);
+        manager.RegisterService(std::make_shared<IFileSystem>(std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/switch" + saveDataPath), readAheadThread, state, manager), session, response);
         return {};
 
     }
@@ -66,7 +66,12 @@ namespace skyline::service::fssrv {
         if (!state.loader->romFs)
             return result::NoRomFsAvailable;
 
-        manager.RegisterService(std::make_shared<IStorage>(state.loader->romFs, state, manager), session, response);
+        if (!romFsTrace && state.loader->nacp) {
+            auto cache{std::make_shared<vfs::OsFileSystem>(state.os->appFilesPath + "/cache/access/")};
+            romFsTrace = std::make_shared<AccessTrace>(cache, fmt::format("{:016X}_{:X}", state.loader->nacp->nacpContents.saveDataOwnerId, state.loader->romFs->size), state.loader->romFs);
+        }
+
+        manager.RegisterService(std::make_shared<IStorage>(state.loader->romFs, readAheadThread, romFsTrace, state, manager), session, response);
         return {};
     }
 
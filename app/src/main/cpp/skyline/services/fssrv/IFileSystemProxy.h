@@ -5,6 +5,8 @@
 
 #include <services/account/IAccountServiceForApplication.h>
 #include "IFileSystem.h"
+#include "read_ahead.h"
+#include "access_trace.h"
 
 namespace skyline::service::fssrv {
     enum class SaveDataSpaceId : u64 {
@@ -47,6 +49,10 @@ namespace skyline::service::fssrv {
      * @url https://switchbrew.org/wiki/Filesystem_services#fsp-srv
      */
     class IFileSystemProxy : public BaseService {
+      private:
+        std::shared_ptr<ReadAheadThread> readAheadThread; //!< The thread which prefetches data for every file and storage opened through this interface
+        std::shared_ptr<AccessTrace> romFsTrace; //!< The trace of the reads of the RomFS of the current title, it's created when the RomFS is first opened
+
       public:
         pid_t process{}; //!< The PID as set by SetCurrentProcess
 
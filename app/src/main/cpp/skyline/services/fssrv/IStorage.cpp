@@ -5,7 +5,7 @@
 #include "IStorage.h"
 
 namespace skyline::service::fssrv {
-    IStorage::IStorage(std::shared_ptr<vfs::Backing> &backing, const DeviceState &state, ServiceManager &manager) : backing(backing), BaseService(state, manager) {}
+    IStorage::IStorage(std::shared_ptr<vfs::Backing> &backing, std::shared_ptr<ReadAheadThread> readAheadThread, std::shared_ptr<AccessTrace> trace, const DeviceState &state, ServiceManager &manager) : backing(backing), readAhead(std::move(readAheadThread)), trace(std::move(trace)), BaseService(state, manager) {}
 
     Result IStorage::Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto offset{request.Pop<i64>()};
@@ -21,7 +21,10 @@ namespace skyline::service::fssrv {
             return result::InvalidSize;
         }
 
-        backing->Read(request.outputBuf.at(0), offset);
+        auto read{backing->Read(request.outputBuf.at(0), offset)};
+        readAhead.Read(backing, offset, read);
+        if (trace)
+            trace->Read(offset, read);
         return {};
     }
 
@@ -5,6 +5,8 @@
 
 #include <services/serviceman.h>
 #include <vfs/backing.h>
+#include "read_ahead.h"
+#include "access_trace.h"
 
 namespace skyline::service::fssrv {
     /**
@@ -14,9 +16,11 @@ namespace skyline::service::fssrv {
     class IStorage : public BaseService {
       private:
         std::shared_ptr<vfs::Backing> backing;
+        ReadAheadTracker readAhead;
+        std::shared_ptr<AccessTrace> trace; //!< The trace recording or replaying the reads of the backing, this is nullptr if its reads aren't traced
 
       public:
-        IStorage(std::shared_ptr<vfs::Backing> &backing, const DeviceState &state, ServiceManager &manager);
+        IStorage(std::shared_ptr<vfs::Backing> &backing, std::shared_ptr<ReadAheadThread> readAheadThread, std::shared_ptr<AccessTrace> trace, const DeviceState &state, ServiceManager &manager);
 
         /**
          * @brief Reads a buffer from a region of an IStorage
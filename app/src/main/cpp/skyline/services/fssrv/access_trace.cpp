@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "access_trace.h"
+
+namespace skyline::service::fssrv {
+    AccessTrace::AccessTrace(std::shared_ptr<vfs::OsFileSystem> cache, std::string name, std::shared_ptr<vfs::Backing> backing) : cache(std::move(cache)), path(std::move(name)), backing(std::move(backing)), recording(true) {
+        try {
+            if (this->cache->FileExists(path)) {
+                auto file{this->cache->OpenFile(path)};
+                auto header{file->Read<TraceHeader>()};
+                if (header.magic == TraceMagic && header.version == TraceVersion && header.backingSize == this->backing->size && header.accessCount <= MaxAccessCount && file->size == sizeof(TraceHeader) + (header.accessCount * sizeof(Access))) {
+                    accesses.resize(header.accessCount);
+                    file->Read(span(reinterpret_cast<u8 *>(accesses.data()), accesses.size() * sizeof(Access)), sizeof(TraceHeader));
+                    recording = false;
+                }
+            }
+        } catch (const std::exception &) {
+            // A trace that can't be read is just recorded again
+            accesses.clear();
+        }
+
+        if (!recording)
+            replayThread = std::thread(&AccessTrace::Replay, this);
+    }
+
+    AccessTrace::~AccessTrace() {
+        if (recording) {
+            Save();
+            return;
+        }
+
+        {
+            std::lock_guard guard(mutex);
+            running = false;
+        }
+        replayCondition.notify_all();
+        replayThread.join();
+    }
+
+    void AccessTrace::Save() {
+        if (accesses.empty())
+            return;
+
+        try {
+            TraceHeader header{
+                .magic = TraceMagic,
+                .version = TraceVersion,
+                .backingSize = backing->size,
+                .accessCount = accesses.size(),
+            };
+
+            cache->CreateFile(path, sizeof(TraceHeader) + (accesses.size() * sizeof(Access)));
+            auto file{cache->OpenFile(path, {false, true, false})};
+            file->Write(span(reinterpret_cast<u8 *>(accesses.data()), accesses.size() * sizeof(Access)), sizeof(TraceHeader));
+            file->Write(span(reinterpret_cast<u8 *>(&header), sizeof(TraceHeader))); // The header is written last so an interrupted write never results in a valid trace file
+        } catch (const std::exception &) {
+            // The trace is only an optimization, it'll just be recorded again on the next boot
+        }
+    }
+
+    void AccessTrace::Replay() {
+        pthread_setname_np(pthread_self(), "Sky-Prefetch");
+
+        std::unique_lock lock(mutex);
+        while (replayIndex < accesses.size()) {
+            replayCondition.wait(lock, [this] {
+                if (!running)
+                    return true;
+
+                // The guest might have skipped past the replay, there's no point in prefetching anything behind it
+                replayIndex = std::max(replayIndex, guestIndex);
+
+                size_t ahead{};
+                for (auto index{guestIndex}; index < replayIndex; index++)
+                    ahead += accesses[index].size;
+                return ahead < ReplayWindow;
+            });
+
+            if (!running || replayIndex >= accesses.size())
+                return;
+
+            auto access{accesses[replayIndex++]};
+            lock.unlock();
+            try {
+                backing->Prefetch(access.offset, access.size);
+            } catch (const std::exception &) {
+                // Any error will be reported to the guest when it reads the region itself
+            }
+            lock.lock();
+        }
+    }
+
+    void AccessTrace::Read(size_t offset, size_t size) {
+        if (!size)
+            return;
+
+        std::lock_guard guard(mutex);
+        if (recording) {
+            if (!accesses.empty()) {
+                auto &last{accesses.back()};
+                if (last.offset + last.size == offset && last.size + size <= MaxAccessSize) {
+                    last.size += size;
+                    return;
+                }
+            }
+
+            if (accesses.size() < MaxAccessCount)
+                accesses.push_back({offset, size});
+            return;
+        }
+
+        for (auto index{guestIndex}; index < std::min(guestIndex + ResyncDistance, accesses.size()); index++) {
+            const auto &access{accesses[index]};
+            if (offset < access.offset + access.size && access.offset < offset + size) {
+                if (index != guestIndex) {
+                    guestIndex = index;
+                    replayCondition.notify_all();
+                }
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <thread>
+#include <condition_variable>
+#include <vfs/backing.h>
+#include <vfs/os_filesystem.h>
+
+namespace skyline::service::fssrv {
+    /**
+     * @brief Records the regions of a backing read by the guest on the first boot of a title and prefetches them ahead of the guest on every following boot
+     * @details Titles read the same regions in the same order during boot and loading, so a backing which was already traced is prefetched in the recorded order while staying a bounded distance ahead of the guest's position in the trace
+     */
+    class AccessTrace {
+      private:
+        /**
+         * @brief A region of the backing which was read, sequential reads are coalesced into a single access
+         */
+        struct Access {
+            u64 offset;
+            u64 size;
+        };
+
+        /**
+         * @brief The header of a trace file, it's followed by all accesses in order
+         */
+        struct TraceHeader {
+            u32 magic; //!< The magic of the trace file ("ACTR")
+            u32 version; //!< The version of the trace file
+            u64 backingSize; //!< The size of the backing that was traced, a trace is discarded if the backing changed in size
+            u64 accessCount; //!< The amount of accesses following the header
+        };
+
+        static constexpr u32 TraceMagic{util::MakeMagic<u32>("ACTR")};
+        static constexpr u32 TraceVersion{1};
+        static constexpr size_t MaxAccessCount{0x10000}; //!< The maximum amount of accesses that are recorded, anything after them is past the point a trace is useful
+        static constexpr size_t MaxAccessSize{0x100000}; //!< The maximum size of a single access, larger sequential reads are split so prefetching them is paced in smaller steps
+        static constexpr size_t ReplayWindow{0x400000}; //!< The maximum amount of data that's prefetched ahead of the guest, this is half the capacity of the cache of decrypted blocks so the prefetched data isn't evicted before it's read
+        static constexpr size_t ResyncDistance{0x40}; //!< The amount of accesses ahead of the guest's position in the trace that its reads are matched against, reads which don't match any of them don't move its position
+
+        std::shared_ptr<vfs::OsFileSystem> cache; //!< The directory containing the trace files
+        std::string path; //!< The path of the backing's trace file in the cache
+        std::shared_ptr<vfs::Backing> backing;
+        bool recording; //!< If there was no trace for the backing, so the accesses are being recorded rather than replayed
+        std::vector<Access> accesses; //!< The recorded accesses or the accesses being replayed
+
+        std::mutex mutex; //!< Synchronizes access to the accesses and the state of the replay
+        std::condition_variable replayCondition; //!< Signalled when the guest's position in the trace changes or the replay should stop
+        size_t guestIndex{}; //!< The index of the access the guest has most recently read
+        size_t replayIndex{}; //!< The index of the next access to prefetch
+        bool running{true}; //!< If the replay thread should keep prefetching
+        std::thread replayThread;
+
+        /**
+         * @brief The loop of the replay thread, it prefetches every access in the trace while staying at most ReplayWindow ahead of the guest
+         */
+        void Replay();
+
+        /**
+         * @brief Writes all recorded accesses to the trace file
+         */
+        void Save();
+
+      public:
+        /**
+         * @param cache The directory containing the trace files
+         * @param name The name of the trace file of the backing, this must be unique to the title and the backing
+         */
+        AccessTrace(std::shared_ptr<vfs::OsFileSystem> cache, std::string name, std::shared_ptr<vfs::Backing> backing);
+
+        /**
+         * @brief Stops the replay or saves the recorded trace
+         */
+        ~AccessTrace();
+
+        /**
+         * @brief Records a read of the backing by the guest or advances its position in the trace being replayed
+         */
+        void Read(size_t offset, size_t size);
+    };
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "read_ahead.h"
+
+namespace skyline::service::fssrv {
+    ReadAheadThread::ReadAheadThread() : thread(&ReadAheadThread::Run, this) {}
+
+    ReadAheadThread::~ReadAheadThread() {
+        {
+            std::lock_guard guard(mutex);
+            running = false;
+        }
+        requestCondition.notify_all();
+        thread.join();
+    }
+
+    void ReadAheadThread::Run() {
+        pthread_setname_np(pthread_self(), "Sky-ReadAhead");
+
+        std::unique_lock lock(mutex);
+        while (true) {
+            requestCondition.wait(lock, [this] { return !running || !requests.empty(); });
+            if (!running)
+                return;
+
+            auto request{std::move(requests.front())};
+            requests.pop();
+
+            lock.unlock();
+            try {
+                request.backing->Prefetch(request.offset, request.size);
+            } catch (const std::exception &e) {
+                // Prefetching is only an optimization, any error will be reported to the guest when it reads the region itself
+            }
+            request.backing.reset(); // The backing is released before the lock is reacquired in case this is the last reference to it
+            lock.lock();
+        }
+    }
+
+    void ReadAheadThread::Queue(std::shared_ptr<vfs::Backing> backing, size_t offset, size_t size) {
+        {
+            std::lock_guard guard(mutex);
+            if (requests.size() >= MaxPendingRequests)
+                return;
+            requests.push(Request{std::move(backing), offset, size});
+        }
+        requestCondition.notify_one();
+    }
+
+    ReadAheadTracker::ReadAheadTracker(std::shared_ptr<ReadAheadThread> thread) : thread(std::move(thread)) {}
+
+    void ReadAheadTracker::Read(const std::shared_ptr<vfs::Backing> &backing, size_t offset, size_t size) {
+        std::lock_guard guard(mutex);
+
+        if (offset == nextOffset) {
+            sequentialReads++;
+        } else {
+            sequentialReads = 0;
+            prefetchedEnd = 0;
+        }
+        nextOffset = offset + size;
+
+        if (sequentialReads < SequentialReadThreshold || nextOffset >= backing->size)
+            return;
+
+        // The region ahead scales with the size of the reads, it's topped up once the guest has consumed half of it so there's always data ready ahead of the next read
+        auto readAheadSize{std::clamp(size * 2, MinReadAheadSize, MaxReadAheadSize)};
+        auto start{std::max(prefetchedEnd, nextOffset)};
+        if (prefetchedEnd >= nextOffset + (readAheadSize / 2))
+            return;
+
+        auto end{std::min(nextOffset + readAheadSize, backing->size)};
+        if (end <= start)
+            return;
+
+        thread->Queue(backing, start, end - start);
+        prefetchedEnd = end;
+    }
+}
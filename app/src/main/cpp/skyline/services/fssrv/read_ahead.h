@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <thread>
+#include <condition_variable>
+#include <queue>
+#include <vfs/backing.h>
+
+namespace skyline::service::fssrv {
+    /**
+     * @brief A thread which prefetches regions of backings ahead of the guest reading them, so the reads are served from memory rather than storage
+     */
+    class ReadAheadThread {
+      private:
+        /**
+         * @brief A region of a backing which should be prefetched
+         */
+        struct Request {
+            std::shared_ptr<vfs::Backing> backing;
+            size_t offset;
+            size_t size;
+        };
+
+        static constexpr size_t MaxPendingRequests{16}; //!< The maximum amount of requests which can be queued, any further requests are dropped as the guest would likely catch up to them before they're processed
+
+        std::mutex mutex; //!< Synchronizes access to the requests and running
+        std::condition_variable requestCondition; //!< Signalled when a request is queued or the thread should exit
+        std::queue<Request> requests;
+        bool running{true}; //!< If the thread should keep processing requests
+        std::thread thread;
+
+        /**
+         * @brief The loop of the thread, it processes requests in the order they were queued till the thread is destroyed
+         */
+        void Run();
+
+      public:
+        ReadAheadThread();
+
+        ~ReadAheadThread();
+
+        /**
+         * @brief Queues a region of a backing to be prefetched, this doesn't block on any I/O
+         */
+        void Queue(std::shared_ptr<vfs::Backing> backing, size_t offset, size_t size);
+    };
+
+    /**
+     * @brief Detects sequential reads of a single open file or storage and prefetches the region following them
+     */
+    class ReadAheadTracker {
+      private:
+        static constexpr size_t SequentialReadThreshold{2}; //!< The amount of consecutive sequential reads after which the following region is prefetched
+        static constexpr size_t MinReadAheadSize{0x40000}; //!< The minimum size of the region ahead of a read that's kept prefetched
+        static constexpr size_t MaxReadAheadSize{0x200000}; //!< The maximum size of the region ahead of a read that's kept prefetched, this is bounded by the capacity of the caches of the backings
+
+        std::shared_ptr<ReadAheadThread> thread;
+        std::mutex mutex; //!< Synchronizes access to the state of the tracker as a file can be read by multiple guest threads
+        size_t nextOffset{}; //!< The offset a read would start at to be sequential with the last read
+        size_t sequentialReads{}; //!< The amount of consecutive sequential reads
+        size_t prefetchedEnd{}; //!< The end of the region that has been requested to be prefetched
+
+      public:
+        ReadAheadTracker(std::shared_ptr<ReadAheadThread> thread);
+
+        /**
+         * @brief Records a read of the backing and prefetches the region following it if the backing is being read sequentially
+         */
+        void Read(const std::shared_ptr<vfs::Backing> &backing, size_t offset, size_t size);
+    };
+}
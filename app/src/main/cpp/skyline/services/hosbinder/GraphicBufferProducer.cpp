@@ -1,20 +1,25 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <android/hardware_buffer.h>
 #include <gpu.h>
+#include <statistics.h>
 #include <services/nvdrv/driver.h>
 #include <services/common/fence.h>
 #include <gpu/format.h>
 #include "GraphicBufferProducer.h"
 
+extern std::atomic<bool> Halt;
+
 namespace skyline::service::hosbinder {
     Buffer::Buffer(const GbpBuffer &gbpBuffer, const std::shared_ptr<gpu::PresentationTexture> &texture) : gbpBuffer(gbpBuffer), texture(texture) {}
 
-    GraphicBufferProducer::GraphicBufferProducer(const DeviceState &state) : state(state) {}
+    GraphicBufferProducer::GraphicBufferProducer(const DeviceState &state, u64 layerId) : state(state), layerId(layerId) {}
 
     void GraphicBufferProducer::RequestBuffer(Parcel &in, Parcel &out) {
         u32 slot{in.Pop<u32>()};
 
+        std::lock_guard guard(mutex);
         out.Push<u32>(1);
         out.Push<u32>(sizeof(GbpBuffer));
         out.Push<u32>(0);
@@ -23,6 +28,17 @@ namespace skyline::service::hosbinder {
         state.logger->Debug("RequestBuffer: Slot: {}", slot, sizeof(GbpBuffer));
     }
 
+    void GraphicBufferProducer::SetBufferCount(Parcel &in, Parcel &out) {
+        auto count{in.Pop<u32>()};
+
+        std::lock_guard guard(mutex);
+        bufferCount = count ? count : DefaultBufferCount;
+        freeCondition.notify_all();
+        out.Push<u32>(0);
+
+        state.logger->Debug("SetBufferCount: Count: {}", count);
+    }
+
     void GraphicBufferProducer::DequeueBuffer(Parcel &in, Parcel &out) {
         u32 format{in.Pop<u32>()};
         u32 width{in.Pop<u32>()};
@@ -31,15 +47,27 @@ namespace skyline::service::hosbinder {
         u32 usage{in.Pop<u32>()};
 
         std::optional<u32> slot{std::nullopt};
-        while (!slot) {
+        auto findSlot{[&]() {
+            u32 activeBuffers{};
+            std::optional<u32> freeSlot;
             for (auto &buffer : queue) {
-                if (buffer.second->status == BufferStatus::Free && buffer.second->gbpBuffer.format == format && buffer.second->gbpBuffer.width == width && buffer.second->gbpBuffer.height == height && (buffer.second->gbpBuffer.usage & usage) == usage) {
-                    slot = buffer.first;
-                    buffer.second->status = BufferStatus::Dequeued;
-                    break;
-                }
+                if (buffer.second->status != BufferStatus::Free)
+                    activeBuffers++;
+                else if (!freeSlot && buffer.second->gbpBuffer.format == format && buffer.second->gbpBuffer.width == width && buffer.second->gbpBuffer.height == height && (buffer.second->gbpBuffer.usage & usage) == usage)
+                    freeSlot = buffer.first;
             }
-        }
+            if (freeSlot && activeBuffers < bufferCount)
+                slot = freeSlot;
+            return slot.has_value();
+        }};
+
+        constexpr std::chrono::milliseconds WaitSlice{100}; // The maximum duration to wait for a buffer to be freed prior to checking Halt (100ms)
+        std::unique_lock lock(mutex);
+        while (!freeCondition.wait_for(lock, WaitSlice, findSlot))
+            if (Halt)
+                return; // The guest is being torn down, so there's no point in responding to it
+        queue.at(*slot)->status = BufferStatus::Dequeued;
+        lock.unlock();
 
         out.Push(*slot);
         out.Push(std::array<u32, 13>{1, 0x24}); // Unknown
@@ -60,19 +88,33 @@ namespace skyline::service::hosbinder {
             u32 swapInterval;
             std::array<nvdrv::Fence, 4> fence;
         } &data = in.Pop<Data>();
+        state.statistics->boot.Mark(BootPhase::FirstQueueBuffer);
 
+        std::unique_lock lock(mutex);
         auto buffer{queue.at(data.slot)};
         buffer->status = BufferStatus::Queued;
 
+        // The layer can be destroyed while its frames are still queued, so the callbacks don't keep the producer alive and do nothing once it's gone
         auto slot{data.slot};
         auto bufferEvent{state.gpu->bufferEvent};
-        buffer->texture->releaseCallback = [this, slot, bufferEvent]() {
-            queue.at(slot)->status = BufferStatus::Free;
+        buffer->texture->acquireCallback = [weak{weak_from_this()}, slot]() {
+            if (auto producer{weak.lock()}) {
+                std::lock_guard guard(producer->mutex);
+                producer->queue.at(slot)->status = BufferStatus::Acquired;
+            }
+        };
+        buffer->texture->releaseCallback = [weak{weak_from_this()}, slot, bufferEvent]() {
+            if (auto producer{weak.lock()}) {
+                std::lock_guard guard(producer->mutex);
+                producer->queue.at(slot)->status = BufferStatus::Free;
+                producer->freeCondition.notify_all();
+            }
             bufferEvent->Signal();
         };
+        lock.unlock();
 
-        buffer->texture->SynchronizeHost();
-        state.gpu->presentationQueue.push(buffer->texture);
+        state.gpu->presentation.SetSwapInterval(data.swapInterval);
+        state.gpu->QueuePresentation(layerId, buffer->texture);
 
         struct {
             u32 width;
@@ -91,7 +133,11 @@ namespace skyline::service::hosbinder {
         u32 slot{in.Pop<u32>()};
         //auto fences{in.Pop<std::array<nvdrv::Fence, 4>>()};
 
-        queue.at(slot)->status = BufferStatus::Free;
+        {
+            std::lock_guard guard(mutex);
+            queue.at(slot)->status = BufferStatus::Free;
+            freeCondition.notify_all();
+        }
 
         state.logger->Debug("CancelBuffer: Slot: {}", slot);
     }
@@ -123,19 +169,14 @@ namespace skyline::service::hosbinder {
         auto driver{nvdrv::driver.lock()};
         auto nvmap{driver->nvMap.lock()};
 
-        if (gbpBuffer.nvmapHandle) {
-            nvBuffer = nvmap->handleTable.at(gbpBuffer.nvmapHandle);
-        } else {
-            for (const auto &object : nvmap->handleTable) {
-                if (object.second->id == gbpBuffer.nvmapId) {
-                    nvBuffer = object.second;
-                    break;
-                }
-            }
-            if (!nvBuffer)
-                throw exception("A QueueBuffer request has an invalid NVMap Handle ({}) and ID ({})", gbpBuffer.nvmapHandle, gbpBuffer.nvmapId);
+        try {
+            nvBuffer = nvmap->GetObject(gbpBuffer.nvmapHandle ? gbpBuffer.nvmapHandle : nvmap->GetHandleFromId(gbpBuffer.nvmapId));
+        } catch (const std::out_of_range &) {
+            throw exception("A QueueBuffer request has an invalid NVMap Handle ({}) and ID ({})", gbpBuffer.nvmapHandle, gbpBuffer.nvmapId);
         }
 
+        constexpr u32 HalPixelFormatBgra8888{5}; // HAL_PIXEL_FORMAT_BGRA_8888, this isn't exposed by the NDK
+
         gpu::texture::Format format;
         switch (gbpBuffer.format) {
             case WINDOW_FORMAT_RGBA_8888:
@@ -145,13 +186,33 @@ namespace skyline::service::hosbinder {
             case WINDOW_FORMAT_RGB_565:
                 format = gpu::format::RGB565Unorm;
                 break;
+            case HalPixelFormatBgra8888:
+                format = gpu::format::BGRA8888Unorm;
+                break;
+            case AHARDWAREBUFFER_FORMAT_R16G16B16A16_FLOAT:
+                format = gpu::format::RGBA16Float;
+                break;
+            case AHARDWAREBUFFER_FORMAT_R10G10B10A2_UNORM:
+                format = gpu::format::RGB10A2Unorm;
+                break;
             default:
                 throw exception("Unknown pixel format used for FB");
         }
 
-        auto texture{std::make_shared<gpu::GuestTexture>(state, nvBuffer->address + gbpBuffer.offset, gpu::texture::Dimensions(gbpBuffer.width, gbpBuffer.height), format, gpu::texture::TileMode::Block, gpu::texture::TileConfig{.surfaceWidth = static_cast<u16>(gbpBuffer.stride), .blockHeight = static_cast<u8>(1U << gbpBuffer.blockHeightLog2), .blockDepth = 1})};
-
-        queue[data.slot] = std::make_shared<Buffer>(gbpBuffer, texture->InitializePresentationTexture());
+        {
+            // The buffer of the slot is reconfigured in place, its previous texture is handed to the texture cache so its storage can be reused if it isn't being presented
+            std::lock_guard guard(mutex);
+            auto &buffer{queue[data.slot]};
+            auto texture{state.gpu->textureCache.GetPresentationTexture(nvBuffer->address + gbpBuffer.offset, gpu::texture::Dimensions(gbpBuffer.width, gbpBuffer.height), format, gpu::texture::TileMode::Block, gpu::texture::TileConfig{.surfaceWidth = static_cast<u16>(gbpBuffer.stride), .blockHeight = static_cast<u8>(1U << gbpBuffer.blockHeightLog2), .blockDepth = 1}, buffer ? std::move(buffer->texture) : nullptr)};
+            if (buffer) {
+                buffer->status = BufferStatus::Free;
+                buffer->gbpBuffer = gbpBuffer;
+                buffer->texture = std::move(texture);
+            } else {
+                buffer = std::make_shared<Buffer>(gbpBuffer, texture);
+            }
+            freeCondition.notify_all();
+        }
         state.gpu->bufferEvent->Signal();
 
         state.logger->Debug("SetPreallocatedBuffer: Slot: {}, Magic: 0x{:X}, Width: {}, Height: {}, Stride: {}, Format: {}, Usage: {}, Index: {}, ID: {}, Handle: {}, Offset: 0x{:X}, Block Height: {}, Size: 0x{:X}", data.slot, gbpBuffer.magic, gbpBuffer.width, gbpBuffer.height, gbpBuffer.stride, gbpBuffer.format, gbpBuffer.usage, gbpBuffer.index, gbpBuffer.nvmapId, gbpBuffer.nvmapHandle, gbpBuffer.offset, (1U << gbpBuffer.blockHeightLog2), gbpBuffer.size);
@@ -162,6 +223,9 @@ namespace skyline::service::hosbinder {
             case TransactionCode::RequestBuffer:
                 RequestBuffer(in, out);
                 break;
+            case TransactionCode::SetBufferCount:
+                SetBufferCount(in, out);
+                break;
             case TransactionCode::DequeueBuffer:
                 DequeueBuffer(in, out);
                 break;
@@ -186,34 +250,4 @@ namespace skyline::service::hosbinder {
                 throw exception("An unimplemented transaction was called: {}", static_cast<u32>(code));
         }
     }
-
-    /**
-     * @brief A mapping from a display's name to it's displayType entry
-     */
-    static frz::unordered_map<frz::string, DisplayId, 5> DisplayTypeMap{
-        {"Default", DisplayId::Default},
-        {"External", DisplayId::External},
-        {"Edid", DisplayId::Edid},
-        {"Internal", DisplayId::Internal},
-        {"Null", DisplayId::Null},
-    };
-
-    void GraphicBufferProducer::SetDisplay(const std::string &name) {
-        try {
-            if (displayId == DisplayId::Null)
-                displayId = DisplayTypeMap.at(frz::string(name.data(), name.size()));
-            else
-                throw exception("Trying to change display type from non-null type");
-        } catch (const std::out_of_range &) {
-            throw exception("The display with name: '{}' doesn't exist", name);
-        }
-    }
-
-    void GraphicBufferProducer::CloseDisplay() {
-        if (displayId == DisplayId::Null)
-            state.logger->Warn("Trying to close uninitiated display");
-        displayId = DisplayId::Null;
-    }
-
-    std::weak_ptr<GraphicBufferProducer> producer{};
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <services/common/parcel.h>
 
 namespace skyline::gpu {
@@ -39,6 +40,7 @@ namespace skyline::service::hosbinder {
         Free, //!< The buffer is free
         Dequeued, //!< The buffer has been dequeued from the display
         Queued, //!< The buffer is queued to be displayed
+        Acquired, //!< The buffer has been acquired by the presentation engine and is being displayed
     };
 
     /**
@@ -54,31 +56,18 @@ namespace skyline::service::hosbinder {
     };
 
     /**
-     * @brief An enumeration of all the possible display IDs
-     * @url https://switchbrew.org/wiki/Display_services#DisplayName
-     */
-    enum class DisplayId : u64 {
-        Default, //!< Refers to the default display used by most applications
-        External, //!< Refers to an external display
-        Edid, //!< Refers to an external display with EDID capabilities
-        Internal, //!< Refers to the the internal display
-        Null, //!< Refers to the null display which is used for discarding data
-    };
-
-    enum class LayerStatus {
-        Uninitialized, //!< The layer hasn't been initialized
-        Stray, //!< The layer has been initialized as a stray layer
-        Managed, //!< The layer has been initialized as a managed layer
-    };
-
-    /**
-     * @brief IGraphicBufferProducer is responsible for presenting buffers to the display as well as compositing and frame pacing
+     * @brief IGraphicBufferProducer is responsible for queueing the buffers of a single layer to be composited onto the display
      * @url https://android.googlesource.com/platform/frameworks/native/+/8dc5539/libs/gui/IGraphicBufferProducer.cpp
      */
-    class GraphicBufferProducer {
+    class GraphicBufferProducer : public std::enable_shared_from_this<GraphicBufferProducer> {
       private:
         const DeviceState &state;
+        u64 layerId; //!< The ID of the layer that buffers are queued to
+        std::mutex mutex; //!< Synchronizes access to the buffers and their status, as buffers are acquired and released on the presentation thread
+        std::condition_variable freeCondition; //!< Signalled whenever a buffer is freed or added
         std::unordered_map<u32, std::shared_ptr<Buffer>> queue; //!< A vector of shared pointers to all the queued buffers
+        static constexpr u32 DefaultBufferCount{3}; //!< The default amount of buffers that can be in use at once, this allows the guest to render one frame ahead of the one being presented
+        u32 bufferCount{DefaultBufferCount}; //!< The maximum amount of buffers that can be dequeued, queued or acquired at once
 
         /**
          * @brief Request for the GbpBuffer of a buffer
@@ -86,7 +75,12 @@ namespace skyline::service::hosbinder {
         void RequestBuffer(Parcel &in, Parcel &out);
 
         /**
-         * @brief Try to dequeue a free graphics buffer that has been consumed
+         * @brief Sets the maximum amount of buffers that can be in use at once, a count of 0 restores the default
+         */
+        void SetBufferCount(Parcel &in, Parcel &out);
+
+        /**
+         * @brief Dequeues a free graphics buffer that has been consumed, this blocks until one is available
          */
         void DequeueBuffer(Parcel &in, Parcel &out);
 
@@ -111,9 +105,6 @@ namespace skyline::service::hosbinder {
         void SetPreallocatedBuffer(Parcel &in);
 
       public:
-        DisplayId displayId{DisplayId::Null}; //!< The ID of this display
-        LayerStatus layerStatus{LayerStatus::Uninitialized}; //!< The status of the single layer the display has
-
         /**
          * @brief The functions called by TransactParcel for android.gui.IGraphicBufferProducer
          * @refitem https://android.googlesource.com/platform/frameworks/native/+/8dc5539/libs/gui/IGraphicBufferProducer.cpp#35
@@ -135,26 +126,12 @@ namespace skyline::service::hosbinder {
             SetPreallocatedBuffer = 14, //!< No source on this but it's used to set a existing buffer according to libtransistor and libnx
         };
 
-        GraphicBufferProducer(const DeviceState &state);
+        GraphicBufferProducer(const DeviceState &state, u64 layerId);
 
         /**
          * @brief The handler for Binder IPC transactions with IGraphicBufferProducer
          * @url https://android.googlesource.com/platform/frameworks/native/+/8dc5539/libs/gui/IGraphicBufferProducer.cpp#277
          */
         void OnTransact(TransactionCode code, Parcel &in, Parcel &out);
-
-        /**
-         * @brief Sets displayId to a specific display type
-         * @param name The name of the display
-         * @note displayId has to be DisplayId::Null or this will throw an exception
-         */
-        void SetDisplay(const std::string &name);
-
-        /**
-         * @brief Closes the display by setting displayId to DisplayId::Null
-         */
-        void CloseDisplay();
     };
-
-    extern std::weak_ptr<GraphicBufferProducer> producer; //!< A globally shared instance of the GraphicsBufferProducer
 }
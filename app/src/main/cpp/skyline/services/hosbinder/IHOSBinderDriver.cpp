@@ -4,12 +4,12 @@
 #include <gpu.h>
 #include <kernel/types/KProcess.h>
 #include "IHOSBinderDriver.h"
-#include "GraphicBufferProducer.h"
+#include "display.h"
 
 namespace skyline::service::hosbinder {
-    IHOSBinderDriver::IHOSBinderDriver(const DeviceState &state, ServiceManager &manager) : producer(hosbinder::producer.expired() ? std::make_shared<GraphicBufferProducer>(state) : hosbinder::producer.lock()), BaseService(state, manager) {
-        if (hosbinder::producer.expired())
-            hosbinder::producer = producer;
+    IHOSBinderDriver::IHOSBinderDriver(const DeviceState &state, ServiceManager &manager) : display(hosbinder::display.expired() ? std::make_shared<Display>(state) : hosbinder::display.lock()), BaseService(state, manager) {
+        if (hosbinder::display.expired())
+            hosbinder::display = display;
     }
 
     Result IHOSBinderDriver::TransactParcel(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
@@ -17,16 +17,13 @@ namespace skyline::service::hosbinder {
         auto code{request.Pop<GraphicBufferProducer::TransactionCode>()};
 
         Parcel in(request.inputBuf.at(0), state, true);
-        Parcel out(state);
-
-        // We opted for just supporting a single layer and display as it's what basically all games use and wasting cycles on it is pointless
-        // If this was not done then we would need to maintain an array of GraphicBufferProducer objects for each layer and send the request it specifically
-        // There would also need to be an external compositor which composites all the graphics buffers submitted to every GraphicBufferProducer
+        Parcel out(state, request.outputBuf.at(0));
 
+        // The binder ID is the ID of the layer, every layer has its own producer and the presentation engine composites the buffers queued to all of them
         state.logger->Debug("TransactParcel: Layer ID: {}, Code: {}", layerId, code);
-        producer->OnTransact(code, in, out);
+        display->GetProducer(layerId)->OnTransact(code, in, out);
 
-        out.WriteParcel(request.outputBuf.at(0));
+        out.WriteParcel();
         return {};
     }
 
@@ -6,14 +6,14 @@
 #include <services/serviceman.h>
 
 namespace skyline::service::hosbinder {
-    class GraphicBufferProducer;
+    class Display;
 
     /**
      * @brief nvnflinger:dispdrv or nns::hosbinder::IHOSBinderDriver is a translation layer between Android Binder IPC and HOS IPC to communicate with the Android display stack
      */
     class IHOSBinderDriver : public BaseService {
       private:
-        std::shared_ptr<GraphicBufferProducer> producer;
+        std::shared_ptr<Display> display;
 
       public:
         IHOSBinderDriver(const DeviceState &state, ServiceManager &manager);
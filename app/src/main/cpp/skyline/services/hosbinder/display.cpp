@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <gpu.h>
+#include "display.h"
+
+namespace skyline::service::hosbinder {
+    /**
+     * @brief A mapping from a display's name to it's displayType entry
+     */
+    static frz::unordered_map<frz::string, DisplayId, 5> DisplayTypeMap{
+        {"Default", DisplayId::Default},
+        {"External", DisplayId::External},
+        {"Edid", DisplayId::Edid},
+        {"Internal", DisplayId::Internal},
+        {"Null", DisplayId::Null},
+    };
+
+    Display::Display(const DeviceState &state) : state(state) {}
+
+    Display::Layer &Display::GetLayerLocked(u64 layerId) {
+        auto layer{layers.find(layerId)};
+        if (layer == layers.end())
+            throw exception("The layer with ID {} doesn't exist", layerId);
+        return layer->second;
+    }
+
+    void Display::Open(const std::string &name) {
+        try {
+            if (displayId == DisplayId::Null)
+                displayId = DisplayTypeMap.at(frz::string(name.data(), name.size()));
+            else
+                throw exception("Trying to change display type from non-null type");
+        } catch (const std::out_of_range &) {
+            throw exception("The display with name: '{}' doesn't exist", name);
+        }
+    }
+
+    void Display::Close() {
+        if (displayId == DisplayId::Null)
+            state.logger->Warn("Trying to close uninitiated display");
+        displayId = DisplayId::Null;
+    }
+
+    u64 Display::CreateLayer() {
+        std::lock_guard guard(mutex);
+        if (layers.size() >= gpu::PresentationEngine::MaxLayerCount)
+            throw exception("The application is creating more than {} layers", gpu::PresentationEngine::MaxLayerCount);
+
+        auto layerId{nextLayerId++};
+        auto &layer{layers[layerId]};
+        layer.producer = std::make_shared<GraphicBufferProducer>(state, layerId);
+        state.gpu->presentation.SetLayer(layerId, layer.properties);
+        return layerId;
+    }
+
+    void Display::DestroyLayer(u64 layerId) {
+        std::lock_guard guard(mutex);
+        if (!layers.erase(layerId)) {
+            state.logger->Warn("The application is destroying a layer which doesn't exist: {}", layerId);
+            return;
+        }
+        state.gpu->presentation.RemoveLayer(layerId);
+    }
+
+    std::shared_ptr<GraphicBufferProducer> Display::GetProducer(u64 layerId) {
+        std::lock_guard guard(mutex);
+        return GetLayerLocked(layerId).producer;
+    }
+
+    void Display::SetLayerZ(u64 layerId, i64 z) {
+        std::lock_guard guard(mutex);
+        auto &layer{GetLayerLocked(layerId)};
+        layer.properties.z = z;
+        state.gpu->presentation.SetLayer(layerId, layer.properties);
+    }
+
+    void Display::SetLayerVisibility(u64 layerId, bool visible) {
+        std::lock_guard guard(mutex);
+        auto &layer{GetLayerLocked(layerId)};
+        layer.properties.visible = visible;
+        state.gpu->presentation.SetLayer(layerId, layer.properties);
+    }
+
+    std::weak_ptr<Display> display{};
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <gpu/presentation_engine.h>
+#include "GraphicBufferProducer.h"
+
+namespace skyline::service::hosbinder {
+    /**
+     * @brief An enumeration of all the possible display IDs
+     * @url https://switchbrew.org/wiki/Display_services#DisplayName
+     */
+    enum class DisplayId : u64 {
+        Default, //!< Refers to the default display used by most applications
+        External, //!< Refers to an external display
+        Edid, //!< Refers to an external display with EDID capabilities
+        Internal, //!< Refers to the the internal display
+        Null, //!< Refers to the null display which is used for discarding data
+    };
+
+    /**
+     * @brief The display which all layers of the application are on, every layer has its own GraphicBufferProducer and its properties are forwarded to the presentation engine which composites the layers
+     * @note The ID of a layer doubles as the ID of the binder for its producer, so transactions on it can be dispatched to the producer directly
+     */
+    class Display {
+      private:
+        /**
+         * @brief A layer on the display alongside the properties that the guest has set on it
+         */
+        struct Layer {
+            std::shared_ptr<GraphicBufferProducer> producer;
+            gpu::PresentationEngine::LayerProperties properties;
+        };
+
+        const DeviceState &state;
+        std::mutex mutex; //!< Synchronizes access to layers
+        std::map<u64, Layer> layers; //!< All layers on the display keyed by their ID
+        u64 nextLayerId{1}; //!< The ID of the next layer that's created, IDs aren't reused and 0 is never a valid layer ID
+
+        /**
+         * @return The layer with the supplied ID, an exception is thrown if there's no such layer
+         * @note The mutex must be locked when calling this
+         */
+        Layer &GetLayerLocked(u64 layerId);
+
+      public:
+        DisplayId displayId{DisplayId::Null}; //!< The ID of the display which is open
+
+        Display(const DeviceState &state);
+
+        /**
+         * @brief Opens a display by its name
+         * @note The display must be closed already or this will throw an exception
+         */
+        void Open(const std::string &name);
+
+        /**
+         * @brief Closes the display by setting displayId to DisplayId::Null
+         */
+        void Close();
+
+        /**
+         * @brief Creates a layer which is visible at a Z order of 0 until the guest changes either property, stray and managed layers only differ in which services manage them
+         * @return The ID of the layer
+         */
+        u64 CreateLayer();
+
+        /**
+         * @brief Destroys a layer, the frames of it which are still queued are discarded
+         */
+        void DestroyLayer(u64 layerId);
+
+        /**
+         * @return The producer that buffers of the layer are queued with, an exception is thrown if there's no such layer
+         */
+        std::shared_ptr<GraphicBufferProducer> GetProducer(u64 layerId);
+
+        void SetLayerZ(u64 layerId, i64 z);
+
+        void SetLayerVisibility(u64 layerId, bool visible);
+    };
+
+    extern std::weak_ptr<Display> display; //!< A globally shared instance of the Display
+}
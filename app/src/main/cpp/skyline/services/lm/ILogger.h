@@ -4,6 +4,7 @@
 #pragma once
 
 #include <services/serviceman.h>
+#include "log_writer.h"
 
 namespace skyline::service::lm {
     /**
@@ -12,40 +13,13 @@ namespace skyline::service::lm {
      */
     class ILogger : public BaseService {
       private:
-        enum class LogFieldType : u8 {
-            Start = 0, //!< The first log message in the stream
-            Stop = 1, //!< The final log message in the stream
-            Message = 2, //!< A log field with a general message
-            Line = 3, //!< A log field with a line number
-            Filename = 4, //!< A log field with a filename
-            Function = 5, //!< A log field with a function name
-            Module = 6, //!< A log field with a module name
-            Thread = 7, //!< A log field with a thread name
-            DropCount = 8, //!< A log field with the number of dropped messages
-            Time = 9, //!< A log field with a timestamp
-            ProgramName = 10, //!< A log field with the program's name
-        };
-
-        enum class LogLevel : u8 {
-            Trace,
-            Info,
-            Warning,
-            Error,
-            Critical,
-        };
-
-        /**
-         * @brief Obtains a string containing the name of the given field type
-         * @param type The field type to return the name of
-         * @return The name of the given field type
-         */
-        std::string GetFieldName(LogFieldType type);
+        std::shared_ptr<LogWriter> logWriter;
 
       public:
         ILogger(const DeviceState &state, ServiceManager &manager);
 
         /**
-         * @brief Prints a message to the log
+         * @brief Prints a message to the log, this only queues it to be written by the LogWriter
          * @url https://switchbrew.org/wiki/Log_services#Log
          */
         Result Log(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "log_writer.h"
+
+namespace skyline::service::lm {
+    LogWriter::LogWriter(const DeviceState &state) : state(state), thread(&LogWriter::Run, this) {}
+
+    LogWriter::~LogWriter() {
+        {
+            std::lock_guard guard(mutex);
+            running = false;
+        }
+        condition.notify_one();
+        thread.join();
+    }
+
+    std::string_view LogWriter::GetFieldName(LogFieldType type) {
+        switch (type) {
+            case LogFieldType::Message:
+                return "Message";
+            case LogFieldType::Line:
+                return "Line";
+            case LogFieldType::Filename:
+                return "Filename";
+            case LogFieldType::Function:
+                return "Function";
+            case LogFieldType::Module:
+                return "Module";
+            case LogFieldType::Thread:
+                return "Thread";
+            case LogFieldType::DropCount:
+                return "DropCount";
+            case LogFieldType::Time:
+                return "Time";
+            case LogFieldType::ProgramName:
+                return "ProgramName";
+            default:
+                return "";
+        }
+    }
+
+    std::string LogWriter::FormatPacket(span<u8> packet) {
+        std::ostringstream logMessage;
+        logMessage << "Guest log:";
+
+        u64 offset{sizeof(PacketHeader)};
+        while (offset < packet.size()) {
+            auto fieldType{packet.subspan(offset++).as<LogFieldType>()};
+            auto length{packet.subspan(offset++).as<u8>()};
+            auto object{packet.subspan(offset, length)};
+
+            logMessage << " ";
+
+            switch (fieldType) {
+                case LogFieldType::Start:
+                    offset += length;
+                    continue;
+                case LogFieldType::Line:
+                    logMessage << GetFieldName(fieldType) << ": " << object.as<u32>();
+                    offset += sizeof(u32);
+                    continue;
+                case LogFieldType::DropCount:
+                    logMessage << GetFieldName(fieldType) << ": " << object.as<u64>();
+                    offset += sizeof(u64);
+                    continue;
+                case LogFieldType::Time:
+                    logMessage << GetFieldName(fieldType) << ": " << object.as<u64>() << "s";
+                    offset += sizeof(u64);
+                    continue;
+                case LogFieldType::Stop:
+                    break;
+                default:
+                    logMessage << GetFieldName(fieldType) << ": " << object.as_string();
+                    offset += length;
+                    continue;
+            }
+
+            break;
+        }
+
+        return logMessage.str();
+    }
+
+    void LogWriter::Run() {
+        std::vector<QueuedPacket> packets;
+        std::unique_lock lock(mutex);
+        while (true) {
+            condition.wait(lock, [this]() { return !queue.empty() || dropCount || !running; });
+            if (queue.empty() && !dropCount && !running)
+                break;
+
+            packets.swap(queue);
+            auto dropped{std::exchange(dropCount, 0)};
+            lock.unlock();
+
+            for (auto &packet : packets) {
+                try {
+                    auto message{FormatPacket(packet.packet)};
+                    if (packet.repeatCount)
+                        message += fmt::format(" (Repeated {} times)", packet.repeatCount);
+                    state.logger->Write(packet.level, std::move(message));
+                } catch (const std::exception &e) {
+                    state.logger->Warn("Failed to parse guest log packet: {}", e.what());
+                }
+            }
+            packets.clear();
+
+            if (dropped)
+                state.logger->Warn("Dropped {} guest log messages as they were logged faster than they could be written", dropped);
+
+            lock.lock();
+        }
+    }
+
+    void LogWriter::Push(span<u8> packet) {
+        Logger::LogLevel level;
+        switch (packet.as<PacketHeader>().level) {
+            case LogLevel::Trace:
+                level = Logger::LogLevel::Debug;
+                break;
+            case LogLevel::Info:
+                level = Logger::LogLevel::Info;
+                break;
+            case LogLevel::Warning:
+                level = Logger::LogLevel::Warn;
+                break;
+            case LogLevel::Error:
+            case LogLevel::Critical:
+            default:
+                level = Logger::LogLevel::Error;
+                break;
+        }
+
+        if (level > state.logger->configLevel)
+            return;
+
+        {
+            std::lock_guard guard(mutex);
+            if (!queue.empty() && queue.back().level == level && std::equal(packet.begin(), packet.end(), queue.back().packet.begin(), queue.back().packet.end())) {
+                queue.back().repeatCount++;
+                return;
+            }
+
+            if (queue.size() >= MaxQueuedPackets) {
+                dropCount++;
+                return;
+            }
+
+            queue.push_back(QueuedPacket{level, std::vector<u8>(packet.begin(), packet.end()), 0});
+        }
+        condition.notify_one();
+    }
+
+    std::weak_ptr<LogWriter> writer{};
+}
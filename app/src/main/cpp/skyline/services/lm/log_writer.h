@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <condition_variable>
+#include <common.h>
+
+namespace skyline::service::lm {
+    /**
+     * @brief LogWriter formats and writes guest log packets on a background thread, so guest threads which log don't wait on the host logging
+     * @note Consecutive identical packets are coalesced into a single message and packets are dropped while the queue is full, the amount of both is logged
+     */
+    class LogWriter {
+      private:
+        enum class LogFieldType : u8 {
+            Start = 0, //!< The first log message in the stream
+            Stop = 1, //!< The final log message in the stream
+            Message = 2, //!< A log field with a general message
+            Line = 3, //!< A log field with a line number
+            Filename = 4, //!< A log field with a filename
+            Function = 5, //!< A log field with a function name
+            Module = 6, //!< A log field with a module name
+            Thread = 7, //!< A log field with a thread name
+            DropCount = 8, //!< A log field with the number of dropped messages
+            Time = 9, //!< A log field with a timestamp
+            ProgramName = 10, //!< A log field with the program's name
+        };
+
+        enum class LogLevel : u8 {
+            Trace,
+            Info,
+            Warning,
+            Error,
+            Critical,
+        };
+
+        /**
+         * @brief The header of a log packet which is followed by the log fields
+         */
+        struct PacketHeader {
+            u64 pid;
+            u64 threadContext;
+            u16 flags;
+            LogLevel level;
+            u8 verbosity;
+            u32 payloadLength;
+        };
+        static_assert(sizeof(PacketHeader) == 0x18);
+
+        struct QueuedPacket {
+            Logger::LogLevel level; //!< The host log level to write the packet with
+            std::vector<u8> packet; //!< A copy of the packet including its header
+            size_t repeatCount; //!< The amount of identical packets after this one which were coalesced into it
+        };
+
+        static constexpr size_t MaxQueuedPackets{0x400}; //!< The maximum amount of packets queued for writing, this limits the rate of guest logging to how fast the writer can keep up
+
+        const DeviceState &state;
+        std::mutex mutex; //!< Synchronizes access to the queue and dropCount
+        std::condition_variable condition; //!< Signalled when packets are queued or the writer is stopped
+        std::vector<QueuedPacket> queue;
+        size_t dropCount{}; //!< The amount of packets dropped since the last batch was written
+        bool running{true};
+        std::thread thread;
+
+        /**
+         * @return The name of the given field type
+         */
+        static std::string_view GetFieldName(LogFieldType type);
+
+        /**
+         * @return A human-readable message with all fields of the packet
+         */
+        static std::string FormatPacket(span<u8> packet);
+
+        /**
+         * @brief The loop of the writer thread, it writes all queued packets in batches until the writer is stopped
+         */
+        void Run();
+
+      public:
+        LogWriter(const DeviceState &state);
+
+        /**
+         * @brief Stops the writer thread after writing out any remaining packets
+         */
+        ~LogWriter();
+
+        /**
+         * @brief Queues a guest log packet to be written, it's dropped without any copies if its level wouldn't be logged
+         */
+        void Push(span<u8> packet);
+    };
+
+    extern std::weak_ptr<LogWriter> writer; //!< A globally shared instance of the LogWriter
+}
@@ -44,8 +44,8 @@ namespace skyline::service::nifm {
         Result Submit(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
         SERVICE_DECL(
-            SFUNC(0x0, IRequest, GetRequestState),
-            SFUNC(0x1, IRequest, GetResult),
+            SFUNC_PURE(0x0, IRequest, GetRequestState),
+            SFUNC_PURE(0x1, IRequest, GetResult),
             SFUNC(0x2, IRequest, GetSystemEventReadableHandles),
             SFUNC(0x4, IRequest, Submit)
         )
@@ -25,7 +25,7 @@ namespace skyline::service::nvdrv {
         auto fd{request.Pop<u32>()};
         auto cmd{request.Pop<u32>()};
 
-        auto device{driver->GetDevice(fd)};
+        auto &device{driver->GetDevice(fd)};
 
         // Strip the permissions from the command leaving only the ID
         cmd &= 0xFFFF;
@@ -47,7 +47,7 @@ namespace skyline::service::nvdrv {
             throw exception("IOCTL Input Buffer (0x{:X}) != Output Buffer (0x{:X})", fmt::ptr(request.inputBuf[0].data()), fmt::ptr(request.outputBuf[0].data()));
         }
 
-        response.Push(device->HandleIoctl(cmd, device::IoctlType::Ioctl, buffer, {}));
+        response.Push(device.HandleIoctl(cmd, device::IoctlType::Ioctl, buffer, {}));
         return {};
     }
 
@@ -70,8 +70,8 @@ namespace skyline::service::nvdrv {
         auto fd{request.Pop<u32>()};
         auto eventId{request.Pop<u32>()};
 
-        auto device{driver->GetDevice(fd)};
-        auto event{device->QueryEvent(eventId)};
+        auto &device{driver->GetDevice(fd)};
+        auto event{device.QueryEvent(eventId)};
 
         if (event != nullptr) {
             auto handle{state.process->InsertItem<type::KEvent>(event)};
@@ -96,7 +96,7 @@ namespace skyline::service::nvdrv {
         auto fd{request.Pop<u32>()};
         auto cmd{request.Pop<u32>()};
 
-        auto device{driver->GetDevice(fd)};
+        auto &device{driver->GetDevice(fd)};
 
         // Strip the permissions from the command leaving only the ID
         cmd &= 0xFFFF;
@@ -112,7 +112,7 @@ namespace skyline::service::nvdrv {
         else
             buffer = request.outputBuf[0];
 
-        response.Push(device->HandleIoctl(cmd, device::IoctlType::Ioctl2, buffer, request.inputBuf[1]));
+        response.Push(device.HandleIoctl(cmd, device::IoctlType::Ioctl2, buffer, request.inputBuf[1]));
         return {};
     }
 
@@ -120,7 +120,7 @@ namespace skyline::service::nvdrv {
         auto fd{request.Pop<u32>()};
         auto cmd{request.Pop<u32>()};
 
-        auto device{driver->GetDevice(fd)};
+        auto &device{driver->GetDevice(fd)};
 
         // Strip the permissions from the command leaving only the ID
         cmd &= 0xFFFF;
@@ -136,7 +136,7 @@ namespace skyline::service::nvdrv {
         else
             buffer = request.outputBuf[0];
 
-        response.Push(device->HandleIoctl(cmd, device::IoctlType::Ioctl3, buffer, request.outputBuf[1]));
+        response.Push(device.HandleIoctl(cmd, device::IoctlType::Ioctl3, buffer, request.outputBuf[1]));
         return {};
     }
 
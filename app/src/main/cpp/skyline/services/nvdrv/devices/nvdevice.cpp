@@ -19,7 +19,7 @@ namespace skyline::service::nvdrv::device {
     }
 
     NvStatus NvDevice::HandleIoctl(u32 cmd, IoctlType type, span<u8> buffer, span<u8> inlineBuffer) {
-        std::string_view typeString{[type] {
+        auto typeString{[type]() -> std::string_view {
             switch (type) {
                 case IoctlType::Ioctl:
                     return "IOCTL";
@@ -28,20 +28,19 @@ namespace skyline::service::nvdrv::device {
                 case IoctlType::Ioctl3:
                     return "IOCTL3";
             }
-        }()};
+        }};
 
-        std::pair<std::function<NvStatus(IoctlType, span<u8>, span<u8>)>, std::string_view> function;
-        try {
-            function = GetIoctlFunction(cmd);
-            state.logger->Debug("{} @ {}: {}", typeString, GetName(), function.second);
-        } catch (std::out_of_range &) {
+        auto function{GetIoctlFunction(cmd)};
+        if (!function) {
             state.logger->Warn("Cannot find IOCTL for device '{}': 0x{:X}", GetName(), cmd);
             return NvStatus::NotImplemented;
         }
+
+        state.logger->Debug("{} @ {}: {}", typeString(), GetName(), function->name);
         try {
-            return function.first(type, buffer, inlineBuffer);
+            return (this->*function->function)(type, buffer, inlineBuffer);
         } catch (const std::exception &e) {
-            throw exception("{} ({} @ {}: {})", e.what(), typeString, GetName(), function.second);
+            throw exception("{} ({} @ {}: {})", e.what(), typeString(), GetName(), function->name);
         }
     }
 }
@@ -6,13 +6,12 @@
 #include <kernel/ipc.h>
 #include <kernel/types/KEvent.h>
 
-#define NVFUNC(id, Class, Function) std::pair<u32, std::pair<std::function<NvStatus(Class*, IoctlType, span<u8>, span<u8>)>, std::string_view>>{id, {&Class::Function, #Function}}
-#define NVDEVICE_DECL_AUTO(name, value) decltype(value) name = value
-#define NVDEVICE_DECL(...)                                                                                                                        \
-NVDEVICE_DECL_AUTO(functions, frz::make_unordered_map({__VA_ARGS__}));                                                                            \
-std::pair<std::function<NvStatus(IoctlType, span<u8>, span<u8>)>, std::string_view> GetIoctlFunction(u32 id) {                          \
-    auto& function{functions.at(id)};                                                                                                            \
-    return std::make_pair(std::bind(function.first, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), function.second); \
+#define NVFUNC(id, Class, Function) std::pair<u32, IoctlDescriptor>{id, {static_cast<IoctlFunction>(&Class::Function), #Function}}
+#define NVDEVICE_DECL(...)                                                                  \
+static constexpr auto IoctlFunctions{frz::make_unordered_map({__VA_ARGS__})};               \
+const IoctlDescriptor *GetIoctlFunction(u32 id) override {                                  \
+    auto function{IoctlFunctions.find(id)};                                                 \
+    return (function != IoctlFunctions.end()) ? &function->second : nullptr;                \
 }
 
 namespace skyline::service::nvdrv::device {
@@ -57,6 +56,18 @@ namespace skyline::service::nvdrv::device {
         Ioctl3, //!< 1 input/output buffer + 1 output buffer
     };
 
+    class NvDevice;
+
+    using IoctlFunction = NvStatus (NvDevice::*)(IoctlType, span<u8>, span<u8>); //!< A pointer to an IOCTL handler of a device, handlers of derived classes are cast to this
+
+    /**
+     * @brief A single entry in the dispatch table of a device
+     */
+    struct IoctlDescriptor {
+        IoctlFunction function; //!< The handler for the IOCTL
+        std::string_view name; //!< The name of the handler, this is only used for logging
+    };
+
     /**
      * @brief NvDevice is the base class that all /dev/nv* devices inherit from
      */
@@ -72,7 +83,10 @@ namespace skyline::service::nvdrv::device {
 
         virtual ~NvDevice() = default;
 
-        virtual std::pair<std::function<NvStatus(IoctlType, span<u8>, span<u8>)>, std::string_view> GetIoctlFunction(u32 id) = 0;
+        /**
+         * @return The entry of the IOCTL in the dispatch table of the device or nullptr if it isn't implemented, the table is a perfect hash map generated at compile-time by NVDEVICE_DECL
+         */
+        virtual const IoctlDescriptor *GetIoctlFunction(u32 id) = 0;
 
         /**
          * @return The name of the class
@@ -63,7 +63,7 @@ namespace skyline::service::nvdrv::device {
         try {
             auto driver{nvdrv::driver.lock()};
             auto nvmap{driver->nvMap.lock()};
-            auto mapping{nvmap->handleTable.at(data.nvmapHandle)};
+            auto mapping{nvmap->GetObject(data.nvmapHandle)};
 
             u64 mapPhysicalAddress{data.bufferOffset + mapping->address};
             u64 mapSize{data.mappingSize ? data.mappingSize : mapping->size};
@@ -131,23 +131,35 @@ namespace skyline::service::nvdrv::device {
         constexpr u32 MinAlignmentShift{0x10}; // This shift is applied to all addresses passed to Remap
 
         auto entries{buffer.cast<Entry>()};
-        for (auto entry : entries) {
-            try {
-                auto driver{nvdrv::driver.lock()};
-                auto nvmap{driver->nvMap.lock()};
-                auto mapping{nvmap->handleTable.at(entry.nvmapHandle)};
-
-                u64 mapAddress{static_cast<u64>(entry.gpuOffset) << MinAlignmentShift};
-                u64 mapPhysicalAddress{mapping->address + (static_cast<u64>(entry.mapOffset) << MinAlignmentShift)};
-                u64 mapSize{static_cast<u64>(entry.pages) << MinAlignmentShift};
+        auto driver{nvdrv::driver.lock()};
+        auto nvmap{driver->nvMap.lock()};
+
+        // All entries are translated prior to being applied as a single batch, this avoids updating the address space for every entry
+        std::vector<gpu::vmm::ChunkDescriptor> regions;
+        regions.reserve(entries.size());
+        for (const auto &entry : entries) {
+            u64 mapAddress{static_cast<u64>(entry.gpuOffset) << MinAlignmentShift};
+            u64 mapSize{static_cast<u64>(entry.pages) << MinAlignmentShift};
+
+            if (!entry.nvmapHandle) {
+                regions.emplace_back(mapAddress, mapSize, 0, gpu::vmm::ChunkState::Reserved); // A null handle unmaps the region while leaving it reserved
+                continue;
+            }
 
-                state.gpu->memoryManager.MapFixed(mapAddress, mapPhysicalAddress, mapSize);
+            try {
+                auto mapping{nvmap->GetObject(entry.nvmapHandle)};
+                regions.emplace_back(mapAddress, mapSize, mapping->address + (static_cast<u64>(entry.mapOffset) << MinAlignmentShift), gpu::vmm::ChunkState::Mapped);
             } catch (const std::out_of_range &) {
                 state.logger->Warn("Invalid NvMap handle: 0x{:X}", entry.nvmapHandle);
                 return NvStatus::BadParameter;
             }
         }
 
+        if (!state.gpu->memoryManager.MapFixed(regions)) {
+            state.logger->Warn("Failed to remap GPU address space regions!");
+            return NvStatus::BadParameter;
+        }
+
         return NvStatus::Success;
     }
 }
@@ -8,12 +8,14 @@
 #include "nvhost_channel.h"
 
 namespace skyline::service::nvdrv::device {
-    NvHostChannel::NvHostChannel(const DeviceState &state) : smExceptionBreakpointIntReportEvent(std::make_shared<type::KEvent>(state)), smExceptionBreakpointPauseReportEvent(std::make_shared<type::KEvent>(state)), errorNotifierEvent(std::make_shared<type::KEvent>(state)), NvDevice(state) {
+    NvHostChannel::NvHostChannel(const DeviceState &state) : smExceptionBreakpointIntReportEvent(std::make_shared<type::KEvent>(state)), smExceptionBreakpointPauseReportEvent(std::make_shared<type::KEvent>(state)), errorNotifierEvent(std::make_shared<type::KEvent>(state)), channel(std::make_shared<gpu::gpfifo::GPFIFO>(state, state.gpu->scheduler)), NvDevice(state) {
         auto driver{nvdrv::driver.lock()};
         auto &hostSyncpoint{driver->hostSyncpoint};
 
         channelFence.id = hostSyncpoint.AllocateSyncpoint(false);
         channelFence.UpdateValue(hostSyncpoint);
+
+        state.gpu->scheduler.AddChannel(channel);
     }
 
     NvStatus NvHostChannel::SetNvmapFd(IoctlType type, span<u8> buffer, span<u8> inlineBuffer) {
@@ -46,23 +48,26 @@ namespace skyline::service::nvdrv::device {
         auto driver{nvdrv::driver.lock()};
         auto &hostSyncpoint{driver->hostSyncpoint};
 
+        std::optional<gpu::gpfifo::SyncpointOperation> wait;
         if (data.flags.fenceWait) {
             if (data.flags.incrementWithValue)
                 return NvStatus::BadValue;
 
-            if (hostSyncpoint.HasSyncpointExpired(data.fence.id, data.fence.value))
-                throw exception("Waiting on a fence through SubmitGpfifo is unimplemented");
+            if (!hostSyncpoint.HasSyncpointExpired(data.fence.id, data.fence.value))
+                wait = gpu::gpfifo::SyncpointOperation{data.fence.id, data.fence.value};
         }
 
-        state.gpu->gpfifo.Push(span(state.process->GetPointer<gpu::gpfifo::GpEntry>(data.address), data.numEntries));
-
         data.fence.id = channelFence.id;
 
         u32 increment{(data.flags.fenceIncrement ? 2 : 0) + (data.flags.incrementWithValue ? data.fence.value : 0)};
         data.fence.value = hostSyncpoint.IncrementSyncpointMaxExt(data.fence.id, increment);
 
+        // The fence increment is performed by the GPFIFO after the entries, as the kernel would append a pushbuffer which increments the syncpoint twice
+        std::optional<gpu::gpfifo::SyncpointOperation> fenceIncrement;
         if (data.flags.fenceIncrement)
-            throw exception("Incrementing a fence through SubmitGpfifo is unimplemented");
+            fenceIncrement = gpu::gpfifo::SyncpointOperation{data.fence.id, 2};
+
+        channel->Push(span(state.process->GetPointer<gpu::gpfifo::GpEntry>(data.address), data.numEntries), wait, fenceIncrement);
 
         data.flags.raw = 0;
 
@@ -93,6 +98,8 @@ namespace skyline::service::nvdrv::device {
                 timeslice = 5200;
                 break;
         }
+        if (timeslice)
+            channel->SetTimeslice(std::chrono::microseconds(timeslice));
 
         return NvStatus::Success;
     }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <services/common/fence.h>
+#include <gpu/gpfifo.h>
 #include "nvdevice.h"
 
 namespace skyline::service::nvdrv::device {
@@ -20,10 +21,11 @@ namespace skyline::service::nvdrv::device {
         };
 
         Fence channelFence{};
-        u32 timeslice{};
+        u32 timeslice{}; //!< The timeslice of the channel in microseconds, this is set from its priority
         std::shared_ptr<type::KEvent> smExceptionBreakpointIntReportEvent;
         std::shared_ptr<type::KEvent> smExceptionBreakpointPauseReportEvent;
         std::shared_ptr<type::KEvent> errorNotifierEvent;
+        std::shared_ptr<gpu::gpfifo::GPFIFO> channel; //!< The GPFIFO of the channel with its own engines and subchannel bindings, it's run by the GPU's scheduler
 
       public:
         NvHostChannel(const DeviceState &state);
@@ -6,7 +6,7 @@
 namespace skyline::service::nvdrv::device {
     NvMap::NvMapObject::NvMapObject(u32 id, u32 size) : id(id), size(size) {}
 
-    NvMap::NvMap(const DeviceState &state) : NvDevice(state) {}
+    NvMap::NvMap(const DeviceState &state) : NvDevice(state), handleTable(1), idTable(1) {} // Handles and IDs start at 1, so the first entry of each table is always empty
 
     NvStatus NvMap::Create(IoctlType type, span<u8> buffer, span<u8> inlineBuffer) {
         struct Data {
@@ -14,7 +14,8 @@ namespace skyline::service::nvdrv::device {
             u32 handle; // Out
         } &data = buffer.as<Data>();
 
-        handleTable[handleIndex] = std::make_shared<NvMapObject>(idIndex++, data.size);
+        handleTable.push_back(std::make_shared<NvMapObject>(idIndex++, data.size));
+        idTable.push_back(handleIndex);
         data.handle = handleIndex++;
 
         state.logger->Debug("Size: 0x{:X} -> Handle: 0x{:X}", data.size, data.handle);
@@ -27,16 +28,15 @@ namespace skyline::service::nvdrv::device {
             u32 handle; // Out
         } &data = buffer.as<Data>();
 
-        for (const auto &object : handleTable) {
-            if (object.second->id == data.id) {
-                data.handle = object.first;
-                state.logger->Debug("ID: 0x{:X} -> Handle: 0x{:X}", data.id, data.handle);
-                return NvStatus::Success;
-            }
+        auto handle{GetHandleFromId(data.id)};
+        if (!handle) {
+            state.logger->Warn("Handle not found for ID: 0x{:X}", data.id);
+            return NvStatus::BadValue;
         }
 
-        state.logger->Warn("Handle not found for ID: 0x{:X}", data.id);
-        return NvStatus::BadValue;
+        data.handle = handle;
+        state.logger->Debug("ID: 0x{:X} -> Handle: 0x{:X}", data.id, data.handle);
+        return NvStatus::Success;
     }
 
     NvStatus NvMap::Alloc(IoctlType type, span<u8> buffer, span<u8> inlineBuffer) {
@@ -51,7 +51,7 @@ namespace skyline::service::nvdrv::device {
         } &data = buffer.as<Data>();
 
         try {
-            auto &object{handleTable.at(data.handle)};
+            auto object{GetObject(data.handle)};
             object->heapMask = data.heapMask;
             object->flags = data.flags;
             object->align = data.align;
@@ -77,7 +77,8 @@ namespace skyline::service::nvdrv::device {
         } &data = buffer.as<Data>();
 
         try {
-            const auto &object{handleTable.at(data.handle)};
+            GetObject(data.handle); // The handle is validated prior to the entry being accessed directly, so the use count doesn't include a copy of it
+            auto &object{handleTable[data.handle]};
             if (object.use_count() > 1) {
                 data.address = static_cast<u32>(object->address);
                 data.flags = 0x0;
@@ -87,7 +88,8 @@ namespace skyline::service::nvdrv::device {
             }
 
             data.size = object->size;
-            handleTable.erase(data.handle);
+            idTable[object->id] = 0;
+            object.reset();
 
             state.logger->Debug("Handle: 0x{:X} -> Address: 0x{:X}, Size: 0x{:X}, Flags: 0x{:X}", data.handle, data.address, data.size, data.flags);
             return NvStatus::Success;
@@ -115,7 +117,7 @@ namespace skyline::service::nvdrv::device {
         } &data = buffer.as<Data>();
 
         try {
-            auto &object{handleTable.at(data.handle)};
+            auto object{GetObject(data.handle)};
 
             switch (data.parameter) {
                 case Parameter::Size:
@@ -158,7 +160,7 @@ namespace skyline::service::nvdrv::device {
         } &data = buffer.as<Data>();
 
         try {
-            data.id = handleTable.at(data.handle)->id;
+            data.id = GetObject(data.handle)->id;
             state.logger->Debug("Handle: 0x{:X} -> ID: 0x{:X}", data.handle, data.id);
             return NvStatus::Success;
         } catch (const std::out_of_range &) {
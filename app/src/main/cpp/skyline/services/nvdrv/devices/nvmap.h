@@ -32,12 +32,30 @@ namespace skyline::service::nvdrv::device {
             NvMapObject(u32 id, u32 size);
         };
 
-        std::unordered_map<KHandle, std::shared_ptr<NvMapObject>> handleTable; //!< A mapping from a handle to it's corresponding NvMapObject
+        std::vector<std::shared_ptr<NvMapObject>> handleTable; //!< A dense table of NvMapObjects indexed by their handle, the entries of freed handles are null
+        std::vector<KHandle> idTable; //!< A dense table of handles indexed by the ID of their NvMapObject, the entries of freed objects are 0
         KHandle handleIndex{1}; //!< This is used to keep track of the next handle to allocate
         u32 idIndex{1}; //!< This is used to keep track of the next ID to allocate
 
         NvMap(const DeviceState &state);
 
+        /**
+         * @return The NvMapObject of the supplied handle, this is a copy of the entry as handleTable can be reallocated when handles are created
+         * @throw std::out_of_range If the handle doesn't correspond to an NvMapObject
+         */
+        inline std::shared_ptr<NvMapObject> GetObject(KHandle handle) {
+            if (handle >= handleTable.size() || !handleTable[handle])
+                throw std::out_of_range("Invalid NvMap handle");
+            return handleTable[handle];
+        }
+
+        /**
+         * @return The handle of the NvMapObject with the supplied ID or 0 if there's no such object
+         */
+        inline KHandle GetHandleFromId(u32 id) {
+            return (id < idTable.size()) ? idTable[id] : 0;
+        }
+
         /**
          * @brief Creates an NvMapObject and returns an handle to it
          * @url https://switchbrew.org/wiki/NV_services#NVMAP_IOC_CREATE
@@ -12,20 +12,26 @@ namespace skyline::service::nvdrv {
     Driver::Driver(const DeviceState &state) : state(state), hostSyncpoint(state) {}
 
     u32 Driver::OpenDevice(std::string_view path) {
-        state.logger->Debug("Opening NVDRV device ({}): {}", fdIndex, path);
+        std::lock_guard guard(mutex);
+
+        auto slot{std::find_if(devices.begin(), devices.end(), [](const std::atomic<device::NvDevice *> &device) { return device.load(std::memory_order_relaxed) == nullptr; })};
+        if (slot == devices.end())
+            throw exception("Cannot open NVDRV device as all {} FDs are in use: {}", devices.size(), path);
+        auto fd{static_cast<u32>(std::distance(devices.begin(), slot))};
+
+        state.logger->Debug("Opening NVDRV device ({}): {}", fd, path);
 
         switch (util::Hash(path)) {
-            #define NVDEVICE(type, name, devicePath)               \
-                case util::Hash(devicePath): {                     \
-                    std::shared_ptr<device::type> device{};        \
-                    if (name.expired()) {                          \
-                        device = device.make_shared(state);        \
-                        name = device;                             \
-                    } else {                                       \
-                        device = name.lock();                      \
-                    }                                              \
-                    devices.push_back(device);                     \
-                    break;                                         \
+            #define NVDEVICE(type, name, devicePath)                      \
+                case util::Hash(devicePath): {                            \
+                    std::shared_ptr<device::type> device{name.lock()};    \
+                    if (!device) {                                        \
+                        device = device.make_shared(state);               \
+                        name = device;                                    \
+                        ownedDevices.push_back(device);                   \
+                    }                                                     \
+                    slot->store(device.get(), std::memory_order_release); \
+                    break;                                                \
                 }
             NVDEVICE_LIST
             #undef NVDEVICE
@@ -34,27 +40,29 @@ namespace skyline::service::nvdrv {
                 throw exception("Cannot find NVDRV device");
         }
 
-        return fdIndex++;
+        return fd;
     }
 
-    std::shared_ptr<device::NvDevice> Driver::GetDevice(u32 fd) {
-        try {
-            auto item{devices.at(fd)};
-            if (!item)
-                throw exception("GetDevice was called with a closed file descriptor: 0x{:X}", fd);
-            return item;
-        } catch (std::out_of_range) {
+    device::NvDevice &Driver::GetDevice(u32 fd) {
+        if (fd >= devices.size())
             throw exception("GetDevice was called with invalid file descriptor: 0x{:X}", fd);
-        }
+
+        // Devices are never destroyed before the driver, so the device is safe to use even if the FD is closed by another thread after this
+        auto device{devices[fd].load(std::memory_order_acquire)};
+        if (!device)
+            throw exception("GetDevice was called with a closed file descriptor: 0x{:X}", fd);
+        return *device;
     }
 
     void Driver::CloseDevice(u32 fd) {
-        try {
-            auto &device{devices.at(fd)};
-            device.reset();
-        } catch (const std::out_of_range &) {
+        if (fd >= devices.size()) {
             state.logger->Warn("Trying to close non-existent FD");
+            return;
         }
+
+        std::lock_guard guard(mutex);
+        if (!devices[fd].exchange(nullptr, std::memory_order_relaxed))
+            state.logger->Warn("Trying to close non-existent FD");
     }
 
     std::weak_ptr<Driver> driver{};
@@ -29,8 +29,9 @@ namespace skyline::service::nvdrv {
     class Driver {
       private:
         const DeviceState &state;
-        std::vector<std::shared_ptr<device::NvDevice>> devices; //!< A vector of shared pointers to NvDevice object that correspond to FDs
-        u32 fdIndex{}; //!< The next file descriptor to assign
+        std::mutex mutex; //!< Synchronizes opening and closing FDs, lookups of FDs don't lock this
+        std::array<std::atomic<device::NvDevice *>, 0x100> devices{}; //!< The device that each FD refers to or nullptr if it isn't open, it's indexed by FD
+        std::vector<std::shared_ptr<device::NvDevice>> ownedDevices; //!< All devices that have been opened, they're kept alive for the lifetime of the driver so a closed FD can't free a device which is still being accessed through a lookup
 
       public:
         NvHostSyncpoint hostSyncpoint;
@@ -51,19 +52,20 @@ namespace skyline::service::nvdrv {
         /**
          * @brief Returns a particular device with a specific FD
          * @param fd The file descriptor to retrieve
-         * @return A shared pointer to the device
+         * @return A reference to the device, it stays valid even if the FD is closed concurrently
+         * @note This doesn't lock or touch any reference count, so it can be called from any number of threads without contention
          */
-        std::shared_ptr<device::NvDevice> GetDevice(u32 fd);
+        device::NvDevice &GetDevice(u32 fd);
 
         /**
          * @brief Returns a particular device with a specific FD
          * @tparam objectClass The class of the device to return
          * @param fd The file descriptor to retrieve
-         * @return A shared pointer to the device
+         * @return A reference to the device
          */
         template<typename objectClass>
-        inline std::shared_ptr<objectClass> GetDevice(u32 fd) {
-            return std::static_pointer_cast<objectClass>(GetDevice(fd));
+        inline objectClass &GetDevice(u32 fd) {
+            return static_cast<objectClass &>(GetDevice(fd));
         }
 
         /**
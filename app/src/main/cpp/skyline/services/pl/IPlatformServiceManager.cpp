@@ -2,43 +2,63 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <kernel/types/KProcess.h>
-#include "resources/FontChineseSimplified.ttf.h"
 #include "resources/FontChineseTraditional.ttf.h"
 #include "resources/FontExtendedChineseSimplified.ttf.h"
-#include "resources/FontKorean.ttf.h"
 #include "resources/FontNintendoExtended.ttf.h"
 #include "resources/FontStandard.ttf.h"
 #include "IPlatformServiceManager.h"
 
 namespace skyline::service::pl {
     struct FontEntry {
-        u8 *data; //!< The font TTF data
-        size_t length; //!< The length of the font TTF data
-        size_t offset; //!< The offset of the font in shared memory
+        const u8 *data; //!< The font TTF data
+        u32 length; //!< The length of the font TTF data
+        u32 offset{}; //!< The offset of the font in shared memory, this is directly after its header
     };
 
-    std::array<FontEntry, 6> fontTable{{
-                                           {FontChineseSimplified, FontExtendedChineseSimplifiedLength},
-                                           {FontChineseTraditional, FontChineseTraditionalLength},
-                                           {FontExtendedChineseSimplified, FontExtendedChineseSimplifiedLength},
-                                           {FontKorean, FontKoreanLength},
-                                           {FontNintendoExtended, FontNintendoExtendedLength},
-                                           {FontStandard, FontStandardLength}
-                                       }};
+    constexpr u32 SharedFontResult{0x7F9A0218}; //!< The decrypted magic for a single font in the shared font data
+    constexpr u32 SharedFontMagic{0x36F81A1E}; //!< The encrypted magic for a single font in the shared font data
+    constexpr u32 SharedFontKey{SharedFontMagic ^ SharedFontResult}; //!< The XOR key for encrypting the font size
+    constexpr u32 SharedFontHeaderSize{2 * sizeof(u32)}; //!< The size of the header prior to every font, it contains the decrypted magic and the encrypted size
 
-    IPlatformServiceManager::IPlatformServiceManager(const DeviceState &state, ServiceManager &manager) : fontSharedMem(std::make_shared<kernel::type::KSharedMemory>(state, NULL, constant::FontSharedMemSize, memory::Permission{true, false, false})), BaseService(state, manager) {
-        constexpr u32 SharedFontResult{0x7F9A0218}; //!< The decrypted magic for a single font in the shared font data
-        constexpr u32 SharedFontMagic{0x36F81A1E}; //!< The encrypted magic for a single font in the shared font data
-        constexpr u32 SharedFontKey{SharedFontMagic ^ SharedFontResult}; //!< The XOR key for encrypting the font size
+    /**
+     * @brief The layout of all fonts in shared memory, this is computed at compile time as all fonts are embedded in the binary
+     * @note Fonts with the same data share a single copy of it along with its header, as the header only depends on the data
+     */
+    constexpr std::array<FontEntry, 6> FontTable{[] {
+        std::array<FontEntry, 6> table{{
+            {FontStandard, FontStandardLength}, // Chinese Simplified
+            {FontChineseTraditional, FontChineseTraditionalLength},
+            {FontExtendedChineseSimplified, FontExtendedChineseSimplifiedLength},
+            {FontStandard, FontStandardLength}, // Korean
+            {FontNintendoExtended, FontNintendoExtendedLength},
+            {FontStandard, FontStandardLength},
+        }};
+
+        u32 offset{};
+        for (auto font{table.begin()}; font != table.end(); font++) {
+            auto copy{std::find_if(table.begin(), font, [&](const FontEntry &entry) { return entry.data == font->data; })};
+            if (copy != font) {
+                font->offset = copy->offset;
+            } else {
+                font->offset = offset + SharedFontHeaderSize;
+                offset = font->offset + font->length;
+            }
+        }
+        return table;
+    }()};
+    static_assert(std::all_of(FontTable.begin(), FontTable.end(), [](const FontEntry &font) { return font.offset + font.length <= constant::FontSharedMemSize; }));
 
-        auto pointer{reinterpret_cast<u32 *>(fontSharedMem->kernel.address)};
-        for (auto &font : fontTable) {
-            *pointer++ = SharedFontResult;
-            *pointer++ = font.length ^ SharedFontKey;
-            font.offset = reinterpret_cast<u64>(pointer) - fontSharedMem->kernel.address;
+    IPlatformServiceManager::IPlatformServiceManager(const DeviceState &state, ServiceManager &manager) : fontSharedMem(std::make_shared<kernel::type::KSharedMemory>(state, NULL, constant::FontSharedMemSize, memory::Permission{true, false, false})), BaseService(state, manager) {
+        // As the layout is precomputed, every distinct font only needs to be copied in once along with its header
+        auto base{reinterpret_cast<u8 *>(fontSharedMem->kernel.address)};
+        for (auto font{FontTable.begin()}; font != FontTable.end(); font++) {
+            if (std::find_if(FontTable.begin(), font, [&](const FontEntry &entry) { return entry.offset == font->offset; }) != font)
+                continue;
 
-            std::memcpy(pointer, font.data, font.length);
-            pointer = reinterpret_cast<u32 *>(reinterpret_cast<u64>(pointer) + font.length);
+            auto header{reinterpret_cast<u32 *>(base + font->offset - SharedFontHeaderSize)};
+            header[0] = SharedFontResult;
+            header[1] = font->length ^ SharedFontKey;
+            std::memcpy(base + font->offset, font->data, font->length);
         }
     }
 
@@ -50,13 +70,13 @@ namespace skyline::service::pl {
 
     Result IPlatformServiceManager::GetSize(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto fontId{request.Pop<u32>()};
-        response.Push<u32>(fontTable.at(fontId).length);
+        response.Push<u32>(FontTable.at(fontId).length);
         return {};
     }
 
     Result IPlatformServiceManager::GetSharedMemoryAddressOffset(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         auto fontId{request.Pop<u32>()};
-        response.Push<u32>(fontTable.at(fontId).offset);
+        response.Push<u32>(FontTable.at(fontId).offset);
         return {};
     }
 
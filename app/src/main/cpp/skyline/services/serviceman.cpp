@@ -2,6 +2,9 @@
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
 #include <kernel/types/KProcess.h>
+#include <statistics.h>
+#include <allocation.h>
+#include <trace.h>
 #include "sm/IUserInterface.h"
 #include "settings/ISettingsServer.h"
 #include "settings/ISystemSettingsServer.h"
@@ -37,7 +40,9 @@
         }
 
 namespace skyline::service {
-    ServiceManager::ServiceManager(const DeviceState &state) : state(state), smUserInterface(std::make_shared<sm::IUserInterface>(state, *this)) {}
+    ServiceManager::ServiceManager(const DeviceState &state) : state(state), smUserInterface(std::make_shared<sm::IUserInterface>(state, *this)), profiling(state.settings->GetBool("service_profiler", false)) {
+        smUserInterface->GetName();
+    }
 
     std::shared_ptr<BaseService> ServiceManager::CreateService(ServiceName name) {
         auto serviceIter{serviceMap.find(name)};
@@ -77,6 +82,7 @@ namespace skyline::service {
             SERVICE_CASE(nfp::IUserManager, "nfp:user")
             SERVICE_CASE(nifm::IStaticService, "nifm:u")
             SERVICE_CASE(socket::IClient, "bsd:u")
+            SERVICE_CASE(socket::IClient, "bsd:s")
             SERVICE_CASE(ssl::ISslService, "ssl")
             SERVICE_CASE(prepo::IPrepoService, "prepo:u")
             default:
@@ -87,33 +93,33 @@ namespace skyline::service {
     std::shared_ptr<BaseService> ServiceManager::NewService(ServiceName name, type::KSession &session, ipc::IpcResponse &response) {
         std::lock_guard serviceGuard(mutex);
         auto serviceObject{CreateService(name)};
+        auto &serviceName{serviceObject->GetName()}; // The name is resolved while registering the service so requests never have to demangle it
         KHandle handle{};
         if (session.isDomain) {
-            session.domains.push_back(serviceObject);
-            response.domainObjects.push_back(session.handleIndex);
-            handle = session.handleIndex++;
+            handle = session.AddDomainObject(serviceObject);
+            response.domainObjects.push_back(handle);
         } else {
             handle = state.process->NewHandle<type::KSession>(serviceObject).handle;
             response.moveHandles.push_back(handle);
         }
-        state.logger->Debug("Service has been created: \"{}\" (0x{:X})", serviceObject->GetName(), handle);
+        state.logger->Debug("Service has been created: \"{}\" (0x{:X})", serviceName, handle);
         return serviceObject;
     }
 
     void ServiceManager::RegisterService(std::shared_ptr<BaseService> serviceObject, type::KSession &session, ipc::IpcResponse &response) { // NOLINT(performance-unnecessary-value-param)
         std::lock_guard serviceGuard(mutex);
+        auto &name{serviceObject->GetName()}; // The name is resolved while registering the service so requests never have to demangle it
         KHandle handle{};
 
         if (session.isDomain) {
-            session.domains.push_back(serviceObject);
-            response.domainObjects.push_back(session.handleIndex);
-            handle = session.handleIndex++;
+            handle = session.AddDomainObject(serviceObject);
+            response.domainObjects.push_back(handle);
         } else {
             handle = state.process->NewHandle<type::KSession>(serviceObject).handle;
             response.moveHandles.push_back(handle);
         }
 
-        state.logger->Debug("Service has been registered: \"{}\" (0x{:X})", serviceObject->GetName(), handle);
+        state.logger->Debug("Service has been registered: \"{}\" (0x{:X})", name, handle);
     }
 
     void ServiceManager::CloseSession(KHandle handle) {
@@ -122,9 +128,10 @@ namespace skyline::service {
         if (session->isOpen) {
             if (session->isDomain) {
                 for (const auto &domainService : session->domains)
-                    std::erase_if(serviceMap, [domainService](const auto &entry) {
-                        return entry.second == domainService;
-                    });
+                    if (domainService)
+                        std::erase_if(serviceMap, [&domainService](const auto &entry) {
+                            return entry.second == domainService;
+                        });
             } else {
                 std::erase_if(serviceMap, [session](const auto &entry) {
                     return entry.second == session->serviceObject;
@@ -134,7 +141,77 @@ namespace skyline::service {
         }
     }
 
+    void ServiceManager::ServiceStatistics::Record(BaseService &service, const ServiceFunctionDescriptor &function, u64 duration) {
+        auto it{entries.find(&function)};
+        if (__predict_false(it == entries.end())) {
+            std::lock_guard guard(mutex);
+            it = entries.try_emplace(&function, service.GetName(), function).first;
+        }
+
+        auto &entry{it->second};
+        entry.count.store(entry.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        entry.time.store(entry.time.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+
+        auto &bucket{entry.buckets[std::min<size_t>(63 - __builtin_clzll(duration | 1), BucketCount - 1)]};
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    ServiceManager::ServiceStatistics &ServiceManager::GetThreadStatistics() {
+        thread_local ServiceManager *owner{};
+        thread_local std::shared_ptr<ServiceStatistics> statistics;
+
+        if (__predict_false(owner != this)) {
+            statistics = std::make_shared<ServiceStatistics>();
+            owner = this;
+
+            std::lock_guard guard(statisticsMutex);
+            serviceStatistics.push_back(statistics);
+        }
+
+        return *statistics;
+    }
+
+    std::string ServiceManager::GetServiceProfile() {
+        struct Totals {
+            std::string_view service;
+            const ServiceFunctionDescriptor *function;
+            u64 count;
+            u64 time;
+            std::array<u64, ServiceStatistics::BucketCount> buckets;
+        };
+        std::map<std::pair<std::string_view, u32>, Totals> totals; // This is sorted by service and command ID to keep the output stable
+
+        std::lock_guard guard(statisticsMutex);
+        for (const auto &statistics : serviceStatistics) {
+            std::lock_guard statisticsGuard(statistics->mutex);
+            for (const auto &[descriptor, entry] : statistics->entries) {
+                auto &total{totals.try_emplace({entry.service, descriptor->id}, Totals{entry.service, descriptor}).first->second};
+                total.count += entry.count.load(std::memory_order_relaxed);
+                total.time += entry.time.load(std::memory_order_relaxed);
+                for (size_t index{}; index < ServiceStatistics::BucketCount; index++)
+                    total.buckets[index] += entry.buckets[index].load(std::memory_order_relaxed);
+            }
+        }
+
+        std::string profile{"Service,Command,Function,Count,Time"};
+        for (size_t index{}; index < ServiceStatistics::BucketCount; index++)
+            profile += fmt::format(",Bucket{}", index);
+        profile += '\n';
+
+        for (const auto &[key, total] : totals) {
+            profile += fmt::format("{},0x{:X},{},{},{}", total.service, total.function->id, total.function->name, total.count, total.time);
+            for (auto bucket : total.buckets)
+                profile += fmt::format(",{}", bucket);
+            profile += '\n';
+        }
+
+        return profile;
+    }
+
     void ServiceManager::SyncRequestHandler(KHandle handle) {
+        TRACE_SCOPE("ServiceManager::SyncRequestHandler");
+        allocation::Scope allocationScope(allocation::Tag::Ipc);
+        state.statistics->ipcRequestCount.fetch_add(1, std::memory_order_relaxed);
         auto session{state.process->GetHandle<type::KSession>(handle)};
         state.logger->Debug("----Start----");
         state.logger->Debug("Handle is 0x{:X}", handle);
@@ -147,28 +224,24 @@ namespace skyline::service {
                 case ipc::CommandType::Request:
                 case ipc::CommandType::RequestWithContext:
                     if (session->isDomain) {
-                        try {
-                            auto service{session->domains.at(request.domain->objectId)};
-                            if (service == nullptr)
-                                throw exception("Domain request used an expired handle");
-                            switch (request.domain->command) {
-                                case ipc::DomainCommand::SendMessage:
-                                    response.errorCode = service->HandleRequest(*session, request, response);
-                                    break;
-
-                                case ipc::DomainCommand::CloseVHandle:
-                                    std::erase_if(serviceMap, [service](const auto &entry) {
-                                        return entry.second == service;
-                                    });
-                                    session->domains.at(request.domain->objectId).reset();
-                                    break;
+                        switch (request.domain->command) {
+                            case ipc::DomainCommand::SendMessage:
+                                response.errorCode = session->GetDomainObject(request.domain->objectId)->HandleRequest(*session, request, response);
+                                break;
+
+                            case ipc::DomainCommand::CloseVHandle: {
+                                auto service{session->CloseDomainObject(request.domain->objectId)};
+                                std::lock_guard serviceGuard(mutex);
+                                std::erase_if(serviceMap, [&service](const auto &entry) {
+                                    return entry.second == service;
+                                });
+                                break;
                             }
-                        } catch (std::out_of_range &) {
-                            throw exception("Invalid object ID was used with domain request");
                         }
                     } else {
                         response.errorCode = session->serviceObject->HandleRequest(*session, request, response);
                     }
+                    request.WriteBackBuffers();
                     response.WriteResponse(session->isDomain);
                     break;
 
@@ -11,10 +11,40 @@ namespace skyline::service {
      * @brief The ServiceManager class manages passing IPC requests to the right Service and running event loops of Services
      */
     class ServiceManager {
+      public:
+        /**
+         * @brief Statistics about the service commands handled by a single kernel thread, these are only written to by that thread
+         */
+        struct ServiceStatistics {
+            static constexpr size_t BucketCount{32}; //!< The amount of latency buckets, bucket N counts requests which took [2^N, 2^(N + 1)) ns with the last bucket counting all longer requests
+
+            struct Entry {
+                std::string service; //!< The name of the service which handled the command
+                const ServiceFunctionDescriptor &function; //!< The descriptor of the command
+                std::atomic<u64> count; //!< The amount of times the command has been handled
+                std::atomic<u64> time; //!< The total amount of time spent handling the command in nanoseconds
+                std::array<std::atomic<u64>, BucketCount> buckets; //!< A log2 histogram of the latency of the command
+
+                Entry(std::string service, const ServiceFunctionDescriptor &function) : service(std::move(service)), function(function), count(), time(), buckets() {}
+            };
+
+            Mutex mutex; //!< Synchronizes insertions into entries with readers, lookups by the owning thread don't need to lock as it's the only writer
+            std::unordered_map<const ServiceFunctionDescriptor *, Entry> entries; //!< The statistics of every command handled by the thread keyed by their descriptor, which is unique for every command of every service class
+
+            /**
+             * @brief Records a single request to a service command
+             * @param duration The duration of the request in nanoseconds
+             * @note As there's only a single writer, this avoids atomic RMW operations while still allowing concurrent reads
+             */
+            void Record(BaseService &service, const ServiceFunctionDescriptor &function, u64 duration);
+        };
+
       private:
         const DeviceState &state;
         std::unordered_map<ServiceName, std::shared_ptr<BaseService>> serviceMap; //!< A mapping from a Service to the underlying object
         Mutex mutex; //!< Synchronizes concurrent access to services to prevent crashes
+        Mutex statisticsMutex; //!< Synchronizes access to serviceStatistics
+        std::vector<std::shared_ptr<ServiceStatistics>> serviceStatistics; //!< The service statistics of every kernel thread, these are retained after the thread exits to keep the totals intact
 
         /**
          * @brief Creates an instance of the service if it doesn't already exist, otherwise returns an existing instance
@@ -25,6 +55,7 @@ namespace skyline::service {
 
       public:
         std::shared_ptr<BaseService> smUserInterface; //!< Used by applications to open connections to services
+        const bool profiling; //!< If the service statistics are recorded, this is controlled by the "service_profiler" setting
 
         ServiceManager(const DeviceState &state);
 
@@ -73,9 +104,21 @@ namespace skyline::service {
          */
         void CloseSession(KHandle handle);
 
+        /**
+         * @return The service statistics of the calling kernel thread, these are created and registered on the first request of the thread
+         */
+        ServiceStatistics &GetThreadStatistics();
+
+        /**
+         * @brief Sums up the service statistics of all kernel threads
+         * @return A CSV table with the service, command ID, function name, request count, total time and all latency buckets in nanoseconds of every command that was handled
+         */
+        std::string GetServiceProfile();
+
         /**
          * @brief Handles a Synchronous IPC Request
          * @param handle The handle of the object
+         * @note This runs on the kernel thread of the calling guest thread without holding JniMtx, so a slow request only blocks its caller while other guest threads keep running and sending their own requests concurrently
          */
         void SyncRequestHandler(KHandle handle);
     };
@@ -37,7 +37,7 @@ namespace skyline::service {
 
             SERVICE_DECL(
                 SFUNC(0x1, ISettingsServer, GetAvailableLanguageCodes),
-                SFUNC(0x2, ISettingsServer, MakeLanguageCode),
+                SFUNC_PURE(0x2, ISettingsServer, MakeLanguageCode),
                 SFUNC(0x5, ISettingsServer, GetAvailableLanguageCodes2)
             )
         };
@@ -1,11 +1,314 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "IClient.h"
 
+extern std::atomic<bool> Halt;
+
 namespace skyline::service::socket {
+    /**
+     * @brief The layout of sockaddr_in on HOS, it matches FreeBSD which has a leading length byte that Linux doesn't
+     */
+    struct GuestSockAddrIn {
+        u8 length;
+        u8 family;
+        u16 port; //!< The port in network byte order
+        u32 address; //!< The IPv4 address in network byte order
+        std::array<u8, 8> _pad_;
+    };
+    static_assert(sizeof(GuestSockAddrIn) == 0x10);
+
+    constexpr u32 GuestSocketNonBlock{0x20000000}; //!< SOCK_NONBLOCK in the type of Socket
+    constexpr u32 GuestSocketCloseOnExec{0x10000000}; //!< SOCK_CLOEXEC in the type of Socket
+    constexpr u32 GuestMsgPeek{0x2}; //!< MSG_PEEK in the flags of Send and Recv
+    constexpr u32 GuestMsgWaitAll{0x40}; //!< MSG_WAITALL in the flags of Recv
+    constexpr u32 GuestMsgDontWait{0x80}; //!< MSG_DONTWAIT in the flags of Send and Recv
+    constexpr u32 GuestONonBlock{0x4}; //!< O_NONBLOCK in the flags of Fcntl
+    constexpr i32 GuestSolSocket{0xFFFF}; //!< SOL_SOCKET in the level of GetSockOpt and SetSockOpt
+
+    /**
+     * @return The FreeBSD errno equivalent to a Linux errno, values below 35 are the same on both
+     */
+    static u32 TranslateErrno(int error) {
+        switch (error) {
+            case EAGAIN:
+                return 35;
+            case EINPROGRESS:
+                return 36;
+            case EALREADY:
+                return 37;
+            case ENOTSOCK:
+                return 38;
+            case EDESTADDRREQ:
+                return 39;
+            case EMSGSIZE:
+                return 40;
+            case EPROTOTYPE:
+                return 41;
+            case ENOPROTOOPT:
+                return 42;
+            case EPROTONOSUPPORT:
+                return 43;
+            case EOPNOTSUPP:
+                return 45;
+            case EAFNOSUPPORT:
+                return 47;
+            case EADDRINUSE:
+                return 48;
+            case EADDRNOTAVAIL:
+                return 49;
+            case ENETDOWN:
+                return 50;
+            case ENETUNREACH:
+                return 51;
+            case ECONNABORTED:
+                return 53;
+            case ECONNRESET:
+                return 54;
+            case ENOBUFS:
+                return 55;
+            case EISCONN:
+                return 56;
+            case ENOTCONN:
+                return 57;
+            case ETIMEDOUT:
+                return 60;
+            case ECONNREFUSED:
+                return 61;
+            case EHOSTUNREACH:
+                return 65;
+            default:
+                return (error < 35) ? static_cast<u32>(error) : EINVAL;
+        }
+    }
+
+    /**
+     * @brief Translates the level and name of a socket option from FreeBSD to Linux
+     * @return If the option is supported
+     */
+    static bool TranslateSocketOption(i32 &level, i32 &name) {
+        if (level == GuestSolSocket) {
+            level = SOL_SOCKET;
+            switch (name) {
+                case 0x4:
+                    name = SO_REUSEADDR;
+                    return true;
+                case 0x8:
+                    name = SO_KEEPALIVE;
+                    return true;
+                case 0x20:
+                    name = SO_BROADCAST;
+                    return true;
+                case 0x80:
+                    name = SO_LINGER;
+                    return true;
+                case 0x200:
+                    name = SO_REUSEPORT;
+                    return true;
+                case 0x1001:
+                    name = SO_SNDBUF;
+                    return true;
+                case 0x1002:
+                    name = SO_RCVBUF;
+                    return true;
+                case 0x1005:
+                    name = SO_SNDTIMEO;
+                    return true;
+                case 0x1006:
+                    name = SO_RCVTIMEO;
+                    return true;
+                case 0x1007:
+                    name = SO_ERROR;
+                    return true;
+                case 0x1008:
+                    name = SO_TYPE;
+                    return true;
+                default:
+                    return false;
+            }
+        } else if (level == IPPROTO_IP) {
+            switch (name) {
+                case 0x3:
+                    name = IP_TOS;
+                    return true;
+                case 0x4:
+                    name = IP_TTL;
+                    return true;
+                case 0x9:
+                    name = IP_MULTICAST_IF;
+                    return true;
+                case 0xA:
+                    name = IP_MULTICAST_TTL;
+                    return true;
+                case 0xB:
+                    name = IP_MULTICAST_LOOP;
+                    return true;
+                case 0xC:
+                    name = IP_ADD_MEMBERSHIP;
+                    return true;
+                case 0xD:
+                    name = IP_DROP_MEMBERSHIP;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        return true; // The options of the other levels such as IPPROTO_TCP match
+    }
+
+    /**
+     * @return The Linux equivalent of the FreeBSD flags of Send and Recv, MSG_DONTWAIT and MSG_WAITALL are handled separately as host sockets are always non-blocking
+     */
+    static int TranslateMessageFlags(u32 flags) {
+        int hostFlags{MSG_NOSIGNAL}; // A SIGPIPE from writing to a closed connection would terminate the emulator
+        if (flags & 0x1)
+            hostFlags |= MSG_OOB;
+        if (flags & GuestMsgPeek)
+            hostFlags |= MSG_PEEK;
+        if (flags & 0x4)
+            hostFlags |= MSG_DONTROUTE;
+        return hostFlags;
+    }
+
+    /**
+     * @brief Reads a guest IPv4 address from a buffer
+     * @return If the buffer contained a valid IPv4 address
+     */
+    static bool ReadAddress(span<u8> buffer, sockaddr_in &address) {
+        if (buffer.size() < sizeof(GuestSockAddrIn))
+            return false;
+
+        auto &guest{buffer.as<GuestSockAddrIn>()};
+        address = {
+            .sin_family = guest.family,
+            .sin_port = guest.port,
+            .sin_addr = {guest.address},
+        };
+        return guest.family == AF_INET;
+    }
+
+    /**
+     * @brief Writes a host IPv4 address to a guest buffer
+     * @return The size of the guest address
+     */
+    static u32 WriteAddress(span<u8> buffer, const sockaddr_in &address) {
+        GuestSockAddrIn guest{
+            .length = sizeof(GuestSockAddrIn),
+            .family = static_cast<u8>(address.sin_family),
+            .port = address.sin_port,
+            .address = address.sin_addr.s_addr,
+        };
+        std::memcpy(buffer.data(), &guest, std::min(buffer.size(), sizeof(GuestSockAddrIn)));
+        return sizeof(GuestSockAddrIn);
+    }
+
+    /**
+     * @brief Waits for any of the supplied events to occur on the host sockets
+     * @param timeout The timeout in milliseconds, -1 waits indefinitely
+     * @return The amount of ready sockets, this returns 0 early if emulation is halted
+     */
+    static int WaitSockets(span<pollfd> fds, i32 timeout = -1) {
+        constexpr i32 WaitSlice{100}; // The maximum duration to poll for prior to checking Halt (100ms)
+
+        while (!Halt) {
+            auto slice{(timeout < 0) ? WaitSlice : std::min(timeout, WaitSlice)};
+            auto result{::poll(fds.data(), fds.size(), slice)};
+            if (result != 0 && !(result < 0 && errno == EINTR))
+                return result;
+            if (timeout >= 0 && (timeout -= slice) <= 0)
+                return 0;
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Calls a host socket function until it doesn't fail with EAGAIN, while waiting for the socket to be ready in between if the guest socket is blocking
+     * @param events The poll events to wait for prior to retrying the call
+     * @return The result of the host call, errno is set if it failed
+     */
+    template<typename Function>
+    static i64 RetryOnBlock(int fd, bool nonBlocking, short events, Function function) {
+        while (true) {
+            i64 result{function()};
+            if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK) || nonBlocking)
+                return result;
+
+            pollfd pollFd{.fd = fd, .events = events};
+            if (WaitSockets(span<pollfd>(&pollFd, 1)) <= 0) {
+                errno = EINTR;
+                return -1;
+            }
+        }
+    }
+
+    /**
+     * @brief Receives data from a host socket like RetryOnBlock, MSG_WAITALL is emulated on blocking stream sockets by receiving till the buffer is full as it has no effect on non-blocking host sockets
+     * @param function A host receive call which receives into the supplied part of the buffer
+     * @return The amount of bytes received or the result of the host call if it failed prior to receiving anything, errno is set if it failed
+     */
+    template<typename Function>
+    static i64 ReceiveOnBlock(int fd, bool nonBlocking, u32 flags, span<u8> buffer, Function function) {
+        int type{};
+        socklen_t typeLength{sizeof(type)};
+        if (!(flags & GuestMsgWaitAll) || (flags & GuestMsgPeek) || nonBlocking || ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) < 0 || type != SOCK_STREAM)
+            return RetryOnBlock(fd, nonBlocking, POLLIN, [&]() { return function(buffer); });
+
+        // Like on the host kernel, the wait ends early on an orderly shutdown or an error, whatever was received prior to that is still returned
+        size_t received{};
+        while (received < buffer.size()) {
+            auto result{RetryOnBlock(fd, false, POLLIN, [&]() { return function(buffer.subspan(received)); })};
+            if (result <= 0)
+                return received ? static_cast<i64>(received) : result;
+            received += static_cast<size_t>(result);
+        }
+        return static_cast<i64>(received);
+    }
+
+    /**
+     * @brief Pushes the common return value and the errno of the last host call translated to its BSD equivalent
+     * @param result The return value of the host call
+     */
+    static void PushResult(ipc::IpcResponse &response, i64 result) {
+        auto error{errno};
+        response.Push<i32>(static_cast<i32>(result));
+        response.Push<u32>((result < 0) ? TranslateErrno(error) : 0);
+    }
+
     IClient::IClient(const DeviceState &state, ServiceManager &manager) : BaseService(state, manager) {}
 
+    IClient::~IClient() {
+        for (const auto &socket : sockets)
+            if (socket.fd != -1)
+                ::close(socket.fd);
+    }
+
+    IClient::ClientSocket IClient::GetSocket(i32 fd) {
+        std::lock_guard guard(socketLock);
+        if (fd < 0 || static_cast<size_t>(fd) >= sockets.size())
+            return {};
+        return sockets[static_cast<size_t>(fd)];
+    }
+
+    i32 IClient::AddSocket(int hostFd) {
+        std::lock_guard guard(socketLock);
+        if (!freeSockets.empty()) {
+            auto fd{freeSockets.back()};
+            freeSockets.pop_back();
+            sockets[static_cast<size_t>(fd)] = {hostFd};
+            return fd;
+        }
+
+        sockets.push_back({hostFd});
+        return static_cast<i32>(sockets.size() - 1);
+    }
+
     Result IClient::RegisterClient(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         response.Push<u32>(0);
         return {};
@@ -14,4 +317,411 @@ namespace skyline::service::socket {
     Result IClient::StartMonitoring(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         return {};
     }
+
+    Result IClient::Socket(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto domain{request.Pop<u32>()};
+        auto type{request.Pop<u32>()};
+        auto protocol{request.Pop<u32>()};
+
+        if (domain != AF_INET) {
+            errno = EAFNOSUPPORT;
+            PushResult(response, -1);
+            return {};
+        }
+
+        auto hostFd{::socket(AF_INET, static_cast<int>(type & ~(GuestSocketNonBlock | GuestSocketCloseOnExec)) | SOCK_NONBLOCK | SOCK_CLOEXEC, static_cast<int>(protocol))};
+        if (hostFd < 0) {
+            PushResult(response, -1);
+            return {};
+        }
+
+        auto fd{AddSocket(hostFd)};
+        if (type & GuestSocketNonBlock) {
+            std::lock_guard guard(socketLock);
+            sockets[static_cast<size_t>(fd)].nonBlocking = true;
+        }
+
+        state.logger->Debug("Socket: Type: {}, Protocol: {}, FD: {}", type, protocol, fd);
+        PushResult(response, fd);
+        return {};
+    }
+
+    Result IClient::Select(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto nfds{request.Pop<i32>()};
+        request.Skip<u32>(); // The timeval is aligned to 8 bytes
+        auto seconds{request.Pop<i64>()};
+        auto microseconds{request.Pop<i64>()};
+        auto infinite{request.Pop<bool>()}; // If the guest supplied a null timeout
+
+        // The read, write and exception sets are auto-select buffers, null sets are retained as empty buffers so they can be told apart
+        // The input sets are copied as guests commonly supply the same memory for the input and output set
+        constexpr std::array<short, 3> SetEvents{POLLIN, POLLOUT, POLLPRI};
+        constexpr std::array<short, 3> SetResults{POLLIN | POLLHUP | POLLERR, POLLOUT | POLLERR, POLLPRI};
+        std::array<std::vector<u8>, 3> inputSets;
+        std::array<span<u8>, 3> outputSets;
+        for (size_t set{}; set < inputSets.size(); set++) {
+            auto input{request.GetAutoSelectInput(set)};
+            inputSets[set].assign(input.begin(), input.end());
+            outputSets[set] = request.GetAutoSelectOutput(set);
+        }
+
+        if (nfds < 0 || (!infinite && (seconds < 0 || microseconds < 0))) {
+            errno = EINVAL;
+            PushResult(response, -1);
+            return {};
+        }
+
+        // An FD is bit (FD % 8) of byte (FD / 8) of a set regardless of the word size of fd_set as the guest is little-endian
+        auto isSet{[](const std::vector<u8> &set, i32 fd) {
+            return static_cast<size_t>(fd / 8) < set.size() && (set[static_cast<size_t>(fd / 8)] & (1 << (fd % 8)));
+        }};
+
+        std::vector<pollfd> hostFds;
+        std::vector<i32> guestFds;
+        for (i32 fd{}; fd < nfds; fd++) {
+            short events{};
+            for (size_t set{}; set < inputSets.size(); set++)
+                if (isSet(inputSets[set], fd))
+                    events |= SetEvents[set];
+            if (!events)
+                continue;
+
+            auto socket{GetSocket(fd)};
+            if (socket.fd < 0) {
+                errno = EBADF;
+                PushResult(response, -1);
+                return {};
+            }
+
+            hostFds.push_back({.fd = socket.fd, .events = events});
+            guestFds.push_back(fd);
+        }
+
+        constexpr i64 MaxTimeout{std::numeric_limits<i32>::max()}; // The maximum timeout in milliseconds, longer timeouts are clamped to it
+        i64 timeout{infinite ? -1 : std::min((std::min(seconds, MaxTimeout / 1000) * 1000) + (microseconds / 1000), MaxTimeout)};
+        auto result{WaitSockets(hostFds, static_cast<i32>(timeout))};
+        if (result < 0) {
+            PushResult(response, -1);
+            return {};
+        }
+
+        // Unlike poll, select counts every set that an FD is ready in separately
+        for (auto &set : outputSets)
+            std::fill(set.begin(), set.end(), 0);
+        result = 0;
+        for (size_t index{}; index < hostFds.size(); index++) {
+            auto fd{guestFds[index]};
+            for (size_t set{}; set < outputSets.size(); set++) {
+                if (isSet(inputSets[set], fd) && (hostFds[index].revents & SetResults[set]) && static_cast<size_t>(fd / 8) < outputSets[set].size()) {
+                    outputSets[set][static_cast<size_t>(fd / 8)] |= static_cast<u8>(1 << (fd % 8));
+                    result++;
+                }
+            }
+        }
+
+        PushResult(response, result);
+        return {};
+    }
+
+    Result IClient::Poll(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto count{request.Pop<u32>()};
+        auto timeout{request.Pop<i32>()};
+
+        auto guestFds{request.inputBuf.at(0).cast<pollfd>()};
+        auto outputFds{request.outputBuf.at(0).cast<pollfd>()};
+        if (count > guestFds.size() || count > outputFds.size())
+            throw exception("Poll called with more FDs than the buffers can hold: {}", count);
+
+        std::vector<pollfd> hostFds(count);
+        for (size_t index{}; index < count; index++)
+            hostFds[index] = {.fd = (guestFds[index].fd >= 0) ? GetSocket(guestFds[index].fd).fd : -1, .events = guestFds[index].events};
+
+        auto result{WaitSockets(hostFds, timeout)};
+        if (result >= 0) {
+            for (size_t index{}; index < count; index++) {
+                outputFds[index] = guestFds[index];
+                outputFds[index].revents = hostFds[index].revents;
+                if (guestFds[index].fd >= 0 && hostFds[index].fd < 0) {
+                    outputFds[index].revents = POLLNVAL; // Host poll ignores negative FDs, an invalid guest FD is reported as such instead
+                    result++;
+                }
+            }
+        }
+
+        PushResult(response, result);
+        return {};
+    }
+
+    Result IClient::Recv(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto flags{request.Pop<u32>()};
+        auto buffer{request.outputBuf.at(0)};
+
+        PushResult(response, ReceiveOnBlock(socket.fd, socket.nonBlocking || (flags & GuestMsgDontWait), flags, buffer, [&](span<u8> part) {
+            return ::recv(socket.fd, part.data(), part.size(), TranslateMessageFlags(flags));
+        }));
+        return {};
+    }
+
+    Result IClient::RecvFrom(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto flags{request.Pop<u32>()};
+        auto buffer{request.outputBuf.at(0)};
+
+        sockaddr_in address{};
+        socklen_t addressLength{sizeof(address)};
+        auto result{ReceiveOnBlock(socket.fd, socket.nonBlocking || (flags & GuestMsgDontWait), flags, buffer, [&](span<u8> part) {
+            return ::recvfrom(socket.fd, part.data(), part.size(), TranslateMessageFlags(flags), reinterpret_cast<sockaddr *>(&address), &addressLength);
+        })};
+
+        PushResult(response, result);
+        response.Push<u32>((result >= 0 && request.outputBuf.size() > 1) ? WriteAddress(request.outputBuf[1], address) : 0);
+        return {};
+    }
+
+    Result IClient::Send(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto flags{request.Pop<u32>()};
+        auto buffer{request.inputBuf.at(0)};
+
+        PushResult(response, RetryOnBlock(socket.fd, socket.nonBlocking || (flags & GuestMsgDontWait), POLLOUT, [&]() {
+            return ::send(socket.fd, buffer.data(), buffer.size(), TranslateMessageFlags(flags));
+        }));
+        return {};
+    }
+
+    Result IClient::SendTo(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto flags{request.Pop<u32>()};
+        auto buffer{request.inputBuf.at(0)};
+
+        sockaddr_in address{};
+        if (!ReadAddress(request.inputBuf.at(1), address)) {
+            errno = EAFNOSUPPORT;
+            PushResult(response, -1);
+            return {};
+        }
+
+        PushResult(response, RetryOnBlock(socket.fd, socket.nonBlocking || (flags & GuestMsgDontWait), POLLOUT, [&]() {
+            return ::sendto(socket.fd, buffer.data(), buffer.size(), TranslateMessageFlags(flags), reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        }));
+        return {};
+    }
+
+    Result IClient::Accept(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+
+        sockaddr_in address{};
+        socklen_t addressLength{sizeof(address)};
+        auto hostFd{RetryOnBlock(socket.fd, socket.nonBlocking, POLLIN, [&]() {
+            return ::accept4(socket.fd, reinterpret_cast<sockaddr *>(&address), &addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        })};
+
+        if (hostFd < 0) {
+            PushResult(response, -1);
+            response.Push<u32>(0);
+            return {};
+        }
+
+        PushResult(response, AddSocket(static_cast<int>(hostFd)));
+        response.Push<u32>(!request.outputBuf.empty() ? WriteAddress(request.outputBuf[0], address) : 0);
+        return {};
+    }
+
+    Result IClient::Bind(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+
+        sockaddr_in address{};
+        if (!ReadAddress(request.inputBuf.at(0), address)) {
+            errno = EAFNOSUPPORT;
+            PushResult(response, -1);
+            return {};
+        }
+
+        PushResult(response, ::bind(socket.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+        return {};
+    }
+
+    Result IClient::Connect(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+
+        sockaddr_in address{};
+        if (!ReadAddress(request.inputBuf.at(0), address)) {
+            errno = EAFNOSUPPORT;
+            PushResult(response, -1);
+            return {};
+        }
+
+        auto result{::connect(socket.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))};
+        if (result < 0 && errno == EINPROGRESS && !socket.nonBlocking) {
+            // The host socket is non-blocking so a blocking connect is emulated by waiting for it to become writable and retrieving the result of the connection
+            pollfd pollFd{.fd = socket.fd, .events = POLLOUT};
+            if (WaitSockets(span<pollfd>(&pollFd, 1)) > 0) {
+                int error{};
+                socklen_t errorLength{sizeof(error)};
+                ::getsockopt(socket.fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+                errno = error;
+                result = error ? -1 : 0;
+            } else {
+                errno = EINTR;
+            }
+        }
+
+        PushResult(response, result);
+        return {};
+    }
+
+    Result IClient::GetPeerName(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+
+        sockaddr_in address{};
+        socklen_t addressLength{sizeof(address)};
+        auto result{::getpeername(socket.fd, reinterpret_cast<sockaddr *>(&address), &addressLength)};
+
+        PushResult(response, result);
+        response.Push<u32>((result >= 0) ? WriteAddress(request.outputBuf.at(0), address) : 0);
+        return {};
+    }
+
+    Result IClient::GetSockName(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+
+        sockaddr_in address{};
+        socklen_t addressLength{sizeof(address)};
+        auto result{::getsockname(socket.fd, reinterpret_cast<sockaddr *>(&address), &addressLength)};
+
+        PushResult(response, result);
+        response.Push<u32>((result >= 0) ? WriteAddress(request.outputBuf.at(0), address) : 0);
+        return {};
+    }
+
+    Result IClient::GetSockOpt(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto level{request.Pop<i32>()};
+        auto name{request.Pop<i32>()};
+        auto buffer{request.outputBuf.at(0)};
+
+        if (!TranslateSocketOption(level, name)) {
+            state.logger->Warn("GetSockOpt: Unsupported option: Level: 0x{:X}, Name: 0x{:X}", level, name);
+            errno = ENOPROTOOPT;
+            PushResult(response, -1);
+            response.Push<u32>(0);
+            return {};
+        }
+
+        auto length{static_cast<socklen_t>(buffer.size())};
+        auto result{::getsockopt(socket.fd, level, name, buffer.data(), &length)};
+        if (result >= 0 && level == SOL_SOCKET && name == SO_ERROR && length >= sizeof(int))
+            buffer.as<int>() = static_cast<int>(TranslateErrno(buffer.as<int>()));
+
+        PushResult(response, result);
+        response.Push<u32>(length);
+        return {};
+    }
+
+    Result IClient::Listen(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto backlog{request.Pop<i32>()};
+
+        PushResult(response, ::listen(socket.fd, backlog));
+        return {};
+    }
+
+    Result IClient::Fcntl(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto fd{request.Pop<i32>()};
+        auto command{request.Pop<i32>()};
+        auto argument{request.Pop<u32>()};
+
+        std::lock_guard guard(socketLock);
+        if (fd < 0 || static_cast<size_t>(fd) >= sockets.size() || sockets[static_cast<size_t>(fd)].fd == -1) {
+            errno = EBADF;
+            PushResult(response, -1);
+            return {};
+        }
+
+        auto &socket{sockets[static_cast<size_t>(fd)]};
+        switch (command) {
+            case F_GETFL:
+                PushResult(response, O_RDWR | (socket.nonBlocking ? GuestONonBlock : 0));
+                break;
+
+            case F_SETFL:
+                socket.nonBlocking = argument & GuestONonBlock;
+                PushResult(response, 0);
+                break;
+
+            default:
+                state.logger->Warn("Fcntl: Unsupported command: {}", command);
+                errno = EINVAL;
+                PushResult(response, -1);
+                break;
+        }
+
+        return {};
+    }
+
+    Result IClient::SetSockOpt(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto level{request.Pop<i32>()};
+        auto name{request.Pop<i32>()};
+        auto buffer{request.inputBuf.at(0)};
+
+        if (!TranslateSocketOption(level, name)) {
+            state.logger->Warn("SetSockOpt: Unsupported option: Level: 0x{:X}, Name: 0x{:X}", level, name);
+            errno = ENOPROTOOPT;
+            PushResult(response, -1);
+            return {};
+        }
+
+        PushResult(response, ::setsockopt(socket.fd, level, name, buffer.data(), static_cast<socklen_t>(buffer.size())));
+        return {};
+    }
+
+    Result IClient::Shutdown(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto how{request.Pop<i32>()};
+
+        PushResult(response, ::shutdown(socket.fd, how));
+        return {};
+    }
+
+    Result IClient::Write(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto buffer{request.inputBuf.at(0)};
+
+        PushResult(response, RetryOnBlock(socket.fd, socket.nonBlocking, POLLOUT, [&]() {
+            return ::send(socket.fd, buffer.data(), buffer.size(), MSG_NOSIGNAL);
+        }));
+        return {};
+    }
+
+    Result IClient::Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto socket{GetSocket(request.Pop<i32>())};
+        auto buffer{request.outputBuf.at(0)};
+
+        PushResult(response, RetryOnBlock(socket.fd, socket.nonBlocking, POLLIN, [&]() {
+            return ::recv(socket.fd, buffer.data(), buffer.size(), 0);
+        }));
+        return {};
+    }
+
+    Result IClient::Close(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto fd{request.Pop<i32>()};
+
+        std::lock_guard guard(socketLock);
+        if (fd < 0 || static_cast<size_t>(fd) >= sockets.size() || sockets[static_cast<size_t>(fd)].fd == -1) {
+            errno = EBADF;
+            PushResult(response, -1);
+            return {};
+        }
+
+        auto &socket{sockets[static_cast<size_t>(fd)]};
+        auto result{::close(socket.fd)};
+        socket = {};
+        freeSockets.push_back(fd);
+
+        state.logger->Debug("Close: FD: {}", fd);
+        PushResult(response, result);
+        return {};
+    }
 }
@@ -9,11 +9,38 @@ namespace skyline::service::socket {
     /**
      * @brief IClient or bsd:u is used by applications create network sockets
      * @url https://switchbrew.org/wiki/Sockets_services#bsd:u.2C_bsd:s
+     * @note Guest sockets are backed by non-blocking host sockets, blocking operations poll the host socket on the kernel thread of the calling guest thread which has to wait for the reply either way
      */
     class IClient : public BaseService {
+      private:
+        /**
+         * @brief A guest socket and the host socket backing it
+         */
+        struct ClientSocket {
+            int fd{-1}; //!< The FD of the host socket, this is -1 if the slot is free
+            bool nonBlocking{}; //!< If the guest has set O_NONBLOCK on the socket, the host socket is always non-blocking
+        };
+
+        Mutex socketLock; //!< Synchronizes access to sockets and freeSockets
+        std::vector<ClientSocket> sockets; //!< The sockets of the client indexed by their guest FD
+        std::vector<i32> freeSockets; //!< The guest FDs of closed sockets which are reused before the table is grown
+
+        /**
+         * @return A copy of the socket with the supplied guest FD, the FD of it is -1 if there is no such socket
+         */
+        ClientSocket GetSocket(i32 fd);
+
+        /**
+         * @brief Allocates a guest FD for a host socket
+         * @return The guest FD of the socket
+         */
+        i32 AddSocket(int hostFd);
+
       public:
         IClient(const DeviceState &state, ServiceManager &manager);
 
+        ~IClient();
+
         /**
          * @brief Initializes a socket client with the given parameters
          * @url https://switchbrew.org/wiki/Sockets_services#Initialize
@@ -25,9 +52,149 @@ namespace skyline::service::socket {
          */
         Result StartMonitoring(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
+        /**
+         * @brief Creates a new socket
+         * @url https://switchbrew.org/wiki/Sockets_services#Socket
+         */
+        Result Socket(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Waits for the sockets in the read, write and exception sets to be ready, this is implemented on top of poll
+         * @url https://switchbrew.org/wiki/Sockets_services#Select
+         */
+        Result Select(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Waits for events on a set of sockets
+         * @url https://switchbrew.org/wiki/Sockets_services#Poll
+         */
+        Result Poll(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Receives data from a socket
+         * @url https://switchbrew.org/wiki/Sockets_services#Recv
+         */
+        Result Recv(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Receives data from a socket along with the address of the sender
+         * @url https://switchbrew.org/wiki/Sockets_services#RecvFrom
+         */
+        Result RecvFrom(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Sends data on a connected socket
+         * @url https://switchbrew.org/wiki/Sockets_services#Send
+         */
+        Result Send(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Sends data on a socket to the supplied address
+         * @url https://switchbrew.org/wiki/Sockets_services#SendTo
+         */
+        Result SendTo(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Accepts a connection on a listening socket
+         * @url https://switchbrew.org/wiki/Sockets_services#Accept
+         */
+        Result Accept(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Binds a socket to an address
+         * @url https://switchbrew.org/wiki/Sockets_services#Bind
+         */
+        Result Bind(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Connects a socket to an address
+         * @url https://switchbrew.org/wiki/Sockets_services#Connect
+         */
+        Result Connect(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Retrieves the address of the peer a socket is connected to
+         * @url https://switchbrew.org/wiki/Sockets_services#GetPeerName
+         */
+        Result GetPeerName(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Retrieves the address a socket is bound to
+         * @url https://switchbrew.org/wiki/Sockets_services#GetSockName
+         */
+        Result GetSockName(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Retrieves the value of a socket option
+         * @url https://switchbrew.org/wiki/Sockets_services#GetSockOpt
+         */
+        Result GetSockOpt(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Marks a socket as accepting connections
+         * @url https://switchbrew.org/wiki/Sockets_services#Listen
+         */
+        Result Listen(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Retrieves or changes the file status flags of a socket, only O_NONBLOCK is supported
+         * @url https://switchbrew.org/wiki/Sockets_services#Fcntl
+         */
+        Result Fcntl(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Changes the value of a socket option
+         * @url https://switchbrew.org/wiki/Sockets_services#SetSockOpt
+         */
+        Result SetSockOpt(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Shuts down a part of a full-duplex connection
+         * @url https://switchbrew.org/wiki/Sockets_services#Shutdown
+         */
+        Result Shutdown(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Sends data on a connected socket without any flags
+         * @url https://switchbrew.org/wiki/Sockets_services#Write
+         */
+        Result Write(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Receives data from a socket without any flags
+         * @url https://switchbrew.org/wiki/Sockets_services#Read
+         */
+        Result Read(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Closes a socket
+         * @url https://switchbrew.org/wiki/Sockets_services#Close
+         */
+        Result Close(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
         SERVICE_DECL(
             SFUNC(0x0, IClient, RegisterClient),
-            SFUNC(0x1, IClient, StartMonitoring)
+            SFUNC(0x1, IClient, StartMonitoring),
+            SFUNC(0x2, IClient, Socket),
+            SFUNC(0x5, IClient, Select),
+            SFUNC(0x6, IClient, Poll),
+            SFUNC(0x8, IClient, Recv),
+            SFUNC(0x9, IClient, RecvFrom),
+            SFUNC(0xA, IClient, Send),
+            SFUNC(0xB, IClient, SendTo),
+            SFUNC(0xC, IClient, Accept),
+            SFUNC(0xD, IClient, Bind),
+            SFUNC(0xE, IClient, Connect),
+            SFUNC(0xF, IClient, GetPeerName),
+            SFUNC(0x10, IClient, GetSockName),
+            SFUNC(0x11, IClient, GetSockOpt),
+            SFUNC(0x12, IClient, Listen),
+            SFUNC(0x14, IClient, Fcntl),
+            SFUNC(0x15, IClient, SetSockOpt),
+            SFUNC(0x16, IClient, Shutdown),
+            SFUNC(0x18, IClient, Write),
+            SFUNC(0x19, IClient, Read),
+            SFUNC(0x1A, IClient, Close)
         )
     };
 }
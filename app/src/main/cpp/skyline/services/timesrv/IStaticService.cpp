@@ -1,26 +1,27 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <kernel/types/KProcess.h>
 #include "ISteadyClock.h"
 #include "ISystemClock.h"
 #include "ITimeZoneService.h"
 #include "IStaticService.h"
 
 namespace skyline::service::timesrv {
-    IStaticService::IStaticService(const DeviceState &state, ServiceManager &manager) : BaseService(state, manager) {}
+    IStaticService::IStaticService(const DeviceState &state, ServiceManager &manager) : BaseService(state, manager), timeSharedMemory(std::make_shared<TimeSharedMemory>(state)) {}
 
     Result IStaticService::GetStandardUserSystemClock(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::User, state, manager), session, response);
+        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::User, state, manager, timeSharedMemory), session, response);
         return {};
     }
 
     Result IStaticService::GetStandardNetworkSystemClock(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::Network, state, manager), session, response);
+        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::Network, state, manager, timeSharedMemory), session, response);
         return {};
     }
 
     Result IStaticService::GetStandardSteadyClock(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        manager.RegisterService(std::make_shared<ISteadyClock>(state, manager), session, response);
+        manager.RegisterService(std::make_shared<ISteadyClock>(state, manager, timeSharedMemory), session, response);
         return {};
     }
 
@@ -30,7 +31,13 @@ namespace skyline::service::timesrv {
     }
 
     Result IStaticService::GetStandardLocalSystemClock(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::Local, state, manager), session, response);
+        manager.RegisterService(std::make_shared<ISystemClock>(SystemClockType::Local, state, manager, timeSharedMemory), session, response);
+        return {};
+    }
+
+    Result IStaticService::GetSharedMemoryNativeHandle(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto handle{state.process->InsertItem<type::KSharedMemory>(timeSharedMemory->kSharedMemory)};
+        response.copyHandles.push_back(handle);
         return {};
     }
 }
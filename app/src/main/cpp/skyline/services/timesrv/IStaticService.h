@@ -4,6 +4,7 @@
 #pragma once
 
 #include <services/serviceman.h>
+#include "time_shared_memory.h"
 
 namespace skyline::service::timesrv {
     /**
@@ -11,6 +12,9 @@ namespace skyline::service::timesrv {
      * @url https://switchbrew.org/wiki/PSC_services#time:su.2C_time:s
      */
     class IStaticService : public BaseService {
+      private:
+        std::shared_ptr<TimeSharedMemory> timeSharedMemory; //!< The shared memory which all clocks from this service publish their state in
+
       public:
         IStaticService(const DeviceState &state, ServiceManager &manager);
 
@@ -39,12 +43,19 @@ namespace skyline::service::timesrv {
          */
         Result GetStandardLocalSystemClock(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
+        /**
+         * @brief Returns a handle to the shared memory the clocks are published in, so the guest can read them without IPC
+         * @url https://switchbrew.org/wiki/PSC_services#GetSharedMemoryNativeHandle
+         */
+        Result GetSharedMemoryNativeHandle(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
         SERVICE_DECL(
             SFUNC(0x0, IStaticService, GetStandardUserSystemClock),
             SFUNC(0x1, IStaticService, GetStandardNetworkSystemClock),
             SFUNC(0x2, IStaticService, GetStandardSteadyClock),
             SFUNC(0x3, IStaticService, GetTimeZoneService),
-            SFUNC(0x4, IStaticService, GetStandardLocalSystemClock)
+            SFUNC(0x4, IStaticService, GetStandardLocalSystemClock),
+            SFUNC(0x14, IStaticService, GetSharedMemoryNativeHandle)
         )
     };
 }
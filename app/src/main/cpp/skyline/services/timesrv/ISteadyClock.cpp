@@ -4,10 +4,10 @@
 #include "ISteadyClock.h"
 
 namespace skyline::service::timesrv {
-    ISteadyClock::ISteadyClock(const DeviceState &state, ServiceManager &manager) : BaseService(state, manager) {}
+    ISteadyClock::ISteadyClock(const DeviceState &state, ServiceManager &manager, std::shared_ptr<TimeSharedMemory> timeSharedMemory) : BaseService(state, manager), timeSharedMemory(std::move(timeSharedMemory)) {}
 
     Result ISteadyClock::GetCurrentTimePoint(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        response.Push(SteadyClockTimePoint{static_cast<u64>(std::time(nullptr))});
+        response.Push(timeSharedMemory->GetSteadyClockTimePoint());
         return {};
     }
 }
@@ -4,23 +4,19 @@
 #pragma once
 
 #include <services/serviceman.h>
+#include "time_shared_memory.h"
 
 namespace skyline::service::timesrv {
-    /**
-     * @url https://switchbrew.org/wiki/PSC_services#SteadyClockTimePoint
-     */
-    struct SteadyClockTimePoint {
-        u64 timepoint; //!< The point in time of this timepoint
-        u8 id[0x10]; //!< The ID of the source clock
-    };
-
     /**
      * @brief ISteadyClock is used to retrieve a steady time that increments uniformly for the lifetime on an application
      * @url https://switchbrew.org/wiki/PSC_services#ISteadyClock
      */
     class ISteadyClock : public BaseService {
+      private:
+        std::shared_ptr<TimeSharedMemory> timeSharedMemory; //!< The shared memory the steady clock is published in
+
       public:
-        ISteadyClock(const DeviceState &state, ServiceManager &manager);
+        ISteadyClock(const DeviceState &state, ServiceManager &manager, std::shared_ptr<TimeSharedMemory> timeSharedMemory);
 
         /**
          * @brief Returns the current value of the steady clock
@@ -1,20 +1,22 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include "ISteadyClock.h"
 #include "ISystemClock.h"
 
 namespace skyline::service::timesrv {
-    ISystemClock::ISystemClock(const SystemClockType clockType, const DeviceState &state, ServiceManager &manager) : type(clockType), BaseService(state, manager) {}
+    ISystemClock::ISystemClock(const SystemClockType clockType, const DeviceState &state, ServiceManager &manager, std::shared_ptr<TimeSharedMemory> timeSharedMemory) : type(clockType), BaseService(state, manager), timeSharedMemory(std::move(timeSharedMemory)) {}
 
     Result ISystemClock::GetCurrentTime(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        response.Push<u64>(static_cast<u64>(std::time(nullptr)));
+        // The time is calculated from the published context, so it always matches what the guest would calculate from the shared memory
+        timeSharedMemory->Update();
+        auto context{timeSharedMemory->GetSystemClockContext()};
+        response.Push<u64>(static_cast<u64>(context.offset + static_cast<i64>(timeSharedMemory->GetSteadyClockTimePoint().timepoint)));
         return {};
     }
 
     Result ISystemClock::GetSystemClockContext(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
-        response.Push<u64>(static_cast<u64>(std::time(nullptr)));
-        response.Push(SteadyClockTimePoint{static_cast<u64>(std::time(nullptr))});
+        timeSharedMemory->Update();
+        response.Push(timeSharedMemory->GetSystemClockContext());
         return {};
     }
 }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <services/serviceman.h>
+#include "time_shared_memory.h"
 
 namespace skyline::service::timesrv {
     /**
@@ -20,10 +21,13 @@ namespace skyline::service::timesrv {
      * @url https://switchbrew.org/wiki/PSC_services#ISystemClock
      */
     class ISystemClock : public BaseService {
+      private:
+        std::shared_ptr<TimeSharedMemory> timeSharedMemory; //!< The shared memory the context of the system clocks is published in
+
       public:
         const SystemClockType type;
 
-        ISystemClock(const SystemClockType clockType, const DeviceState &state, ServiceManager &manager);
+        ISystemClock(const SystemClockType clockType, const DeviceState &state, ServiceManager &manager, std::shared_ptr<TimeSharedMemory> timeSharedMemory);
 
         /**
          * @brief Returns the amount of seconds since epoch
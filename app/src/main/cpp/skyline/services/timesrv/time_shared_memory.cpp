@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <random>
+#include "time_shared_memory.h"
+
+namespace skyline::service::timesrv {
+    TimeSharedMemory::TimeSharedMemory(const DeviceState &state) : kSharedMemory(std::make_shared<kernel::type::KSharedMemory>(state, NULL, Size, memory::Permission{true, false, false})) {
+        layout = reinterpret_cast<Layout *>(kSharedMemory->kernel.address);
+
+        std::random_device random;
+        for (auto &byte : clockSourceId)
+            byte = static_cast<u8>(random());
+
+        // The steady clock is the system tick, which the guest reads directly, so its offset is constant and only has to be published once
+        layout->standardSteadyClock.Store(SteadyClockContext{0, clockSourceId});
+        layout->standardUserSystemClockAutomaticCorrection.Store(false);
+
+        std::lock_guard guard(writerMutex);
+        auto timepoint{GetSteadyClockTimePoint()};
+        systemClockOffset = static_cast<i64>(std::time(nullptr)) - static_cast<i64>(timepoint.timepoint);
+        PublishSystemClocks(SystemClockContext{systemClockOffset, timepoint});
+        __atomic_store_n(&layout->formatVersion, 0, __ATOMIC_RELEASE);
+    }
+
+    void TimeSharedMemory::PublishSystemClocks(const SystemClockContext &context) {
+        layout->standardLocalSystemClock.Store(context);
+        layout->standardNetworkSystemClock.Store(context);
+    }
+
+    void TimeSharedMemory::Update() {
+        auto timepoint{GetSteadyClockTimePoint()};
+        auto offset{static_cast<i64>(std::time(nullptr)) - static_cast<i64>(timepoint.timepoint)};
+        std::lock_guard guard(writerMutex);
+        // The offset is only republished when it's off by more than a second as it flips between adjacent values due to the truncation of both clocks to seconds
+        if (std::abs(offset - systemClockOffset) <= 1)
+            return;
+
+        systemClockOffset = offset;
+        PublishSystemClocks(SystemClockContext{offset, timepoint});
+    }
+
+    SteadyClockTimePoint TimeSharedMemory::GetSteadyClockTimePoint() {
+        auto context{layout->standardSteadyClock.Load()};
+        return SteadyClockTimePoint{(context.internalOffset + util::GetTimeNs()) / constant::NsInSecond, context.id};
+    }
+
+    SystemClockContext TimeSharedMemory::GetSystemClockContext() {
+        return layout->standardLocalSystemClock.Load();
+    }
+}
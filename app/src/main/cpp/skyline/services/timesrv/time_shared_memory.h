@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <kernel/types/KSharedMemory.h>
+
+namespace skyline::service::timesrv {
+    using ClockSourceId = std::array<u8, 0x10>; //!< A UUID identifying a steady clock, time points are only comparable if they're from the same source
+
+    /**
+     * @url https://switchbrew.org/wiki/PSC_services#SteadyClockTimePoint
+     */
+    struct SteadyClockTimePoint {
+        u64 timepoint; //!< The point in time of this timepoint in seconds
+        ClockSourceId id; //!< The ID of the source clock
+    };
+    static_assert(sizeof(SteadyClockTimePoint) == 0x18);
+
+    /**
+     * @url https://switchbrew.org/wiki/PSC_services#SystemClockContext
+     */
+    struct SystemClockContext {
+        i64 offset; //!< The offset of the system clock from the steady clock in seconds
+        SteadyClockTimePoint timepoint; //!< The steady clock time point the offset was calculated at
+    };
+    static_assert(sizeof(SystemClockContext) == 0x20);
+
+    /**
+     * @brief The context of the steady clock, the current time point of it is calculated from this and the system tick
+     */
+    struct SteadyClockContext {
+        u64 internalOffset; //!< The offset of the steady clock from the system tick in nanoseconds
+        ClockSourceId id; //!< The ID of the steady clock
+    };
+    static_assert(sizeof(SteadyClockContext) == 0x18);
+
+    /**
+     * @brief A value which is published with seqlock semantics, the writer writes to the value which isn't current and then increments the counter
+     * @note Readers read the value indexed by the counter and retry if the counter has changed in the meantime, so they never need to lock
+     */
+    template<typename Type>
+    struct LockFreeAtomic {
+        u32 counter;
+        std::array<Type, 2> values;
+
+        /**
+         * @brief Publishes a new value, this must only be called by a single writer at a time
+         */
+        void Store(const Type &value) {
+            auto next{__atomic_load_n(&counter, __ATOMIC_RELAXED) + 1};
+            values[next & 1] = value;
+            __atomic_store_n(&counter, next, __ATOMIC_RELEASE);
+        }
+
+        Type Load() {
+            Type value;
+            u32 current;
+            do {
+                current = __atomic_load_n(&counter, __ATOMIC_ACQUIRE);
+                value = values[current & 1];
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while (current != __atomic_load_n(&counter, __ATOMIC_RELAXED));
+            return value;
+        }
+    };
+
+    /**
+     * @brief The time shared memory contains the contexts of all clocks, so the guest can read the current time directly without an IPC round trip
+     * @url https://switchbrew.org/wiki/Glue_services#Time_SharedMemory
+     */
+    class TimeSharedMemory {
+      private:
+        struct Layout {
+            LockFreeAtomic<SteadyClockContext> standardSteadyClock;
+            LockFreeAtomic<SystemClockContext> standardLocalSystemClock;
+            LockFreeAtomic<SystemClockContext> standardNetworkSystemClock;
+            LockFreeAtomic<bool> standardUserSystemClockAutomaticCorrection;
+            u32 formatVersion;
+        };
+        static_assert(offsetof(Layout, standardLocalSystemClock) == 0x38);
+        static_assert(offsetof(Layout, standardNetworkSystemClock) == 0x80);
+        static_assert(offsetof(Layout, standardUserSystemClockAutomaticCorrection) == 0xC8);
+        static_assert(sizeof(Layout) == 0xD8);
+
+        Layout *layout; //!< The contents of the shared memory on the host, the host is the only writer to it
+        ClockSourceId clockSourceId; //!< A random ID which is generated for the steady clock on every boot
+        Mutex writerMutex; //!< Serializes updates to the shared memory as every value must only have a single writer at a time
+        i64 systemClockOffset{}; //!< The offset of the system clocks which was last published, this is protected by writerMutex
+
+        /**
+         * @brief Publishes a new context for the local and network system clocks, they're both backed by the host clock
+         * @note writerMutex must be locked when calling this
+         */
+        void PublishSystemClocks(const SystemClockContext &context);
+
+      public:
+        static constexpr size_t Size{0x1000};
+
+        std::shared_ptr<kernel::type::KSharedMemory> kSharedMemory;
+
+        TimeSharedMemory(const DeviceState &state);
+
+        /**
+         * @brief Republishes the system clock contexts if the host clock has shifted relative to the steady clock since they were last published
+         */
+        void Update();
+
+        /**
+         * @return The current time point of the steady clock, this is the time since boot
+         */
+        SteadyClockTimePoint GetSteadyClockTimePoint();
+
+        /**
+         * @return The last published context of the system clocks, the current time is the offset added to the current time point of the steady clock
+         */
+        SystemClockContext GetSystemClockContext();
+    };
+}
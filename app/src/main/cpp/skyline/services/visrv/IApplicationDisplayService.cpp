@@ -4,7 +4,7 @@
 #include <gpu.h>
 #include <kernel/types/KProcess.h>
 #include <services/hosbinder/IHOSBinderDriver.h>
-#include <services/hosbinder/GraphicBufferProducer.h>
+#include <services/hosbinder/display.h>
 #include "IApplicationDisplayService.h"
 #include "ISystemDisplayService.h"
 #include "IManagerDisplayService.h"
@@ -36,8 +36,7 @@ namespace skyline::service::visrv {
         std::string displayName(request.PopString());
         state.logger->Debug("Setting display as: {}", displayName);
 
-        auto producer{hosbinder::producer.lock()};
-        producer->SetDisplay(displayName);
+        hosbinder::display.lock()->Open(displayName);
 
         response.Push<u64>(0); // There's only one display
         return {};
@@ -45,8 +44,7 @@ namespace skyline::service::visrv {
 
     Result IApplicationDisplayService::CloseDisplay(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
         state.logger->Debug("Closing the display");
-        auto producer{hosbinder::producer.lock()};
-        producer->CloseDisplay();
+        hosbinder::display.lock()->Close();
         return {};
     }
 
@@ -58,19 +56,20 @@ namespace skyline::service::visrv {
         } input = request.Pop<InputStruct>();
         state.logger->Debug("Opening Layer: Display Name: {}, Layer ID: {}, User ID: {}", input.displayName, input.layerId, input.userId);
 
-        std::string name(input.displayName);
+        // Layers are only composited while they're open, they're visible from creation as stray layers are never opened
+        hosbinder::display.lock()->SetLayerVisibility(input.layerId, true);
 
-        Parcel parcel(state);
+        Parcel parcel(state, request.outputBuf.at(0));
         LayerParcel data{
             .type = 0x2,
             .pid = 0,
-            .bufferId = 0, // As we only have one layer and buffer
+            .bufferId = static_cast<u32>(input.layerId), // The binder of a layer's producer has the same ID as the layer
             .string = "dispdrv"
         };
         parcel.Push(data);
-        parcel.objects.resize(4);
+        parcel.PushObject<u32>(0);
 
-        response.Push<u64>(parcel.WriteParcel(request.outputBuf.at(0)));
+        response.Push<u64>(parcel.WriteParcel());
         return {};
     }
 
@@ -78,11 +77,8 @@ namespace skyline::service::visrv {
         u64 layerId{request.Pop<u64>()};
         state.logger->Debug("Closing Layer: {}", layerId);
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus == hosbinder::LayerStatus::Uninitialized)
-            state.logger->Warn("The application is destroying an uninitialized layer");
-        producer->layerStatus = hosbinder::LayerStatus::Uninitialized;
-
+        // The layer itself is only destroyed by the service which created it, closing it hides it until it's opened again
+        hosbinder::display.lock()->SetLayerVisibility(layerId, false);
         return {};
     }
 
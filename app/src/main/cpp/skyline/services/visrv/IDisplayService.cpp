@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include <services/hosbinder/GraphicBufferProducer.h>
+#include <services/hosbinder/display.h>
 #include "IDisplayService.h"
 
 namespace skyline::service::visrv {
@@ -13,23 +13,19 @@ namespace skyline::service::visrv {
 
         state.logger->Debug("Creating Stray Layer on Display: {}", displayId);
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus == hosbinder::LayerStatus::Stray)
-            throw exception("The application is creating more than one stray layer");
-        producer->layerStatus = hosbinder::LayerStatus::Stray;
+        auto layerId{hosbinder::display.lock()->CreateLayer()};
+        response.Push<u64>(layerId);
 
-        response.Push<u64>(0); // There's only one layer
-
-        Parcel parcel(state);
+        Parcel parcel(state, request.outputBuf.at(0));
         LayerParcel data{
             .type = 0x2,
             .pid = 0,
-            .bufferId = 0, // As we only have one layer and buffer
+            .bufferId = static_cast<u32>(layerId), // The binder of a layer's producer has the same ID as the layer
             .string = "dispdrv"
         };
         parcel.Push(data);
 
-        response.Push<u64>(parcel.WriteParcel(request.outputBuf.at(0)));
+        response.Push<u64>(parcel.WriteParcel());
         return {};
     }
 
@@ -37,11 +33,16 @@ namespace skyline::service::visrv {
         auto layerId{request.Pop<u64>()};
         state.logger->Debug("Destroying Stray Layer: {}", layerId);
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus == hosbinder::LayerStatus::Uninitialized)
-            state.logger->Warn("The application is destroying an uninitialized layer");
-        producer->layerStatus = hosbinder::LayerStatus::Uninitialized;
+        hosbinder::display.lock()->DestroyLayer(layerId);
+        return {};
+    }
+
+    Result IDisplayService::SetLayerVisibility(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto layerId{request.Pop<u64>()};
+        auto visible{request.Pop<u8>() != 0};
+        state.logger->Debug("Setting the visibility of Layer {} to {}", layerId, visible);
 
+        hosbinder::display.lock()->SetLayerVisibility(layerId, visible);
         return {};
     }
 }
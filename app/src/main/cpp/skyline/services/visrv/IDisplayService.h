@@ -36,5 +36,10 @@ namespace skyline::service::visrv {
          * @brief Destroys a stray layer by it's ID
          */
         Result DestroyStrayLayer(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
+
+        /**
+         * @brief Shows or hides a layer, hidden layers aren't composited onto the display
+         */
+        Result SetLayerVisibility(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
     };
 }
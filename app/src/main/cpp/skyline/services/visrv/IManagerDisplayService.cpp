@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
-#include <services/hosbinder/GraphicBufferProducer.h>
+#include <services/hosbinder/display.h>
 #include "IManagerDisplayService.h"
 
 namespace skyline::service::visrv {
@@ -12,12 +12,7 @@ namespace skyline::service::visrv {
         auto displayId{request.Pop<u64>()};
         state.logger->Debug("Creating Managed Layer on Display: {}", displayId);
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus != hosbinder::LayerStatus::Uninitialized)
-            throw exception("The application is creating more than one layer");
-        producer->layerStatus = hosbinder::LayerStatus::Managed;
-
-        response.Push<u64>(0); // There's only one layer
+        response.Push<u64>(hosbinder::display.lock()->CreateLayer());
         return {};
     }
 
@@ -25,15 +20,18 @@ namespace skyline::service::visrv {
         auto layerId{request.Pop<u64>()};
         state.logger->Debug("Destroying Managed Layer: {}", layerId);
 
-        auto producer{hosbinder::producer.lock()};
-        if (producer->layerStatus == hosbinder::LayerStatus::Uninitialized)
-            state.logger->Warn("The application is destroying an uninitialized layer");
-        producer->layerStatus = hosbinder::LayerStatus::Uninitialized;
-
+        hosbinder::display.lock()->DestroyLayer(layerId);
         return {};
     }
 
     Result IManagerDisplayService::AddToLayerStack(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto stack{request.Pop<u32>()};
+        request.Skip<u32>();
+        auto layerId{request.Pop<u64>()};
+        state.logger->Debug("Adding Layer {} to Layer Stack {}", layerId, stack);
+
+        // Every layer is composited onto the only display we present to regardless of the stacks it's in, so only the layer's existence is checked
+        hosbinder::display.lock()->GetProducer(layerId);
         return {};
     }
 }
@@ -25,7 +25,7 @@ namespace skyline::service::visrv {
         Result DestroyManagedLayer(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
         /**
-         * @brief This takes a layer's ID and adds it to the layer stack
+         * @brief This takes a layer's ID and adds it to a layer stack of the display
          */
         Result AddToLayerStack(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
@@ -33,7 +33,8 @@ namespace skyline::service::visrv {
             SFUNC(0x7DA, IManagerDisplayService, CreateManagedLayer),
             SFUNC(0x7DB, IManagerDisplayService, DestroyManagedLayer),
             SFUNC_BASE(0x7DC, IManagerDisplayService, IDisplayService, CreateStrayLayer),
-            SFUNC(0x1770, IManagerDisplayService, AddToLayerStack)
+            SFUNC(0x1770, IManagerDisplayService, AddToLayerStack),
+            SFUNC_BASE(0x1772, IManagerDisplayService, IDisplayService, SetLayerVisibility)
         )
     };
 }
@@ -1,12 +1,18 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
 
+#include <services/hosbinder/display.h>
 #include "ISystemDisplayService.h"
 
 namespace skyline::service::visrv {
     ISystemDisplayService::ISystemDisplayService(const DeviceState &state, ServiceManager &manager) : IDisplayService(state, manager) {}
 
     Result ISystemDisplayService::SetLayerZ(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response) {
+        auto layerId{request.Pop<u64>()};
+        auto z{request.Pop<i64>()};
+        state.logger->Debug("Setting the Z index of Layer {} to {}", layerId, z);
+
+        hosbinder::display.lock()->SetLayerZ(layerId, z);
         return {};
     }
 }
@@ -15,12 +15,13 @@ namespace skyline::service::visrv {
         ISystemDisplayService(const DeviceState &state, ServiceManager &manager);
 
         /**
-         * @brief Sets the Z index of a layer
+         * @brief Sets the Z index of a layer, layers with a higher Z index are composited over ones with a lower one
          */
         Result SetLayerZ(type::KSession &session, ipc::IpcRequest &request, ipc::IpcResponse &response);
 
         SERVICE_DECL(
             SFUNC(0x89D, ISystemDisplayService, SetLayerZ),
+            SFUNC_BASE(0x89F, ISystemDisplayService, IDisplayService, SetLayerVisibility),
             SFUNC_BASE(0x908, ISystemDisplayService, IDisplayService, CreateStrayLayer)
         )
     };
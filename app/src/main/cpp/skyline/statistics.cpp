@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <algorithm>
+#include <unistd.h>
+#include "statistics.h"
+
+namespace skyline {
+    void SampleHistory::Record(u64 duration) {
+        auto index{count.load(std::memory_order_relaxed)};
+        samples[index % Size].store(static_cast<u32>(std::min<u64>(duration / 1000, std::numeric_limits<u32>::max())), std::memory_order_relaxed);
+        count.store(index + 1, std::memory_order_release); // Only a single thread records samples so this doesn't need to be an RMW
+    }
+
+    SampleHistory::Percentiles SampleHistory::GetPercentiles() {
+        std::array<u32, Size> sorted;
+        auto sampleCount{std::min(count.load(std::memory_order_acquire), Size)};
+        if (!sampleCount)
+            return {};
+
+        for (size_t index{}; index < sampleCount; index++)
+            sorted[index] = samples[index].load(std::memory_order_relaxed);
+        std::sort(sorted.begin(), sorted.begin() + sampleCount);
+
+        auto percentile{[&](size_t percent) {
+            return sorted[(sampleCount - 1) * percent / 100];
+        }};
+        return {percentile(50), percentile(95), percentile(99), sorted[sampleCount - 1]};
+    }
+
+    void BootTimeline::Record(BootPhase phase, u64 start, u64 end) {
+        auto index{static_cast<size_t>(phase)};
+        auto earliest{starts[index].load(std::memory_order_relaxed)};
+        while ((!earliest || start < earliest) && !starts[index].compare_exchange_weak(earliest, start, std::memory_order_relaxed));
+        durations[index].fetch_add(end - start, std::memory_order_relaxed);
+    }
+
+    bool BootTimeline::Mark(BootPhase phase) {
+        auto &start{starts[static_cast<size_t>(phase)]};
+        if (start.load(std::memory_order_relaxed))
+            return false;
+
+        u64 expected{};
+        return start.compare_exchange_strong(expected, util::GetTimeNs(), std::memory_order_relaxed);
+    }
+
+    std::array<i64, BootTimeline::PhaseCount * 2> BootTimeline::GetTimeline() {
+        std::array<i64, PhaseCount * 2> timeline;
+        auto launch{starts[static_cast<size_t>(BootPhase::Setup)].load(std::memory_order_relaxed)};
+        for (size_t index{}; index < PhaseCount; index++) {
+            auto start{starts[index].load(std::memory_order_relaxed)};
+            if (start && launch) {
+                timeline[index * 2] = static_cast<i64>((start - launch) / 1000);
+                timeline[(index * 2) + 1] = static_cast<i64>(durations[index].load(std::memory_order_relaxed) / 1000);
+            } else {
+                timeline[index * 2] = timeline[(index * 2) + 1] = -1;
+            }
+        }
+        return timeline;
+    }
+
+    std::string BootTimeline::Format() {
+        constexpr std::array<std::string_view, PhaseCount> PhaseNames{"Setup", "Key Store", "Loader", "Mapping", "Decompression", "Patching", "Process Memory", "First SVC", "First QueueBuffer", "First Frame"};
+
+        std::string output{"Boot timeline:"};
+        auto timeline{GetTimeline()};
+        for (size_t index{}; index < PhaseCount; index++) {
+            auto start{timeline[index * 2]}, duration{timeline[(index * 2) + 1]};
+            if (start < 0)
+                output += fmt::format("\n  {}: Not reached", PhaseNames[index]);
+            else if (index >= static_cast<size_t>(BootPhase::FirstSvc))
+                output += fmt::format("\n  {}: at {:.2f}ms", PhaseNames[index], static_cast<double>(start) / 1000);
+            else
+                output += fmt::format("\n  {}: {:.2f}ms at {:.2f}ms", PhaseNames[index], static_cast<double>(duration) / 1000, static_cast<double>(start) / 1000);
+        }
+        return output;
+    }
+
+    void PerformanceStatistics::TrackHostMapping(u64 host, size_t size, kernel::memory::MemoryType type) {
+        std::lock_guard guard(hostMappingsMutex);
+        hostMappings[host] = HostMapping{size, type};
+    }
+
+    void PerformanceStatistics::UntrackHostMapping(u64 host) {
+        std::lock_guard guard(hostMappingsMutex);
+        hostMappings.erase(host);
+    }
+
+    std::array<PerformanceStatistics::HostMemoryUsage, PerformanceStatistics::MemoryTypeCount> PerformanceStatistics::GetHostMemoryUsage() {
+        std::array<HostMemoryUsage, MemoryTypeCount> usage{};
+        std::vector<u8> residency; // The residency of every page in a mapping, it's reused across mappings to avoid allocations
+        auto pageSize{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+
+        std::lock_guard guard(hostMappingsMutex);
+        for (const auto &[host, mapping] : hostMappings) {
+            auto &typeUsage{usage[static_cast<u8>(mapping.type)]};
+            typeUsage.reserved += mapping.size;
+
+            residency.resize((mapping.size + pageSize - 1) / pageSize);
+            if (mincore(reinterpret_cast<void *>(host), mapping.size, residency.data()) < 0)
+                continue; // The mapping may be in the middle of being replaced, it's skipped rather than reported inaccurately
+
+            for (auto page : residency)
+                if (page & 1)
+                    typeUsage.resident += pageSize;
+        }
+
+        return usage;
+    }
+}
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <map>
+#include <kernel/memory.h>
+
+namespace skyline {
+    /**
+     * @brief A rolling history of the most recent samples of a duration, percentiles over it expose stutters which an average hides
+     * @note Samples must only be recorded by a single thread while any thread can calculate the percentiles
+     */
+    class SampleHistory {
+      public:
+        static constexpr size_t Size{600}; //!< The amount of the most recent samples which percentiles are calculated over, this is 10 seconds of frames at 60 FPS
+
+        /**
+         * @brief Percentiles of the samples in the history in microseconds
+         */
+        struct Percentiles {
+            u32 p50;
+            u32 p95;
+            u32 p99; //!< The 1% low of the samples, this is what stutters show up in
+            u32 max;
+        };
+
+      private:
+        std::array<std::atomic<u32>, Size> samples{}; //!< A ring of the samples in microseconds
+        std::atomic<size_t> count{}; //!< The total amount of samples recorded, this is used to index into samples
+
+      public:
+        /**
+         * @param duration The duration of the sample in nanoseconds
+         */
+        void Record(u64 duration);
+
+        /**
+         * @return The percentiles of the samples in the history, these are 0 while no samples have been recorded
+         */
+        Percentiles GetPercentiles();
+    };
+
+    /**
+     * @brief The phases of booting an application, they're listed in the order they usually start in
+     */
+    enum class BootPhase : u8 {
+        Setup, //!< From the JNI launch to the ROM being loaded, this covers creating every subsystem
+        KeyStore, //!< Loading the keys
+        Loader, //!< Constructing the loader, this parses the ROM's containers such as NCAs and NSPs
+        Mapping, //!< Mapping the executables into guest memory
+        Decompression, //!< Decompressing the segments of NSOs
+        Patching, //!< Patching the code of the executables, this includes loading patched code from the patch cache
+        ProcessMemory, //!< Initializing the memory of the process
+        FirstSvc, //!< The guest calling its first SVC
+        FirstQueueBuffer, //!< The guest queueing its first frame
+        FirstFrame, //!< The first frame being presented
+    };
+
+    /**
+     * @brief A breakdown of where the time to boot an application goes, every phase is timed relative to the launch so the gaps between phases are visible as well
+     * @note Phases which happen several times such as decompressing every NSO accumulate their durations, the last three phases are instants and only their first occurrence is recorded
+     */
+    class BootTimeline {
+      public:
+        static constexpr size_t PhaseCount{static_cast<size_t>(BootPhase::FirstFrame) + 1};
+
+      private:
+        std::array<std::atomic<u64>, PhaseCount> starts{}; //!< The earliest time every phase started at in nanoseconds, this is 0 if it hasn't happened yet
+        std::array<std::atomic<u64>, PhaseCount> durations{}; //!< The total duration of every phase in nanoseconds
+
+      public:
+        /**
+         * @brief Times a phase for as long as this object exists
+         */
+        class ScopedTimer {
+          private:
+            BootTimeline &timeline;
+            BootPhase phase;
+            u64 start;
+
+          public:
+            ScopedTimer(BootTimeline &timeline, BootPhase phase) : timeline(timeline), phase(phase), start(util::GetTimeNs()) {}
+
+            ~ScopedTimer() {
+                timeline.Record(phase, start, util::GetTimeNs());
+            }
+        };
+
+        /**
+         * @brief Records an occurrence of a phase, its start is only updated if this is its earliest one
+         */
+        void Record(BootPhase phase, u64 start, u64 end);
+
+        /**
+         * @brief Records the first occurrence of an instant phase
+         * @return If this was the first occurrence of it
+         * @note This only does a relaxed load after the first occurrence, so it can be called on hot paths
+         */
+        bool Mark(BootPhase phase);
+
+        /**
+         * @return The start of every phase relative to the launch and its duration in microseconds, these are interleaved and both are -1 for phases which haven't happened yet
+         */
+        std::array<i64, PhaseCount * 2> GetTimeline();
+
+        /**
+         * @return A human-readable breakdown of every phase for the log
+         */
+        std::string Format();
+    };
+
+    /**
+     * @brief Performance counters which are updated by the subsystems they concern and sampled by the frontend to display them
+     * @note All counters are relaxed atomics as they're only used for display, they're cheap enough to update on hot paths
+     */
+    class PerformanceStatistics {
+      public:
+        static constexpr size_t MemoryTypeCount{static_cast<size_t>(kernel::memory::MemoryType::CodeWritable) + 1};
+
+        /**
+         * @brief The amount of host memory used for a category of memory
+         */
+        struct HostMemoryUsage {
+            u64 reserved; //!< The amount of address space mapped in bytes
+            u64 resident; //!< The amount of memory which is backed by physical pages in bytes
+        };
+
+      private:
+        std::array<std::atomic<u64>, MemoryTypeCount> memoryUsage{}; //!< The amount of guest memory mapped for every MemoryType in bytes
+
+        /**
+         * @brief A mapping of guest memory in the host address space
+         */
+        struct HostMapping {
+            size_t size;
+            kernel::memory::MemoryType type;
+        };
+
+        std::mutex hostMappingsMutex; //!< Synchronizes access to hostMappings
+        std::map<u64, HostMapping> hostMappings; //!< The host mappings of all memory objects keyed by their address, these are only changed when memory objects are created, resized or destroyed
+
+      public:
+        BootTimeline boot; //!< The breakdown of the time spent booting the application
+        SampleHistory frameTimes; //!< The intervals between frames being presented
+        SampleHistory presentLatency; //!< The time from the guest queueing a frame to it being posted to the display
+        std::atomic<u32> gpfifoQueueDepth{}; //!< The amount of entries which are pending in the GPFIFO ring
+        std::atomic<u64> ipcRequestCount{}; //!< The total amount of IPC requests handled by the ServiceManager
+        std::atomic<u64> textureUploadBytes{}; //!< The total amount of texture data synchronized from the guest to the host in bytes
+        std::atomic<u64> bufferUploadBytes{}; //!< The total amount of buffer data synchronized from the guest to the host in bytes
+        std::atomic<u64> textureHostBytes{}; //!< The amount of host memory allocated for host copies of textures in bytes
+        std::atomic<u64> audioHostBytes{}; //!< The amount of host memory allocated for the sample buffers of audio tracks in bytes
+        std::atomic<u64> releasedBytes{}; //!< The total amount of guest memory which was freed while its backing stayed allocated and has been released back to the host
+        std::atomic<u64> queuedFrames{}; //!< The total amount of frames queued by the guest which were presented or skipped, input recordings are timed against this as it only depends on the guest's progress
+        std::atomic<u64> skippedFrames{}; //!< The total amount of queued frames which were released without being presented as presentation couldn't keep up
+        std::atomic<u64> culledVoices{}; //!< The total amount of audio renderer voices which were culled from mix buffers to stay within the DSP budget
+
+        /**
+         * @brief Adjusts the amount of guest memory that's tracked as being mapped with the specified type
+         * @param delta The amount of bytes which were mapped, this is negative for unmapped memory
+         */
+        void UpdateMemoryUsage(kernel::memory::MemoryType type, i64 delta) {
+            memoryUsage[static_cast<u8>(type)].fetch_add(static_cast<u64>(delta), std::memory_order_relaxed);
+        }
+
+        /**
+         * @return The amount of guest memory mapped with the specified type in bytes
+         */
+        u64 GetMemoryUsage(kernel::memory::MemoryType type) {
+            return memoryUsage[static_cast<u8>(type)].load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Tracks the host mapping of a memory object, this replaces any mapping which was tracked at the same address
+         * @param host The page-aligned address of the mapping
+         */
+        void TrackHostMapping(u64 host, size_t size, kernel::memory::MemoryType type);
+
+        /**
+         * @brief Stops tracking the host mapping at the specified address
+         */
+        void UntrackHostMapping(u64 host);
+
+        /**
+         * @return The amount of host memory reserved and resident for the host mappings of every MemoryType
+         * @note The residency of every mapping is queried with mincore, so this should only be called periodically
+         */
+        std::array<HostMemoryUsage, MemoryTypeCount> GetHostMemoryUsage();
+    };
+}
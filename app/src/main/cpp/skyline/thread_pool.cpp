@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "os.h"
+#include "thread_pool.h"
+
+namespace skyline {
+    static thread_local ThreadPool *CurrentPool{}; //!< The pool which the calling thread is a worker of, this is nullptr for threads outside of any pool
+    static thread_local size_t CurrentWorker{}; //!< The index of the calling thread in the workers of CurrentPool
+
+    ThreadPool::TaskGroup::TaskGroup(ThreadPool &pool) : pool(pool) {}
+
+    ThreadPool::TaskGroup::~TaskGroup() {
+        WaitForTasks();
+    }
+
+    void ThreadPool::TaskGroup::WaitForTasks() {
+        while (pending.load(std::memory_order_acquire)) {
+            if (auto task{pool.FindTask()}) {
+                pool.Execute(*task);
+                continue;
+            }
+
+            std::unique_lock lock(pool.sleepMutex);
+            pool.sleepCondition.wait(lock, [this] { return !pending.load(std::memory_order_acquire) || pool.queuedTasks.load(std::memory_order_acquire); });
+        }
+    }
+
+    void ThreadPool::TaskGroup::Run(std::function<void()> function) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        Task task{std::move(function), this};
+        if (pool.workers.empty())
+            pool.Execute(task);
+        else
+            pool.Queue(std::move(task));
+    }
+
+    void ThreadPool::TaskGroup::Wait() {
+        WaitForTasks();
+
+        std::lock_guard guard(exceptionMutex);
+        if (exception)
+            std::rethrow_exception(std::exchange(exception, nullptr));
+    }
+
+    ThreadPool::ThreadPool(const DeviceState &state) : state(state) {
+        auto workerCount{state.os->affinity.GetWorkerCount()};
+        workers.reserve(workerCount);
+        for (size_t index{}; index < workerCount; index++)
+            workers.push_back(std::make_unique<Worker>());
+
+        // The threads are only started once all workers exist as they steal from each other
+        for (size_t index{}; index < workerCount; index++)
+            workers[index]->thread = std::thread(&ThreadPool::Run, this, index);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard guard(sleepMutex);
+            stop = true;
+            sleepCondition.notify_all();
+        }
+
+        for (auto &worker : workers)
+            worker->thread.join();
+    }
+
+    void ThreadPool::Queue(Task task) {
+        // Tasks queued by a worker go onto its own deque as they're likely to share data with the task that queued them
+        auto index{CurrentPool == this ? CurrentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size()};
+        {
+            auto &worker{*workers[index]};
+            std::lock_guard guard(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        queuedTasks.fetch_add(1, std::memory_order_release);
+        std::lock_guard guard(sleepMutex);
+        sleepCondition.notify_one();
+    }
+
+    std::optional<ThreadPool::Task> ThreadPool::FindTask() {
+        if (!queuedTasks.load(std::memory_order_acquire))
+            return std::nullopt;
+
+        bool isWorker{CurrentPool == this};
+        if (isWorker) {
+            auto &worker{*workers[CurrentWorker]};
+            std::lock_guard guard(worker.mutex);
+            if (!worker.tasks.empty()) {
+                auto task{std::move(worker.tasks.back())};
+                worker.tasks.pop_back();
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+
+        // Tasks are stolen from the front of the deque as those were queued the earliest and are the least likely to be in the cache of the victim
+        size_t start{isWorker ? CurrentWorker + 1 : 0};
+        for (size_t offset{}; offset < workers.size(); offset++) {
+            auto &victim{*workers[(start + offset) % workers.size()]};
+            std::lock_guard guard(victim.mutex);
+            if (!victim.tasks.empty()) {
+                auto task{std::move(victim.tasks.front())};
+                victim.tasks.pop_front();
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void ThreadPool::Execute(Task &task) {
+        auto group{task.group};
+        {
+            // The function is destroyed prior to the task being marked as done as its captures may refer to the callers of Wait
+            auto function{std::move(task.function)};
+            try {
+                function();
+            } catch (...) {
+                std::lock_guard guard(group->exceptionMutex);
+                if (!group->exception)
+                    group->exception = std::current_exception();
+            }
+        }
+
+        // The group may be destroyed as soon as its last task is marked as done, so it can't be touched after this
+        if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard guard(sleepMutex);
+            sleepCondition.notify_all();
+        }
+    }
+
+    void ThreadPool::Run(size_t index) {
+        pthread_setname_np(pthread_self(), fmt::format("Sky-Worker-{}", index).c_str());
+        state.os->affinity.SetHostAffinity(kernel::AffinityManager::HostThread::Worker);
+
+        CurrentPool = this;
+        CurrentWorker = index;
+
+        while (true) {
+            if (auto task{FindTask()}) {
+                Execute(*task);
+                continue;
+            }
+
+            std::unique_lock lock(sleepMutex);
+            sleepCondition.wait(lock, [this] { return stop || queuedTasks.load(std::memory_order_acquire); });
+            if (stop)
+                return;
+        }
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> &function) {
+        if (count <= 1 || workers.empty()) {
+            for (size_t index{}; index < count; index++)
+                function(index);
+            return;
+        }
+
+        // Parts are taken from a shared index rather than being split up ahead of time, so parts which take longer than others don't hold up the rest
+        std::atomic<size_t> next{};
+        auto process{[&] {
+            try {
+                for (auto index{next++}; index < count; index = next++)
+                    function(index);
+            } catch (...) {
+                next = count;
+                throw;
+            }
+        }};
+
+        TaskGroup group(*this);
+        auto taskCount{std::min(count, workers.size() + 1) - 1}; // The calling thread processes parts alongside the workers
+        for (size_t task{}; task < taskCount; task++)
+            group.Run(process);
+
+        std::exception_ptr exception;
+        try {
+            process();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+
+        group.Wait();
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+}
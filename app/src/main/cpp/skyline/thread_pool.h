@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <common.h>
+
+namespace skyline {
+    /**
+     * @brief A work-stealing pool of persistent worker threads which is shared by all subsystems, so they split their work across a single budget of threads rather than each spawning their own
+     * @note Every worker has its own deque of tasks, workers take tasks from the back of their own deque and steal from the front of the others when it's empty
+     * @note Threads waiting on a TaskGroup process queued tasks until the group is done, so tasks can wait on groups of their own without deadlocking the pool
+     */
+    class ThreadPool {
+      public:
+        class TaskGroup;
+
+      private:
+        struct Task {
+            std::function<void()> function;
+            TaskGroup *group;
+        };
+
+        struct Worker {
+            std::mutex mutex; //!< Synchronizes access to tasks as other workers steal from it
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        const DeviceState &state;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> queuedTasks{}; //!< The amount of tasks across all deques, workers only sleep while this is 0
+        std::atomic<size_t> nextWorker{}; //!< The index of the worker to queue the next task from a thread outside the pool onto
+        std::mutex sleepMutex; //!< The mutex used for sleeping on sleepCondition, it's held while signalling so wakeups can't be lost
+        std::condition_variable sleepCondition; //!< Signalled when a task is queued, a group is done or the pool is being destroyed
+        bool stop{}; //!< If the workers should exit, this is protected by sleepMutex
+
+        /**
+         * @brief Queues a task onto the deque of the calling worker or onto any worker if the caller isn't part of the pool
+         */
+        void Queue(Task task);
+
+        /**
+         * @return A task taken from the calling worker's deque or stolen from another worker, if there are any
+         */
+        std::optional<Task> FindTask();
+
+        /**
+         * @brief Runs a task and marks it as done in its group, any exception thrown by it is stored in the group
+         */
+        void Execute(Task &task);
+
+        /**
+         * @brief The loop of every worker thread, it processes tasks until the pool is destroyed
+         */
+        void Run(size_t index);
+
+      public:
+        /**
+         * @brief A group of tasks which can be waited on together, the first exception thrown by any of its tasks is rethrown by Wait
+         * @note The group must outlive all of its tasks, this is ensured by the destructor waiting on them
+         */
+        class TaskGroup {
+          private:
+            friend ThreadPool;
+
+            ThreadPool &pool;
+            std::atomic<size_t> pending{}; //!< The amount of tasks in the group which haven't finished yet
+            std::mutex exceptionMutex; //!< Synchronizes access to exception
+            std::exception_ptr exception; //!< The first exception thrown by a task in the group
+
+            /**
+             * @brief Processes queued tasks of any group until every task in this group is done
+             */
+            void WaitForTasks();
+
+          public:
+            TaskGroup(ThreadPool &pool);
+
+            TaskGroup(const TaskGroup &) = delete;
+
+            /**
+             * @brief Waits for all tasks in the group without rethrowing any of their exceptions
+             */
+            ~TaskGroup();
+
+            /**
+             * @brief Queues a task to be run by the pool as a part of this group
+             */
+            void Run(std::function<void()> function);
+
+            /**
+             * @brief Waits for all tasks in the group to finish, the calling thread processes queued tasks in the meantime
+             * @note The first exception thrown by any task in the group is rethrown after all tasks have finished
+             */
+            void Wait();
+        };
+
+        /**
+         * @note The amount of workers and the host cores they're placed on are determined by the AffinityManager
+         */
+        ThreadPool(const DeviceState &state);
+
+        ~ThreadPool();
+
+        /**
+         * @brief Calls the supplied function for every index from 0 to count across the workers and the calling thread, this returns after every call has returned
+         * @note The first exception thrown by the function is rethrown after all calls have returned, indices which weren't started yet are skipped once a call has thrown
+         */
+        void ParallelFor(size_t count, const std::function<void(size_t)> &function);
+    };
+}
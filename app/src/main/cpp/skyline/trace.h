@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#ifdef SKYLINE_TRACING
+#include <dlfcn.h>
+#include <android/trace.h>
+#endif
+#include <common.h>
+
+namespace skyline::trace {
+#ifdef SKYLINE_TRACING
+    /**
+     * @brief A section of an ATrace event which spans the lifetime of this object, it shows up as a slice on the thread in Perfetto/Systrace
+     * @note The only cost while tracing isn't active is checking if it's active, which is a single load from a shared page
+     */
+    class ScopedSection {
+      private:
+        bool active; //!< If tracing was active when the section began, the section is only ended if it was begun
+
+      public:
+        /**
+         * @param name The name of the section, this must be a string literal or otherwise outlive the section
+         */
+        explicit ScopedSection(const char *name) : active(ATrace_isEnabled()) {
+            if (active)
+                ATrace_beginSection(name);
+        }
+
+        ScopedSection(const ScopedSection &) = delete;
+
+        ~ScopedSection() {
+            if (active)
+                ATrace_endSection();
+        }
+    };
+
+    /**
+     * @brief Sets the value of an ATrace counter, it shows up as a counter track of the process in Perfetto/Systrace
+     * @note ATrace_setCounter was added in API 29 so it's resolved at runtime, counters are ignored on older versions
+     */
+    inline void SetCounter(const char *name, i64 value) {
+        using SetCounterFunction = void (*)(const char *, int64_t);
+        static auto setCounter{reinterpret_cast<SetCounterFunction>(dlsym(RTLD_DEFAULT, "ATrace_setCounter"))};
+        if (setCounter && ATrace_isEnabled())
+            setCounter(name, value);
+    }
+#else
+    /**
+     * @brief A no-op stand-in for a trace section when tracing isn't compiled in
+     */
+    class ScopedSection {
+      public:
+        explicit constexpr ScopedSection(const char *) {}
+    };
+
+    constexpr void SetCounter(const char *, i64) {}
+#endif
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * @brief Traces the rest of the enclosing scope as a section with the given name, this compiles to nothing unless the TRACING CMake option is enabled
+ */
+#define TRACE_SCOPE(name) ::skyline::trace::ScopedSection TRACE_CONCAT(traceSection, __LINE__)(name)
@@ -56,6 +56,20 @@ namespace skyline::vfs {
             return object;
         }
 
+        /**
+         * @brief Maps a region of the backing into memory, this allows reading it without any copies
+         * @return A span of the region which is valid for the lifetime of the backing or an empty span if the backing can't be mapped, in which case it needs to be read
+         */
+        virtual span<u8> Map(size_t offset, size_t size) {
+            return {};
+        }
+
+        /**
+         * @brief Hints that a region of the backing is going to be read soon, backings which cache or map their data load it ahead of time
+         * @note This may block on I/O for the entire region, so it should be called from a thread which isn't latency sensitive
+         */
+        virtual void Prefetch(size_t offset, size_t size) {}
+
         /**
          * @brief Writes from a buffer to a particular offset in the backing
          * @param input The data to write to the backing
@@ -78,6 +92,11 @@ namespace skyline::vfs {
                 throw exception("Object wasn't written fully into output backing: {}/{}", size, sizeof(T));
         }
 
+        /**
+         * @brief Commits all writes to the backing to its underlying storage, writes may be buffered till this is called or the backing is destroyed
+         */
+        virtual void Flush() {}
+
         /**
          * @brief Resizes a backing to the given size
          * @param size The new size for the backing
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include "bktr_backing.h"
+
+namespace skyline::vfs {
+    CtrExEncryptedBacking::CtrExEncryptedBacking(crypto::KeyStore::Key128 &ctr, crypto::KeyStore::Key128 &key, const std::shared_ptr<Backing> &backing, size_t baseOffset, std::vector<Subsection> subsections) : Backing({true, false, false}, backing->size), ctr(ctr), cipher(key, MBEDTLS_CIPHER_AES_128_CTR), backing(backing), baseOffset(baseOffset), subsections(std::move(subsections)) {
+        if (this->subsections.empty() || this->subsections.front().offset != 0)
+            throw exception("AES-CTR-EX subsections don't cover the start of the backing");
+    }
+
+    size_t CtrExEncryptedBacking::Read(span<u8> output, size_t offset) {
+        constexpr size_t BlockSize{0x10}; // The size of an AES block, the counter can only be set at this granularity
+
+        if (offset >= size || output.empty())
+            return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        // Reads which aren't aligned to the AES block size are read into a buffer which covers the entire blocks they're in
+        size_t alignedOffset{util::AlignDown(offset, BlockSize)};
+        size_t alignedEnd{std::min(util::AlignUp(offset + output.size(), BlockSize), size)};
+        bool aligned{alignedOffset == offset && alignedEnd == offset + output.size()};
+
+        std::vector<u8> buffer;
+        span<u8> data{output};
+        if (!aligned) {
+            buffer.resize(alignedEnd - alignedOffset);
+            data = buffer;
+        }
+
+        if (backing->Read(data, alignedOffset) != data.size())
+            return 0;
+
+        auto subsection{std::prev(std::upper_bound(subsections.begin(), subsections.end(), alignedOffset, [](size_t offset, const Subsection &subsection) {
+            return offset < subsection.offset;
+        }))};
+
+        {
+            std::lock_guard guard(cipherMutex);
+            size_t decrypted{};
+            while (decrypted < data.size()) {
+                size_t position{alignedOffset + decrypted};
+                auto next{std::next(subsection)};
+                size_t length{std::min((next != subsections.end() ? next->offset : size) - position, data.size() - decrypted)};
+
+                u32 ctrBE{__builtin_bswap32(subsection->ctr)};
+                u64 blockBE{__builtin_bswap64((baseOffset + position) >> 4)};
+                std::memcpy(ctr.data() + 4, &ctrBE, sizeof(u32));
+                std::memcpy(ctr.data() + 8, &blockBE, sizeof(u64));
+                cipher.SetIV(ctr);
+                cipher.Decrypt(data.subspan(decrypted, length));
+
+                decrypted += length;
+                subsection = next;
+            }
+        }
+
+        if (!aligned)
+            std::memcpy(output.data(), buffer.data() + (offset - alignedOffset), output.size());
+        return output.size();
+    }
+
+    BktrBacking::BktrBacking(std::shared_ptr<Backing> base, std::shared_ptr<Backing> patch, std::vector<Relocation> relocations, size_t size) : Backing({true, false, false}, size), base(std::move(base)), patch(std::move(patch)), relocations(std::move(relocations)) {
+        if (this->relocations.empty() || this->relocations.front().virtualOffset != 0)
+            throw exception("BKTR relocations don't cover the start of the backing");
+    }
+
+    template<typename Function>
+    void BktrBacking::ForEachRun(size_t offset, size_t size, Function function) {
+        auto relocation{std::prev(std::upper_bound(relocations.begin(), relocations.end(), offset, [](size_t offset, const Relocation &relocation) {
+            return offset < relocation.virtualOffset;
+        }))};
+
+        size_t done{};
+        while (done < size) {
+            size_t position{offset + done};
+            auto next{std::next(relocation)};
+            size_t length{std::min((next != relocations.end() ? next->virtualOffset : this->size) - position, size - done)};
+
+            if (!function(relocation->patch ? *patch : *base, relocation->physicalOffset + (position - relocation->virtualOffset), done, length))
+                return;
+
+            done += length;
+            relocation = next;
+        }
+    }
+
+    size_t BktrBacking::Read(span<u8> output, size_t offset) {
+        if (offset >= size || output.empty())
+            return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        size_t read{};
+        ForEachRun(offset, output.size(), [&](Backing &backing, size_t backingOffset, size_t runOffset, size_t length) {
+            auto runRead{backing.Read(output.subspan(runOffset, length), backingOffset)};
+            read += runRead;
+            return runRead == length;
+        });
+        return read;
+    }
+
+    void BktrBacking::Prefetch(size_t offset, size_t size) {
+        if (offset >= this->size)
+            return;
+
+        ForEachRun(offset, std::min(size, this->size - offset), [](Backing &backing, size_t backingOffset, size_t runOffset, size_t length) {
+            backing.Prefetch(backingOffset, length);
+            return true;
+        });
+    }
+}
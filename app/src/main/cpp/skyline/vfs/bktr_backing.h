@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <crypto/aes_cipher.h>
+#include <crypto/key_store.h>
+#include "backing.h"
+
+namespace skyline::vfs {
+    /**
+     * @brief A backing for decrypting the AES-CTR-EX data of a BKTR patch, this is AES-CTR where the upper half of the counter changes between subsections of the data
+     */
+    class CtrExEncryptedBacking : public Backing {
+      public:
+        /**
+         * @brief A region of the data which is decrypted with the same upper half of the counter, it extends till the start of the next subsection
+         */
+        struct Subsection {
+            u64 offset; //!< The offset of the subsection in the backing
+            u32 ctr; //!< The value of the second word of the counter in this subsection
+        };
+
+      private:
+        crypto::KeyStore::Key128 ctr; //!< The base counter of the section, the second word is replaced by that of the subsection being decrypted
+        crypto::AesCipher cipher;
+        std::mutex cipherMutex; //!< Synchronizes access to the cipher and ctr as reads can happen concurrently
+        std::shared_ptr<Backing> backing;
+        size_t baseOffset; //!< The offset of the backing into the file is used to calculate the IV
+        std::vector<Subsection> subsections; //!< All subsections sorted by their offset
+
+      public:
+        CtrExEncryptedBacking(crypto::KeyStore::Key128 &ctr, crypto::KeyStore::Key128 &key, const std::shared_ptr<Backing> &backing, size_t baseOffset, std::vector<Subsection> subsections);
+
+        size_t Read(span<u8> output, size_t offset = 0) override;
+    };
+
+    /**
+     * @brief A backing which layers the data of a BKTR patch over the backing it patches, every region is read from either of them according to the relocation table of the patch
+     * @note The relocations are held in memory and looked up once per read, the following ones are walked in order as every relocation is contiguous with the one after it
+     */
+    class BktrBacking : public Backing {
+      public:
+        /**
+         * @brief A region of the patched backing which is read from a contiguous region in either the base or the patch, it extends till the start of the next relocation
+         */
+        struct Relocation {
+            u64 virtualOffset; //!< The offset of the region in the patched backing
+            u64 physicalOffset; //!< The offset of the region in the backing it's read from
+            bool patch; //!< If the region is read from the patch rather than the base
+        };
+
+      private:
+        std::shared_ptr<Backing> base; //!< The backing that's being patched
+        std::shared_ptr<Backing> patch; //!< The decrypted data of the patch
+        std::vector<Relocation> relocations; //!< All relocations sorted by their virtual offset
+
+        /**
+         * @brief Calls the supplied function for every contiguous run of a region with the backing it's in, the offset into it and the offset and size of the run in the region
+         */
+        template<typename Function>
+        void ForEachRun(size_t offset, size_t size, Function function);
+
+      public:
+        BktrBacking(std::shared_ptr<Backing> base, std::shared_ptr<Backing> patch, std::vector<Relocation> relocations, size_t size);
+
+        size_t Read(span<u8> output, size_t offset = 0) override;
+
+        void Prefetch(size_t offset, size_t size) override;
+    };
+}
@@ -4,9 +4,7 @@
 #include "ctr_encrypted_backing.h"
 
 namespace skyline::vfs {
-    constexpr size_t SectorSize{0x10};
-
-    CtrEncryptedBacking::CtrEncryptedBacking(crypto::KeyStore::Key128 &ctr, crypto::KeyStore::Key128 &key, const std::shared_ptr<Backing> &backing, size_t baseOffset) : Backing({true, false, false}), ctr(ctr), cipher(key, MBEDTLS_CIPHER_AES_128_CTR), backing(backing), baseOffset(baseOffset) {}
+    CtrEncryptedBacking::CtrEncryptedBacking(crypto::KeyStore::Key128 &ctr, crypto::KeyStore::Key128 &key, const std::shared_ptr<Backing> &backing, size_t baseOffset) : Backing({true, false, false}, backing->size), ctr(ctr), cipher(key, MBEDTLS_CIPHER_AES_128_CTR), backing(backing), baseOffset(baseOffset) {}
 
     void CtrEncryptedBacking::UpdateCtr(u64 offset) {
         offset >>= 4;
@@ -15,35 +13,105 @@ namespace skyline::vfs {
         cipher.SetIV(ctr);
     }
 
+    bool CtrEncryptedBacking::ReadDecrypted(span<u8> output, size_t offset) {
+        if (backing->Read(output, offset) != output.size())
+            return false;
+
+        std::lock_guard guard(cipherMutex);
+        UpdateCtr(baseOffset + offset);
+        cipher.Decrypt(output);
+        return true;
+    }
+
+    CtrEncryptedBacking::CacheBlock CtrEncryptedBacking::GetCacheBlock(size_t index) {
+        auto &shard{cache[index % CacheShardCount]};
+        {
+            std::lock_guard guard(shard.mutex);
+            auto block{shard.blockMap.find(index)};
+            if (block != shard.blockMap.end()) {
+                shard.blocks.splice(shard.blocks.begin(), shard.blocks, block->second);
+                return block->second->second;
+            }
+        }
+
+        // The block is read without holding the lock of the shard, so reads of other blocks in it aren't blocked on the I/O
+        size_t blockOffset{index * CacheBlockSize};
+        std::vector<u8> data(std::min(CacheBlockSize, size - blockOffset));
+        if (!ReadDecrypted(data, blockOffset))
+            return nullptr;
+        auto decrypted{std::make_shared<const std::vector<u8>>(std::move(data))};
+
+        std::lock_guard guard(shard.mutex);
+        auto block{shard.blockMap.find(index)};
+        if (block != shard.blockMap.end())
+            return block->second->second; // Another thread inserted the same block in the meantime
+
+        if (shard.blocks.size() == CacheShardBlocks) {
+            shard.blockMap.erase(shard.blocks.back().first);
+            shard.blocks.pop_back();
+        }
+        shard.blocks.emplace_front(index, decrypted);
+        shard.blockMap.emplace(index, shard.blocks.begin());
+        return decrypted;
+    }
+
+    CtrEncryptedBacking::CacheBlock CtrEncryptedBacking::FindCacheBlock(size_t index) {
+        auto &shard{cache[index % CacheShardCount]};
+        std::lock_guard guard(shard.mutex);
+        auto block{shard.blockMap.find(index)};
+        if (block == shard.blockMap.end())
+            return nullptr;
+        shard.blocks.splice(shard.blocks.begin(), shard.blocks, block->second);
+        return block->second->second;
+    }
+
     size_t CtrEncryptedBacking::Read(span<u8> output, size_t offset) {
-        size_t size{output.size()};
-        if (size == 0)
+        if (offset >= size || output.empty())
             return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        size_t read{};
+        while (read < output.size()) {
+            size_t position{offset + read};
+            size_t index{position / CacheBlockSize}, blockOffset{position % CacheBlockSize};
+            size_t length{std::min(CacheBlockSize - blockOffset, output.size() - read)};
+
+            if (blockOffset == 0 && length == CacheBlockSize) {
+                // Reads which cover entire blocks are decrypted directly into the output, caching them would only evict the blocks of smaller reads which are likely to be repeated
+                // Blocks which were prefetched into the cache are copied from it, the run of blocks up to the next cached one is decrypted directly
+                if (auto block{FindCacheBlock(index)}) {
+                    std::memcpy(output.data() + read, block->data(), CacheBlockSize);
+                    read += CacheBlockSize;
+                    continue;
+                }
+
+                size_t directLength{CacheBlockSize};
+                while (read + directLength + CacheBlockSize <= output.size() && !FindCacheBlock(index + (directLength / CacheBlockSize)))
+                    directLength += CacheBlockSize;
 
-        size_t sectorOffset{offset % SectorSize};
-        if (sectorOffset == 0) {
-            UpdateCtr(baseOffset + offset);
-            size_t read{backing->Read(output, offset)};
-            if (read != size)
+                if (!ReadDecrypted(output.subspan(read, directLength), position))
+                    return 0;
+                read += directLength;
+                continue;
+            }
+
+            auto block{GetCacheBlock(index)};
+            if (!block)
                 return 0;
-            cipher.Decrypt(output);
-            return size;
+            std::memcpy(output.data() + read, block->data() + blockOffset, length);
+            read += length;
         }
 
-        size_t sectorStart{offset - sectorOffset};
-        std::vector<u8> blockBuf(SectorSize);
-        size_t read{backing->Read(blockBuf, sectorStart)};
-        if (read != SectorSize)
-            return 0;
-        UpdateCtr(baseOffset + sectorStart);
-        cipher.Decrypt(blockBuf);
-        if (size + sectorOffset < SectorSize) {
-            std::memcpy(output.data(), blockBuf.data() + sectorOffset, size);
-            return size;
-        }
+        return read;
+    }
+
+    void CtrEncryptedBacking::Prefetch(size_t offset, size_t size) {
+        if (offset >= this->size)
+            return;
+        size_t end{std::min(offset + size, this->size)};
 
-        size_t readInBlock{SectorSize - sectorOffset};
-        std::memcpy(output.data(), blockBuf.data() + sectorOffset, readInBlock);
-        return readInBlock + Read(output.subspan(readInBlock), offset + readInBlock);
+        for (size_t index{offset / CacheBlockSize}; index * CacheBlockSize < end; index++)
+            if (!GetCacheBlock(index))
+                return;
     }
 }
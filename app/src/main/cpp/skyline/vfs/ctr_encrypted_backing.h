@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <list>
 #include <crypto/aes_cipher.h>
 #include <crypto/key_store.h>
 #include "backing.h"
@@ -10,22 +11,61 @@
 namespace skyline::vfs {
     /**
      * @brief A backing for decrypting AES-CTR data
+     * @note Decrypted blocks which are partially read are kept in a sharded LRU cache, as small files and filesystem metadata are read repeatedly
      */
     class CtrEncryptedBacking : public Backing {
       private:
+        static constexpr size_t CacheBlockSize{0x10000}; //!< The size of the blocks which are cached, this is a multiple of the AES block size so every block starts with a fresh counter
+        static constexpr size_t CacheShardCount{8}; //!< The amount of independently locked shards in the cache, blocks are assigned to them by index so concurrent reads rarely contend
+        static constexpr size_t CacheShardBlocks{16}; //!< The maximum amount of blocks in every shard
+
+        using CacheBlock = std::shared_ptr<const std::vector<u8>>;
+
+        /**
+         * @brief An independently locked part of the cache of decrypted blocks
+         */
+        struct CacheShard {
+            std::mutex mutex;
+            std::list<std::pair<size_t, CacheBlock>> blocks; //!< The index and data of every cached block ordered from the most to the least recently used
+            std::unordered_map<size_t, std::list<std::pair<size_t, CacheBlock>>::iterator> blockMap;
+        };
+
         crypto::KeyStore::Key128 ctr;
         crypto::AesCipher cipher;
+        std::mutex cipherMutex; //!< Synchronizes access to the cipher and ctr as reads can happen concurrently
         std::shared_ptr<Backing> backing;
         size_t baseOffset; //!< The offset of the backing into the file is used to calculate the IV
+        std::array<CacheShard, CacheShardCount> cache;
 
         /**
          * @brief Calculates IV based on the offset
          */
         void UpdateCtr(u64 offset);
 
+        /**
+         * @brief Reads and decrypts data from the backing, the offset must be aligned to the AES block size
+         * @return If the entire span could be read
+         */
+        bool ReadDecrypted(span<u8> output, size_t offset);
+
+        /**
+         * @return The decrypted contents of a cache block or nullptr if it couldn't be read, it's read and inserted into the cache if it isn't in it
+         */
+        CacheBlock GetCacheBlock(size_t index);
+
+        /**
+         * @return The decrypted contents of a cache block or nullptr if it isn't in the cache
+         */
+        CacheBlock FindCacheBlock(size_t index);
+
       public:
         CtrEncryptedBacking(crypto::KeyStore::Key128 &ctr, crypto::KeyStore::Key128 &key, const std::shared_ptr<Backing> &backing, size_t baseOffset);
 
         size_t Read(span<u8> output, size_t offset = 0) override;
+
+        /**
+         * @brief Decrypts the blocks covering the region into the cache, so reads of entire blocks which would bypass it are served from memory
+         */
+        void Prefetch(size_t offset, size_t size) override;
     };
 }
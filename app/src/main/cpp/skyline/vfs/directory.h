@@ -19,6 +19,7 @@ namespace skyline::vfs {
         struct Entry {
             std::string name;
             EntryType type;
+            size_t size{}; //!< The size of the file in bytes, this is always 0 for directories
         };
 
         /**
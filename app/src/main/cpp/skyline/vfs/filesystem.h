@@ -49,6 +49,11 @@ namespace skyline::vfs {
          */
         virtual std::shared_ptr<Backing> OpenFile(const std::string &path, Backing::Mode mode = {true, false, false}) = 0;
 
+        /**
+         * @brief Commits all writes to files of the filesystem which are still open to its underlying storage
+         */
+        virtual void Commit() {}
+
         /**
          * @brief Queries the type of the entry given by path
          * @param path The path to the entry
@@ -4,8 +4,9 @@
 #include <crypto/aes_cipher.h>
 #include <loader/loader.h>
 #include "ctr_encrypted_backing.h"
+#include "bktr_backing.h"
+#include "ncz_backing.h"
 #include "region_backing.h"
-#include "partition_filesystem.h"
 #include "nca.h"
 #include "rom_filesystem.h"
 #include "directory.h"
@@ -13,7 +14,7 @@
 namespace skyline::vfs {
     using namespace loader;
 
-    NCA::NCA(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore) : backing(backing), keyStore(keyStore) {
+    NCA::NCA(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<Backing> &baseRomFsSection, const std::shared_ptr<ThreadPool> &threadPool, bool verify) : backing(backing), keyStore(keyStore), baseRomFsSection(baseRomFsSection), threadPool(threadPool), verify(verify) {
         header = backing->Read<NcaHeader>();
 
         if (header.magic != util::MakeMagic<u32>("NCA3")) {
@@ -31,41 +32,125 @@ namespace skyline::vfs {
         }
 
         contentType = header.contentType;
+        programId = header.programId;
         rightsIdEmpty = header.rightsId == crypto::KeyStore::Key128{};
+    }
 
-        for (size_t i{}; i < header.sectionHeaders.size(); i++) {
-            auto &sectionHeader{header.sectionHeaders.at(i)};
-            auto &sectionEntry{header.fsEntries.at(i)};
+    bool NCA::IsSectionPresent(size_t index, NcaSectionFsType fsType) {
+        const auto &sectionHeader{header.sectionHeaders.at(index)};
+        const auto &entry{header.fsEntries.at(index)};
+        if (entry.endOffset <= entry.startOffset || sectionHeader.fsType != fsType)
+            return false;
 
-            if (sectionHeader.fsType == NcaSectionFsType::PFS0 && sectionHeader.hashType == NcaSectionHashType::HierarchicalSha256)
-                ReadPfs0(sectionHeader, sectionEntry);
-            else if (sectionHeader.fsType == NcaSectionFsType::RomFs && sectionHeader.hashType == NcaSectionHashType::HierarchicalIntegrity)
-                ReadRomFs(sectionHeader, sectionEntry);
-        }
+        if (fsType == NcaSectionFsType::PFS0)
+            return sectionHeader.hashType == NcaSectionHashType::HierarchicalSha256;
+        if (encrypted && sectionHeader.encryptionType == NcaSectionEncryptionType::BKTR && !baseRomFsSection)
+            return false; // The data of a patch which isn't in the patch itself is read from the base, so it can't be read by itself
+        return sectionHeader.hashType == NcaSectionHashType::HierarchicalIntegrity;
     }
 
-    void NCA::ReadPfs0(const NcaSectionHeader &sectionHeader, const NcaFsEntry &entry) {
-        size_t offset{static_cast<size_t>(entry.startOffset) * constant::MediaUnitSize + sectionHeader.sha256HashInfo.pfs0Offset};
+    std::shared_ptr<Backing> NCA::GetSectionBacking(size_t index) {
+        auto &sectionBacking{sectionBackings.at(index)};
+        if (sectionBacking)
+            return sectionBacking;
+
+        const auto &sectionHeader{header.sectionHeaders.at(index)};
+        const auto &entry{header.fsEntries.at(index)};
+        size_t offset{static_cast<size_t>(entry.startOffset) * constant::MediaUnitSize};
         size_t size{constant::MediaUnitSize * static_cast<size_t>(entry.endOffset - entry.startOffset)};
 
-        auto pfs{std::make_shared<PartitionFileSystem>(CreateBacking(sectionHeader, std::make_shared<RegionBacking>(backing, offset, size), offset))};
+        if (encrypted && sectionHeader.encryptionType == NcaSectionEncryptionType::BKTR) {
+            if (!baseRomFsSection)
+                return nullptr;
+            sectionBacking = CreatePatchBacking(sectionHeader, offset, size);
+        } else {
+            // The sections of an NCZ are stored decrypted, so they're read directly rather than being re-encrypted only to be decrypted again
+            if (auto ncz{std::dynamic_pointer_cast<NczBacking>(backing)}; ncz && encrypted && sectionHeader.encryptionType == NcaSectionEncryptionType::CTR)
+                sectionBacking = ncz->GetDecryptedSection(offset, size);
+            if (!sectionBacking)
+                sectionBacking = CreateBacking(sectionHeader, std::make_shared<RegionBacking>(backing, offset, size), offset);
+        }
+        return sectionBacking;
+    }
 
-        if (contentType == NcaContentType::Program) {
-            // An ExeFS must always contain an NPDM and a main NSO, whereas the logo section will always contain a logo and a startup movie
-            if (pfs->FileExists("main") && pfs->FileExists("main.npdm"))
-                exeFs = std::move(pfs);
-            else if (pfs->FileExists("NintendoLogo.png") && pfs->FileExists("StartupMovie.gif"))
-                logo = std::move(pfs);
-        } else if (contentType == NcaContentType::Meta) {
-            cnmt = std::move(pfs);
+    std::shared_ptr<PartitionFileSystem> NCA::GetPartitionFileSystem(size_t index) {
+        auto &pfs{partitionFileSystems.at(index)};
+        if (!pfs) {
+            std::shared_ptr<Backing> pfsBacking;
+            if (verify && !(pfsBacking = GetVerifiedBacking(index)))
+                throw exception("The hash header of PFS0 section {} is invalid", index);
+            if (!pfsBacking) {
+                const auto &hashInfo{header.sectionHeaders.at(index).sha256HashInfo};
+                pfsBacking = std::make_shared<RegionBacking>(GetSectionBacking(index), hashInfo.pfs0Offset, hashInfo.pfs0Size);
+            }
+            pfs = std::make_shared<PartitionFileSystem>(pfsBacking);
         }
+        return pfs;
     }
 
-    void NCA::ReadRomFs(const NcaSectionHeader &sectionHeader, const NcaFsEntry &entry) {
-        size_t offset{static_cast<size_t>(entry.startOffset) * constant::MediaUnitSize + sectionHeader.integrityHashInfo.levels.back().offset};
-        size_t size{sectionHeader.integrityHashInfo.levels.back().size};
+    std::shared_ptr<FileSystem> NCA::FindPartitionFileSystem(const std::string &firstFile, const std::string &secondFile) {
+        for (size_t index{}; index < SectionCount; index++) {
+            if (!IsSectionPresent(index, NcaSectionFsType::PFS0))
+                continue;
+
+            auto pfs{GetPartitionFileSystem(index)};
+            if (pfs->FileExists(firstFile) && pfs->FileExists(secondFile))
+                return pfs;
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<FileSystem> NCA::GetExeFs() {
+        // An ExeFS must always contain an NPDM and a main NSO, whereas the logo section will always contain a logo and a startup movie
+        return contentType == NcaContentType::Program ? FindPartitionFileSystem("main", "main.npdm") : nullptr;
+    }
+
+    std::shared_ptr<FileSystem> NCA::GetLogo() {
+        return contentType == NcaContentType::Program ? FindPartitionFileSystem("NintendoLogo.png", "StartupMovie.gif") : nullptr;
+    }
+
+    std::shared_ptr<FileSystem> NCA::GetCnmt() {
+        if (contentType != NcaContentType::Meta)
+            return nullptr;
+
+        for (size_t index{}; index < SectionCount; index++)
+            if (IsSectionPresent(index, NcaSectionFsType::PFS0))
+                return GetPartitionFileSystem(index);
+        return nullptr;
+    }
 
-        romFs = CreateBacking(sectionHeader, std::make_shared<RegionBacking>(backing, offset, size), offset);
+    bool NCA::HasRomFs() {
+        for (size_t index{}; index < SectionCount; index++)
+            if (IsSectionPresent(index, NcaSectionFsType::RomFs))
+                return true;
+        return false;
+    }
+
+    std::shared_ptr<Backing> NCA::GetRomFsSection() {
+        for (size_t index{}; index < SectionCount; index++)
+            if (IsSectionPresent(index, NcaSectionFsType::RomFs))
+                return GetSectionBacking(index);
+        return nullptr;
+    }
+
+    std::shared_ptr<Backing> NCA::GetRomFs() {
+        if (romFs)
+            return romFs;
+
+        for (size_t index{}; index < SectionCount; index++) {
+            if (!IsSectionPresent(index, NcaSectionFsType::RomFs))
+                continue;
+
+            if (verify) {
+                if (!(romFs = GetVerifiedBacking(index)))
+                    throw exception("The hash header of RomFS section {} is invalid", index);
+            } else {
+                const auto &level{header.sectionHeaders.at(index).integrityHashInfo.levels.back()};
+                romFs = std::make_shared<RegionBacking>(GetSectionBacking(index), level.offset, level.size);
+            }
+            break;
+        }
+        return romFs;
     }
 
     std::shared_ptr<Backing> NCA::CreateBacking(const NcaSectionHeader &sectionHeader, std::shared_ptr<Backing> rawBacking, size_t offset) {
@@ -78,13 +163,7 @@ namespace skyline::vfs {
             case NcaSectionEncryptionType::CTR:
             case NcaSectionEncryptionType::BKTR: {
                 auto key{!rightsIdEmpty ? GetTitleKey() : GetKeyAreaKey(sectionHeader.encryptionType)};
-
-                std::array<u8, 0x10> ctr{};
-                u32 secureValueLE{__builtin_bswap32(sectionHeader.secureValue)};
-                u32 generationLE{__builtin_bswap32(sectionHeader.generation)};
-                std::memcpy(ctr.data(), &secureValueLE, 4);
-                std::memcpy(ctr.data() + 4, &generationLE, 4);
-
+                auto ctr{GetSectionCtr(sectionHeader)};
                 return std::make_shared<CtrEncryptedBacking>(ctr, key, std::move(rawBacking), offset);
             }
             default:
@@ -92,6 +171,170 @@ namespace skyline::vfs {
         }
     }
 
+    std::shared_ptr<Backing> NCA::CreatePatchBacking(const NcaSectionHeader &sectionHeader, size_t offset, size_t size) {
+        /**
+         * @brief The header of the table at the start of a bucket tree, it is followed by the offsets at which every bucket starts
+         */
+        struct BucketTreeTable {
+            u32 _pad_;
+            u32 bucketCount; //!< The amount of buckets in the tree
+            u64 size; //!< The total size of the region the tree covers
+        };
+
+        /**
+         * @brief The header of a bucket in a bucket tree, it is followed by its entries
+         */
+        struct BucketHeader {
+            u32 _pad_;
+            u32 entryCount; //!< The amount of entries in the bucket
+            u64 endOffset; //!< The offset at which the region the bucket covers ends
+        };
+
+        struct __attribute__((packed)) IndirectEntry {
+            u64 virtualOffset; //!< The offset of the region in the patched section
+            u64 physicalOffset; //!< The offset of the region in the section it's read from
+            u32 storageIndex; //!< The section the region is read from, 0 for the base and 1 for the patch
+        };
+        static_assert(sizeof(IndirectEntry) == 0x14);
+
+        struct AesCtrExEntry {
+            u64 offset; //!< The offset of the subsection in the patch section
+            u32 _pad_;
+            u32 ctr; //!< The value of the second word of the counter in the subsection
+        };
+        static_assert(sizeof(AesCtrExEntry) == 0x10);
+
+        constexpr size_t BucketSize{0x4000}; // The size of the table and of every bucket in a bucket tree
+
+        // Both tables are decrypted with the regular AES-CTR of the section, the buckets of each one are flattened into a single sorted list of entries
+        auto rawBacking{std::make_shared<RegionBacking>(backing, offset, size)};
+        auto tableBacking{CreateBacking(sectionHeader, rawBacking, offset)};
+
+        auto readTree{[&](u64 treeOffset, u64 treeSize, const BucketTreeHeader &header, size_t entrySize, auto callback) {
+            if (header.magic != util::MakeMagic<u32>("BKTR"))
+                throw exception("Invalid BKTR magic! 0x{0:X}", header.magic);
+            if (treeSize < BucketSize)
+                throw exception("BKTR bucket tree is too small: 0x{:X}", treeSize);
+
+            std::vector<u8> tree(treeSize);
+            tableBacking->Read(tree, treeOffset);
+
+            BucketTreeTable table;
+            std::memcpy(&table, tree.data(), sizeof(BucketTreeTable));
+            if (table.bucketCount > (tree.size() / BucketSize) - 1)
+                throw exception("BKTR bucket tree has more buckets than fit in it: {}", table.bucketCount);
+
+            for (size_t bucket{}; bucket < table.bucketCount; bucket++) {
+                auto bucketData{tree.data() + (bucket + 1) * BucketSize};
+                BucketHeader bucketHeader;
+                std::memcpy(&bucketHeader, bucketData, sizeof(BucketHeader));
+                if (bucketHeader.entryCount > (BucketSize - sizeof(BucketHeader)) / entrySize)
+                    throw exception("BKTR bucket has more entries than fit in it: {}", bucketHeader.entryCount);
+
+                for (size_t entry{}; entry < bucketHeader.entryCount; entry++)
+                    callback(bucketData + sizeof(BucketHeader) + entry * entrySize);
+            }
+
+            return table.size;
+        }};
+
+        const auto &patchInfo{sectionHeader.patchInfo};
+
+        std::vector<CtrExEncryptedBacking::Subsection> subsections;
+        subsections.reserve(patchInfo.aesCtrExHeader.entryCount + 1);
+        readTree(patchInfo.aesCtrExOffset, patchInfo.aesCtrExSize, patchInfo.aesCtrExHeader, sizeof(AesCtrExEntry), [&](const u8 *data) {
+            AesCtrExEntry entry;
+            std::memcpy(&entry, data, sizeof(AesCtrExEntry));
+            subsections.push_back({entry.offset, entry.ctr});
+        });
+        subsections.push_back({patchInfo.indirectOffset, sectionHeader.generation}); // The tables at the end of the section are encrypted with the counter of the section itself
+
+        std::vector<BktrBacking::Relocation> relocations;
+        relocations.reserve(patchInfo.indirectHeader.entryCount);
+        auto virtualSize{readTree(patchInfo.indirectOffset, patchInfo.indirectSize, patchInfo.indirectHeader, sizeof(IndirectEntry), [&](const u8 *data) {
+            IndirectEntry entry;
+            std::memcpy(&entry, data, sizeof(IndirectEntry));
+            relocations.push_back({entry.virtualOffset, entry.physicalOffset, entry.storageIndex != 0});
+        })};
+
+        if (!std::is_sorted(subsections.begin(), subsections.end(), [](const auto &lhs, const auto &rhs) { return lhs.offset < rhs.offset; }))
+            throw exception("BKTR subsections aren't sorted by their offset");
+        if (!std::is_sorted(relocations.begin(), relocations.end(), [](const auto &lhs, const auto &rhs) { return lhs.virtualOffset < rhs.virtualOffset; }))
+            throw exception("BKTR relocations aren't sorted by their offset");
+
+        auto key{!rightsIdEmpty ? GetTitleKey() : GetKeyAreaKey(sectionHeader.encryptionType)};
+        auto ctr{GetSectionCtr(sectionHeader)};
+        auto patch{std::make_shared<CtrExEncryptedBacking>(ctr, key, rawBacking, offset, std::move(subsections))};
+
+        return std::make_shared<BktrBacking>(baseRomFsSection, std::move(patch), std::move(relocations), virtualSize);
+    }
+
+    crypto::KeyStore::Key128 NCA::GetSectionCtr(const NcaSectionHeader &sectionHeader) {
+        crypto::KeyStore::Key128 ctr{};
+        u32 secureValueLE{__builtin_bswap32(sectionHeader.secureValue)};
+        u32 generationLE{__builtin_bswap32(sectionHeader.generation)};
+        std::memcpy(ctr.data(), &secureValueLE, 4);
+        std::memcpy(ctr.data() + 4, &generationLE, 4);
+        return ctr;
+    }
+
+    std::shared_ptr<VerifyingBacking> NCA::GetVerifiedBacking(size_t index) {
+        auto &verifiedBacking{verifiedBackings.at(index)};
+        if (verifiedBacking)
+            return verifiedBacking;
+
+        const auto &sectionHeader{header.sectionHeaders.at(index)};
+        if (IsSectionPresent(index, NcaSectionFsType::PFS0)) {
+            const auto &hashInfo{sectionHeader.sha256HashInfo};
+            auto section{GetSectionBacking(index)};
+            if (!section || !hashInfo.blockSize || !hashInfo.hashTableSize)
+                return nullptr;
+
+            // The hash table is verified as a single block against its hash in the header, it's then the source of the hashes of the PFS0's blocks
+            std::vector<u8> hashTableHash(hashInfo.hashTableHash.begin(), hashInfo.hashTableHash.end());
+            auto hashTable{std::make_shared<VerifyingBacking>(std::make_shared<RegionBacking>(section, hashInfo.hashTableOffset, hashInfo.hashTableSize), std::move(hashTableHash), hashInfo.hashTableSize, false, nullptr)};
+            verifiedBacking = std::make_shared<VerifyingBacking>(std::make_shared<RegionBacking>(section, hashInfo.pfs0Offset, hashInfo.pfs0Size), std::move(hashTable), hashInfo.blockSize, false, threadPool); // The last block is hashed over only the data that's in it
+        } else if (IsSectionPresent(index, NcaSectionFsType::RomFs)) {
+            const auto &hashInfo{sectionHeader.integrityHashInfo};
+            if (hashInfo.magic != util::MakeMagic<u32>("IVFC") || hashInfo.numLevels < 2 || hashInfo.numLevels - 1 > hashInfo.levels.size() || hashInfo.masterHashSize > hashInfo.masterHash.size())
+                return nullptr;
+            auto section{GetSectionBacking(index)};
+            if (!section)
+                return nullptr;
+
+            // Every level is hashed by the level before it and the first one by the master hash in the header, so a level is only verified as far as the levels after it are read
+            std::shared_ptr<VerifyingBacking> level;
+            for (size_t levelIndex{}; levelIndex < hashInfo.numLevels - 1; levelIndex++) {
+                const auto &levelInfo{hashInfo.levels[levelIndex]};
+                if (levelInfo.blockSize >= 32)
+                    return nullptr;
+                size_t blockSize{1ULL << levelInfo.blockSize}; // The block size of a level is stored as a power of two
+
+                // A partial block at the end of a level is hashed as if it was padded with zeros to the block size
+                auto levelData{std::make_shared<RegionBacking>(section, levelInfo.offset, levelInfo.size)};
+                if (level)
+                    level = std::make_shared<VerifyingBacking>(std::move(levelData), std::move(level), blockSize, true, threadPool);
+                else
+                    level = std::make_shared<VerifyingBacking>(std::move(levelData), std::vector<u8>(hashInfo.masterHash.begin(), hashInfo.masterHash.begin() + hashInfo.masterHashSize), blockSize, true, threadPool);
+            }
+            verifiedBacking = std::move(level);
+        }
+        return verifiedBacking;
+    }
+
+    bool NCA::VerifyIntegrity(const std::atomic_bool &cancel) {
+        for (size_t index{}; index < SectionCount && !cancel; index++) {
+            if (!IsSectionPresent(index, NcaSectionFsType::PFS0) && !IsSectionPresent(index, NcaSectionFsType::RomFs))
+                continue;
+
+            // Only the last level of a RomFS is verified directly, the levels before it are verified through being read for its hashes
+            auto verifiedBacking{GetVerifiedBacking(index)};
+            if (!verifiedBacking || !verifiedBacking->VerifyAll(cancel))
+                return false;
+        }
+        return true;
+    }
+
     u8 NCA::GetKeyGeneration() {
         u8 legacyGen{static_cast<u8>(header.legacyKeyGenerationType)};
         u8 gen{static_cast<u8>(header.keyGenerationType)};
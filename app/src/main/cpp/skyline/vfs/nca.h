@@ -3,9 +3,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <crypto/key_store.h>
 #include <crypto/aes_cipher.h>
-#include "filesystem.h"
+#include "partition_filesystem.h"
+#include "verifying_backing.h"
 
 namespace skyline {
     namespace constant {
@@ -127,6 +129,30 @@ namespace skyline {
             };
             static_assert(sizeof(HierarchicalSha256HashInfo) == 0xF8);
 
+            /**
+             * @brief The header of a bucket tree, it's used for both of the tables of a BKTR patch
+             */
+            struct BucketTreeHeader {
+                u32 magic; //!< The bucket tree magic, 'BKTR'
+                u32 version; //!< The version of the bucket tree format
+                u32 entryCount; //!< The total amount of entries in the tree
+                u32 _pad_;
+            };
+            static_assert(sizeof(BucketTreeHeader) == 0x10);
+
+            /**
+             * @brief The locations of the tables of a BKTR patch, these are relative to the start of the section
+             */
+            struct PatchInfo {
+                u64 indirectOffset; //!< The offset of the relocation table
+                u64 indirectSize; //!< The size of the relocation table
+                BucketTreeHeader indirectHeader; //!< The header of the relocation table
+                u64 aesCtrExOffset; //!< The offset of the AES-CTR-EX subsection table
+                u64 aesCtrExSize; //!< The size of the AES-CTR-EX subsection table
+                BucketTreeHeader aesCtrExHeader; //!< The header of the AES-CTR-EX subsection table
+            };
+            static_assert(sizeof(PatchInfo) == 0x40);
+
             struct NcaSectionHeader {
                 u16 version; //!< The version, always 2
                 NcaSectionFsType fsType; //!< The type of the filesystem in the section
@@ -137,7 +163,7 @@ namespace skyline {
                     HierarchicalIntegrityHashInfo integrityHashInfo; //!< The HashInfo used for RomFS
                     HierarchicalSha256HashInfo sha256HashInfo; //!< The HashInfo used for PFS0
                 };
-                u8 _pad1_[0x40]; // PatchInfo
+                PatchInfo patchInfo; //!< The tables of the patch, this is only used by sections with BKTR encryption
                 u32 generation; //!< The generation of the NCA section
                 u32 secureValue; //!< The secure value of the section
                 u8 _pad2_[0x30]; //!< SparseInfo
@@ -169,17 +195,62 @@ namespace skyline {
             } header{};
             static_assert(sizeof(NcaHeader) == 0xC00);
 
+            static constexpr size_t SectionCount{4}; //!< The maximum amount of sections in an NCA
+
             std::shared_ptr<Backing> backing;
             std::shared_ptr<crypto::KeyStore> keyStore;
+            std::shared_ptr<Backing> baseRomFsSection; //!< The RomFS section of the NCA this NCA patches, if any
+            std::shared_ptr<ThreadPool> threadPool; //!< The pool that blocks are verified on, this may be nullptr
+            bool verify; //!< If the filesystems are read through their hashes, so that any corrupted block is caught when it's read
             bool encrypted{false};
             bool rightsIdEmpty;
 
-            void ReadPfs0(const NcaSectionHeader &sectionHeader, const NcaFsEntry &entry);
+            // The sections are only decrypted and parsed when they're first accessed, as listing the metadata of a title only requires a few of them
+            std::array<std::shared_ptr<Backing>, SectionCount> sectionBackings; //!< The decrypted backings of every section
+            std::array<std::shared_ptr<PartitionFileSystem>, SectionCount> partitionFileSystems; //!< The PFS0 filesystems of every section with one
+            std::shared_ptr<Backing> romFs;
+            std::array<std::shared_ptr<VerifyingBacking>, SectionCount> verifiedBackings; //!< The backings of the hashed data of every section which verify it against the hashes, these are shared between reads and VerifyIntegrity
 
-            void ReadRomFs(const NcaSectionHeader &sectionHeader, const NcaFsEntry &entry);
+            /**
+             * @return If a section with a supported filesystem is present at the supplied index
+             */
+            bool IsSectionPresent(size_t index, NcaSectionFsType fsType);
+
+            /**
+             * @return The decrypted backing of the entire section at the supplied index or nullptr if it can't be read
+             */
+            std::shared_ptr<Backing> GetSectionBacking(size_t index);
+
+            /**
+             * @return The PFS0 filesystem of the section at the supplied index
+             */
+            std::shared_ptr<PartitionFileSystem> GetPartitionFileSystem(size_t index);
+
+            /**
+             * @return The first PFS0 filesystem which contains both of the supplied files or nullptr if there's none
+             */
+            std::shared_ptr<FileSystem> FindPartitionFileSystem(const std::string &firstFile, const std::string &secondFile);
 
             std::shared_ptr<Backing> CreateBacking(const NcaSectionHeader &sectionHeader, std::shared_ptr<Backing> rawBacking, size_t offset);
 
+            /**
+             * @brief Creates a backing for a BKTR section which layers its data over the RomFS section of the base NCA
+             * @param offset The offset of the section in the NCA
+             * @param size The size of the section
+             */
+            std::shared_ptr<Backing> CreatePatchBacking(const NcaSectionHeader &sectionHeader, size_t offset, size_t size);
+
+            /**
+             * @return The AES-CTR counter of a section with the offset set to 0
+             */
+            static crypto::KeyStore::Key128 GetSectionCtr(const NcaSectionHeader &sectionHeader);
+
+            /**
+             * @return A backing of the hashed data of the section at the supplied index which verifies every block the first time it's read or nullptr if the hash header is invalid
+             * @note For a PFS0 section this is the PFS0 itself, for a RomFS section this is the last level of the hierarchical integrity scheme which is the RomFS while every level before it is verified as it's used
+             */
+            std::shared_ptr<VerifyingBacking> GetVerifiedBacking(size_t index);
+
             u8 GetKeyGeneration();
 
             crypto::KeyStore::Key128 GetTitleKey();
@@ -187,13 +258,53 @@ namespace skyline {
             crypto::KeyStore::Key128 GetKeyAreaKey(NcaSectionEncryptionType type);
 
           public:
-            std::shared_ptr<FileSystem> exeFs; //!< The PFS0 filesystem for this NCA's ExeFS section
-            std::shared_ptr<FileSystem> logo; //!< The PFS0 filesystem for this NCA's logo section
-            std::shared_ptr<FileSystem> cnmt; //!< The PFS0 filesystem for this NCA's CNMT section
-            std::shared_ptr<Backing> romFs; //!< The backing for this NCA's RomFS section
             NcaContentType contentType; //!< The content type of the NCA
+            u64 programId; //!< The title ID of the program the NCA belongs to
+
+            /**
+             * @param baseRomFsSection The RomFS section of the NCA this NCA patches, a BKTR RomFS section can't be read without it
+             * @param threadPool The pool that blocks are verified on, they're verified serially if this is nullptr
+             * @param verify If the ExeFS and RomFS should be verified against their hashes as they're read, an exception is thrown on reading a corrupted block
+             */
+            NCA(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore, const std::shared_ptr<Backing> &baseRomFsSection = nullptr, const std::shared_ptr<ThreadPool> &threadPool = nullptr, bool verify = false);
+
+            /**
+             * @return The PFS0 filesystem for this NCA's ExeFS section or nullptr if it has none
+             */
+            std::shared_ptr<FileSystem> GetExeFs();
+
+            /**
+             * @return The PFS0 filesystem for this NCA's logo section or nullptr if it has none
+             */
+            std::shared_ptr<FileSystem> GetLogo();
+
+            /**
+             * @return The PFS0 filesystem for this NCA's CNMT section or nullptr if it has none
+             */
+            std::shared_ptr<FileSystem> GetCnmt();
 
-            NCA(const std::shared_ptr<vfs::Backing> &backing, const std::shared_ptr<crypto::KeyStore> &keyStore);
+            /**
+             * @return If this NCA has a RomFS section, this doesn't decrypt or read the section
+             */
+            bool HasRomFs();
+
+            /**
+             * @return The backing for this NCA's entire RomFS section including the hash levels or nullptr if it has none, this is what the BKTR sections of updates are layered over
+             */
+            std::shared_ptr<Backing> GetRomFsSection();
+
+            /**
+             * @return The backing for this NCA's RomFS or nullptr if it has none
+             */
+            std::shared_ptr<Backing> GetRomFs();
+
+            /**
+             * @brief Verifies the data of every section against its hashes, this reads the entire NCA so it should be done on a background thread
+             * @note Blocks which have already been verified by being read aren't verified again
+             * @param cancel If set, the verification is stopped as soon as possible
+             * @return If every section is intact, this is also true if the verification was cancelled
+             */
+            bool VerifyIntegrity(const std::atomic_bool &cancel);
         };
     }
 }
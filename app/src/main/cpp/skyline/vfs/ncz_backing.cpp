@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <sys/mman.h>
+#include <zstd.h>
+#include <thread_pool.h>
+#include "region_backing.h"
+#include "ncz_backing.h"
+
+namespace skyline::vfs {
+    /**
+     * @brief The header of a block-compressed NCZ body, it is followed by the compressed size of every block
+     */
+    struct NczBlockHeader {
+        u64 magic; //!< "NCZBLOCK"
+        u8 version;
+        u8 type;
+        u8 _pad_;
+        u8 blockSizeExponent; //!< The size of a decompressed block as a power of two
+        u32 blockCount;
+        u64 decompressedSize;
+    };
+    static_assert(sizeof(NczBlockHeader) == 0x18);
+
+    NczBodyBacking::NczBodyBacking(std::shared_ptr<Backing> pBacking, size_t size, std::shared_ptr<ThreadPool> pThreadPool) : Backing({true, false, false}, size), backing(std::move(pBacking)), threadPool(std::move(pThreadPool)) {
+        auto blockHeader{backing->Read<NczBlockHeader>()};
+        if (blockHeader.magic == util::MakeMagic<u64>("NCZBLOCK")) {
+            if (blockHeader.blockSizeExponent < 14 || blockHeader.blockSizeExponent > 32)
+                throw exception("Invalid NCZ block size exponent: {}", blockHeader.blockSizeExponent);
+            blockSize = 1ULL << blockHeader.blockSizeExponent;
+            this->size = blockHeader.decompressedSize;
+            if (util::AlignUp(this->size, blockSize) / blockSize != blockHeader.blockCount)
+                throw exception("NCZ block count doesn't match its decompressed size: {} (Size: 0x{:X})", blockHeader.blockCount, this->size);
+
+            std::vector<u32> compressedSizes(blockHeader.blockCount);
+            backing->Read(span(compressedSizes).cast<u8>(), sizeof(NczBlockHeader));
+
+            // The offsets of the blocks are accumulated in advance, so any block can be located without walking the ones before it
+            blockOffsets.reserve(compressedSizes.size() + 1);
+            u64 offset{sizeof(NczBlockHeader) + compressedSizes.size() * sizeof(u32)};
+            for (auto compressedSize : compressedSizes) {
+                blockOffsets.push_back(offset);
+                offset += compressedSize;
+            }
+            blockOffsets.push_back(offset);
+            if (offset > backing->size)
+                throw exception("NCZ blocks extend past the end of the file: 0x{:X}/0x{:X}", offset, backing->size);
+
+            cacheCapacity = std::max<size_t>(CacheSize / blockSize, 4);
+        } else {
+            std::array<u8, 18> frameHeader{}; // The maximum size of a zstd frame header
+            backing->Read(span(frameHeader).first(std::min(frameHeader.size(), backing->size)));
+            if (auto contentSize{ZSTD_getFrameContentSize(frameHeader.data(), frameHeader.size())}; contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR)
+                this->size = contentSize;
+
+            solidStream = ZSTD_createDStream();
+            ZSTD_initDStream(static_cast<ZSTD_DStream *>(solidStream));
+
+            // The mapping is only backed by memory as far as it has been decompressed
+            solidData = static_cast<u8 *>(mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+            if (solidData == MAP_FAILED)
+                throw exception("Failed to map the decompressed NCZ body: {}", strerror(errno));
+        }
+    }
+
+    NczBodyBacking::~NczBodyBacking() {
+        if (solidStream)
+            ZSTD_freeDStream(static_cast<ZSTD_DStream *>(solidStream));
+        if (solidData)
+            munmap(solidData, size);
+    }
+
+    NczBodyBacking::CacheBlock NczBodyBacking::DecompressBlock(size_t index) {
+        size_t decompressedSize{std::min(blockSize, size - index * blockSize)};
+        size_t compressedSize{static_cast<size_t>(blockOffsets[index + 1] - blockOffsets[index])};
+
+        std::vector<u8> compressed;
+        auto source{backing->Map(blockOffsets[index], compressedSize)};
+        if (source.empty()) {
+            compressed.resize(compressedSize);
+            backing->Read(compressed, blockOffsets[index]);
+            source = compressed;
+        }
+
+        std::vector<u8> data(decompressedSize);
+        if (compressedSize >= decompressedSize) {
+            // Blocks which don't compress are stored uncompressed
+            std::memcpy(data.data(), source.data(), decompressedSize);
+        } else {
+            thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context{ZSTD_createDCtx(), &ZSTD_freeDCtx};
+            auto result{ZSTD_decompressDCtx(context.get(), data.data(), data.size(), source.data(), source.size())};
+            if (ZSTD_isError(result) || result != decompressedSize)
+                throw exception("Failed to decompress NCZ block {}: {}", index, ZSTD_isError(result) ? ZSTD_getErrorName(result) : "Size mismatch");
+        }
+        return std::make_shared<const std::vector<u8>>(std::move(data));
+    }
+
+    NczBodyBacking::CacheBlock NczBodyBacking::FindCacheBlock(size_t index) {
+        std::lock_guard guard(cacheMutex);
+        auto block{cacheMap.find(index)};
+        if (block == cacheMap.end())
+            return nullptr;
+        cacheBlocks.splice(cacheBlocks.begin(), cacheBlocks, block->second);
+        return block->second->second;
+    }
+
+    void NczBodyBacking::InsertCacheBlock(size_t index, CacheBlock block) {
+        std::lock_guard guard(cacheMutex);
+        if (cacheMap.find(index) != cacheMap.end())
+            return; // Another thread inserted the same block in the meantime
+
+        if (cacheBlocks.size() == cacheCapacity) {
+            cacheMap.erase(cacheBlocks.back().first);
+            cacheBlocks.pop_back();
+        }
+        cacheBlocks.emplace_front(index, std::move(block));
+        cacheMap.emplace(index, cacheBlocks.begin());
+    }
+
+    void NczBodyBacking::DecompressSolid(size_t end) {
+        std::lock_guard guard(solidMutex);
+        auto stream{static_cast<ZSTD_DStream *>(solidStream)};
+        while (solidEnd < end) {
+            if (solidInputPosition == solidInput.size()) {
+                if (solidInputOffset >= backing->size)
+                    throw exception("NCZ body ended prematurely: 0x{:X}/0x{:X}", solidEnd.load(), size);
+                solidInput.resize(std::min(ZSTD_DStreamInSize(), backing->size - solidInputOffset));
+                backing->Read(solidInput, solidInputOffset);
+                solidInputOffset += solidInput.size();
+                solidInputPosition = 0;
+            }
+
+            ZSTD_inBuffer input{solidInput.data(), solidInput.size(), solidInputPosition};
+            ZSTD_outBuffer output{solidData + solidEnd, std::min(SolidChunkSize, size - solidEnd), 0};
+            auto result{ZSTD_decompressStream(stream, &output, &input)};
+            if (ZSTD_isError(result))
+                throw exception("Failed to decompress NCZ body: {}", ZSTD_getErrorName(result));
+
+            solidInputPosition = input.pos;
+            solidEnd += output.pos;
+        }
+    }
+
+    size_t NczBodyBacking::Read(span<u8> output, size_t offset) {
+        if (offset >= size || output.empty())
+            return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        if (!blockSize) {
+            if (solidEnd < offset + output.size())
+                DecompressSolid(offset + output.size());
+            std::memcpy(output.data(), solidData + offset, output.size());
+            return output.size();
+        }
+
+        size_t firstBlock{offset / blockSize}, lastBlock{(offset + output.size() - 1) / blockSize};
+        std::vector<CacheBlock> blocks(lastBlock - firstBlock + 1);
+        std::vector<size_t> missing;
+        for (size_t index{firstBlock}; index <= lastBlock; index++)
+            if (!(blocks[index - firstBlock] = FindCacheBlock(index)))
+                missing.push_back(index);
+
+        // Blocks are independent of each other, so reads spanning several uncached blocks decompress them concurrently
+        auto decompress{[&](size_t missingIndex) {
+            auto index{missing[missingIndex]};
+            auto block{DecompressBlock(index)};
+            InsertCacheBlock(index, block);
+            blocks[index - firstBlock] = std::move(block);
+        }};
+        if (missing.size() > 1 && threadPool)
+            threadPool->ParallelFor(missing.size(), decompress);
+        else
+            for (size_t index{}; index < missing.size(); index++)
+                decompress(index);
+
+        size_t read{};
+        while (read < output.size()) {
+            size_t position{offset + read};
+            auto &block{blocks[(position / blockSize) - firstBlock]};
+            size_t blockOffset{position % blockSize};
+            size_t length{std::min(block->size() - blockOffset, output.size() - read)};
+            std::memcpy(output.data() + read, block->data() + blockOffset, length);
+            read += length;
+        }
+        return read;
+    }
+
+    NczBacking::NczBacking(const std::shared_ptr<Backing> &backing, std::shared_ptr<ThreadPool> threadPool) : Backing({true, false, false}), backing(backing) {
+        struct NczSectionHeader {
+            u64 magic; //!< "NCZSECTN"
+            u64 sectionCount;
+        } sectionHeader{backing->Read<NczSectionHeader>(HeaderSize)};
+        if (sectionHeader.magic != util::MakeMagic<u64>("NCZSECTN"))
+            throw exception("Invalid NCZ section magic: 0x{:X}", sectionHeader.magic);
+        if (sectionHeader.sectionCount > 0x10)
+            throw exception("Too many NCZ sections: {}", sectionHeader.sectionCount);
+
+        sections.resize(sectionHeader.sectionCount);
+        size_t bodyOffset{HeaderSize + sizeof(NczSectionHeader)};
+        backing->Read(span(sections).cast<u8>(), bodyOffset);
+        bodyOffset += sections.size() * sizeof(NczSection);
+
+        // The sections cover the entire NCA after its header, so the end of the last one is the size of the NCA unless the body specifies it
+        size_t ncaSize{HeaderSize};
+        for (const auto &section : sections) {
+            ncaSize = std::max<size_t>(ncaSize, section.offset + section.size);
+            if ((section.cryptoType == CryptoType::Ctr || section.cryptoType == CryptoType::Bktr) && section.size) {
+                auto key{section.cryptoKey};
+                ciphers.push_back(std::make_unique<crypto::AesCipher>(key, MBEDTLS_CIPHER_AES_128_CTR));
+            } else {
+                ciphers.push_back(nullptr);
+            }
+        }
+
+        body = std::make_shared<NczBodyBacking>(std::make_shared<RegionBacking>(backing, bodyOffset, backing->size - bodyOffset), ncaSize - HeaderSize, std::move(threadPool));
+        size = HeaderSize + body->size;
+    }
+
+    size_t NczBacking::Read(span<u8> output, size_t offset) {
+        if (offset >= size || output.empty())
+            return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        size_t read{};
+        if (offset < HeaderSize) {
+            read = backing->Read(output.first(std::min(output.size(), HeaderSize - offset)), offset);
+            if (read == output.size())
+                return read;
+        }
+
+        size_t position{offset + read};
+        auto remaining{output.subspan(read)};
+        body->Read(remaining, position - HeaderSize);
+
+        // Sections which were encrypted with AES-CTR are re-encrypted, the keystream is generated from an aligned offset so the start of reads doesn't need to be aligned
+        for (size_t index{}; index < sections.size(); index++) {
+            const auto &section{sections[index]};
+            if (!ciphers[index])
+                continue;
+
+            size_t start{std::max<size_t>(position, section.offset)}, end{std::min<size_t>(position + remaining.size(), section.offset + section.size)};
+            if (start >= end)
+                continue;
+
+            constexpr size_t AesBlockSize{0x10};
+            size_t alignedStart{util::AlignDown(start, AesBlockSize)};
+            std::vector<u8> keystream(util::AlignUp(end, AesBlockSize) - alignedStart);
+
+            auto ctr{section.cryptoCounter};
+            size_t ctrOffset{__builtin_bswap64(alignedStart >> 4)};
+            std::memcpy(ctr.data() + 8, &ctrOffset, 8);
+            {
+                std::lock_guard guard(cipherMutex);
+                ciphers[index]->SetIV(ctr);
+                ciphers[index]->Decrypt(keystream);
+            }
+
+            for (size_t byte{start}; byte < end; byte++)
+                remaining[byte - position] ^= keystream[byte - alignedStart];
+        }
+        return output.size();
+    }
+
+    std::shared_ptr<Backing> NczBacking::GetDecryptedSection(size_t offset, size_t size) {
+        for (const auto &section : sections)
+            if (section.cryptoType == CryptoType::Ctr && offset >= HeaderSize && offset >= section.offset && offset + size <= section.offset + section.size)
+                return std::make_shared<RegionBacking>(body, offset - HeaderSize, size);
+        return nullptr;
+    }
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <list>
+#include <crypto/aes_cipher.h>
+#include <crypto/key_store.h>
+#include "backing.h"
+
+namespace skyline::vfs {
+    /**
+     * @brief A backing for the zstd-compressed body of an NCZ, this is the data of the NCA after its header with all encrypted sections in their decrypted form
+     * @note Block-compressed bodies are decompressed in blocks on demand, solid bodies can only be decompressed sequentially so they're decompressed up to the end of the furthest read
+     */
+    class NczBodyBacking : public Backing {
+      private:
+        static constexpr size_t CacheSize{0x2000000}; //!< The maximum size of all cached decompressed blocks in bytes
+        static constexpr size_t SolidChunkSize{0x100000}; //!< The amount of bytes that a solid body is decompressed in at once
+
+        using CacheBlock = std::shared_ptr<const std::vector<u8>>;
+
+        std::shared_ptr<Backing> backing; //!< The backing of the compressed data
+        std::shared_ptr<ThreadPool> threadPool; //!< The pool that reads spanning several blocks are decompressed on, they're decompressed serially if this is nullptr
+
+        size_t blockSize{}; //!< The size of a decompressed block, this is 0 for solid bodies
+        std::vector<u64> blockOffsets; //!< The offset of the compressed data of every block followed by the size of all compressed data
+
+        std::mutex cacheMutex; //!< Synchronizes access to the cache
+        size_t cacheCapacity{}; //!< The maximum amount of blocks in the cache
+        std::list<std::pair<size_t, CacheBlock>> cacheBlocks; //!< The index and data of every cached block ordered from the most to the least recently used
+        std::unordered_map<size_t, std::list<std::pair<size_t, CacheBlock>>::iterator> cacheMap;
+
+        std::mutex solidMutex; //!< Synchronizes decompressing a solid body
+        void *solidStream{}; //!< The ZSTD_DStream which a solid body is decompressed with
+        u8 *solidData{}; //!< A mapping of the entire decompressed body which is filled up to solidEnd
+        std::atomic<size_t> solidEnd{}; //!< The amount of bytes of a solid body that have been decompressed
+        size_t solidInputOffset{}; //!< The offset of the next compressed byte of a solid body that isn't in solidInput
+        std::vector<u8> solidInput; //!< The compressed data which is being decompressed
+        size_t solidInputPosition{}; //!< The amount of bytes of solidInput that have been consumed
+
+        /**
+         * @brief Decompresses a block into a new buffer
+         */
+        CacheBlock DecompressBlock(size_t index);
+
+        /**
+         * @return A cached block or nullptr if it isn't in the cache
+         */
+        CacheBlock FindCacheBlock(size_t index);
+
+        /**
+         * @brief Inserts a block into the cache, evicting the least recently used one if it's full
+         */
+        void InsertCacheBlock(size_t index, CacheBlock block);
+
+        /**
+         * @brief Decompresses a solid body up to the supplied offset
+         */
+        void DecompressSolid(size_t end);
+
+      public:
+        /**
+         * @param backing The compressed data which starts with the NCZBLOCK header for block-compressed bodies or the zstd frame for solid bodies
+         * @param size The size of the decompressed body
+         */
+        NczBodyBacking(std::shared_ptr<Backing> backing, size_t size, std::shared_ptr<ThreadPool> threadPool);
+
+        ~NczBodyBacking();
+
+        size_t Read(span<u8> output, size_t offset = 0) override;
+    };
+
+    /**
+     * @brief The NczBacking class provides the raw NCA contained in an NCZ, which is an NCA with its encrypted sections decrypted and compressed with zstd
+     * @note Sections are re-encrypted only when the raw NCA is read, the NCA class reads AES-CTR sections from the decrypted body directly instead
+     * @url https://github.com/nicoboss/nsz#ncz
+     */
+    class NczBacking : public Backing {
+      private:
+        static constexpr size_t HeaderSize{0x4000}; //!< The size of the NCA header and the section headers which precede the compressed body uncompressed
+
+        enum class CryptoType : u64 {
+            None = 1,
+            Xts = 2,
+            Ctr = 3,
+            Bktr = 4,
+        };
+
+        /**
+         * @brief A range of the NCA which has been decrypted prior to compression and the key that it's re-encrypted with
+         */
+        struct NczSection {
+            u64 offset;
+            u64 size;
+            CryptoType cryptoType;
+            u64 _pad_;
+            crypto::KeyStore::Key128 cryptoKey;
+            crypto::KeyStore::Key128 cryptoCounter; //!< The AES-CTR counter of the section with the offset set to 0
+        };
+        static_assert(sizeof(NczSection) == 0x40);
+
+        std::shared_ptr<Backing> backing;
+        std::shared_ptr<NczBodyBacking> body;
+        std::vector<NczSection> sections;
+        std::vector<std::unique_ptr<crypto::AesCipher>> ciphers; //!< The ciphers for re-encrypting every section, these are nullptr for sections which aren't encrypted with AES-CTR
+        std::mutex cipherMutex; //!< Synchronizes access to the ciphers as reads can happen concurrently
+
+      public:
+        /**
+         * @param threadPool The pool that blocks are decompressed on, this may be nullptr
+         */
+        NczBacking(const std::shared_ptr<Backing> &backing, std::shared_ptr<ThreadPool> threadPool = nullptr);
+
+        size_t Read(span<u8> output, size_t offset = 0) override;
+
+        /**
+         * @return A backing with the decrypted contents of an AES-CTR section of the NCA or nullptr if the region isn't entirely in one
+         * @param offset The offset of the section in the NCA
+         */
+        std::shared_ptr<Backing> GetDecryptedSection(size_t offset, size_t size);
+    };
+}
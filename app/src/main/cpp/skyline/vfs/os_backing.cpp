@@ -4,18 +4,94 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <condition_variable>
+#include <thread>
 #include "os_backing.h"
 
 namespace skyline::vfs {
-    OsBacking::OsBacking(int fd, bool closable, Mode mode) : Backing(mode), fd(fd), closable(closable) {
+    /**
+     * @brief A thread which writes out the write-back buffers of all backings once every WriteBufferTimeout, so buffered data doesn't stay held back after the guest stops writing
+     */
+    class WriteBackThread {
+      private:
+        std::mutex mutex; //!< Synchronizes access to all members
+        std::condition_variable condition; //!< Wakes the thread up early when it's being stopped
+        std::vector<std::weak_ptr<OsBacking>> backings; //!< All backings which have buffered writes since the last pass, a backing can be in here multiple times
+        bool stop{};
+        std::thread thread;
+
+        void Run(std::chrono::steady_clock::duration interval) {
+            pthread_setname_np(pthread_self(), "Sky-WriteBack");
+
+            std::unique_lock lock(mutex);
+            while (!stop) {
+                condition.wait_for(lock, interval, [this] { return stop; });
+
+                auto pending{std::move(backings)};
+                backings.clear();
+                lock.unlock();
+
+                for (auto &weakBacking : pending) {
+                    if (auto backing{weakBacking.lock()}) {
+                        try {
+                            backing->WriteBack();
+                        } catch (const std::exception &e) {
+                            // The guest observes the failure on its next write instead as that writes out the buffer again
+                        }
+                    }
+                }
+
+                lock.lock();
+            }
+        }
+
+      public:
+        explicit WriteBackThread(std::chrono::steady_clock::duration interval) : thread(&WriteBackThread::Run, this, interval) {}
+
+        ~WriteBackThread() {
+            {
+                std::lock_guard guard(mutex);
+                stop = true;
+            }
+            condition.notify_all();
+            thread.join();
+        }
+
+        /**
+         * @brief Registers a backing which has just started buffering writes, it's written out on the next pass
+         */
+        void Register(std::weak_ptr<OsBacking> backing) {
+            std::lock_guard guard(mutex);
+            backings.emplace_back(std::move(backing));
+        }
+    };
+
+    OsBacking::OsBacking(int fd, bool closable, Mode mode, bool map) : Backing(mode), fd(fd), closable(closable) {
         struct stat fileInfo;
         if (fstat(fd, &fileInfo))
             throw exception("Failed to stat fd: {}", strerror(errno));
 
         size = fileInfo.st_size;
+
+        if (map && mode.read && !mode.write && !mode.append && size) {
+            // The mapping is only an optimization, so files which can't be mapped such as pipes are read with pread instead
+            auto pointer{mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+            if (pointer != MAP_FAILED)
+                mapping = static_cast<u8 *>(pointer);
+        }
     }
 
     OsBacking::~OsBacking() {
+        try {
+            std::lock_guard guard(writeMutex);
+            FlushWriteBuffer();
+        } catch (const std::exception &e) {
+            // An exception can't be thrown out of the destructor, the guest has no way to observe the failure at this point either
+        }
+
+        if (mapping)
+            munmap(mapping, size);
         if (closable)
             close(fd);
     }
@@ -24,6 +100,20 @@ namespace skyline::vfs {
         if (!mode.read)
             throw exception("Attempting to read a backing that is not readable");
 
+        if (mapping) {
+            if (offset >= size)
+                return 0;
+            size_t readSize{std::min(output.size(), size - offset)};
+            std::memcpy(output.data(), mapping + offset, readSize);
+            return readSize;
+        }
+
+        {
+            // Buffered writes are written out first so reads always observe them, files that are written to are rarely read at the same time
+            std::lock_guard guard(writeMutex);
+            FlushWriteBuffer();
+        }
+
         auto ret{pread64(fd, output.data(), output.size(), offset)};
         if (ret < 0)
             throw exception("Failed to read from fd: {}", strerror(errno));
@@ -31,18 +121,105 @@ namespace skyline::vfs {
         return static_cast<size_t>(ret);
     }
 
+    void OsBacking::Prefetch(size_t offset, size_t size) {
+        if (offset >= this->size)
+            return;
+        size = std::min(size, this->size - offset);
+
+        if (mapping) {
+            // The pages are touched rather than only being advised, so the read of the region is complete once this returns
+            auto alignedOffset{util::AlignDown(offset, PAGE_SIZE)};
+            madvise(mapping + alignedOffset, (offset + size) - alignedOffset, MADV_WILLNEED);
+            volatile u8 sink{};
+            for (size_t page{alignedOffset}; page < offset + size; page += PAGE_SIZE)
+                sink = mapping[page];
+        } else {
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+        }
+    }
+
+    span<u8> OsBacking::Map(size_t offset, size_t size) {
+        if (!mapping || offset > this->size || this->size - offset < size)
+            return {};
+
+        // The region is expected to be read in its entirety soon after it's mapped, so the kernel is asked to read it ahead rather than fault it in page by page
+        auto alignedOffset{util::AlignDown(offset, PAGE_SIZE)};
+        madvise(mapping + alignedOffset, (offset + size) - alignedOffset, MADV_WILLNEED);
+        return span(mapping + offset, size);
+    }
+
+    void OsBacking::FlushWriteBuffer() {
+        size_t written{};
+        while (written < writeBuffer.size()) {
+            auto ret{pwrite64(fd, writeBuffer.data() + written, writeBuffer.size() - written, writeBufferOffset + written)};
+            if (ret < 0)
+                throw exception("Failed to write to fd: {}", strerror(errno));
+            written += static_cast<size_t>(ret);
+        }
+        writeBuffer.clear();
+    }
+
     size_t OsBacking::Write(span<u8> input, size_t offset) {
         if (!mode.write)
             throw exception("Attempting to write to a backing that is not writable");
 
-        auto ret{pwrite64(fd, input.data(), input.size(), offset)};
-        if (ret < 0)
-            throw exception("Failed to write to fd: {}", strerror(errno));
+        std::lock_guard guard(writeMutex);
 
-        return static_cast<size_t>(ret);
+        // A write is coalesced into the buffer if it overlaps or directly follows it, any other write requires the buffer to be written out first to retain the order of writes
+        bool coalesce{!writeBuffer.empty() && offset >= writeBufferOffset && offset <= writeBufferOffset + writeBuffer.size()};
+        if (!coalesce || std::chrono::steady_clock::now() - writeBufferTime > WriteBufferTimeout)
+            FlushWriteBuffer();
+
+        if (input.size() >= WriteBufferSize) {
+            FlushWriteBuffer();
+            auto ret{pwrite64(fd, input.data(), input.size(), offset)};
+            if (ret < 0)
+                throw exception("Failed to write to fd: {}", strerror(errno));
+            size = std::max(size, offset + static_cast<size_t>(ret));
+            return static_cast<size_t>(ret);
+        }
+
+        if (writeBuffer.empty()) {
+            writeBufferOffset = offset;
+            writeBufferTime = std::chrono::steady_clock::now();
+
+            // Backings that aren't owned by a shared pointer can't be written out asynchronously, they're only written out by further writes or on destruction
+            static WriteBackThread writeBackThread{WriteBufferTimeout};
+            if (auto weakThis{weak_from_this()}; !weakThis.expired())
+                writeBackThread.Register(std::move(weakThis));
+        }
+
+        size_t bufferOffset{offset - writeBufferOffset};
+        if (writeBuffer.size() < bufferOffset + input.size())
+            writeBuffer.resize(bufferOffset + input.size());
+        std::memcpy(writeBuffer.data() + bufferOffset, input.data(), input.size());
+        size = std::max(size, offset + input.size());
+
+        if (writeBuffer.size() >= WriteBufferSize)
+            FlushWriteBuffer();
+
+        return input.size();
+    }
+
+    void OsBacking::Flush() {
+        std::lock_guard guard(writeMutex);
+        FlushWriteBuffer();
+
+        if (mode.write && fdatasync(fd) < 0)
+            throw exception("Failed to sync fd: {}", strerror(errno));
+    }
+
+    void OsBacking::WriteBack() {
+        std::lock_guard guard(writeMutex);
+        FlushWriteBuffer();
     }
 
     void OsBacking::Resize(size_t size) {
+        {
+            std::lock_guard guard(writeMutex);
+            FlushWriteBuffer();
+        }
+
         int ret{ftruncate(fd, size)};
         if (ret < 0)
             throw exception("Failed to resize file: {}", strerror(errno));
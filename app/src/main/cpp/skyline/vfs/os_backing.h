@@ -3,29 +3,62 @@
 
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include "backing.h"
 
 namespace skyline::vfs {
     /**
      * @brief The OsBacking class provides the backing abstractions for a physical linux file
+     * @note Read-only files can be mapped into memory, so reads don't need a syscall and regions can be mapped without any copies
+     * @note Writes are coalesced into a write-back buffer while they're adjacent to each other, as guests commonly write files in many small chunks
+     * @note Buffered writes are only visible to other backings of the same file once the buffer is written out, this happens on Flush, WriteBack or destruction and at most about WriteBufferTimeout after the buffer was filled
      */
-    class OsBacking : public Backing {
+    class OsBacking : public Backing, public std::enable_shared_from_this<OsBacking> {
       private:
         int fd; //!< An FD to the backing
         bool closable; //!< Whether the FD can be closed when the backing is destroyed
+        u8 *mapping{}; //!< A read-only mapping of the entire file, this is nullptr if mapping wasn't requested or failed
+
+        static constexpr size_t WriteBufferSize{0x100000}; //!< The size after which the write-back buffer is written out to the file
+        static constexpr std::chrono::seconds WriteBufferTimeout{1}; //!< The maximum amount of time the data in the write-back buffer is held back from the file for
+
+        std::mutex writeMutex; //!< Synchronizes access to the write-back buffer
+        std::vector<u8> writeBuffer; //!< The data of all buffered writes, this is a contiguous region of the file
+        size_t writeBufferOffset{}; //!< The offset in the file that the write-back buffer starts at
+        std::chrono::steady_clock::time_point writeBufferTime; //!< The time at which the first write in the write-back buffer was buffered
+
+        /**
+         * @brief Writes all data in the write-back buffer out to the file
+         * @note writeMutex must be locked when calling this
+         */
+        void FlushWriteBuffer();
 
       public:
         /**
          * @param fd The file descriptor of the backing
+         * @param map If the file should be mapped into memory, this is ignored unless the backing is read-only
+         * @note Only files which aren't resized while the backing exists such as the ROM can be mapped, a read beyond the end of a truncated file would fault and the mapping doesn't observe the file growing
          */
-        OsBacking(int fd, bool closable = false, Mode = {true, false, false});
+        OsBacking(int fd, bool closable = false, Mode = {true, false, false}, bool map = false);
 
         ~OsBacking();
 
         size_t Read(span<u8> output, size_t offset = 0);
 
+        void Prefetch(size_t offset, size_t size);
+
+        span<u8> Map(size_t offset, size_t size);
+
         size_t Write(span<u8> input, size_t offset = 0);
 
+        void Flush();
+
+        /**
+         * @brief Writes the write-back buffer out to the file without syncing it to storage, so it's visible to any other backing of the file
+         */
+        void WriteBack();
+
         void Resize(size_t size);
     };
 }
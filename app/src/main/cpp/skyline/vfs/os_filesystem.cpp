@@ -63,11 +63,37 @@ namespace skyline::vfs {
         if (!(mode.read || mode.write))
             throw exception("Cannot open a file that is neither readable or writable");
 
+        std::lock_guard guard(writableFilesMutex);
+        auto &writers{writableFiles[path]};
+        std::erase_if(writers, [](const std::weak_ptr<OsBacking> &writer) { return writer.expired(); });
+        for (auto &weakWriter : writers)
+            if (auto writer{weakWriter.lock()})
+                writer->WriteBack();
+
         int fd{open((basePath + path).c_str(), (mode.read && mode.write) ? O_RDWR : (mode.write ? O_WRONLY : O_RDONLY))};
         if (fd < 0)
             throw exception("Failed to open file: {}", strerror(errno));
 
-        return std::make_shared<OsBacking>(fd, true, mode);
+        auto backing{std::make_shared<OsBacking>(fd, true, mode)};
+        if (mode.write)
+            writers.emplace_back(backing);
+        return backing;
+    }
+
+    void OsFileSystem::Commit() {
+        std::lock_guard guard(writableFilesMutex);
+        for (auto file{writableFiles.begin()}; file != writableFiles.end();) {
+            auto &writers{file->second};
+            std::erase_if(writers, [](const std::weak_ptr<OsBacking> &writer) { return writer.expired(); });
+            for (auto &weakWriter : writers)
+                if (auto writer{weakWriter.lock()})
+                    writer->Flush();
+
+            if (writers.empty())
+                file = writableFiles.erase(file);
+            else
+                file++;
+        }
     }
 
     std::optional<Directory::EntryType> OsFileSystem::GetEntryType(const std::string &path) {
@@ -84,4 +110,45 @@ namespace skyline::vfs {
 
         return std::nullopt;
     }
+
+    std::shared_ptr<Directory> OsFileSystem::OpenDirectory(const std::string &path, Directory::ListMode listMode) {
+        auto fullPath{basePath + path};
+        struct stat status;
+        if (stat(fullPath.c_str(), &status) || !S_ISDIR(status.st_mode))
+            return nullptr;
+
+        return std::make_shared<OsFileSystemDirectory>(fullPath, listMode);
+    }
+
+    OsFileSystemDirectory::OsFileSystemDirectory(std::string path, ListMode listMode) : Directory(listMode), path(std::move(path)) {}
+
+    std::vector<Directory::Entry> OsFileSystemDirectory::Read() {
+        std::vector<Entry> contents;
+
+        auto directory{opendir(path.c_str())};
+        if (!directory)
+            throw exception("Failed to open directory: {}", strerror(errno));
+
+        int directoryFd{dirfd(directory)};
+        while (auto entry{readdir(directory)}) {
+            std::string_view name{entry->d_name};
+            if (name == "." || name == "..")
+                continue;
+
+            // The type is usually known from the directory entry itself, so only files that are listed (for their size) and links or unknown entries need to be stat-ed
+            struct stat status{};
+            bool needsStat{entry->d_type != DT_DIR && (entry->d_type != DT_REG || listMode.file)};
+            if (needsStat && fstatat(directoryFd, entry->d_name, &status, 0))
+                continue; // The entry was removed while the directory was being read
+            bool isDirectory{entry->d_type == DT_DIR || (needsStat && S_ISDIR(status.st_mode))};
+
+            if (isDirectory && listMode.directory)
+                contents.emplace_back(Entry{std::string(name), EntryType::Directory});
+            else if (!isDirectory && listMode.file)
+                contents.emplace_back(Entry{std::string(name), EntryType::File, static_cast<size_t>(status.st_size)});
+        }
+
+        closedir(directory);
+        return contents;
+    }
 }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "filesystem.h"
+#include "os_backing.h"
 
 namespace skyline::vfs {
     /**
@@ -12,6 +13,8 @@ namespace skyline::vfs {
     class OsFileSystem : public FileSystem {
       private:
         std::string basePath; //!< The base path for filesystem operations
+        std::mutex writableFilesMutex; //!< Synchronizes access to writableFiles
+        std::unordered_map<std::string, std::vector<std::weak_ptr<OsBacking>>> writableFiles; //!< The backings of all files which have been opened for writing keyed by their path, so their buffered writes can be written out when the file is opened again or the filesystem is committed
 
       public:
         OsFileSystem(const std::string &basePath);
@@ -20,8 +23,28 @@ namespace skyline::vfs {
 
         bool CreateDirectory(const std::string &path, bool parents);
 
+        /**
+         * @note Writes buffered by other backings of the file are written out first, so the file is opened with all prior writes to it
+         */
         std::shared_ptr<Backing> OpenFile(const std::string &path, Backing::Mode mode = {true, false, false});
 
+        void Commit();
+
         std::optional<Directory::EntryType> GetEntryType(const std::string &path);
+
+        std::shared_ptr<Directory> OpenDirectory(const std::string &path, Directory::ListMode listMode);
+    };
+
+    /**
+     * @brief The OsFileSystemDirectory provides access to a directory within an OsFileSystem
+     */
+    class OsFileSystemDirectory : public Directory {
+      private:
+        std::string path; //!< The full path to the directory on the host
+
+      public:
+        OsFileSystemDirectory(std::string path, ListMode listMode);
+
+        std::vector<Entry> Read();
     };
 }
@@ -29,5 +29,16 @@ namespace skyline::vfs {
                 throw exception("Trying to read past the end of a region backing: 0x{:X}/0x{:X} (Offset: 0x{:X})", output.size(), size, offset);
             return backing->Read(output, baseOffset + offset);
         }
+
+        virtual void Prefetch(size_t offset, size_t size) {
+            if (offset < this->size)
+                backing->Prefetch(baseOffset + offset, std::min(size, this->size - offset));
+        }
+
+        virtual span<u8> Map(size_t offset, size_t size) {
+            if (this->size < offset || this->size - offset < size)
+                throw exception("Trying to map past the end of a region backing: 0x{:X}/0x{:X} (Offset: 0x{:X})", size, this->size, offset);
+            return backing->Map(baseOffset + offset, size);
+        }
     };
 }
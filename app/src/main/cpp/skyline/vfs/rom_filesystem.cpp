@@ -7,115 +7,171 @@
 namespace skyline::vfs {
     RomFileSystem::RomFileSystem(std::shared_ptr<Backing> backing) : FileSystem(), backing(backing) {
         header = backing->Read<RomFsHeader>();
-        TraverseDirectory(0, "");
+
+        // Only the metadata is read upfront, it's a small fraction of the image even for titles with a large amount of files
+        directoryHashTable.resize(header.dirHashTableSize / sizeof(u32));
+        backing->Read(span(directoryHashTable).cast<u8>(), header.dirHashTableOffset);
+        fileHashTable.resize(header.fileHashTableSize / sizeof(u32));
+        backing->Read(span(fileHashTable).cast<u8>(), header.fileHashTableOffset);
+
+        directoryMetaTable.resize(header.dirMetaTableSize);
+        backing->Read(directoryMetaTable, header.dirMetaTableOffset);
+        fileMetaTable.resize(header.fileMetaTableSize);
+        backing->Read(fileMetaTable, header.fileMetaTableOffset);
     }
 
-    void RomFileSystem::TraverseFiles(u32 offset, const std::string &path) {
-        RomFsFileEntry entry;
-        do {
-            entry = backing->Read<RomFsFileEntry>(header.fileMetaTableOffset + offset);
+    u32 RomFileSystem::HashEntry(u32 parentOffset, std::string_view name) {
+        u32 hash{parentOffset ^ 123456789};
+        for (auto character : name) {
+            hash = (hash >> 5) | (hash << 27);
+            hash ^= static_cast<u8>(character);
+        }
+        return hash;
+    }
 
-            if (entry.nameSize) {
-                std::vector<char> name(entry.nameSize);
-                backing->Read(span(name).cast<u8>(), header.fileMetaTableOffset + offset + sizeof(RomFsFileEntry));
+    template<typename EntryType>
+    u32 RomFileSystem::FindEntry(span<const u32> hashTable, span<const u8> metaTable, u32 parentOffset, std::string_view name) {
+        if (hashTable.empty())
+            return constant::RomFsEmptyEntry;
 
-                std::string fullPath{path + (path.empty() ? "" : "/") + std::string(name.data(), entry.nameSize)};
-                fileMap.emplace(fullPath, entry);
-            }
+        u32 offset{hashTable[HashEntry(parentOffset, name) % hashTable.size()]};
+        while (offset != constant::RomFsEmptyEntry) {
+            if (offset > metaTable.size() || metaTable.size() - offset < sizeof(EntryType))
+                throw exception("RomFS entry is out of bounds: 0x{:X} (Table Size: 0x{:X})", offset, metaTable.size());
 
-            offset = entry.siblingOffset;
-        } while (offset != constant::RomFsEmptyEntry);
+            EntryType entry;
+            std::memcpy(&entry, metaTable.data() + offset, sizeof(EntryType));
+
+            if (entry.parentOffset == parentOffset && entry.nameSize == name.size() && metaTable.size() - offset - sizeof(EntryType) >= entry.nameSize
+                && std::string_view(reinterpret_cast<const char *>(metaTable.data() + offset + sizeof(EntryType)), entry.nameSize) == name)
+                return offset;
+
+            offset = entry.hashSiblingOffset;
+        }
+
+        return constant::RomFsEmptyEntry;
     }
 
-    void RomFileSystem::TraverseDirectory(u32 offset, const std::string &path) {
-        auto entry{backing->Read<RomFsDirectoryEntry>(header.dirMetaTableOffset + offset)};
+    u32 RomFileSystem::FindParentDirectory(std::string_view path, std::string_view &name) {
+        u32 directory{}; // The root directory is always the first entry in the directory metadata table
+        while (true) {
+            auto separator{path.find('/')};
+            if (separator == std::string_view::npos) {
+                name = path;
+                return directory;
+            }
+
+            auto component{path.substr(0, separator)};
+            path.remove_prefix(separator + 1);
+            if (component.empty())
+                continue; // Leading or repeated separators don't change the directory
 
-        std::string childPath{path};
-        if (entry.nameSize) {
-            std::vector<char> name(entry.nameSize);
-            backing->Read(span(name).cast<u8>(), header.dirMetaTableOffset + offset + sizeof(RomFsDirectoryEntry));
-            childPath = path + (path.empty() ? "" : "/") + std::string(name.data(), entry.nameSize);
+            directory = FindEntry<RomFsDirectoryEntry>(directoryHashTable, directoryMetaTable, directory, component);
+            if (directory == constant::RomFsEmptyEntry)
+                return directory;
         }
+    }
 
-        directoryMap.emplace(childPath, entry);
+    std::optional<RomFileSystem::RomFsFileEntry> RomFileSystem::FindFile(std::string_view path) {
+        std::string_view name;
+        auto parent{FindParentDirectory(path, name)};
+        if (parent == constant::RomFsEmptyEntry || name.empty())
+            return std::nullopt;
 
-        if (entry.fileOffset != constant::RomFsEmptyEntry)
-            TraverseFiles(entry.fileOffset, childPath);
+        auto offset{FindEntry<RomFsFileEntry>(fileHashTable, fileMetaTable, parent, name)};
+        if (offset == constant::RomFsEmptyEntry)
+            return std::nullopt;
 
-        if (entry.childOffset != constant::RomFsEmptyEntry)
-            TraverseDirectory(entry.childOffset, childPath);
+        RomFsFileEntry entry;
+        std::memcpy(&entry, fileMetaTable.data() + offset, sizeof(RomFsFileEntry));
+        return entry;
+    }
+
+    std::optional<RomFileSystem::RomFsDirectoryEntry> RomFileSystem::FindDirectory(std::string_view path) {
+        std::string_view name;
+        auto offset{FindParentDirectory(path, name)};
+        if (offset != constant::RomFsEmptyEntry && !name.empty())
+            offset = FindEntry<RomFsDirectoryEntry>(directoryHashTable, directoryMetaTable, offset, name);
 
-        if (entry.siblingOffset != constant::RomFsEmptyEntry)
-            TraverseDirectory(entry.siblingOffset, path);
+        if (offset == constant::RomFsEmptyEntry || directoryMetaTable.size() < offset + sizeof(RomFsDirectoryEntry))
+            return std::nullopt;
+
+        RomFsDirectoryEntry entry;
+        std::memcpy(&entry, directoryMetaTable.data() + offset, sizeof(RomFsDirectoryEntry));
+        return entry;
     }
 
     std::shared_ptr<Backing> RomFileSystem::OpenFile(const std::string &path, Backing::Mode mode) {
-        try {
-            const auto &entry{fileMap.at(path)};
-            return std::make_shared<RegionBacking>(backing, header.dataOffset + entry.offset, entry.size, mode);
-        } catch (std::out_of_range &e) {
+        auto entry{FindFile(path)};
+        if (!entry)
             return nullptr;
-        }
+        return std::make_shared<RegionBacking>(backing, header.dataOffset + entry->offset, entry->size, mode);
     }
 
     std::optional<Directory::EntryType> RomFileSystem::GetEntryType(const std::string &path) {
-        if (fileMap.count(path))
+        if (FindFile(path))
             return Directory::EntryType::File;
-        else if (directoryMap.count(path))
+        else if (FindDirectory(path))
             return Directory::EntryType::Directory;
 
         return std::nullopt;
     }
 
-    std::shared_ptr<Directory> RomFileSystem::OpenDirectory(const std::string &path, Directory::ListMode listMode) {
-        try {
-            auto &entry{directoryMap.at(path)};
-            return std::make_shared<RomFileSystemDirectory>(backing, header, entry, listMode);
-        } catch (std::out_of_range &e) {
-            return nullptr;
-        }
-    }
+    std::shared_ptr<const RomFileSystem::Listing> RomFileSystem::GetListing(const RomFsDirectoryEntry &directory) {
+        u64 key{(static_cast<u64>(directory.childOffset) << 32) | directory.fileOffset};
+        std::lock_guard guard(listingMutex);
+        auto &cached{listingCache[key]};
+        if (cached)
+            return cached;
 
-    RomFileSystemDirectory::RomFileSystemDirectory(const std::shared_ptr<Backing> &backing, const RomFileSystem::RomFsHeader &header, const RomFileSystem::RomFsDirectoryEntry &ownEntry, ListMode listMode) : Directory(listMode), backing(backing), header(header), ownEntry(ownEntry) {}
+        // The listing is built entirely from the metadata tables that are already in memory, the backing is never touched
+        auto listing{std::make_shared<Listing>()};
+        for (u32 offset{directory.fileOffset}; offset != constant::RomFsEmptyEntry;) {
+            if (offset > fileMetaTable.size() || fileMetaTable.size() - offset < sizeof(RomFsFileEntry))
+                throw exception("RomFS file entry is out of bounds: 0x{:X} (Table Size: 0x{:X})", offset, fileMetaTable.size());
 
-    std::vector<RomFileSystemDirectory::Entry> RomFileSystemDirectory::Read() {
-        std::vector<Entry> contents;
-
-        if (listMode.file) {
-            RomFileSystem::RomFsFileEntry romFsFileEntry;
-            u32 offset{ownEntry.fileOffset};
+            RomFsFileEntry entry;
+            std::memcpy(&entry, fileMetaTable.data() + offset, sizeof(RomFsFileEntry));
+            if (entry.nameSize && fileMetaTable.size() - offset - sizeof(RomFsFileEntry) >= entry.nameSize)
+                listing->files.emplace_back(Directory::Entry{std::string(reinterpret_cast<const char *>(fileMetaTable.data() + offset + sizeof(RomFsFileEntry)), entry.nameSize), Directory::EntryType::File, entry.size});
 
-            do {
-                romFsFileEntry = backing->Read<RomFileSystem::RomFsFileEntry>(header.fileMetaTableOffset + offset);
+            offset = entry.siblingOffset;
+        }
 
-                if (romFsFileEntry.nameSize) {
-                    std::vector<char> name(romFsFileEntry.nameSize);
-                    backing->Read(span(name).cast<u8>(), header.fileMetaTableOffset + offset + sizeof(RomFileSystem::RomFsFileEntry));
+        for (u32 offset{directory.childOffset}; offset != constant::RomFsEmptyEntry;) {
+            if (offset > directoryMetaTable.size() || directoryMetaTable.size() - offset < sizeof(RomFsDirectoryEntry))
+                throw exception("RomFS directory entry is out of bounds: 0x{:X} (Table Size: 0x{:X})", offset, directoryMetaTable.size());
 
-                    contents.emplace_back(Entry{std::string(name.data(), romFsFileEntry.nameSize), EntryType::File});
-                }
+            RomFsDirectoryEntry entry;
+            std::memcpy(&entry, directoryMetaTable.data() + offset, sizeof(RomFsDirectoryEntry));
+            if (entry.nameSize && directoryMetaTable.size() - offset - sizeof(RomFsDirectoryEntry) >= entry.nameSize)
+                listing->directories.emplace_back(Directory::Entry{std::string(reinterpret_cast<const char *>(directoryMetaTable.data() + offset + sizeof(RomFsDirectoryEntry)), entry.nameSize), Directory::EntryType::Directory});
 
-                offset = romFsFileEntry.siblingOffset;
-            } while (offset != constant::RomFsEmptyEntry);
+            offset = entry.siblingOffset;
         }
 
-        if (listMode.directory) {
-            RomFileSystem::RomFsDirectoryEntry romFsDirectoryEntry;
-            u32 offset{ownEntry.childOffset};
+        cached = listing;
+        return cached;
+    }
 
-            do {
-                romFsDirectoryEntry = backing->Read<RomFileSystem::RomFsDirectoryEntry>(header.dirMetaTableOffset + offset);
+    std::shared_ptr<Directory> RomFileSystem::OpenDirectory(const std::string &path, Directory::ListMode listMode) {
+        auto entry{FindDirectory(path)};
+        if (!entry)
+            return nullptr;
+        return std::make_shared<RomFileSystemDirectory>(GetListing(*entry), listMode);
+    }
 
-                if (romFsDirectoryEntry.nameSize) {
-                    std::vector<char> name(romFsDirectoryEntry.nameSize);
-                    backing->Read(span(name).cast<u8>(), header.dirMetaTableOffset + offset + sizeof(RomFileSystem::RomFsDirectoryEntry));
+    RomFileSystemDirectory::RomFileSystemDirectory(std::shared_ptr<const RomFileSystem::Listing> listing, ListMode listMode) : Directory(listMode), listing(std::move(listing)) {}
 
-                    contents.emplace_back(Entry{std::string(name.data(), romFsDirectoryEntry.nameSize), EntryType::Directory});
-                }
+    std::vector<RomFileSystemDirectory::Entry> RomFileSystemDirectory::Read() {
+        std::vector<Entry> contents;
+        contents.reserve((listMode.file ? listing->files.size() : 0) + (listMode.directory ? listing->directories.size() : 0));
 
-                offset = romFsDirectoryEntry.siblingOffset;
-            } while (offset != constant::RomFsEmptyEntry);
-        }
+        if (listMode.file)
+            contents.insert(contents.end(), listing->files.begin(), listing->files.end());
+
+        if (listMode.directory)
+            contents.insert(contents.end(), listing->directories.begin(), listing->directories.end());
 
         return contents;
     }
@@ -13,25 +13,9 @@ namespace skyline {
     namespace vfs {
         /**
          * @brief The RomFileSystem class abstracts access to a RomFS image using the vfs::FileSystem api
+         * @note Paths are resolved using the hash tables of the RomFS itself, so opening an image only requires reading its metadata tables rather than traversing every entry
          */
         class RomFileSystem : public FileSystem {
-          private:
-            std::shared_ptr<Backing> backing;
-
-            /**
-             * @brief Traverses the sibling files of the given file and adds them to the file map
-             * @param offset The offset of the file entry to traverses the siblings of
-             * @param path The path to the parent directory of the supplied file entry
-             */
-            void TraverseFiles(u32 offset, const std::string &path);
-
-            /**
-             * @brief Traverses the directories within the given directory, adds them to the directory map and calls TraverseFiles on them
-             * @param offset The offset of the directory entry to traverses the directories in
-             * @param path The path to the supplied directory entry
-             */
-            void TraverseDirectory(u32 offset, const std::string &path);
-
           public:
             struct RomFsHeader {
                 u64 headerSize; //!< The size of the header
@@ -52,7 +36,7 @@ namespace skyline {
                 u32 siblingOffset; //!< The offset from the directory metadata base of a sibling directory
                 u32 childOffset; //!< The offset from the directory metadata base of a child directory
                 u32 fileOffset; //!< The offset from the file metadata base of a child file
-                u32 hash; //!< The hash of the directory
+                u32 hashSiblingOffset; //!< The offset from the directory metadata base of the next directory in the same hash table bucket
                 u32 nameSize; //!< The size of the directory's name in bytes
             };
 
@@ -61,13 +45,66 @@ namespace skyline {
                 u32 siblingOffset; //!< The offset from the file metadata base of a sibling file
                 u64 offset; //!< The offset from the file data base of the file contents
                 u64 size; //!< The size of the file in bytes
-                u32 hash; //!< The hash of the file
+                u32 hashSiblingOffset; //!< The offset from the file metadata base of the next file in the same hash table bucket
                 u32 nameSize; //!< The size of the file's name in bytes
             };
 
-            std::unordered_map<std::string, RomFsFileEntry> fileMap; //!< A map that maps file names to their corresponding entry
-            std::unordered_map<std::string, RomFsDirectoryEntry> directoryMap; //!< A map that maps directory names to their corresponding entry
+          private:
+            std::shared_ptr<Backing> backing;
+            std::vector<u32> directoryHashTable; //!< The buckets of the directory hash table, each one holds the offset of the first directory entry in it
+            std::vector<u32> fileHashTable; //!< The buckets of the file hash table, each one holds the offset of the first file entry in it
+            std::vector<u8> directoryMetaTable; //!< The directory entries followed by their names
+            std::vector<u8> fileMetaTable; //!< The file entries followed by their names
+
+          public:
+            /**
+             * @brief The contents of a single directory, these are immutable and shared between all instances of the directory
+             */
+            struct Listing {
+                std::vector<Directory::Entry> files;
+                std::vector<Directory::Entry> directories;
+            };
+
+          private:
+            std::mutex listingMutex; //!< Synchronizes access to the listing cache
+            std::unordered_map<u64, std::shared_ptr<const Listing>> listingCache; //!< A cache of directory listings keyed by the offsets of their first child directory and file, an image can't change so they never need to be invalidated
+
+            /**
+             * @brief Calculates the hash of an entry in the RomFS hash tables, it is based on the parent directory and name of the entry
+             */
+            static u32 HashEntry(u32 parentOffset, std::string_view name);
+
+            /**
+             * @brief Looks up an entry in one of the hash tables
+             * @param parentOffset The offset of the directory entry the entry is in
+             * @return The offset of the entry in its metadata table or RomFsEmptyEntry if there's no such entry
+             */
+            template<typename EntryType>
+            static u32 FindEntry(span<const u32> hashTable, span<const u8> metaTable, u32 parentOffset, std::string_view name);
 
+            /**
+             * @brief Resolves all directories in a path except for the last component
+             * @param name This is set to the name of the last component of the path
+             * @return The offset of the directory entry containing the last component or RomFsEmptyEntry if any directory in the path doesn't exist
+             */
+            u32 FindParentDirectory(std::string_view path, std::string_view &name);
+
+            /**
+             * @return The file entry at the supplied path, if it exists
+             */
+            std::optional<RomFsFileEntry> FindFile(std::string_view path);
+
+            /**
+             * @return The directory entry at the supplied path, if it exists
+             */
+            std::optional<RomFsDirectoryEntry> FindDirectory(std::string_view path);
+
+            /**
+             * @return The listing of the supplied directory, it is built from the metadata tables on the first access and cached after that
+             */
+            std::shared_ptr<const Listing> GetListing(const RomFsDirectoryEntry &directory);
+
+          public:
             RomFileSystem(std::shared_ptr<Backing> backing);
 
             std::shared_ptr<Backing> OpenFile(const std::string &path, Backing::Mode mode = {true, false, false});
@@ -82,12 +119,10 @@ namespace skyline {
          */
         class RomFileSystemDirectory : public Directory {
           private:
-            RomFileSystem::RomFsDirectoryEntry ownEntry; //!< This directory's entry in the RomFS header
-            RomFileSystem::RomFsHeader header; //!< A header of this files parent RomFS image
-            std::shared_ptr<Backing> backing;
+            std::shared_ptr<const RomFileSystem::Listing> listing; //!< The cached contents of this directory
 
           public:
-            RomFileSystemDirectory(const std::shared_ptr<Backing> &backing, const RomFileSystem::RomFsHeader &header, const RomFileSystem::RomFsDirectoryEntry &ownEntry, ListMode listMode);
+            RomFileSystemDirectory(std::shared_ptr<const RomFileSystem::Listing> listing, ListMode listMode);
 
             std::vector<Entry> Read();
         };
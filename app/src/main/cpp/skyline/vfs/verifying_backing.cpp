@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#include <crypto/sha256.h>
+#include <thread_pool.h>
+#include "verifying_backing.h"
+
+namespace skyline::vfs {
+    VerifyingBacking::VerifyingBacking(std::shared_ptr<Backing> backing, std::shared_ptr<Backing> hashBacking, size_t blockSize, bool padBlocks, std::shared_ptr<ThreadPool> threadPool) : Backing({true, false, false}, backing->size), backing(std::move(backing)), hashBacking(std::move(hashBacking)), blockSize(blockSize), padBlocks(padBlocks), threadPool(std::move(threadPool)) {
+        if (!blockSize)
+            throw exception("The block size of a verifying backing can't be 0");
+        blockCount = util::AlignUp(size, blockSize) / blockSize;
+        verifiedBlocks = std::make_unique<std::atomic<u64>[]>(util::AlignUp(blockCount, 64) / 64);
+    }
+
+    VerifyingBacking::VerifyingBacking(std::shared_ptr<Backing> backing, std::vector<u8> hashes, size_t blockSize, bool padBlocks, std::shared_ptr<ThreadPool> threadPool) : VerifyingBacking(std::move(backing), std::shared_ptr<Backing>{}, blockSize, padBlocks, std::move(threadPool)) {
+        this->hashes = std::move(hashes);
+    }
+
+    bool VerifyingBacking::VerifyBlock(size_t index, span<u8> data) {
+        Hash expected;
+        if (hashBacking) {
+            if (hashBacking->Read(expected, index * sizeof(Hash)) != sizeof(Hash))
+                return false;
+        } else {
+            if ((index + 1) * sizeof(Hash) > hashes.size())
+                return false;
+            std::memcpy(expected.data(), hashes.data() + index * sizeof(Hash), sizeof(Hash));
+        }
+
+        if (crypto::Sha256(data) != expected)
+            return false;
+
+        verifiedBlocks[index / 64].fetch_or(1ULL << (index % 64), std::memory_order_release);
+        return true;
+    }
+
+    bool VerifyingBacking::ReadBlock(size_t index, span<u8> output, size_t blockOffset) {
+        size_t blockStart{index * blockSize};
+        if (IsVerified(index))
+            return backing->Read(output, blockStart + blockOffset) == output.size();
+
+        // The last block is only hashed over the data in it unless it's padded, in which case the padding has to be hashed too and the block can't be hashed in the output
+        size_t dataSize{std::min(blockSize, size - blockStart)};
+        bool padded{padBlocks && dataSize != blockSize};
+        if (blockOffset == 0 && output.size() == dataSize && !padded) {
+            if (backing->Read(output, blockStart) != dataSize)
+                return false;
+            return VerifyBlock(index, output);
+        }
+
+        std::vector<u8> block(padded ? blockSize : dataSize);
+        if (backing->Read(span(block).first(dataSize), blockStart) != dataSize || !VerifyBlock(index, block))
+            return false;
+        std::memcpy(output.data(), block.data() + blockOffset, output.size());
+        return true;
+    }
+
+    size_t VerifyingBacking::Read(span<u8> output, size_t offset) {
+        if (offset >= size || output.empty())
+            return 0;
+        output = output.first(std::min(output.size(), size - offset));
+
+        size_t firstBlock{offset / blockSize}, lastBlock{(offset + output.size() - 1) / blockSize};
+        bool verified{true};
+        for (size_t index{firstBlock}; index <= lastBlock && verified; index++)
+            verified = IsVerified(index);
+        if (verified)
+            return backing->Read(output, offset);
+
+        auto readBlock{[&](size_t block) {
+            size_t index{firstBlock + block};
+            size_t start{std::max(offset, index * blockSize)}, end{std::min(offset + output.size(), (index + 1) * blockSize)};
+            if (!ReadBlock(index, output.subspan(start - offset, end - start), start - index * blockSize))
+                throw exception("Block {} at 0x{:X} doesn't match its hash", index, index * blockSize);
+        }};
+
+        size_t count{lastBlock - firstBlock + 1};
+        if (count > 1 && threadPool)
+            threadPool->ParallelFor(count, readBlock);
+        else
+            for (size_t block{}; block < count; block++)
+                readBlock(block);
+        return output.size();
+    }
+
+    span<u8> VerifyingBacking::Map(size_t offset, size_t size) {
+        // A mapping can be read without going through this backing, so only regions which have been verified entirely can be mapped
+        if (!size || offset + size > this->size)
+            return {};
+        for (size_t index{offset / blockSize}; index <= (offset + size - 1) / blockSize; index++)
+            if (!IsVerified(index))
+                return {};
+        return backing->Map(offset, size);
+    }
+
+    void VerifyingBacking::Prefetch(size_t offset, size_t size) {
+        backing->Prefetch(offset, size);
+    }
+
+    bool VerifyingBacking::VerifyAll(const std::atomic_bool &cancel) {
+        constexpr size_t ChunkSize{0x400000}; // The amount of bytes that are verified in parallel at once, cancellation is checked between chunks
+
+        std::atomic_bool intact{true};
+        size_t chunkBlocks{std::max<size_t>(ChunkSize / blockSize, 1)};
+        try {
+            for (size_t chunk{}; chunk < blockCount && intact && !cancel; chunk += chunkBlocks) {
+                auto verifyBlock{[&](size_t block) {
+                    size_t index{chunk + block};
+                    if (cancel || !intact || IsVerified(index))
+                        return;
+                    if (!ReadBlock(index, {}, 0))
+                        intact = false;
+                }};
+
+                size_t count{std::min(chunkBlocks, blockCount - chunk)};
+                if (count > 1 && threadPool)
+                    threadPool->ParallelFor(count, verifyBlock);
+                else
+                    for (size_t block{}; block < count; block++)
+                        verifyBlock(block);
+            }
+        } catch (const exception &) {
+            return false; // The hashes of the blocks are read from a level above which didn't match its own hashes
+        }
+        return intact;
+    }
+}
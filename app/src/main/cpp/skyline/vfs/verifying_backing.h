@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright © 2020 Skyline Team and Contributors (https://github.com/skyline-emu/)
+
+#pragma once
+
+#include <atomic>
+#include "backing.h"
+
+namespace skyline::vfs {
+    /**
+     * @brief A backing which verifies the SHA-256 hash of every block of another backing the first time any of it is read
+     * @note The hashes can come from another VerifyingBacking, so every level of a hash tree is only verified as far as the blocks below it are read
+     * @note Blocks which are verified are tracked in a bitmap, they're never hashed again
+     */
+    class VerifyingBacking : public Backing {
+      private:
+        using Hash = std::array<u8, 0x20>;
+
+        std::shared_ptr<Backing> backing;
+        std::shared_ptr<Backing> hashBacking; //!< The backing of the hash of every block, this is nullptr if the hashes are in hashes
+        std::vector<u8> hashes; //!< The trusted hash of every block if they aren't read from hashBacking
+        size_t blockSize;
+        bool padBlocks; //!< If a partial block at the end is hashed as if it was padded with zeros to the block size rather than only over its data
+        std::shared_ptr<ThreadPool> threadPool; //!< The pool that blocks are verified on when several are verified at once, they're verified serially if this is nullptr
+        size_t blockCount;
+        std::unique_ptr<std::atomic<u64>[]> verifiedBlocks; //!< A bitmap of the blocks which have been verified
+
+        inline bool IsVerified(size_t index) {
+            return verifiedBlocks[index / 64].load(std::memory_order_acquire) & (1ULL << (index % 64));
+        }
+
+        /**
+         * @brief Verifies a single block, the contents of which have already been read
+         * @param data The data of the block, this must extend to the block size if the block is padded
+         * @return If the hash of the block matches
+         */
+        bool VerifyBlock(size_t index, span<u8> data);
+
+        /**
+         * @brief Reads a region of a single block into the output, the entire block is read and verified if it hasn't been yet
+         * @return If the block could be read and matches its hash
+         */
+        bool ReadBlock(size_t index, span<u8> output, size_t blockOffset);
+
+      public:
+        /**
+         * @param hashBacking The backing of the hash of every block, these are read as required
+         * @param padBlocks If a partial block at the end should be hashed as if it was padded with zeros to the block size
+         */
+        VerifyingBacking(std::shared_ptr<Backing> backing, std::shared_ptr<Backing> hashBacking, size_t blockSize, bool padBlocks, std::shared_ptr<ThreadPool> threadPool);
+
+        /**
+         * @param hashes The trusted hash of every block
+         */
+        VerifyingBacking(std::shared_ptr<Backing> backing, std::vector<u8> hashes, size_t blockSize, bool padBlocks, std::shared_ptr<ThreadPool> threadPool);
+
+        /**
+         * @note An exception is thrown if any block doesn't match its hash
+         */
+        size_t Read(span<u8> output, size_t offset = 0) override;
+
+        span<u8> Map(size_t offset, size_t size) override;
+
+        void Prefetch(size_t offset, size_t size) override;
+
+        /**
+         * @brief Verifies every block which hasn't been verified yet
+         * @param cancel If set, the verification is stopped as soon as possible
+         * @return If every block is intact, this is also true if the verification was cancelled
+         */
+        bool VerifyAll(const std::atomic_bool &cancel);
+    };
+}
@@ -18,11 +18,22 @@ import emu.skyline.input.*
 import emu.skyline.loader.getRomFormat
 import kotlinx.android.synthetic.main.emu_activity.*
 import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import kotlin.math.abs
 
 class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTouchListener {
     companion object {
         private val Tag = EmulationActivity::class.java.name
+
+        /**
+         * The offsets of the fields in the native control block, these must match ControlBlock in control_block.h
+         */
+        private const val ControlRunStateOffset = 0x0
+        private const val ControlFpsOffset = 0x4
+        private const val ControlFrametimeOffset = 0x8
+
+        private const val RunStatePaused = 2 // RunState::Paused in control_block.h
     }
 
     init {
@@ -39,6 +50,20 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
      */
     private var vibrators = HashMap<Int, Vibrator>()
 
+    /**
+     * The host state of a guest controller, an input event is applied to this first so all of its changes are passed into libskyline with a single [setControllerState] call
+     */
+    private class ControllerState {
+        var buttons = 0L
+        val axes = IntArray(AxisId.values().size)
+        var modified = false
+    }
+
+    /**
+     * A map of [ControllerState]s that correspond to [InputManager.controllers]
+     */
+    private val controllerStates = HashMap<Int, ControllerState>()
+
     /**
      * A boolean flag denoting the current operation mode of the emulator (Docked = true/Handheld = false)
      */
@@ -77,6 +102,16 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
      */
     private external fun executeApplication(romUri : String, romType : Int, romFd : Int, preferenceFd : Int, appFilesPath : String)
 
+    /**
+     * This is the entry point into the emulation code for headless benchmark runs, the ROM is run without a surface or audio output until either limit is reached
+     *
+     * @param frameCount The amount of frames to run for or 0 for no limit
+     * @param duration The duration to run for in seconds or 0 for no limit
+     * @param inputPath The path of an input recording to replay during the run or an empty string for none
+     * @param gpuTracePath The path of a GPFIFO trace to replay during the run or an empty string for none
+     */
+    private external fun executeBenchmark(romUri : String, romType : Int, romFd : Int, preferenceFd : Int, appFilesPath : String, frameCount : Long, duration : Long, inputPath : String, gpuTracePath : String)
+
     /**
      * This sets the halt flag in libskyline to the provided value, if set to true it causes libskyline to halt emulation
      *
@@ -92,14 +127,50 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
     private external fun setSurface(surface : Surface?)
 
     /**
-     * This returns the current FPS of the application
+     * This returns a direct buffer of the control block which is shared with libskyline, it stays valid for the lifetime of the process
+     *
+     * @note The layout of it is defined by the Control*Offset constants, all fields are 32-bit integers in native byte order
+     */
+    private external fun getControlBlock() : ByteBuffer
+
+    /**
+     * The control block shared with libskyline, the state of emulation is polled from this rather than through a JNI call for every value
+     */
+    private val controlBlock by lazy { getControlBlock().order(ByteOrder.nativeOrder()) }
+
+    /**
+     * This returns the estimated output latency of the audio stream in milliseconds
+     */
+    private external fun getAudioLatency() : Float
+
+    /**
+     * This returns the size of the buffer of the audio stream in frames, this grows whenever the stream underruns
+     */
+    private external fun getAudioBufferSize() : Int
+
+    /**
+     * This returns the amount of times the audio stream has underrun
+     */
+    private external fun getAudioXRunCount() : Int
+
+    /**
+     * This returns a snapshot of the SVC profile of the application or null if it isn't running
+     *
+     * @note Every SVC is represented by its call count, the total time spent in it in nanoseconds and 32 buckets of a log2 latency histogram in nanoseconds
+     */
+    private external fun getSvcProfile() : LongArray?
+
+    /**
+     * This returns a snapshot of the performance statistics of the application or null if it isn't running
+     *
+     * @note The layout is the 50th, 95th and 99th percentile and the maximum of the recent frame-times in microseconds, the same percentiles of the latency from a frame being queued to it being posted, the amount of pending GPFIFO entries, SVCs per second, IPC requests per second, the amount of audio underruns, the total amount of uploaded texture data in bytes and the amount of guest memory used by every memory type in bytes the amount of freed guest memory released back to the host in bytes, the reserved and resident host memory of every memory type in bytes interleaved, and the host memory used by textures and audio tracks in bytes, the amount of culled voices and skipped frames, and the allocations and allocated bytes per second of every allocation tag interleaved
      */
-    private external fun getFps() : Int
+    private external fun getPerformanceStats() : LongArray?
 
     /**
-     * This returns the current frame-time of the application
+     * This returns the boot timeline of the application or null if it isn't running, the start and duration of every phase are interleaved in microseconds or -1 if it hasn't happened yet
      */
-    private external fun getFrametime() : Float
+    private external fun getBootTimeline() : LongArray?
 
     /**
      * This initializes a guest controller in libskyline
@@ -119,22 +190,16 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
     private external fun updateControllers()
 
     /**
-     * This sets the state of the buttons specified in the mask on a specific controller
+     * This sets the state of all buttons and axes of a specific controller at once
      *
      * @param index The index of the controller this is directed to
-     * @param mask The mask of the button that are being set
-     * @param pressed If the buttons are being pressed or released
+     * @param buttons The mask of all buttons that are pressed
+     * @param leftX The value of the X axis of the left stick
+     * @param leftY The value of the Y axis of the left stick
+     * @param rightX The value of the X axis of the right stick
+     * @param rightY The value of the Y axis of the right stick
      */
-    private external fun setButtonState(index : Int, mask : Long, pressed : Boolean)
-
-    /**
-     * This sets the value of a specific axis on a specific controller
-     *
-     * @param index The index of the controller this is directed to
-     * @param axis The ID of the axis that is being modified
-     * @param value The value to set the axis to
-     */
-    private external fun setAxisValue(index : Int, axis : Int, value : Int)
+    private external fun setControllerState(index : Int, buttons : Long, leftX : Int, leftY : Int, rightX : Int, rightY : Int)
 
     /**
      * This sets the values of the points on the guest touch-screen
@@ -143,6 +208,36 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
      */
     private external fun setTouchState(points : IntArray)
 
+    /**
+     * This sets the state of the buttons specified in the mask on a specific controller, it's passed into libskyline by [flushControllerStates]
+     */
+    private fun setButtonState(index : Int, mask : Long, pressed : Boolean) {
+        val state = controllerStates.getOrPut(index) { ControllerState() }
+        state.buttons = if (pressed) state.buttons or mask else state.buttons and mask.inv()
+        state.modified = true
+    }
+
+    /**
+     * This sets the value of a specific axis on a specific controller, it's passed into libskyline by [flushControllerStates]
+     */
+    private fun setAxisValue(index : Int, axis : Int, value : Int) {
+        val state = controllerStates.getOrPut(index) { ControllerState() }
+        state.axes[axis] = value
+        state.modified = true
+    }
+
+    /**
+     * This passes the state of every controller that was modified since the last call into libskyline
+     */
+    private fun flushControllerStates() {
+        for ((index, state) in controllerStates) {
+            if (state.modified) {
+                setControllerState(index, state.buttons, state.axes[AxisId.LX.ordinal], state.axes[AxisId.LY.ordinal], state.axes[AxisId.RX.ordinal], state.axes[AxisId.RY.ordinal])
+                state.modified = false
+            }
+        }
+    }
+
     /**
      * This initializes all of the controllers from [input] on the guest
      */
@@ -180,7 +275,19 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
         val romFd = contentResolver.openFileDescriptor(rom, "r")!!
         val preferenceFd = ParcelFileDescriptor.open(File("${applicationInfo.dataDir}/shared_prefs/${applicationInfo.packageName}_preferences.xml"), ParcelFileDescriptor.MODE_READ_WRITE)
 
+        // A headless benchmark is requested through intent extras, so device farms can start one without any UI automation
+        val benchmarkFrames = intent.getLongExtra("benchmark_frames", 0)
+        val benchmarkDuration = intent.getLongExtra("benchmark_duration", 0)
+        val benchmarkInput = intent.getStringExtra("benchmark_input") ?: ""
+        val benchmarkGpuTrace = intent.getStringExtra("benchmark_gpu_trace") ?: ""
+
         emulationThread = Thread {
+            if (benchmarkFrames > 0 || benchmarkDuration > 0) {
+                executeBenchmark(rom.toString(), romType, romFd.detachFd(), preferenceFd.detachFd(), applicationContext.filesDir.canonicalPath + "/", benchmarkFrames, benchmarkDuration, benchmarkInput, benchmarkGpuTrace)
+                runOnUiThread { finish() }
+                return@Thread
+            }
+
             surfaceReady.block()
 
             executeApplication(rom.toString(), romType, romFd.detachFd(), preferenceFd.detachFd(), applicationContext.filesDir.canonicalPath + "/")
@@ -223,7 +330,10 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
         if (sharedPreferences.getBoolean("perf_stats", false)) {
             perf_stats.postDelayed(object : Runnable {
                 override fun run() {
-                    perf_stats.text = "${getFps()} FPS\n${getFrametime()}ms"
+                    val stats = getPerformanceStats()
+                    val paused = controlBlock.getInt(ControlRunStateOffset) == RunStatePaused
+                    perf_stats.text = "${controlBlock.getInt(ControlFpsOffset)} FPS${if (paused) " (Paused)" else ""}\n${controlBlock.getInt(ControlFrametimeOffset) / 100f}ms\n${"%.1f".format(getAudioLatency())}ms audio (${getAudioBufferSize()} frames, ${getAudioXRunCount()} xruns)" +
+                            if (stats != null) "\n${"%.2f".format(stats[2] / 1000f)}ms 1% low (${"%.2f".format(stats[3] / 1000f)}ms max, ${"%.2f".format(stats[5] / 1000f)}ms latency)\n${stats[9]} SVC/s, ${stats[10]} IPC/s, ${stats[8]} GPFIFO" else ""
                     perf_stats.postDelayed(this, 250)
                 }
             }, 250)
@@ -312,13 +422,16 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
 
         return when (val guestEvent = input.eventMap[KeyHostEvent(event.device.descriptor, event.keyCode)]) {
             is ButtonGuestEvent -> {
-                if (guestEvent.button != ButtonId.Menu)
+                if (guestEvent.button != ButtonId.Menu) {
                     setButtonState(guestEvent.id, guestEvent.button.value(), action.state)
+                    flushControllerStates()
+                }
                 true
             }
 
             is AxisGuestEvent -> {
                 setAxisValue(guestEvent.id, guestEvent.axis.ordinal, (if (action == ButtonState.Pressed) if (guestEvent.polarity) Short.MAX_VALUE else Short.MIN_VALUE else 0).toInt())
+                flushControllerStates()
                 true
             }
 
@@ -377,6 +490,7 @@ class EmulationActivity : AppCompatActivity(), SurfaceHolder.Callback, View.OnTo
                     axesHistory[axisItem.index] = value
                 }
 
+                flushControllerStates()
                 return true
             } else {
                 oldHat = hat
@@ -114,6 +114,9 @@ class MainActivity : AppCompatActivity() {
                 foundRoms = foundRoms or addEntries("nso", RomFormat.NSO, searchLocation)
                 foundRoms = foundRoms or addEntries("nca", RomFormat.NCA, searchLocation)
                 foundRoms = foundRoms or addEntries("nsp", RomFormat.NSP, searchLocation)
+                foundRoms = foundRoms or addEntries("nsz", RomFormat.NSZ, searchLocation)
+                foundRoms = foundRoms or addEntries("xci", RomFormat.XCI, searchLocation)
+                foundRoms = foundRoms or addEntries("xcz", RomFormat.XCZ, searchLocation)
 
                 runOnUiThread {
                     if (!foundRoms) adapter.addHeader(getString(R.string.no_rom))
@@ -23,6 +23,8 @@ enum class RomFormat(val format : Int) {
     NCA(2),
     XCI(3),
     NSP(4),
+    NSZ(5),
+    XCZ(6),
 }
 
 /**